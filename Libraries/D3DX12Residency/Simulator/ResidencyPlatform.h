@@ -0,0 +1,435 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// The platform headers for the residency simulator. On Windows these are the SDK headers. Everywhere else this
+// declares just the part of Win32, D3D12 and DXGI that d3dx12Residency.h and the simulator's mocks use, built on the
+// C++ standard library, so the simulator and its traces can run on any machine with a C++11 compiler.
+//
+// Only the interface methods the library calls are declared, so mocks must keep the rest of each interface behind
+// RESIDENCY_PLATFORM_WIN32.
+
+#pragma once
+
+#if defined(_WIN32)
+
+#define RESIDENCY_PLATFORM_WIN32 1
+
+#include <windows.h>
+#include <d3d12.h>
+#include <dxgi1_4.h>
+
+namespace D3DX12Residency
+{
+	namespace Platform
+	{
+		template<class Interface>
+		inline REFIID InterfaceId()
+		{
+			return __uuidof(Interface);
+		}
+	}
+}
+
+#else
+
+#define RESIDENCY_PLATFORM_WIN32 0
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <thread>
+
+/* Base types */
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef int INT;
+typedef int32_t INT32;
+typedef int64_t INT64;
+typedef unsigned int UINT;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef int64_t LONGLONG;
+typedef uint32_t DWORD;
+typedef size_t SIZE_T;
+typedef int32_t HRESULT;
+typedef void* HANDLE;
+typedef const wchar_t* LPCWSTR;
+
+#define TRUE 1
+#define FALSE 0
+#define INFINITE 0xFFFFFFFF
+#define MAXUINT64 (~UINT64(0))
+#define WAIT_OBJECT_0 0
+#define WAIT_FAILED 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+
+#define WINAPI
+#define STDMETHODCALLTYPE
+#define FORCEINLINE inline __attribute__((always_inline))
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define CONTAINING_RECORD(address, type, field) ((type*)((char*)(address) - offsetof(type, field)))
+#define ZeroMemory(Destination, Length) memset((Destination), 0, (Length))
+
+// The library only uses __declspec(selectany), for a global that lives in a header
+#define __declspec(Attribute) RESIDENCY_DECLSPEC_##Attribute
+#define RESIDENCY_DECLSPEC_selectany __attribute__((weak))
+
+/* Results */
+#define S_OK HRESULT(0)
+#define E_NOTIMPL HRESULT(0x80004001)
+#define E_NOINTERFACE HRESULT(0x80004002)
+#define E_FAIL HRESULT(0x80004005)
+#define E_OUTOFMEMORY HRESULT(0x8007000E)
+#define E_INVALIDARG HRESULT(0x80070057)
+#define DXGI_ERROR_NOT_FOUND HRESULT(0x887A0002)
+#define DXGI_ERROR_MORE_DATA HRESULT(0x887A0003)
+
+#define SUCCEEDED(hr) (HRESULT(hr) >= 0)
+#define FAILED(hr) (HRESULT(hr) < 0)
+#define HRESULT_FROM_WIN32(x) ((x) == 0 ? S_OK : HRESULT(((x) & 0x0000FFFF) | 0x80070000))
+
+inline DWORD GetLastError() { return 0; }
+
+union LARGE_INTEGER
+{
+	LONGLONG QuadPart;
+};
+
+struct LIST_ENTRY
+{
+	LIST_ENTRY* Flink;
+	LIST_ENTRY* Blink;
+};
+
+struct GUID
+{
+	uint32_t Data1;
+	uint16_t Data2;
+	uint16_t Data3;
+	uint8_t Data4[8];
+};
+
+typedef const GUID& REFGUID;
+typedef const GUID& REFIID;
+
+inline bool operator==(REFGUID a, REFGUID b) { return memcmp(&a, &b, sizeof(GUID)) == 0; }
+inline bool operator!=(REFGUID a, REFGUID b) { return !(a == b); }
+
+/* Timing */
+inline BOOL QueryPerformanceCounter(LARGE_INTEGER* pCount)
+{
+	pCount->QuadPart = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	return TRUE;
+}
+
+inline BOOL QueryPerformanceFrequency(LARGE_INTEGER* pFrequency)
+{
+	pFrequency->QuadPart = 1000000000;
+	return TRUE;
+}
+
+/* Interlocked */
+template<typename T>
+inline T InterlockedIncrement(T volatile* pAddend)
+{
+	return __atomic_add_fetch(pAddend, 1, __ATOMIC_SEQ_CST);
+}
+
+inline INT64 InterlockedIncrement64(INT64 volatile* pAddend)
+{
+	return __atomic_add_fetch(pAddend, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Critical sections; like Win32 they can be re-entered by the owning thread */
+struct CRITICAL_SECTION
+{
+	alignas(std::recursive_mutex) unsigned char Storage[sizeof(std::recursive_mutex)];
+	std::recursive_mutex& Get() { return *reinterpret_cast<std::recursive_mutex*>(Storage); }
+};
+
+inline BOOL InitializeCriticalSectionAndSpinCount(CRITICAL_SECTION* pCS, DWORD)
+{
+	new (pCS->Storage) std::recursive_mutex();
+	return TRUE;
+}
+
+inline void DeleteCriticalSection(CRITICAL_SECTION* pCS) { pCS->Get().~recursive_mutex(); }
+inline void EnterCriticalSection(CRITICAL_SECTION* pCS) { pCS->Get().lock(); }
+inline void LeaveCriticalSection(CRITICAL_SECTION* pCS) { pCS->Get().unlock(); }
+
+/* Events and threads. Both are waitable through the same HANDLE, as on Windows. */
+namespace D3DX12Residency
+{
+	namespace Platform
+	{
+		class WaitableObject
+		{
+		public:
+			virtual ~WaitableObject() {}
+			virtual DWORD Wait(DWORD Milliseconds) = 0;
+		};
+
+		class Event : public WaitableObject
+		{
+		public:
+			Event(bool ManualResetIn, bool InitialState) : ManualReset(ManualResetIn), Signaled(InitialState) {}
+
+			void Set()
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+				Signaled = true;
+				if (ManualReset)
+				{
+					Condition.notify_all();
+				}
+				else
+				{
+					Condition.notify_one();
+				}
+			}
+
+			void Reset()
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+				Signaled = false;
+			}
+
+			DWORD Wait(DWORD Milliseconds) override
+			{
+				std::unique_lock<std::mutex> Lock(Mutex);
+				if (Milliseconds == INFINITE)
+				{
+					Condition.wait(Lock, [this] { return Signaled; });
+				}
+				else if (Condition.wait_for(Lock, std::chrono::milliseconds(Milliseconds), [this] { return Signaled; }) == false)
+				{
+					return WAIT_FAILED;
+				}
+
+				// An auto reset event releases exactly one waiter
+				if (ManualReset == false)
+				{
+					Signaled = false;
+				}
+				return WAIT_OBJECT_0;
+			}
+
+		private:
+			std::mutex Mutex;
+			std::condition_variable Condition;
+			const bool ManualReset;
+			bool Signaled;
+		};
+
+		class Thread : public WaitableObject
+		{
+		public:
+			template<typename StartRoutine>
+			Thread(StartRoutine pStart, void* pParameter) : Worker(pStart, pParameter) {}
+
+			~Thread()
+			{
+				if (Worker.joinable())
+				{
+					Worker.detach();
+				}
+			}
+
+			// Waiting on a thread handle waits for the thread to exit
+			DWORD Wait(DWORD) override
+			{
+				if (Worker.joinable())
+				{
+					Worker.join();
+				}
+				return WAIT_OBJECT_0;
+			}
+
+		private:
+			std::thread Worker;
+		};
+
+		template<class Interface>
+		inline REFIID InterfaceId()
+		{
+			return Interface::InterfaceId();
+		}
+
+		// Builds a distinct interface ID from a small number, which is all the mocks need
+		inline GUID MakeInterfaceId(uint32_t Index)
+		{
+			GUID Id = { 0x696E7466, 0x0000, 0x0000, { 0, 0, 0, 0, 0, 0, 0, 0 } };
+			Id.Data2 = uint16_t(Index);
+			return Id;
+		}
+	}
+}
+
+inline HANDLE CreateEvent(void*, BOOL bManualReset, BOOL bInitialState, LPCWSTR)
+{
+	return static_cast<D3DX12Residency::Platform::WaitableObject*>(new D3DX12Residency::Platform::Event(bManualReset != FALSE, bInitialState != FALSE));
+}
+
+inline BOOL SetEvent(HANDLE hEvent)
+{
+	static_cast<D3DX12Residency::Platform::Event*>(static_cast<D3DX12Residency::Platform::WaitableObject*>(hEvent))->Set();
+	return TRUE;
+}
+
+inline BOOL ResetEvent(HANDLE hEvent)
+{
+	static_cast<D3DX12Residency::Platform::Event*>(static_cast<D3DX12Residency::Platform::WaitableObject*>(hEvent))->Reset();
+	return TRUE;
+}
+
+typedef unsigned long (*LPTHREAD_START_ROUTINE)(void* pParameter);
+
+inline HANDLE CreateThread(void*, SIZE_T, LPTHREAD_START_ROUTINE pStartAddress, void* pParameter, DWORD, DWORD*)
+{
+	return static_cast<D3DX12Residency::Platform::WaitableObject*>(new D3DX12Residency::Platform::Thread(pStartAddress, pParameter));
+}
+
+inline DWORD WaitForSingleObject(HANDLE hHandle, DWORD Milliseconds)
+{
+	if (hHandle == nullptr || hHandle == INVALID_HANDLE_VALUE)
+	{
+		return WAIT_FAILED;
+	}
+	return static_cast<D3DX12Residency::Platform::WaitableObject*>(hHandle)->Wait(Milliseconds);
+}
+
+inline BOOL CloseHandle(HANDLE hObject)
+{
+	delete static_cast<D3DX12Residency::Platform::WaitableObject*>(hObject);
+	return TRUE;
+}
+
+/* COM */
+#define IID_PPV_ARGS(ppType) D3DX12Residency::Platform::InterfaceIdOfPointee(ppType), reinterpret_cast<void**>(ppType)
+
+#define RESIDENCY_DECLARE_INTERFACE_ID(Index) \
+	static REFIID InterfaceId() { static const GUID Id = D3DX12Residency::Platform::MakeInterfaceId(Index); return Id; }
+
+struct IUnknown
+{
+	RESIDENCY_DECLARE_INTERFACE_ID(0)
+
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) = 0;
+	virtual ULONG STDMETHODCALLTYPE AddRef() = 0;
+	virtual ULONG STDMETHODCALLTYPE Release() = 0;
+
+protected:
+	~IUnknown() {}
+};
+
+namespace D3DX12Residency
+{
+	namespace Platform
+	{
+		template<class Interface>
+		inline REFIID InterfaceIdOfPointee(Interface**)
+		{
+			return Interface::InterfaceId();
+		}
+	}
+}
+
+/* D3D12 */
+enum D3D12_FENCE_FLAGS
+{
+	D3D12_FENCE_FLAG_NONE = 0
+};
+
+struct ID3D12Object : public IUnknown
+{
+	RESIDENCY_DECLARE_INTERFACE_ID(1)
+
+	virtual HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData) = 0;
+	virtual HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT DataSize, const void* pData) = 0;
+	virtual HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* pData) = 0;
+	virtual HRESULT STDMETHODCALLTYPE SetName(LPCWSTR Name) = 0;
+};
+
+struct ID3D12DeviceChild : public ID3D12Object
+{
+	RESIDENCY_DECLARE_INTERFACE_ID(2)
+
+	virtual HRESULT STDMETHODCALLTYPE GetDevice(REFIID riid, void** ppvDevice) = 0;
+};
+
+struct ID3D12Pageable : public ID3D12DeviceChild
+{
+	RESIDENCY_DECLARE_INTERFACE_ID(3)
+};
+
+struct ID3D12Fence : public ID3D12Pageable
+{
+	RESIDENCY_DECLARE_INTERFACE_ID(4)
+
+	virtual UINT64 STDMETHODCALLTYPE GetCompletedValue() = 0;
+	virtual HRESULT STDMETHODCALLTYPE SetEventOnCompletion(UINT64 Value, HANDLE hEvent) = 0;
+	virtual HRESULT STDMETHODCALLTYPE Signal(UINT64 Value) = 0;
+};
+
+struct ID3D12CommandList : public ID3D12DeviceChild
+{
+	RESIDENCY_DECLARE_INTERFACE_ID(5)
+};
+
+struct ID3D12CommandQueue : public ID3D12Pageable
+{
+	RESIDENCY_DECLARE_INTERFACE_ID(6)
+
+	virtual void STDMETHODCALLTYPE ExecuteCommandLists(UINT NumCommandLists, ID3D12CommandList* const* ppCommandLists) = 0;
+	virtual HRESULT STDMETHODCALLTYPE Signal(ID3D12Fence* pFence, UINT64 Value) = 0;
+	virtual HRESULT STDMETHODCALLTYPE Wait(ID3D12Fence* pFence, UINT64 Value) = 0;
+};
+
+struct ID3D12Device : public ID3D12Object
+{
+	RESIDENCY_DECLARE_INTERFACE_ID(7)
+
+	virtual HRESULT STDMETHODCALLTYPE CreateFence(UINT64 InitialValue, D3D12_FENCE_FLAGS Flags, REFIID riid, void** ppFence) = 0;
+	virtual HRESULT STDMETHODCALLTYPE MakeResident(UINT NumObjects, ID3D12Pageable* const* ppObjects) = 0;
+	virtual HRESULT STDMETHODCALLTYPE Evict(UINT NumObjects, ID3D12Pageable* const* ppObjects) = 0;
+};
+
+/* DXGI */
+enum DXGI_MEMORY_SEGMENT_GROUP
+{
+	DXGI_MEMORY_SEGMENT_GROUP_LOCAL = 0,
+	DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL = 1
+};
+
+struct DXGI_QUERY_VIDEO_MEMORY_INFO
+{
+	UINT64 Budget;
+	UINT64 CurrentUsage;
+	UINT64 AvailableForReservation;
+	UINT64 CurrentReservation;
+};
+
+struct IDXGIAdapter3 : public IUnknown
+{
+	RESIDENCY_DECLARE_INTERFACE_ID(8)
+
+	virtual HRESULT STDMETHODCALLTYPE QueryVideoMemoryInfo(UINT NodeIndex, DXGI_MEMORY_SEGMENT_GROUP MemorySegmentGroup, DXGI_QUERY_VIDEO_MEMORY_INFO* pVideoMemoryInfo) = 0;
+};
+
+#undef RESIDENCY_DECLARE_INTERFACE_ID
+
+#endif
@@ -0,0 +1,777 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Replays a residency trace through ResidencySimulator and prints the resulting paging report.
+//
+// Usage: ResidencySimulator <trace file> [-log] [-nolockstep]
+//        ResidencySimulator -stress [threads]
+//        ResidencySimulator -bench [threads]
+//
+// -log prints every paging event. -nolockstep lets the library's worker thread run ahead of the submitting thread
+// (see Config::LockstepPaging); it only makes a difference when built with RESIDENCY_SINGLE_THREADED set to 0, and
+// because it makes the results depend on thread timing, traces should be checked without it.
+//
+// A trace is a list of commands, one per line ('#' starts a comment). Sizes accept a K, M or G suffix.
+//
+//   budget <local> [non-local]     Set the budgets reported by the adapter
+//   latency <frames>               GPU latency in frames (only before the first create)
+//   frametime <milliseconds>       How far the virtual clock advances per frame (only before the first create)
+//   thrashwindow <frames>          See Config::ThrashWindowFrames (only before the first create)
+//   create <name> <size>           Create and begin tracking a heap
+//   destroy <name>                 Stop tracking and release a heap
+//   submit <name> [<name> ...]     Execute one command list that uses the given heaps
+//   frame [count]                  End the current frame(s)
+//   repeat <count> ... end         Replay the enclosed commands; blocks can nest
+//   expect <metric> <op> <value>   Fail the run unless the metric (so far) satisfies the comparison
+//
+// Metrics: stalls, deadlocks, thrash_rate, bytes_paged_per_frame, max_bytes_paged_per_frame,
+// frames_over_budget, bytes_made_resident, bytes_evicted, peak_usage
+//
+// The process exits with a non-zero code if the trace is malformed or any expectation fails, so traces can be
+// used as regression tests for changes to the paging policy.
+//
+// -stress has streaming threads create, destroy, track and untrack heaps while the main thread submits under a
+// changing budget, so heaps are released while the worker thread is paging, then checks that the library's residency state matches the mock device's. -bench times
+// submissions with and without paging, counts the heap allocations each one makes, and measures track/untrack
+// throughput through the sharded LRU from 1 up to the given number of threads. Both are most useful in the
+// RESIDENCY_SINGLE_THREADED=0 build; build with RESIDENCY_NUM_LRU_SHARDS=1 to compare against a single LRU.
+
+#include "ResidencySimulator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using D3DX12Residency::ManagedObject;
+using D3DX12Residency::ResidencyManager;
+using namespace D3DX12Residency::Simulator;
+
+namespace
+{
+	std::atomic<UINT64> g_NumAllocations(0);
+}
+
+// Every heap allocation in the process is counted so that -bench can see what a submission allocates
+void* operator new(size_t Size)
+{
+	g_NumAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	void* pMemory = malloc(Size ? Size : 1);
+	if (pMemory == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return pMemory;
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+	free(pMemory);
+}
+
+namespace
+{
+	bool ParseSize(const std::string& Token, UINT64& SizeOut)
+	{
+		char* pEnd = nullptr;
+		double Value = strtod(Token.c_str(), &pEnd);
+		if (pEnd == Token.c_str() || Value < 0.0)
+		{
+			return false;
+		}
+
+		switch (*pEnd)
+		{
+		case '\0':           break;
+		case 'k': case 'K':  Value *= 1024.0; break;
+		case 'm': case 'M':  Value *= 1024.0 * 1024.0; break;
+		case 'g': case 'G':  Value *= 1024.0 * 1024.0 * 1024.0; break;
+		default:             return false;
+		}
+
+		SizeOut = UINT64(Value);
+		return true;
+	}
+
+	class TraceRunner
+	{
+	public:
+		TraceRunner(bool PrintLog, bool LockstepPaging) : bPrintLog(PrintLog), bInitialized(false), NumFailedExpectations(0)
+		{
+			Settings.LockstepPaging = LockstepPaging;
+		}
+
+		bool Run(const std::vector<std::string>& Lines)
+		{
+			if (RunRange(Lines, 0, Lines.size()) == false)
+			{
+				return false;
+			}
+			return EnsureInitialized();
+		}
+
+		void PrintReport()
+		{
+			if (bPrintLog)
+			{
+				static const char* EventNames[] = { "MakeResident", "Evict", "Stall" };
+
+				for (const PagingEvent& Event : Simulator.GetLog())
+				{
+					printf("frame %6u  %-12s  %6u objects  %12llu bytes\n",
+						Event.Frame, EventNames[UINT32(Event.Type)], Event.NumObjects, (unsigned long long)Event.NumBytes);
+				}
+				printf("\n");
+			}
+
+			const Report& Stats = Simulator.GetReport();
+			printf("Paging:                     %s\n", RESIDENCY_SINGLE_THREADED ? "inline" : Settings.LockstepPaging ? "worker thread, lockstep" : "worker thread");
+			printf("Frames:                     %u\n", Stats.NumFrames);
+			printf("MakeResident calls:         %llu (%llu objects, %llu bytes)\n", (unsigned long long)Stats.NumMakeResidentCalls,
+				(unsigned long long)Stats.NumObjectsMadeResident, (unsigned long long)Stats.BytesMadeResident);
+			printf("Evict calls:                %llu (%llu objects, %llu bytes)\n", (unsigned long long)Stats.NumEvictCalls,
+				(unsigned long long)Stats.NumObjectsEvicted, (unsigned long long)Stats.BytesEvicted);
+			printf("Bytes paged per frame:      %.0f average, %llu max\n", Stats.GetAverageBytesPagedPerFrame(), (unsigned long long)Stats.MaxBytesPagedInFrame);
+			printf("Thrash rate:                %.4f (%llu objects)\n", Stats.GetThrashRate(), (unsigned long long)Stats.NumThrashedObjects);
+			printf("Stalls:                     %u\n", Stats.NumStalls);
+			printf("Deadlocks:                  %u\n", Stats.NumDeadlocks);
+			printf("Frames over budget:         %u\n", Stats.NumFramesOverBudget);
+			printf("Peak usage:                 %llu bytes\n", (unsigned long long)Stats.PeakUsage);
+		}
+
+		UINT32 GetNumFailedExpectations() const { return NumFailedExpectations; }
+
+	private:
+		bool Error(size_t LineIndex, const char* pMessage)
+		{
+			fprintf(stderr, "line %zu: %s\n", LineIndex + 1, pMessage);
+			return false;
+		}
+
+		bool EnsureInitialized()
+		{
+			if (bInitialized == false)
+			{
+				if (FAILED(Simulator.Initialize(Settings)))
+				{
+					fprintf(stderr, "Failed to initialize the residency simulator\n");
+					return false;
+				}
+				bInitialized = true;
+			}
+			return true;
+		}
+
+		// Finds the 'end' matching the 'repeat' on line Begin
+		size_t FindBlockEnd(const std::vector<std::string>& Lines, size_t Begin, size_t End)
+		{
+			UINT32 Depth = 0;
+			for (size_t i = Begin; i < End; i++)
+			{
+				std::istringstream Stream(Lines[i].substr(0, Lines[i].find('#')));
+				std::string Command;
+				Stream >> Command;
+
+				if (Command == "repeat")
+				{
+					Depth++;
+				}
+				else if (Command == "end" && --Depth == 0)
+				{
+					return i;
+				}
+			}
+			return End;
+		}
+
+		bool RunRange(const std::vector<std::string>& Lines, size_t Begin, size_t End)
+		{
+			for (size_t i = Begin; i < End; i++)
+			{
+				std::istringstream Stream(Lines[i].substr(0, Lines[i].find('#')));
+				std::string Command;
+				if (!(Stream >> Command))
+				{
+					continue;
+				}
+
+				if (Command == "repeat")
+				{
+					UINT32 Count = 0;
+					const size_t BlockEnd = FindBlockEnd(Lines, i, End);
+					if (!(Stream >> Count) || BlockEnd == End)
+					{
+						return Error(i, "expected 'repeat <count>' with a matching 'end'");
+					}
+					for (UINT32 Iteration = 0; Iteration < Count; Iteration++)
+					{
+						if (RunRange(Lines, i + 1, BlockEnd) == false)
+						{
+							return false;
+						}
+					}
+					i = BlockEnd;
+				}
+				else if (Command == "budget")
+				{
+					std::string Local, NonLocal;
+					UINT64 LocalBudget = 0, NonLocalBudget = 0;
+					Stream >> Local >> NonLocal;
+					if (ParseSize(Local, LocalBudget) == false || (NonLocal.empty() == false && ParseSize(NonLocal, NonLocalBudget) == false))
+					{
+						return Error(i, "expected 'budget <local> [non-local]'");
+					}
+					Settings.LocalBudget = LocalBudget;
+					Settings.NonLocalBudget = NonLocalBudget;
+					Simulator.SetBudget(LocalBudget, NonLocalBudget);
+				}
+				else if (Command == "latency" || Command == "frametime" || Command == "thrashwindow")
+				{
+					float Value = 0.0f;
+					if (bInitialized || !(Stream >> Value) || Value < 0.0f)
+					{
+						return Error(i, "simulation settings must be given as non-negative values before the first create");
+					}
+					if (Command == "latency")
+					{
+						Settings.GPULatencyFrames = UINT32(Value);
+					}
+					else if (Command == "frametime")
+					{
+						Settings.FrameTimeSeconds = Value / 1000.0f;
+					}
+					else
+					{
+						Settings.ThrashWindowFrames = UINT32(Value);
+					}
+				}
+				else if (Command == "create")
+				{
+					std::string Name, Size;
+					UINT64 SizeInBytes = 0;
+					if (!(Stream >> Name >> Size) || ParseSize(Size, SizeInBytes) == false)
+					{
+						return Error(i, "expected 'create <name> <size>'");
+					}
+					if (ObjectsByName.count(Name))
+					{
+						return Error(i, "object already exists");
+					}
+					if (EnsureInitialized() == false)
+					{
+						return false;
+					}
+					ObjectsByName[Name] = Simulator.CreateObject(SizeInBytes);
+				}
+				else if (Command == "destroy")
+				{
+					std::string Name;
+					Stream >> Name;
+					auto Iter = ObjectsByName.find(Name);
+					if (Iter == ObjectsByName.end())
+					{
+						return Error(i, "unknown object");
+					}
+					Simulator.DestroyObject(Iter->second);
+					ObjectsByName.erase(Iter);
+				}
+				else if (Command == "submit")
+				{
+					if (EnsureInitialized() == false)
+					{
+						return false;
+					}
+
+					std::vector<UINT32> Indices;
+					std::string Name;
+					while (Stream >> Name)
+					{
+						auto Iter = ObjectsByName.find(Name);
+						if (Iter == ObjectsByName.end())
+						{
+							return Error(i, "unknown object");
+						}
+						Indices.push_back(Iter->second);
+					}
+					if (FAILED(Simulator.Submit(Indices.data(), UINT32(Indices.size()))))
+					{
+						return Error(i, "submit failed");
+					}
+				}
+				else if (Command == "frame")
+				{
+					UINT32 Count = 1;
+					if (!(Stream >> Count))
+					{
+						Count = 1;
+					}
+					if (EnsureInitialized() == false)
+					{
+						return false;
+					}
+					for (UINT32 Frame = 0; Frame < Count; Frame++)
+					{
+						Simulator.EndFrame();
+					}
+				}
+				else if (Command == "expect")
+				{
+					std::string Metric, Op, Value;
+					Stream >> Metric >> Op >> Value;
+					if (EnsureInitialized() == false || Expect(i, Metric, Op, Value) == false)
+					{
+						return false;
+					}
+				}
+				else
+				{
+					return Error(i, "unknown command");
+				}
+			}
+			return true;
+		}
+
+		bool Expect(size_t LineIndex, const std::string& Metric, const std::string& Op, const std::string& ValueToken)
+		{
+			const Report& Stats = Simulator.GetReport();
+
+			double Actual = 0.0;
+			if (Metric == "stalls")                          Actual = Stats.NumStalls;
+			else if (Metric == "deadlocks")                  Actual = Stats.NumDeadlocks;
+			else if (Metric == "thrash_rate")                Actual = Stats.GetThrashRate();
+			else if (Metric == "bytes_paged_per_frame")      Actual = Stats.GetAverageBytesPagedPerFrame();
+			else if (Metric == "max_bytes_paged_per_frame")  Actual = double(Stats.MaxBytesPagedInFrame);
+			else if (Metric == "frames_over_budget")         Actual = Stats.NumFramesOverBudget;
+			else if (Metric == "bytes_made_resident")        Actual = double(Stats.BytesMadeResident);
+			else if (Metric == "bytes_evicted")              Actual = double(Stats.BytesEvicted);
+			else if (Metric == "peak_usage")                 Actual = double(Stats.PeakUsage);
+			else return Error(LineIndex, "unknown metric");
+
+			// Ratios are given as plain numbers, everything else may use a size suffix
+			double Expected = 0.0;
+			UINT64 Size = 0;
+			if (Metric == "thrash_rate")
+			{
+				Expected = atof(ValueToken.c_str());
+			}
+			else if (ParseSize(ValueToken, Size))
+			{
+				Expected = double(Size);
+			}
+			else
+			{
+				return Error(LineIndex, "expected 'expect <metric> <op> <value>'");
+			}
+
+			bool Passed;
+			if (Op == "<=")       Passed = Actual <= Expected;
+			else if (Op == "<")   Passed = Actual < Expected;
+			else if (Op == ">=")  Passed = Actual >= Expected;
+			else if (Op == ">")   Passed = Actual > Expected;
+			else if (Op == "==")  Passed = Actual == Expected;
+			else return Error(LineIndex, "unknown comparison");
+
+			if (Passed == false)
+			{
+				fprintf(stderr, "line %zu: expectation failed: %s is %.4f, expected %s %s\n",
+					LineIndex + 1, Metric.c_str(), Actual, Op.c_str(), ValueToken.c_str());
+				NumFailedExpectations++;
+			}
+			return true;
+		}
+
+		bool bPrintLog;
+		bool bInitialized;
+		UINT32 NumFailedExpectations;
+		Config Settings;
+		ResidencySimulator Simulator;
+		std::map<std::string, UINT32> ObjectsByName;
+	};
+
+	UINT32 DefaultThreadCount()
+	{
+		return RESIDENCY_MIN(RESIDENCY_MAX(std::thread::hardware_concurrency(), 2u), 8u);
+	}
+
+	int RunStress(UINT32 NumThreads)
+	{
+		static const UINT32 cNumFrames = 4000;
+		static const UINT32 cNumSharedObjects = 512;
+		static const UINT32 cHotObjects = 128;
+		static const UINT32 cCommandListsPerFrame = 4;
+		static const UINT32 cObjectsPerCommandList = 32;
+		static const UINT32 cObjectsPerStreamingThread = 16;
+		static const UINT64 cMB = 1024 * 1024;
+
+		Config Settings;
+		Settings.LocalBudget = 256 * cMB;
+		Settings.FrameTimeSeconds = 0.1f;
+		Settings.LockstepPaging = false;
+		Settings.RecordLog = false;
+
+		ResidencySimulator Simulator;
+		if (FAILED(Simulator.Initialize(Settings)))
+		{
+			fprintf(stderr, "Failed to initialize the residency simulator\n");
+			return 2;
+		}
+
+		std::mt19937 Random(1);
+		std::vector<UINT32> SharedObjects(cNumSharedObjects);
+		for (UINT32& Index : SharedObjects)
+		{
+			Index = Simulator.CreateObject((1 + Random() % 4) * cMB);
+		}
+
+		// Each streaming thread keeps a handful of heaps of its own, replacing the oldest one every iteration and
+		// untracking and retracking another, which may have been evicted in the meantime
+		std::atomic<bool> Stop(false);
+		std::atomic<UINT64> NumStreamed(0);
+		std::vector<std::thread> StreamingThreads;
+		for (UINT32 t = 0; t < NumThreads; t++)
+		{
+			StreamingThreads.emplace_back([&Simulator, &Stop, &NumStreamed, t]
+			{
+				std::mt19937 ThreadRandom(100 + t);
+				std::vector<UINT32> Owned;
+				UINT32 Oldest = 0;
+
+				while (Stop.load() == false)
+				{
+					const UINT32 Index = Simulator.CreateObject((1 + ThreadRandom() % 8) * 256 * 1024);
+					if (Owned.size() < cObjectsPerStreamingThread)
+					{
+						Owned.push_back(Index);
+					}
+					else
+					{
+						Simulator.DestroyObject(Owned[Oldest]);
+						Owned[Oldest] = Index;
+						Oldest = (Oldest + 1) % cObjectsPerStreamingThread;
+					}
+
+					ManagedObject* pObject = Simulator.GetManagedObject(Owned[ThreadRandom() % Owned.size()]);
+					Simulator.GetManager().EndTrackingObject(pObject);
+					Simulator.GetManager().BeginTrackingObject(pObject);
+
+					NumStreamed++;
+					std::this_thread::yield();
+				}
+
+				for (UINT32 Index : Owned)
+				{
+					Simulator.DestroyObject(Index);
+				}
+			});
+		}
+
+		// Command lists use random heaps from a window that moves through the shared heaps, so heaps age out and are
+		// evicted, then come back into use and have to be made resident again
+		bool SubmitFailed = false;
+		std::vector<UINT32> Indices(cObjectsPerCommandList);
+		for (UINT32 Frame = 0; Frame < cNumFrames && SubmitFailed == false; Frame++)
+		{
+			if (Frame % 100 == 0)
+			{
+				Simulator.SetBudget((128 + Random() % 384) * cMB, 0);
+			}
+
+			for (UINT32 CommandList = 0; CommandList < cCommandListsPerFrame; CommandList++)
+			{
+				for (UINT32& Index : Indices)
+				{
+					Index = SharedObjects[(Frame * 8 + Random() % cHotObjects) % cNumSharedObjects];
+				}
+				SubmitFailed |= FAILED(Simulator.Submit(Indices.data(), UINT32(Indices.size())));
+			}
+			Simulator.EndFrame();
+
+			// Let the streaming threads in even when there are fewer cores than threads
+			std::this_thread::yield();
+		}
+
+		Stop = true;
+		for (std::thread& Thread : StreamingThreads)
+		{
+			Thread.join();
+		}
+
+		const Report& Stats = Simulator.GetReport();
+		const UINT32 NumInconsistent = Simulator.CountInconsistentObjects();
+
+		for (UINT32 Index : SharedObjects)
+		{
+			Simulator.DestroyObject(Index);
+		}
+		const UINT64 LeftoverUsage = Simulator.GetCurrentUsage();
+
+		printf("Paging:                     %s\n", RESIDENCY_SINGLE_THREADED ? "inline" : "worker thread");
+		printf("Streaming threads:          %u (%llu heaps streamed)\n", NumThreads, (unsigned long long)NumStreamed.load());
+		printf("Frames:                     %u\n", Stats.NumFrames);
+		printf("MakeResident calls:         %llu (%llu objects)\n", (unsigned long long)Stats.NumMakeResidentCalls, (unsigned long long)Stats.NumObjectsMadeResident);
+		printf("Evict calls:                %llu (%llu objects)\n", (unsigned long long)Stats.NumEvictCalls, (unsigned long long)Stats.NumObjectsEvicted);
+		printf("Stalls:                     %u\n", Stats.NumStalls);
+		printf("Deadlocks:                  %u\n", Stats.NumDeadlocks);
+		printf("Inconsistent objects:       %u\n", NumInconsistent);
+
+		const bool Passed = SubmitFailed == false && Stats.NumDeadlocks == 0 && NumInconsistent == 0 && LeftoverUsage == 0 &&
+			Stats.NumObjectsMadeResident > 0 && (NumThreads == 0 || NumStreamed.load() > 0);
+		printf("stress %s\n", Passed ? "passed" : "FAILED");
+		return Passed ? 0 : 1;
+	}
+
+	struct SubmissionTiming
+	{
+		double NanosecondsPerSubmit;
+		double AllocationsPerSubmit;
+		UINT64 NumObjectsMadeResident;
+	};
+
+	// Each frame submits cCommandListsPerFrame lists of cObjectsPerCommandList 1MB heaps. The heaps a frame uses
+	// start Stride heaps after the previous frame's, so a stride of 0 reuses the same heaps every frame.
+	bool TimeSubmissions(UINT64 Budget, UINT32 Stride, float FrameTimeSeconds, SubmissionTiming& Timing)
+	{
+		static const UINT32 cNumObjects = 2048;
+		static const UINT32 cCommandListsPerFrame = 8;
+		static const UINT32 cObjectsPerCommandList = 32;
+		static const UINT32 cWarmupFrames = 64;
+		static const UINT32 cMeasuredFrames = 512;
+
+		Config Settings;
+		Settings.LocalBudget = Budget;
+		Settings.FrameTimeSeconds = FrameTimeSeconds;
+		Settings.RecordLog = false;
+
+		ResidencySimulator Simulator;
+		if (FAILED(Simulator.Initialize(Settings)))
+		{
+			return false;
+		}
+
+		std::vector<UINT32> Objects(cNumObjects);
+		for (UINT32& Index : Objects)
+		{
+			Index = Simulator.CreateObject(1024 * 1024);
+		}
+
+		std::chrono::steady_clock::duration SubmitTime(0);
+		UINT64 NumAllocations = 0;
+		UINT64 MadeResidentBefore = 0;
+		std::vector<UINT32> Indices(cObjectsPerCommandList);
+
+		for (UINT32 Frame = 0; Frame < cWarmupFrames + cMeasuredFrames; Frame++)
+		{
+			if (Frame == cWarmupFrames)
+			{
+				MadeResidentBefore = Simulator.GetReport().NumObjectsMadeResident;
+			}
+
+			for (UINT32 CommandList = 0; CommandList < cCommandListsPerFrame; CommandList++)
+			{
+				const UINT32 First = Frame * Stride + CommandList * cObjectsPerCommandList;
+				for (UINT32 i = 0; i < cObjectsPerCommandList; i++)
+				{
+					Indices[i] = Objects[(First + i) % cNumObjects];
+				}
+
+				const UINT64 AllocationsBefore = g_NumAllocations.load();
+				const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+				const HRESULT hr = Simulator.Submit(Indices.data(), cObjectsPerCommandList);
+				const std::chrono::steady_clock::time_point End = std::chrono::steady_clock::now();
+				const UINT64 AllocationsAfter = g_NumAllocations.load();
+
+				if (FAILED(hr))
+				{
+					return false;
+				}
+				if (Frame >= cWarmupFrames)
+				{
+					SubmitTime += End - Start;
+					NumAllocations += AllocationsAfter - AllocationsBefore;
+				}
+			}
+			Simulator.EndFrame();
+		}
+
+		const double NumSubmits = double(cMeasuredFrames * cCommandListsPerFrame);
+		Timing.NanosecondsPerSubmit = double(std::chrono::duration_cast<std::chrono::nanoseconds>(SubmitTime).count()) / NumSubmits;
+		Timing.AllocationsPerSubmit = double(NumAllocations) / NumSubmits;
+		Timing.NumObjectsMadeResident = Simulator.GetReport().NumObjectsMadeResident - MadeResidentBefore;
+		return Simulator.GetReport().NumDeadlocks == 0;
+	}
+
+	// Returns track/untrack pairs per second with NumThreads threads each cycling through its own objects
+	double TimeTracking(ResidencySimulator& Simulator, const std::vector<ManagedObject*>& Objects, UINT32 NumThreads)
+	{
+		static const UINT32 cRounds = 64;
+
+		const size_t ObjectsPerThread = Objects.size() / NumThreads;
+		std::atomic<UINT32> NumReady(0);
+		std::vector<std::thread> Threads;
+		const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+		for (UINT32 t = 0; t < NumThreads; t++)
+		{
+			Threads.emplace_back([&Simulator, &Objects, &NumReady, NumThreads, ObjectsPerThread, t]
+			{
+				// Start together so the threads actually contend
+				NumReady++;
+				while (NumReady.load() < NumThreads)
+				{
+					std::this_thread::yield();
+				}
+
+				ResidencyManager& Manager = Simulator.GetManager();
+				for (UINT32 Round = 0; Round < cRounds; Round++)
+				{
+					for (size_t i = t * ObjectsPerThread; i < (t + 1) * ObjectsPerThread; i++)
+					{
+						Manager.EndTrackingObject(Objects[i]);
+						Manager.BeginTrackingObject(Objects[i]);
+					}
+				}
+			});
+		}
+		for (std::thread& Thread : Threads)
+		{
+			Thread.join();
+		}
+
+		const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+		return double(ObjectsPerThread * NumThreads * cRounds) / Seconds;
+	}
+
+	int RunBenchmark(UINT32 MaxThreads)
+	{
+		static const UINT64 cMB = 1024 * 1024;
+
+		printf("Paging:                     %s, %u LRU shard(s)\n", RESIDENCY_SINGLE_THREADED ? "inline" : "worker thread, lockstep", RESIDENCY_NUM_LRU_SHARDS);
+
+		// Everything fits, so submissions take the fast path. Then a budget of a quarter of the heaps, with the
+		// working set moving every frame and frames long enough that heaps age out (after the library's minimum
+		// grace period of a second) before they come around again, so every submission pages.
+		SubmissionTiming FastPath, PagingPath;
+		if (TimeSubmissions(4096 * cMB, 0, 1.0f / 60.0f, FastPath) == false || TimeSubmissions(512 * cMB, 256, 0.25f, PagingPath) == false)
+		{
+			fprintf(stderr, "Submission benchmark failed\n");
+			return 2;
+		}
+
+		printf("Submit, nothing to page:    %8.0f ns, %.2f allocations\n", FastPath.NanosecondsPerSubmit, FastPath.AllocationsPerSubmit);
+		printf("Submit, paging:             %8.0f ns, %.2f allocations (%llu heaps made resident)\n", PagingPath.NanosecondsPerSubmit,
+			PagingPath.AllocationsPerSubmit, (unsigned long long)PagingPath.NumObjectsMadeResident);
+
+		Config Settings;
+		Settings.LocalBudget = 64 * 1024 * cMB;
+		Settings.RecordLog = false;
+
+		ResidencySimulator Simulator;
+		if (FAILED(Simulator.Initialize(Settings)))
+		{
+			fprintf(stderr, "Failed to initialize the residency simulator\n");
+			return 2;
+		}
+
+		std::vector<ManagedObject*> Objects(MaxThreads * 1024);
+		for (ManagedObject*& pObject : Objects)
+		{
+			pObject = Simulator.GetManagedObject(Simulator.CreateObject(64 * 1024));
+		}
+
+		for (UINT32 NumThreads = 1; NumThreads <= MaxThreads; NumThreads *= 2)
+		{
+			printf("Track/untrack, %2u thread(s): %8.2f M pairs/s\n", NumThreads, TimeTracking(Simulator, Objects, NumThreads) / 1000000.0);
+		}
+
+		// The library creates one sync point per submission; anything beyond that means the submission or its
+		// paging work is allocating again
+		const bool Passed = FastPath.AllocationsPerSubmit <= 1.01 && PagingPath.AllocationsPerSubmit <= 1.01 && PagingPath.NumObjectsMadeResident > 0;
+		printf("bench %s\n", Passed ? "passed" : "FAILED");
+		return Passed ? 0 : 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <trace file> [-log] [-nolockstep]\n", argv[0]);
+		fprintf(stderr, "       %s -stress [threads]\n", argv[0]);
+		fprintf(stderr, "       %s -bench [threads]\n", argv[0]);
+		return 2;
+	}
+
+	if (strcmp(argv[1], "-stress") == 0 || strcmp(argv[1], "-bench") == 0)
+	{
+		const UINT32 NumThreads = argc > 2 ? UINT32(atoi(argv[2])) : DefaultThreadCount();
+		if (NumThreads < 1 || NumThreads > 64)
+		{
+			fprintf(stderr, "Thread count must be between 1 and 64\n");
+			return 2;
+		}
+		return strcmp(argv[1], "-stress") == 0 ? RunStress(NumThreads) : RunBenchmark(NumThreads);
+	}
+
+	std::ifstream File(argv[1]);
+	if (!File)
+	{
+		fprintf(stderr, "Unable to open %s\n", argv[1]);
+		return 2;
+	}
+
+	std::vector<std::string> Lines;
+	std::string Line;
+	while (std::getline(File, Line))
+	{
+		Lines.push_back(Line);
+	}
+
+	bool PrintLog = false;
+	bool LockstepPaging = true;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-log") == 0)
+		{
+			PrintLog = true;
+		}
+		else if (strcmp(argv[i], "-nolockstep") == 0)
+		{
+			LockstepPaging = false;
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	TraceRunner Runner(PrintLog, LockstepPaging);
+	if (Runner.Run(Lines) == false)
+	{
+		return 2;
+	}
+
+	Runner.PrintReport();
+	return Runner.GetNumFailedExpectations() ? 1 : 0;
+}
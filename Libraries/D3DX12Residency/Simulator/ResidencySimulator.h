@@ -0,0 +1,962 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// A headless, deterministic harness for the residency library. The library is driven against a mock device,
+// queue and adapter: the caller scripts budgets, object sizes, per-frame residency sets and how far the GPU lags
+// behind, and every MakeResident/Evict call the library makes is logged along with any CPU stall on a GPU fence.
+//
+// The library's clock is replaced by a virtual one that only advances in EndFrame. Because the clock is global,
+// only one ResidencySimulator should exist at a time.
+//
+// By default the library runs in single threaded mode, so paging work happens inline in ExecuteCommandLists.
+// Define RESIDENCY_SINGLE_THREADED to 0 before including this header to run it on the library's worker thread
+// instead. With Config::LockstepPaging set (the default), each submission then waits for the worker to finish its
+// paging, which gives the same results as single threaded mode; without it the worker runs freely and the
+// simulator only catches up with it at the end of every frame.
+//
+// Objects can be created and destroyed from any number of threads while a single thread submits, which is how
+// ResidencySimulator -stress exercises the library's LRU locking.
+//
+// This header must be included instead of (not after) d3dx12Residency.h.
+
+#pragma once
+
+#include "ResidencyPlatform.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace D3DX12Residency
+{
+	namespace Simulator
+	{
+		static const UINT64 cVirtualTicksPerSecond = 10000000;
+
+		// Read by the paging worker thread, advanced by EndFrame
+		inline std::atomic<UINT64>& VirtualTicks()
+		{
+			static std::atomic<UINT64> s_Ticks(0);
+			return s_Ticks;
+		}
+
+		inline BOOL QueryVirtualCounter(LARGE_INTEGER* pTime)
+		{
+			pTime->QuadPart = LONGLONG(VirtualTicks().load());
+			return TRUE;
+		}
+
+		inline BOOL QueryVirtualFrequency(LARGE_INTEGER* pFrequency)
+		{
+			pFrequency->QuadPart = LONGLONG(cVirtualTicksPerSecond);
+			return TRUE;
+		}
+	}
+}
+
+#ifndef RESIDENCY_SINGLE_THREADED
+#define RESIDENCY_SINGLE_THREADED 1
+#endif
+#define RESIDENCY_QUERY_PERFORMANCE_COUNTER(pTime) D3DX12Residency::Simulator::QueryVirtualCounter(pTime)
+#define RESIDENCY_QUERY_PERFORMANCE_FREQUENCY(pFrequency) D3DX12Residency::Simulator::QueryVirtualFrequency(pFrequency)
+
+#include "../d3dx12Residency.h"
+
+namespace D3DX12Residency
+{
+	namespace Simulator
+	{
+		struct Config
+		{
+			Config() :
+				LocalBudget(512ull * 1024 * 1024),
+				NonLocalBudget(0),
+				GPULatencyFrames(2),
+				FrameTimeSeconds(1.0f / 60.0f),
+				ThrashWindowFrames(8),
+				MaxLatency(6),
+				LockstepPaging(true),
+				RecordLog(true)
+			{
+			}
+
+			UINT64 LocalBudget;
+			UINT64 NonLocalBudget;
+			// Work submitted in frame N is completed by the GPU at the end of frame N + GPULatencyFrames
+			UINT32 GPULatencyFrames;
+			float FrameTimeSeconds;
+			// An object made resident again within this many frames of being evicted counts as thrashing
+			UINT32 ThrashWindowFrames;
+			// Passed straight through to ResidencyManager::Initialize
+			UINT32 MaxLatency;
+			// Only used when the library runs its worker thread; see the top of this file
+			bool LockstepPaging;
+			// Keep every paging event for GetLog(). Benchmarks turn this off so the log doesn't allocate.
+			bool RecordLog;
+		};
+
+		enum class PagingEventType
+		{
+			MAKE_RESIDENT,
+			EVICT,
+			STALL
+		};
+
+		struct PagingEvent
+		{
+			UINT32 Frame;
+			PagingEventType Type;
+			UINT32 NumObjects;
+			UINT64 NumBytes;
+		};
+
+		struct Report
+		{
+			UINT32 NumFrames;
+
+			UINT64 NumMakeResidentCalls;
+			UINT64 NumObjectsMadeResident;
+			UINT64 BytesMadeResident;
+
+			UINT64 NumEvictCalls;
+			UINT64 NumObjectsEvicted;
+			UINT64 BytesEvicted;
+
+			// Objects made resident within Config::ThrashWindowFrames of their eviction
+			UINT64 NumThrashedObjects;
+			UINT64 MaxBytesPagedInFrame;
+			UINT64 PeakUsage;
+			UINT32 NumFramesOverBudget;
+
+			// Times the library had to block the CPU until the (simulated) GPU caught up
+			UINT32 NumStalls;
+			// Waits on fences nothing would ever signal; on real hardware these would hang
+			UINT32 NumDeadlocks;
+
+			double GetThrashRate() const
+			{
+				return NumObjectsMadeResident ? double(NumThrashedObjects) / double(NumObjectsMadeResident) : 0.0;
+			}
+
+			double GetAverageBytesPagedPerFrame() const
+			{
+				return NumFrames ? double(BytesMadeResident + BytesEvicted) / double(NumFrames) : 0.0;
+			}
+		};
+
+		namespace Internal
+		{
+			class MockFence;
+
+			// How long the simulator waits for the paging worker before it counts a deadlock
+			static const UINT32 cPagingTimeoutMilliseconds = 30000;
+
+			// Everything the mocks share: memory accounting, the GPU timeline and the log. Mocks are called from both
+			// the app's threads and the library's worker thread, so all of it is guarded by Mutex.
+			struct SimulationState
+			{
+				// An entry on the GPU timeline: either a fence signal or a wait the GPU can't get past until the fence
+				// reaches the value.
+				struct QueueOperation
+				{
+					MockFence* pFence;
+					UINT64 Value;
+					UINT32 SubmitFrame;
+					bool IsWait;
+				};
+
+				SimulationState() :
+					CurrentFrame(0),
+					CurrentUsage(0),
+					BytesPagedThisFrame(0),
+					GPUTimelineHead(0),
+					pPagingFence(nullptr),
+					PagingFenceValue(0)
+				{
+					ZeroMemory(&Stats, sizeof(Stats));
+				}
+
+				void RecordEvent(PagingEventType Type, UINT32 NumObjects, UINT64 NumBytes)
+				{
+					if (Settings.RecordLog)
+					{
+						PagingEvent Event = { CurrentFrame, Type, NumObjects, NumBytes };
+						Log.push_back(Event);
+					}
+				}
+
+				// The timeline is a vector consumed from GPUTimelineHead rather than a deque, so that once it has grown
+				// to the number of operations in flight, queueing and retiring them never touches the heap. That keeps
+				// the mocks out of the allocation counts in ResidencySimulator -bench.
+				void PushOperation(const QueueOperation& Operation)
+				{
+					if (GPUTimelineHead > 0 && GPUTimeline.size() == GPUTimeline.capacity())
+					{
+						GPUTimeline.erase(GPUTimeline.begin(), GPUTimeline.begin() + GPUTimelineHead);
+						GPUTimelineHead = 0;
+					}
+					GPUTimeline.push_back(Operation);
+				}
+
+				bool IsTimelineEmpty() const { return GPUTimelineHead == GPUTimeline.size(); }
+
+				// Retire queue operations in submission order, as a GPU would. Returns false if the GPU is blocked
+				// on a wait.
+				inline bool RetireNext();
+				inline void CompleteFramesUpTo(UINT32 Frame);
+				inline bool DrainUntil(MockFence* pFence, UINT64 Value);
+
+				// Blocks until the paging fence reaches Value; the caller must hold Lock
+				inline bool WaitForPagingFence(std::unique_lock<std::mutex>& Lock, UINT64 Value);
+
+				std::mutex Mutex;
+				std::condition_variable PagingFenceSignaled;
+
+				Config Settings;
+				UINT32 CurrentFrame;
+				UINT64 CurrentUsage;
+				UINT64 BytesPagedThisFrame;
+				std::vector<QueueOperation> GPUTimeline;
+				size_t GPUTimelineHead;
+				std::vector<PagingEvent> Log;
+				Report Stats;
+
+				// The fence the library signals once paging for a submission is done, and the last value queued on it
+				MockFence* pPagingFence;
+				UINT64 PagingFenceValue;
+			};
+
+			template<class Interface>
+			class MockUnknown : public Interface
+			{
+			public:
+				MockUnknown(SimulationState* pStateIn) : pState(pStateIn), RefCount(1) {}
+				virtual ~MockUnknown() {}
+
+				HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+				{
+					if (riid == Platform::InterfaceId<IUnknown>() || riid == Platform::InterfaceId<Interface>())
+					{
+						AddRef();
+						*ppvObject = static_cast<Interface*>(this);
+						return S_OK;
+					}
+					*ppvObject = nullptr;
+					return E_NOINTERFACE;
+				}
+
+				ULONG STDMETHODCALLTYPE AddRef() override
+				{
+					return ++RefCount;
+				}
+
+				ULONG STDMETHODCALLTYPE Release() override
+				{
+					ULONG NewCount = --RefCount;
+					if (NewCount == 0)
+					{
+						delete this;
+					}
+					return NewCount;
+				}
+
+			protected:
+				SimulationState* pState;
+
+			private:
+				std::atomic<ULONG> RefCount;
+			};
+
+			// Implements the ID3D12Object/ID3D12DeviceChild part of every pageable mock. Private data is kept
+			// because the library stores its per-queue fence on the queue.
+			template<class Interface>
+			class MockDeviceChild : public MockUnknown<Interface>
+			{
+			public:
+				MockDeviceChild(SimulationState* pStateIn) : MockUnknown<Interface>(pStateIn) {}
+
+				HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData) override
+				{
+					for (size_t i = 0; i < PrivateData.size(); i++)
+					{
+						if (PrivateData[i].Guid == guid)
+						{
+							const UINT Size = UINT(PrivateData[i].Data.size());
+							if (pData && *pDataSize < Size)
+							{
+								*pDataSize = Size;
+								return DXGI_ERROR_MORE_DATA;
+							}
+							if (pData)
+							{
+								memcpy(pData, PrivateData[i].Data.data(), Size);
+							}
+							*pDataSize = Size;
+							return S_OK;
+						}
+					}
+					*pDataSize = 0;
+					return DXGI_ERROR_NOT_FOUND;
+				}
+
+				HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT DataSize, const void* pData) override
+				{
+					const BYTE* pBytes = reinterpret_cast<const BYTE*>(pData);
+					for (size_t i = 0; i < PrivateData.size(); i++)
+					{
+						if (PrivateData[i].Guid == guid)
+						{
+							PrivateData[i].Data.assign(pBytes, pBytes + DataSize);
+							return S_OK;
+						}
+					}
+					PrivateDataEntry Entry;
+					Entry.Guid = guid;
+					Entry.Data.assign(pBytes, pBytes + DataSize);
+					PrivateData.push_back(Entry);
+					return S_OK;
+				}
+
+				HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE SetName(LPCWSTR) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE GetDevice(REFIID, void**) override { return E_NOTIMPL; }
+
+			private:
+				struct PrivateDataEntry
+				{
+					GUID Guid;
+					std::vector<BYTE> Data;
+				};
+				std::vector<PrivateDataEntry> PrivateData;
+			};
+
+			// Stands in for a heap or committed resource. D3D12 reference counts residency, so this does too.
+			class MockPageable : public MockDeviceChild<ID3D12Pageable>
+			{
+			public:
+				static const UINT32 cNeverEvicted = UINT32(-1);
+
+				MockPageable(SimulationState* pStateIn, UINT64 SizeIn) :
+					MockDeviceChild<ID3D12Pageable>(pStateIn),
+					Size(SizeIn),
+					ResidencyCount(1),
+					LastEvictedFrame(cNeverEvicted)
+				{
+					// Newly created heaps are resident
+					std::lock_guard<std::mutex> Lock(pState->Mutex);
+					pState->CurrentUsage += Size;
+					pState->Stats.PeakUsage = RESIDENCY_MAX(pState->Stats.PeakUsage, pState->CurrentUsage);
+				}
+
+				~MockPageable()
+				{
+					std::lock_guard<std::mutex> Lock(pState->Mutex);
+					if (ResidencyCount > 0)
+					{
+						pState->CurrentUsage -= Size;
+					}
+				}
+
+				UINT64 Size;
+				UINT32 ResidencyCount;
+				UINT32 LastEvictedFrame;
+			};
+
+			class MockFence : public MockDeviceChild<ID3D12Fence>
+			{
+			public:
+				MockFence(SimulationState* pStateIn, UINT64 InitialValue) :
+					MockDeviceChild<ID3D12Fence>(pStateIn),
+					CompletedValue(InitialValue)
+				{
+				}
+
+				UINT64 STDMETHODCALLTYPE GetCompletedValue() override
+				{
+					std::lock_guard<std::mutex> Lock(pState->Mutex);
+					return CompletedValue;
+				}
+
+				// The library only calls this right before blocking on the event, so a fence that isn't
+				// complete yet is a CPU stall: the simulated GPU is run forward until it gets there.
+				HRESULT STDMETHODCALLTYPE SetEventOnCompletion(UINT64 Value, HANDLE hEvent) override
+				{
+					{
+						std::lock_guard<std::mutex> Lock(pState->Mutex);
+						if (CompletedValue < Value)
+						{
+							pState->Stats.NumStalls++;
+							pState->RecordEvent(PagingEventType::STALL, 0, 0);
+
+							if (pState->DrainUntil(this, Value) == false)
+							{
+								pState->Stats.NumDeadlocks++;
+								CompletedValue = Value;
+							}
+						}
+					}
+					return SetEvent(hEvent) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+				}
+
+				// CPU side signal, used by the library once paging work is done
+				HRESULT STDMETHODCALLTYPE Signal(UINT64 Value) override
+				{
+					std::lock_guard<std::mutex> Lock(pState->Mutex);
+					CompletedValue = Value;
+					pState->PagingFenceSignaled.notify_all();
+					return S_OK;
+				}
+
+				// Guarded by SimulationState::Mutex
+				UINT64 CompletedValue;
+			};
+
+			class MockCommandQueue : public MockDeviceChild<ID3D12CommandQueue>
+			{
+			public:
+				MockCommandQueue(SimulationState* pStateIn) : MockDeviceChild<ID3D12CommandQueue>(pStateIn) {}
+
+				// Command lists carry no work in the simulation, only the fence signals that follow them matter
+				void STDMETHODCALLTYPE ExecuteCommandLists(UINT, ID3D12CommandList* const*) override {}
+
+				HRESULT STDMETHODCALLTYPE Signal(ID3D12Fence* pFence, UINT64 Value) override
+				{
+					std::lock_guard<std::mutex> Lock(pState->Mutex);
+					SimulationState::QueueOperation Operation = { static_cast<MockFence*>(pFence), Value, pState->CurrentFrame, false };
+					pState->PushOperation(Operation);
+
+					if (pState->Settings.GPULatencyFrames == 0)
+					{
+						pState->CompleteFramesUpTo(pState->CurrentFrame);
+					}
+					return S_OK;
+				}
+
+				// The only fence the library makes a queue wait on is the one its paging work signals from the CPU.
+				HRESULT STDMETHODCALLTYPE Wait(ID3D12Fence* pFence, UINT64 Value) override
+				{
+					std::unique_lock<std::mutex> Lock(pState->Mutex);
+					MockFence* pMockFence = static_cast<MockFence*>(pFence);
+					pState->pPagingFence = pMockFence;
+					pState->PagingFenceValue = Value;
+
+#if RESIDENCY_SINGLE_THREADED
+					// Paging is done inline, before the wait is queued, so a wait that isn't satisfied yet could
+					// never be released.
+					if (pMockFence->CompletedValue < Value)
+					{
+						pState->Stats.NumDeadlocks++;
+					}
+#else
+					if (pState->Settings.LockstepPaging)
+					{
+						pState->WaitForPagingFence(Lock, Value);
+					}
+					else if (pMockFence->CompletedValue < Value)
+					{
+						SimulationState::QueueOperation Operation = { pMockFence, Value, pState->CurrentFrame, true };
+						pState->PushOperation(Operation);
+					}
+#endif
+					return S_OK;
+				}
+
+#if RESIDENCY_PLATFORM_WIN32
+				void STDMETHODCALLTYPE UpdateTileMappings(ID3D12Resource*, UINT, const D3D12_TILED_RESOURCE_COORDINATE*, const D3D12_TILE_REGION_SIZE*, ID3D12Heap*, UINT, const D3D12_TILE_RANGE_FLAGS*, const UINT*, const UINT*, D3D12_TILE_MAPPING_FLAGS) override {}
+				void STDMETHODCALLTYPE CopyTileMappings(ID3D12Resource*, const D3D12_TILED_RESOURCE_COORDINATE*, ID3D12Resource*, const D3D12_TILED_RESOURCE_COORDINATE*, const D3D12_TILE_REGION_SIZE*, D3D12_TILE_MAPPING_FLAGS) override {}
+				void STDMETHODCALLTYPE SetMarker(UINT, const void*, UINT) override {}
+				void STDMETHODCALLTYPE BeginEvent(UINT, const void*, UINT) override {}
+				void STDMETHODCALLTYPE EndEvent() override {}
+				HRESULT STDMETHODCALLTYPE GetTimestampFrequency(UINT64*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE GetClockCalibration(UINT64*, UINT64*) override { return E_NOTIMPL; }
+				D3D12_COMMAND_QUEUE_DESC STDMETHODCALLTYPE GetDesc() override { return {}; }
+#endif
+			};
+
+			class MockDevice : public MockUnknown<ID3D12Device>
+			{
+			public:
+				MockDevice(SimulationState* pStateIn) : MockUnknown<ID3D12Device>(pStateIn) {}
+
+				HRESULT STDMETHODCALLTYPE MakeResident(UINT NumObjects, ID3D12Pageable* const* ppObjects) override
+				{
+					if (NumObjects == 0)
+					{
+						return S_OK;
+					}
+
+					std::lock_guard<std::mutex> Lock(pState->Mutex);
+
+					UINT64 NumBytes = 0;
+					for (UINT i = 0; i < NumObjects; i++)
+					{
+						MockPageable* pObject = static_cast<MockPageable*>(ppObjects[i]);
+						if (pObject->ResidencyCount++ == 0)
+						{
+							pState->CurrentUsage += pObject->Size;
+							NumBytes += pObject->Size;
+
+							if (pObject->LastEvictedFrame != MockPageable::cNeverEvicted &&
+								pState->CurrentFrame - pObject->LastEvictedFrame <= pState->Settings.ThrashWindowFrames)
+							{
+								pState->Stats.NumThrashedObjects++;
+							}
+						}
+					}
+
+					pState->Stats.NumMakeResidentCalls++;
+					pState->Stats.NumObjectsMadeResident += NumObjects;
+					pState->Stats.BytesMadeResident += NumBytes;
+					pState->Stats.PeakUsage = RESIDENCY_MAX(pState->Stats.PeakUsage, pState->CurrentUsage);
+					pState->BytesPagedThisFrame += NumBytes;
+					pState->RecordEvent(PagingEventType::MAKE_RESIDENT, NumObjects, NumBytes);
+					return S_OK;
+				}
+
+				HRESULT STDMETHODCALLTYPE Evict(UINT NumObjects, ID3D12Pageable* const* ppObjects) override
+				{
+					if (NumObjects == 0)
+					{
+						return S_OK;
+					}
+
+					std::lock_guard<std::mutex> Lock(pState->Mutex);
+
+					UINT64 NumBytes = 0;
+					for (UINT i = 0; i < NumObjects; i++)
+					{
+						MockPageable* pObject = static_cast<MockPageable*>(ppObjects[i]);
+						if (pObject->ResidencyCount == 0)
+						{
+							// Unbalanced Evict; the runtime would ignore it
+							continue;
+						}
+						if (--pObject->ResidencyCount == 0)
+						{
+							pState->CurrentUsage -= pObject->Size;
+							pObject->LastEvictedFrame = pState->CurrentFrame;
+							NumBytes += pObject->Size;
+						}
+					}
+
+					pState->Stats.NumEvictCalls++;
+					pState->Stats.NumObjectsEvicted += NumObjects;
+					pState->Stats.BytesEvicted += NumBytes;
+					pState->BytesPagedThisFrame += NumBytes;
+					pState->RecordEvent(PagingEventType::EVICT, NumObjects, NumBytes);
+					return S_OK;
+				}
+
+				HRESULT STDMETHODCALLTYPE CreateFence(UINT64 InitialValue, D3D12_FENCE_FLAGS, REFIID riid, void** ppFence) override
+				{
+					MockFence* pFence = new MockFence(pState, InitialValue);
+					HRESULT hr = pFence->QueryInterface(riid, ppFence);
+					pFence->Release();
+					return hr;
+				}
+
+				HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE SetName(LPCWSTR) override { return E_NOTIMPL; }
+
+#if RESIDENCY_PLATFORM_WIN32
+				UINT STDMETHODCALLTYPE GetNodeCount() override { return {}; }
+				HRESULT STDMETHODCALLTYPE CreateCommandQueue(const D3D12_COMMAND_QUEUE_DESC*, REFIID, void**) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE, REFIID, void**) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC*, REFIID, void**) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC*, REFIID, void**) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE CreateCommandList(UINT, D3D12_COMMAND_LIST_TYPE, ID3D12CommandAllocator*, ID3D12PipelineState*, REFIID, void**) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE CheckFeatureSupport(D3D12_FEATURE, void*, UINT) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC*, REFIID, void**) override { return E_NOTIMPL; }
+				UINT STDMETHODCALLTYPE GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE) override { return {}; }
+				HRESULT STDMETHODCALLTYPE CreateRootSignature(UINT, const void*, SIZE_T, REFIID, void**) override { return E_NOTIMPL; }
+				void STDMETHODCALLTYPE CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override {}
+				void STDMETHODCALLTYPE CreateShaderResourceView(ID3D12Resource*, const D3D12_SHADER_RESOURCE_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override {}
+				void STDMETHODCALLTYPE CreateUnorderedAccessView(ID3D12Resource*, ID3D12Resource*, const D3D12_UNORDERED_ACCESS_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override {}
+				void STDMETHODCALLTYPE CreateRenderTargetView(ID3D12Resource*, const D3D12_RENDER_TARGET_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override {}
+				void STDMETHODCALLTYPE CreateDepthStencilView(ID3D12Resource*, const D3D12_DEPTH_STENCIL_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override {}
+				void STDMETHODCALLTYPE CreateSampler(const D3D12_SAMPLER_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override {}
+				void STDMETHODCALLTYPE CopyDescriptors(UINT, const D3D12_CPU_DESCRIPTOR_HANDLE*, const UINT*, UINT, const D3D12_CPU_DESCRIPTOR_HANDLE*, const UINT*, D3D12_DESCRIPTOR_HEAP_TYPE) override {}
+				void STDMETHODCALLTYPE CopyDescriptorsSimple(UINT, D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_DESCRIPTOR_HEAP_TYPE) override {}
+				D3D12_RESOURCE_ALLOCATION_INFO STDMETHODCALLTYPE GetResourceAllocationInfo(UINT, UINT, const D3D12_RESOURCE_DESC*) override { return {}; }
+				D3D12_HEAP_PROPERTIES STDMETHODCALLTYPE GetCustomHeapProperties(UINT, D3D12_HEAP_TYPE) override { return {}; }
+				HRESULT STDMETHODCALLTYPE CreateCommittedResource(const D3D12_HEAP_PROPERTIES*, D3D12_HEAP_FLAGS, const D3D12_RESOURCE_DESC*, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, REFIID, void**) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE CreateHeap(const D3D12_HEAP_DESC*, REFIID, void**) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE CreatePlacedResource(ID3D12Heap*, UINT64, const D3D12_RESOURCE_DESC*, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, REFIID, void**) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE CreateReservedResource(const D3D12_RESOURCE_DESC*, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, REFIID, void**) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE CreateSharedHandle(ID3D12DeviceChild*, const SECURITY_ATTRIBUTES*, DWORD, LPCWSTR, HANDLE*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE OpenSharedHandle(HANDLE, REFIID, void**) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE OpenSharedHandleByName(LPCWSTR, DWORD, HANDLE*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE GetDeviceRemovedReason() override { return E_NOTIMPL; }
+				void STDMETHODCALLTYPE GetCopyableFootprints(const D3D12_RESOURCE_DESC*, UINT, UINT, UINT64, D3D12_PLACED_SUBRESOURCE_FOOTPRINT*, UINT*, UINT64*, UINT64*) override {}
+				HRESULT STDMETHODCALLTYPE CreateQueryHeap(const D3D12_QUERY_HEAP_DESC*, REFIID, void**) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE SetStablePowerState(BOOL) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE CreateCommandSignature(const D3D12_COMMAND_SIGNATURE_DESC*, ID3D12RootSignature*, REFIID, void**) override { return E_NOTIMPL; }
+				void STDMETHODCALLTYPE GetResourceTiling(ID3D12Resource*, UINT*, D3D12_PACKED_MIP_INFO*, D3D12_TILE_SHAPE*, UINT*, UINT, D3D12_SUBRESOURCE_TILING*) override {}
+				LUID STDMETHODCALLTYPE GetAdapterLuid() override { return {}; }
+#endif
+			};
+
+			class MockAdapter : public MockUnknown<IDXGIAdapter3>
+			{
+			public:
+				MockAdapter(SimulationState* pStateIn) : MockUnknown<IDXGIAdapter3>(pStateIn) {}
+
+				// Every simulated object lives in the local segment; non-local only contributes its budget
+				HRESULT STDMETHODCALLTYPE QueryVideoMemoryInfo(UINT, DXGI_MEMORY_SEGMENT_GROUP MemorySegmentGroup, DXGI_QUERY_VIDEO_MEMORY_INFO* pVideoMemoryInfo) override
+				{
+					std::lock_guard<std::mutex> Lock(pState->Mutex);
+					ZeroMemory(pVideoMemoryInfo, sizeof(*pVideoMemoryInfo));
+					if (MemorySegmentGroup == DXGI_MEMORY_SEGMENT_GROUP_LOCAL)
+					{
+						pVideoMemoryInfo->Budget = pState->Settings.LocalBudget;
+						pVideoMemoryInfo->CurrentUsage = pState->CurrentUsage;
+					}
+					else
+					{
+						pVideoMemoryInfo->Budget = pState->Settings.NonLocalBudget;
+					}
+					pVideoMemoryInfo->AvailableForReservation = pVideoMemoryInfo->Budget / 2;
+					return S_OK;
+				}
+
+#if RESIDENCY_PLATFORM_WIN32
+				HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE GetParent(REFIID, void**) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE EnumOutputs(UINT, IDXGIOutput**) override { return DXGI_ERROR_NOT_FOUND; }
+				HRESULT STDMETHODCALLTYPE GetDesc(DXGI_ADAPTER_DESC*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE CheckInterfaceSupport(REFGUID, LARGE_INTEGER*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE GetDesc1(DXGI_ADAPTER_DESC1*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE GetDesc2(DXGI_ADAPTER_DESC2*) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE RegisterHardwareContentProtectionTeardownStatusEvent(HANDLE, DWORD*) override { return E_NOTIMPL; }
+				void STDMETHODCALLTYPE UnregisterHardwareContentProtectionTeardownStatus(DWORD) override {}
+				HRESULT STDMETHODCALLTYPE SetVideoMemoryReservation(UINT, DXGI_MEMORY_SEGMENT_GROUP, UINT64) override { return E_NOTIMPL; }
+				HRESULT STDMETHODCALLTYPE RegisterVideoMemoryBudgetChangeNotificationEvent(HANDLE, DWORD*) override { return E_NOTIMPL; }
+				void STDMETHODCALLTYPE UnregisterVideoMemoryBudgetChangeNotification(DWORD) override {}
+#endif
+			};
+
+			bool SimulationState::RetireNext()
+			{
+				const QueueOperation& Operation = GPUTimeline[GPUTimelineHead];
+				if (Operation.IsWait)
+				{
+					if (Operation.pFence->CompletedValue < Operation.Value)
+					{
+						return false;
+					}
+				}
+				else
+				{
+					Operation.pFence->CompletedValue = RESIDENCY_MAX(Operation.pFence->CompletedValue, Operation.Value);
+				}
+				if (++GPUTimelineHead == GPUTimeline.size())
+				{
+					GPUTimeline.clear();
+					GPUTimelineHead = 0;
+				}
+				return true;
+			}
+
+			void SimulationState::CompleteFramesUpTo(UINT32 Frame)
+			{
+				while (IsTimelineEmpty() == false && GPUTimeline[GPUTimelineHead].SubmitFrame <= Frame && RetireNext())
+				{
+				}
+			}
+
+			bool SimulationState::DrainUntil(MockFence* pFence, UINT64 Value)
+			{
+				while (pFence->CompletedValue < Value && IsTimelineEmpty() == false && RetireNext())
+				{
+				}
+				return pFence->CompletedValue >= Value;
+			}
+
+			bool SimulationState::WaitForPagingFence(std::unique_lock<std::mutex>& Lock, UINT64 Value)
+			{
+				if (pPagingFence == nullptr)
+				{
+					return true;
+				}
+
+				MockFence* pFence = pPagingFence;
+				const bool Signaled = PagingFenceSignaled.wait_for(Lock, std::chrono::milliseconds(cPagingTimeoutMilliseconds),
+					[pFence, Value] { return pFence->CompletedValue >= Value; });
+
+				if (Signaled == false)
+				{
+					Stats.NumDeadlocks++;
+				}
+				return Signaled;
+			}
+		}
+
+		class ResidencySimulator
+		{
+		public:
+			static const UINT32 cInvalidObject = UINT32(-1);
+
+			ResidencySimulator() :
+				pDevice(nullptr),
+				pQueue(nullptr),
+				pAdapter(nullptr),
+				pResidencySet(nullptr)
+			{
+			}
+
+			~ResidencySimulator()
+			{
+				Destroy();
+			}
+
+			HRESULT Initialize(const Config& Settings)
+			{
+				VirtualTicks() = 0;
+				State.Settings = Settings;
+
+				pDevice = new Internal::MockDevice(&State);
+				pQueue = new Internal::MockCommandQueue(&State);
+				pAdapter = new Internal::MockAdapter(&State);
+
+				HRESULT hr = Manager.Initialize(pDevice, 0, pAdapter, Settings.MaxLatency);
+				if (SUCCEEDED(hr))
+				{
+					pResidencySet = Manager.CreateResidencySet();
+					hr = pResidencySet ? S_OK : E_OUTOFMEMORY;
+				}
+				return hr;
+			}
+
+			void Destroy()
+			{
+				if (pDevice == nullptr)
+				{
+					return;
+				}
+
+				WaitForPagingWork();
+
+				for (size_t i = 0; i < Objects.size(); i++)
+				{
+					DestroyObject(UINT32(i));
+				}
+				Objects.clear();
+				FreeIndices.clear();
+
+				Manager.DestroyResidencySet(pResidencySet);
+				Manager.Destroy();
+
+				pAdapter->Release();
+				pQueue->Release();
+				pDevice->Release();
+				pAdapter = nullptr;
+				pQueue = nullptr;
+				pDevice = nullptr;
+				pResidencySet = nullptr;
+			}
+
+			// Budgets can change at any point, e.g. to model another app starting up
+			void SetBudget(UINT64 LocalBudget, UINT64 NonLocalBudget)
+			{
+				std::lock_guard<std::mutex> Lock(State.Mutex);
+				State.Settings.LocalBudget = LocalBudget;
+				State.Settings.NonLocalBudget = NonLocalBudget;
+			}
+
+			// Returns the index used to refer to the object from Submit/DestroyObject. Objects can be created and
+			// destroyed on any thread (as a streaming thread would) while another thread submits.
+			UINT32 CreateObject(UINT64 Size)
+			{
+				SimulatedObject Object;
+				Object.pMock = new Internal::MockPageable(&State, Size);
+				Object.pManaged = new ManagedObject();
+				Object.pManaged->Initialize(Object.pMock, Size);
+				Manager.BeginTrackingObject(Object.pManaged);
+
+				std::lock_guard<std::mutex> Lock(ObjectsMutex);
+				if (FreeIndices.empty() == false)
+				{
+					const UINT32 Index = FreeIndices.back();
+					FreeIndices.pop_back();
+					Objects[Index] = Object;
+					return Index;
+				}
+				Objects.push_back(Object);
+				return UINT32(Objects.size() - 1);
+			}
+
+			// The simulated GPU never touches object memory, so objects are released as soon as they stop being
+			// tracked, even while the library is paging other work.
+			void DestroyObject(UINT32 Index)
+			{
+				SimulatedObject Object;
+				{
+					std::lock_guard<std::mutex> Lock(ObjectsMutex);
+					if (Index >= Objects.size() || Objects[Index].pManaged == nullptr)
+					{
+						return;
+					}
+					Object = Objects[Index];
+					Objects[Index].pManaged = nullptr;
+					Objects[Index].pMock = nullptr;
+					FreeIndices.push_back(Index);
+				}
+
+				Manager.EndTrackingObject(Object.pManaged);
+				delete Object.pManaged;
+				Object.pMock->Release();
+			}
+
+			// Submits one command list that references the given objects. Only one thread may submit.
+			HRESULT Submit(const UINT32* pIndices, UINT32 NumIndices)
+			{
+				HRESULT hr = pResidencySet->Open();
+				if (FAILED(hr))
+				{
+					return hr;
+				}
+
+				{
+					std::lock_guard<std::mutex> Lock(ObjectsMutex);
+					for (UINT32 i = 0; i < NumIndices; i++)
+					{
+						if (pIndices[i] < Objects.size() && Objects[pIndices[i]].pManaged)
+						{
+							pResidencySet->Insert(Objects[pIndices[i]].pManaged);
+						}
+					}
+				}
+
+				hr = pResidencySet->Close();
+				if (FAILED(hr))
+				{
+					return hr;
+				}
+
+				ID3D12CommandList* pCommandList = nullptr;
+				return Manager.ExecuteCommandLists(pQueue, &pCommandList, &pResidencySet, 1);
+			}
+
+			// Blocks until the paging for every submission so far is done. Paging is always done by the time
+			// ExecuteCommandLists returns unless the library runs its worker thread without Config::LockstepPaging.
+			void WaitForPagingWork()
+			{
+				std::unique_lock<std::mutex> Lock(State.Mutex);
+				State.WaitForPagingFence(Lock, State.PagingFenceValue);
+			}
+
+			// Advances the virtual clock by one frame and lets the GPU retire everything it has caught up with
+			void EndFrame()
+			{
+				WaitForPagingWork();
+
+				std::lock_guard<std::mutex> Lock(State.Mutex);
+				if (State.CurrentUsage > State.Settings.LocalBudget)
+				{
+					State.Stats.NumFramesOverBudget++;
+				}
+				State.Stats.MaxBytesPagedInFrame = RESIDENCY_MAX(State.Stats.MaxBytesPagedInFrame, State.BytesPagedThisFrame);
+				State.BytesPagedThisFrame = 0;
+				State.Stats.NumFrames++;
+
+				if (State.CurrentFrame >= State.Settings.GPULatencyFrames)
+				{
+					State.CompleteFramesUpTo(State.CurrentFrame - State.Settings.GPULatencyFrames);
+				}
+
+				State.CurrentFrame++;
+				VirtualTicks() += UINT64(double(State.Settings.FrameTimeSeconds) * double(cVirtualTicksPerSecond));
+			}
+
+			// The report and log only change while paging work is outstanding, so these wait for it first
+			const Report& GetReport()
+			{
+				WaitForPagingWork();
+				return State.Stats;
+			}
+
+			const std::vector<PagingEvent>& GetLog()
+			{
+				WaitForPagingWork();
+				return State.Log;
+			}
+
+			UINT64 GetCurrentUsage()
+			{
+				std::lock_guard<std::mutex> Lock(State.Mutex);
+				return State.CurrentUsage;
+			}
+
+			UINT32 GetCurrentFrame() const { return State.CurrentFrame; }
+
+			// For tests that drive the manager directly, e.g. to track and untrack objects from several threads.
+			// The returned object is valid until DestroyObject, and must be tracked again by then.
+			ResidencyManager& GetManager() { return Manager; }
+
+			ManagedObject* GetManagedObject(UINT32 Index)
+			{
+				std::lock_guard<std::mutex> Lock(ObjectsMutex);
+				return Index < Objects.size() ? Objects[Index].pManaged : nullptr;
+			}
+
+			// Compares the library's idea of which objects are resident with the mock device's residency counts, once
+			// all outstanding paging work is done. Returns the number of live objects they disagree on, counting any
+			// object made resident more than once. Nothing may be submitted or tracked meanwhile.
+			UINT32 CountInconsistentObjects()
+			{
+				WaitForPagingWork();
+
+				std::lock_guard<std::mutex> ObjectsLock(ObjectsMutex);
+				std::lock_guard<std::mutex> Lock(State.Mutex);
+
+				UINT32 Count = 0;
+				for (size_t i = 0; i < Objects.size(); i++)
+				{
+					if (Objects[i].pManaged)
+					{
+						const bool Resident = Objects[i].pManaged->ResidencyStatus == ManagedObject::RESIDENCY_STATUS::RESIDENT;
+						if (Objects[i].pMock->ResidencyCount > 1 || Resident != (Objects[i].pMock->ResidencyCount == 1))
+						{
+							Count++;
+						}
+					}
+				}
+				return Count;
+			}
+
+		private:
+			struct SimulatedObject
+			{
+				Internal::MockPageable* pMock;
+				ManagedObject* pManaged;
+			};
+
+			Internal::SimulationState State;
+			Internal::MockDevice* pDevice;
+			Internal::MockCommandQueue* pQueue;
+			Internal::MockAdapter* pAdapter;
+
+			ResidencyManager Manager;
+			ResidencySet* pResidencySet;
+
+			// Lets objects be created and destroyed while another thread submits
+			std::mutex ObjectsMutex;
+			std::vector<SimulatedObject> Objects;
+			std::vector<UINT32> FreeIndices;
+		};
+	}
+}
@@ -25,7 +25,19 @@ namespace D3DX12Residency
 #define RESIDENCY_CHECK_RESULT(x) x
 #endif
 
+#ifndef RESIDENCY_SINGLE_THREADED
 #define RESIDENCY_SINGLE_THREADED 0
+#endif
+
+	// The time source used for eviction grace periods. These can be overridden before including this header
+	// (e.g. by the residency simulator) to drive the library from a virtual clock.
+#ifndef RESIDENCY_QUERY_PERFORMANCE_COUNTER
+#define RESIDENCY_QUERY_PERFORMANCE_COUNTER(pTime) QueryPerformanceCounter(pTime)
+#endif
+
+#ifndef RESIDENCY_QUERY_PERFORMANCE_FREQUENCY
+#define RESIDENCY_QUERY_PERFORMANCE_FREQUENCY(pFrequency) QueryPerformanceFrequency(pFrequency)
+#endif
 
 #define RESIDENCY_MIN(x,y) ((x) < (y) ? (x) : (y))
 #define RESIDENCY_MAX(x,y) ((x) > (y) ? (x) : (y))
@@ -33,11 +45,18 @@ namespace D3DX12Residency
 	// This size can be tuned to your app in order to save space
 #define MAX_NUM_CONCURRENT_CMD_LISTS 32
 
+	// The LRU is split into this many independently locked shards (keyed by the underlying heap) so that
+	// tracking objects from loading threads doesn't serialize against the paging thread
+#ifndef RESIDENCY_NUM_LRU_SHARDS
+#define RESIDENCY_NUM_LRU_SHARDS 8
+#endif
+
 	namespace Internal
 	{
 		class CriticalSection
 		{
 			friend class ScopedLock;
+			friend class ScopedLockAllShards;
 		public:
 			CriticalSection()
 			{
@@ -169,7 +188,8 @@ namespace D3DX12Residency
 			ppSet(nullptr),
 			IsOpen(false),
 			OutOfMemory(false),
-			pSyncManager(nullptr)
+			pSyncManager(nullptr),
+			pNextFree(nullptr)
 		{
 		};
 
@@ -304,6 +324,21 @@ namespace D3DX12Residency
 			return ppSet != nullptr;
 		}
 
+		// Grow to hold at least MaxSize objects without preserving the contents. Used when recycling a set.
+		bool Reserve(UINT32 MaxSize)
+		{
+			if (ppSet != nullptr && INT32(MaxSize) <= MaxResidencySetSize)
+			{
+				return true;
+			}
+
+			delete[](ppSet);
+			MaxResidencySetSize = RESIDENCY_MAX(INT32(MaxSize), MaxResidencySetSize + MaxResidencySetSize / 2);
+			ppSet = new ManagedObject*[MaxResidencySetSize];
+
+			return ppSet != nullptr;
+		}
+
 		inline void Realloc()
 		{
 			MaxResidencySetSize = (MaxResidencySetSize == 0) ? 4096 : INT32(MaxResidencySetSize + (MaxResidencySetSize / 2.0f));
@@ -328,10 +363,51 @@ namespace D3DX12Residency
 		bool OutOfMemory;
 
 		Internal::SyncManager* pSyncManager;
+
+		// Link for the residency manager's pool of recycled master sets
+		ResidencySet* pNextFree;
 	};
 
 	namespace Internal
 	{
+		// A grow-only array that keeps its allocation between uses
+		template<typename T>
+		class ScratchArray
+		{
+		public:
+			ScratchArray() : pData(nullptr), Capacity(0) {};
+
+			~ScratchArray()
+			{
+				delete[](pData);
+			}
+
+			bool Reserve(UINT32 Count)
+			{
+				if (Count <= Capacity && pData != nullptr)
+				{
+					return true;
+				}
+
+				delete[](pData);
+				Capacity = RESIDENCY_MAX(Count, Capacity + Capacity / 2);
+				pData = new T[RESIDENCY_MAX(Capacity, 1u)];
+
+				if (pData == nullptr)
+				{
+					Capacity = 0;
+				}
+				return pData != nullptr;
+			}
+
+			inline T* Get() { return pData; }
+			inline T& operator[](UINT32 Index) { return pData[Index]; }
+
+		private:
+			T* pData;
+			UINT32 Capacity;
+		};
+
 		/* List Helpers */
 		inline void InitializeListHead(LIST_ENTRY* pHead)
 		{
@@ -466,6 +542,13 @@ namespace D3DX12Residency
 				return pSyncPoint;
 			}
 
+			// Sync points are allocated as raw bytes, so they have to be freed the same way
+			static void DestroySyncPoint(DeviceWideSyncPoint* pSyncPoint)
+			{
+				pSyncPoint->~DeviceWideSyncPoint();
+				delete[](reinterpret_cast<BYTE*>(pSyncPoint));
+			}
+
 			// A device wide fence is completed if all of the queues that were active at that point are completed
 			inline bool IsCompleted()
 			{
@@ -643,6 +726,135 @@ namespace D3DX12Residency
 			UINT64 ResidentSize;
 		};
 
+		// An LRU split into shards keyed by the underlying heap. Each shard is kept in reference order, so the
+		// globally least recently used object is always at the head of one of the shards and the trimming policy
+		// is the same as with a single list.
+		//
+		// Single objects are updated under their own shard's lock. Anything that walks or trims across shards
+		// must hold every shard lock (see ScopedLockAllShards).
+		class ShardedLRUCache
+		{
+		public:
+			static const UINT32 NumShards = RESIDENCY_NUM_LRU_SHARDS;
+
+			inline UINT32 GetShardIndex(ManagedObject* pObject)
+			{
+				// Heaps are at least 64KB aligned in practice, so mix the upper bits down
+				UINT64 Key = UINT64(pObject->pUnderlying);
+				Key ^= Key >> 17;
+				Key ^= Key >> 31;
+				return UINT32(Key % NumShards);
+			}
+
+			inline LRUCache& GetShard(ManagedObject* pObject) { return Shards[GetShardIndex(pObject)]; }
+			inline CriticalSection* GetShardLock(ManagedObject* pObject) { return &ShardLocks[GetShardIndex(pObject)]; }
+
+			// The following require all shard locks
+
+			UINT32 GetNumResidentObjects()
+			{
+				UINT32 Count = 0;
+				for (UINT32 i = 0; i < NumShards; i++)
+				{
+					Count += Shards[i].NumResidentObjects;
+				}
+				return Count;
+			}
+
+			ManagedObject* GetResidentListHead()
+			{
+				ManagedObject* pOldest = nullptr;
+				for (UINT32 i = 0; i < NumShards; i++)
+				{
+					ManagedObject* pHead = Shards[i].GetResidentListHead();
+					if (pHead && (pOldest == nullptr || IsOlder(pHead, pOldest)))
+					{
+						pOldest = pHead;
+					}
+				}
+				return pOldest;
+			}
+
+			// Same policy as LRUCache::TrimToSyncPointInclusive, applied to the oldest object across all shards
+			void TrimToSyncPointInclusive(INT64 CurrentUsage, INT64 CurrentBudget, ID3D12Pageable** EvictionList, UINT32& NumObjectsToEvict, UINT64 SyncPoint)
+			{
+				NumObjectsToEvict = 0;
+
+				ManagedObject* pObject = GetResidentListHead();
+				while (pObject)
+				{
+					if (pObject->LastGPUSyncPoint > SyncPoint || CurrentUsage < CurrentBudget)
+					{
+						break;
+					}
+
+					EvictionList[NumObjectsToEvict++] = pObject->pUnderlying;
+					GetShard(pObject).Evict(pObject);
+
+					CurrentUsage -= pObject->Size;
+
+					pObject = GetResidentListHead();
+				}
+			}
+
+			// Same policy as LRUCache::TrimAgedAllocations, applied to the oldest object across all shards
+			void TrimAgedAllocations(DeviceWideSyncPoint* MaxSyncPoint, ID3D12Pageable** EvictionList, UINT32& NumObjectsToEvict, UINT64 CurrentTimeStamp, UINT64 MinDelta)
+			{
+				ManagedObject* pObject = GetResidentListHead();
+				while (pObject)
+				{
+					if ((MaxSyncPoint && pObject->LastGPUSyncPoint >= MaxSyncPoint->GenerationID) ||
+						CurrentTimeStamp - pObject->LastUsedTimestamp <= MinDelta)
+					{
+						break;
+					}
+
+					EvictionList[NumObjectsToEvict++] = pObject->pUnderlying;
+					GetShard(pObject).Evict(pObject);
+
+					pObject = GetResidentListHead();
+				}
+			}
+
+			LRUCache Shards[NumShards];
+			CriticalSection ShardLocks[NumShards];
+
+		private:
+			// Objects that have never been referenced sit at the head of their shard with a zero timestamp
+			static inline bool IsOlder(ManagedObject* pA, ManagedObject* pB)
+			{
+				if (pA->LastUsedTimestamp != pB->LastUsedTimestamp)
+				{
+					return pA->LastUsedTimestamp < pB->LastUsedTimestamp;
+				}
+				return pA->LastGPUSyncPoint < pB->LastGPUSyncPoint;
+			}
+		};
+
+		class ScopedLockAllShards
+		{
+		public:
+			ScopedLockAllShards(ShardedLRUCache* pLRUIn) : pLRU(pLRUIn)
+			{
+				// Always in the same order so that this can't deadlock against itself
+				for (UINT32 i = 0; i < ShardedLRUCache::NumShards; i++)
+				{
+					EnterCriticalSection(&pLRU->ShardLocks[i].CS);
+				}
+			}
+
+			~ScopedLockAllShards()
+			{
+				for (UINT32 i = ShardedLRUCache::NumShards; i > 0; i--)
+				{
+					LeaveCriticalSection(&pLRU->ShardLocks[i - 1].CS);
+				}
+			}
+
+		private:
+			ShardedLRUCache* pLRU;
+		};
+
 		class ResidencyManagerInternal
 		{
 		public:
@@ -667,6 +879,9 @@ namespace D3DX12Residency
 				AsyncWorkQueue(nullptr),
 				MaxSoftwareQueueLatency(6),
 				AsyncWorkQueueSize(7),
+				LastAgedTrimTimestamp(0),
+				AgedTrimIntervalTicks(0),
+				pFreeMasterSets(nullptr),
 				pSyncManager(pSyncManagerIn)
 			{
 				Internal::InitializeListHead(&QueueFencesListHead);
@@ -692,12 +907,15 @@ namespace D3DX12Residency
 				}
 
 				LARGE_INTEGER Frequency;
-				QueryPerformanceFrequency(&Frequency);
+				RESIDENCY_QUERY_PERFORMANCE_FREQUENCY(&Frequency);
 
 				// Calculate how many QPC ticks are equivalent to the given time in seconds
 				MinEvictionGracePeriodTicks = UINT64(Frequency.QuadPart * cMinEvictionGracePeriod);
 				MaxEvictionGracePeriodTicks = UINT64(Frequency.QuadPart * cMaxEvictionGracePeriod);
 
+				// Nothing can age out faster than the minimum grace period, so checking a few times within it is plenty
+				AgedTrimIntervalTicks = MinEvictionGracePeriodTicks / 10;
+
 				HRESULT hr = S_OK;
 				hr = AsyncThreadFence.Initialize(Device);
 
@@ -775,13 +993,14 @@ namespace D3DX12Residency
 					CloseHandle(AsyncWorkThread);
 					AsyncWorkThread = INVALID_HANDLE_VALUE;
 				}
+#endif
 
+				// Created in single threaded mode too
 				if (AsyncWorkEvent != INVALID_HANDLE_VALUE)
 				{
 					CloseHandle(AsyncWorkEvent);
 					AsyncWorkEvent = INVALID_HANDLE_VALUE;
 				}
-#endif
 
 				if (AsyncThreadWorkCompletionEvent != INVALID_HANDLE_VALUE)
 				{
@@ -789,6 +1008,25 @@ namespace D3DX12Residency
 					AsyncThreadWorkCompletionEvent = INVALID_HANDLE_VALUE;
 				}
 
+				while (pFreeMasterSets)
+				{
+					ResidencySet* pSet = pFreeMasterSets;
+					pFreeMasterSets = pSet->pNextFree;
+					delete(pSet);
+				}
+
+				while (Internal::IsListEmpty(&InFlightSyncPointsHead) == false)
+				{
+					Internal::DeviceWideSyncPoint* pPoint =
+						CONTAINING_RECORD(InFlightSyncPointsHead.Flink, Internal::DeviceWideSyncPoint, ListEntry);
+
+					Internal::RemoveHeadList(&InFlightSyncPointsHead);
+					Internal::DeviceWideSyncPoint::DestroySyncPoint(pPoint);
+				}
+
+				delete[](AsyncWorkQueue);
+				AsyncWorkQueue = nullptr;
+
 				while (Internal::IsListEmpty(&QueueFencesListHead) == false)
 				{
 					Internal::Fence* pObject =
@@ -802,26 +1040,27 @@ namespace D3DX12Residency
 
 			void BeginTrackingObject(ManagedObject* pObject)
 			{
-				Internal::ScopedLock Lock(&Mutex);
-
 				if (pObject)
 				{
 					RESIDENCY_CHECK(pObject->pUnderlying != nullptr);
+
+					Internal::ScopedLock Lock(LRU.GetShardLock(pObject));
+
 					if (cStartEvicted)
 					{
 						pObject->ResidencyStatus = ManagedObject::RESIDENCY_STATUS::EVICTED;
 						RESIDENCY_CHECK_RESULT(Device->Evict(1, &pObject->pUnderlying));
 					}
 
-					LRU.Insert(pObject);
+					LRU.GetShard(pObject).Insert(pObject);
 				}
 			}
 
 			void EndTrackingObject(ManagedObject* pObject)
 			{
-				Internal::ScopedLock Lock(&Mutex);
+				Internal::ScopedLock Lock(LRU.GetShardLock(pObject));
 
-				LRU.Remove(pObject);
+				LRU.GetShard(pObject).Remove(pObject);
 			}
 
 			// One residency set per command-list
@@ -910,14 +1149,6 @@ namespace D3DX12Residency
 			{
 				HRESULT hr = S_OK;
 
-				DXGI_QUERY_VIDEO_MEMORY_INFO LocalMemory;
-				ZeroMemory(&LocalMemory, sizeof(LocalMemory));
-				GetCurrentBudget(&LocalMemory, DXGI_MEMORY_SEGMENT_GROUP_LOCAL);
-
-				DXGI_QUERY_VIDEO_MEMORY_INFO NonLocalMemory;
-				ZeroMemory(&NonLocalMemory, sizeof(NonLocalMemory));
-				GetCurrentBudget(&NonLocalMemory, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL);
-
 				UINT64 TotalSizeNeeded = 0;
 
 				UINT32 MaxObjectsReferenced = 0;
@@ -934,9 +1165,9 @@ namespace D3DX12Residency
 					}
 				}
 
-				// Create a set to gather up all unique resources required by this call
-				ResidencySet* pMasterSet = new ResidencySet();
-				if (pMasterSet == nullptr || pMasterSet->Initialize(pSyncManager, MaxObjectsReferenced) == false)
+				// Get a set to gather up all unique resources required by this call
+				ResidencySet* pMasterSet = AcquireMasterSet(MaxObjectsReferenced);
+				if (pMasterSet == nullptr)
 				{
 					return E_OUTOFMEMORY;
 				}
@@ -944,6 +1175,7 @@ namespace D3DX12Residency
 				hr = pMasterSet->Open();
 				if (FAILED(hr))
 				{
+					ReleaseMasterSet(pMasterSet);
 					return hr;
 				}
 
@@ -966,14 +1198,29 @@ namespace D3DX12Residency
 				hr = pMasterSet->Close();
 				if (FAILED(hr))
 				{
+					ReleaseMasterSet(pMasterSet);
 					return hr;
 				}
 
 				// This set of commandlists can't possibly fit within the budget, they need to be split up. If the number of command lists is 1 there is
-				// nothing we can do
-				if (Count > 1 && TotalSizeNeeded > LocalMemory.Budget + NonLocalMemory.Budget)
+				// nothing we can do, so don't bother querying the budget.
+				bool ExceedsBudget = false;
+				if (Count > 1)
 				{
-					delete(pMasterSet);
+					DXGI_QUERY_VIDEO_MEMORY_INFO LocalMemory;
+					ZeroMemory(&LocalMemory, sizeof(LocalMemory));
+					GetCurrentBudget(&LocalMemory, DXGI_MEMORY_SEGMENT_GROUP_LOCAL);
+
+					DXGI_QUERY_VIDEO_MEMORY_INFO NonLocalMemory;
+					ZeroMemory(&NonLocalMemory, sizeof(NonLocalMemory));
+					GetCurrentBudget(&NonLocalMemory, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL);
+
+					ExceedsBudget = TotalSizeNeeded > LocalMemory.Budget + NonLocalMemory.Budget;
+				}
+
+				if (ExceedsBudget)
+				{
+					ReleaseMasterSet(pMasterSet);
 
 					// Recursively try to find a small enough set to fit in memory
 					const UINT32 Half = Count / 2;
@@ -1084,98 +1331,117 @@ namespace D3DX12Residency
 
 			// This will be run from a worker thread and will emulate a software queue for making gpu resources resident or evicted.
 			// The GPU will be synchronized by this queue to ensure that it never executes using an evicted resource.
+			//
+			// Paging work is serialized (one worker thread, or under ExecutionCS in single threaded mode), so the scratch lists
+			// are owned by the manager and reused for every submission on every queue.
 			void ProcessPagingWork(AsyncWorkload* pWork)
 			{
 				Internal::DeviceWideSyncPoint* FirstUncompletedSyncPoint = DequeueCompletedSyncPoints();
 
-				// Use a union so that we only need 1 allocation
-				union ResidentScratchSpace
-				{
-					ManagedObject* pManagedObject;
-					ID3D12Pageable* pUnderlying;
-				};
-
-				ResidentScratchSpace* pMakeResidentList = nullptr;
 				UINT32 NumObjectsToMakeResident = 0;
-
-				ID3D12Pageable** pEvictionList = nullptr;
 				UINT32 NumObjectsToEvict = 0;
 
 				// the size of all the objects which will need to be made resident in order to execute this set.
 				UINT64 SizeToMakeResident = 0;
 
 				LARGE_INTEGER CurrentTime;
-				QueryPerformanceCounter(&CurrentTime);
+				RESIDENCY_QUERY_PERFORMANCE_COUNTER(&CurrentTime);
+
+				if (MakeResidentScratch.Reserve(pWork->pMasterSet->CurrentSetSize) == false)
+				{
+					RESIDENCY_CHECK(false);
+				}
 
+				// Mark the objects used by this command list to be made resident. Each object only needs its own shard locked.
+				for (INT32 i = 0; i < pWork->pMasterSet->CurrentSetSize; i++)
 				{
-					// A lock must be taken here as the state of the objects will be altered
-					Internal::ScopedLock Lock(&Mutex);
+					ManagedObject* pObject = pWork->pMasterSet->ppSet[i];
 
-					pMakeResidentList = new ResidentScratchSpace[pWork->pMasterSet->CurrentSetSize];
-					pEvictionList = new ID3D12Pageable*[LRU.NumResidentObjects];
+					Internal::ScopedLock Lock(LRU.GetShardLock(pObject));
+					Internal::LRUCache& Shard = LRU.GetShard(pObject);
 
-					// Mark the objects used by this command list to be made resident
-					for (INT32 i = 0; i < pWork->pMasterSet->CurrentSetSize; i++)
+					// If it's evicted we need to make it resident again
+					if (pObject->ResidencyStatus == ManagedObject::RESIDENCY_STATUS::EVICTED)
 					{
-						ManagedObject*& pObject = pWork->pMasterSet->ppSet[i];
-						// If it's evicted we need to make it resident again
-						if (pObject->ResidencyStatus == ManagedObject::RESIDENCY_STATUS::EVICTED)
-						{
-							pMakeResidentList[NumObjectsToMakeResident++].pManagedObject = pObject;
-							LRU.MakeResident(pObject);
+						MakeResidentScratch[NumObjectsToMakeResident++].pManagedObject = pObject;
+						Shard.MakeResident(pObject);
 
-							SizeToMakeResident += pObject->Size;
-						}
+						SizeToMakeResident += pObject->Size;
+					}
 
-						// Update the last sync point that this was used on
-						pObject->LastGPUSyncPoint = pWork->SyncPointGeneration;
+					// Update the last sync point that this was used on
+					pObject->LastGPUSyncPoint = pWork->SyncPointGeneration;
 
-						pObject->LastUsedTimestamp = CurrentTime.QuadPart;
-						LRU.ObjectReferenced(pObject);
-					}
+					pObject->LastUsedTimestamp = CurrentTime.QuadPart;
+					Shard.ObjectReferenced(pObject);
+				}
 
-					DXGI_QUERY_VIDEO_MEMORY_INFO LocalMemory;
-					ZeroMemory(&LocalMemory, sizeof(LocalMemory));
-					GetCurrentBudget(&LocalMemory, DXGI_MEMORY_SEGMENT_GROUP_LOCAL);
+				// Fast path: nothing in this submission changed residency and the aged trim has run recently, so there is
+				// no reason to query the budget or look at the rest of the LRU.
+				const bool TrimCheckDue = UINT64(CurrentTime.QuadPart) - LastAgedTrimTimestamp >= AgedTrimIntervalTicks;
+				if (NumObjectsToMakeResident == 0 && TrimCheckDue == false)
+				{
+					SignalPagingWorkComplete(pWork);
+					return;
+				}
+
+				DXGI_QUERY_VIDEO_MEMORY_INFO LocalMemory;
+				ZeroMemory(&LocalMemory, sizeof(LocalMemory));
+				GetCurrentBudget(&LocalMemory, DXGI_MEMORY_SEGMENT_GROUP_LOCAL);
+
+				{
+					// Evict under the shard locks so that an object can't stop being tracked (and be released) mid-call
+					Internal::ScopedLockAllShards Lock(&LRU);
+
+					if (EvictionScratch.Reserve(LRU.GetNumResidentObjects()) == false)
+					{
+						RESIDENCY_CHECK(false);
+					}
 
 					UINT64 EvictionGracePeriod = GetCurrentEvictionGracePeriod(&LocalMemory);
-					LRU.TrimAgedAllocations(FirstUncompletedSyncPoint, pEvictionList, NumObjectsToEvict, CurrentTime.QuadPart, EvictionGracePeriod);
+					LRU.TrimAgedAllocations(FirstUncompletedSyncPoint, EvictionScratch.Get(), NumObjectsToEvict, CurrentTime.QuadPart, EvictionGracePeriod);
+					LastAgedTrimTimestamp = CurrentTime.QuadPart;
 
 					if (NumObjectsToEvict)
 					{
-						RESIDENCY_CHECK_RESULT(Device->Evict(NumObjectsToEvict, pEvictionList));
+						RESIDENCY_CHECK_RESULT(Device->Evict(NumObjectsToEvict, EvictionScratch.Get()));
 						NumObjectsToEvict = 0;
 					}
+				}
 
-					if (NumObjectsToMakeResident)
+				if (NumObjectsToMakeResident)
+				{
+					// Sizes and underlying heaps are read under the shard locks, like everything else in the LRU. MakeResident
+					// itself runs unlocked: the objects are referenced by this submission, so the app must keep them alive.
+					UINT32 ObjectsMadeResident = 0;
+					UINT32 MakeResidentIndex = 0;
+					while (true)
 					{
-						UINT32 ObjectsMadeResident = 0;
-						UINT32 MakeResidentIndex = 0;
-						while (true)
-						{
-							ZeroMemory(&LocalMemory, sizeof(LocalMemory));
+						ZeroMemory(&LocalMemory, sizeof(LocalMemory));
 
-							GetCurrentBudget(&LocalMemory, DXGI_MEMORY_SEGMENT_GROUP_LOCAL);
-							DXGI_QUERY_VIDEO_MEMORY_INFO NonLocalMemory;
-							ZeroMemory(&NonLocalMemory, sizeof(NonLocalMemory));
-							GetCurrentBudget(&NonLocalMemory, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL);
+						GetCurrentBudget(&LocalMemory, DXGI_MEMORY_SEGMENT_GROUP_LOCAL);
+						DXGI_QUERY_VIDEO_MEMORY_INFO NonLocalMemory;
+						ZeroMemory(&NonLocalMemory, sizeof(NonLocalMemory));
+						GetCurrentBudget(&NonLocalMemory, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL);
 
-							INT64 TotalUsage = LocalMemory.CurrentUsage + NonLocalMemory.CurrentUsage;
-							INT64 TotalBudget = LocalMemory.Budget + NonLocalMemory.Budget;
+						INT64 TotalUsage = LocalMemory.CurrentUsage + NonLocalMemory.CurrentUsage;
+						INT64 TotalBudget = LocalMemory.Budget + NonLocalMemory.Budget;
 
-							INT64 AvailableSpace = TotalBudget - TotalUsage;
+						INT64 AvailableSpace = TotalBudget - TotalUsage;
 
-							UINT64 BatchSize = 0;
-							UINT32 NumObjectsInBatch = 0;
-							UINT32 BatchStart = MakeResidentIndex;
+						UINT64 BatchSize = 0;
+						UINT32 NumObjectsInBatch = 0;
+						UINT32 BatchStart = MakeResidentIndex;
 
-							HRESULT hr = S_OK;
-							if (AvailableSpace > 0)
+						HRESULT hr = S_OK;
+						if (AvailableSpace > 0)
+						{
 							{
+								Internal::ScopedLockAllShards Lock(&LRU);
 								for (UINT32 i = MakeResidentIndex; i < NumObjectsToMakeResident; i++)
 								{
 									// If we try to make this object resident, will we go over budget?
-									if (BatchSize + pMakeResidentList[i].pManagedObject->Size > UINT64(AvailableSpace))
+									if (BatchSize + MakeResidentScratch[i].pManagedObject->Size > UINT64(AvailableSpace))
 									{
 										// Next time we will start here
 										MakeResidentIndex = i;
@@ -1183,85 +1449,158 @@ namespace D3DX12Residency
 									}
 									else
 									{
-										BatchSize += pMakeResidentList[i].pManagedObject->Size;
+										BatchSize += MakeResidentScratch[i].pManagedObject->Size;
 										NumObjectsInBatch++;
 										ObjectsMadeResident++;
 
-										pMakeResidentList[i].pUnderlying = pMakeResidentList[i].pManagedObject->pUnderlying;
+										MakeResidentScratch[i].pUnderlying = MakeResidentScratch[i].pManagedObject->pUnderlying;
 									}
 								}
+							}
 
-								hr = Device->MakeResident(NumObjectsInBatch, &pMakeResidentList[BatchStart].pUnderlying);
-								if (SUCCEEDED(hr))
-								{
-									SizeToMakeResident -= BatchSize;
-								}
+							hr = Device->MakeResident(NumObjectsInBatch, &MakeResidentScratch[BatchStart].pUnderlying);
+							if (SUCCEEDED(hr))
+							{
+								SizeToMakeResident -= BatchSize;
 							}
+						}
 
-							if (FAILED(hr) || ObjectsMadeResident != NumObjectsToMakeResident)
+						if (FAILED(hr) || ObjectsMadeResident != NumObjectsToMakeResident)
+						{
+							// If there is nothing to trim OR the only objects 'Resident' are the ones about to be used by this execute.
+							// The head is only looked at under the locks, as once they are released it can stop being tracked and
+							// be released.
+							bool NothingToTrim = false;
 							{
+								Internal::ScopedLockAllShards Lock(&LRU);
 								ManagedObject* pResidentHead = LRU.GetResidentListHead();
+								NothingToTrim = pResidentHead == nullptr || pResidentHead->LastGPUSyncPoint >= pWork->SyncPointGeneration;
+							}
 
-								// Get the next sync point to wait for
-								FirstUncompletedSyncPoint = DequeueCompletedSyncPoints();
+							// Get the next sync point to wait for
+							FirstUncompletedSyncPoint = DequeueCompletedSyncPoints();
 
-								// If there is nothing to trim OR the only objects 'Resident' are the ones about to be used by this execute.
-								if (pResidentHead == nullptr ||
-									pResidentHead->LastGPUSyncPoint >= pWork->SyncPointGeneration ||
-									FirstUncompletedSyncPoint == nullptr)
-								{
-									// Make resident the rest of the objects as there is nothing left to trim
-									UINT32 NumObjects = NumObjectsToMakeResident - ObjectsMadeResident;
+							if (NothingToTrim || FirstUncompletedSyncPoint == nullptr)
+							{
+								// Make resident the rest of the objects as there is nothing left to trim
+								UINT32 NumObjects = NumObjectsToMakeResident - ObjectsMadeResident;
 
-									// Gather up the remaining underlying objects
+								// Gather up the remaining underlying objects
+								{
+									Internal::ScopedLockAllShards Lock(&LRU);
 									for (UINT32 i = MakeResidentIndex; i < NumObjectsToMakeResident; i++)
 									{
-										pMakeResidentList[i].pUnderlying = pMakeResidentList[i].pManagedObject->pUnderlying;
-									}
-
-									hr = Device->MakeResident(NumObjects, &pMakeResidentList[MakeResidentIndex].pUnderlying);
-									if (FAILED(hr))
-									{
-										// TODO: What should we do if this fails? This is a catastrophic failure in which the app is trying to use more memory
-										//       in 1 command list than can possibly be made resident by the system.
-										RESIDENCY_CHECK_RESULT(hr);
+										MakeResidentScratch[i].pUnderlying = MakeResidentScratch[i].pManagedObject->pUnderlying;
 									}
-									break;
 								}
 
-								UINT64 GenerationToWaitFor = FirstUncompletedSyncPoint->GenerationID;
-
-								// We can't wait for the sync-point that this work is intended for
-								if (GenerationToWaitFor == pWork->SyncPointGeneration)
+								hr = Device->MakeResident(NumObjects, &MakeResidentScratch[MakeResidentIndex].pUnderlying);
+								if (FAILED(hr))
 								{
-									RESIDENCY_CHECK(GenerationToWaitFor >= 0);
-									GenerationToWaitFor -= 1;
+									// TODO: What should we do if this fails? This is a catastrophic failure in which the app is trying to use more memory
+									//       in 1 command list than can possibly be made resident by the system.
+									RESIDENCY_CHECK_RESULT(hr);
 								}
-								// Wait until the GPU is done
-								WaitForSyncPoint(GenerationToWaitFor);
+								break;
+							}
 
-								LRU.TrimToSyncPointInclusive(TotalUsage + INT64(SizeToMakeResident), TotalBudget, pEvictionList, NumObjectsToEvict, GenerationToWaitFor);
+							UINT64 GenerationToWaitFor = FirstUncompletedSyncPoint->GenerationID;
 
-								RESIDENCY_CHECK_RESULT(Device->Evict(NumObjectsToEvict, pEvictionList));
+							// We can't wait for the sync-point that this work is intended for
+							if (GenerationToWaitFor == pWork->SyncPointGeneration)
+							{
+								RESIDENCY_CHECK(GenerationToWaitFor >= 0);
+								GenerationToWaitFor -= 1;
 							}
-							else
+							// Wait until the GPU is done. No shard locks are held, so other threads can keep tracking objects.
+							WaitForSyncPoint(GenerationToWaitFor);
+
+							Internal::ScopedLockAllShards Lock(&LRU);
+
+							if (EvictionScratch.Reserve(LRU.GetNumResidentObjects()) == false)
 							{
-								// We made everything resident, mission accomplished
-								break;
+								RESIDENCY_CHECK(false);
 							}
+
+							LRU.TrimToSyncPointInclusive(TotalUsage + INT64(SizeToMakeResident), TotalBudget, EvictionScratch.Get(), NumObjectsToEvict, GenerationToWaitFor);
+
+							RESIDENCY_CHECK_RESULT(Device->Evict(NumObjectsToEvict, EvictionScratch.Get()));
+						}
+						else
+						{
+							// We made everything resident, mission accomplished
+							break;
 						}
 					}
-
-					delete[](pMakeResidentList);
-					delete[](pEvictionList);
 				}
 
+				SignalPagingWorkComplete(pWork);
+			}
+
+			void SignalPagingWorkComplete(AsyncWorkload* pWork)
+			{
 				// Tell the GPU that it's safe to execute since we made things resident
 				RESIDENCY_CHECK_RESULT(AsyncThreadFence.pFence->Signal(pWork->FenceValueToSignal));
 
-				delete(pWork->pMasterSet);
+				ReleaseMasterSet(pWork->pMasterSet);
 				pWork->pMasterSet = nullptr;
 			}
+
+			// Master sets are recycled rather than allocated for every ExecuteCommandLists call
+			ResidencySet* AcquireMasterSet(UINT32 MaxObjectsReferenced)
+			{
+				ResidencySet* pSet = nullptr;
+				{
+					Internal::ScopedLock Lock(&MasterSetPoolCS);
+					if (pFreeMasterSets)
+					{
+						pSet = pFreeMasterSets;
+						pFreeMasterSets = pSet->pNextFree;
+						pSet->pNextFree = nullptr;
+					}
+				}
+
+				if (pSet == nullptr)
+				{
+					pSet = new ResidencySet();
+					if (pSet == nullptr)
+					{
+						return nullptr;
+					}
+					pSet->Initialize(pSyncManager);
+				}
+
+				if (pSet->Reserve(MaxObjectsReferenced) == false)
+				{
+					delete(pSet);
+					return nullptr;
+				}
+
+				return pSet;
+			}
+
+			void ReleaseMasterSet(ResidencySet* pSet)
+			{
+				Internal::ScopedLock Lock(&MasterSetPoolCS);
+				pSet->pNextFree = pFreeMasterSets;
+				pFreeMasterSets = pSet;
+			}
+
+			// Use a union so that we only need 1 allocation
+			union ResidentScratchSpace
+			{
+				ManagedObject* pManagedObject;
+				ID3D12Pageable* pUnderlying;
+			};
+
+			Internal::ScratchArray<ResidentScratchSpace> MakeResidentScratch;
+			Internal::ScratchArray<ID3D12Pageable*> EvictionScratch;
+			UINT64 LastAgedTrimTimestamp;
+			UINT64 AgedTrimIntervalTicks;
+
+			Internal::CriticalSection MasterSetPoolCS;
+			ResidencySet* pFreeMasterSets;
+
 			// The Enqueue and Dequeue Async Work functions are threadsafe as there is only 1 producer and 1 consumer, if that changes
 			// Synchronisation will be required
 			HRESULT EnqueueAsyncWork(ResidencySet* pMasterSet, UINT64 FenceValueToSignal, UINT64 SyncPointGeneration)
@@ -1349,7 +1688,7 @@ namespace D3DX12Residency
 					if (pPoint->IsCompleted())
 					{
 						Internal::RemoveHeadList(&InFlightSyncPointsHead);
-						delete pPoint;
+						Internal::DeviceWideSyncPoint::DestroySyncPoint(pPoint);
 					}
 					else
 					{
@@ -1379,13 +1718,13 @@ namespace D3DX12Residency
 					{
 						// Keep popping off until we find the one to wait on
 						Internal::RemoveHeadList(&InFlightSyncPointsHead);
-						delete(pPoint);
+						Internal::DeviceWideSyncPoint::DestroySyncPoint(pPoint);
 					}
 					else
 					{
 						pPoint->WaitForCompletion(CompletionEvent);
 						Internal::RemoveHeadList(&InFlightSyncPointsHead);
-						delete(pPoint);
+						Internal::DeviceWideSyncPoint::DestroySyncPoint(pPoint);
 						return;
 					}
 				}
@@ -1429,9 +1768,7 @@ namespace D3DX12Residency
 			// NOTE: This is an index not a mask. The majority of D3D12 uses bit masks to identify a GPU node whereas DXGI uses 0 based indices.
 			UINT NodeIndex;
 			IDXGIAdapter3* Adapter;
-			Internal::LRUCache LRU;
-
-			Internal::CriticalSection Mutex;
+			Internal::ShardedLRUCache LRU;
 
 			Internal::CriticalSection ExecutionCS;
 
@@ -29,6 +29,9 @@ public:
         std::memset(m_UAVHandle, 0xFF, sizeof(m_UAVHandle));
     }
 
+    // Release the resource and return its views to the descriptor allocators
+    virtual void Destroy( void ) override;
+
     // Create a color buffer from a swap chain buffer.  Unordered access is restricted.
     void CreateFromSwapChain( const std::wstring& Name, ID3D12Resource* BaseResource );
 
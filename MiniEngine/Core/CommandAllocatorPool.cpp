@@ -14,65 +14,195 @@
 #include "pch.h"
 #include "CommandAllocatorPool.h"
 
-CommandAllocatorPool::CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE Type) :
+CommandAllocatorPool::CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE Type, CommandAllocatorProvider* Provider) :
     m_cCommandListType(Type),
-    m_Device(nullptr)
+    m_Provider(Provider),
+    m_Device(nullptr),
+    m_MaxAllocators(0),
+    m_Generation(1),
+    m_NumCreated(0),
+    m_NumReused(0),
+    m_NumThreadCacheHits(0),
+    m_NumStalled(0)
 {
 }
 
 CommandAllocatorPool::~CommandAllocatorPool()
 {
     Shutdown();
+
+    // Threads other than this one must be done with the pool by now
+    ThreadCache* Cache = GetThreadCache();
+    if (Cache != nullptr)
+        Cache->Owner = nullptr;
 }
 
-void CommandAllocatorPool::Create(ID3D12Device * pDevice)
+void CommandAllocatorPool::Create(ID3D12Device * pDevice, uint32_t MaxAllocators)
 {
     m_Device = pDevice;
+    m_MaxAllocators = MaxAllocators;
 }
 
 void CommandAllocatorPool::Shutdown()
 {
+    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
+
     for (size_t i = 0; i < m_AllocatorPool.size(); ++i)
         m_AllocatorPool[i]->Release();
 
     m_AllocatorPool.clear();
+    m_ReadyAllocators = decltype(m_ReadyAllocators)();
+    ++m_Generation;
 }
 
-ID3D12CommandAllocator * CommandAllocatorPool::RequestAllocator(uint64_t CompletedFenceValue)
+CommandAllocatorPool::ThreadCache::~ThreadCache()
 {
-    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
+    if (Owner == nullptr || Count == 0)
+        return;
+
+    std::lock_guard<std::mutex> LockGuard(Owner->m_AllocatorMutex);
+    if (Generation == Owner->m_Generation)
+    {
+        for (uint32_t i = 0; i < Count; ++i)
+            Owner->RetireLocked(Entries[i].first, Entries[i].second);
+    }
+    Count = 0;
+}
+
+CommandAllocatorPool::ThreadCache* CommandAllocatorPool::GetThreadCache(void)
+{
+    // One cache per command list type per thread.  Only the first pool of a type to be used on a thread gets a cache;
+    // any other pool of the same type goes straight to its shared queue.
+    static thread_local ThreadCache s_Caches[4];
+
+    ThreadCache& Cache = s_Caches[m_cCommandListType & 3];
+    if (Cache.Owner == nullptr)
+        Cache.Owner = this;
+    else if (Cache.Owner != this)
+        return nullptr;
+
+    uint32_t CurrentGeneration = m_Generation.load(std::memory_order_relaxed);
+    if (Cache.Generation != CurrentGeneration)
+    {
+        Cache.Generation = CurrentGeneration;
+        Cache.Count = 0;
+    }
+
+    return &Cache;
+}
+
+void CommandAllocatorPool::RetireLocked(uint64_t FenceValue, ID3D12CommandAllocator* Allocator)
+{
+    m_ReadyAllocators.push(std::make_pair(FenceValue, Allocator));
+}
 
+ID3D12CommandAllocator * CommandAllocatorPool::RequestAllocator(uint64_t CompletedFenceValue)
+{
     ID3D12CommandAllocator* pAllocator = nullptr;
 
-    if (!m_ReadyAllocators.empty())
+    ThreadCache* Cache = GetThreadCache();
+    if (Cache != nullptr)
     {
-        std::pair<uint64_t, ID3D12CommandAllocator*>& AllocatorPair = m_ReadyAllocators.front();
+        for (uint32_t i = 0; i < Cache->Count; ++i)
+        {
+            if (Cache->Entries[i].first <= CompletedFenceValue)
+            {
+                pAllocator = Cache->Entries[i].second;
+                Cache->Entries[i] = Cache->Entries[--Cache->Count];
+                ++m_NumThreadCacheHits;
+                break;
+            }
+        }
+    }
 
-        if (AllocatorPair.first <= CompletedFenceValue)
+    if (pAllocator == nullptr)
+    {
+        std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
+
+        // The queue is ordered by fence value, so if the oldest allocator isn't ready, none of them are.
+        if (!m_ReadyAllocators.empty() && m_ReadyAllocators.top().first <= CompletedFenceValue)
         {
-            pAllocator = AllocatorPair.second;
-            ASSERT_SUCCEEDED(pAllocator->Reset());
+            pAllocator = m_ReadyAllocators.top().second;
             m_ReadyAllocators.pop();
         }
+        else if (m_MaxAllocators > 0 && m_AllocatorPool.size() >= m_MaxAllocators)
+        {
+            // Only refuse when there is something to wait on.  Otherwise every spare allocator is parked in some
+            // thread's cache and the cap has to give.
+            if (!m_ReadyAllocators.empty())
+            {
+                ++m_NumStalled;
+                return nullptr;
+            }
+            WARN_ONCE_IF(true, "Command allocator pool exceeded its cap while allocators were held in thread caches");
+        }
     }
 
-    // If no allocator's were ready to be reused, create a new one
-    if (pAllocator == nullptr)
+    if (pAllocator != nullptr)
     {
-        ASSERT_SUCCEEDED(m_Device->CreateCommandAllocator(m_cCommandListType, MY_IID_PPV_ARGS(&pAllocator)));
-        wchar_t AllocatorName[32];
-        swprintf(AllocatorName, 32, L"CommandAllocator %zu", m_AllocatorPool.size());
-        pAllocator->SetName(AllocatorName);
-        m_AllocatorPool.push_back(pAllocator);
+        ASSERT_SUCCEEDED(pAllocator->Reset());
+        ++m_NumReused;
+        return pAllocator;
     }
 
+    // If no allocator's were ready to be reused, create a new one
+    if (m_Provider != nullptr)
+        pAllocator = m_Provider->CreateAllocator(m_cCommandListType);
+    else
+        ASSERT_SUCCEEDED(m_Device->CreateCommandAllocator(m_cCommandListType, MY_IID_PPV_ARGS(&pAllocator)));
+    ++m_NumCreated;
+
+    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
+    wchar_t AllocatorName[32];
+    swprintf(AllocatorName, 32, L"CommandAllocator %zu", m_AllocatorPool.size());
+    pAllocator->SetName(AllocatorName);
+    m_AllocatorPool.push_back(pAllocator);
+
     return pAllocator;
 }
 
 void CommandAllocatorPool::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator * Allocator)
 {
+    ThreadCache* Cache = GetThreadCache();
+    if (Cache != nullptr)
+    {
+        if (Cache->Count < sm_ThreadCacheSize)
+        {
+            Cache->Entries[Cache->Count++] = std::make_pair(FenceValue, Allocator);
+            return;
+        }
+
+        // Keep the newest allocator locally and hand the oldest (the one most likely to be ready) to everyone else
+        uint32_t Oldest = 0;
+        for (uint32_t i = 1; i < Cache->Count; ++i)
+        {
+            if (Cache->Entries[i].first < Cache->Entries[Oldest].first)
+                Oldest = i;
+        }
+        RetiredAllocator Evicted = Cache->Entries[Oldest];
+        Cache->Entries[Oldest] = std::make_pair(FenceValue, Allocator);
+        FenceValue = Evicted.first;
+        Allocator = Evicted.second;
+    }
+
     std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
 
     // That fence value indicates we are free to reset the allocator
-    m_ReadyAllocators.push(std::make_pair(FenceValue, Allocator));
+    RetireLocked(FenceValue, Allocator);
+}
+
+uint64_t CommandAllocatorPool::GetOldestPendingFence(void)
+{
+    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
+    return m_ReadyAllocators.empty() ? 0 : m_ReadyAllocators.top().first;
+}
+
+CommandAllocatorPool::Statistics CommandAllocatorPool::GetStatistics(void) const
+{
+    Statistics Stats;
+    Stats.NumCreated = m_NumCreated;
+    Stats.NumReused = m_NumReused;
+    Stats.NumThreadCacheHits = m_NumThreadCacheHits;
+    Stats.NumStalled = m_NumStalled;
+    return Stats;
 }
@@ -16,27 +16,85 @@
 #include <vector>
 #include <queue>
 #include <mutex>
+#include <atomic>
+#include <functional>
 #include <stdint.h>
 
+// Source of new command allocators.  The default creates them on the device passed to Create(); a test can hand out
+// stand-ins to check when the pool resets and reuses them.
+class CommandAllocatorProvider
+{
+public:
+    virtual ~CommandAllocatorProvider() {}
+    virtual ID3D12CommandAllocator* CreateAllocator(D3D12_COMMAND_LIST_TYPE Type) = 0;
+};
+
+// Recycles command allocators once the GPU has finished with them.  Retired allocators are ordered by the fence
+// value that releases them, so a request never creates a new allocator while any retired one is reusable.  Each
+// thread also keeps a couple of its own retired allocators that it can reuse without taking the pool lock.
 class CommandAllocatorPool
 {
 public:
-    CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE Type);
+    struct Statistics
+    {
+        uint64_t NumCreated;        // Allocators created on the device
+        uint64_t NumReused;         // Requests satisfied by a retired allocator
+        uint64_t NumThreadCacheHits;// ...of which came from the calling thread's cache
+        uint64_t NumStalled;        // Requests refused because the pool was at its cap with nothing ready
+    };
+
+    CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE Type, CommandAllocatorProvider* Provider = nullptr);
     ~CommandAllocatorPool();
 
-    void Create(ID3D12Device* pDevice);
+    // MaxAllocators caps how many allocators the pool creates.  Zero means unbounded.
+    void Create(ID3D12Device* pDevice, uint32_t MaxAllocators = 0);
     void Shutdown();
 
+    // Returns nullptr when the pool is at its cap and nothing is ready.  The caller should then wait for
+    // GetOldestPendingFence() and try again.
     ID3D12CommandAllocator* RequestAllocator(uint64_t CompletedFenceValue);
     void DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator);
 
-    inline size_t Size() { return m_AllocatorPool.size(); }
+    // The smallest fence value that will release a retired allocator, or 0 if none is waiting in the shared pool
+    uint64_t GetOldestPendingFence(void);
+
+    Statistics GetStatistics(void) const;
+
+    inline size_t Size() { std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex); return m_AllocatorPool.size(); }
 
 private:
+    typedef std::pair<uint64_t, ID3D12CommandAllocator*> RetiredAllocator;
+
+    static const uint32_t sm_ThreadCacheSize = 2;
+
+    struct ThreadCache
+    {
+        ThreadCache() : Owner(nullptr), Generation(0), Count(0) {}
+        ~ThreadCache();
+
+        CommandAllocatorPool* Owner;
+        uint32_t Generation;
+        uint32_t Count;
+        RetiredAllocator Entries[sm_ThreadCacheSize];
+    };
+
+    ThreadCache* GetThreadCache(void);
+    void RetireLocked(uint64_t FenceValue, ID3D12CommandAllocator* Allocator);
+
     const D3D12_COMMAND_LIST_TYPE m_cCommandListType;
+    CommandAllocatorProvider* m_Provider;
 
     ID3D12Device* m_Device;
+    uint32_t m_MaxAllocators;
     std::vector<ID3D12CommandAllocator*> m_AllocatorPool;
-    std::queue<std::pair<uint64_t, ID3D12CommandAllocator*>> m_ReadyAllocators;
-    std::mutex m_AllocatorMutex;
+    std::priority_queue<RetiredAllocator, std::vector<RetiredAllocator>, std::greater<RetiredAllocator>> m_ReadyAllocators;
+    mutable std::mutex m_AllocatorMutex;
+
+    // Bumped by Shutdown() so that thread caches drop allocators that have been released
+    std::atomic<uint32_t> m_Generation;
+
+    std::atomic<uint64_t> m_NumCreated;
+    std::atomic<uint64_t> m_NumReused;
+    std::atomic<uint64_t> m_NumThreadCacheHits;
+    std::atomic<uint64_t> m_NumStalled;
 };
@@ -30,30 +30,88 @@ using namespace Graphics;
 void ContextManager::DestroyAllContexts(void)
 {
     for (uint32_t i = 0; i < 4; ++i)
+    {
+        std::lock_guard<std::mutex> LockGuard(sm_ContextAllocationMutex[i]);
         sm_ContextPool[i].clear();
+        sm_AvailableContexts[i] = std::queue<CommandContext*>();
+    }
+
+    // Cached contexts on every thread were just deleted
+    ++m_Generation;
 }
 
-CommandContext* ContextManager::AllocateContext(D3D12_COMMAND_LIST_TYPE Type)
+ContextManager::ThreadCache::~ThreadCache()
 {
-    std::lock_guard<std::mutex> LockGuard(sm_ContextAllocationMutex);
+    if (Owner == nullptr || Generation != Owner->m_Generation)
+        return;
 
-    auto& AvailableContexts = sm_AvailableContexts[Type];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        if (Contexts[i] != nullptr)
+        {
+            std::lock_guard<std::mutex> LockGuard(Owner->sm_ContextAllocationMutex[i]);
+            Owner->sm_AvailableContexts[i].push(Contexts[i]);
+        }
+    }
+}
 
-    CommandContext* ret = nullptr;
-    if (AvailableContexts.empty())
+ContextManager::ThreadCache* ContextManager::GetThreadCache(void)
+{
+    static thread_local ThreadCache s_Cache;
+
+    if (s_Cache.Owner == nullptr)
+        s_Cache.Owner = this;
+    else if (s_Cache.Owner != this)
+        return nullptr;
+
+    uint32_t CurrentGeneration = m_Generation.load(std::memory_order_relaxed);
+    if (s_Cache.Generation != CurrentGeneration)
     {
-        ret = new CommandContext(Type);
-        sm_ContextPool[Type].emplace_back(ret);
-        ret->Initialize();
+        s_Cache.Generation = CurrentGeneration;
+        for (uint32_t i = 0; i < 4; ++i)
+            s_Cache.Contexts[i] = nullptr;
     }
-    else
+
+    return &s_Cache;
+}
+
+CommandContext* ContextManager::AllocateContext(D3D12_COMMAND_LIST_TYPE Type)
+{
+    CommandContext* ret = nullptr;
+
+    ThreadCache* Cache = GetThreadCache();
+    if (Cache != nullptr && Cache->Contexts[Type] != nullptr)
     {
-        ret = AvailableContexts.front();
-        AvailableContexts.pop();
+        ret = Cache->Contexts[Type];
+        Cache->Contexts[Type] = nullptr;
         ret->Reset();
+        return ret;
+    }
+
+    {
+        std::lock_guard<std::mutex> LockGuard(sm_ContextAllocationMutex[Type]);
+
+        auto& AvailableContexts = sm_AvailableContexts[Type];
+
+        if (AvailableContexts.empty())
+        {
+            ret = new CommandContext(Type);
+            sm_ContextPool[Type].emplace_back(ret);
+        }
+        else
+        {
+            ret = AvailableContexts.front();
+            AvailableContexts.pop();
+        }
     }
     ASSERT(ret != nullptr);
 
+    // Requesting an allocator may wait on the GPU, so do it outside the lock
+    if (ret->m_CommandList == nullptr)
+        ret->Initialize();
+    else
+        ret->Reset();
+
     ASSERT(ret->m_Type == Type);
 
     return ret;
@@ -62,8 +120,19 @@ CommandContext* ContextManager::AllocateContext(D3D12_COMMAND_LIST_TYPE Type)
 void ContextManager::FreeContext(CommandContext* UsedContext)
 {
     ASSERT(UsedContext != nullptr);
-    std::lock_guard<std::mutex> LockGuard(sm_ContextAllocationMutex);
-    sm_AvailableContexts[UsedContext->m_Type].push(UsedContext);
+
+    D3D12_COMMAND_LIST_TYPE Type = UsedContext->m_Type;
+
+    ThreadCache* Cache = GetThreadCache();
+    if (Cache != nullptr)
+    {
+        std::swap(Cache->Contexts[Type], UsedContext);
+        if (UsedContext == nullptr)
+            return;
+    }
+
+    std::lock_guard<std::mutex> LockGuard(sm_ContextAllocationMutex[Type]);
+    sm_AvailableContexts[Type].push(UsedContext);
 }
 
 void CommandContext::DestroyAllContexts(void)
@@ -94,6 +163,7 @@ ComputeContext& ComputeContext::Begin(const std::wstring& ID, bool Async)
 
 uint64_t CommandContext::Flush(bool WaitForCompletion)
 {
+    m_BarrierTracker.EndSplitTransitions();
     FlushResourceBarriers();
 
     ASSERT(m_CurrentAllocator != nullptr);
@@ -129,6 +199,7 @@ uint64_t CommandContext::Finish( bool WaitForCompletion )
 {
     ASSERT(m_Type == D3D12_COMMAND_LIST_TYPE_DIRECT || m_Type == D3D12_COMMAND_LIST_TYPE_COMPUTE);
 
+    m_BarrierTracker.EndSplitTransitions();
     FlushResourceBarriers();
 
     if (m_ID.length() > 0)
@@ -159,6 +230,7 @@ CommandContext::CommandContext(D3D12_COMMAND_LIST_TYPE Type) :
     m_Type(Type),
     m_DynamicViewDescriptorHeap(*this, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV),
     m_DynamicSamplerDescriptorHeap(*this, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER),
+    m_BarrierTracker(Type),
     m_CpuLinearAllocator(kCpuWritable), 
     m_GpuLinearAllocator(kGpuExclusive)
 {
@@ -171,7 +243,6 @@ CommandContext::CommandContext(D3D12_COMMAND_LIST_TYPE Type) :
     m_CurGraphicsPipelineState = nullptr;
     m_CurComputeRootSignature = nullptr;
     m_CurComputePipelineState = nullptr;
-    m_NumBarriersToFlush = 0;
 }
 
 CommandContext::~CommandContext( void )
@@ -197,7 +268,7 @@ void CommandContext::Reset( void )
     m_CurGraphicsPipelineState = nullptr;
     m_CurComputeRootSignature = nullptr;
     m_CurComputePipelineState = nullptr;
-    m_NumBarriersToFlush = 0;
+    m_BarrierTracker.Reset();
 
     BindDescriptorHeaps();
 }
@@ -248,6 +319,7 @@ void GraphicsContext::ClearUAV( GpuBuffer& Target )
     // a shader to set all of the values).
     D3D12_GPU_DESCRIPTOR_HANDLE GpuVisibleHandle = m_DynamicViewDescriptorHeap.UploadDirect(Target.GetUAV());
     const UINT ClearColor[4] = {};
+    FlushResourceBarriers();
     m_CommandList->ClearUnorderedAccessViewUint(GpuVisibleHandle, Target.GetUAV(), Target.GetResource(), ClearColor, 0, nullptr);
 }
 
@@ -257,6 +329,7 @@ void ComputeContext::ClearUAV( GpuBuffer& Target )
     // a shader to set all of the values).
     D3D12_GPU_DESCRIPTOR_HANDLE GpuVisibleHandle = m_DynamicViewDescriptorHeap.UploadDirect(Target.GetUAV());
     const UINT ClearColor[4] = {};
+    FlushResourceBarriers();
     m_CommandList->ClearUnorderedAccessViewUint(GpuVisibleHandle, Target.GetUAV(), Target.GetResource(), ClearColor, 0, nullptr);
 }
 
@@ -269,6 +342,7 @@ void GraphicsContext::ClearUAV( ColorBuffer& Target )
 
     //TODO: My Nvidia card is not clearing UAVs with either Float or Uint variants.
     const float* ClearColor = Target.GetClearColor().GetPtr();
+    FlushResourceBarriers();
     m_CommandList->ClearUnorderedAccessViewFloat(GpuVisibleHandle, Target.GetUAV(), Target.GetResource(), ClearColor, 1, &ClearRect);
 }
 
@@ -281,26 +355,31 @@ void ComputeContext::ClearUAV( ColorBuffer& Target )
 
     //TODO: My Nvidia card is not clearing UAVs with either Float or Uint variants.
     const float* ClearColor = Target.GetClearColor().GetPtr();
+    FlushResourceBarriers();
     m_CommandList->ClearUnorderedAccessViewFloat(GpuVisibleHandle, Target.GetUAV(), Target.GetResource(), ClearColor, 1, &ClearRect);
 }
 
 void GraphicsContext::ClearColor( ColorBuffer& Target )
 {
+    FlushResourceBarriers();
     m_CommandList->ClearRenderTargetView(Target.GetRTV(), Target.GetClearColor().GetPtr(), 0, nullptr);
 }
 
 void GraphicsContext::ClearDepth( DepthBuffer& Target )
 {
+    FlushResourceBarriers();
     m_CommandList->ClearDepthStencilView(Target.GetDSV(), D3D12_CLEAR_FLAG_DEPTH, Target.GetClearDepth(), Target.GetClearStencil(), 0, nullptr );
 }
 
 void GraphicsContext::ClearStencil( DepthBuffer& Target )
 {
+    FlushResourceBarriers();
     m_CommandList->ClearDepthStencilView(Target.GetDSV(), D3D12_CLEAR_FLAG_STENCIL, Target.GetClearDepth(), Target.GetClearStencil(), 0, nullptr);
 }
 
 void GraphicsContext::ClearDepthAndStencil( DepthBuffer& Target )
 {
+    FlushResourceBarriers();
     m_CommandList->ClearDepthStencilView(Target.GetDSV(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, Target.GetClearDepth(), Target.GetClearStencil(), 0, nullptr);
 }
 
@@ -336,79 +415,39 @@ void GraphicsContext::SetScissor( const D3D12_RECT& rect )
 
 void CommandContext::TransitionResource(GpuResource& Resource, D3D12_RESOURCE_STATES NewState, bool FlushImmediate)
 {
-    D3D12_RESOURCE_STATES OldState = Resource.m_UsageState;
-
-    if (m_Type == D3D12_COMMAND_LIST_TYPE_COMPUTE)
-    {
-        ASSERT((OldState & VALID_COMPUTE_QUEUE_RESOURCE_STATES) == OldState);
-        ASSERT((NewState & VALID_COMPUTE_QUEUE_RESOURCE_STATES) == NewState);
-    }
-
-    if (OldState != NewState)
-    {
-        ASSERT(m_NumBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
-        D3D12_RESOURCE_BARRIER& BarrierDesc = m_ResourceBarrierBuffer[m_NumBarriersToFlush++];
-
-        BarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        BarrierDesc.Transition.pResource = Resource.GetResource();
-        BarrierDesc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-        BarrierDesc.Transition.StateBefore = OldState;
-        BarrierDesc.Transition.StateAfter = NewState;
+    m_BarrierTracker.Transition(Resource, NewState);
 
-        // Check to see if we already started the transition
-        if (NewState == Resource.m_TransitioningState)
-        {
-            BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
-            Resource.m_TransitioningState = (D3D12_RESOURCE_STATES)-1;
-        }
-        else
-            BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    if (FlushImmediate)
+        FlushResourceBarriers();
+}
 
-        Resource.m_UsageState = NewState;
-    }
-    else if (NewState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
-        InsertUAVBarrier(Resource, FlushImmediate);
+void CommandContext::TransitionSubresource(GpuResource& Resource, UINT Subresource, D3D12_RESOURCE_STATES NewState, bool FlushImmediate)
+{
+    m_BarrierTracker.Transition(Resource, NewState, Subresource);
 
-    if (FlushImmediate || m_NumBarriersToFlush == 16)
+    if (FlushImmediate)
         FlushResourceBarriers();
 }
 
 void CommandContext::BeginResourceTransition(GpuResource& Resource, D3D12_RESOURCE_STATES NewState, bool FlushImmediate)
 {
-    // If it's already transitioning, finish that transition
-    if (Resource.m_TransitioningState != (D3D12_RESOURCE_STATES)-1)
-        TransitionResource(Resource, Resource.m_TransitioningState);
-
-    D3D12_RESOURCE_STATES OldState = Resource.m_UsageState;
-
-    if (OldState != NewState)
-    {
-        ASSERT(m_NumBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
-        D3D12_RESOURCE_BARRIER& BarrierDesc = m_ResourceBarrierBuffer[m_NumBarriersToFlush++];
-
-        BarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        BarrierDesc.Transition.pResource = Resource.GetResource();
-        BarrierDesc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-        BarrierDesc.Transition.StateBefore = OldState;
-        BarrierDesc.Transition.StateAfter = NewState;
+    m_BarrierTracker.BeginTransition(Resource, NewState);
 
-        BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+    if (FlushImmediate)
+        FlushResourceBarriers();
+}
 
-        Resource.m_TransitioningState = NewState;
-    }
+void CommandContext::BeginSubresourceTransition(GpuResource& Resource, UINT Subresource, D3D12_RESOURCE_STATES NewState, bool FlushImmediate)
+{
+    m_BarrierTracker.BeginTransition(Resource, NewState, Subresource);
 
-    if (FlushImmediate || m_NumBarriersToFlush == 16)
+    if (FlushImmediate)
         FlushResourceBarriers();
 }
 
 void CommandContext::InsertUAVBarrier(GpuResource& Resource, bool FlushImmediate)
 {
-    ASSERT(m_NumBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
-    D3D12_RESOURCE_BARRIER& BarrierDesc = m_ResourceBarrierBuffer[m_NumBarriersToFlush++];
-
-    BarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-    BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    BarrierDesc.UAV.pResource = Resource.GetResource();
+    m_BarrierTracker.UAVBarrier(Resource);
 
     if (FlushImmediate)
         FlushResourceBarriers();
@@ -416,13 +455,7 @@ void CommandContext::InsertUAVBarrier(GpuResource& Resource, bool FlushImmediate
 
 void CommandContext::InsertAliasBarrier(GpuResource& Before, GpuResource& After, bool FlushImmediate)
 {
-    ASSERT(m_NumBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
-    D3D12_RESOURCE_BARRIER& BarrierDesc = m_ResourceBarrierBuffer[m_NumBarriersToFlush++];
-
-    BarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
-    BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    BarrierDesc.Aliasing.pResourceBefore = Before.GetResource();
-    BarrierDesc.Aliasing.pResourceAfter = After.GetResource();
+    m_BarrierTracker.AliasBarrier(Before, After);
 
     if (FlushImmediate)
         FlushResourceBarriers();
@@ -430,9 +463,9 @@ void CommandContext::InsertAliasBarrier(GpuResource& Before, GpuResource& After,
 
 void CommandContext::WriteBuffer( GpuResource& Dest, size_t DestOffset, const void* BufferData, size_t NumBytes )
 {
-    ASSERT(BufferData != nullptr && Math::IsAligned(BufferData, 16));
+    ASSERT(BufferData != nullptr);
     DynAlloc TempSpace = m_CpuLinearAllocator.Allocate( NumBytes, 512 );
-    SIMDMemCopy(TempSpace.DataPtr, BufferData, Math::DivideByMultiple(NumBytes, 16));
+    CopyUploadData(TempSpace.DataPtr, BufferData, NumBytes);
     CopyBufferRegion(Dest, DestOffset, TempSpace.Buffer, TempSpace.Offset, NumBytes );
 }
 
@@ -440,7 +473,7 @@ void CommandContext::FillBuffer( GpuResource& Dest, size_t DestOffset, DWParam V
 {
     DynAlloc TempSpace = m_CpuLinearAllocator.Allocate( NumBytes, 512 );
     __m128 VectorValue = _mm_set1_ps(Value.Float);
-    SIMDMemFill(TempSpace.DataPtr, VectorValue, Math::DivideByMultiple(NumBytes, 16));
+    SIMDMemFillBytes(TempSpace.DataPtr, VectorValue, NumBytes);
     CopyBufferRegion(Dest, DestOffset, TempSpace.Buffer, TempSpace.Offset, NumBytes );
 }
 
@@ -459,6 +492,29 @@ void CommandContext::InitializeTexture( GpuResource& Dest, UINT NumSubresources,
     InitContext.Finish(true);
 }
 
+void CommandContext::InitializeTexture( GpuResource& Dest, const std::function<void (void* Data, size_t RowPitch)>& WriteTexels )
+{
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint;
+    UINT64 uploadBufferSize;
+    g_Device->GetCopyableFootprints(&Dest.GetResource()->GetDesc(), 0, 1, 0, &Footprint, nullptr, nullptr, &uploadBufferSize);
+
+    CommandContext& InitContext = CommandContext::Begin();
+
+    // Texture data must be placed on a 512-byte boundary of the upload buffer
+    DynAlloc mem = InitContext.m_CpuLinearAllocator.Allocate((size_t)uploadBufferSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+    WriteTexels(mem.DataPtr, Footprint.Footprint.RowPitch);
+    Footprint.Offset = mem.Offset;
+
+    InitContext.TransitionResource(Dest, D3D12_RESOURCE_STATE_COPY_DEST, true);
+    InitContext.m_CommandList->CopyTextureRegion(
+        &CD3DX12_TEXTURE_COPY_LOCATION(Dest.GetResource(), 0), 0, 0, 0,
+        &CD3DX12_TEXTURE_COPY_LOCATION(mem.Buffer.GetResource(), Footprint), nullptr);
+    InitContext.TransitionResource(Dest, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+    // Execute the command list and wait for it to finish so we can release the upload buffer
+    InitContext.Finish(true);
+}
+
 void CommandContext::CopySubresource(GpuResource& Dest, UINT DestSubIndex, GpuResource& Src, UINT SrcSubIndex)
 {
     FlushResourceBarriers();
@@ -546,7 +602,7 @@ void CommandContext::InitializeBuffer( GpuResource& Dest, const void* BufferData
     CommandContext& InitContext = CommandContext::Begin();
 
     DynAlloc mem = InitContext.ReserveUploadMemory(NumBytes);
-    SIMDMemCopy(mem.DataPtr, BufferData, Math::DivideByMultiple(NumBytes, 16));
+    SIMDMemCopyBytes(mem.DataPtr, BufferData, NumBytes);
 
     // copy data to the intermediate upload heap and then schedule a copy from the upload heap to the default texture
     InitContext.TransitionResource(Dest, D3D12_RESOURCE_STATE_COPY_DEST, true);
@@ -23,8 +23,10 @@
 #include "PixelBuffer.h"
 #include "DynamicDescriptorHeap.h"
 #include "LinearAllocator.h"
+#include <functional>
 #include "CommandSignature.h"
 #include "GraphicsCore.h"
+#include "ResourceBarrierTracker.h"
 #include <vector>
 
 class ColorBuffer;
@@ -51,25 +53,34 @@ struct DWParam
     };
 };
 
-#define VALID_COMPUTE_QUEUE_RESOURCE_STATES \
-    ( D3D12_RESOURCE_STATE_UNORDERED_ACCESS \
-    | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE \
-    | D3D12_RESOURCE_STATE_COPY_DEST \
-    | D3D12_RESOURCE_STATE_COPY_SOURCE )
-
+// Each thread parks the last context it finished (per type) and hands it back to itself on the next Begin()
+// without locking.  Everything else goes through per-type free queues.
 class ContextManager
 {
 public:
-    ContextManager(void) {}
+    ContextManager(void) : m_Generation(1) {}
 
     CommandContext* AllocateContext(D3D12_COMMAND_LIST_TYPE Type);
     void FreeContext(CommandContext*);
     void DestroyAllContexts();
 
 private:
+    struct ThreadCache
+    {
+        ThreadCache() : Owner(nullptr), Generation(0) { Contexts[0] = Contexts[1] = Contexts[2] = Contexts[3] = nullptr; }
+        ~ThreadCache();
+
+        ContextManager* Owner;
+        uint32_t Generation;
+        CommandContext* Contexts[4];
+    };
+
+    ThreadCache* GetThreadCache(void);
+
     std::vector<std::unique_ptr<CommandContext> > sm_ContextPool[4];
     std::queue<CommandContext*> sm_AvailableContexts[4];
-    std::mutex sm_ContextAllocationMutex;
+    std::mutex sm_ContextAllocationMutex[4];
+    std::atomic<uint32_t> m_Generation;
 };
 
 struct NonCopyable
@@ -130,6 +141,8 @@ public:
     }
 
     static void InitializeTexture( GpuResource& Dest, UINT NumSubresources, D3D12_SUBRESOURCE_DATA SubData[] );
+    // Initializes the first subresource from texels written straight into the upload buffer at its row pitch
+    static void InitializeTexture( GpuResource& Dest, const std::function<void (void* Data, size_t RowPitch)>& WriteTexels );
     static void InitializeBuffer( GpuResource& Dest, const void* Data, size_t NumBytes, size_t Offset = 0);
     static void InitializeTextureArraySlice(GpuResource& Dest, UINT SliceIndex, GpuResource& Src);
     static void ReadbackTexture2D(GpuResource& ReadbackBuffer, PixelBuffer& SrcBuffer);
@@ -138,11 +151,15 @@ public:
     void FillBuffer( GpuResource& Dest, size_t DestOffset, DWParam Value, size_t NumBytes );
 
     void TransitionResource(GpuResource& Resource, D3D12_RESOURCE_STATES NewState, bool FlushImmediate = false);
+    void TransitionSubresource(GpuResource& Resource, UINT Subresource, D3D12_RESOURCE_STATES NewState, bool FlushImmediate = false);
     void BeginResourceTransition(GpuResource& Resource, D3D12_RESOURCE_STATES NewState, bool FlushImmediate = false);
+    void BeginSubresourceTransition(GpuResource& Resource, UINT Subresource, D3D12_RESOURCE_STATES NewState, bool FlushImmediate = false);
     void InsertUAVBarrier(GpuResource& Resource, bool FlushImmediate = false);
     void InsertAliasBarrier(GpuResource& Before, GpuResource& After, bool FlushImmediate = false);
     inline void FlushResourceBarriers(void);
 
+    const ResourceBarrierTracker::Statistics& GetBarrierStatistics(void) const { return m_BarrierTracker.GetStatistics(); }
+
     void InsertTimeStamp( ID3D12QueryHeap* pQueryHeap, uint32_t QueryIdx );
     void ResolveTimeStamps( ID3D12Resource* pReadbackHeap, ID3D12QueryHeap* pQueryHeap, uint32_t NumQueries );
     void PIXBeginEvent(const wchar_t* label);
@@ -158,6 +175,15 @@ protected:
 
     void BindDescriptorHeaps( void );
 
+    // Copies data into upload memory.  Constant buffers and other small uploads go to memcpy.
+    static void CopyUploadData( void* Dest, const void* Source, size_t NumBytes )
+    {
+        if (NumBytes < kSIMDMemCopyMinBytes)
+            memcpy(Dest, Source, NumBytes);
+        else
+            SIMDMemCopyBytes(Dest, Source, NumBytes);
+    }
+
     CommandListManager* m_OwningManager;
     ID3D12GraphicsCommandList* m_CommandList;
     ID3D12CommandAllocator* m_CurrentAllocator;
@@ -170,8 +196,7 @@ protected:
     DynamicDescriptorHeap m_DynamicViewDescriptorHeap;		// HEAP_TYPE_CBV_SRV_UAV
     DynamicDescriptorHeap m_DynamicSamplerDescriptorHeap;	// HEAP_TYPE_SAMPLER
 
-    D3D12_RESOURCE_BARRIER m_ResourceBarrierBuffer[16];
-    UINT m_NumBarriersToFlush;
+    ResourceBarrierTracker m_BarrierTracker;
 
     ID3D12DescriptorHeap* m_CurrentDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
 
@@ -303,11 +328,7 @@ private:
 
 inline void CommandContext::FlushResourceBarriers( void )
 {
-    if (m_NumBarriersToFlush > 0)
-    {
-        m_CommandList->ResourceBarrier(m_NumBarriersToFlush, m_ResourceBarrierBuffer);
-        m_NumBarriersToFlush = 0;
-    }
+    m_BarrierTracker.Flush(m_CommandList);
 }
 
 inline void GraphicsContext::SetRootSignature( const RootSignature& RootSig )
@@ -462,30 +483,28 @@ inline void GraphicsContext::SetConstantBuffer( UINT RootIndex, D3D12_GPU_VIRTUA
 
 inline void GraphicsContext::SetDynamicConstantBufferView( UINT RootIndex, size_t BufferSize, const void* BufferData )
 {
-    ASSERT(BufferData != nullptr && Math::IsAligned(BufferData, 16));
+    ASSERT(BufferData != nullptr);
     DynAlloc cb = m_CpuLinearAllocator.Allocate(BufferSize);
-    //SIMDMemCopy(cb.DataPtr, BufferData, Math::AlignUp(BufferSize, 16) >> 4);
-    memcpy(cb.DataPtr, BufferData, BufferSize);
+    CopyUploadData(cb.DataPtr, BufferData, BufferSize);
     m_CommandList->SetGraphicsRootConstantBufferView(RootIndex, cb.GpuAddress);
 }
 
 inline void ComputeContext::SetDynamicConstantBufferView( UINT RootIndex, size_t BufferSize, const void* BufferData )
 {
-    ASSERT(BufferData != nullptr && Math::IsAligned(BufferData, 16));
+    ASSERT(BufferData != nullptr);
     DynAlloc cb = m_CpuLinearAllocator.Allocate(BufferSize);
-    //SIMDMemCopy(cb.DataPtr, BufferData, Math::AlignUp(BufferSize, 16) >> 4);
-    memcpy(cb.DataPtr, BufferData, BufferSize);
+    CopyUploadData(cb.DataPtr, BufferData, BufferSize);
     m_CommandList->SetComputeRootConstantBufferView(RootIndex, cb.GpuAddress);
 }
 
 inline void GraphicsContext::SetDynamicVB( UINT Slot, size_t NumVertices, size_t VertexStride, const void* VertexData )
 {
-    ASSERT(VertexData != nullptr && Math::IsAligned(VertexData, 16));
+    ASSERT(VertexData != nullptr);
 
     size_t BufferSize = Math::AlignUp(NumVertices * VertexStride, 16);
     DynAlloc vb = m_CpuLinearAllocator.Allocate(BufferSize);
 
-    SIMDMemCopy(vb.DataPtr, VertexData, BufferSize >> 4);
+    CopyUploadData(vb.DataPtr, VertexData, NumVertices * VertexStride);
 
     D3D12_VERTEX_BUFFER_VIEW VBView;
     VBView.BufferLocation = vb.GpuAddress;
@@ -497,12 +516,12 @@ inline void GraphicsContext::SetDynamicVB( UINT Slot, size_t NumVertices, size_t
 
 inline void GraphicsContext::SetDynamicIB( size_t IndexCount, const uint16_t* IndexData )
 {
-    ASSERT(IndexData != nullptr && Math::IsAligned(IndexData, 16));
+    ASSERT(IndexData != nullptr);
 
     size_t BufferSize = Math::AlignUp(IndexCount * sizeof(uint16_t), 16);
     DynAlloc ib = m_CpuLinearAllocator.Allocate(BufferSize);
 
-    SIMDMemCopy(ib.DataPtr, IndexData, BufferSize >> 4);
+    CopyUploadData(ib.DataPtr, IndexData, IndexCount * sizeof(uint16_t));
 
     D3D12_INDEX_BUFFER_VIEW IBView;
     IBView.BufferLocation = ib.GpuAddress;
@@ -514,17 +533,17 @@ inline void GraphicsContext::SetDynamicIB( size_t IndexCount, const uint16_t* In
 
 inline void GraphicsContext::SetDynamicSRV(UINT RootIndex, size_t BufferSize, const void* BufferData)
 {
-    ASSERT(BufferData != nullptr && Math::IsAligned(BufferData, 16));
+    ASSERT(BufferData != nullptr);
     DynAlloc cb = m_CpuLinearAllocator.Allocate(BufferSize);
-    SIMDMemCopy(cb.DataPtr, BufferData, Math::AlignUp(BufferSize, 16) >> 4);
+    CopyUploadData(cb.DataPtr, BufferData, BufferSize);
     m_CommandList->SetGraphicsRootShaderResourceView(RootIndex, cb.GpuAddress);
 }
 
 inline void ComputeContext::SetDynamicSRV(UINT RootIndex, size_t BufferSize, const void* BufferData)
 {
-    ASSERT(BufferData != nullptr && Math::IsAligned(BufferData, 16));
+    ASSERT(BufferData != nullptr);
     DynAlloc cb = m_CpuLinearAllocator.Allocate(BufferSize);
-    SIMDMemCopy(cb.DataPtr, BufferData, Math::AlignUp(BufferSize, 16) >> 4);
+    CopyUploadData(cb.DataPtr, BufferData, BufferSize);
     m_CommandList->SetComputeRootShaderResourceView(RootIndex, cb.GpuAddress);
 }
 
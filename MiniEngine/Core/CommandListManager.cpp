@@ -65,7 +65,7 @@ void CommandListManager::Shutdown()
     m_CopyQueue.Shutdown();
 }
 
-void CommandQueue::Create(ID3D12Device* pDevice)
+void CommandQueue::Create(ID3D12Device* pDevice, uint32_t MaxAllocators)
 {
     ASSERT(pDevice != nullptr);
     ASSERT(!IsReady());
@@ -84,20 +84,20 @@ void CommandQueue::Create(ID3D12Device* pDevice)
     m_FenceEventHandle = CreateEvent(nullptr, false, false, nullptr);
     ASSERT(m_FenceEventHandle != INVALID_HANDLE_VALUE);
 
-    m_AllocatorPool.Create(pDevice);
+    m_AllocatorPool.Create(pDevice, MaxAllocators);
 
     ASSERT(IsReady());
 }
 
-void CommandListManager::Create(ID3D12Device* pDevice)
+void CommandListManager::Create(ID3D12Device* pDevice, uint32_t MaxAllocatorsPerQueue)
 {
     ASSERT(pDevice != nullptr);
 
     m_Device = pDevice;
 
-    m_GraphicsQueue.Create(pDevice);
-    m_ComputeQueue.Create(pDevice);
-    m_CopyQueue.Create(pDevice);
+    m_GraphicsQueue.Create(pDevice, MaxAllocatorsPerQueue);
+    m_ComputeQueue.Create(pDevice, MaxAllocatorsPerQueue);
+    m_CopyQueue.Create(pDevice, MaxAllocatorsPerQueue);
 }
 
 void CommandListManager::CreateNewCommandList( D3D12_COMMAND_LIST_TYPE Type, ID3D12GraphicsCommandList** List, ID3D12CommandAllocator** Allocator )
@@ -194,7 +194,16 @@ ID3D12CommandAllocator* CommandQueue::RequestAllocator()
 {
     uint64_t CompletedFence = m_pFence->GetCompletedValue();
 
-    return m_AllocatorPool.RequestAllocator(CompletedFence);
+    ID3D12CommandAllocator* pAllocator = m_AllocatorPool.RequestAllocator(CompletedFence);
+
+    // The pool is at its cap, so wait for the oldest allocator in flight rather than growing
+    while (pAllocator == nullptr)
+    {
+        WaitForFence(m_AllocatorPool.GetOldestPendingFence());
+        pAllocator = m_AllocatorPool.RequestAllocator(m_pFence->GetCompletedValue());
+    }
+
+    return pAllocator;
 }
 
 void CommandQueue::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator)
@@ -28,7 +28,7 @@ public:
     CommandQueue(D3D12_COMMAND_LIST_TYPE Type);
     ~CommandQueue();
 
-    void Create(ID3D12Device* pDevice);
+    void Create(ID3D12Device* pDevice, uint32_t MaxAllocators = 0);
     void Shutdown();
 
     inline bool IsReady()
@@ -47,6 +47,8 @@ public:
 
     uint64_t GetNextFenceValue() { return m_NextFenceValue; }
 
+    CommandAllocatorPool::Statistics GetAllocatorStatistics() const { return m_AllocatorPool.GetStatistics(); }
+
 private:
 
     uint64_t ExecuteCommandList(ID3D12CommandList* List);
@@ -77,7 +79,9 @@ public:
     CommandListManager();
     ~CommandListManager();
 
-    void Create(ID3D12Device* pDevice);
+    // MaxAllocatorsPerQueue bounds each queue's command allocator pool (zero is unbounded).  When a queue hits the
+    // cap, requests wait for the oldest in-flight allocator instead of creating another.
+    void Create(ID3D12Device* pDevice, uint32_t MaxAllocatorsPerQueue = 0);
     void Shutdown();
 
     CommandQueue& GetGraphicsQueue(void) { return m_GraphicsQueue; }
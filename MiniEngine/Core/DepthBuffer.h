@@ -31,6 +31,9 @@ public:
         m_hStencilSRV.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
     }
 
+    // Release the resource and return its views to the descriptor allocators
+    virtual void Destroy( void ) override;
+
     // Create a depth buffer.  If an address is supplied, memory will not be allocated.
     // The vmem address allows you to alias buffers (which can be especially useful for
     // reusing ESRAM across a frame.)
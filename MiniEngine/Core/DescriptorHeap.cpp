@@ -15,6 +15,7 @@
 #include "DescriptorHeap.h"
 #include "GraphicsCore.h"
 #include "CommandListManager.h"
+#include <algorithm>
 
 using namespace Graphics;
 
@@ -23,10 +24,56 @@ using namespace Graphics;
 //
 std::mutex DescriptorAllocator::sm_AllocationMutex;
 std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DescriptorAllocator::sm_DescriptorHeapPool;
+std::atomic<uint32_t> DescriptorAllocator::sm_Generation(1);
+std::atomic<uint32_t> DescriptorAllocator::sm_RecycleCount(0);
+
+namespace
+{
+    // Size class N holds blocks of [2^(N-1)+1, 2^N] descriptors.
+    inline uint32_t SizeClassOf( uint32_t Count )
+    {
+        uint32_t Class = 0;
+        while ((1u << Class) < Count)
+            ++Class;
+        return Class;
+    }
+}
+
+DescriptorAllocator::DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type, DescriptorHeapProvider* Provider) :
+    m_Type(Type),
+    m_Provider(Provider),
+    m_Generation(sm_Generation),
+    m_HasCurrentHeap(false),
+    m_DescriptorSize(0),
+    m_RemainingFreeHandles(0),
+    m_NumHeaps(0),
+    m_NumFreeListed(0),
+    m_NumInUse(0),
+    m_NumAllocations(0),
+    m_NumFrees(0),
+    m_NumMagazineHits(0)
+{
+    m_CurrentHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+    Magazine* Mag = GetThreadMagazine();
+    if (Mag != nullptr)
+    {
+        Mag->Owner = nullptr;
+        Mag->Count = 0;
+    }
+}
 
 void DescriptorAllocator::DestroyAll(void)
 {
+    std::lock_guard<std::mutex> LockGuard(sm_AllocationMutex);
+
+    // Every outstanding handle, free list entry, and cached magazine handle now points at a dead heap.  Bumping the
+    // generation causes allocators and magazines to discard that state the next time they are touched.
     sm_DescriptorHeapPool.clear();
+    ++sm_Generation;
 }
 
 ID3D12DescriptorHeap* DescriptorAllocator::RequestNewHeap(D3D12_DESCRIPTOR_HEAP_TYPE Type)
@@ -45,24 +92,283 @@ ID3D12DescriptorHeap* DescriptorAllocator::RequestNewHeap(D3D12_DESCRIPTOR_HEAP_
     return pHeap.Get();
 }
 
-D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::Allocate( uint32_t Count )
+DescriptorAllocator::Magazine::~Magazine()
 {
-    if (m_CurrentHeap == nullptr || m_RemainingFreeHandles < Count)
+    if (Owner != nullptr && Count > 0)
     {
-        m_CurrentHeap = RequestNewHeap(m_Type);
-        m_CurrentHandle = m_CurrentHeap->GetCPUDescriptorHandleForHeapStart();
+        std::lock_guard<std::mutex> LockGuard(Owner->m_Mutex);
+        Owner->ResetIfStale();
+        if (Generation == Owner->m_Generation)
+        {
+            for (uint32_t i = 0; i < Count; ++i)
+                Owner->FreeLocked(Handles[i], 1);
+        }
+        Count = 0;
+    }
+}
+
+DescriptorAllocator::Magazine* DescriptorAllocator::GetThreadMagazine( void )
+{
+    // One magazine per heap type per thread.  The global allocators own them; any other allocator of the same type
+    // (e.g. one driven by a stub provider) falls back to the shared lists.
+    static thread_local Magazine s_Magazines[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
+
+    Magazine& Mag = s_Magazines[m_Type];
+    if (Mag.Owner == nullptr)
+        Mag.Owner = this;
+    else if (Mag.Owner != this)
+        return nullptr;
+
+    uint32_t CurrentGeneration = sm_Generation.load(std::memory_order_relaxed);
+    if (Mag.Generation != CurrentGeneration)
+    {
+        Mag.Generation = CurrentGeneration;
+        Mag.Count = 0;
+    }
+
+    return &Mag;
+}
+
+void DescriptorAllocator::ResetIfStale( void )
+{
+    uint32_t CurrentGeneration = sm_Generation.load(std::memory_order_relaxed);
+    if (m_Generation == CurrentGeneration)
+        return;
+
+    m_Generation = CurrentGeneration;
+    m_HasCurrentHeap = false;
+    m_RemainingFreeHandles = 0;
+    m_NumHeaps = 0;
+    m_NumFreeListed = 0;
+    m_NumInUse = 0;
+    m_HeapStarts.clear();
+    m_FreeBlocks.clear();
+    for (uint32_t i = 0; i < sm_NumSizeClasses; ++i)
+        m_SizeClasses[i].clear();
+}
+
+size_t DescriptorAllocator::HeapIndexOf( size_t Ptr ) const
+{
+    return std::upper_bound(m_HeapStarts.begin(), m_HeapStarts.end(), Ptr) - m_HeapStarts.begin();
+}
+
+void DescriptorAllocator::InsertFreeBlock( size_t Ptr, uint32_t Count )
+{
+    m_FreeBlocks[Ptr] = Count;
+    m_SizeClasses[SizeClassOf(Count)].insert(Ptr);
+    m_NumFreeListed += Count;
+}
+
+void DescriptorAllocator::RemoveFreeBlock( size_t Ptr, uint32_t Count )
+{
+    m_FreeBlocks.erase(Ptr);
+    m_SizeClasses[SizeClassOf(Count)].erase(Ptr);
+    m_NumFreeListed -= Count;
+}
+
+size_t DescriptorAllocator::AllocateLocked( uint32_t Count )
+{
+    // Search the free lists starting with the first class that can contain a block this large.  Blocks in that
+    // class may still be too small, so it is scanned; any block in a larger class fits.
+    for (uint32_t Class = SizeClassOf(Count); Class < sm_NumSizeClasses; ++Class)
+    {
+        for (size_t Ptr : m_SizeClasses[Class])
+        {
+            uint32_t BlockCount = m_FreeBlocks[Ptr];
+            if (BlockCount < Count)
+                continue;
+
+            RemoveFreeBlock(Ptr, BlockCount);
+            if (BlockCount > Count)
+                InsertFreeBlock(Ptr + Count * m_DescriptorSize, BlockCount - Count);
+
+            return Ptr;
+        }
+    }
+
+    if (!m_HasCurrentHeap || m_RemainingFreeHandles < Count)
+    {
+        // Don't strand the tail of the old heap
+        if (m_HasCurrentHeap && m_RemainingFreeHandles > 0)
+            FreeLocked(m_CurrentHandle.ptr, m_RemainingFreeHandles);
+
+        if (m_Provider != nullptr)
+            m_CurrentHandle = m_Provider->CreateHeap(m_Type, sm_NumDescriptorsPerHeap);
+        else
+            m_CurrentHandle = RequestNewHeap(m_Type)->GetCPUDescriptorHandleForHeapStart();
+
+        m_HasCurrentHeap = true;
         m_RemainingFreeHandles = sm_NumDescriptorsPerHeap;
+        m_HeapStarts.insert(std::upper_bound(m_HeapStarts.begin(), m_HeapStarts.end(), m_CurrentHandle.ptr), m_CurrentHandle.ptr);
+        ++m_NumHeaps;
 
         if (m_DescriptorSize == 0)
-            m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(m_Type);
+        {
+            m_DescriptorSize = m_Provider != nullptr ? m_Provider->GetDescriptorSize(m_Type) :
+                Graphics::g_Device->GetDescriptorHandleIncrementSize(m_Type);
+        }
     }
 
-    D3D12_CPU_DESCRIPTOR_HANDLE ret = m_CurrentHandle;
+    size_t ret = m_CurrentHandle.ptr;
     m_CurrentHandle.ptr += Count * m_DescriptorSize;
     m_RemainingFreeHandles -= Count;
     return ret;
 }
 
+void DescriptorAllocator::FreeLocked( size_t Ptr, uint32_t Count )
+{
+    size_t HeapIndex = HeapIndexOf(Ptr);
+
+    // A handle allocated before DestroyAll() belongs to a heap that no longer exists.  Drop it rather than hand it out.
+    if (HeapIndex == 0 || Ptr >= m_HeapStarts[HeapIndex - 1] + sm_NumDescriptorsPerHeap * m_DescriptorSize)
+    {
+        m_NumInUse += Count;
+        return;
+    }
+
+    auto Next = m_FreeBlocks.lower_bound(Ptr);
+    ASSERT(Next == m_FreeBlocks.end() || Next->first >= Ptr + Count * m_DescriptorSize, "Descriptor range freed twice");
+
+    if (Next != m_FreeBlocks.end() && Next->first == Ptr + Count * m_DescriptorSize && HeapIndexOf(Next->first) == HeapIndex)
+    {
+        uint32_t NextCount = Next->second;
+        RemoveFreeBlock(Next->first, NextCount);
+        Count += NextCount;
+    }
+
+    auto Prev = m_FreeBlocks.lower_bound(Ptr);
+    if (Prev != m_FreeBlocks.begin())
+    {
+        --Prev;
+        ASSERT(Prev->first + Prev->second * m_DescriptorSize <= Ptr, "Descriptor range freed twice");
+
+        if (Prev->first + Prev->second * m_DescriptorSize == Ptr && HeapIndexOf(Prev->first) == HeapIndex)
+        {
+            size_t PrevPtr = Prev->first;
+            uint32_t PrevCount = Prev->second;
+            RemoveFreeBlock(PrevPtr, PrevCount);
+            Ptr = PrevPtr;
+            Count += PrevCount;
+        }
+    }
+
+    InsertFreeBlock(Ptr, Count);
+}
+
+void DescriptorAllocator::RefillMagazine( Magazine& Mag )
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    ResetIfStale();
+
+    // Prefer isolated singles, which are otherwise the hardest blocks to reuse, then carve the rest as one run
+    std::set<size_t>& Singles = m_SizeClasses[0];
+    while (Mag.Count < sm_MagazineBatch && !Singles.empty())
+    {
+        size_t Ptr = *Singles.begin();
+        RemoveFreeBlock(Ptr, 1);
+        Mag.Handles[Mag.Count++] = Ptr;
+    }
+
+    if (Mag.Count < sm_MagazineBatch)
+    {
+        uint32_t NumToCarve = sm_MagazineBatch - Mag.Count;
+        size_t Run = AllocateLocked(NumToCarve);
+        for (uint32_t i = NumToCarve; i > 0; --i)
+            Mag.Handles[Mag.Count++] = Run + (i - 1) * m_DescriptorSize;
+    }
+}
+
+void DescriptorAllocator::FlushMagazine( Magazine& Mag, uint32_t NumToFlush )
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    ResetIfStale();
+
+    ASSERT(NumToFlush <= Mag.Count);
+    for (uint32_t i = 0; i < NumToFlush; ++i)
+        FreeLocked(Mag.Handles[--Mag.Count], 1);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::Allocate( uint32_t Count )
+{
+    ASSERT(Count > 0 && Count <= sm_NumDescriptorsPerHeap, "Descriptor allocations must be between 1 and 256 descriptors");
+
+    ++m_NumAllocations;
+    m_NumInUse += Count;
+
+    D3D12_CPU_DESCRIPTOR_HANDLE ret;
+
+    Magazine* Mag = Count == 1 ? GetThreadMagazine() : nullptr;
+    if (Mag != nullptr)
+    {
+        if (Mag->Count == 0)
+            RefillMagazine(*Mag);
+        else
+            ++m_NumMagazineHits;
+
+        ret.ptr = Mag->Handles[--Mag->Count];
+        return ret;
+    }
+
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    ResetIfStale();
+    ret.ptr = AllocateLocked(Count);
+    return ret;
+}
+
+void DescriptorAllocator::Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count )
+{
+    if (Handle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN || Count == 0)
+        return;
+
+    ASSERT(Count <= sm_NumDescriptorsPerHeap);
+
+    ++m_NumFrees;
+    sm_RecycleCount.fetch_add(1, std::memory_order_release);
+
+    Magazine* Mag = Count == 1 ? GetThreadMagazine() : nullptr;
+    if (Mag != nullptr)
+    {
+        --m_NumInUse;
+        if (Mag->Count == sm_MagazineSize)
+            FlushMagazine(*Mag, sm_MagazineBatch);
+
+        Mag->Handles[Mag->Count++] = Handle.ptr;
+        return;
+    }
+
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    ResetIfStale();
+    m_NumInUse -= Count;
+    FreeLocked(Handle.ptr, Count);
+}
+
+DescriptorAllocatorStats DescriptorAllocator::GetStats( void )
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    ResetIfStale();
+
+    DescriptorAllocatorStats Stats = {};
+    Stats.NumHeaps = m_NumHeaps;
+    Stats.NumAllocations = m_NumAllocations;
+    Stats.NumFrees = m_NumFrees;
+    Stats.NumMagazineHits = m_NumMagazineHits;
+    Stats.NumReserved = m_NumHeaps * sm_NumDescriptorsPerHeap;
+    Stats.NumInUse = m_NumInUse;
+    Stats.NumFreeListed = m_NumFreeListed;
+    Stats.LargestFreeBlock = m_HasCurrentHeap ? m_RemainingFreeHandles : 0;
+
+    Stats.NumFreeBlocks = (uint32_t)m_FreeBlocks.size();
+    for (auto& Block : m_FreeBlocks)
+        Stats.LargestFreeBlock = std::max(Stats.LargestFreeBlock, Block.second);
+
+    // Descriptors cached in per-thread magazines are neither free-listed nor in use from the pool's point of view,
+    // so they are left out of the fragmentation ratio.
+    uint32_t TotalFree = m_NumFreeListed + (m_HasCurrentHeap ? m_RemainingFreeHandles : 0);
+    Stats.Fragmentation = TotalFree == 0 ? 0.0f : 1.0f - (float)Stats.LargestFreeBlock / (float)TotalFree;
+
+    return Stats;
+}
+
 //
 // UserDescriptorHeap implementation
 //
@@ -14,35 +14,129 @@
 #pragma once
 
 #include <mutex>
+#include <atomic>
 #include <vector>
 #include <queue>
+#include <map>
+#include <set>
 #include <string>
 
 
+// Source of the fixed-size CPU descriptor heaps that DescriptorAllocator carves up.  The default provider
+// creates non-shader-visible ID3D12DescriptorHeaps on the graphics device.  Any other provider only needs to
+// hand out the start of a range of NumDescriptors handles spaced GetDescriptorSize() apart, so the allocator
+// can be exercised with fake handle ranges and no device.
+class DescriptorHeapProvider
+{
+public:
+    virtual ~DescriptorHeapProvider() {}
+    virtual D3D12_CPU_DESCRIPTOR_HANDLE CreateHeap( D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t NumDescriptors ) = 0;
+    virtual uint32_t GetDescriptorSize( D3D12_DESCRIPTOR_HEAP_TYPE Type ) = 0;
+};
+
+struct DescriptorAllocatorStats
+{
+    uint32_t NumHeaps;              // Heaps requested from the provider
+    uint64_t NumAllocations;        // Total calls to Allocate()
+    uint64_t NumFrees;              // Total calls to Free()
+    uint64_t NumMagazineHits;       // Single-descriptor requests served from a per-thread magazine
+    uint32_t NumReserved;           // Descriptors owned by all heaps
+    uint32_t NumInUse;              // Descriptors currently handed out
+    uint32_t NumFreeListed;         // Descriptors sitting in the shared free lists
+    uint32_t NumFreeBlocks;         // Disjoint ranges in the shared free lists
+    uint32_t LargestFreeBlock;      // Largest contiguous range in the free lists or the current heap
+    float Fragmentation;            // 1 - LargestFreeBlock / (free-listed + unused heap tail); 0 when not fragmented
+};
+
 // This is an unbounded resource descriptor allocator.  It is intended to provide space for CPU-visible resource descriptors
 // as resources are created.  For those that need to be made shader-visible, they will need to be copied to a UserDescriptorHeap
 // or a DynamicDescriptorHeap.
+//
+// Descriptors returned with Free() are recycled.  Single descriptors (by far the common case) are cached in small per-thread
+// magazines so that most allocate/free pairs never touch a lock.  Larger ranges go to power-of-two size-class free lists, are
+// merged with free neighbors in the same heap, and are split on reuse.  GetStats() reports how fragmented the lists become.
 class DescriptorAllocator
 {
 public:
-    DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type) : m_Type(Type), m_CurrentHeap(nullptr) {}
+    DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type, DescriptorHeapProvider* Provider = nullptr);
+
+    // Worker threads that allocated or freed single descriptors must have exited (or stopped using the allocator)
+    // before it is destroyed.  The calling thread's magazine is detached here.
+    ~DescriptorAllocator();
 
     D3D12_CPU_DESCRIPTOR_HANDLE Allocate( uint32_t Count );
 
+    // Return a range previously obtained from Allocate().  Count must match the count it was allocated with.  The caller
+    // guarantees that no one will read from the descriptors again (they are copied into shader-visible heaps at record
+    // time, so it is not necessary to wait on the GPU.)  Contexts that are recording stop reusing tables copied from
+    // the freed handles.
+    void Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count );
+
+    DescriptorAllocatorStats GetStats( void );
+
+    // Changes whenever any allocator has descriptors returned to it, after which a handle seen before may name a
+    // different view.
+    static uint32_t GetRecycleCount( void ) { return sm_RecycleCount.load(std::memory_order_acquire); }
+
+    // Releases every heap.  Views must not be freed after this; Graphics::FreeDescriptor() stops forwarding them once the
+    // device is gone.  Stray ranges are dropped, but single descriptors freed into a magazine cannot be told apart.
     static void DestroyAll(void);
 
 protected:
 
     static const uint32_t sm_NumDescriptorsPerHeap = 256;
+    static const uint32_t sm_NumSizeClasses = 9;            // 1, 2, 4, ... 256
+    static const uint32_t sm_MagazineSize = 32;
+    static const uint32_t sm_MagazineBatch = sm_MagazineSize / 2;
+
     static std::mutex sm_AllocationMutex;
     static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_DescriptorHeapPool;
+    static std::atomic<uint32_t> sm_Generation;
+    static std::atomic<uint32_t> sm_RecycleCount;
     static ID3D12DescriptorHeap* RequestNewHeap( D3D12_DESCRIPTOR_HEAP_TYPE Type );
 
+    struct Magazine
+    {
+        Magazine() : Owner(nullptr), Generation(0), Count(0) {}
+        ~Magazine();
+
+        DescriptorAllocator* Owner;
+        uint32_t Generation;
+        uint32_t Count;
+        size_t Handles[sm_MagazineSize];
+    };
+
+    Magazine* GetThreadMagazine( void );
+    void ResetIfStale( void );
+    size_t AllocateLocked( uint32_t Count );
+    void FreeLocked( size_t Ptr, uint32_t Count );
+    void InsertFreeBlock( size_t Ptr, uint32_t Count );
+    void RemoveFreeBlock( size_t Ptr, uint32_t Count );
+    size_t HeapIndexOf( size_t Ptr ) const;
+    void RefillMagazine( Magazine& Mag );
+    void FlushMagazine( Magazine& Mag, uint32_t NumToFlush );
+
     D3D12_DESCRIPTOR_HEAP_TYPE m_Type;
-    ID3D12DescriptorHeap* m_CurrentHeap;
+    DescriptorHeapProvider* m_Provider;
+    std::mutex m_Mutex;
+    uint32_t m_Generation;
+    bool m_HasCurrentHeap;
     D3D12_CPU_DESCRIPTOR_HANDLE m_CurrentHandle;
     uint32_t m_DescriptorSize;
     uint32_t m_RemainingFreeHandles;
+    std::vector<size_t> m_HeapStarts;                   // Sorted, so that frees never coalesce across heaps
+
+    // Free ranges keyed by their first handle, which lets a freed range merge with free neighbors.  The same ranges
+    // are bucketed by size class to find a fit quickly.
+    std::map<size_t, uint32_t> m_FreeBlocks;
+    std::set<size_t> m_SizeClasses[sm_NumSizeClasses];
+
+    uint32_t m_NumHeaps;
+    uint32_t m_NumFreeListed;
+    std::atomic<uint32_t> m_NumInUse;
+    std::atomic<uint64_t> m_NumAllocations;
+    std::atomic<uint64_t> m_NumFrees;
+    std::atomic<uint64_t> m_NumMagazineHits;
 };
 
 
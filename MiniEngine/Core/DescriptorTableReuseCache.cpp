@@ -0,0 +1,106 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "pch.h"
+#include "DescriptorTableReuseCache.h"
+#include "Hash.h"
+
+DescriptorTableReuseCache::DescriptorTableReuseCache( uint32_t HeapSize ) : m_RecycleCount(0)
+{
+    m_HeapSources.resize(HeapSize);
+    Clear();
+}
+
+size_t DescriptorTableReuseCache::HashTable( const D3D12_CPU_DESCRIPTOR_HANDLE* Handles, uint32_t AssignedHandlesBitMap )
+{
+    size_t Hash = Utility::HashState(&AssignedHandlesBitMap);
+
+    unsigned long Slot;
+    uint32_t SetHandles = AssignedHandlesBitMap;
+    while (_BitScanForward(&Slot, SetHandles))
+    {
+        SetHandles ^= (1 << Slot);
+        Hash = Utility::HashState(&Handles[Slot], 1, Hash);
+    }
+
+    return Hash;
+}
+
+bool DescriptorTableReuseCache::Find( size_t Hash, const D3D12_CPU_DESCRIPTOR_HANDLE* Handles,
+    uint32_t AssignedHandlesBitMap, uint32_t& HeapOffset ) const
+{
+    const Entry& Candidate = m_Entries[EntryIndex(Hash)];
+    if (Candidate.Hash != Hash || Candidate.AssignedHandlesBitMap != AssignedHandlesBitMap)
+        return false;
+
+    const D3D12_CPU_DESCRIPTOR_HANDLE* Copied = m_HeapSources.data() + Candidate.HeapOffset;
+
+    unsigned long Slot;
+    uint32_t SetHandles = AssignedHandlesBitMap;
+    while (_BitScanForward(&Slot, SetHandles))
+    {
+        SetHandles ^= (1 << Slot);
+        if (Copied[Slot].ptr != Handles[Slot].ptr)
+            return false;
+    }
+
+    HeapOffset = Candidate.HeapOffset;
+    return true;
+}
+
+void DescriptorTableReuseCache::Insert( size_t Hash, const D3D12_CPU_DESCRIPTOR_HANDLE* Handles,
+    uint32_t AssignedHandlesBitMap, uint32_t HeapOffset )
+{
+    ASSERT(AssignedHandlesBitMap != 0);
+
+    unsigned long MaxSetHandle;
+    _BitScanReverse(&MaxSetHandle, AssignedHandlesBitMap);
+    ASSERT(HeapOffset + MaxSetHandle < (uint32_t)m_HeapSources.size());
+
+    // Unset slots are left alone.  Find() never looks at them for this table, and no other table covers them.
+    unsigned long Slot;
+    uint32_t SetHandles = AssignedHandlesBitMap;
+    while (_BitScanForward(&Slot, SetHandles))
+    {
+        SetHandles ^= (1 << Slot);
+        m_HeapSources[HeapOffset + Slot] = Handles[Slot];
+    }
+
+    // Direct mapped:  a newer table replaces whatever shared its slot.
+    Entry& Target = m_Entries[EntryIndex(Hash)];
+    Target.Hash = Hash;
+    Target.AssignedHandlesBitMap = AssignedHandlesBitMap;
+    Target.HeapOffset = HeapOffset;
+}
+
+uint32_t DescriptorTableReuseCache::EntryIndex( size_t Hash )
+{
+    // Descriptor handles are multiples of the descriptor size, which leaves the low bits of the hash poorly
+    // mixed.  Fibonacci hashing takes the index from the top bits of the product instead.
+    return (uint32_t)(((uint64_t)Hash * 0x9E3779B97F4A7C15ull) >> (64 - kEntryIndexBits));
+}
+
+void DescriptorTableReuseCache::Clear( void )
+{
+    for (uint32_t i = 0; i < kNumEntries; ++i)
+        m_Entries[i].AssignedHandlesBitMap = 0;
+}
+
+void DescriptorTableReuseCache::Validate( uint32_t RecycleCount )
+{
+    if (RecycleCount != m_RecycleCount)
+    {
+        Clear();
+        m_RecycleCount = RecycleCount;
+    }
+}
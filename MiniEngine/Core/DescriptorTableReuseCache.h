@@ -0,0 +1,66 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Remembers which descriptor tables a DynamicDescriptorHeap has already copied into its current shader-visible
+// heap, so that a draw binding the same handles as an earlier one can point at the earlier copy instead of making
+// a new one.  Tables are keyed by a hash of their CPU handles and which slots are set.  A hit is confirmed against
+// the handles that were actually copied into the heap, so a hash collision never binds the wrong descriptors.
+//
+// Reuse assumes that the view behind a CPU handle doesn't change while it can still be looked up.  Descriptors are
+// written once when their resource is created, and DescriptorAllocator::Free() bumps the recycle count, which
+// empties the cache the next time it is consulted.
+//
+
+#pragma once
+
+#include <vector>
+
+class DescriptorTableReuseCache
+{
+public:
+    // HeapSize is the number of descriptors in each shader-visible heap.
+    DescriptorTableReuseCache( uint32_t HeapSize );
+
+    // Hash of the handles selected by AssignedHandlesBitMap.  Unset slots don't contribute.
+    static size_t HashTable( const D3D12_CPU_DESCRIPTOR_HANDLE* Handles, uint32_t AssignedHandlesBitMap );
+
+    // Returns true and the table's offset in the current heap if an identical table has been copied there.
+    bool Find( size_t Hash, const D3D12_CPU_DESCRIPTOR_HANDLE* Handles, uint32_t AssignedHandlesBitMap, uint32_t& HeapOffset ) const;
+
+    // Records a table just copied to HeapOffset.  The slots it covers must not have been written before.
+    void Insert( size_t Hash, const D3D12_CPU_DESCRIPTOR_HANDLE* Handles, uint32_t AssignedHandlesBitMap, uint32_t HeapOffset );
+
+    // Forget everything.  Called when the current heap is retired.
+    void Clear( void );
+
+    // Clears the cache if any descriptors have been recycled since the last call.
+    void Validate( uint32_t RecycleCount );
+
+private:
+    static const uint32_t kEntryIndexBits = 7;
+    static const uint32_t kNumEntries = 1 << kEntryIndexBits;
+
+    static uint32_t EntryIndex( size_t Hash );
+
+    struct Entry
+    {
+        size_t Hash;
+        uint32_t AssignedHandlesBitMap;     // Zero when the entry is empty
+        uint32_t HeapOffset;
+    };
+
+    Entry m_Entries[kNumEntries];
+
+    // The CPU handle that was copied into each slot of the current heap
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_HeapSources;
+    uint32_t m_RecycleCount;
+};
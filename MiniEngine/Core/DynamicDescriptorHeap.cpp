@@ -13,9 +13,6 @@
 
 #include "pch.h"
 #include "DynamicDescriptorHeap.h"
-#include "CommandContext.h"
-#include "GraphicsCore.h"
-#include "CommandListManager.h"
 #include "RootSignature.h"
 
 using namespace Graphics;
@@ -25,48 +22,13 @@ using namespace Graphics;
 //
 
 std::mutex DynamicDescriptorHeap::sm_Mutex;
-std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DynamicDescriptorHeap::sm_DescriptorHeapPool[2];
-std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> DynamicDescriptorHeap::sm_RetiredDescriptorHeaps[2];
-std::queue<ID3D12DescriptorHeap*> DynamicDescriptorHeap::sm_AvailableDescriptorHeaps[2];
+DynamicDescriptorHeap::Statistics DynamicDescriptorHeap::sm_Statistics[2];
 
-ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType)
-{
-    std::lock_guard<std::mutex> LockGuard(sm_Mutex);
-
-    uint32_t idx = HeapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
-
-    while (!sm_RetiredDescriptorHeaps[idx].empty() && g_CommandManager.IsFenceComplete(sm_RetiredDescriptorHeaps[idx].front().first))
-    {
-        sm_AvailableDescriptorHeaps[idx].push(sm_RetiredDescriptorHeaps[idx].front().second);
-        sm_RetiredDescriptorHeaps[idx].pop();
-    }
-
-    if (!sm_AvailableDescriptorHeaps[idx].empty())
-    {
-        ID3D12DescriptorHeap* HeapPtr = sm_AvailableDescriptorHeaps[idx].front();
-        sm_AvailableDescriptorHeaps[idx].pop();
-        return HeapPtr;
-    }
-    else
-    {
-        D3D12_DESCRIPTOR_HEAP_DESC HeapDesc = {};
-        HeapDesc.Type = HeapType;
-        HeapDesc.NumDescriptors = kNumDescriptorsPerHeap;
-        HeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-        HeapDesc.NodeMask = 1;
-        Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> HeapPtr;
-        ASSERT_SUCCEEDED(g_Device->CreateDescriptorHeap(&HeapDesc, MY_IID_PPV_ARGS(&HeapPtr)));
-        sm_DescriptorHeapPool[idx].emplace_back(HeapPtr);
-        return HeapPtr.Get();
-    }
-}
-
-void DynamicDescriptorHeap::DiscardDescriptorHeaps( D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t FenceValue, const std::vector<ID3D12DescriptorHeap*>& UsedHeaps )
+DynamicDescriptorHeap::Statistics DynamicDescriptorHeap::GetStatistics( D3D12_DESCRIPTOR_HEAP_TYPE HeapType )
 {
     uint32_t idx = HeapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
     std::lock_guard<std::mutex> LockGuard(sm_Mutex);
-    for (auto iter = UsedHeaps.begin(); iter != UsedHeaps.end(); ++iter)
-        sm_RetiredDescriptorHeaps[idx].push(std::make_pair(FenceValue, *iter));
+    return sm_Statistics[idx];
 }
 
 void DynamicDescriptorHeap::RetireCurrentHeap( void )
@@ -82,20 +44,30 @@ void DynamicDescriptorHeap::RetireCurrentHeap( void )
     m_RetiredHeaps.push_back(m_CurrentHeapPtr);
     m_CurrentHeapPtr = nullptr;
     m_CurrentOffset = 0;
+    m_ReuseCache.Clear();
 }
 
 void DynamicDescriptorHeap::RetireUsedHeaps( uint64_t fenceValue )
 {
-    DiscardDescriptorHeaps(m_DescriptorType, fenceValue, m_RetiredHeaps);
+    m_Provider.DiscardHeaps(m_DescriptorType, fenceValue, m_RetiredHeaps);
     m_RetiredHeaps.clear();
+
+    uint32_t idx = m_DescriptorType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
+    std::lock_guard<std::mutex> LockGuard(sm_Mutex);
+    sm_Statistics[idx].TablesCopied += m_Statistics.TablesCopied;
+    sm_Statistics[idx].TablesReused += m_Statistics.TablesReused;
+    sm_Statistics[idx].DescriptorsCopied += m_Statistics.DescriptorsCopied;
+    sm_Statistics[idx].CopyCalls += m_Statistics.CopyCalls;
+    ZeroMemory(&m_Statistics, sizeof(m_Statistics));
 }
 
-DynamicDescriptorHeap::DynamicDescriptorHeap(CommandContext& OwningContext, D3D12_DESCRIPTOR_HEAP_TYPE HeapType)
-    : m_OwningContext(OwningContext), m_DescriptorType(HeapType)
+DynamicDescriptorHeap::DynamicDescriptorHeap(DynamicDescriptorHeapProvider& Provider, D3D12_DESCRIPTOR_HEAP_TYPE HeapType)
+    : m_Provider(Provider), m_DescriptorType(HeapType), m_ReuseCache(kNumDescriptorsPerHeap)
 {
     m_CurrentHeapPtr = nullptr;
     m_CurrentOffset = 0;
     m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(HeapType);
+    ZeroMemory(&m_Statistics, sizeof(m_Statistics));
 }
 
 DynamicDescriptorHeap::~DynamicDescriptorHeap()
@@ -115,7 +87,7 @@ inline ID3D12DescriptorHeap* DynamicDescriptorHeap::GetHeapPointer()
     if (m_CurrentHeapPtr == nullptr)
     {
         ASSERT(m_CurrentOffset == 0);
-        m_CurrentHeapPtr = RequestDescriptorHeap(m_DescriptorType);
+        m_CurrentHeapPtr = m_Provider.RequestHeap(m_DescriptorType);
         m_FirstDescriptor = DescriptorHandle(
             m_CurrentHeapPtr->GetCPUDescriptorHandleForHeapStart(),
             m_CurrentHeapPtr->GetGPUDescriptorHandleForHeapStart());
@@ -146,7 +118,7 @@ uint32_t DynamicDescriptorHeap::DescriptorHandleCache::ComputeStagedSize()
 void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
     D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize,
     DescriptorHandle DestHandleStart, ID3D12GraphicsCommandList* CmdList,
-    void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE))
+    void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE), Statistics& Stats)
 {
     uint32_t StaleParamCount = 0;
     uint32_t TableSize[DescriptorHandleCache::kMaxNumDescriptorTables];
@@ -175,6 +147,7 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
         "We're only equipped to handle so many descriptor tables");
 
     m_StaleRootParamsBitMap = 0;
+    Stats.TablesCopied += StaleParamCount;
 
     static const uint32_t kMaxDescriptorsPerCopy = 16;
     UINT NumDestDescriptorRanges = 0;
@@ -216,6 +189,7 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
                     NumDestDescriptorRanges, pDestDescriptorRangeStarts, pDestDescriptorRangeSizes,
                     NumSrcDescriptorRanges, pSrcDescriptorRangeStarts, pSrcDescriptorRangeSizes,
                     Type);
+                ++Stats.CopyCalls;
 
                 NumSrcDescriptorRanges = 0;
                 NumDestDescriptorRanges = 0;
@@ -225,6 +199,7 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
             pDestDescriptorRangeStarts[NumDestDescriptorRanges] = CurDest;
             pDestDescriptorRangeSizes[NumDestDescriptorRanges] = DescriptorCount;
             ++NumDestDescriptorRanges;
+            Stats.DescriptorsCopied += DescriptorCount;
 
             // Setup source ranges (one descriptor each because we don't assume they are contiguous)
             for (uint32_t j = 0; j < DescriptorCount; ++j)
@@ -244,11 +219,44 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
         NumDestDescriptorRanges, pDestDescriptorRangeStarts, pDestDescriptorRangeSizes,
         NumSrcDescriptorRanges, pSrcDescriptorRangeStarts, pSrcDescriptorRangeSizes,
         Type);
+    ++Stats.CopyCalls;
 }
     
 void DynamicDescriptorHeap::CopyAndBindStagedTables( DescriptorHandleCache& HandleCache, ID3D12GraphicsCommandList* CmdList,
     void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE))
 {
+    size_t TableHashes[DescriptorHandleCache::kMaxNumDescriptorTables];
+    uint32_t HashedTables = 0;
+    unsigned long RootIndex;
+
+    // Bind any table that was already copied into the current heap to that copy
+    if (m_CurrentHeapPtr != nullptr)
+    {
+        m_ReuseCache.Validate(DescriptorAllocator::GetRecycleCount());
+
+        uint32_t StaleParams = HandleCache.m_StaleRootParamsBitMap;
+        while (_BitScanForward(&RootIndex, StaleParams))
+        {
+            StaleParams ^= (1 << RootIndex);
+
+            DescriptorTableCache& RootDescTable = HandleCache.m_RootDescriptorTable[RootIndex];
+            TableHashes[RootIndex] = DescriptorTableReuseCache::HashTable(RootDescTable.TableStart, RootDescTable.AssignedHandlesBitMap);
+            HashedTables |= (1 << RootIndex);
+
+            uint32_t HeapOffset;
+            if (m_ReuseCache.Find(TableHashes[RootIndex], RootDescTable.TableStart, RootDescTable.AssignedHandlesBitMap, HeapOffset))
+            {
+                m_Provider.SetDescriptorHeap(m_DescriptorType, m_CurrentHeapPtr);
+                (CmdList->*SetFunc)(RootIndex, (m_FirstDescriptor + HeapOffset * m_DescriptorSize).GetGpuHandle());
+                HandleCache.m_StaleRootParamsBitMap ^= (1 << RootIndex);
+                ++m_Statistics.TablesReused;
+            }
+        }
+
+        if (HandleCache.m_StaleRootParamsBitMap == 0)
+            return;
+    }
+
     uint32_t NeededSize = HandleCache.ComputeStagedSize();
     if (!HasSpace(NeededSize))
     {
@@ -258,8 +266,26 @@ void DynamicDescriptorHeap::CopyAndBindStagedTables( DescriptorHandleCache& Hand
     }
 
     // This can trigger the creation of a new heap
-    m_OwningContext.SetDescriptorHeap(m_DescriptorType, GetHeapPointer());
-    HandleCache.CopyAndBindStaleTables(m_DescriptorType, m_DescriptorSize, Allocate(NeededSize), CmdList, SetFunc);
+    m_Provider.SetDescriptorHeap(m_DescriptorType, GetHeapPointer());
+
+    // Remember where each table will land.  They are copied in root index order, each taking up to its last set handle.
+    uint32_t HeapOffset = m_CurrentOffset;
+    uint32_t StaleParams = HandleCache.m_StaleRootParamsBitMap;
+    while (_BitScanForward(&RootIndex, StaleParams))
+    {
+        StaleParams ^= (1 << RootIndex);
+
+        DescriptorTableCache& RootDescTable = HandleCache.m_RootDescriptorTable[RootIndex];
+        size_t Hash = (HashedTables & (1 << RootIndex)) != 0 ? TableHashes[RootIndex] :
+            DescriptorTableReuseCache::HashTable(RootDescTable.TableStart, RootDescTable.AssignedHandlesBitMap);
+        m_ReuseCache.Insert(Hash, RootDescTable.TableStart, RootDescTable.AssignedHandlesBitMap, HeapOffset);
+
+        unsigned long MaxSetHandle;
+        _BitScanReverse(&MaxSetHandle, RootDescTable.AssignedHandlesBitMap);
+        HeapOffset += MaxSetHandle + 1;
+    }
+
+    HandleCache.CopyAndBindStaleTables(m_DescriptorType, m_DescriptorSize, Allocate(NeededSize), CmdList, SetFunc, m_Statistics);
 }
 
 void DynamicDescriptorHeap::UnbindAllValid( void )
@@ -276,12 +302,14 @@ D3D12_GPU_DESCRIPTOR_HANDLE DynamicDescriptorHeap::UploadDirect( D3D12_CPU_DESCR
         UnbindAllValid();
     }
 
-    m_OwningContext.SetDescriptorHeap(m_DescriptorType, GetHeapPointer());
+    m_Provider.SetDescriptorHeap(m_DescriptorType, GetHeapPointer());
 
     DescriptorHandle DestHandle = m_FirstDescriptor + m_CurrentOffset * m_DescriptorSize;
     m_CurrentOffset += 1;
 
     g_Device->CopyDescriptorsSimple(1, DestHandle.GetCpuHandle(), Handle, m_DescriptorType);
+    ++m_Statistics.DescriptorsCopied;
+    ++m_Statistics.CopyCalls;
 
     return DestHandle.GetGpuHandle();
 }
@@ -15,6 +15,7 @@
 
 #include "DescriptorHeap.h"
 #include "RootSignature.h"
+#include "DescriptorTableReuseCache.h"
 #include <vector>
 #include <queue>
 
@@ -23,13 +24,38 @@ namespace Graphics
     extern ID3D12Device* g_Device;
 }
 
+class CommandContext;
+
+// Source of the shader-visible heaps that a DynamicDescriptorHeap fills, and the context it binds them on.  The
+// default provider (DynamicDescriptorHeapProvider.cpp) shares a pool of heaps on the graphics device, recycled by
+// g_CommandManager's fences, and binds them on the owning CommandContext.  Any other provider lets tables be staged,
+// copied and reused without a device or a context.  Descriptors are always copied with Graphics::g_Device.
+class DynamicDescriptorHeapProvider
+{
+public:
+    virtual ~DynamicDescriptorHeapProvider() {}
+    virtual ID3D12DescriptorHeap* RequestHeap( D3D12_DESCRIPTOR_HEAP_TYPE HeapType ) = 0;
+    virtual void DiscardHeaps( D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t FenceValue, const std::vector<ID3D12DescriptorHeap*>& UsedHeaps ) = 0;
+    virtual void SetDescriptorHeap( D3D12_DESCRIPTOR_HEAP_TYPE HeapType, ID3D12DescriptorHeap* HeapPtr ) = 0;
+};
+
 // This class is a linear allocation system for dynamically generated descriptor tables.  It internally caches
 // CPU descriptor handles so that when not enough space is available in the current heap, necessary descriptors
-// can be re-copied to the new heap.
+// can be re-copied to the new heap.  A table whose handles match one already copied into the current heap is
+// bound to that copy rather than copied again.
 class DynamicDescriptorHeap
 {
 public:
+    struct Statistics
+    {
+        uint64_t TablesCopied;          // Descriptor tables copied into a shader-visible heap
+        uint64_t TablesReused;          // Descriptor tables bound to an earlier copy
+        uint64_t DescriptorsCopied;     // Descriptors copied, including UploadDirect()
+        uint64_t CopyCalls;             // Calls to CopyDescriptors() and CopyDescriptorsSimple()
+    };
+
     DynamicDescriptorHeap(CommandContext& OwningContext, D3D12_DESCRIPTOR_HEAP_TYPE HeapType);
+    DynamicDescriptorHeap(DynamicDescriptorHeapProvider& Provider, D3D12_DESCRIPTOR_HEAP_TYPE HeapType);
     ~DynamicDescriptorHeap();
 
     static void DestroyAll(void)
@@ -38,6 +64,9 @@ public:
         sm_DescriptorHeapPool[1].clear();
     }
 
+    // Totals over every command list finished so far.  Sample it once a frame for per-frame figures.
+    static Statistics GetStatistics( D3D12_DESCRIPTOR_HEAP_TYPE HeapType );
+
     void CleanupUsedHeaps( uint64_t fenceValue );
 
     // Copy multiple handles into the cache area reserved for the specified root parameter.
@@ -78,27 +107,34 @@ public:
             CopyAndBindStagedTables(m_ComputeHandleCache, CmdList, &ID3D12GraphicsCommandList::SetComputeRootDescriptorTable);
     }
 
+    static const uint32_t kNumDescriptorsPerHeap = 1024;
+
 private:
 
+    class ContextProvider;
+
     // Static members
-    static const uint32_t kNumDescriptorsPerHeap = 1024;
     static std::mutex sm_Mutex;
     static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_DescriptorHeapPool[2];
     static std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> sm_RetiredDescriptorHeaps[2];
     static std::queue<ID3D12DescriptorHeap*> sm_AvailableDescriptorHeaps[2];
+    static Statistics sm_Statistics[2];
 
     // Static methods
     static ID3D12DescriptorHeap* RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType);
     static void DiscardDescriptorHeaps( D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t FenceValueForReset, const std::vector<ID3D12DescriptorHeap*>& UsedHeaps );
 
     // Non-static members
-    CommandContext& m_OwningContext;
+    std::unique_ptr<DynamicDescriptorHeapProvider> m_ContextProvider;     // Only set for a CommandContext's heaps
+    DynamicDescriptorHeapProvider& m_Provider;
     ID3D12DescriptorHeap* m_CurrentHeapPtr;
     const D3D12_DESCRIPTOR_HEAP_TYPE m_DescriptorType;
     uint32_t m_DescriptorSize;
     uint32_t m_CurrentOffset;
     DescriptorHandle m_FirstDescriptor;
     std::vector<ID3D12DescriptorHeap*> m_RetiredHeaps;
+    DescriptorTableReuseCache m_ReuseCache;
+    Statistics m_Statistics;
 
     // Describes a descriptor table entry:  a region of the handle cache and which handles have been set
     struct DescriptorTableCache
@@ -131,7 +167,7 @@ private:
 
         uint32_t ComputeStagedSize();
         void CopyAndBindStaleTables( D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize, DescriptorHandle DestHandleStart, ID3D12GraphicsCommandList* CmdList,
-            void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE));
+            void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE), Statistics& Stats);
 
         DescriptorTableCache m_RootDescriptorTable[kMaxNumDescriptorTables];
         D3D12_CPU_DESCRIPTOR_HANDLE m_HandleCache[kMaxNumDescriptors];
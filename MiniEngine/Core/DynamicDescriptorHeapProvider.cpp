@@ -0,0 +1,95 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard 
+//
+
+#include "pch.h"
+#include "DynamicDescriptorHeap.h"
+#include "CommandContext.h"
+#include "GraphicsCore.h"
+#include "CommandListManager.h"
+
+using namespace Graphics;
+
+std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DynamicDescriptorHeap::sm_DescriptorHeapPool[2];
+std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> DynamicDescriptorHeap::sm_RetiredDescriptorHeaps[2];
+std::queue<ID3D12DescriptorHeap*> DynamicDescriptorHeap::sm_AvailableDescriptorHeaps[2];
+
+ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType)
+{
+    std::lock_guard<std::mutex> LockGuard(sm_Mutex);
+
+    uint32_t idx = HeapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
+
+    while (!sm_RetiredDescriptorHeaps[idx].empty() && g_CommandManager.IsFenceComplete(sm_RetiredDescriptorHeaps[idx].front().first))
+    {
+        sm_AvailableDescriptorHeaps[idx].push(sm_RetiredDescriptorHeaps[idx].front().second);
+        sm_RetiredDescriptorHeaps[idx].pop();
+    }
+
+    if (!sm_AvailableDescriptorHeaps[idx].empty())
+    {
+        ID3D12DescriptorHeap* HeapPtr = sm_AvailableDescriptorHeaps[idx].front();
+        sm_AvailableDescriptorHeaps[idx].pop();
+        return HeapPtr;
+    }
+    else
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC HeapDesc = {};
+        HeapDesc.Type = HeapType;
+        HeapDesc.NumDescriptors = kNumDescriptorsPerHeap;
+        HeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+        HeapDesc.NodeMask = 1;
+        Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> HeapPtr;
+        ASSERT_SUCCEEDED(g_Device->CreateDescriptorHeap(&HeapDesc, MY_IID_PPV_ARGS(&HeapPtr)));
+        sm_DescriptorHeapPool[idx].emplace_back(HeapPtr);
+        return HeapPtr.Get();
+    }
+}
+
+void DynamicDescriptorHeap::DiscardDescriptorHeaps( D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t FenceValue, const std::vector<ID3D12DescriptorHeap*>& UsedHeaps )
+{
+    uint32_t idx = HeapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
+    std::lock_guard<std::mutex> LockGuard(sm_Mutex);
+    for (auto iter = UsedHeaps.begin(); iter != UsedHeaps.end(); ++iter)
+        sm_RetiredDescriptorHeaps[idx].push(std::make_pair(FenceValue, *iter));
+}
+
+// The shared heap pool, with heaps bound on the CommandContext that owns the DynamicDescriptorHeap
+class DynamicDescriptorHeap::ContextProvider : public DynamicDescriptorHeapProvider
+{
+public:
+    ContextProvider( CommandContext& OwningContext ) : m_OwningContext(OwningContext) {}
+
+    ID3D12DescriptorHeap* RequestHeap( D3D12_DESCRIPTOR_HEAP_TYPE HeapType ) override
+    {
+        return RequestDescriptorHeap(HeapType);
+    }
+
+    void DiscardHeaps( D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t FenceValue, const std::vector<ID3D12DescriptorHeap*>& UsedHeaps ) override
+    {
+        DiscardDescriptorHeaps(HeapType, FenceValue, UsedHeaps);
+    }
+
+    void SetDescriptorHeap( D3D12_DESCRIPTOR_HEAP_TYPE HeapType, ID3D12DescriptorHeap* HeapPtr ) override
+    {
+        m_OwningContext.SetDescriptorHeap(HeapType, HeapPtr);
+    }
+
+private:
+    CommandContext& m_OwningContext;
+};
+
+DynamicDescriptorHeap::DynamicDescriptorHeap(CommandContext& OwningContext, D3D12_DESCRIPTOR_HEAP_TYPE HeapType)
+    : DynamicDescriptorHeap(*new ContextProvider(OwningContext), HeapType)
+{
+    m_ContextProvider.reset(&m_Provider);
+}
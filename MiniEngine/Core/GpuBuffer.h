@@ -24,6 +24,9 @@ class GpuBuffer : public GpuResource
 public:
     virtual ~GpuBuffer() { Destroy(); }
 
+    // Release the resource and return its views to the descriptor allocator
+    virtual void Destroy( void ) override;
+
     // Create a buffer.  If initial data is provided, it will be copied into the buffer using the default command context.
     void Create( const std::wstring& name, uint32_t NumElements, uint32_t ElementSize,
         const void* initialData = nullptr );
@@ -18,6 +18,7 @@ class GpuResource
     friend class CommandContext;
     friend class GraphicsContext;
     friend class ComputeContext;
+    friend class ResourceBarrierTracker;
 
 public:
     GpuResource() : 
@@ -39,6 +40,7 @@ public:
     virtual void Destroy()
     {
         m_pResource = nullptr;
+        m_SubresourceStates.clear();
         m_GpuVirtualAddress = D3D12_GPU_VIRTUAL_ADDRESS_NULL;
         if (m_UserAllocatedMemory != nullptr)
         {
@@ -59,7 +61,14 @@ protected:
 
     Microsoft::WRL::ComPtr<ID3D12Resource> m_pResource;
     D3D12_RESOURCE_STATES m_UsageState;
+
+    // The state that an open split barrier is taking the resource (or one of its subresources) to, or -1.
+    // ResourceBarrierTracker keeps the details of each split.
     D3D12_RESOURCE_STATES m_TransitioningState;
+
+    // Empty while all subresources share m_UsageState.  Once one of them is transitioned on its own, this
+    // holds the state of each subresource and m_UsageState is out of date.
+    std::vector<D3D12_RESOURCE_STATES> m_SubresourceStates;
     D3D12_GPU_VIRTUAL_ADDRESS m_GpuVirtualAddress;
 
     // When using VirtualAlloc() to allocate memory directly, record the allocation here so that it can be freed.  The
@@ -189,10 +189,10 @@ namespace Graphics
 
     DescriptorAllocator g_DescriptorAllocator[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES] =
     {
-        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
-        D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER,
-        D3D12_DESCRIPTOR_HEAP_TYPE_RTV,
-        D3D12_DESCRIPTOR_HEAP_TYPE_DSV,
+        { D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV },
+        { D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER },
+        { D3D12_DESCRIPTOR_HEAP_TYPE_RTV },
+        { D3D12_DESCRIPTOR_HEAP_TYPE_DSV },
     };
 
     RootSignature s_PresentRS;
@@ -601,7 +601,6 @@ void Graphics::Shutdown( void )
     s_SwapChain1->Release();
     PSO::DestroyAll();
     RootSignature::DestroyAll();
-    DescriptorAllocator::DestroyAll();
 
     DestroyCommonState();
     DestroyRenderingBuffers();
@@ -618,6 +617,9 @@ void Graphics::Shutdown( void )
 
     g_PreDisplayBuffer.Destroy();
 
+    // Last, because destroying the buffers and textures above returns their views to the allocators
+    DescriptorAllocator::DestroyAll();
+
 #if defined(_DEBUG)
     ID3D12DebugDevice* debugInterface;
     if (SUCCEEDED(g_Device->QueryInterface(&debugInterface)))
@@ -68,6 +68,12 @@ namespace Graphics
     {
         return g_DescriptorAllocator[Type].Allocate(Count);
     }
+    // Resources that outlive the device (e.g. globals destroyed at exit) have nothing left to return their views to.
+    inline void FreeDescriptor( D3D12_DESCRIPTOR_HEAP_TYPE Type, D3D12_CPU_DESCRIPTOR_HANDLE Handle, UINT Count = 1 )
+    {
+        if (g_Device != nullptr)
+            g_DescriptorAllocator[Type].Free(Handle, Count);
+    }
 
     extern RootSignature g_GenerateMipsRS;
     extern ComputePSO g_GenerateMipsLinearPSO[4];
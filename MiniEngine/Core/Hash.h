@@ -63,4 +63,85 @@ namespace Utility
         return HashRange((uint32_t*)StateDesc, (uint32_t*)(StateDesc + Count), Hash);
     }
 
+    // A 64-bit hash of any byte range, for keys that must not collide in practice.  This is XXH64, which needs
+    // nothing beyond 64-bit multiplies.  It costs a few nanoseconds more than HashRange() on a small state and
+    // is faster on anything over a few hundred bytes.
+    inline uint64_t HashBytes64( const void* Data, size_t NumBytes, uint64_t Seed = 0 )
+    {
+        const uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+        const uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+        const uint64_t Prime3 = 0x165667B19E3779F9ull;
+        const uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+        const uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+        struct Local
+        {
+            static uint64_t Rotate( uint64_t X, int Bits ) { return (X << Bits) | (X >> (64 - Bits)); }
+            static uint64_t Read64( const uint8_t* P ) { uint64_t X; memcpy(&X, P, 8); return X; }
+            static uint32_t Read32( const uint8_t* P ) { uint32_t X; memcpy(&X, P, 4); return X; }
+            static uint64_t Round( uint64_t Acc, uint64_t Input )
+            {
+                return Rotate(Acc + Input * Prime2, 31) * Prime1;
+            }
+            static uint64_t Merge( uint64_t Acc, uint64_t Lane )
+            {
+                return (Acc ^ Round(0, Lane)) * Prime1 + Prime4;
+            }
+        };
+
+        const uint8_t* Iter = (const uint8_t*)Data;
+        const uint8_t* const End = Iter + NumBytes;
+        uint64_t Hash;
+
+        // Four independent lanes over 32-byte stripes
+        if (NumBytes >= 32)
+        {
+            uint64_t Lane0 = Seed + Prime1 + Prime2;
+            uint64_t Lane1 = Seed + Prime2;
+            uint64_t Lane2 = Seed;
+            uint64_t Lane3 = Seed - Prime1;
+
+            for (const uint8_t* const Last = End - 32; Iter <= Last; Iter += 32)
+            {
+                Lane0 = Local::Round(Lane0, Local::Read64(Iter));
+                Lane1 = Local::Round(Lane1, Local::Read64(Iter + 8));
+                Lane2 = Local::Round(Lane2, Local::Read64(Iter + 16));
+                Lane3 = Local::Round(Lane3, Local::Read64(Iter + 24));
+            }
+
+            Hash = Local::Rotate(Lane0, 1) + Local::Rotate(Lane1, 7) + Local::Rotate(Lane2, 12) + Local::Rotate(Lane3, 18);
+            Hash = Local::Merge(Hash, Lane0);
+            Hash = Local::Merge(Hash, Lane1);
+            Hash = Local::Merge(Hash, Lane2);
+            Hash = Local::Merge(Hash, Lane3);
+        }
+        else
+        {
+            Hash = Seed + Prime5;
+        }
+
+        Hash += NumBytes;
+
+        for (; Iter + 8 <= End; Iter += 8)
+            Hash = Local::Rotate(Hash ^ Local::Round(0, Local::Read64(Iter)), 27) * Prime1 + Prime4;
+
+        if (Iter + 4 <= End)
+        {
+            Hash = Local::Rotate(Hash ^ (Local::Read32(Iter) * Prime1), 23) * Prime2 + Prime3;
+            Iter += 4;
+        }
+
+        for (; Iter < End; ++Iter)
+            Hash = Local::Rotate(Hash ^ (*Iter * Prime5), 11) * Prime1;
+
+        // Avalanche
+        Hash ^= Hash >> 33;
+        Hash *= Prime2;
+        Hash ^= Hash >> 29;
+        Hash *= Prime3;
+        Hash ^= Hash >> 32;
+
+        return Hash;
+    }
+
 } // namespace Utility
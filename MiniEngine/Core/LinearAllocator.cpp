@@ -14,138 +14,289 @@
 
 #include "pch.h"
 #include "LinearAllocator.h"
-#include "GraphicsCore.h"
-#include "CommandListManager.h"
-#include <thread>
+#include <algorithm>
 
-using namespace Graphics;
 using namespace std;
 
-LinearAllocatorType LinearAllocatorPageManager::sm_AutoType = kGpuExclusive;
-
-LinearAllocatorPageManager::LinearAllocatorPageManager()
+LinearAllocatorPageManager::LinearAllocatorPageManager( LinearAllocatorType Type, LinearAllocatorPageProvider* Provider ) :
+    m_AllocationType(Type),
+    m_Provider(Provider),
+    m_AvailableLargeBytes(0),
+    m_Generation(1),
+    m_NumCreated(0),
+    m_NumReused(0),
+    m_NumMagazineHits(0),
+    m_NumLargeCreated(0),
+    m_NumLargeReused(0),
+    m_NumLargeDestroyed(0)
 {
-    m_AllocationType = sm_AutoType;
-    sm_AutoType = (LinearAllocatorType)(sm_AutoType + 1);
-    ASSERT(sm_AutoType <= kNumAllocatorTypes);
+    ASSERT(Type > kInvalidAllocator && Type < kNumAllocatorTypes);
+    m_PageSize = (Type == kGpuExclusive ? kGpuAllocatorPageSize : kCpuAllocatorPageSize);
+    m_MagazineBatch = (uint32_t)max<size_t>(1, min<size_t>(sm_MaxMagazineSize, sm_MagazineBytes / m_PageSize));
 }
 
-LinearAllocatorPageManager LinearAllocator::sm_PageManager[2];
+LinearAllocatorPageManager::~LinearAllocatorPageManager()
+{
+    Destroy();
 
-LinearAllocationPage* LinearAllocatorPageManager::RequestPage()
+    Magazine* Mag = GetThreadMagazine();
+    if (Mag != nullptr)
+    {
+        Mag->Owner = nullptr;
+        Mag->Count = 0;
+        Mag->Hits = 0;
+    }
+}
+
+void LinearAllocatorPageManager::Destroy( void )
 {
     lock_guard<mutex> LockGuard(m_Mutex);
 
-    while (!m_RetiredPages.empty() && g_CommandManager.IsFenceComplete(m_RetiredPages.front().first))
+    // Regular pages are owned by the pool.  Large pages are owned by whichever list holds them.
+    for (uint32_t i = 0; i < _countof(m_RetiredPages); ++i)
     {
-        m_AvailablePages.push(m_RetiredPages.front().second);
-        m_RetiredPages.pop();
+        for (auto& Batch : m_RetiredPages[i])
+        {
+            for (LinearAllocationPage* Page : Batch.LargePages)
+                delete Page;
+        }
+        m_RetiredPages[i].clear();
     }
 
-    LinearAllocationPage* PagePtr = nullptr;
+    for (auto& Entry : m_AvailableLargePages)
+        delete Entry.second;
+    m_AvailableLargePages.clear();
+    m_AvailableLargeBytes = 0;
 
-    if (!m_AvailablePages.empty())
+    m_AvailablePages.clear();
+    m_PagePool.clear();
+    ++m_Generation;
+}
+
+thread_local LinearAllocatorPageManager::Magazine LinearAllocatorPageManager::sm_ThreadMagazines[kNumAllocatorTypes];
+
+LinearAllocatorPageManager::Magazine::~Magazine()
+{
+    if (Owner == nullptr)
+        return;
+
+    Owner->AddMagazineHits(*this);
+    if (Count == 0)
+        return;
+
+    lock_guard<mutex> LockGuard(Owner->m_Mutex);
+    if (Generation == Owner->m_Generation)
+        Owner->m_AvailablePages.insert(Owner->m_AvailablePages.end(), Pages, Pages + Count);
+    Count = 0;
+}
+
+LinearAllocatorPageManager::Magazine* LinearAllocatorPageManager::GetThreadMagazine( void )
+{
+    // The global page managers own the magazines.  Any other manager of the same type (e.g. one driven by a test
+    // provider) uses the shared pool only, unless it is the first one a thread uses.
+    Magazine& Mag = sm_ThreadMagazines[m_AllocationType];
+    if (Mag.Owner == nullptr)
+        Mag.Owner = this;
+    else if (Mag.Owner != this)
+        return nullptr;
+
+    uint32_t CurrentGeneration = m_Generation.load(memory_order_relaxed);
+    if (Mag.Generation != CurrentGeneration)
     {
-        PagePtr = m_AvailablePages.front();
-        m_AvailablePages.pop();
+        Mag.Generation = CurrentGeneration;
+        Mag.Count = 0;
     }
-    else
+
+    return &Mag;
+}
+
+void LinearAllocatorPageManager::AddMagazineHits( Magazine& Mag )
+{
+    // Shared counters would be written by every thread on every hit, so each magazine keeps its own
+    if (Mag.Hits != 0)
     {
-        PagePtr = CreateNewPage();
-        m_PagePool.emplace_back(PagePtr);
+        m_NumReused += Mag.Hits;
+        m_NumMagazineHits += Mag.Hits;
+        Mag.Hits = 0;
     }
+}
 
-    return PagePtr;
+void LinearAllocatorPageManager::CollectRetiredPagesLocked( vector<LinearAllocationPage*>& PagesToDelete )
+{
+    // Fence values only increase within a queue, so each list can stop at the first batch still in flight.
+    for (uint32_t i = 0; i < _countof(m_RetiredPages); ++i)
+    {
+        deque<RetiredBatch>& Retired = m_RetiredPages[i];
+        while (!Retired.empty() && m_Provider->IsFenceComplete(Retired.front().FenceValue))
+        {
+            RetiredBatch& Batch = Retired.front();
+            m_AvailablePages.insert(m_AvailablePages.end(), Batch.Pages.begin(), Batch.Pages.end());
+            for (LinearAllocationPage* Page : Batch.LargePages)
+            {
+                m_AvailableLargePages.insert(make_pair(Page->m_PageSize, Page));
+                m_AvailableLargeBytes += Page->m_PageSize;
+            }
+            Retired.pop_front();
+        }
+    }
+
+    // Over budget, give up the largest pages first.  They are the least likely to fit a later request closely.
+    while (m_AvailableLargeBytes > sm_LargePageBudget)
+    {
+        auto Largest = prev(m_AvailableLargePages.end());
+        m_AvailableLargeBytes -= Largest->first;
+        PagesToDelete.push_back(Largest->second);
+        m_AvailableLargePages.erase(Largest);
+        ++m_NumLargeDestroyed;
+    }
 }
 
-void LinearAllocatorPageManager::DiscardPages( uint64_t FenceValue, const vector<LinearAllocationPage*>& UsedPages )
+LinearAllocationPage* LinearAllocatorPageManager::RequestPage()
 {
+    Magazine* Mag = GetThreadMagazine();
+    if (Mag != nullptr && Mag->Count > 0)
+    {
+        ++Mag->Hits;
+        return Mag->Pages[--Mag->Count];
+    }
+
+    if (Mag != nullptr)
+        AddMagazineHits(*Mag);
+
+    LinearAllocationPage* PagePtr = nullptr;
+    vector<LinearAllocationPage*> PagesToDelete;
+    {
+        lock_guard<mutex> LockGuard(m_Mutex);
+        CollectRetiredPagesLocked(PagesToDelete);
+
+        if (!m_AvailablePages.empty())
+        {
+            PagePtr = m_AvailablePages.back();
+            m_AvailablePages.pop_back();
+            ++m_NumReused;
+
+            // Take a batch for later, but leave at least as many for everyone else
+            if (Mag != nullptr)
+            {
+                while (Mag->Count + 1 < m_MagazineBatch && Mag->Count < m_AvailablePages.size() / 2)
+                {
+                    Mag->Pages[Mag->Count++] = m_AvailablePages.back();
+                    m_AvailablePages.pop_back();
+                }
+            }
+        }
+    }
+
+    for (LinearAllocationPage* Page : PagesToDelete)
+        delete Page;
+
+    if (PagePtr != nullptr)
+        return PagePtr;
+
+    // Creating a resource is slow, so it's done outside of the lock
+    PagePtr = CreateNewPage();
+    ++m_NumCreated;
+
     lock_guard<mutex> LockGuard(m_Mutex);
-    for (auto iter = UsedPages.begin(); iter != UsedPages.end(); ++iter)
-        m_RetiredPages.push(make_pair(FenceValue, *iter));
+    m_PagePool.emplace_back(PagePtr);
+    return PagePtr;
 }
 
-void LinearAllocatorPageManager::FreeLargePages( uint64_t FenceValue, const vector<LinearAllocationPage*>& LargePages )
+LinearAllocationPage* LinearAllocatorPageManager::RequestLargePage( size_t PageSize )
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
+    // Round up to whole pages so that sizes repeat, and accept a retired page up to a quarter larger than needed
+    PageSize = Math::AlignUp(PageSize, m_PageSize);
 
-    while (!m_DeletionQueue.empty() && g_CommandManager.IsFenceComplete(m_DeletionQueue.front().first))
+    LinearAllocationPage* PagePtr = nullptr;
+    vector<LinearAllocationPage*> PagesToDelete;
     {
-        delete m_DeletionQueue.front().second;
-        m_DeletionQueue.pop();
+        lock_guard<mutex> LockGuard(m_Mutex);
+        CollectRetiredPagesLocked(PagesToDelete);
+
+        auto BestFit = m_AvailableLargePages.lower_bound(PageSize);
+        if (BestFit != m_AvailableLargePages.end() && BestFit->first <= PageSize + PageSize / 4)
+        {
+            PagePtr = BestFit->second;
+            m_AvailableLargeBytes -= BestFit->first;
+            m_AvailableLargePages.erase(BestFit);
+            ++m_NumLargeReused;
+        }
     }
 
-    for (auto iter = LargePages.begin(); iter != LargePages.end(); ++iter)
+    for (LinearAllocationPage* Page : PagesToDelete)
+        delete Page;
+
+    if (PagePtr == nullptr)
     {
-        (*iter)->Unmap();
-        m_DeletionQueue.push(make_pair(FenceValue, *iter));
+        PagePtr = CreateNewPage(PageSize);
+        ++m_NumLargeCreated;
     }
+
+    return PagePtr;
 }
 
-LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage( size_t PageSize  )
+void LinearAllocatorPageManager::DiscardPages( uint64_t FenceValue, const vector<LinearAllocationPage*>& UsedPages,
+    const vector<LinearAllocationPage*>& LargePages )
 {
-    D3D12_HEAP_PROPERTIES HeapProps;
-    HeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-    HeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-    HeapProps.CreationNodeMask = 1;
-    HeapProps.VisibleNodeMask = 1;
-
-    D3D12_RESOURCE_DESC ResourceDesc;
-    ResourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    ResourceDesc.Alignment = 0;
-    ResourceDesc.Height = 1;
-    ResourceDesc.DepthOrArraySize = 1;
-    ResourceDesc.MipLevels = 1;
-    ResourceDesc.Format = DXGI_FORMAT_UNKNOWN;
-    ResourceDesc.SampleDesc.Count = 1;
-    ResourceDesc.SampleDesc.Quality = 0;
-    ResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-    D3D12_RESOURCE_STATES DefaultUsage;
-
-    if (m_AllocationType == kGpuExclusive)
-    {
-        HeapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
-        ResourceDesc.Width = PageSize == 0 ? kGpuAllocatorPageSize : PageSize;
-        ResourceDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-        DefaultUsage = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
-    }
-    else
+    if (UsedPages.empty() && LargePages.empty())
+        return;
+
+    lock_guard<mutex> LockGuard(m_Mutex);
+
+    // Contexts finishing on the same queue usually get increasing fence values.  Anything else joins the batch
+    // with the next higher fence, which only delays it.
+    deque<RetiredBatch>& Retired = m_RetiredPages[(FenceValue >> 56) & 3];
+    if (Retired.empty() || Retired.back().FenceValue < FenceValue)
     {
-        HeapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-        ResourceDesc.Width = PageSize == 0 ? kCpuAllocatorPageSize : PageSize;
-        ResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-        DefaultUsage = D3D12_RESOURCE_STATE_GENERIC_READ;
+        Retired.emplace_back();
+        Retired.back().FenceValue = FenceValue;
     }
 
-    ID3D12Resource* pBuffer;
-    ASSERT_SUCCEEDED( g_Device->CreateCommittedResource(&HeapProps, D3D12_HEAP_FLAG_NONE,
-        &ResourceDesc, DefaultUsage, nullptr, MY_IID_PPV_ARGS(&pBuffer)) );
+    RetiredBatch& Batch = Retired.back();
+    Batch.Pages.insert(Batch.Pages.end(), UsedPages.begin(), UsedPages.end());
+    Batch.LargePages.insert(Batch.LargePages.end(), LargePages.begin(), LargePages.end());
+}
 
-    pBuffer->SetName(L"LinearAllocator Page");
+LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage( size_t PageSize )
+{
+    return m_Provider->CreatePage(m_AllocationType, PageSize == 0 ? m_PageSize : PageSize);
+}
 
-    return new LinearAllocationPage(pBuffer, DefaultUsage);
+LinearAllocatorPageManager::Statistics LinearAllocatorPageManager::GetStatistics( void ) const
+{
+    const Magazine& Mag = sm_ThreadMagazines[m_AllocationType];
+    uint64_t UncountedHits = Mag.Owner == this ? Mag.Hits : 0;
+
+    Statistics Stats;
+    Stats.NumCreated = m_NumCreated;
+    Stats.NumReused = m_NumReused + UncountedHits;
+    Stats.NumMagazineHits = m_NumMagazineHits + UncountedHits;
+    Stats.NumLargeCreated = m_NumLargeCreated;
+    Stats.NumLargeReused = m_NumLargeReused;
+    Stats.NumLargeDestroyed = m_NumLargeDestroyed;
+    return Stats;
 }
 
 void LinearAllocator::CleanupUsedPages( uint64_t FenceID )
 {
-    if (m_CurPage == nullptr)
+    if (m_CurPage == nullptr && m_LargePageList.empty())
         return;
 
-    m_RetiredPages.push_back(m_CurPage);
-    m_CurPage = nullptr;
-    m_CurOffset = 0;
+    if (m_CurPage != nullptr)
+    {
+        m_RetiredPages.push_back(m_CurPage);
+        m_CurPage = nullptr;
+        m_CurOffset = 0;
+    }
 
-    sm_PageManager[m_AllocationType].DiscardPages(FenceID, m_RetiredPages);
+    m_PageManager->DiscardPages(FenceID, m_RetiredPages, m_LargePageList);
     m_RetiredPages.clear();
-
-    sm_PageManager[m_AllocationType].FreeLargePages(FenceID, m_LargePageList);
     m_LargePageList.clear();
 }
 
 DynAlloc LinearAllocator::AllocateLargePage(size_t SizeInBytes)
 {
-    LinearAllocationPage* OneOff = sm_PageManager[m_AllocationType].CreateNewPage(SizeInBytes);
+    LinearAllocationPage* OneOff = m_PageManager->RequestLargePage(SizeInBytes);
     m_LargePageList.push_back(OneOff);
 
     DynAlloc ret(*OneOff, 0, SizeInBytes);
@@ -179,7 +330,7 @@ DynAlloc LinearAllocator::Allocate(size_t SizeInBytes, size_t Alignment)
 
     if (m_CurPage == nullptr)
     {
-        m_CurPage = sm_PageManager[m_AllocationType].RequestPage();
+        m_CurPage = m_PageManager->RequestPage();
         m_CurOffset = 0;
     }
 
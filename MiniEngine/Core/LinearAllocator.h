@@ -13,12 +13,14 @@
 // Description:  This is a dynamic graphics memory allocator for DX12.  It's designed to work in concert
 // with the CommandContext class and to do so in a thread-safe manner.  There may be many command contexts,
 // each with its own linear allocators.  They act as windows into a global memory pool by reserving a
-// context-local memory page.  Requesting a new page is done in a thread-safe manner by guarding accesses
-// with a mutex lock.
+// context-local memory page.  Each thread keeps a small magazine of pages that are ready for reuse, refilled
+// from the shared pool in batches.  A page request only takes the page manager's lock when the magazine is empty.
 //
 // When a command context is finished, it will receive a fence ID that indicates when it's safe to reclaim
 // used resources.  The CleanupUsedPages() method must be invoked at this time so that the used pages can be
-// scheduled for reuse after the fence has cleared.
+// scheduled for reuse after the fence has cleared.  Retired pages are kept in batches per fence, in a list
+// per command queue, so a slow queue never holds up pages retired on another one.  Pages made for allocations
+// larger than a page are recycled too, up to a budget.
 
 #pragma once
 
@@ -26,6 +28,9 @@
 #include <vector>
 #include <queue>
 #include <mutex>
+#include <map>
+#include <deque>
+#include <atomic>
 
 // Constant blocks must be multiples of 16 constants @ 16 bytes each
 #define DEFAULT_ALIGN 256
@@ -50,6 +55,7 @@ public:
     {
         m_pResource.Attach(pResource);
         m_UsageState = Usage;
+        m_PageSize = (size_t)m_pResource->GetDesc().Width;
         m_GpuVirtualAddress = m_pResource->GetGPUVirtualAddress();
         m_pResource->Map(0, nullptr, &m_CpuVirtualAddress);
     }
@@ -78,6 +84,7 @@ public:
 
     void* m_CpuVirtualAddress;
     D3D12_GPU_VIRTUAL_ADDRESS m_GpuVirtualAddress;
+    size_t m_PageSize;
 };
 
 enum LinearAllocatorType
@@ -96,40 +103,123 @@ enum
     kCpuAllocatorPageSize = 0x200000	// 2MB
 };
 
+// Source of the pages that a LinearAllocatorPageManager hands out, and of the fence values that release them.  The
+// default provider creates committed buffers on the graphics device and asks g_CommandManager about fences.  Any
+// other provider lets the page manager run without a device.
+class LinearAllocatorPageProvider
+{
+public:
+    virtual ~LinearAllocatorPageProvider() {}
+    virtual LinearAllocationPage* CreatePage( LinearAllocatorType Type, size_t PageSize ) = 0;
+    virtual bool IsFenceComplete( uint64_t FenceValue ) = 0;
+};
+
 class LinearAllocatorPageManager
 {
 public:
+    struct Statistics
+    {
+        uint64_t NumCreated;            // Pages created by the provider
+        uint64_t NumReused;             // Page requests served by a retired page
+        uint64_t NumMagazineHits;       // ...of which came from a thread's magazine
+        uint64_t NumLargeCreated;       // Large pages created by the provider
+        uint64_t NumLargeReused;        // Large page requests served by a retired large page
+        uint64_t NumLargeDestroyed;     // Retired large pages destroyed to stay within the budget
+    };
 
     LinearAllocatorPageManager();
+    LinearAllocatorPageManager( LinearAllocatorType Type, LinearAllocatorPageProvider* Provider );
+
+    // Worker threads that requested pages must have exited (or stopped using the manager) before it is destroyed.
+    // The calling thread's magazine is detached here.
+    ~LinearAllocatorPageManager();
+
     LinearAllocationPage* RequestPage( void );
-    LinearAllocationPage* CreateNewPage( size_t PageSize = 0 );
 
-    // Discarded pages will get recycled.  This is for fixed size pages.
-    void DiscardPages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages );
+    // A page of at least PageSize bytes for an allocation that doesn't fit in a regular page.
+    LinearAllocationPage* RequestLargePage( size_t PageSize );
 
-    // Freed pages will be destroyed once their fence has passed.  This is for single-use,
-    // "large" pages.
-    void FreeLargePages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages );
+    // Used pages of both kinds are recycled once their fence has passed.
+    void DiscardPages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages,
+        const std::vector<LinearAllocationPage*>& LargePages );
 
-    void Destroy( void ) { m_PagePool.clear(); }
+    // Magazine hits are added up when a thread next takes the lock or exits.  The calling thread's are always
+    // included.
+    Statistics GetStatistics( void ) const;
+
+    void Destroy( void );
 
 private:
 
     static LinearAllocatorType sm_AutoType;
 
+    static const uint32_t sm_MaxMagazineSize = 16;
+    static const size_t sm_MagazineBytes = 0x400000;        // 4MB of pages per thread at most
+    static const size_t sm_LargePageBudget = 0x4000000;     // 64MB of retired large pages at most
+
+    // Pages retired by one context, or by several with the same fence
+    struct RetiredBatch
+    {
+        uint64_t FenceValue;
+        std::vector<LinearAllocationPage*> Pages;
+        std::vector<LinearAllocationPage*> LargePages;
+    };
+
+    struct Magazine
+    {
+        Magazine() : Owner(nullptr), Generation(0), Count(0), Hits(0) {}
+        ~Magazine();
+
+        LinearAllocatorPageManager* Owner;
+        uint32_t Generation;
+        uint32_t Count;
+        uint64_t Hits;      // Requests served since the owner's totals were last updated
+        LinearAllocationPage* Pages[sm_MaxMagazineSize];
+    };
+
+    // One magazine per allocator type per thread
+    static thread_local Magazine sm_ThreadMagazines[kNumAllocatorTypes];
+
+    Magazine* GetThreadMagazine( void );
+    void AddMagazineHits( Magazine& Mag );
+    LinearAllocationPage* CreateNewPage( size_t PageSize = 0 );
+    void CollectRetiredPagesLocked( std::vector<LinearAllocationPage*>& PagesToDelete );
+
     LinearAllocatorType m_AllocationType;
+    LinearAllocatorPageProvider* m_Provider;
+    size_t m_PageSize;
+    uint32_t m_MagazineBatch;
     std::vector<std::unique_ptr<LinearAllocationPage> > m_PagePool;
-    std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_RetiredPages;
-    std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_DeletionQueue;
-    std::queue<LinearAllocationPage*> m_AvailablePages;
+
+    // One list per command queue type, each in fence order
+    std::deque<RetiredBatch> m_RetiredPages[4];
+
+    std::vector<LinearAllocationPage*> m_AvailablePages;
+    std::multimap<size_t, LinearAllocationPage*> m_AvailableLargePages;
+    size_t m_AvailableLargeBytes;
     std::mutex m_Mutex;
+
+    // Bumped by Destroy() so that thread magazines drop pages that have been released
+    std::atomic<uint32_t> m_Generation;
+
+    std::atomic<uint64_t> m_NumCreated;
+    std::atomic<uint64_t> m_NumReused;
+    std::atomic<uint64_t> m_NumMagazineHits;
+    std::atomic<uint64_t> m_NumLargeCreated;
+    std::atomic<uint64_t> m_NumLargeReused;
+    std::atomic<uint64_t> m_NumLargeDestroyed;
 };
 
 class LinearAllocator
 {
 public:
 
-    LinearAllocator(LinearAllocatorType Type) : m_AllocationType(Type), m_PageSize(0), m_CurOffset(~(size_t)0), m_CurPage(nullptr)
+    LinearAllocator(LinearAllocatorType Type) : LinearAllocator(Type, sm_PageManager[Type])
+    {
+    }
+
+    LinearAllocator(LinearAllocatorType Type, LinearAllocatorPageManager& PageManager) :
+        m_AllocationType(Type), m_PageManager(&PageManager), m_PageSize(0), m_CurOffset(~(size_t)0), m_CurPage(nullptr)
     {
         ASSERT(Type > kInvalidAllocator && Type < kNumAllocatorTypes);
         m_PageSize = (Type == kGpuExclusive ? kGpuAllocatorPageSize : kCpuAllocatorPageSize);
@@ -152,6 +242,7 @@ private:
     static LinearAllocatorPageManager sm_PageManager[2];
 
     LinearAllocatorType m_AllocationType;
+    LinearAllocatorPageManager* m_PageManager;
     size_t m_PageSize;
     size_t m_CurOffset;
     LinearAllocationPage* m_CurPage;
@@ -0,0 +1,89 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author(s):  James Stanard
+//             Alex Nankervis
+//
+
+#include "pch.h"
+#include "LinearAllocator.h"
+#include "GraphicsCore.h"
+#include "CommandListManager.h"
+
+using namespace Graphics;
+
+namespace
+{
+    // Committed buffers on the graphics device, released by g_CommandManager's fences
+    class DevicePageProvider : public LinearAllocatorPageProvider
+    {
+    public:
+        LinearAllocationPage* CreatePage( LinearAllocatorType Type, size_t PageSize ) override
+        {
+            D3D12_HEAP_PROPERTIES HeapProps;
+            HeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+            HeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+            HeapProps.CreationNodeMask = 1;
+            HeapProps.VisibleNodeMask = 1;
+
+            D3D12_RESOURCE_DESC ResourceDesc;
+            ResourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+            ResourceDesc.Alignment = 0;
+            ResourceDesc.Width = PageSize;
+            ResourceDesc.Height = 1;
+            ResourceDesc.DepthOrArraySize = 1;
+            ResourceDesc.MipLevels = 1;
+            ResourceDesc.Format = DXGI_FORMAT_UNKNOWN;
+            ResourceDesc.SampleDesc.Count = 1;
+            ResourceDesc.SampleDesc.Quality = 0;
+            ResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+            D3D12_RESOURCE_STATES DefaultUsage;
+
+            if (Type == kGpuExclusive)
+            {
+                HeapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+                ResourceDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+                DefaultUsage = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+            }
+            else
+            {
+                HeapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
+                ResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+                DefaultUsage = D3D12_RESOURCE_STATE_GENERIC_READ;
+            }
+
+            ID3D12Resource* pBuffer;
+            ASSERT_SUCCEEDED( g_Device->CreateCommittedResource(&HeapProps, D3D12_HEAP_FLAG_NONE,
+                &ResourceDesc, DefaultUsage, nullptr, MY_IID_PPV_ARGS(&pBuffer)) );
+
+            pBuffer->SetName(L"LinearAllocator Page");
+
+            return new LinearAllocationPage(pBuffer, DefaultUsage);
+        }
+
+        bool IsFenceComplete( uint64_t FenceValue ) override
+        {
+            return g_CommandManager.IsFenceComplete(FenceValue);
+        }
+    };
+
+    DevicePageProvider s_DevicePageProvider;
+}
+
+LinearAllocatorType LinearAllocatorPageManager::sm_AutoType = kGpuExclusive;
+
+LinearAllocatorPageManager::LinearAllocatorPageManager() : LinearAllocatorPageManager(sm_AutoType, &s_DevicePageProvider)
+{
+    sm_AutoType = (LinearAllocatorType)(sm_AutoType + 1);
+    ASSERT(sm_AutoType <= kNumAllocatorTypes);
+}
+
+LinearAllocatorPageManager LinearAllocator::sm_PageManager[2];
@@ -149,7 +149,7 @@ namespace
     CBChangesPerView s_ChangesPerView;
 
     GpuResource TextureArray;
-    D3D12_CPU_DESCRIPTOR_HANDLE TextureArraySRV;
+    D3D12_CPU_DESCRIPTOR_HANDLE TextureArraySRV = { D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN };
     std::vector<std::wstring> TextureNameArray;
 
     std::vector<std::unique_ptr<ParticleEffect>> ParticleEffectsPool;
@@ -574,6 +574,9 @@ void ParticleEffects::Shutdown( void )
     TileDrawPackets.Destroy();
     TileFastDrawPackets.Destroy();
     TextureArray.Destroy();
+
+    FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, TextureArraySRV);
+    TextureArraySRV.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
 }
 
 //Returns index into Pool
@@ -14,23 +14,33 @@
 #include "GraphicsCore.h"
 #include "PipelineState.h"
 #include "RootSignature.h"
-#include "Hash.h"
-#include <map>
-#include <thread>
-#include <mutex>
+#include "StateCache.h"
 
 using Math::IsAligned;
 using namespace Graphics;
 using Microsoft::WRL::ComPtr;
 using namespace std;
 
-static map< size_t, ComPtr<ID3D12PipelineState> > s_GraphicsPSOHashMap;
-static map< size_t, ComPtr<ID3D12PipelineState> > s_ComputePSOHashMap;
+static StateCache< ComPtr<ID3D12PipelineState> > s_GraphicsPSOCache;
+static StateCache< ComPtr<ID3D12PipelineState> > s_ComputePSOCache;
 
 void PSO::DestroyAll(void)
 {
-    s_GraphicsPSOHashMap.clear();
-    s_ComputePSOHashMap.clear();
+    s_GraphicsPSOCache.Clear();
+    s_ComputePSOCache.Clear();
+}
+
+// The PSO caches compare descriptions byte for byte, so bytes that belong to no field must be zero.  The
+// constructors clear the whole description, but the blend and depth-stencil states are copied in from the
+// caller along with whatever their padding holds.
+static void ClearPadding( D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc )
+{
+    const size_t UsedBlendBytes = offsetof(D3D12_RENDER_TARGET_BLEND_DESC, RenderTargetWriteMask) + sizeof(UINT8);
+    for (UINT i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+        memset((uint8_t*)&Desc.BlendState.RenderTarget[i] + UsedBlendBytes, 0, sizeof(D3D12_RENDER_TARGET_BLEND_DESC) - UsedBlendBytes);
+
+    const size_t UsedStencilBytes = offsetof(D3D12_DEPTH_STENCIL_DESC, StencilWriteMask) + sizeof(UINT8);
+    memset((uint8_t*)&Desc.DepthStencilState + UsedStencilBytes, 0, offsetof(D3D12_DEPTH_STENCIL_DESC, FrontFace) - UsedStencilBytes);
 }
 
 
@@ -112,39 +122,32 @@ void GraphicsPSO::Finalize()
     m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
     ASSERT(m_PSODesc.pRootSignature != nullptr);
 
+    // Shaders are identified by their bytecode pointer and length, and the root signature by its pointer, which
+    // the root signature cache has already made unique.  Input elements are keyed by their semantic names rather
+    // than the pointers to them.
+    ClearPadding(m_PSODesc);
     m_PSODesc.InputLayout.pInputElementDescs = nullptr;
-    size_t HashCode = Utility::HashState(&m_PSODesc);
-    HashCode = Utility::HashState(m_InputLayouts.get(), m_PSODesc.InputLayout.NumElements, HashCode);
-    m_PSODesc.InputLayout.pInputElementDescs = m_InputLayouts.get();
-
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = false;
+    StateKey Key;
+    Key.Append(&m_PSODesc);
+    for (UINT i = 0; i < m_PSODesc.InputLayout.NumElements; ++i)
     {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_GraphicsPSOHashMap.find(HashCode);
-
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_GraphicsPSOHashMap.end())
-        {
-            firstCompile = true;
-            PSORef = s_GraphicsPSOHashMap[HashCode].GetAddressOf();
-        }
-        else
-            PSORef = iter->second.GetAddressOf();
+        const D3D12_INPUT_ELEMENT_DESC& Element = m_InputLayouts.get()[i];
+        Key.AppendString(Element.SemanticName);
+        Key.AppendValue(Element.SemanticIndex);
+        Key.AppendValue(Element.Format);
+        Key.AppendValue(Element.InputSlot);
+        Key.AppendValue(Element.AlignedByteOffset);
+        Key.AppendValue(Element.InputSlotClass);
+        Key.AppendValue(Element.InstanceDataStepRate);
     }
+    m_PSODesc.InputLayout.pInputElementDescs = m_InputLayouts.get();
 
-    if (firstCompile)
-    {
-        ASSERT_SUCCEEDED( g_Device->CreateGraphicsPipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_GraphicsPSOHashMap[HashCode].Attach(m_PSO);
-    }
-    else
+    m_PSO = s_GraphicsPSOCache.GetOrCreate(Key, [this]()
     {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
-    }
+        ComPtr<ID3D12PipelineState> NewPSO;
+        ASSERT_SUCCEEDED( g_Device->CreateGraphicsPipelineState(&m_PSODesc, MY_IID_PPV_ARGS(NewPSO.GetAddressOf())) );
+        return NewPSO;
+    }).Get();
 }
 
 void ComputePSO::Finalize()
@@ -153,36 +156,16 @@ void ComputePSO::Finalize()
     m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
     ASSERT(m_PSODesc.pRootSignature != nullptr);
 
-    size_t HashCode = Utility::HashState(&m_PSODesc);
-
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = false;
-    {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_ComputePSOHashMap.find(HashCode);
-
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_ComputePSOHashMap.end())
-        {
-            firstCompile = true;
-            PSORef = s_ComputePSOHashMap[HashCode].GetAddressOf();
-        }
-        else
-            PSORef = iter->second.GetAddressOf();
-    }
+    // The description has no padding that the constructor didn't clear.
+    StateKey Key;
+    Key.Append(&m_PSODesc);
 
-    if (firstCompile)
+    m_PSO = s_ComputePSOCache.GetOrCreate(Key, [this]()
     {
-        ASSERT_SUCCEEDED( g_Device->CreateComputePipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_ComputePSOHashMap[HashCode].Attach(m_PSO);
-    }
-    else
-    {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
-    }
+        ComPtr<ID3D12PipelineState> NewPSO;
+        ASSERT_SUCCEEDED( g_Device->CreateComputePipelineState(&m_PSODesc, MY_IID_PPV_ARGS(NewPSO.GetAddressOf())) );
+        return NewPSO;
+    }).Get();
 }
 
 ComputePSO::ComputePSO()
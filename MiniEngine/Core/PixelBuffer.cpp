@@ -317,6 +317,7 @@ void PixelBuffer::AssociateWithResource( ID3D12Device* Device, const std::wstrin
 
     m_pResource.Attach(Resource);
     m_UsageState = CurrentState;
+    m_SubresourceStates.clear();
 
     m_Width = (uint32_t)ResourceDesc.Width;		// We don't care about large virtual textures yet
     m_Height = ResourceDesc.Height;
@@ -0,0 +1,546 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "pch.h"
+#include "ResourceBarrierTracker.h"
+#include "GpuResource.h"
+
+#include <algorithm>
+
+namespace
+{
+    const D3D12_RESOURCE_STATES kNotTransitioning = (D3D12_RESOURCE_STATES)-1;
+
+    // States that only read the resource and so may be combined with each other
+    const D3D12_RESOURCE_STATES kReadOnlyStates = (D3D12_RESOURCE_STATES)
+        ( D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
+        | D3D12_RESOURCE_STATE_INDEX_BUFFER
+        | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+        | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
+        | D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT
+        | D3D12_RESOURCE_STATE_COPY_SOURCE
+        | D3D12_RESOURCE_STATE_DEPTH_READ );
+
+    // Whether a pending barrier has to be recorded before anything that is later done to the resource.  A null
+    // resource in a UAV or aliasing barrier stands for every resource.
+    bool BarrierTouches( const D3D12_RESOURCE_BARRIER& Barrier, const ID3D12Resource* Resource )
+    {
+        switch (Barrier.Type)
+        {
+        case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+            return Barrier.Transition.pResource == Resource;
+        case D3D12_RESOURCE_BARRIER_TYPE_UAV:
+            return Barrier.UAV.pResource == Resource || Barrier.UAV.pResource == nullptr;
+        default:
+            return Barrier.Aliasing.pResourceBefore == Resource || Barrier.Aliasing.pResourceAfter == Resource
+                || Barrier.Aliasing.pResourceBefore == nullptr || Barrier.Aliasing.pResourceAfter == nullptr;
+        }
+    }
+
+    D3D12_RESOURCE_BARRIER MakeTransition( ID3D12Resource* Resource, UINT Subresource,
+        D3D12_RESOURCE_STATES Before, D3D12_RESOURCE_STATES After, D3D12_RESOURCE_BARRIER_FLAGS Flags )
+    {
+        D3D12_RESOURCE_BARRIER BarrierDesc;
+        BarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+        BarrierDesc.Flags = Flags;
+        BarrierDesc.Transition.pResource = Resource;
+        BarrierDesc.Transition.Subresource = Subresource;
+        BarrierDesc.Transition.StateBefore = Before;
+        BarrierDesc.Transition.StateAfter = After;
+        return BarrierDesc;
+    }
+
+    // The states that a command list of the given type may transition a resource into or out of
+    D3D12_RESOURCE_STATES GetValidStates( D3D12_COMMAND_LIST_TYPE Type )
+    {
+        switch (Type)
+        {
+        case D3D12_COMMAND_LIST_TYPE_COMPUTE:
+            return (D3D12_RESOURCE_STATES)VALID_COMPUTE_QUEUE_RESOURCE_STATES;
+        case D3D12_COMMAND_LIST_TYPE_COPY:
+            return (D3D12_RESOURCE_STATES)(D3D12_RESOURCE_STATE_COPY_DEST | D3D12_RESOURCE_STATE_COPY_SOURCE);
+        default:
+            return (D3D12_RESOURCE_STATES)~0;
+        }
+    }
+}
+
+ResourceBarrierTracker::ResourceBarrierTracker( D3D12_COMMAND_LIST_TYPE Type ) : m_Type(Type)
+{
+    ResetStatistics();
+}
+
+void ResourceBarrierTracker::ResetStatistics( void )
+{
+    ZeroMemory(&m_Statistics, sizeof(m_Statistics));
+}
+
+UINT ResourceBarrierTracker::GetSubresourceCount( ID3D12Resource* Resource )
+{
+    D3D12_RESOURCE_DESC Desc = Resource->GetDesc();
+
+    if (Desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        return 1;
+    else if (Desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+        return Desc.MipLevels;
+
+    // Depth-stencil formats keep stencil in a second plane with its own subresources
+    UINT PlaneCount = 1;
+    switch (Desc.Format)
+    {
+    case DXGI_FORMAT_R24G8_TYPELESS:
+    case DXGI_FORMAT_D24_UNORM_S8_UINT:
+    case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+    case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+    case DXGI_FORMAT_R32G8X24_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+    case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+    case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+        PlaneCount = 2;
+        break;
+    default:
+        break;
+    }
+
+    return Desc.MipLevels * Desc.DepthOrArraySize * PlaneCount;
+}
+
+D3D12_RESOURCE_STATES ResourceBarrierTracker::MergeReadState( D3D12_RESOURCE_STATES OldState, D3D12_RESOURCE_STATES NewState ) const
+{
+    // COMMON (and PRESENT) is 0, so it has to be ruled out on its own
+    if (OldState == 0 || NewState == 0 || (OldState & ~kReadOnlyStates) != 0 || (NewState & ~kReadOnlyStates) != 0)
+        return NewState;
+
+    D3D12_RESOURCE_STATES Merged = OldState | NewState;
+
+    // The merged state has to be one this queue can transition out of again
+    if ((Merged & GetValidStates(m_Type)) != Merged)
+        return NewState;
+
+    // A resource that a graphics context leaves in PIXEL_SHADER_RESOURCE | NON_PIXEL_SHADER_RESOURCE can't be
+    // transitioned by a compute context, so a request for a state that the compute queue supports has to leave
+    // the resource in one.
+    if ((NewState & VALID_COMPUTE_QUEUE_RESOURCE_STATES) == NewState && (Merged & VALID_COMPUTE_QUEUE_RESOURCE_STATES) != Merged)
+        return NewState;
+
+    return Merged;
+}
+
+void ResourceBarrierTracker::Transition( GpuResource& Resource, D3D12_RESOURCE_STATES NewState, UINT Subresource )
+{
+    if (m_Type == D3D12_COMMAND_LIST_TYPE_COMPUTE)
+        ASSERT((NewState & VALID_COMPUTE_QUEUE_RESOURCE_STATES) == NewState);
+
+    // Any use of a resource in the middle of a split barrier ends the split.  If this is the transition that the
+    // split was started for, the resource is then already in the state asked for.
+    if (Resource.m_TransitioningState != kNotTransitioning)
+        EndSplitTransitions(Resource);
+
+    if (Subresource != D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+    {
+        TransitionSubresource(Resource, Subresource, NewState);
+        return;
+    }
+
+    if (Resource.m_SubresourceStates.empty())
+    {
+        D3D12_RESOURCE_STATES OldState = Resource.m_UsageState;
+
+        if (m_Type == D3D12_COMMAND_LIST_TYPE_COMPUTE)
+            ASSERT((OldState & VALID_COMPUTE_QUEUE_RESOURCE_STATES) == OldState);
+
+        NewState = MergeReadState(OldState, NewState);
+
+        if (OldState != NewState)
+        {
+            AddTransition(Resource.GetResource(), Subresource, OldState, NewState);
+            Resource.m_UsageState = NewState;
+        }
+        else if (NewState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+            UAVBarrier(Resource);
+        else
+            ++m_Statistics.Skipped;
+
+        return;
+    }
+
+    // The subresources are in different states, so each one that needs it gets its own barrier.
+    bool NeedsUAVBarrier = false;
+    bool AllSkipped = true;
+
+    for (UINT i = 0; i < (UINT)Resource.m_SubresourceStates.size(); ++i)
+    {
+        D3D12_RESOURCE_STATES OldState = Resource.m_SubresourceStates[i];
+        D3D12_RESOURCE_STATES SubresourceState = MergeReadState(OldState, NewState);
+
+        if (OldState != SubresourceState)
+        {
+            AddTransition(Resource.GetResource(), i, OldState, SubresourceState);
+            Resource.m_SubresourceStates[i] = SubresourceState;
+            AllSkipped = false;
+        }
+        else if (SubresourceState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+            NeedsUAVBarrier = true;
+    }
+
+    if (NeedsUAVBarrier)
+        UAVBarrier(Resource);
+    else if (AllSkipped)
+        ++m_Statistics.Skipped;
+
+    CollapseSubresourceStates(Resource);
+}
+
+void ResourceBarrierTracker::TransitionSubresource( GpuResource& Resource, UINT Subresource, D3D12_RESOURCE_STATES NewState )
+{
+    std::vector<D3D12_RESOURCE_STATES>& States = Resource.m_SubresourceStates;
+
+    if (States.empty())
+    {
+        D3D12_RESOURCE_STATES OldState = Resource.m_UsageState;
+
+        if (MergeReadState(OldState, NewState) == OldState)
+        {
+            if (OldState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+                UAVBarrier(Resource);
+            else
+                ++m_Statistics.Skipped;
+            return;
+        }
+
+        UINT SubresourceCount = GetSubresourceCount(Resource.GetResource());
+        ASSERT(Subresource < SubresourceCount, "Subresource %u is out of range", Subresource);
+
+        // A resource with a single subresource is never split up
+        if (SubresourceCount == 1)
+        {
+            Transition(Resource, NewState);
+            return;
+        }
+
+        States.assign(SubresourceCount, OldState);
+    }
+
+    ASSERT(Subresource < (UINT)States.size(), "Subresource %u is out of range", Subresource);
+
+    D3D12_RESOURCE_STATES OldState = States[Subresource];
+
+    if (m_Type == D3D12_COMMAND_LIST_TYPE_COMPUTE)
+        ASSERT((OldState & VALID_COMPUTE_QUEUE_RESOURCE_STATES) == OldState);
+
+    NewState = MergeReadState(OldState, NewState);
+
+    if (OldState != NewState)
+    {
+        AddTransition(Resource.GetResource(), Subresource, OldState, NewState);
+        States[Subresource] = NewState;
+    }
+    else if (NewState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+        UAVBarrier(Resource);
+    else
+        ++m_Statistics.Skipped;
+
+    CollapseSubresourceStates(Resource);
+}
+
+void ResourceBarrierTracker::CollapseSubresourceStates( GpuResource& Resource )
+{
+    std::vector<D3D12_RESOURCE_STATES>& States = Resource.m_SubresourceStates;
+
+    if (!States.empty() && std::all_of(States.begin(), States.end(), [&](D3D12_RESOURCE_STATES State) { return State == States[0]; }))
+    {
+        Resource.m_UsageState = States[0];
+        States.clear();
+    }
+}
+
+void ResourceBarrierTracker::AddTransition( ID3D12Resource* Resource, UINT Subresource,
+    D3D12_RESOURCE_STATES Before, D3D12_RESOURCE_STATES After )
+{
+    // Look for a pending transition of the same subresource that nothing else has to wait for.  Barriers on
+    // other subresources of the resource don't get in the way, but anything that covers this one does.
+    for (size_t i = m_PendingBarriers.size(); i-- > 0; )
+    {
+        D3D12_RESOURCE_BARRIER& Pending = m_PendingBarriers[i];
+
+        if (!BarrierTouches(Pending, Resource))
+            continue;
+
+        if (Pending.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION && Pending.Transition.Subresource != Subresource &&
+            Pending.Transition.Subresource != D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES &&
+            Subresource != D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+        {
+            continue;
+        }
+
+        if (Pending.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION && Pending.Flags == D3D12_RESOURCE_BARRIER_FLAG_NONE &&
+            Pending.Transition.Subresource == Subresource)
+        {
+            ASSERT(Pending.Transition.StateAfter == Before);
+
+            if (Pending.Transition.StateBefore == After)
+            {
+                m_PendingBarriers.erase(m_PendingBarriers.begin() + i);
+                ++m_Statistics.Cancelled;
+
+                // Unordered access before the round trip must still finish before unordered access after it
+                if (After == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+                    AddUAVBarrier(Resource);
+            }
+            else
+            {
+                Pending.Transition.StateAfter = After;
+                ++m_Statistics.Folded;
+            }
+            return;
+        }
+
+        break;
+    }
+
+    m_PendingBarriers.push_back(MakeTransition(Resource, Subresource, Before, After, D3D12_RESOURCE_BARRIER_FLAG_NONE));
+}
+
+void ResourceBarrierTracker::BeginTransition( GpuResource& Resource, D3D12_RESOURCE_STATES NewState, UINT Subresource )
+{
+    if (m_Type == D3D12_COMMAND_LIST_TYPE_COMPUTE)
+        ASSERT((NewState & VALID_COMPUTE_QUEUE_RESOURCE_STATES) == NewState);
+
+    if (Resource.m_TransitioningState != kNotTransitioning)
+        EndSplitTransitions(Resource);
+
+    // A UAV barrier can't be split
+    if (NewState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+    {
+        Transition(Resource, NewState, Subresource);
+        return;
+    }
+
+    if (Subresource != D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+    {
+        BeginSubresourceTransition(Resource, Subresource, NewState);
+        return;
+    }
+
+    if (Resource.m_SubresourceStates.empty())
+    {
+        D3D12_RESOURCE_STATES OldState = Resource.m_UsageState;
+        NewState = MergeReadState(OldState, NewState);
+
+        if (OldState != NewState)
+            AddSplitBegin(Resource, Subresource, OldState, NewState);
+        else
+            ++m_Statistics.Skipped;
+
+        return;
+    }
+
+    // Each subresource that isn't in the new state already gets a split of its own
+    bool AllSkipped = true;
+
+    for (UINT i = 0; i < (UINT)Resource.m_SubresourceStates.size(); ++i)
+    {
+        D3D12_RESOURCE_STATES OldState = Resource.m_SubresourceStates[i];
+        D3D12_RESOURCE_STATES SubresourceState = MergeReadState(OldState, NewState);
+
+        if (OldState != SubresourceState)
+        {
+            AddSplitBegin(Resource, i, OldState, SubresourceState);
+            AllSkipped = false;
+        }
+    }
+
+    if (AllSkipped)
+        ++m_Statistics.Skipped;
+}
+
+void ResourceBarrierTracker::BeginSubresourceTransition( GpuResource& Resource, UINT Subresource, D3D12_RESOURCE_STATES NewState )
+{
+    std::vector<D3D12_RESOURCE_STATES>& States = Resource.m_SubresourceStates;
+
+    if (States.empty())
+    {
+        D3D12_RESOURCE_STATES OldState = Resource.m_UsageState;
+
+        if (MergeReadState(OldState, NewState) == OldState)
+        {
+            ++m_Statistics.Skipped;
+            return;
+        }
+
+        UINT SubresourceCount = GetSubresourceCount(Resource.GetResource());
+        ASSERT(Subresource < SubresourceCount, "Subresource %u is out of range", Subresource);
+
+        if (SubresourceCount == 1)
+        {
+            BeginTransition(Resource, NewState);
+            return;
+        }
+
+        States.assign(SubresourceCount, OldState);
+    }
+
+    ASSERT(Subresource < (UINT)States.size(), "Subresource %u is out of range", Subresource);
+
+    D3D12_RESOURCE_STATES OldState = States[Subresource];
+    NewState = MergeReadState(OldState, NewState);
+
+    if (OldState != NewState)
+        AddSplitBegin(Resource, Subresource, OldState, NewState);
+    else
+        ++m_Statistics.Skipped;
+}
+
+void ResourceBarrierTracker::AddSplitBegin( GpuResource& Resource, UINT Subresource,
+    D3D12_RESOURCE_STATES Before, D3D12_RESOURCE_STATES After )
+{
+    m_PendingBarriers.push_back(MakeTransition(Resource.GetResource(), Subresource, Before, After, D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY));
+
+    SplitTransition Split = { &Resource, Subresource, After };
+    m_SplitTransitions.push_back(Split);
+    Resource.m_TransitioningState = After;
+}
+
+void ResourceBarrierTracker::EndSplitTransitions( GpuResource& Resource )
+{
+    ASSERT(Resource.m_TransitioningState != kNotTransitioning);
+
+    ID3D12Resource* pResource = Resource.GetResource();
+
+    for (size_t Index = 0; Index < m_SplitTransitions.size(); )
+    {
+        SplitTransition Split = m_SplitTransitions[Index];
+        if (Split.Resource != &Resource)
+        {
+            ++Index;
+            continue;
+        }
+        m_SplitTransitions.erase(m_SplitTransitions.begin() + Index);
+
+        D3D12_RESOURCE_STATES& State = (Split.Subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES) ?
+            Resource.m_UsageState : Resource.m_SubresourceStates[Split.Subresource];
+        D3D12_RESOURCE_STATES OldState = State;
+        State = Split.After;
+
+        // If the beginning hasn't been recorded yet, there is no work for the split to overlap with, so record
+        // an ordinary barrier instead of the pair.  Nothing else is added for the resource while it is split.
+        bool BeginPending = false;
+        for (size_t i = m_PendingBarriers.size(); i-- > 0; )
+        {
+            const D3D12_RESOURCE_BARRIER& Pending = m_PendingBarriers[i];
+
+            if (Pending.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION && Pending.Flags == D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY &&
+                Pending.Transition.pResource == pResource && Pending.Transition.Subresource == Split.Subresource)
+            {
+                m_PendingBarriers.erase(m_PendingBarriers.begin() + i);
+                BeginPending = true;
+                break;
+            }
+        }
+
+        if (BeginPending)
+        {
+            ++m_Statistics.Folded;
+            AddTransition(pResource, Split.Subresource, OldState, Split.After);
+        }
+        else
+        {
+            m_PendingBarriers.push_back(MakeTransition(pResource, Split.Subresource,
+                OldState, Split.After, D3D12_RESOURCE_BARRIER_FLAG_END_ONLY));
+        }
+    }
+
+    Resource.m_TransitioningState = kNotTransitioning;
+    CollapseSubresourceStates(Resource);
+}
+
+void ResourceBarrierTracker::EndSplitTransitions( void )
+{
+    while (!m_SplitTransitions.empty())
+        EndSplitTransitions(*m_SplitTransitions.back().Resource);
+}
+
+void ResourceBarrierTracker::UAVBarrier( GpuResource& Resource )
+{
+    if (Resource.m_TransitioningState != kNotTransitioning)
+        EndSplitTransitions(Resource);
+
+    AddUAVBarrier(Resource.GetResource());
+}
+
+void ResourceBarrierTracker::AddUAVBarrier( ID3D12Resource* Resource )
+{
+    // Nothing has used the resource since the last pending barrier on it, so if that barrier already waits for
+    // earlier unordered access, another one is redundant.
+    for (size_t i = m_PendingBarriers.size(); i-- > 0; )
+    {
+        const D3D12_RESOURCE_BARRIER& Pending = m_PendingBarriers[i];
+
+        if (!BarrierTouches(Pending, Resource))
+            continue;
+
+        if (Pending.Type == D3D12_RESOURCE_BARRIER_TYPE_UAV ||
+            (Pending.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION &&
+            Pending.Flags != D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY &&
+            Pending.Transition.Subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES &&
+            Pending.Transition.StateAfter == D3D12_RESOURCE_STATE_UNORDERED_ACCESS))
+        {
+            ++m_Statistics.Skipped;
+            return;
+        }
+
+        break;
+    }
+
+    D3D12_RESOURCE_BARRIER BarrierDesc;
+    BarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+    BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    BarrierDesc.UAV.pResource = Resource;
+    m_PendingBarriers.push_back(BarrierDesc);
+}
+
+void ResourceBarrierTracker::AliasBarrier( GpuResource& Before, GpuResource& After )
+{
+    if (Before.m_TransitioningState != kNotTransitioning)
+        EndSplitTransitions(Before);
+    if (After.m_TransitioningState != kNotTransitioning)
+        EndSplitTransitions(After);
+
+    D3D12_RESOURCE_BARRIER BarrierDesc;
+    BarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+    BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    BarrierDesc.Aliasing.pResourceBefore = Before.GetResource();
+    BarrierDesc.Aliasing.pResourceAfter = After.GetResource();
+    m_PendingBarriers.push_back(BarrierDesc);
+}
+
+void ResourceBarrierTracker::Flush( ID3D12GraphicsCommandList* CommandList )
+{
+    if (m_PendingBarriers.empty())
+        return;
+
+    CommandList->ResourceBarrier((UINT)m_PendingBarriers.size(), m_PendingBarriers.data());
+
+    m_Statistics.Emitted += m_PendingBarriers.size();
+    ++m_Statistics.Flushes;
+    m_PendingBarriers.clear();
+}
+
+void ResourceBarrierTracker::Reset( void )
+{
+    m_PendingBarriers.clear();
+
+    for (SplitTransition& Split : m_SplitTransitions)
+        Split.Resource->m_TransitioningState = kNotTransitioning;
+    m_SplitTransitions.clear();
+}
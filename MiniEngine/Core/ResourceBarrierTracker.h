@@ -0,0 +1,115 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// The resource barriers that a CommandContext has requested but not yet recorded.  Barriers are held back
+// until the context records work that depends on them, and while they wait, a later request for the same
+// resource is folded into the pending barrier:
+//
+//   A -> B followed by B -> A         cancels both barriers, except that a round trip out of
+//                                     UNORDERED_ACCESS leaves a UAV barrier in its place
+//   A -> B followed by B -> C         becomes A -> C
+//   BEGIN_ONLY followed by its end    becomes one ordinary barrier
+//   UAV barrier after a UAV barrier   is dropped
+//
+// A read-only state that is requested while a resource is already in a read-only state is added to the
+// current state instead of replacing it, so a resource read by several kinds of shader is not transitioned
+// back and forth, and a request for a state it already holds needs no barrier at all.  Merged states stay
+// within the states that the context's queue supports, and a request for a state that the compute queue
+// supports always leaves the resource in one, so that it can still be handed to a compute context.
+//
+// A split barrier (BeginTransition) is recorded as BEGIN_ONLY at the next flush, and its END_ONLY half
+// is held back until the resource is next asked for, so that the transition overlaps the work recorded in
+// between.
+//
+// Each GpuResource keeps one state for all of its subresources until one of them is transitioned on its
+// own.  From then on it keeps a state per subresource, until they all agree again.
+//
+
+#pragma once
+
+#include <vector>
+
+class GpuResource;
+
+#define VALID_COMPUTE_QUEUE_RESOURCE_STATES \
+    ( D3D12_RESOURCE_STATE_UNORDERED_ACCESS \
+    | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE \
+    | D3D12_RESOURCE_STATE_COPY_DEST \
+    | D3D12_RESOURCE_STATE_COPY_SOURCE )
+
+class ResourceBarrierTracker
+{
+public:
+    struct Statistics
+    {
+        uint64_t Emitted;       // Barriers handed to ResourceBarrier()
+        uint64_t Flushes;       // Calls to ResourceBarrier()
+        uint64_t Cancelled;     // Pending barriers removed by a later request
+        uint64_t Folded;        // Requests folded into a pending barrier
+        uint64_t Skipped;       // Requests for a state the resource already held
+    };
+
+    ResourceBarrierTracker( D3D12_COMMAND_LIST_TYPE Type );
+
+    // Subresource may be D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES.  A transition to UNORDERED_ACCESS from
+    // UNORDERED_ACCESS inserts a UAV barrier.
+    void Transition( GpuResource& Resource, D3D12_RESOURCE_STATES NewState, UINT Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES );
+
+    // Starts a split barrier.  It is ended by the next request of any kind for the resource (a transition to
+    // the state it was split for then needs nothing more), or by EndSplitTransitions().  Subresource may be
+    // D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES.
+    void BeginTransition( GpuResource& Resource, D3D12_RESOURCE_STATES NewState, UINT Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES );
+
+    void UAVBarrier( GpuResource& Resource );
+    void AliasBarrier( GpuResource& Before, GpuResource& After );
+
+    // Split barriers may not span command lists, so this must be called before the command list is closed.
+    void EndSplitTransitions( void );
+
+    void Flush( ID3D12GraphicsCommandList* CommandList );
+
+    // Drops everything pending.  Only valid when the command list was reset without being executed.
+    void Reset( void );
+
+    UINT GetPendingCount( void ) const { return (UINT)m_PendingBarriers.size(); }
+    const D3D12_RESOURCE_BARRIER* GetPendingBarriers( void ) const { return m_PendingBarriers.data(); }
+
+    const Statistics& GetStatistics( void ) const { return m_Statistics; }
+    void ResetStatistics( void );
+
+    // The number of subresources that a resource's barriers can name.
+    static UINT GetSubresourceCount( ID3D12Resource* Resource );
+
+private:
+    // A split barrier whose BEGIN_ONLY half has been requested.  The resource's recorded state stays the
+    // before state until the split ends.
+    struct SplitTransition
+    {
+        GpuResource* Resource;
+        UINT Subresource;
+        D3D12_RESOURCE_STATES After;
+    };
+
+    D3D12_RESOURCE_STATES MergeReadState( D3D12_RESOURCE_STATES OldState, D3D12_RESOURCE_STATES NewState ) const;
+    void TransitionSubresource( GpuResource& Resource, UINT Subresource, D3D12_RESOURCE_STATES NewState );
+    void CollapseSubresourceStates( GpuResource& Resource );
+    void BeginSubresourceTransition( GpuResource& Resource, UINT Subresource, D3D12_RESOURCE_STATES NewState );
+    void AddTransition( ID3D12Resource* Resource, UINT Subresource, D3D12_RESOURCE_STATES Before, D3D12_RESOURCE_STATES After );
+    void AddSplitBegin( GpuResource& Resource, UINT Subresource, D3D12_RESOURCE_STATES Before, D3D12_RESOURCE_STATES After );
+    void AddUAVBarrier( ID3D12Resource* Resource );
+    void EndSplitTransitions( GpuResource& Resource );
+
+    D3D12_COMMAND_LIST_TYPE m_Type;
+    std::vector<D3D12_RESOURCE_BARRIER> m_PendingBarriers;
+    std::vector<SplitTransition> m_SplitTransitions;
+    Statistics m_Statistics;
+};
@@ -0,0 +1,57 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "pch.h"
+#include "SamplerCache.h"
+
+SamplerCache::SamplerCache( SamplerDescriptorProvider& Provider, const D3D12_SAMPLER_DESC& FallbackDesc, uint32_t MaxSamplers )
+    : m_Provider(Provider), m_FallbackDesc(FallbackDesc), m_MaxSamplers(MaxSamplers), m_NumClaimed(0), m_NumSamplers(0), m_NumRejected(0)
+{
+    ASSERT(MaxSamplers > 0);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE SamplerCache::GetDescriptor( const D3D12_SAMPLER_DESC& Desc )
+{
+    // Every field of a sampler description is a word, so it can be used as its own key.
+    StateKey Key;
+    Key.Append(&Desc);
+
+    // The low bits pick the bucket within a shard, so use the high ones to pick the shard.
+    StateCache<D3D12_CPU_DESCRIPTOR_HANDLE>& Shard = m_Shards[(Key.GetHash() >> 32) % kNumShards];
+
+    return Shard.GetOrCreate(Key, [&]()
+    {
+        // The last slot is kept for the fallback.  Any other sampler claims a slot before creating anything so
+        // that racing threads can't overshoot the limit together.
+        if (memcmp(&Desc, &m_FallbackDesc, sizeof(Desc)) != 0)
+        {
+            uint32_t NumClaimed = m_NumClaimed.load(std::memory_order_relaxed);
+            do
+            {
+                if (NumClaimed >= m_MaxSamplers - 1)
+                {
+                    if (m_NumRejected.fetch_add(1, std::memory_order_relaxed) == 0)
+                    {
+                        Utility::Printf("Out of sampler descriptors:  %u distinct samplers fill a shader-visible heap.  "
+                            "Further samplers get the fallback sampler instead.\n", m_MaxSamplers);
+                    }
+                    return GetDescriptor(m_FallbackDesc);
+                }
+            }
+            while (!m_NumClaimed.compare_exchange_weak(NumClaimed, NumClaimed + 1, std::memory_order_relaxed));
+        }
+
+        m_NumSamplers.fetch_add(1, std::memory_order_relaxed);
+        return m_Provider.CreateSampler(Desc);
+    });
+}
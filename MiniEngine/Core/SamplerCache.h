@@ -0,0 +1,61 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Gives every distinct sampler description one descriptor.  Materials are loaded on many threads, so lookups are
+// spread over shards that each have their own lock.  Once a sampler exists, finding it holds a shard's lock only
+// for the hash table probe.
+//
+// A shader-visible sampler heap holds at most 2048 descriptors, so the cache refuses to create more distinct
+// samplers than that rather than letting a later copy into the heap fail.  Descriptions past the limit get the
+// fallback sampler, which always has a slot kept for it.
+//
+
+#pragma once
+
+#include "StateCache.h"
+
+// Makes the descriptors that a SamplerCache hands out.  The default provider allocates them from the sampler
+// descriptor allocator and writes them with the graphics device.  Any other provider lets the cache run without
+// a device.
+class SamplerDescriptorProvider
+{
+public:
+    virtual ~SamplerDescriptorProvider() {}
+    virtual D3D12_CPU_DESCRIPTOR_HANDLE CreateSampler( const D3D12_SAMPLER_DESC& Desc ) = 0;
+};
+
+class SamplerCache
+{
+public:
+    SamplerCache( SamplerDescriptorProvider& Provider, const D3D12_SAMPLER_DESC& FallbackDesc,
+        uint32_t MaxSamplers = D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE );
+
+    // Returns the descriptor created for an identical description, or creates it.  When no more distinct samplers
+    // fit under MaxSamplers, the description is given the fallback sampler's descriptor from then on, and the
+    // first time this happens a message is printed, in Release builds too.
+    D3D12_CPU_DESCRIPTOR_HANDLE GetDescriptor( const D3D12_SAMPLER_DESC& Desc );
+
+    uint32_t GetNumSamplers( void ) const { return m_NumSamplers.load(std::memory_order_relaxed); }
+    uint32_t GetNumRejected( void ) const { return m_NumRejected.load(std::memory_order_relaxed); }
+    uint32_t GetMaxSamplers( void ) const { return m_MaxSamplers; }
+
+private:
+    static const uint32_t kNumShards = 16;
+
+    SamplerDescriptorProvider& m_Provider;
+    const D3D12_SAMPLER_DESC m_FallbackDesc;
+    const uint32_t m_MaxSamplers;
+    std::atomic<uint32_t> m_NumClaimed;     // Slots taken by samplers other than the fallback
+    std::atomic<uint32_t> m_NumSamplers;
+    std::atomic<uint32_t> m_NumRejected;
+    StateCache<D3D12_CPU_DESCRIPTOR_HANDLE> m_Shards[kNumShards];
+};
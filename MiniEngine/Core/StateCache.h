@@ -0,0 +1,154 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Interns objects created from state descriptions (root signatures, pipeline states, samplers) so that each
+// distinct description is created once and shared.  The cache is keyed by a StateKey, a canonical copy of the
+// description:  every field that matters, none of the padding, and what pointers point to rather than the
+// pointers themselves wherever the pointer isn't the identity.  The key's 64-bit hash only picks the bucket.
+// A hit is confirmed by comparing the whole key, so two descriptions that happen to hash alike still get their
+// own objects.
+//
+// Any number of threads may ask for the same key at once.  The first one creates the object outside the lock
+// while the others wait for it.
+//
+
+#pragma once
+
+#include "Hash.h"
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+class StateKey
+{
+public:
+    StateKey() : m_Hash(0), m_HashValid(false) {}
+
+    template <typename T> void Append( const T* State, size_t Count = 1 )
+    {
+        static_assert((sizeof(T) & 3) == 0 && alignof(T) >= 4, "State object is not word-aligned");
+        const uint32_t* Words = (const uint32_t*)State;
+        m_Words.insert(m_Words.end(), Words, Words + Count * sizeof(T) / 4);
+        m_HashValid = false;
+    }
+
+    template <typename T> void AppendValue( const T& Value ) { Append(&Value); }
+
+    // Appends the characters and the terminator, padded to a whole word
+    void AppendString( const char* String )
+    {
+        size_t Length = String == nullptr ? 0 : strlen(String);
+        size_t FirstWord = m_Words.size();
+        m_Words.resize(FirstWord + Length / 4 + 1, 0);
+        if (Length > 0)
+            memcpy(m_Words.data() + FirstWord, String, Length);
+        m_HashValid = false;
+    }
+
+    uint64_t GetHash( void ) const
+    {
+        if (!m_HashValid)
+        {
+            m_Hash = Utility::HashBytes64(m_Words.data(), m_Words.size() * sizeof(uint32_t));
+            m_HashValid = true;
+        }
+        return m_Hash;
+    }
+
+    const uint32_t* GetWords( void ) const { return m_Words.data(); }
+    size_t GetNumWords( void ) const { return m_Words.size(); }
+
+    bool operator==( const StateKey& Rhs ) const { return m_Words == Rhs.m_Words; }
+    bool operator!=( const StateKey& Rhs ) const { return m_Words != Rhs.m_Words; }
+
+private:
+    std::vector<uint32_t> m_Words;
+    mutable uint64_t m_Hash;
+    mutable bool m_HashValid;
+};
+
+struct StateKeyHash
+{
+    size_t operator()( const StateKey& Key ) const { return (size_t)Key.GetHash(); }
+};
+
+template <typename ObjectType, typename KeyHash = StateKeyHash>
+class StateCache
+{
+public:
+    // Returns the object made for an identical key, or calls Create() to make it.  Create() runs without the
+    // lock held, and anyone else asking for the same key meanwhile waits for it to return.
+    template <typename CreateFunction>
+    const ObjectType& GetOrCreate( const StateKey& Key, CreateFunction Create, bool* WasCreated = nullptr )
+    {
+        Entry* Target = nullptr;
+        bool FirstRequest = false;
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+            auto Iter = m_Entries.find(Key);
+
+            // Reserve the entry so that the next request finds that someone got here first.
+            if (Iter == m_Entries.end())
+            {
+                Iter = m_Entries.emplace(std::piecewise_construct, std::forward_as_tuple(Key), std::forward_as_tuple()).first;
+                FirstRequest = true;
+            }
+            Target = &Iter->second;
+        }
+
+        if (FirstRequest)
+        {
+            Target->Object = Create();
+            Target->Ready.store(true, std::memory_order_release);
+        }
+        else
+        {
+            while (!Target->Ready.load(std::memory_order_acquire))
+                std::this_thread::yield();
+        }
+
+        if (WasCreated != nullptr)
+            *WasCreated = FirstRequest;
+
+        return Target->Object;
+    }
+
+    // Not safe while another thread is in GetOrCreate().
+    void Clear( void )
+    {
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+        m_Entries.clear();
+    }
+
+    size_t GetSize( void ) const
+    {
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+        return m_Entries.size();
+    }
+
+private:
+    struct Entry
+    {
+        Entry() : Object(), Ready(false) {}
+        ObjectType Object;
+        std::atomic<bool> Ready;
+    };
+
+    mutable std::mutex m_Mutex;
+
+    // Node based, so entries stay put while other keys are added
+    std::unordered_map<StateKey, Entry, KeyHash> m_Entries;
+};
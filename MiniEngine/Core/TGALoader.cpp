@@ -0,0 +1,484 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "pch.h"
+#include "TGALoader.h"
+#include <algorithm>
+#include <cstring>
+#include <intrin.h>
+
+namespace
+{
+    const size_t kHeaderSize = 18;
+
+    // Layouts of a stored pixel or palette entry
+    enum PixelFormat
+    {
+        kBGR555,        // Little-endian ARRRRRGGGGGBBBBB
+        kBGR24,
+        kBGRA32,
+        kGray8,
+        kGrayAlpha16,
+        kIndex8,
+        kIndex16,
+    };
+
+    bool CPUHasSSSE3( void )
+    {
+        int Info[4];
+        __cpuid(Info, 1);
+        return (Info[2] & (1 << 9)) != 0;
+    }
+
+    bool s_UseSSSE3 = CPUHasSSSE3();
+
+    inline uint16_t ReadU16( const uint8_t* Bytes )
+    {
+        return (uint16_t)(Bytes[0] | Bytes[1] << 8);
+    }
+
+    inline uint32_t ReadU32( const uint8_t* Bytes )
+    {
+        return (uint32_t)ReadU16(Bytes) | (uint32_t)ReadU16(Bytes + 2) << 16;
+    }
+
+    // A TGA 2.0 file ends with a footer giving the offset of its extension area, whose attributes type says what
+    // the alpha bits hold:  0 none, 1 and 2 undefined data, 3 alpha and 4 premultiplied alpha.  Returns -1 for
+    // files without an extension area.
+    int ReadAttributesType( const uint8_t* File, size_t FileSize )
+    {
+        const size_t kFooterSize = 26;
+        const size_t kExtensionAreaSize = 495;
+        if (FileSize < kHeaderSize + kExtensionAreaSize + kFooterSize)
+            return -1;
+
+        const uint8_t* Footer = File + FileSize - kFooterSize;
+        if (memcmp(Footer + 8, "TRUEVISION-XFILE.", 18) != 0)
+            return -1;
+
+        const size_t ExtensionOffset = ReadU32(Footer);
+        if (ExtensionOffset < kHeaderSize || ExtensionOffset > FileSize - kFooterSize - kExtensionAreaSize ||
+            ReadU16(File + ExtensionOffset) != kExtensionAreaSize)
+            return -1;
+
+        return File[ExtensionOffset + 494];
+    }
+
+    // Scales 5 bits to 8 so that 0 and 31 map to 0 and 255
+    inline uint32_t Expand5( uint32_t Bits )
+    {
+        return Bits << 3 | Bits >> 2;
+    }
+
+    // Pixels are written as RGBA bytes.  AlphaMask is OR'd into every pixel, and is 0xFF000000 for images without
+    // alpha.
+    void ConvertScalar( PixelFormat Format, const uint8_t* Src, uint32_t* Dest, uint32_t Count, uint32_t AlphaMask )
+    {
+        switch (Format)
+        {
+        case kBGR555:
+            for (uint32_t i = 0; i < Count; ++i, Src += 2)
+            {
+                uint32_t Pixel = ReadU16(Src);
+                uint32_t Alpha = (Pixel & 0x8000) ? 0xFF000000 : 0;
+                Dest[i] = Expand5(Pixel >> 10 & 31) | Expand5(Pixel >> 5 & 31) << 8 | Expand5(Pixel & 31) << 16 | Alpha | AlphaMask;
+            }
+            break;
+        case kBGR24:
+            for (uint32_t i = 0; i < Count; ++i, Src += 3)
+                Dest[i] = 0xFF000000 | Src[0] << 16 | Src[1] << 8 | Src[2];
+            break;
+        case kBGRA32:
+            for (uint32_t i = 0; i < Count; ++i, Src += 4)
+                Dest[i] = ((uint32_t)Src[3] << 24 | Src[0] << 16 | Src[1] << 8 | Src[2]) | AlphaMask;
+            break;
+        case kGray8:
+            for (uint32_t i = 0; i < Count; ++i)
+                Dest[i] = 0xFF000000 | Src[i] * 0x010101u;
+            break;
+        case kGrayAlpha16:
+            for (uint32_t i = 0; i < Count; ++i, Src += 2)
+                Dest[i] = ((uint32_t)Src[1] << 24 | Src[0] * 0x010101u) | AlphaMask;
+            break;
+        default:
+            break;
+        }
+    }
+
+    //
+    // SSSE3 versions.  Each converts as many whole vectors as fit in the span and leaves the rest to
+    // ConvertScalar().  None of them reads past the end of the span.
+    //
+
+    uint32_t ConvertBGR24_SSSE3( const uint8_t* Src, uint32_t* Dest, uint32_t Count )
+    {
+        const __m128i Shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+        const __m128i Alpha = _mm_set1_epi32((int)0xFF000000);
+
+        // Sixteen pixels from three loads, with the pixels that straddle loads put back together by PALIGNR
+        uint32_t i = 0;
+        for (; i + 16 <= Count; i += 16, Src += 48)
+        {
+            __m128i A = _mm_loadu_si128((const __m128i*)Src);
+            __m128i B = _mm_loadu_si128((const __m128i*)(Src + 16));
+            __m128i C = _mm_loadu_si128((const __m128i*)(Src + 32));
+            _mm_storeu_si128((__m128i*)(Dest + i + 0), _mm_or_si128(_mm_shuffle_epi8(A, Shuffle), Alpha));
+            _mm_storeu_si128((__m128i*)(Dest + i + 4), _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(B, A, 12), Shuffle), Alpha));
+            _mm_storeu_si128((__m128i*)(Dest + i + 8), _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(C, B, 8), Shuffle), Alpha));
+            _mm_storeu_si128((__m128i*)(Dest + i + 12), _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(C, 4), Shuffle), Alpha));
+        }
+        return i;
+    }
+
+    uint32_t ConvertBGRA32_SSSE3( const uint8_t* Src, uint32_t* Dest, uint32_t Count, uint32_t AlphaMask )
+    {
+        const __m128i Shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        const __m128i Alpha = _mm_set1_epi32((int)AlphaMask);
+
+        uint32_t i = 0;
+        for (; i + 8 <= Count; i += 8, Src += 32)
+        {
+            __m128i A = _mm_loadu_si128((const __m128i*)Src);
+            __m128i B = _mm_loadu_si128((const __m128i*)(Src + 16));
+            _mm_storeu_si128((__m128i*)(Dest + i + 0), _mm_or_si128(_mm_shuffle_epi8(A, Shuffle), Alpha));
+            _mm_storeu_si128((__m128i*)(Dest + i + 4), _mm_or_si128(_mm_shuffle_epi8(B, Shuffle), Alpha));
+        }
+        return i;
+    }
+
+    uint32_t ConvertGray8_SSSE3( const uint8_t* Src, uint32_t* Dest, uint32_t Count )
+    {
+        const __m128i Shuffle0 = _mm_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1);
+        const __m128i Next = _mm_set1_epi8(4);
+        const __m128i Alpha = _mm_set1_epi32((int)0xFF000000);
+
+        uint32_t i = 0;
+        for (; i + 16 <= Count; i += 16, Src += 16)
+        {
+            __m128i A = _mm_loadu_si128((const __m128i*)Src);
+            __m128i Shuffle1 = _mm_add_epi8(Shuffle0, Next);
+            __m128i Shuffle2 = _mm_add_epi8(Shuffle1, Next);
+            __m128i Shuffle3 = _mm_add_epi8(Shuffle2, Next);
+            _mm_storeu_si128((__m128i*)(Dest + i + 0), _mm_or_si128(_mm_shuffle_epi8(A, Shuffle0), Alpha));
+            _mm_storeu_si128((__m128i*)(Dest + i + 4), _mm_or_si128(_mm_shuffle_epi8(A, Shuffle1), Alpha));
+            _mm_storeu_si128((__m128i*)(Dest + i + 8), _mm_or_si128(_mm_shuffle_epi8(A, Shuffle2), Alpha));
+            _mm_storeu_si128((__m128i*)(Dest + i + 12), _mm_or_si128(_mm_shuffle_epi8(A, Shuffle3), Alpha));
+        }
+        return i;
+    }
+
+    uint32_t ConvertGrayAlpha16_SSSE3( const uint8_t* Src, uint32_t* Dest, uint32_t Count, uint32_t AlphaMask )
+    {
+        const __m128i ShuffleLo = _mm_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7);
+        const __m128i ShuffleHi = _mm_setr_epi8(8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14, 14, 15);
+        const __m128i Alpha = _mm_set1_epi32((int)AlphaMask);
+
+        uint32_t i = 0;
+        for (; i + 8 <= Count; i += 8, Src += 16)
+        {
+            __m128i A = _mm_loadu_si128((const __m128i*)Src);
+            _mm_storeu_si128((__m128i*)(Dest + i + 0), _mm_or_si128(_mm_shuffle_epi8(A, ShuffleLo), Alpha));
+            _mm_storeu_si128((__m128i*)(Dest + i + 4), _mm_or_si128(_mm_shuffle_epi8(A, ShuffleHi), Alpha));
+        }
+        return i;
+    }
+
+    // Four 16-bit pixels zero extended to 32 bits
+    inline __m128i ExpandBGR555( __m128i Pixels, __m128i AlphaMask )
+    {
+        const __m128i FiveBits = _mm_set1_epi32(31);
+        __m128i R = _mm_and_si128(_mm_srli_epi32(Pixels, 10), FiveBits);
+        __m128i G = _mm_and_si128(_mm_srli_epi32(Pixels, 5), FiveBits);
+        __m128i B = _mm_and_si128(Pixels, FiveBits);
+        __m128i RGB = _mm_or_si128(_mm_or_si128(R, _mm_slli_epi32(G, 8)), _mm_slli_epi32(B, 16));
+
+        // Every channel at once.  The mask drops the bits each byte shifts into its neighbor.
+        RGB = _mm_or_si128(_mm_slli_epi32(RGB, 3), _mm_and_si128(_mm_srli_epi32(RGB, 2), _mm_set1_epi32(0x070707)));
+
+        // Bit 15 copied into the whole alpha byte
+        __m128i A = _mm_and_si128(_mm_srai_epi32(_mm_slli_epi32(Pixels, 16), 31), _mm_set1_epi32((int)0xFF000000));
+        return _mm_or_si128(_mm_or_si128(RGB, A), AlphaMask);
+    }
+
+    // SSE2 is enough for this one
+    uint32_t ConvertBGR555_SSE2( const uint8_t* Src, uint32_t* Dest, uint32_t Count, uint32_t AlphaMask )
+    {
+        const __m128i Zero = _mm_setzero_si128();
+        const __m128i Alpha = _mm_set1_epi32((int)AlphaMask);
+
+        uint32_t i = 0;
+        for (; i + 8 <= Count; i += 8, Src += 16)
+        {
+            __m128i A = _mm_loadu_si128((const __m128i*)Src);
+            _mm_storeu_si128((__m128i*)(Dest + i + 0), ExpandBGR555(_mm_unpacklo_epi16(A, Zero), Alpha));
+            _mm_storeu_si128((__m128i*)(Dest + i + 4), ExpandBGR555(_mm_unpackhi_epi16(A, Zero), Alpha));
+        }
+        return i;
+    }
+
+    struct PixelConverter
+    {
+        PixelFormat Format;
+        uint32_t BytesPerPixel;
+        uint32_t AlphaMask;
+        const uint32_t* Palette;
+        uint32_t PaletteFirstEntry;
+        uint32_t PaletteLength;
+        bool UseSIMD;
+
+        // Returns false for a color index outside the palette
+        bool Convert( const uint8_t* Src, uint32_t* Dest, uint32_t Count ) const
+        {
+            if (Format == kIndex8 || Format == kIndex16)
+            {
+                for (uint32_t i = 0; i < Count; ++i)
+                {
+                    uint32_t Index = Format == kIndex8 ? Src[i] : ReadU16(Src + i * 2);
+                    uint32_t Entry = Index - PaletteFirstEntry;
+                    if (Entry >= PaletteLength)
+                        return false;
+                    Dest[i] = Palette[Entry];
+                }
+                return true;
+            }
+
+            uint32_t Done = 0;
+            if (UseSIMD && Count >= 8)
+            {
+                switch (Format)
+                {
+                case kBGR555: Done = ConvertBGR555_SSE2(Src, Dest, Count, AlphaMask); break;
+                case kBGR24: Done = ConvertBGR24_SSSE3(Src, Dest, Count); break;
+                case kBGRA32: Done = ConvertBGRA32_SSSE3(Src, Dest, Count, AlphaMask); break;
+                case kGray8: Done = ConvertGray8_SSSE3(Src, Dest, Count); break;
+                case kGrayAlpha16: Done = ConvertGrayAlpha16_SSSE3(Src, Dest, Count, AlphaMask); break;
+                default: break;
+                }
+            }
+
+            ConvertScalar(Format, Src + Done * BytesPerPixel, Dest + Done, Count - Done, AlphaMask);
+            return true;
+        }
+    };
+
+    PixelFormat GetPixelFormat( uint32_t ImageType, uint32_t BitsPerPixel )
+    {
+        switch (ImageType & 7)
+        {
+        case 1: return BitsPerPixel == 8 ? kIndex8 : kIndex16;
+        case 3: return BitsPerPixel == 8 ? kGray8 : kGrayAlpha16;
+        default: return BitsPerPixel == 24 ? kBGR24 : BitsPerPixel == 32 ? kBGRA32 : kBGR555;
+        }
+    }
+
+    // Rows are numbered in file order, and finished rows are mirrored if they were stored right to left.
+    class RowWriter
+    {
+    public:
+        RowWriter( const TGAImageInfo& Info, void* Dest, size_t DestRowPitch )
+            : m_Info(Info), m_Dest((uint8_t*)Dest), m_RowPitch(DestRowPitch) {}
+
+        uint32_t* GetRow( uint32_t Row ) const
+        {
+            uint32_t DestRow = m_Info.TopToBottom ? Row : m_Info.Height - 1 - Row;
+            return (uint32_t*)(m_Dest + DestRow * m_RowPitch);
+        }
+
+        void FinishRow( uint32_t Row ) const
+        {
+            if (m_Info.RightToLeft)
+            {
+                uint32_t* Pixels = GetRow(Row);
+                std::reverse(Pixels, Pixels + m_Info.Width);
+            }
+        }
+
+    private:
+        const TGAImageInfo& m_Info;
+        uint8_t* m_Dest;
+        size_t m_RowPitch;
+    };
+}
+
+bool ReadTGAHeader( const void* FileData, size_t FileSize, TGAImageInfo& Info )
+{
+    if (FileData == nullptr || FileSize < kHeaderSize)
+        return false;
+
+    const uint8_t* Header = (const uint8_t*)FileData;
+    const uint8_t IDLength = Header[0];
+    const uint8_t ColorMapType = Header[1];
+    const uint8_t Descriptor = Header[17];
+
+    Info.ImageType = Header[2];
+    Info.PaletteFirstEntry = ReadU16(Header + 3);
+    Info.PaletteLength = ReadU16(Header + 5);
+    Info.PaletteBitsPerEntry = Header[7];
+    Info.Width = ReadU16(Header + 12);
+    Info.Height = ReadU16(Header + 14);
+    Info.BitsPerPixel = Header[16];
+    Info.RightToLeft = (Descriptor & 0x10) != 0;
+    Info.TopToBottom = (Descriptor & 0x20) != 0;
+
+    if (Info.Width == 0 || Info.Height == 0 || Info.Width > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+        Info.Height > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION || ColorMapType > 1)
+        return false;
+
+    const uint32_t Depth = Info.BitsPerPixel;
+    const uint32_t PaletteDepth = Info.PaletteBitsPerEntry;
+    switch (Info.ImageType)
+    {
+    case 1:
+    case 9:
+        if (ColorMapType != 1 || Info.PaletteLength == 0 || (Depth != 8 && Depth != 16) ||
+            (PaletteDepth != 15 && PaletteDepth != 16 && PaletteDepth != 24 && PaletteDepth != 32))
+            return false;
+        break;
+    case 2:
+    case 10:
+        if (Depth != 15 && Depth != 16 && Depth != 24 && Depth != 32)
+            return false;
+        break;
+    case 3:
+    case 11:
+        if (Depth != 8 && Depth != 16)
+            return false;
+        break;
+    default:
+        return false;
+    }
+
+    // Writers often leave the attribute bits of 32-bit images at zero, so the fourth byte is taken as alpha
+    // unless the extension area says it isn't.  Other depths go by the attribute bits.
+    const int AttributesType = ReadAttributesType(Header, FileSize);
+    if (AttributesType >= 0)
+        Info.HasAlpha = AttributesType >= 3;
+    else
+        Info.HasAlpha = (Descriptor & 0xF) != 0 || Depth == 32 || ((Info.ImageType & 7) == 1 && PaletteDepth == 32);
+
+    // A color map may be present in any image, but is only used by color mapped ones.
+    const size_t PaletteBytes = ColorMapType == 1 ? (size_t)Info.PaletteLength * ((PaletteDepth + 7) / 8) : 0;
+    Info.PaletteOffset = kHeaderSize + IDLength;
+    Info.PixelOffset = Info.PaletteOffset + PaletteBytes;
+    if (Info.PixelOffset > FileSize)
+        return false;
+
+    // Compressed images are checked while they are decoded.
+    const size_t PixelBytes = (size_t)Info.Width * Info.Height * ((Depth + 7) / 8);
+    if (Info.ImageType < 9 && PixelBytes > FileSize - Info.PixelOffset)
+        return false;
+
+    return true;
+}
+
+bool DecodeTGA( const void* FileData, size_t FileSize, const TGAImageInfo& Info, void* Dest, size_t DestRowPitch )
+{
+    const uint8_t* File = (const uint8_t*)FileData;
+    const uint8_t* Src = File + Info.PixelOffset;
+    const uint8_t* const End = File + FileSize;
+
+    // The top bit of a 16-bit pixel is only alpha with attribute bits, and the top bit of a 15-bit one never is.
+    const uint32_t AlphaMask = Info.HasAlpha && Info.BitsPerPixel != 15 ? 0 : 0xFF000000;
+
+    PixelConverter Converter;
+    Converter.Format = GetPixelFormat(Info.ImageType, Info.BitsPerPixel);
+    Converter.BytesPerPixel = (Info.BitsPerPixel + 7) / 8;
+    Converter.AlphaMask = AlphaMask;
+    Converter.Palette = nullptr;
+    Converter.PaletteFirstEntry = Info.PaletteFirstEntry;
+    Converter.PaletteLength = Info.PaletteLength;
+    Converter.UseSIMD = s_UseSSSE3;
+
+    std::vector<uint32_t> Palette;
+    if ((Info.ImageType & 7) == 1)
+    {
+        // HasAlpha describes the palette entries of a color mapped image.
+        const uint32_t EntryAlphaMask = Info.HasAlpha && Info.PaletteBitsPerEntry != 15 ? 0 : 0xFF000000;
+        Palette.resize(Info.PaletteLength);
+        ConvertScalar(GetPixelFormat(2, Info.PaletteBitsPerEntry), File + Info.PaletteOffset, Palette.data(),
+            Info.PaletteLength, EntryAlphaMask);
+        Converter.Palette = Palette.data();
+    }
+
+    const RowWriter Rows(Info, Dest, DestRowPitch);
+    const uint32_t Width = Info.Width;
+    const size_t BytesPerPixel = Converter.BytesPerPixel;
+
+    if (Info.ImageType < 9)
+    {
+        for (uint32_t Row = 0; Row < Info.Height; ++Row, Src += Width * BytesPerPixel)
+        {
+            if (!Converter.Convert(Src, Rows.GetRow(Row), Width))
+                return false;
+            Rows.FinishRow(Row);
+        }
+        return true;
+    }
+
+    // Each packet is a header byte followed by one pixel to repeat or by that many literal pixels.  Packets are
+    // supposed to end at the end of a row, but plenty of writers let them run on to the next one.
+    uint32_t Row = 0;
+    uint32_t Column = 0;
+    uint32_t* RowPixels = Rows.GetRow(0);
+    while (Row < Info.Height)
+    {
+        if (Src == End)
+            return false;
+
+        const uint8_t PacketHeader = *Src++;
+        uint32_t Count = (PacketHeader & 0x7F) + 1u;
+
+        uint32_t RunPixel = 0;
+        const bool IsRun = (PacketHeader & 0x80) != 0;
+        if (IsRun)
+        {
+            if ((size_t)(End - Src) < BytesPerPixel || !Converter.Convert(Src, &RunPixel, 1))
+                return false;
+            Src += BytesPerPixel;
+        }
+        else if ((size_t)(End - Src) < Count * BytesPerPixel)
+            return false;
+
+        // Pixels past the end of the image are ignored.
+        while (Count > 0 && Row < Info.Height)
+        {
+            uint32_t Span = std::min(Count, Width - Column);
+            if (IsRun)
+                std::fill(RowPixels + Column, RowPixels + Column + Span, RunPixel);
+            else
+            {
+                if (!Converter.Convert(Src, RowPixels + Column, Span))
+                    return false;
+                Src += Span * BytesPerPixel;
+            }
+
+            Count -= Span;
+            Column += Span;
+            if (Column == Width)
+            {
+                Rows.FinishRow(Row);
+                Column = 0;
+                if (++Row < Info.Height)
+                    RowPixels = Rows.GetRow(Row);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ConfigureTGADecoder( bool UseSSSE3 )
+{
+    s_UseSSSE3 = UseSSSE3 && CPUHasSSSE3();
+    return s_UseSSSE3;
+}
@@ -0,0 +1,57 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Decodes Truevision TGA images to 32-bit RGBA.  All of the current image types are understood:  uncompressed
+// and run-length encoded true color (15, 16, 24 and 32 bits), grayscale (8 bits, or 16 with alpha) and color
+// mapped (8 or 16-bit indices into a 15, 16, 24 or 32-bit palette).  Rows are written top row first whichever
+// corner the file starts in.
+//
+// Pixels are written straight to memory the caller provides, at any row pitch, so a texture can be decoded into
+// its upload buffer without an intermediate copy.  Rows of 24-bit, 32-bit and grayscale pixels are swizzled with
+// SSSE3 when the CPU has it.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct TGAImageInfo
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint8_t ImageType;          // 1-3 uncompressed color mapped, true color or grayscale; 9-11 the same with RLE
+    uint8_t BitsPerPixel;       // As stored, so color mapped images report the size of an index
+    bool HasAlpha;              // Set by the extension area's attributes type when the file has one, and otherwise
+                                // by the attribute bits, except that 32-bit pixels always keep their fourth byte
+    bool TopToBottom;
+    bool RightToLeft;
+
+    // Filled in by ReadTGAHeader() for DecodeTGA()
+    uint8_t PaletteBitsPerEntry;
+    uint16_t PaletteFirstEntry;
+    uint16_t PaletteLength;
+    size_t PaletteOffset;
+    size_t PixelOffset;
+};
+
+// Checks the header and everything else that can be checked without decoding, such as whether the file is long
+// enough to hold an uncompressed image.  Returns false for anything this decoder can't read.
+bool ReadTGAHeader( const void* FileData, size_t FileSize, TGAImageInfo& Info );
+
+// Writes Info.Width x Info.Height RGBA8 pixels, DestRowPitch bytes apart.  Returns false when compressed data
+// runs past the end of the file or a color index is outside the palette; the destination is partly written then.
+bool DecodeTGA( const void* FileData, size_t FileSize, const TGAImageInfo& Info, void* Dest, size_t DestRowPitch );
+
+// Selects the SSSE3 or the scalar row conversions.  SSSE3 is chosen at startup when the CPU has it, and can't
+// be selected when it doesn't.  Returns whether SSSE3 is now used.
+bool ConfigureTGADecoder( bool UseSSSE3 );
@@ -16,6 +16,7 @@
 #include "TextureManager.h"
 #include "FileUtility.h"
 #include "DDSTextureLoader.h"
+#include "TGALoader.h"
 #include "GraphicsCore.h"
 #include "CommandContext.h"
 #include <map>
@@ -29,7 +30,7 @@ static UINT BytesPerPixel( DXGI_FORMAT Format )
     return (UINT)BitsPerPixel(Format) / 8;
 };
 
-void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT Format, const void* InitialData )
+void Texture::CreateResource( size_t Width, size_t Height, DXGI_FORMAT Format )
 {
     m_UsageState = D3D12_RESOURCE_STATE_COPY_DEST;
 
@@ -56,75 +57,83 @@ void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT For
         m_UsageState, nullptr, MY_IID_PPV_ARGS(m_pResource.ReleaseAndGetAddressOf())));
 
     m_pResource->SetName(L"Texture");
+}
 
-    D3D12_SUBRESOURCE_DATA texResource;
-    texResource.pData = InitialData;
-    texResource.RowPitch = Pitch * BytesPerPixel(Format);
-    texResource.SlicePitch = texResource.RowPitch * Height;
-
-    CommandContext::InitializeTexture(*this, 1, &texResource);
-
+void Texture::AllocateSRV( void )
+{
     if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+    {
         m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    g_Device->CreateShaderResourceView(m_pResource.Get(), nullptr, m_hCpuDescriptorHandle);
+        m_OwnsDescriptor = true;
+    }
 }
 
-void Texture::CreateTGAFromMemory( const void* _filePtr, size_t, bool sRGB )
+void Texture::FreeSRV( void )
 {
-    const uint8_t* filePtr = (const uint8_t*)_filePtr;
+    if (m_OwnsDescriptor)
+    {
+        FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_hCpuDescriptorHandle);
+        m_OwnsDescriptor = false;
+    }
+}
 
-    // Skip first two bytes
-    filePtr += 2;
+void Texture::Destroy( void )
+{
+    GpuResource::Destroy();
+    FreeSRV();
+    m_hCpuDescriptorHandle.ptr = 0;
+}
 
-    /*uint8_t imageTypeCode =*/ *filePtr++;
+// Allocating the descriptor last is what tells ManagedTexture::WaitForLoad() that the texture is ready.
+void Texture::CreateSRV( void )
+{
+    AllocateSRV();
+    g_Device->CreateShaderResourceView(m_pResource.Get(), nullptr, m_hCpuDescriptorHandle);
+}
 
-    // Ignore another 9 bytes
-    filePtr += 9;
+void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT Format, const void* InitialData )
+{
+    CreateResource(Width, Height, Format);
 
-    uint16_t imageWidth = *(uint16_t*)filePtr;
-    filePtr += sizeof(uint16_t);
-    uint16_t imageHeight = *(uint16_t*)filePtr;
-    filePtr += sizeof(uint16_t);
-    uint8_t bitCount = *filePtr++;
+    D3D12_SUBRESOURCE_DATA texResource;
+    texResource.pData = InitialData;
+    texResource.RowPitch = Pitch * BytesPerPixel(Format);
+    texResource.SlicePitch = texResource.RowPitch * Height;
 
-    // Ignore another byte
-    filePtr++;
+    CommandContext::InitializeTexture(*this, 1, &texResource);
+
+    CreateSRV();
+}
 
-    uint32_t* formattedData = new uint32_t[imageWidth * imageHeight];
-    uint32_t* iter = formattedData;
+bool Texture::CreateTGAFromMemory( const void* memBuffer, size_t fileSize, bool sRGB )
+{
+    TGAImageInfo Info;
+    if (!ReadTGAHeader(memBuffer, fileSize, Info))
+        return false;
 
-    uint8_t numChannels = bitCount / 8;
-    uint32_t numBytes = imageWidth * imageHeight * numChannels;
+    CreateResource(Info.Width, Info.Height, sRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM);
 
-    switch (numChannels)
+    // Decode straight into the upload buffer
+    bool Decoded = false;
+    CommandContext::InitializeTexture(*this, [&]( void* Data, size_t RowPitch )
     {
-    default:
-        break;
-    case 3:
-        for (uint32_t byteIdx = 0; byteIdx < numBytes; byteIdx += 3)
-        {
-            *iter++ = 0xff000000 | filePtr[0] << 16 | filePtr[1] << 8 | filePtr[2];
-            filePtr += 3;
-        }
-        break;
-    case 4:
-        for (uint32_t byteIdx = 0; byteIdx < numBytes; byteIdx += 4)
-        {
-            *iter++ = filePtr[3] << 24 | filePtr[0] << 16 | filePtr[1] << 8 | filePtr[2];
-            filePtr += 4;
-        }
-        break;
-    }
+        Decoded = DecodeTGA(memBuffer, fileSize, Info, Data, RowPitch);
+    });
 
-    Create( imageWidth, imageHeight, sRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM, formattedData );
+    if (!Decoded)
+    {
+        // Leave the descriptor alone so that waiting threads keep waiting for the invalid texture.
+        GpuResource::Destroy();
+        return false;
+    }
 
-    delete [] formattedData;
+    CreateSRV();
+    return true;
 }
 
 bool Texture::CreateDDSFromMemory( const void* filePtr, size_t fileSize, bool sRGB )
 {
-    if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-        m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    AllocateSRV();
 
     HRESULT hr = CreateDDSTextureFromMemory( Graphics::g_Device,
         (const uint8_t*)filePtr, fileSize, 0, sRGB, &m_pResource, m_hCpuDescriptorHandle );
@@ -248,6 +257,8 @@ void ManagedTexture::WaitForLoad( void ) const
 
 void ManagedTexture::SetToInvalidTexture( void )
 {
+    // A failed DDS load may have allocated a descriptor already.  The magenta texture's SRV is only borrowed.
+    FreeSRV();
     m_hCpuDescriptorHandle = TextureManager::GetMagentaTex2D().GetSRV();
     m_IsValid = false;
 }
@@ -299,13 +310,10 @@ const ManagedTexture* TextureManager::LoadTGAFromFile( const std::wstring& fileN
     }
 
     Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + fileName );
-    if (ba->size() > 0)
-    {
-        ManTex->CreateTGAFromMemory( ba->data(), ba->size(), sRGB );
-        ManTex->GetResource()->SetName(fileName.c_str());
-    }
-    else
+    if (ba->size() == 0 || !ManTex->CreateTGAFromMemory( ba->data(), ba->size(), sRGB ))
         ManTex->SetToInvalidTexture();
+    else
+        ManTex->GetResource()->SetName(fileName.c_str());
 
     return ManTex;
 }
@@ -24,8 +24,12 @@ class Texture : public GpuResource
 
 public:
 
-    Texture() { m_hCpuDescriptorHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN; }
-    Texture(D3D12_CPU_DESCRIPTOR_HANDLE Handle) : m_hCpuDescriptorHandle(Handle) {}
+    Texture() : m_OwnsDescriptor(false) { m_hCpuDescriptorHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN; }
+
+    // The handle is borrowed; whoever allocated it is responsible for freeing it.
+    Texture(D3D12_CPU_DESCRIPTOR_HANDLE Handle) : m_hCpuDescriptorHandle(Handle), m_OwnsDescriptor(false) {}
+
+    virtual ~Texture() { Destroy(); }
 
     // Create a 1-level 2D texture
     void Create(size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT Format, const void* InitData );
@@ -34,15 +38,11 @@ public:
         Create(Width, Width, Height, Format, InitData);
     }
 
-    void CreateTGAFromMemory( const void* memBuffer, size_t fileSize, bool sRGB );
+    bool CreateTGAFromMemory( const void* memBuffer, size_t fileSize, bool sRGB );
     bool CreateDDSFromMemory( const void* memBuffer, size_t fileSize, bool sRGB );
     void CreatePIXImageFromMemory( const void* memBuffer, size_t fileSize );
 
-    virtual void Destroy() override
-    {
-        GpuResource::Destroy();
-        m_hCpuDescriptorHandle.ptr = 0;
-    }
+    virtual void Destroy() override;
 
     const D3D12_CPU_DESCRIPTOR_HANDLE& GetSRV() const { return m_hCpuDescriptorHandle; }
 
@@ -50,7 +50,13 @@ public:
 
 protected:
 
+    void CreateResource( size_t Width, size_t Height, DXGI_FORMAT Format );
+    void CreateSRV( void );
+    void AllocateSRV( void );
+    void FreeSRV( void );
+
     D3D12_CPU_DESCRIPTOR_HANDLE m_hCpuDescriptorHandle;
+    bool m_OwnsDescriptor;
 };
 
 class ManagedTexture : public Texture
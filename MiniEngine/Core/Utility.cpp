@@ -14,125 +14,275 @@
 #include "pch.h"
 #include "Utility.h"
 #include <string>
+#include <intrin.h>
 
-// A faster version of memcopy that uses SSE instructions.  TODO:  Write an ARM variant if necessary.
-void SIMDMemCopy( void* __restrict _Dest, const void* __restrict _Source, size_t NumQuadwords )
+// SIMDMemCopy() and SIMDMemFill() are written once against a vector type and instantiated for SSE2, AVX2 and
+// AVX-512.  The widest one the CPU supports is chosen when the program starts.  TODO:  Write an ARM variant if
+// necessary.
+//
+// Every variant writes the first and last vector with unaligned stores and everything between them with aligned
+// stores.  The ends overlap the aligned run, so neither pointer needs to be aligned and the length doesn't need to
+// be a multiple of the vector size.
+
+#if (defined(_MSC_VER) && _MSC_VER >= 1911) || defined(__AVX512F__)
+#define SIMD_MEM_AVX512     // AVX-512 intrinsics arrived with Visual Studio 2017 15.3
+#endif
+
+namespace
 {
-    ASSERT(Math::IsAligned(_Dest, 16));
-    ASSERT(Math::IsAligned(_Source, 16));
+    struct SSE2Vector
+    {
+        typedef __m128i Type;
+        static const size_t kBytes = 16;
+        static Type Load( const uint8_t* Source ) { return _mm_loadu_si128((const __m128i*)Source); }
+        static void StoreUnaligned( uint8_t* Dest, Type V ) { _mm_storeu_si128((__m128i*)Dest, V); }
+        static void Store( uint8_t* Dest, Type V ) { _mm_store_si128((__m128i*)Dest, V); }
+        static void Stream( uint8_t* Dest, Type V ) { _mm_stream_si128((__m128i*)Dest, V); }
+        static void Finish( void ) {}
+    };
 
-    __m128i* __restrict Dest = (__m128i* __restrict)_Dest;
-    const __m128i* __restrict Source = (const __m128i* __restrict)_Source;
+    struct AVX2Vector
+    {
+        typedef __m256i Type;
+        static const size_t kBytes = 32;
+        static Type Load( const uint8_t* Source ) { return _mm256_loadu_si256((const __m256i*)Source); }
+        static void StoreUnaligned( uint8_t* Dest, Type V ) { _mm256_storeu_si256((__m256i*)Dest, V); }
+        static void Store( uint8_t* Dest, Type V ) { _mm256_store_si256((__m256i*)Dest, V); }
+        static void Stream( uint8_t* Dest, Type V ) { _mm256_stream_si256((__m256i*)Dest, V); }
+        // Avoid the penalty for mixing VEX and legacy SSE code
+        static void Finish( void ) { _mm256_zeroupper(); }
+    };
 
-    // Discover how many quadwords precede a cache line boundary.  Copy them separately.
-    size_t InitialQuadwordCount = (4 - ((size_t)Source >> 4) & 3) & 3;
-    if (InitialQuadwordCount > NumQuadwords)
-        InitialQuadwordCount = NumQuadwords;
+#ifdef SIMD_MEM_AVX512
+    struct AVX512Vector
+    {
+        typedef __m512i Type;
+        static const size_t kBytes = 64;
+        static Type Load( const uint8_t* Source ) { return _mm512_loadu_si512((const void*)Source); }
+        static void StoreUnaligned( uint8_t* Dest, Type V ) { _mm512_storeu_si512((void*)Dest, V); }
+        static void Store( uint8_t* Dest, Type V ) { _mm512_store_si512((void*)Dest, V); }
+        static void Stream( uint8_t* Dest, Type V ) { _mm512_stream_si512((__m512i*)Dest, V); }
+        static void Finish( void ) { _mm256_zeroupper(); }
+    };
+#endif
 
-    switch (InitialQuadwordCount)
+    template <typename V, bool Streaming>
+    inline void PutVector( uint8_t* Dest, typename V::Type Value )
     {
-    case 3: _mm_stream_si128(Dest + 2, _mm_load_si128(Source + 2));	 // Fall through
-    case 2: _mm_stream_si128(Dest + 1, _mm_load_si128(Source + 1));	 // Fall through
-    case 1: _mm_stream_si128(Dest + 0, _mm_load_si128(Source + 0));	 // Fall through
-    default:
-        break;
+        if (Streaming)
+            V::Stream(Dest, Value);
+        else
+            V::Store(Dest, Value);
     }
 
-    if (NumQuadwords == InitialQuadwordCount)
-        return;
+    template <typename V, bool Streaming>
+    void CopyBytes( uint8_t* __restrict Dest, const uint8_t* __restrict Source, size_t NumBytes )
+    {
+        if (NumBytes < V::kBytes)
+        {
+            memcpy(Dest, Source, NumBytes);
+            return;
+        }
+
+        // Read both ends before writing anything.  They are stored last, unaligned, over the ends of the aligned run.
+        const typename V::Type Head = V::Load(Source);
+        const typename V::Type Tail = V::Load(Source + NumBytes - V::kBytes);
+
+        uint8_t* const End = Dest + NumBytes;
+        uint8_t* const AlignedEnd = (uint8_t*)((size_t)End & ~(V::kBytes - 1));
+        const size_t HeadBytes = V::kBytes - ((size_t)Dest & (V::kBytes - 1));
+        uint8_t* Next = Dest + HeadBytes;
+        Source += HeadBytes;
+
+        // Four vectors per loop to minimize stalls.  The hardware prefetcher follows the source on its own;
+        // software prefetching only slowed it down.
+        while ((size_t)(AlignedEnd - Next) >= 4 * V::kBytes)
+        {
+            const typename V::Type V0 = V::Load(Source + 0 * V::kBytes);
+            const typename V::Type V1 = V::Load(Source + 1 * V::kBytes);
+            const typename V::Type V2 = V::Load(Source + 2 * V::kBytes);
+            const typename V::Type V3 = V::Load(Source + 3 * V::kBytes);
+            PutVector<V, Streaming>(Next + 0 * V::kBytes, V0);
+            PutVector<V, Streaming>(Next + 1 * V::kBytes, V1);
+            PutVector<V, Streaming>(Next + 2 * V::kBytes, V2);
+            PutVector<V, Streaming>(Next + 3 * V::kBytes, V3);
+
+            Next += 4 * V::kBytes;
+            Source += 4 * V::kBytes;
+        }
+
+        while (Next < AlignedEnd)
+        {
+            PutVector<V, Streaming>(Next, V::Load(Source));
+            Next += V::kBytes;
+            Source += V::kBytes;
+        }
+
+        V::StoreUnaligned(Dest, Head);
+        V::StoreUnaligned(End - V::kBytes, Tail);
 
-    Dest += InitialQuadwordCount;
-    Source += InitialQuadwordCount;
-    NumQuadwords -= InitialQuadwordCount;
+        if (Streaming)
+            _mm_sfence();
 
-    size_t CacheLines = NumQuadwords >> 2;
+        V::Finish();
+    }
 
-    switch (CacheLines)
+    // Pattern holds the 16-byte fill value repeated five times, so that a vector of any width can be loaded from it
+    // starting at any byte of the value.
+    template <typename V, bool Streaming>
+    void FillBytes( uint8_t* __restrict Dest, const uint8_t* Pattern, size_t NumBytes )
     {
-    default:
-    case 10: _mm_prefetch((char*)(Source + 36), _MM_HINT_NTA);	// Fall through
-    case 9:  _mm_prefetch((char*)(Source + 32), _MM_HINT_NTA);	// Fall through
-    case 8:  _mm_prefetch((char*)(Source + 28), _MM_HINT_NTA);	// Fall through
-    case 7:  _mm_prefetch((char*)(Source + 24), _MM_HINT_NTA);	// Fall through
-    case 6:  _mm_prefetch((char*)(Source + 20), _MM_HINT_NTA);	// Fall through
-    case 5:  _mm_prefetch((char*)(Source + 16), _MM_HINT_NTA);	// Fall through
-    case 4:  _mm_prefetch((char*)(Source + 12), _MM_HINT_NTA);	// Fall through
-    case 3:  _mm_prefetch((char*)(Source + 8 ), _MM_HINT_NTA);	// Fall through
-    case 2:  _mm_prefetch((char*)(Source + 4 ), _MM_HINT_NTA);	// Fall through
-    case 1:  _mm_prefetch((char*)(Source + 0 ), _MM_HINT_NTA);	// Fall through
-
-        // Do four quadwords per loop to minimize stalls.
-        for (size_t i = CacheLines; i > 0; --i)
+        if (NumBytes < V::kBytes)
         {
-            // If this is a large copy, start prefetching future cache lines.  This also prefetches the
-            // trailing quadwords that are not part of a whole cache line.
-            if (i >= 10)
-                _mm_prefetch((char*)(Source + 40), _MM_HINT_NTA);
-
-            _mm_stream_si128(Dest + 0, _mm_load_si128(Source + 0));
-            _mm_stream_si128(Dest + 1, _mm_load_si128(Source + 1));
-            _mm_stream_si128(Dest + 2, _mm_load_si128(Source + 2));
-            _mm_stream_si128(Dest + 3, _mm_load_si128(Source + 3));
-
-            Dest += 4;
-            Source += 4;
+            memcpy(Dest, Pattern, NumBytes);
+            return;
         }
 
-    case 0:	// No whole cache lines to read
-        break;
+        uint8_t* const End = Dest + NumBytes;
+        uint8_t* const AlignedEnd = (uint8_t*)((size_t)End & ~(V::kBytes - 1));
+        const size_t HeadBytes = V::kBytes - ((size_t)Dest & (V::kBytes - 1));
+        uint8_t* Next = Dest + HeadBytes;
+
+        // The aligned run starts HeadBytes into the fill value
+        const typename V::Type Value = V::Load(Pattern + (HeadBytes & 15));
+
+        while ((size_t)(AlignedEnd - Next) >= 4 * V::kBytes)
+        {
+            PutVector<V, Streaming>(Next + 0 * V::kBytes, Value);
+            PutVector<V, Streaming>(Next + 1 * V::kBytes, Value);
+            PutVector<V, Streaming>(Next + 2 * V::kBytes, Value);
+            PutVector<V, Streaming>(Next + 3 * V::kBytes, Value);
+            Next += 4 * V::kBytes;
+        }
+
+        while (Next < AlignedEnd)
+        {
+            PutVector<V, Streaming>(Next, Value);
+            Next += V::kBytes;
+        }
+
+        V::StoreUnaligned(Dest, V::Load(Pattern));
+        V::StoreUnaligned(End - V::kBytes, V::Load(Pattern + ((NumBytes - V::kBytes) & 15)));
+
+        if (Streaming)
+            _mm_sfence();
+
+        V::Finish();
     }
 
-    // Copy the remaining quadwords
-    switch (NumQuadwords & 3)
+    typedef void (*CopyFunction)( uint8_t* __restrict Dest, const uint8_t* __restrict Source, size_t NumBytes );
+    typedef void (*FillFunction)( uint8_t* __restrict Dest, const uint8_t* Pattern, size_t NumBytes );
+
+    struct SIMDMemFunctions
+    {
+        SIMDMemLevel Level;
+        CopyFunction CachedCopy;
+        CopyFunction StreamingCopy;
+        FillFunction CachedFill;
+        FillFunction StreamingFill;
+        size_t StreamingThreshold;
+    };
+
+    template <typename V>
+    SIMDMemFunctions MakeSIMDMemFunctions( SIMDMemLevel Level, size_t StreamingThreshold )
     {
-    case 3: _mm_stream_si128(Dest + 2, _mm_load_si128(Source + 2));	 // Fall through
-    case 2: _mm_stream_si128(Dest + 1, _mm_load_si128(Source + 1));	 // Fall through
-    case 1: _mm_stream_si128(Dest + 0, _mm_load_si128(Source + 0));	 // Fall through
-    default:
-        break;
+        SIMDMemFunctions Functions = { Level, CopyBytes<V, false>, CopyBytes<V, true>,
+            FillBytes<V, false>, FillBytes<V, true>, StreamingThreshold };
+        return Functions;
     }
 
-    _mm_sfence();
+    // SSE2 is part of x64, so these are usable before static initialization has picked the real ones.
+    SIMDMemFunctions s_SIMDMem = { kSIMDMemSSE2, CopyBytes<SSE2Vector, false>, CopyBytes<SSE2Vector, true>,
+        FillBytes<SSE2Vector, false>, FillBytes<SSE2Vector, true>, kSIMDMemStreamingThreshold };
+
+    struct SIMDMemAutoSelect
+    {
+        SIMDMemAutoSelect() { ConfigureSIMDMem(GetSupportedSIMDMemLevel(), kSIMDMemStreamingThreshold); }
+    } s_SIMDMemAutoSelect;
 }
 
-void SIMDMemFill( void* __restrict _Dest, __m128 FillVector, size_t NumQuadwords )
+SIMDMemLevel GetSupportedSIMDMemLevel( void )
 {
-    ASSERT(Math::IsAligned(_Dest, 16));
+    int Info[4];
+    __cpuid(Info, 0);
+    const int MaxLeaf = Info[0];
 
-    register const __m128i Source = _mm_castps_si128(FillVector);
-    __m128i* __restrict Dest = (__m128i* __restrict)_Dest;
+    // The OS must also save the wider registers on a context switch, which XGETBV reports.
+    __cpuid(Info, 1);
+    const bool OSXSave = (Info[2] & (1 << 27)) != 0;
+    const bool HasAVX = (Info[2] & (1 << 28)) != 0;
+    if (!OSXSave || !HasAVX || MaxLeaf < 7)
+        return kSIMDMemSSE2;
 
-    switch (((size_t)Dest >> 4) & 3)
-    {
-    case 1: _mm_stream_si128(Dest++, Source); --NumQuadwords;	 // Fall through
-    case 2: _mm_stream_si128(Dest++, Source); --NumQuadwords;	 // Fall through
-    case 3: _mm_stream_si128(Dest++, Source); --NumQuadwords;	 // Fall through
-    default:
-        break;
-    }
+    const unsigned long long EnabledState = _xgetbv(0);
+    if ((EnabledState & 0x6) != 0x6)        // XMM and YMM state
+        return kSIMDMemSSE2;
 
-    size_t WholeCacheLines = NumQuadwords >> 2;
+    __cpuidex(Info, 7, 0);
+    const bool HasAVX2 = (Info[1] & (1 << 5)) != 0;
+    const bool HasAVX512F = (Info[1] & (1 << 16)) != 0;
 
-    // Do four quadwords per loop to minimize stalls.
-    while (WholeCacheLines--)
-    {
-        _mm_stream_si128(Dest++, Source);
-        _mm_stream_si128(Dest++, Source);
-        _mm_stream_si128(Dest++, Source);
-        _mm_stream_si128(Dest++, Source);
-    }
+#ifdef SIMD_MEM_AVX512
+    if (HasAVX512F && (EnabledState & 0xE6) == 0xE6)        // Plus opmask and ZMM state
+        return kSIMDMemAVX512;
+#else
+    (void)HasAVX512F;
+#endif
+
+    return HasAVX2 ? kSIMDMemAVX2 : kSIMDMemSSE2;
+}
 
-    // Copy the remaining quadwords
-    switch (NumQuadwords & 3)
+SIMDMemLevel ConfigureSIMDMem( SIMDMemLevel Level, size_t StreamingThreshold )
+{
+    const SIMDMemLevel Supported = GetSupportedSIMDMemLevel();
+    if (Level > Supported)
+        Level = Supported;
+
+    switch (Level)
     {
-    case 3: _mm_stream_si128(Dest++, Source);	 // Fall through
-    case 2: _mm_stream_si128(Dest++, Source);	 // Fall through
-    case 1: _mm_stream_si128(Dest++, Source);	 // Fall through
-    default:
-        break;
+#ifdef SIMD_MEM_AVX512
+    case kSIMDMemAVX512: s_SIMDMem = MakeSIMDMemFunctions<AVX512Vector>(kSIMDMemAVX512, StreamingThreshold); break;
+#endif
+    case kSIMDMemAVX2: s_SIMDMem = MakeSIMDMemFunctions<AVX2Vector>(kSIMDMemAVX2, StreamingThreshold); break;
+    default: s_SIMDMem = MakeSIMDMemFunctions<SSE2Vector>(kSIMDMemSSE2, StreamingThreshold); break;
     }
 
-    _mm_sfence();
+    return s_SIMDMem.Level;
+}
+
+SIMDMemLevel GetSIMDMemLevel( void )
+{
+    return s_SIMDMem.Level;
+}
+
+void SIMDMemCopyBytes( void* __restrict Dest, const void* __restrict Source, size_t NumBytes )
+{
+    if (NumBytes < s_SIMDMem.StreamingThreshold)
+        s_SIMDMem.CachedCopy((uint8_t*)Dest, (const uint8_t*)Source, NumBytes);
+    else
+        s_SIMDMem.StreamingCopy((uint8_t*)Dest, (const uint8_t*)Source, NumBytes);
+}
+
+void SIMDMemCopy( void* __restrict Dest, const void* __restrict Source, size_t NumQuadwords )
+{
+    SIMDMemCopyBytes(Dest, Source, NumQuadwords * 16);
+}
+
+void SIMDMemFillBytes( void* __restrict Dest, __m128 FillVector, size_t NumBytes )
+{
+    uint8_t Pattern[80];
+    for (size_t i = 0; i < 80; i += 16)
+        _mm_storeu_ps((float*)(Pattern + i), FillVector);
+
+    if (NumBytes < s_SIMDMem.StreamingThreshold)
+        s_SIMDMem.CachedFill((uint8_t*)Dest, Pattern, NumBytes);
+    else
+        s_SIMDMem.StreamingFill((uint8_t*)Dest, Pattern, NumBytes);
+}
+
+void SIMDMemFill( void* __restrict Dest, __m128 FillVector, size_t NumQuadwords )
+{
+    SIMDMemFillBytes(Dest, FillVector, NumQuadwords * 16);
 }
 
 std::wstring MakeWStr( const std::string& str )
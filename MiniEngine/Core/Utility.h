@@ -136,7 +136,28 @@ namespace Utility
 
 #define BreakIfFailed( hr ) if (FAILED(hr)) __debugbreak()
 
+// Copy and fill with the widest vectors the CPU supports.  Neither pointer needs to be aligned.  Sizes below the
+// streaming threshold are written with regular stores and stay in the cache; larger ones use streaming stores.
 void SIMDMemCopy( void* __restrict Dest, const void* __restrict Source, size_t NumQuadwords );
+void SIMDMemCopyBytes( void* __restrict Dest, const void* __restrict Source, size_t NumBytes );
 void SIMDMemFill( void* __restrict Dest, __m128 FillVector, size_t NumQuadwords );
+void SIMDMemFillBytes( void* __restrict Dest, __m128 FillVector, size_t NumBytes );
+
+enum SIMDMemLevel { kSIMDMemSSE2, kSIMDMemAVX2, kSIMDMemAVX512 };
+
+// The default streaming threshold, in bytes.  Streaming stores only caught up with regular ones once the copy
+// outgrew the L2 cache.
+const size_t kSIMDMemStreamingThreshold = 2 * 1024 * 1024;
+
+// Below this many bytes the CRT memcpy is faster, as the indirect call to the chosen variant dominates
+const size_t kSIMDMemCopyMinBytes = 512;
+
+// The widest vectors that both the CPU and the OS support
+SIMDMemLevel GetSupportedSIMDMemLevel( void );
+SIMDMemLevel GetSIMDMemLevel( void );
+
+// Overrides the choice made at startup, for tests and benchmarks.  Level is clamped to what is supported, and the
+// level in use is returned.  Not safe while another thread is copying.
+SIMDMemLevel ConfigureSIMDMem( SIMDMemLevel Level, size_t StreamingThreshold );
 
 std::wstring MakeWStr( const std::string& str );
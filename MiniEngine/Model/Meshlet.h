@@ -0,0 +1,63 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// A meshlet is a cluster of up to 256 vertices and 256 triangles from one mesh, small enough to cull on its own.
+// Each carries a bounding sphere and a normal cone in the mesh's model space.  The layout is what H3D files
+// store, and it depends on nothing but <cstdint> so the converter and tools can share it with Model.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+struct Meshlet
+{
+    uint32_t vertexOffset;      // first entry in the model's meshlet vertex list
+    uint32_t vertexCount;
+    uint32_t primitiveOffset;   // first entry in the model's meshlet primitive list
+    uint32_t primitiveCount;
+
+    float center[3];            // bounding sphere
+    float radius;
+
+    // Every triangle faces away from the apex, and every normal is within the cone's half angle of the axis.
+    // The cutoff is the sine of that angle; 1 means the triangles face too many ways for the cone to cull.
+    float coneApex[3];
+    float coneCutoff;
+    float coneAxis[3];
+    uint32_t reserved;
+};
+
+// Entries of the meshlet vertex list are mesh-relative vertex indices, the same as the index buffer's.  Each
+// primitive packs the meshlet-relative indices of one triangle's corners into bits 0-9, 10-19 and 20-29.
+inline uint32_t PackMeshletTriangle( uint32_t i0, uint32_t i1, uint32_t i2 )
+{
+    return i0 | i1 << 10 | i2 << 20;
+}
+
+inline uint32_t UnpackMeshletIndex( uint32_t Primitive, uint32_t Corner )
+{
+    return (Primitive >> (Corner * 10)) & 0x3FF;
+}
+
+// True when no triangle of the meshlet can face an eye at this model-space position, so back-face culling would
+// reject all of them.  Only valid for meshes drawn with counter-clockwise front faces and back-face culling.
+inline bool IsMeshletBackFacing( const Meshlet& m, float EyeX, float EyeY, float EyeZ )
+{
+    if (m.coneCutoff >= 1.0f)
+        return false;
+
+    const float dx = m.coneApex[0] - EyeX, dy = m.coneApex[1] - EyeY, dz = m.coneApex[2] - EyeZ;
+    const float d = dx * m.coneAxis[0] + dy * m.coneAxis[1] + dz * m.coneAxis[2];
+    return d >= m.coneCutoff * std::sqrt(dx * dx + dy * dy + dz * dz);
+}
@@ -18,6 +18,13 @@
 Model::Model()
     : m_pMesh(nullptr)
     , m_pMaterial(nullptr)
+    , m_pMeshletRange(nullptr)
+    , m_pMeshlet(nullptr)
+    , m_pMeshletPrimitives(nullptr)
+    , m_pMeshletVertices(nullptr)
+    , m_pLODRange(nullptr)
+    , m_pLOD(nullptr)
+    , m_pLODIndexData(nullptr)
     , m_pVertexData(nullptr)
     , m_pIndexData(nullptr)
     , m_pVertexDataDepth(nullptr)
@@ -60,12 +67,63 @@ void Model::Clear()
     m_Header.vertexDataByteSizeDepth = 0;
     m_pIndexDataDepth = nullptr;
 
+    ClearMeshlets();
+    ClearLODs();
+
     ReleaseTextures();
 
     m_Header.boundingBox.min = Vector3(0.0f);
     m_Header.boundingBox.max = Vector3(0.0f);
 }
 
+void Model::ClearMeshlets()
+{
+    delete [] m_pMeshletRange;
+    delete [] m_pMeshlet;
+    delete [] m_pMeshletPrimitives;
+    delete [] m_pMeshletVertices;
+
+    m_pMeshletRange = nullptr;
+    m_pMeshlet = nullptr;
+    m_pMeshletPrimitives = nullptr;
+    m_pMeshletVertices = nullptr;
+    memset(&m_MeshletHeader, 0, sizeof(m_MeshletHeader));
+}
+
+void Model::ClearLODs()
+{
+    delete [] m_pLODRange;
+    delete [] m_pLOD;
+    delete [] m_pLODIndexData;
+
+    m_pLODRange = nullptr;
+    m_pLOD = nullptr;
+    m_pLODIndexData = nullptr;
+    memset(&m_LODHeader, 0, sizeof(m_LODHeader));
+}
+
+void Model::GetMeshLOD( uint32_t meshIndex, float screenSize, uint32_t& indexCount, uint32_t& startIndex ) const
+{
+    const Mesh& mesh = m_pMesh[meshIndex];
+    indexCount = mesh.indexCount;
+    startIndex = mesh.indexDataByteOffset / sizeof(uint16_t);
+
+    if (m_pLODRange == nullptr)
+        return;
+
+    // Thresholds shrink down the chain, so the last one the mesh is small enough for is the coarsest it allows
+    const LODRange& range = m_pLODRange[meshIndex];
+    for (uint32_t lodIndex = 0; lodIndex < range.lodCount; ++lodIndex)
+    {
+        const MeshLOD& lod = m_pLOD[range.lodOffset + lodIndex];
+        if (screenSize > lod.screenSize)
+            break;
+
+        indexCount = lod.indexCount;
+        startIndex = (m_Header.indexDataByteSize + lod.indexDataByteOffset) / sizeof(uint16_t);
+    }
+}
+
 // assuming at least 3 floats for position
 void Model::ComputeMeshBoundingBox(unsigned int meshIndex, BoundingBox &bbox) const
 {
@@ -17,6 +17,7 @@
 #include "VectorMath.h"
 #include "TextureManager.h"
 #include "GpuBuffer.h"
+#include "Meshlet.h"
 
 using namespace Math;
 
@@ -169,6 +170,75 @@ public:
     };
     Material *m_pMaterial;
 
+    // Optional sections follow the depth-only index data, each behind a SectionHeader.  The loader skips ids it
+    // doesn't know, and loaders that predate sections stop reading before them, so files work either way.
+    struct SectionHeader
+    {
+        uint32_t id;
+        uint32_t byteSize; // of the data after this header
+    };
+
+    enum
+    {
+        section_meshlets = 0x4C48534D, // 'MSHL'
+        section_lods = 0x53444F4C, // 'LODS'
+    };
+
+    // The meshlet section holds this header, a MeshletRange per mesh, the meshlets, their primitives and then
+    // their vertices (padded to four bytes).  Meshlets cover the main vertex stream, not the depth-only one.
+    struct MeshletHeader
+    {
+        uint32_t meshletCount;
+        uint32_t vertexCount;
+        uint32_t primitiveCount;
+        uint32_t maxVertices; // the limits they were built with
+        uint32_t maxPrimitives;
+    };
+    MeshletHeader m_MeshletHeader;
+
+    struct MeshletRange
+    {
+        uint32_t meshletOffset;
+        uint32_t meshletCount;
+    };
+
+    // Kept on the CPU for culling; all null when the file has no meshlets
+    MeshletRange *m_pMeshletRange;
+    Meshlet *m_pMeshlet;
+    uint32_t *m_pMeshletPrimitives;
+    uint16_t *m_pMeshletVertices;
+
+    // The LOD section holds this header, a LODRange per mesh, the LODs and then their index data (padded to four
+    // bytes).  Each mesh is its own first LOD and only the reduced ones are stored, coarsest last.  LOD indices
+    // address the mesh's vertices just as its own indices do, and are loaded into m_IndexBuffer after them.
+    struct LODHeader
+    {
+        uint32_t lodCount;
+        uint32_t indexDataByteSize;
+        float pixelError; // how far, in pixels, a LOD may stray from the full mesh on screen
+        uint32_t reserved;
+    };
+    LODHeader m_LODHeader;
+
+    struct LODRange
+    {
+        uint32_t lodOffset;
+        uint32_t lodCount;
+    };
+
+    struct MeshLOD
+    {
+        uint32_t indexDataByteOffset; // into the LOD index data
+        uint32_t indexCount;
+        float error; // Hausdorff distance from the full mesh
+        float screenSize; // used once the mesh's bounding sphere is no more than this many pixels across
+    };
+
+    // All null when the file has no LODs; the index data is freed once it is uploaded
+    LODRange *m_pLODRange;
+    MeshLOD *m_pLOD;
+    unsigned char *m_pLODIndexData;
+
     unsigned char *m_pVertexData;
     unsigned char *m_pIndexData;
     StructuredBuffer m_VertexBuffer;
@@ -197,10 +267,17 @@ public:
         return m_SRVs + materialIdx * 6;
     }
 
+    // Finds the indices to draw for a mesh whose bounding sphere covers screenSize pixels across
+    void GetMeshLOD( uint32_t meshIndex, float screenSize, uint32_t& indexCount, uint32_t& startIndex ) const;
+
 protected:
 
 	bool LoadH3D(const char *filename);
 	bool SaveH3D(const char *filename) const;
+	bool LoadH3DSections(FILE *file);
+	bool SaveH3DSections(FILE *file) const;
+	void ClearMeshlets();
+	void ClearLODs();
 
 	void ComputeMeshBoundingBox(unsigned int meshIndex, BoundingBox &bbox) const;
 	void ComputeGlobalBoundingBox(BoundingBox &bbox) const;
@@ -18,6 +18,7 @@
 #include "DescriptorHeap.h"
 #include "CommandContext.h"
 #include <stdio.h>
+#include <string.h>
 
 bool Model::LoadH3D(const char *filename)
 {
@@ -79,8 +80,23 @@ bool Model::LoadH3D(const char *filename)
     if (m_Header.indexDataByteSize > 0)
         if (1 != fread(m_pIndexDataDepth, m_Header.indexDataByteSize, 1, file)) goto h3d_load_fail;
 
+    if (!LoadH3DSections(file)) goto h3d_load_fail;
+
     m_VertexBuffer.Create(L"VertexBuffer", m_Header.vertexDataByteSize / m_VertexStride, m_VertexStride, m_pVertexData);
-    m_IndexBuffer.Create(L"IndexBuffer", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), m_pIndexData);
+    if (m_pLODIndexData == nullptr)
+        m_IndexBuffer.Create(L"IndexBuffer", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), m_pIndexData);
+    else
+    {
+        // LOD indices follow the mesh indices so that every draw uses the one index buffer
+        uint32_t indexDataByteSize = m_Header.indexDataByteSize + m_LODHeader.indexDataByteSize;
+        unsigned char *indexData = new unsigned char[ indexDataByteSize ];
+        memcpy(indexData, m_pIndexData, m_Header.indexDataByteSize);
+        memcpy(indexData + m_Header.indexDataByteSize, m_pLODIndexData, m_LODHeader.indexDataByteSize);
+        m_IndexBuffer.Create(L"IndexBuffer", indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), indexData);
+        delete [] indexData;
+        delete [] m_pLODIndexData;
+        m_pLODIndexData = nullptr;
+    }
     delete [] m_pVertexData;
     m_pVertexData = nullptr;
     delete [] m_pIndexData;
@@ -130,6 +146,8 @@ bool Model::SaveH3D(const char *filename) const
     if (m_Header.indexDataByteSize > 0)
         if (1 != fwrite(m_pIndexDataDepth, m_Header.indexDataByteSize, 1, file)) goto h3d_save_fail;
 
+    if (!SaveH3DSections(file)) goto h3d_save_fail;
+
     ok = true;
 
 h3d_save_fail:
@@ -140,6 +158,154 @@ h3d_save_fail:
     return ok;
 }
 
+static size_t MeshletSectionSize(const Model::MeshletHeader &header, uint32_t meshCount)
+{
+    size_t vertexBytes = sizeof(uint16_t) * (size_t)header.vertexCount;
+    return sizeof(Model::MeshletHeader) + sizeof(Model::MeshletRange) * (size_t)meshCount
+        + sizeof(Meshlet) * (size_t)header.meshletCount + sizeof(uint32_t) * (size_t)header.primitiveCount
+        + ((vertexBytes + 3) & ~(size_t)3);
+}
+
+static size_t LODSectionSize(const Model::LODHeader &header, uint32_t meshCount)
+{
+    return sizeof(Model::LODHeader) + sizeof(Model::LODRange) * (size_t)meshCount
+        + sizeof(Model::MeshLOD) * (size_t)header.lodCount + (((size_t)header.indexDataByteSize + 3) & ~(size_t)3);
+}
+
+bool Model::LoadH3DSections(FILE *file)
+{
+    SectionHeader section;
+    while (1 == fread(&section, sizeof(SectionHeader), 1, file))
+    {
+        long sectionStart = ftell(file);
+
+        if (section.id == section_meshlets && m_pMeshletRange == nullptr)
+        {
+            MeshletHeader header;
+            if (1 != fread(&header, sizeof(MeshletHeader), 1, file))
+                return false;
+            if (MeshletSectionSize(header, m_Header.meshCount) != section.byteSize)
+                return false;
+
+            m_MeshletHeader = header;
+            m_pMeshletRange = new MeshletRange [m_Header.meshCount];
+            m_pMeshlet = new Meshlet [header.meshletCount];
+            m_pMeshletPrimitives = new uint32_t [header.primitiveCount];
+            m_pMeshletVertices = new uint16_t [header.vertexCount];
+
+            if (m_Header.meshCount > 0)
+                if (1 != fread(m_pMeshletRange, sizeof(MeshletRange) * m_Header.meshCount, 1, file)) return false;
+            if (header.meshletCount > 0)
+                if (1 != fread(m_pMeshlet, sizeof(Meshlet) * header.meshletCount, 1, file)) return false;
+            if (header.primitiveCount > 0)
+                if (1 != fread(m_pMeshletPrimitives, sizeof(uint32_t) * header.primitiveCount, 1, file)) return false;
+            if (header.vertexCount > 0)
+                if (1 != fread(m_pMeshletVertices, sizeof(uint16_t) * header.vertexCount, 1, file)) return false;
+
+#if _DEBUG
+            for (uint32_t meshIndex = 0; meshIndex < m_Header.meshCount; ++meshIndex)
+            {
+                const MeshletRange& range = m_pMeshletRange[meshIndex];
+                ASSERT(range.meshletOffset + range.meshletCount <= header.meshletCount);
+            }
+            for (uint32_t meshletIndex = 0; meshletIndex < header.meshletCount; ++meshletIndex)
+            {
+                const Meshlet& meshlet = m_pMeshlet[meshletIndex];
+                ASSERT(meshlet.vertexOffset + meshlet.vertexCount <= header.vertexCount);
+                ASSERT(meshlet.primitiveOffset + meshlet.primitiveCount <= header.primitiveCount);
+            }
+#endif
+        }
+
+        else if (section.id == section_lods && m_pLODRange == nullptr)
+        {
+            LODHeader header;
+            if (1 != fread(&header, sizeof(LODHeader), 1, file))
+                return false;
+            if (LODSectionSize(header, m_Header.meshCount) != section.byteSize)
+                return false;
+
+            m_LODHeader = header;
+            m_pLODRange = new LODRange [m_Header.meshCount];
+            m_pLOD = new MeshLOD [header.lodCount];
+            m_pLODIndexData = new unsigned char [header.indexDataByteSize];
+
+            if (m_Header.meshCount > 0)
+                if (1 != fread(m_pLODRange, sizeof(LODRange) * m_Header.meshCount, 1, file)) return false;
+            if (header.lodCount > 0)
+                if (1 != fread(m_pLOD, sizeof(MeshLOD) * header.lodCount, 1, file)) return false;
+            if (header.indexDataByteSize > 0)
+                if (1 != fread(m_pLODIndexData, header.indexDataByteSize, 1, file)) return false;
+
+#if _DEBUG
+            for (uint32_t meshIndex = 0; meshIndex < m_Header.meshCount; ++meshIndex)
+            {
+                const LODRange& range = m_pLODRange[meshIndex];
+                ASSERT(range.lodOffset + range.lodCount <= header.lodCount);
+            }
+            for (uint32_t lodIndex = 0; lodIndex < header.lodCount; ++lodIndex)
+            {
+                const MeshLOD& lod = m_pLOD[lodIndex];
+                ASSERT(lod.indexDataByteOffset + lod.indexCount * sizeof(uint16_t) <= header.indexDataByteSize);
+            }
+#endif
+        }
+
+        // Skip what wasn't read, including sections this build doesn't know
+        if (0 != fseek(file, sectionStart + (long)section.byteSize, SEEK_SET))
+            return false;
+    }
+
+    return feof(file) != 0;
+}
+
+bool Model::SaveH3DSections(FILE *file) const
+{
+    if (m_pMeshletRange != nullptr)
+    {
+        const MeshletHeader &header = m_MeshletHeader;
+        SectionHeader section = { section_meshlets, (uint32_t)MeshletSectionSize(header, m_Header.meshCount) };
+        const uint32_t padding = 0;
+        size_t paddingBytes = (4 - (sizeof(uint16_t) * header.vertexCount) % 4) % 4;
+
+        if (1 != fwrite(&section, sizeof(SectionHeader), 1, file)) return false;
+        if (1 != fwrite(&header, sizeof(MeshletHeader), 1, file)) return false;
+
+        if (m_Header.meshCount > 0)
+            if (1 != fwrite(m_pMeshletRange, sizeof(MeshletRange) * m_Header.meshCount, 1, file)) return false;
+        if (header.meshletCount > 0)
+            if (1 != fwrite(m_pMeshlet, sizeof(Meshlet) * header.meshletCount, 1, file)) return false;
+        if (header.primitiveCount > 0)
+            if (1 != fwrite(m_pMeshletPrimitives, sizeof(uint32_t) * header.primitiveCount, 1, file)) return false;
+        if (header.vertexCount > 0)
+            if (1 != fwrite(m_pMeshletVertices, sizeof(uint16_t) * header.vertexCount, 1, file)) return false;
+        if (paddingBytes > 0)
+            if (1 != fwrite(&padding, paddingBytes, 1, file)) return false;
+    }
+
+    if (m_pLODRange != nullptr)
+    {
+        const LODHeader &header = m_LODHeader;
+        SectionHeader section = { section_lods, (uint32_t)LODSectionSize(header, m_Header.meshCount) };
+        const uint32_t padding = 0;
+        size_t paddingBytes = (4 - header.indexDataByteSize % 4) % 4;
+
+        if (1 != fwrite(&section, sizeof(SectionHeader), 1, file)) return false;
+        if (1 != fwrite(&header, sizeof(LODHeader), 1, file)) return false;
+
+        if (m_Header.meshCount > 0)
+            if (1 != fwrite(m_pLODRange, sizeof(LODRange) * m_Header.meshCount, 1, file)) return false;
+        if (header.lodCount > 0)
+            if (1 != fwrite(m_pLOD, sizeof(MeshLOD) * header.lodCount, 1, file)) return false;
+        if (header.indexDataByteSize > 0)
+            if (1 != fwrite(m_pLODIndexData, header.indexDataByteSize, 1, file)) return false;
+        if (paddingBytes > 0)
+            if (1 != fwrite(&padding, paddingBytes, 1, file)) return false;
+    }
+
+    return true;
+}
+
 void Model::ReleaseTextures()
 {
     /*
@@ -0,0 +1,767 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "MeshSimplify.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    struct Float3
+    {
+        float x, y, z;
+    };
+
+    inline Float3 Add(const Float3& a, const Float3& b) { return Float3{ a.x + b.x, a.y + b.y, a.z + b.z }; }
+    inline Float3 Sub(const Float3& a, const Float3& b) { return Float3{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+    inline Float3 Scale(const Float3& a, float s) { return Float3{ a.x * s, a.y * s, a.z * s }; }
+    inline float Dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline float Length(const Float3& a) { return sqrtf(Dot(a, a)); }
+
+    inline Float3 Cross(const Float3& a, const Float3& b)
+    {
+        return Float3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    inline Float3 Normalize(const Float3& a)
+    {
+        float length = Length(a);
+        return length > 0.0f ? Scale(a, 1.0f / length) : Float3{ 0.0f, 0.0f, 0.0f };
+    }
+
+    inline Float3 GetPosition(const SimplifySource& mesh, uint32_t vertex)
+    {
+        const float* p = (const float*)((const uint8_t*)mesh.positions + (size_t)vertex * mesh.vertexStride);
+        return Float3{ p[0], p[1], p[2] };
+    }
+
+    // The sum of squared distances to a set of weighted planes, x'Ax + 2b'x + c, and the total weight, so that
+    // dividing by it gives an average squared distance
+    struct Quadric
+    {
+        double a00, a11, a22, a10, a20, a21;
+        double b0, b1, b2;
+        double c;
+        double w;
+    };
+
+    void AddPlane(Quadric& q, const Float3& n, float d, double weight)
+    {
+        q.a00 += weight * n.x * n.x;
+        q.a11 += weight * n.y * n.y;
+        q.a22 += weight * n.z * n.z;
+        q.a10 += weight * n.y * n.x;
+        q.a20 += weight * n.z * n.x;
+        q.a21 += weight * n.z * n.y;
+        q.b0 += weight * n.x * d;
+        q.b1 += weight * n.y * d;
+        q.b2 += weight * n.z * d;
+        q.c += weight * d * d;
+        q.w += weight;
+    }
+
+    void AddQuadric(Quadric& q, const Quadric& r)
+    {
+        q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+        q.a10 += r.a10; q.a20 += r.a20; q.a21 += r.a21;
+        q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+        q.c += r.c;
+        q.w += r.w;
+    }
+
+    float EvaluateQuadric(const Quadric& q, const Float3& p)
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double r = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+            + 2.0 * (q.a10 * x * y + q.a20 * x * z + q.a21 * y * z)
+            + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+        return q.w > 0.0 ? (float)(fabs(r) / q.w) : 0.0f;
+    }
+
+    enum VertexKind
+    {
+        kManifold,      // moves onto any neighbor
+        kBorder,        // on one open border; moves along it
+        kSeam,          // two wedges on one seam; moves along it
+        kLocked,        // stays put
+    };
+
+    // How much an open border or seam edge weighs against triangle area, per squared edge length
+    const float kBoundaryWeight = 10.0f;
+
+    // A triangle whose normal would turn further than this (about 75 degrees) blocks the collapse
+    const float kMinNormalCosine = 0.25f;
+
+    struct HalfEdge
+    {
+        uint64_t key;   // from position << 32 | to position
+        uint32_t from;  // the vertices, which differ from the opposite half-edge's on a seam
+        uint32_t to;
+        uint32_t other; // the triangle's third vertex
+    };
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        float error;
+    };
+
+    inline uint64_t EdgeKey(uint32_t from, uint32_t to)
+    {
+        return (uint64_t)from << 32 | to;
+    }
+
+    // Finds vertices with identical positions.  Each position is named by its first vertex, and its wedges are
+    // linked in a ring.
+    void FindWedges(const SimplifySource& mesh, std::vector<uint32_t>& positionOf, std::vector<uint32_t>& wedgeNext)
+    {
+        const uint32_t vertexCount = mesh.vertexCount;
+        positionOf.resize(vertexCount);
+        wedgeNext.resize(vertexCount);
+
+        uint32_t tableSize = 1;
+        while (tableSize < vertexCount * 2)
+            tableSize *= 2;
+        std::vector<uint32_t> table(tableSize, UINT32_MAX);
+
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            // Adding zero turns -0 into +0 so that equal positions hash alike
+            Float3 p = GetPosition(mesh, v);
+            float key[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+            uint32_t bits[3];
+            memcpy(bits, key, sizeof(bits));
+            uint32_t hash = (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+
+            for (uint32_t slot = hash & (tableSize - 1);; slot = (slot + 1) & (tableSize - 1))
+            {
+                uint32_t first = table[slot];
+                if (first == UINT32_MAX)
+                {
+                    table[slot] = v;
+                    positionOf[v] = v;
+                    wedgeNext[v] = v;
+                    break;
+                }
+
+                Float3 q = GetPosition(mesh, first);
+                if (q.x == p.x && q.y == p.y && q.z == p.z)
+                {
+                    positionOf[v] = first;
+                    wedgeNext[v] = wedgeNext[first];
+                    wedgeNext[first] = v;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Triangle point distance, after Ericson's Real-Time Collision Detection, 5.1.5
+    float SquaredDistanceToTriangle(const Float3& p, const Float3& a, const Float3& b, const Float3& c)
+    {
+        Float3 ab = Sub(b, a), ac = Sub(c, a), ap = Sub(p, a);
+        float d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+        Float3 closest;
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            closest = a;
+        else
+        {
+            Float3 bp = Sub(p, b);
+            float d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+            Float3 cp = Sub(p, c);
+            float d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+            float vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+
+            if (d3 >= 0.0f && d4 <= d3)
+                closest = b;
+            else if (d6 >= 0.0f && d5 <= d6)
+                closest = c;
+            else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+                closest = Add(a, Scale(ab, d1 / (d1 - d3)));
+            else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+                closest = Add(a, Scale(ac, d2 / (d2 - d6)));
+            else if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+                closest = Add(b, Scale(Sub(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+            else
+            {
+                float sum = va + vb + vc;
+                if (sum == 0.0f)
+                {
+                    // Degenerate triangles lie on their longest edge, which the cases above have measured
+                    Float3 d = Sub(p, a);
+                    return std::min(Dot(d, d), std::min(Dot(bp, bp), Dot(cp, cp)));
+                }
+                closest = Add(a, Add(Scale(ab, vb / sum), Scale(ac, vc / sum)));
+            }
+        }
+        Float3 d = Sub(p, closest);
+        return Dot(d, d);
+    }
+
+    // A uniform grid of triangles for nearest point queries
+    class TriangleGrid
+    {
+    public:
+        TriangleGrid(const SimplifySource& mesh, const uint16_t* indices, uint32_t indexCount)
+            : m_Mesh(mesh), m_Indices(indices), m_TriangleCount(indexCount / 3), m_Stamp(indexCount / 3, 0), m_Query(0)
+        {
+            Float3 boxMin = { FLT_MAX, FLT_MAX, FLT_MAX }, boxMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+            for (uint32_t n = 0; n < m_TriangleCount * 3; n++)
+            {
+                Float3 p = GetPosition(mesh, indices[n]);
+                boxMin = Float3{ std::min(boxMin.x, p.x), std::min(boxMin.y, p.y), std::min(boxMin.z, p.z) };
+                boxMax = Float3{ std::max(boxMax.x, p.x), std::max(boxMax.y, p.y), std::max(boxMax.z, p.z) };
+            }
+            if (m_TriangleCount == 0)
+                boxMin = boxMax = Float3{ 0.0f, 0.0f, 0.0f };
+
+            // About one triangle per cell across the longest side
+            Float3 extent = Sub(boxMax, boxMin);
+            float longest = std::max(extent.x, std::max(extent.y, extent.z));
+            uint32_t resolution = std::min(64u, std::max(1u, (uint32_t)ceilf(cbrtf((float)m_TriangleCount) * 2.0f)));
+            m_CellSize = longest > 0.0f ? longest / resolution : 1.0f;
+            m_Origin = boxMin;
+            const float* e = &extent.x;
+            for (int axis = 0; axis < 3; axis++)
+                m_Dim[axis] = std::min(64, std::max(1, (int)ceilf(e[axis] / m_CellSize)));
+
+            m_CellStart.assign((size_t)m_Dim[0] * m_Dim[1] * m_Dim[2] + 1, 0);
+            for (int pass = 0; pass < 2; pass++)
+            {
+                if (pass == 1)
+                {
+                    for (size_t cell = 1; cell < m_CellStart.size(); cell++)
+                        m_CellStart[cell] += m_CellStart[cell - 1];
+                    m_CellTriangles.resize(m_CellStart.back());
+                }
+                std::vector<uint32_t> cursor(m_CellStart.begin(), m_CellStart.end() - 1);
+
+                for (uint32_t t = 0; t < m_TriangleCount; t++)
+                {
+                    int lo[3], hi[3];
+                    TriangleCells(t, lo, hi);
+                    for (int z = lo[2]; z <= hi[2]; z++)
+                        for (int y = lo[1]; y <= hi[1]; y++)
+                            for (int x = lo[0]; x <= hi[0]; x++)
+                            {
+                                size_t cell = CellIndex(x, y, z);
+                                if (pass == 0)
+                                    m_CellStart[cell + 1]++;
+                                else
+                                    m_CellTriangles[cursor[cell]++] = t;
+                            }
+                }
+            }
+        }
+
+        // Squared distance from the point to the nearest triangle
+        float SquaredDistance(const Float3& p)
+        {
+            if (m_TriangleCount == 0)
+                return FLT_MAX;
+
+            m_Query++;
+            int home[3];
+            const float* pc = &p.x;
+            const float* oc = &m_Origin.x;
+            for (int axis = 0; axis < 3; axis++)
+                home[axis] = ClampCell((int)floorf((pc[axis] - oc[axis]) / m_CellSize), axis);
+
+            const int maxRing = std::max(m_Dim[0], std::max(m_Dim[1], m_Dim[2]));
+            float best = FLT_MAX;
+            for (int ring = 0; ring <= maxRing; ring++)
+            {
+                // Cells on this ring are at least ring - 1 cells away
+                float reach = (ring - 1) * m_CellSize;
+                if (ring > 1 && best <= reach * reach)
+                    break;
+
+                for (int dz = -ring; dz <= ring; dz++)
+                {
+                    int z = home[2] + dz;
+                    if (z < 0 || z >= m_Dim[2])
+                        continue;
+                    for (int dy = -ring; dy <= ring; dy++)
+                    {
+                        int y = home[1] + dy;
+                        if (y < 0 || y >= m_Dim[1])
+                            continue;
+                        bool face = dz == -ring || dz == ring || dy == -ring || dy == ring;
+                        for (int dx = -ring; dx <= ring; dx += face ? 1 : std::max(1, 2 * ring))
+                        {
+                            int x = home[0] + dx;
+                            if (x >= 0 && x < m_Dim[0])
+                                best = std::min(best, SearchCell(CellIndex(x, y, z), p));
+                        }
+                    }
+                }
+            }
+            return best;
+        }
+
+    private:
+        int ClampCell(int cell, int axis) const
+        {
+            return std::min(m_Dim[axis] - 1, std::max(0, cell));
+        }
+
+        size_t CellIndex(int x, int y, int z) const
+        {
+            return ((size_t)z * m_Dim[1] + y) * m_Dim[0] + x;
+        }
+
+        void TriangleCells(uint32_t t, int lo[3], int hi[3]) const
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                lo[axis] = INT32_MAX;
+                hi[axis] = INT32_MIN;
+            }
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                Float3 p = GetPosition(m_Mesh, m_Indices[t * 3 + corner]);
+                const float* pc = &p.x;
+                const float* oc = &m_Origin.x;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    int cell = ClampCell((int)floorf((pc[axis] - oc[axis]) / m_CellSize), axis);
+                    lo[axis] = std::min(lo[axis], cell);
+                    hi[axis] = std::max(hi[axis], cell);
+                }
+            }
+        }
+
+        float SearchCell(size_t cell, const Float3& p)
+        {
+            float best = FLT_MAX;
+            for (uint32_t n = m_CellStart[cell]; n < m_CellStart[cell + 1]; n++)
+            {
+                uint32_t t = m_CellTriangles[n];
+                if (m_Stamp[t] == m_Query)
+                    continue;
+                m_Stamp[t] = m_Query;
+
+                const uint16_t* corners = m_Indices + t * 3;
+                best = std::min(best, SquaredDistanceToTriangle(p, GetPosition(m_Mesh, corners[0]),
+                    GetPosition(m_Mesh, corners[1]), GetPosition(m_Mesh, corners[2])));
+            }
+            return best;
+        }
+
+        const SimplifySource& m_Mesh;
+        const uint16_t* m_Indices;
+        uint32_t m_TriangleCount;
+        Float3 m_Origin;
+        float m_CellSize;
+        int m_Dim[3];
+        std::vector<uint32_t> m_CellStart;
+        std::vector<uint32_t> m_CellTriangles;
+        std::vector<uint32_t> m_Stamp;
+        uint32_t m_Query;
+    };
+
+    // Samples the triangles no more than spacing apart and measures each sample's distance to the grid's surface
+    void MeasureOneWay(const SimplifySource& mesh, const uint16_t* indices, uint32_t indexCount, float spacing,
+        TriangleGrid& grid, float& maxDistanceSq, double& distanceSum, uint64_t& sampleCount)
+    {
+        for (uint32_t t = 0; t < indexCount / 3; t++)
+        {
+            Float3 a = GetPosition(mesh, indices[t * 3]);
+            Float3 b = GetPosition(mesh, indices[t * 3 + 1]);
+            Float3 c = GetPosition(mesh, indices[t * 3 + 2]);
+            float longest = std::max(Length(Sub(b, a)), std::max(Length(Sub(c, b)), Length(Sub(a, c))));
+            uint32_t steps = spacing > 0.0f ? std::min(16u, std::max(1u, (uint32_t)ceilf(longest / spacing))) : 1u;
+
+            for (uint32_t i = 0; i <= steps; i++)
+            {
+                for (uint32_t j = 0; i + j <= steps; j++)
+                {
+                    float u = (float)i / steps, v = (float)j / steps;
+                    Float3 p = Add(a, Add(Scale(Sub(b, a), u), Scale(Sub(c, a), v)));
+                    float distanceSq = grid.SquaredDistance(p);
+                    maxDistanceSq = std::max(maxDistanceSq, distanceSq);
+                    distanceSum += sqrt((double)distanceSq);
+                    sampleCount++;
+                }
+            }
+        }
+    }
+}
+
+uint32_t SimplifyMesh(const SimplifySource& mesh, uint32_t targetIndexCount, float maxError, uint16_t* destination, float* error)
+{
+    const uint32_t vertexCount = mesh.vertexCount;
+    if (error != nullptr)
+        *error = 0.0f;
+
+    std::vector<uint32_t> positionOf, wedgeNext;
+    FindWedges(mesh, positionOf, wedgeNext);
+
+    // Drop triangles that have collapsed to a line at one position
+    uint32_t indexCount = 0;
+    for (uint32_t n = 0; n + 2 < mesh.indexCount; n += 3)
+    {
+        uint32_t p0 = positionOf[mesh.indices[n]], p1 = positionOf[mesh.indices[n + 1]], p2 = positionOf[mesh.indices[n + 2]];
+        if (p0 == p1 || p1 == p2 || p2 == p0)
+            continue;
+        destination[indexCount++] = mesh.indices[n];
+        destination[indexCount++] = mesh.indices[n + 1];
+        destination[indexCount++] = mesh.indices[n + 2];
+    }
+    if (indexCount <= targetIndexCount)
+        return indexCount;
+
+    // Quadrics and errors are worked out in a unit cube so that they don't depend on the model's scale
+    Float3 boxMin = { FLT_MAX, FLT_MAX, FLT_MAX }, boxMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        Float3 p = GetPosition(mesh, v);
+        boxMin = Float3{ std::min(boxMin.x, p.x), std::min(boxMin.y, p.y), std::min(boxMin.z, p.z) };
+        boxMax = Float3{ std::max(boxMax.x, p.x), std::max(boxMax.y, p.y), std::max(boxMax.z, p.z) };
+    }
+    Float3 extent = Sub(boxMax, boxMin);
+    float longest = std::max(extent.x, std::max(extent.y, extent.z));
+    const float scale = longest > 0.0f ? 1.0f / longest : 1.0f;
+
+    std::vector<Float3> positions(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        positions[v] = Scale(Sub(GetPosition(mesh, v), boxMin), scale);
+
+    // Classify each position by its open and seam edges.  Everything from here on is indexed by position.
+    std::vector<HalfEdge> halfEdges;
+    halfEdges.reserve(indexCount);
+    for (uint32_t n = 0; n < indexCount; n += 3)
+    {
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            uint32_t a = destination[n + corner], b = destination[n + (corner + 1) % 3], c = destination[n + (corner + 2) % 3];
+            halfEdges.push_back(HalfEdge{ EdgeKey(positionOf[a], positionOf[b]), a, b, c });
+        }
+    }
+    std::sort(halfEdges.begin(), halfEdges.end(), [](const HalfEdge& l, const HalfEdge& r) { return l.key < r.key; });
+
+    std::vector<Quadric> quadrics(vertexCount, Quadric{});
+    std::vector<uint8_t> kind(vertexCount, kLocked);
+    std::vector<uint32_t> along[2] = { std::vector<uint32_t>(vertexCount, UINT32_MAX), std::vector<uint32_t>(vertexCount, UINT32_MAX) };
+    {
+        std::vector<uint8_t> openOut(vertexCount, 0), openIn(vertexCount, 0), seams(vertexCount, 0), wedges(vertexCount, 0);
+        std::vector<uint8_t> complex(vertexCount, 0);
+
+        auto findEdge = [&](uint64_t key) -> const HalfEdge*
+        {
+            auto it = std::lower_bound(halfEdges.begin(), halfEdges.end(), key, [](const HalfEdge& e, uint64_t k) { return e.key < k; });
+            return it != halfEdges.end() && it->key == key ? &*it : nullptr;
+        };
+
+        for (size_t n = 0; n < halfEdges.size(); n++)
+        {
+            const HalfEdge& edge = halfEdges[n];
+            uint32_t from = positionOf[edge.from], to = positionOf[edge.to];
+
+            // The same directed edge twice is a fold or a fin
+            if ((n > 0 && halfEdges[n - 1].key == edge.key) || (n + 1 < halfEdges.size() && halfEdges[n + 1].key == edge.key))
+                complex[from] = complex[to] = 1;
+
+            const HalfEdge* opposite = findEdge(EdgeKey(to, from));
+            bool open = opposite == nullptr;
+            bool seam = !open && (opposite->from != edge.to || opposite->to != edge.from);
+            if (open)
+            {
+                openOut[from] = (uint8_t)std::min(255, openOut[from] + 1);
+                openIn[to] = (uint8_t)std::min(255, openIn[to] + 1);
+                along[0][from] = to;
+                along[1][to] = from;
+            }
+            else if (seam)
+            {
+                if (seams[from] < 2)
+                    along[seams[from]][from] = to;
+                seams[from] = (uint8_t)std::min(255, seams[from] + 1);
+            }
+
+            if (open || seam)
+            {
+                // A plane through the edge, square to the triangle, keeps the border where it is
+                const Float3& p0 = positions[edge.from];
+                const Float3& p1 = positions[edge.to];
+                Float3 normal = Normalize(Cross(Sub(p1, p0), Sub(positions[edge.other], p0)));
+                Float3 side = Sub(p1, p0);
+                float lengthSq = Dot(side, side);
+                Float3 plane = Normalize(Cross(side, normal));
+                if (Dot(plane, plane) > 0.0f)
+                {
+                    AddPlane(quadrics[from], plane, -Dot(plane, p0), lengthSq * kBoundaryWeight);
+                    AddPlane(quadrics[to], plane, -Dot(plane, p0), lengthSq * kBoundaryWeight);
+                }
+            }
+        }
+
+        std::vector<uint8_t> used(vertexCount, 0);
+        for (uint32_t n = 0; n < indexCount; n++)
+            used[destination[n]] = 1;
+        for (uint32_t v = 0; v < vertexCount; v++)
+            if (used[v])
+                wedges[positionOf[v]] = (uint8_t)std::min(255, wedges[positionOf[v]] + 1);
+
+        for (uint32_t p = 0; p < vertexCount; p++)
+        {
+            if (positionOf[p] != p || wedges[p] == 0 || complex[p])
+                continue;
+
+            if (openOut[p] == 0 && openIn[p] == 0 && seams[p] == 0 && wedges[p] == 1)
+                kind[p] = kManifold;
+            else if (openOut[p] == 1 && openIn[p] == 1 && seams[p] == 0 && wedges[p] == 1)
+                kind[p] = kBorder;
+            else if (openOut[p] == 0 && openIn[p] == 0 && seams[p] == 2 && wedges[p] == 2 && along[0][p] != along[1][p])
+                kind[p] = kSeam;
+        }
+
+        // Triangle planes, weighted by area
+        for (uint32_t n = 0; n < indexCount; n += 3)
+        {
+            const Float3& p0 = positions[destination[n]];
+            Float3 normal = Cross(Sub(positions[destination[n + 1]], p0), Sub(positions[destination[n + 2]], p0));
+            float area = Length(normal) * 0.5f;
+            if (area == 0.0f)
+                continue;
+
+            normal = Scale(normal, 0.5f / area);
+            for (uint32_t corner = 0; corner < 3; corner++)
+                AddPlane(quadrics[positionOf[destination[n + corner]]], normal, -Dot(normal, p0), area);
+        }
+    }
+
+    auto canCollapse = [&](uint32_t from, uint32_t to) -> bool
+    {
+        switch (kind[from])
+        {
+        case kManifold:
+            return true;
+        case kBorder:
+            return (along[0][from] == to || along[1][from] == to) && (kind[to] == kBorder || kind[to] == kLocked);
+        case kSeam:
+            return (along[0][from] == to || along[1][from] == to) && (kind[to] == kSeam || kind[to] == kLocked);
+        default:
+            return false;
+        }
+    };
+
+    const float errorLimit = maxError < FLT_MAX ? (maxError * scale) * (maxError * scale) : FLT_MAX;
+    float worstError = 0.0f;
+
+    std::vector<uint32_t> remap(vertexCount), adjacencyOffset(vertexCount + 1), adjacency, wedgeTarget;
+    std::vector<uint8_t> locked(vertexCount);
+    std::vector<uint64_t> edges;
+    std::vector<Collapse> collapses;
+
+    while (indexCount > targetIndexCount)
+    {
+        // Triangles around each vertex
+        std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+        for (uint32_t n = 0; n < indexCount; n++)
+            adjacencyOffset[destination[n] + 1]++;
+        for (uint32_t v = 0; v < vertexCount; v++)
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        adjacency.resize(indexCount);
+        {
+            std::vector<uint32_t> cursor(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (uint32_t n = 0; n < indexCount; n++)
+                adjacency[cursor[destination[n]]++] = n / 3;
+        }
+
+        // Every edge between positions, each costed in the cheaper direction it can collapse
+        edges.clear();
+        for (uint32_t n = 0; n < indexCount; n += 3)
+        {
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t p0 = positionOf[destination[n + corner]], p1 = positionOf[destination[n + (corner + 1) % 3]];
+                edges.push_back(EdgeKey(std::min(p0, p1), std::max(p0, p1)));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        collapses.clear();
+        for (uint64_t edge : edges)
+        {
+            uint32_t p0 = (uint32_t)(edge >> 32), p1 = (uint32_t)edge;
+            Collapse best = { 0, 0, FLT_MAX };
+            if (canCollapse(p0, p1))
+                best = Collapse{ p0, p1, EvaluateQuadric(quadrics[p0], positions[p1]) };
+            if (canCollapse(p1, p0))
+            {
+                float cost = EvaluateQuadric(quadrics[p1], positions[p0]);
+                if (cost < best.error)
+                    best = Collapse{ p1, p0, cost };
+            }
+            if (best.error < FLT_MAX)
+                collapses.push_back(best);
+        }
+        if (collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r)
+        {
+            return l.error != r.error ? l.error < r.error : (l.from != r.from ? l.from < r.from : l.to < r.to);
+        });
+
+        // Take the cheap half of what is left to do in this pass, allowing a little more error once a tenth of
+        // it is done, so that error stays even across the mesh
+        const uint32_t triangleGoal = (indexCount - targetIndexCount) / 3;
+        const size_t edgeGoal = triangleGoal / 2;
+        const float errorGoal = edgeGoal < collapses.size() ? 1.5f * collapses[edgeGoal].error : FLT_MAX;
+
+        for (uint32_t v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        std::fill(locked.begin(), locked.end(), 0);
+
+        uint32_t removed = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapse.error > errorLimit || removed >= triangleGoal)
+                break;
+            if (collapse.error > errorGoal && removed > triangleGoal / 10)
+                break;
+
+            const uint32_t from = collapse.from, to = collapse.to;
+            if (locked[from] || locked[to])
+                continue;
+
+            // Each wedge must meet exactly one wedge of the target, which it becomes, and no triangle that stays
+            // may turn over or tilt so far that it nearly does
+            const Float3& target = positions[to];
+            bool valid = true;
+            uint32_t lostTriangles = 0;
+            wedgeTarget.clear();
+
+            uint32_t wedge = from;
+            do
+            {
+                uint32_t match = UINT32_MAX;
+                for (uint32_t a = adjacencyOffset[wedge]; a < adjacencyOffset[wedge + 1] && valid; a++)
+                {
+                    const uint16_t* corners = destination + adjacency[a] * 3;
+                    uint32_t v[3] = { remap[corners[0]], remap[corners[1]], remap[corners[2]] };
+                    uint32_t p[3] = { positionOf[v[0]], positionOf[v[1]], positionOf[v[2]] };
+                    if (p[0] == p[1] || p[1] == p[2] || p[2] == p[0])
+                        continue;
+
+                    int toCorner = p[0] == to ? 0 : p[1] == to ? 1 : p[2] == to ? 2 : -1;
+                    if (toCorner >= 0)
+                    {
+                        if (match != UINT32_MAX && match != v[toCorner])
+                            valid = false;
+                        match = v[toCorner];
+                        lostTriangles++;
+                        continue;
+                    }
+
+                    Float3 q[3] = { positions[v[0]], positions[v[1]], positions[v[2]] };
+                    Float3 before = Cross(Sub(q[1], q[0]), Sub(q[2], q[0]));
+                    for (int corner = 0; corner < 3; corner++)
+                        if (p[corner] == from)
+                            q[corner] = target;
+                    Float3 after = Cross(Sub(q[1], q[0]), Sub(q[2], q[0]));
+                    if (Dot(before, after) < kMinNormalCosine * sqrtf(Dot(before, before) * Dot(after, after)))
+                        valid = false;
+                }
+
+                if (adjacencyOffset[wedge] < adjacencyOffset[wedge + 1] && match == UINT32_MAX)
+                    valid = false;
+                wedgeTarget.push_back(match);
+                wedge = wedgeNext[wedge];
+            }
+            while (wedge != from && valid);
+
+            if (!valid)
+                continue;
+
+            wedge = from;
+            for (uint32_t match : wedgeTarget)
+            {
+                if (match != UINT32_MAX)
+                    remap[wedge] = match;
+                wedge = wedgeNext[wedge];
+            }
+
+            // Borders and seams close up over the vertex that left
+            if (kind[from] == kBorder || kind[from] == kSeam)
+            {
+                uint32_t beyond = along[0][from] == to ? along[1][from] : along[0][from];
+                for (int side = 0; side < 2; side++)
+                {
+                    if (along[side][to] == from)
+                        along[side][to] = beyond;
+                    if (beyond != UINT32_MAX && along[side][beyond] == from)
+                        along[side][beyond] = to;
+                }
+            }
+
+            AddQuadric(quadrics[to], quadrics[from]);
+            locked[from] = locked[to] = 1;
+            removed += lostTriangles;
+            worstError = std::max(worstError, collapse.error);
+        }
+
+        if (removed == 0)
+            break;
+
+        uint32_t written = 0;
+        for (uint32_t n = 0; n < indexCount; n += 3)
+        {
+            uint32_t v0 = remap[destination[n]], v1 = remap[destination[n + 1]], v2 = remap[destination[n + 2]];
+            uint32_t p0 = positionOf[v0], p1 = positionOf[v1], p2 = positionOf[v2];
+            if (p0 == p1 || p1 == p2 || p2 == p0)
+                continue;
+            destination[written++] = (uint16_t)v0;
+            destination[written++] = (uint16_t)v1;
+            destination[written++] = (uint16_t)v2;
+        }
+        indexCount = written;
+    }
+
+    if (error != nullptr)
+        *error = sqrtf(worstError) / scale;
+    return indexCount;
+}
+
+SurfaceDistance MeasureSurfaceDistance(const SimplifySource& mesh, const uint16_t* indices, uint32_t indexCount, float sampleSpacing)
+{
+    SurfaceDistance result = { 0.0f, 0.0f };
+    if (mesh.indexCount < 3 || indexCount < 3)
+    {
+        if (mesh.indexCount >= 3 || indexCount >= 3)
+            result.maxDistance = result.meanDistance = FLT_MAX;
+        return result;
+    }
+
+    TriangleGrid meshGrid(mesh, mesh.indices, mesh.indexCount);
+    TriangleGrid otherGrid(mesh, indices, indexCount);
+
+    float maxDistanceSq = 0.0f;
+    double distanceSum = 0.0;
+    uint64_t sampleCount = 0;
+    MeasureOneWay(mesh, mesh.indices, mesh.indexCount, sampleSpacing, otherGrid, maxDistanceSq, distanceSum, sampleCount);
+    MeasureOneWay(mesh, indices, indexCount, sampleSpacing, meshGrid, maxDistanceSq, distanceSum, sampleCount);
+
+    result.maxDistance = sqrtf(maxDistanceSq);
+    result.meanDistance = (float)(distanceSum / sampleCount);
+    return result;
+}
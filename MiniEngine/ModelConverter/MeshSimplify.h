@@ -0,0 +1,77 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct SimplifySource
+{
+    const float* positions;     // x, y, z at the start of each vertex
+    uint32_t vertexStride;      // in bytes
+    uint32_t vertexCount;
+    const uint16_t* indices;    // triangle list
+    uint32_t indexCount;
+};
+
+//-----------------------------------------------------------------------------
+//  SimplifyMesh
+//-----------------------------------------------------------------------------
+//  Reduces a mesh with quadric error edge collapses (Garland and Heckbert)
+//  until it is down to targetIndexCount or the cheapest collapse left would
+//  move the surface further than maxError.  A collapse moves one vertex onto
+//  a neighbor, so the result indexes the mesh's own vertices and needs no new
+//  vertex data.
+//
+//  Vertices at the same position with different attributes are wedges of one
+//  corner, and the edges where the wedges part are seams (UV borders, hard
+//  edges).  Seam and open border vertices only collapse along their seam or
+//  border, taking all their wedges to the matching wedges of the target, and
+//  planes through those edges are added to the quadrics to hold them in
+//  place.  Corners where seams or borders meet or branch, and non-manifold
+//  ones, never move.  Triangles with two corners at one position cover
+//  nothing and are dropped.
+//
+//  Parameters:
+//      mesh
+//          positions and indices of one mesh
+//      targetIndexCount
+//          stop once the mesh has no more indices than this
+//      maxError
+//          in the units of the positions
+//      destination
+//          receives the indices and must hold mesh.indexCount of them
+//      error
+//          if not null, receives the largest collapse error, an estimate of
+//          how far the surface moved
+//
+//  Returns the number of indices written.
+//-----------------------------------------------------------------------------
+uint32_t SimplifyMesh(const SimplifySource& mesh, uint32_t targetIndexCount, float maxError, uint16_t* destination, float* error);
+
+struct SurfaceDistance
+{
+    float maxDistance;      // the Hausdorff distance
+    float meanDistance;
+};
+
+//-----------------------------------------------------------------------------
+//  MeasureSurfaceDistance
+//-----------------------------------------------------------------------------
+//  Measures how far apart the surface of the mesh and another triangle list
+//  over the same vertices are, in both directions.  Points are sampled on
+//  every triangle no more than sampleSpacing apart and matched to the
+//  nearest point on the other surface.
+//-----------------------------------------------------------------------------
+SurfaceDistance MeasureSurfaceDistance(const SimplifySource& mesh, const uint16_t* indices, uint32_t indexCount, float sampleSpacing);
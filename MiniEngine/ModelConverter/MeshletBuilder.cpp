@@ -0,0 +1,524 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "MeshletBuilder.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <algorithm>
+
+namespace
+{
+    struct Float3
+    {
+        float x, y, z;
+    };
+
+    inline Float3 Add(const Float3& a, const Float3& b) { return Float3{ a.x + b.x, a.y + b.y, a.z + b.z }; }
+    inline Float3 Sub(const Float3& a, const Float3& b) { return Float3{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+    inline Float3 Scale(const Float3& a, float s) { return Float3{ a.x * s, a.y * s, a.z * s }; }
+    inline float Dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline float Length(const Float3& a) { return sqrtf(Dot(a, a)); }
+
+    inline Float3 Cross(const Float3& a, const Float3& b)
+    {
+        return Float3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    inline Float3 Normalize(const Float3& a)
+    {
+        float length = Length(a);
+        return length > 0.0f ? Scale(a, 1.0f / length) : Float3{ 0.0f, 0.0f, 0.0f };
+    }
+
+    inline Float3 GetPosition(const MeshletSource& mesh, uint32_t vertex)
+    {
+        const float* p = (const float*)((const uint8_t*)mesh.positions + (size_t)vertex * mesh.vertexStride);
+        return Float3{ p[0], p[1], p[2] };
+    }
+
+    // Unit normal of the counter-clockwise front face, or zero for a degenerate triangle
+    Float3 GetTriangleNormal(const MeshletSource& mesh, uint32_t triangle)
+    {
+        const uint16_t* corners = mesh.indices + triangle * 3;
+        Float3 p0 = GetPosition(mesh, corners[0]);
+        return Normalize(Cross(Sub(GetPosition(mesh, corners[1]), p0), Sub(GetPosition(mesh, corners[2]), p0)));
+    }
+
+    float GetBoundingRadius(const MeshletSource& mesh, const std::vector<uint32_t>& vertices, const Float3& center)
+    {
+        float radiusSq = 0.0f;
+        for (uint32_t vertex : vertices)
+        {
+            Float3 d = Sub(GetPosition(mesh, vertex), center);
+            radiusSq = std::max(radiusSq, Dot(d, d));
+        }
+        return sqrtf(radiusSq);
+    }
+
+    // The smaller of the sphere around the bounding box and Ritter's sphere, with the radius taken exactly from
+    // whichever center wins
+    void ComputeBoundingSphere(const MeshletSource& mesh, const std::vector<uint32_t>& vertices, Meshlet& meshlet)
+    {
+        Float3 boxMin = GetPosition(mesh, vertices[0]), boxMax = boxMin;
+        uint32_t extremeMin[3] = {}, extremeMax[3] = {};
+        for (uint32_t n = 1; n < vertices.size(); n++)
+        {
+            Float3 p = GetPosition(mesh, vertices[n]);
+            const float* pc = &p.x;
+            float* minc = &boxMin.x;
+            float* maxc = &boxMax.x;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (pc[axis] < minc[axis]) { minc[axis] = pc[axis]; extremeMin[axis] = n; }
+                if (pc[axis] > maxc[axis]) { maxc[axis] = pc[axis]; extremeMax[axis] = n; }
+            }
+        }
+
+        Float3 boxCenter = Scale(Add(boxMin, boxMax), 0.5f);
+        float boxRadius = GetBoundingRadius(mesh, vertices, boxCenter);
+
+        // Start with the most distant pair of axis extremes and grow the sphere over anything outside it
+        float widestSq = -1.0f;
+        Float3 a = {}, b = {};
+        for (int axis = 0; axis < 3; axis++)
+        {
+            Float3 pMin = GetPosition(mesh, vertices[extremeMin[axis]]);
+            Float3 pMax = GetPosition(mesh, vertices[extremeMax[axis]]);
+            Float3 d = Sub(pMax, pMin);
+            if (Dot(d, d) > widestSq)
+            {
+                widestSq = Dot(d, d);
+                a = pMin;
+                b = pMax;
+            }
+        }
+
+        Float3 center = Scale(Add(a, b), 0.5f);
+        float radius = sqrtf(widestSq) * 0.5f;
+        for (uint32_t vertex : vertices)
+        {
+            Float3 p = GetPosition(mesh, vertex);
+            float distance = Length(Sub(p, center));
+            if (distance > radius)
+            {
+                float newRadius = (radius + distance) * 0.5f;
+                center = Add(center, Scale(Sub(p, center), (newRadius - radius) / distance));
+                radius = newRadius;
+            }
+        }
+        radius = GetBoundingRadius(mesh, vertices, center);
+
+        if (boxRadius < radius)
+        {
+            center = boxCenter;
+            radius = boxRadius;
+        }
+
+        meshlet.center[0] = center.x;
+        meshlet.center[1] = center.y;
+        meshlet.center[2] = center.z;
+        meshlet.radius = radius;
+    }
+
+    // The axis is the mean of the triangle normals and the cone is just wide enough to hold them all.  The apex
+    // slides back along the axis until it is behind every triangle's plane.  Wider than about 84 degrees, the
+    // cone would almost never cull, so the meshlet gets none.
+    void ComputeNormalCone(const MeshletSource& mesh, const std::vector<uint32_t>& triangles,
+        const std::vector<Float3>& normals, Meshlet& meshlet)
+    {
+        const Float3 center = { meshlet.center[0], meshlet.center[1], meshlet.center[2] };
+
+        meshlet.coneApex[0] = center.x;
+        meshlet.coneApex[1] = center.y;
+        meshlet.coneApex[2] = center.z;
+        meshlet.coneAxis[0] = meshlet.coneAxis[1] = meshlet.coneAxis[2] = 0.0f;
+        meshlet.coneCutoff = 1.0f;
+
+        Float3 normalSum = {};
+        for (uint32_t triangle : triangles)
+            normalSum = Add(normalSum, normals[triangle]);
+
+        Float3 axis = Normalize(normalSum);
+        if (Dot(axis, axis) == 0.0f)
+            return;
+
+        float minDot = 1.0f;
+        for (uint32_t triangle : triangles)
+        {
+            const Float3& normal = normals[triangle];
+            if (Dot(normal, normal) > 0.0f)
+                minDot = std::min(minDot, Dot(normal, axis));
+        }
+
+        if (minDot <= 0.1f)
+            return;
+
+        float maxDistance = -FLT_MAX;
+        for (uint32_t triangle : triangles)
+        {
+            const Float3& normal = normals[triangle];
+            if (Dot(normal, normal) == 0.0f)
+                continue;
+
+            Float3 p0 = GetPosition(mesh, mesh.indices[triangle * 3]);
+            maxDistance = std::max(maxDistance, Dot(Sub(center, p0), normal) / Dot(axis, normal));
+        }
+
+        Float3 apex = Sub(center, Scale(axis, maxDistance));
+        meshlet.coneApex[0] = apex.x;
+        meshlet.coneApex[1] = apex.y;
+        meshlet.coneApex[2] = apex.z;
+        meshlet.coneAxis[0] = axis.x;
+        meshlet.coneAxis[1] = axis.y;
+        meshlet.coneAxis[2] = axis.z;
+        meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+    }
+
+    // How far ahead in index order to look for a nearby triangle once a meshlet runs out of connected ones
+    enum {kSearchWindow = 256};
+
+    // How much a triangle's normal turning away from the meshlet's counts against it, in average edge lengths
+    const float kNormalWeight = 2.0f;
+
+    bool Fail(char* error, size_t errorSize, const char* format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(error, errorSize, format, args);
+        va_end(args);
+        return false;
+    }
+
+    inline uint64_t TriangleKey(uint32_t i0, uint32_t i1, uint32_t i2)
+    {
+        return (uint64_t)i0 | (uint64_t)i1 << 16 | (uint64_t)i2 << 32;
+    }
+}
+
+void BuildMeshlets(const MeshletSource& mesh, uint32_t maxVertices, uint32_t maxPrimitives, MeshletList& list)
+{
+    assert(maxVertices >= 3 && maxVertices <= kMaxMeshletVertices);
+    assert(maxPrimitives >= 1 && maxPrimitives <= kMaxMeshletPrimitives);
+
+    const uint32_t triangleCount = mesh.indexCount / 3;
+    const uint16_t* indices = mesh.indices;
+    if (triangleCount == 0)
+        return;
+
+    // Triangles around each vertex, and how many of them are still unassigned
+    std::vector<uint32_t> adjacencyOffset(mesh.vertexCount + 1, 0);
+    for (uint32_t n = 0; n < triangleCount * 3; n++)
+        adjacencyOffset[indices[n] + 1]++;
+    for (uint32_t v = 0; v < mesh.vertexCount; v++)
+        adjacencyOffset[v + 1] += adjacencyOffset[v];
+
+    std::vector<uint32_t> liveTriangles(mesh.vertexCount);
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    for (uint32_t v = 0; v < mesh.vertexCount; v++)
+        liveTriangles[v] = adjacencyOffset[v + 1] - adjacencyOffset[v];
+    {
+        std::vector<uint32_t> cursor(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (uint32_t n = 0; n < triangleCount * 3; n++)
+            adjacency[cursor[indices[n]]++] = n / 3;
+    }
+
+    std::vector<Float3> centroids(triangleCount), normals(triangleCount);
+    double edgeLengthSum = 0.0;
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        Float3 p0 = GetPosition(mesh, indices[t * 3 + 0]);
+        Float3 p1 = GetPosition(mesh, indices[t * 3 + 1]);
+        Float3 p2 = GetPosition(mesh, indices[t * 3 + 2]);
+        centroids[t] = Scale(Add(Add(p0, p1), p2), 1.0f / 3.0f);
+        normals[t] = GetTriangleNormal(mesh, t);
+        edgeLengthSum += Length(Sub(p1, p0)) + Length(Sub(p2, p1)) + Length(Sub(p0, p2));
+    }
+    const float distanceScale = edgeLengthSum > 0.0 ? (float)(triangleCount * 3 / edgeLengthSum) : 1.0f;
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> candidateOf(triangleCount, UINT32_MAX); // the meshlet that listed it as a candidate
+    std::vector<uint16_t> localIndex(mesh.vertexCount, 0xFFFF);
+
+    std::vector<uint32_t> candidates, meshletVertices, meshletTriangles;
+    uint32_t remaining = triangleCount;
+    uint32_t scanPosition = 0;
+    uint32_t seed = 0;
+
+    auto countNewVertices = [&](uint32_t triangle) -> uint32_t
+    {
+        uint32_t i0 = indices[triangle * 3], i1 = indices[triangle * 3 + 1], i2 = indices[triangle * 3 + 2];
+        return (localIndex[i0] == 0xFFFF) + (localIndex[i1] == 0xFFFF && i1 != i0) +
+            (localIndex[i2] == 0xFFFF && i2 != i0 && i2 != i1);
+    };
+
+    while (remaining > 0)
+    {
+        const uint32_t meshletIndex = (uint32_t)list.meshlets.size();
+        Float3 positionSum = {}, normalSum = {};
+        candidates.clear();
+        meshletVertices.clear();
+        meshletTriangles.clear();
+
+        for (uint32_t next = seed;;)
+        {
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t vertex = indices[next * 3 + corner];
+                if (localIndex[vertex] == 0xFFFF)
+                {
+                    localIndex[vertex] = (uint16_t)meshletVertices.size();
+                    meshletVertices.push_back(vertex);
+                    positionSum = Add(positionSum, GetPosition(mesh, vertex));
+
+                    for (uint32_t a = adjacencyOffset[vertex]; a < adjacencyOffset[vertex + 1]; a++)
+                    {
+                        uint32_t triangle = adjacency[a];
+                        if (!emitted[triangle] && candidateOf[triangle] != meshletIndex)
+                        {
+                            candidateOf[triangle] = meshletIndex;
+                            candidates.push_back(triangle);
+                        }
+                    }
+                }
+                liveTriangles[vertex]--;
+            }
+            emitted[next] = 1;
+            remaining--;
+            meshletTriangles.push_back(next);
+            normalSum = Add(normalSum, normals[next]);
+
+            if (meshletTriangles.size() == maxPrimitives || remaining == 0)
+                break;
+
+            const Float3 center = Scale(positionSum, 1.0f / meshletVertices.size());
+            const Float3 axis = Normalize(normalSum);
+
+            // Fewest new vertices first, so fans close before the meshlet spreads, then nearest and flattest
+            uint32_t best = UINT32_MAX, bestNewVertices = 4;
+            float bestScore = FLT_MAX;
+            for (size_t n = 0; n < candidates.size();)
+            {
+                uint32_t triangle = candidates[n];
+                if (emitted[triangle])
+                {
+                    candidates[n] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                n++;
+
+                uint32_t newVertices = countNewVertices(triangle);
+                if (meshletVertices.size() + newVertices > maxVertices || newVertices > bestNewVertices)
+                    continue;
+
+                float score = Length(Sub(centroids[triangle], center)) * distanceScale +
+                    kNormalWeight * (1.0f - Dot(normals[triangle], axis));
+                if (newVertices < bestNewVertices || score < bestScore)
+                {
+                    best = triangle;
+                    bestNewVertices = newVertices;
+                    bestScore = score;
+                }
+            }
+
+            if (best == UINT32_MAX)
+            {
+                // Connected triangles that don't fit end the meshlet.  Once there are none, the nearest of the
+                // triangles that come next in index order, which the vertex cache ordering keeps close, fills it.
+                if (!candidates.empty())
+                    break;
+
+                while (emitted[scanPosition])
+                    scanPosition++;
+
+                float bestDistanceSq = FLT_MAX;
+                for (uint32_t triangle = scanPosition; triangle < triangleCount && triangle < scanPosition + kSearchWindow; triangle++)
+                {
+                    if (emitted[triangle] || meshletVertices.size() + countNewVertices(triangle) > maxVertices)
+                        continue;
+
+                    Float3 d = Sub(centroids[triangle], center);
+                    if (Dot(d, d) < bestDistanceSq)
+                    {
+                        best = triangle;
+                        bestDistanceSq = Dot(d, d);
+                    }
+                }
+
+                if (best == UINT32_MAX)
+                    break;
+            }
+
+            next = best;
+        }
+
+        Meshlet meshlet = {};
+        meshlet.vertexOffset = (uint32_t)list.vertices.size();
+        meshlet.vertexCount = (uint32_t)meshletVertices.size();
+        meshlet.primitiveOffset = (uint32_t)list.primitives.size();
+        meshlet.primitiveCount = (uint32_t)meshletTriangles.size();
+
+        for (uint32_t vertex : meshletVertices)
+            list.vertices.push_back((uint16_t)vertex);
+        for (uint32_t triangle : meshletTriangles)
+        {
+            const uint16_t* corners = indices + triangle * 3;
+            list.primitives.push_back(PackMeshletTriangle(localIndex[corners[0]], localIndex[corners[1]], localIndex[corners[2]]));
+        }
+
+        ComputeBoundingSphere(mesh, meshletVertices, meshlet);
+        ComputeNormalCone(mesh, meshletTriangles, normals, meshlet);
+        list.meshlets.push_back(meshlet);
+
+        for (uint32_t vertex : meshletVertices)
+            localIndex[vertex] = 0xFFFF;
+
+        if (remaining == 0)
+            break;
+
+        // Start the next meshlet on this one's border, at the triangle with the fewest unassigned neighbors, so
+        // that corners and thin strips are taken before they are cut off
+        seed = UINT32_MAX;
+        uint32_t seedLiveCount = UINT32_MAX;
+        for (uint32_t triangle : candidates)
+        {
+            if (emitted[triangle])
+                continue;
+
+            const uint16_t* corners = indices + triangle * 3;
+            uint32_t liveCount = liveTriangles[corners[0]] + liveTriangles[corners[1]] + liveTriangles[corners[2]];
+            if (liveCount < seedLiveCount)
+            {
+                seed = triangle;
+                seedLiveCount = liveCount;
+            }
+        }
+
+        if (seed == UINT32_MAX)
+        {
+            while (emitted[scanPosition])
+                scanPosition++;
+            seed = scanPosition;
+        }
+    }
+}
+
+bool ValidateMeshlets(const MeshletSource& mesh, const MeshletList& list, uint32_t firstMeshlet, uint32_t meshletCount,
+    uint32_t maxVertices, uint32_t maxPrimitives, char* error, size_t errorSize)
+{
+    if ((size_t)firstMeshlet + meshletCount > list.meshlets.size())
+        return Fail(error, errorSize, "meshlets %u-%u are past the end of the list", firstMeshlet, firstMeshlet + meshletCount);
+
+    const uint32_t triangleCount = mesh.indexCount / 3;
+    std::vector<uint64_t> expected(triangleCount), found;
+    for (uint32_t t = 0; t < triangleCount; t++)
+        expected[t] = TriangleKey(mesh.indices[t * 3], mesh.indices[t * 3 + 1], mesh.indices[t * 3 + 2]);
+    found.reserve(triangleCount);
+
+    std::vector<uint32_t> seenIn(mesh.vertexCount, UINT32_MAX);
+    std::vector<uint8_t> used;
+
+    for (uint32_t meshletIndex = firstMeshlet; meshletIndex < firstMeshlet + meshletCount; meshletIndex++)
+    {
+        const Meshlet& meshlet = list.meshlets[meshletIndex];
+
+        if (meshlet.vertexCount == 0 || meshlet.vertexCount > maxVertices)
+            return Fail(error, errorSize, "meshlet %u has %u vertices", meshletIndex, meshlet.vertexCount);
+        if (meshlet.primitiveCount == 0 || meshlet.primitiveCount > maxPrimitives)
+            return Fail(error, errorSize, "meshlet %u has %u triangles", meshletIndex, meshlet.primitiveCount);
+        if ((size_t)meshlet.vertexOffset + meshlet.vertexCount > list.vertices.size() ||
+            (size_t)meshlet.primitiveOffset + meshlet.primitiveCount > list.primitives.size())
+            return Fail(error, errorSize, "meshlet %u is past the end of the vertex or primitive list", meshletIndex);
+
+        const uint16_t* vertices = list.vertices.data() + meshlet.vertexOffset;
+        for (uint32_t n = 0; n < meshlet.vertexCount; n++)
+        {
+            if (vertices[n] >= mesh.vertexCount)
+                return Fail(error, errorSize, "meshlet %u uses vertex %u of %u", meshletIndex, vertices[n], mesh.vertexCount);
+            if (seenIn[vertices[n]] == meshletIndex)
+                return Fail(error, errorSize, "meshlet %u lists vertex %u twice", meshletIndex, vertices[n]);
+            seenIn[vertices[n]] = meshletIndex;
+        }
+
+        const Float3 center = { meshlet.center[0], meshlet.center[1], meshlet.center[2] };
+        const Float3 apex = { meshlet.coneApex[0], meshlet.coneApex[1], meshlet.coneApex[2] };
+        const Float3 axis = { meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2] };
+        const bool hasCone = meshlet.coneCutoff < 1.0f;
+        const float minDot = hasCone ? sqrtf(std::max(0.0f, 1.0f - meshlet.coneCutoff * meshlet.coneCutoff)) : 0.0f;
+        if (hasCone && (meshlet.coneCutoff < 0.0f || fabsf(Length(axis) - 1.0f) > 1e-3f))
+            return Fail(error, errorSize, "meshlet %u has a malformed cone", meshletIndex);
+
+        used.assign(meshlet.vertexCount, 0);
+        const uint32_t* primitives = list.primitives.data() + meshlet.primitiveOffset;
+        for (uint32_t n = 0; n < meshlet.primitiveCount; n++)
+        {
+            uint32_t corners[3];
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t local = UnpackMeshletIndex(primitives[n], corner);
+                if (local >= meshlet.vertexCount || (primitives[n] >> 30) != 0)
+                    return Fail(error, errorSize, "meshlet %u triangle %u refers past its %u vertices", meshletIndex, n, meshlet.vertexCount);
+                used[local] = 1;
+                corners[corner] = vertices[local];
+            }
+            found.push_back(TriangleKey(corners[0], corners[1], corners[2]));
+
+            if (!hasCone)
+                continue;
+
+            // Back-face culling must agree with the cone for every eye position it culls from
+            Float3 p0 = GetPosition(mesh, corners[0]);
+            Float3 normal = Normalize(Cross(Sub(GetPosition(mesh, corners[1]), p0), Sub(GetPosition(mesh, corners[2]), p0)));
+            if (Dot(normal, normal) == 0.0f)
+                continue;
+            if (Dot(normal, axis) < minDot - 1e-3f)
+                return Fail(error, errorSize, "meshlet %u triangle %u is outside the normal cone", meshletIndex, n);
+            if (Dot(Sub(apex, p0), normal) > 1e-4f * (Length(Sub(apex, p0)) + meshlet.radius))
+                return Fail(error, errorSize, "meshlet %u triangle %u faces the cone apex", meshletIndex, n);
+        }
+
+        for (uint32_t n = 0; n < meshlet.vertexCount; n++)
+        {
+            if (!used[n])
+                return Fail(error, errorSize, "meshlet %u vertex %u belongs to no triangle", meshletIndex, n);
+
+            float distance = Length(Sub(GetPosition(mesh, vertices[n]), center));
+            if (distance > meshlet.radius + 1e-5f * (meshlet.radius + Length(center)))
+                return Fail(error, errorSize, "meshlet %u vertex %u is outside the bounding sphere", meshletIndex, n);
+        }
+    }
+
+    std::sort(expected.begin(), expected.end());
+    std::sort(found.begin(), found.end());
+    if (expected != found)
+    {
+        // Report the first triangle whose count differs
+        size_t e = 0, f = 0;
+        while (e < expected.size() && f < found.size() && expected[e] == found[f])
+        {
+            e++;
+            f++;
+        }
+        uint64_t key = (f < found.size() && (e == expected.size() || found[f] < expected[e])) ? found[f] : expected[e];
+        size_t expectedCount = std::upper_bound(expected.begin(), expected.end(), key) - std::lower_bound(expected.begin(), expected.end(), key);
+        size_t foundCount = std::upper_bound(found.begin(), found.end(), key) - std::lower_bound(found.begin(), found.end(), key);
+        return Fail(error, errorSize, "triangle (%u, %u, %u) is in the mesh %zu times and in its meshlets %zu times",
+            (uint32_t)(key & 0xFFFF), (uint32_t)(key >> 16 & 0xFFFF), (uint32_t)(key >> 32 & 0xFFFF), expectedCount, foundCount);
+    }
+
+    return true;
+}
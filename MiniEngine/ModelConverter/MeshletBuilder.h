@@ -0,0 +1,72 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#pragma once
+
+#include "Meshlet.h"
+
+#include <stddef.h>
+#include <vector>
+
+enum {kMaxMeshletVertices = 256};
+enum {kMaxMeshletPrimitives = 256};
+
+struct MeshletSource
+{
+    const float* positions;     // x, y, z at the start of each vertex
+    uint32_t vertexStride;      // in bytes
+    uint32_t vertexCount;
+    const uint16_t* indices;    // triangle list
+    uint32_t indexCount;
+};
+
+struct MeshletList
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> primitives;
+    std::vector<uint16_t> vertices;
+};
+
+//-----------------------------------------------------------------------------
+//  BuildMeshlets
+//-----------------------------------------------------------------------------
+//  Splits a mesh into meshlets and appends them to the list.  Each meshlet
+//  starts from a triangle on the edge of the last one and grows across
+//  shared edges, taking the triangle that needs the fewest new vertices and,
+//  among those, the one nearest its center and closest to its normals.  When
+//  nothing connected is left it takes the nearest triangle that follows in
+//  index order.  Every triangle lands in exactly one meshlet, degenerate ones
+//  included, with its corners in their original order.
+//
+//  Parameters:
+//      mesh
+//          positions and indices of one mesh
+//      maxVertices, maxPrimitives
+//          limits per meshlet, 3-256 and 1-256
+//      list
+//          the meshlets are appended, with offsets into its vertex and
+//          primitive lists
+//-----------------------------------------------------------------------------
+void BuildMeshlets(const MeshletSource& mesh, uint32_t maxVertices, uint32_t maxPrimitives, MeshletList& list);
+
+//-----------------------------------------------------------------------------
+//  ValidateMeshlets
+//-----------------------------------------------------------------------------
+//  Checks meshlets [firstMeshlet, firstMeshlet + meshletCount) of the list
+//  against the mesh they were built from:  limits, index ranges, that every
+//  triangle of the mesh appears exactly once with its winding, that the
+//  spheres hold their vertices, and that the cones are conservative.  On
+//  failure it describes the first problem in error and returns false.
+//-----------------------------------------------------------------------------
+bool ValidateMeshlets(const MeshletSource& mesh, const MeshletList& list, uint32_t firstMeshlet, uint32_t meshletCount,
+    uint32_t maxVertices, uint32_t maxPrimitives, char* error, size_t errorSize);
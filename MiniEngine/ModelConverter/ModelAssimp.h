@@ -30,6 +30,17 @@ public:
 	virtual bool Load(const char* filename) override;
 	bool Save(const char* filename) const;
 
+	// Splits every mesh into meshlets for cluster culling.  Needs the vertex and index data on the CPU, so
+	// only works on models loaded through ASSIMP.
+	bool GenerateMeshlets(uint32_t maxVertices, uint32_t maxPrimitives);
+
+	// Builds a chain of up to maxLODs reduced index lists per mesh, each about ratio the size of the one before,
+	// over the mesh's own vertices.  maxError bounds the Hausdorff distance from the full mesh as a fraction of
+	// its bounding sphere's radius, and pixelError sets how many pixels of error a LOD may show before the
+	// viewer switches to a finer one.  Meshes are simplified on up to numThreads threads.  Like meshlets, this
+	// only works on models loaded through ASSIMP.
+	bool GenerateLODs(uint32_t maxLODs, float ratio, float maxError, float pixelError, uint32_t numThreads);
+
 private:
 
 	bool LoadAssimp(const char *filename);
@@ -14,13 +14,25 @@
 #include "ModelAssimp.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
 
 void PrintHelp()
 {
     printf("model_convert\n");
 
     printf("usage:\n");
-    printf("model_convert input_file output_file\n");
+    printf("model_convert [options] input_file output_file\n");
+    printf("options:\n");
+    printf("  -meshlets                 split meshes into meshlets of up to 64 vertices and 124 triangles\n");
+    printf("  -meshlet_size <v> <t>     meshlets of up to v vertices (3-256) and t triangles (1-256)\n");
+    printf("  -lods <n>                 add up to n reduced LODs (1-8) to every mesh\n");
+    printf("  -lod_ratio <r>            each LOD keeps about r of the triangles of the one before (default 0.5)\n");
+    printf("  -lod_error <e>            largest Hausdorff distance from the full mesh, relative to its radius (default 0.1)\n");
+    printf("  -lod_pixel_error <p>      pixels of error a LOD may show before a finer one is drawn (default 1)\n");
+    printf("  -threads <n>              threads for building LODs (default: one per core)\n");
 }
 
 void PrintModelStats(const Model *model)
@@ -100,6 +112,32 @@ void PrintModelStats(const Model *model)
     }
     printf("\n");
 
+    if (model->m_pMeshletRange != nullptr)
+    {
+        printf("meshlet count: %u\n", model->m_MeshletHeader.meshletCount);
+        printf("meshlet limits: %u vertices, %u triangles\n", model->m_MeshletHeader.maxVertices, model->m_MeshletHeader.maxPrimitives);
+        printf("meshlet data size: %u\n", (unsigned int)(sizeof(Meshlet) * model->m_MeshletHeader.meshletCount
+            + sizeof(uint32_t) * model->m_MeshletHeader.primitiveCount + sizeof(uint16_t) * model->m_MeshletHeader.vertexCount));
+        printf("\n");
+    }
+
+    if (model->m_pLODRange != nullptr)
+    {
+        printf("LOD count: %u, for %.1f pixels of error\n", model->m_LODHeader.lodCount, model->m_LODHeader.pixelError);
+        printf("LOD index data size: %u\n", model->m_LODHeader.indexDataByteSize);
+        for (unsigned int meshIndex = 0; meshIndex < model->m_Header.meshCount; meshIndex++)
+        {
+            const Model::LODRange &range = model->m_pLODRange[meshIndex];
+            for (uint32_t lodIndex = 0; lodIndex < range.lodCount; lodIndex++)
+            {
+                const Model::MeshLOD &lod = model->m_pLOD[range.lodOffset + lodIndex];
+                printf("mesh %u LOD %u: indices %u, error %f, below %.1f pixels\n",
+                    meshIndex, lodIndex + 1, lod.indexCount, lod.error, lod.screenSize);
+            }
+        }
+        printf("\n");
+    }
+
     printf("material count: %u\n", model->m_Header.materialCount);
     for (unsigned int materialIndex = 0; materialIndex < model->m_Header.materialCount; materialIndex++)
     {
@@ -112,14 +150,63 @@ void PrintModelStats(const Model *model)
 
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    bool meshlets = false;
+    unsigned int meshletVertices = 64;
+    unsigned int meshletTriangles = 124;
+    unsigned int lodCount = 0;
+    float lodRatio = 0.5f;
+    float lodError = 0.1f;
+    float lodPixelError = 1.0f;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (0 == strcmp(argv[arg], "-meshlets"))
+        {
+            meshlets = true;
+        }
+        else if (0 == strcmp(argv[arg], "-meshlet_size") && arg + 2 < argc)
+        {
+            meshlets = true;
+            meshletVertices = (unsigned int)atoi(argv[++arg]);
+            meshletTriangles = (unsigned int)atoi(argv[++arg]);
+        }
+        else if (0 == strcmp(argv[arg], "-lods") && arg + 1 < argc)
+        {
+            lodCount = (unsigned int)atoi(argv[++arg]);
+        }
+        else if (0 == strcmp(argv[arg], "-lod_ratio") && arg + 1 < argc)
+        {
+            lodRatio = (float)atof(argv[++arg]);
+        }
+        else if (0 == strcmp(argv[arg], "-lod_error") && arg + 1 < argc)
+        {
+            lodError = (float)atof(argv[++arg]);
+        }
+        else if (0 == strcmp(argv[arg], "-lod_pixel_error") && arg + 1 < argc)
+        {
+            lodPixelError = (float)atof(argv[++arg]);
+        }
+        else if (0 == strcmp(argv[arg], "-threads") && arg + 1 < argc)
+        {
+            threads = (unsigned int)atoi(argv[++arg]);
+        }
+        else
+        {
+            PrintHelp();
+            return -1;
+        }
+    }
+
+    if (argc - arg != 2)
     {
         PrintHelp();
         return -1;
     }
 
-    const char *input_file = argv[1];
-    const char *output_file = argv[2];
+    const char *input_file = argv[arg];
+    const char *output_file = argv[arg + 1];
 
     printf("input file %s\n", input_file);
     printf("output file %s\n", output_file);
@@ -133,6 +220,26 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    if (meshlets)
+    {
+        printf("building meshlets...\n");
+        if (!model.GenerateMeshlets(meshletVertices, meshletTriangles))
+        {
+            printf("failed to build meshlets: %s\n", input_file);
+            return -1;
+        }
+    }
+
+    if (lodCount > 0)
+    {
+        printf("building LODs...\n");
+        if (!model.GenerateLODs(lodCount, lodRatio, lodError, lodPixelError, threads))
+        {
+            printf("failed to build LODs: %s\n", input_file);
+            return -1;
+        }
+    }
+
     printf("saving...\n");
     if (!model.Save(output_file))
     {
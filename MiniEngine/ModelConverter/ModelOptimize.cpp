@@ -13,8 +13,18 @@
 
 #include "ModelAssimp.h"
 #include "IndexOptimizePostTransform.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplify.h"
 
 #include <string.h>
+#include <stdio.h>
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 void AssimpModel::OptimizeRemoveDuplicateVertices(bool depth)
 {
@@ -182,3 +192,314 @@ void AssimpModel::Optimize()
     OptimizePreTransform(false);
     OptimizePreTransform(true);
 }
+
+bool AssimpModel::GenerateMeshlets(uint32_t maxVertices, uint32_t maxPrimitives)
+{
+    if (m_pVertexData == nullptr || m_pIndexData == nullptr)
+    {
+        printf("meshlets need the source model's vertex and index data\n");
+        return false;
+    }
+
+    if (maxVertices < 3 || maxVertices > kMaxMeshletVertices || maxPrimitives < 1 || maxPrimitives > kMaxMeshletPrimitives)
+    {
+        printf("meshlet limits must be 3-%u vertices and 1-%u triangles\n", kMaxMeshletVertices, kMaxMeshletPrimitives);
+        return false;
+    }
+
+    ClearMeshlets();
+
+    MeshletList list;
+    MeshletRange *ranges = new MeshletRange [m_Header.meshCount];
+    uint32_t triangleCount = 0;
+    double buildSeconds = 0.0;
+
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        const Mesh *mesh = m_pMesh + meshIndex;
+        const Attrib &position = mesh->attrib[attrib_position];
+        if (position.format != attrib_format_float || position.components < 3)
+        {
+            printf("mesh %u: meshlets need float positions\n", meshIndex);
+            delete [] ranges;
+            return false;
+        }
+
+        MeshletSource source;
+        source.positions = (const float*)(m_pVertexData + mesh->vertexDataByteOffset + position.offset);
+        source.vertexStride = mesh->vertexStride;
+        source.vertexCount = mesh->vertexCount;
+        source.indices = (const uint16_t*)(m_pIndexData + mesh->indexDataByteOffset);
+        source.indexCount = mesh->indexCount;
+
+        ranges[meshIndex].meshletOffset = (uint32_t)list.meshlets.size();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        BuildMeshlets(source, maxVertices, maxPrimitives, list);
+        buildSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        ranges[meshIndex].meshletCount = (uint32_t)list.meshlets.size() - ranges[meshIndex].meshletOffset;
+        triangleCount += mesh->indexCount / 3;
+
+        char error[256];
+        if (!ValidateMeshlets(source, list, ranges[meshIndex].meshletOffset, ranges[meshIndex].meshletCount,
+            maxVertices, maxPrimitives, error, sizeof(error)))
+        {
+            printf("mesh %u: bad meshlets: %s\n", meshIndex, error);
+            delete [] ranges;
+            return false;
+        }
+    }
+
+    m_MeshletHeader.meshletCount = (uint32_t)list.meshlets.size();
+    m_MeshletHeader.vertexCount = (uint32_t)list.vertices.size();
+    m_MeshletHeader.primitiveCount = (uint32_t)list.primitives.size();
+    m_MeshletHeader.maxVertices = maxVertices;
+    m_MeshletHeader.maxPrimitives = maxPrimitives;
+
+    m_pMeshletRange = ranges;
+    m_pMeshlet = new Meshlet [list.meshlets.size()];
+    m_pMeshletPrimitives = new uint32_t [list.primitives.size()];
+    m_pMeshletVertices = new uint16_t [list.vertices.size()];
+    std::copy(list.meshlets.begin(), list.meshlets.end(), m_pMeshlet);
+    std::copy(list.primitives.begin(), list.primitives.end(), m_pMeshletPrimitives);
+    std::copy(list.vertices.begin(), list.vertices.end(), m_pMeshletVertices);
+
+    // How full the meshlets are against whichever limit stopped each one
+    double fill = 0.0;
+    uint32_t coneCount = 0;
+    for (const Meshlet &meshlet : list.meshlets)
+    {
+        fill += std::max((double)meshlet.vertexCount / maxVertices, (double)meshlet.primitiveCount / maxPrimitives);
+        coneCount += meshlet.coneCutoff < 1.0f;
+    }
+    if (!list.meshlets.empty())
+        fill /= list.meshlets.size();
+
+    printf("meshlets: %u of up to %u vertices and %u triangles, %.1f%% full, %u with normal cones\n",
+        m_MeshletHeader.meshletCount, maxVertices, maxPrimitives, fill * 100.0, coneCount);
+    printf("meshlets: %u triangles in %.1f ms, %.1f ms per million triangles\n", triangleCount, buildSeconds * 1000.0,
+        triangleCount > 0 ? buildSeconds * 1000.0 * 1e6 / triangleCount : 0.0);
+
+    return true;
+}
+
+namespace
+{
+    const uint32_t kMaxLODs = 8;
+
+    struct LODChain
+    {
+        std::vector<uint16_t> indices; // every reduced level, one after another
+        std::vector<Model::MeshLOD> lods; // offsets into indices above, in bytes
+        std::vector<float> meanError;
+        uint32_t simplifiedTriangles; // triangles fed to the simplifier, over all levels
+        double seconds;
+    };
+}
+
+bool AssimpModel::GenerateLODs(uint32_t maxLODs, float ratio, float maxError, float pixelError, uint32_t numThreads)
+{
+    if (m_pVertexData == nullptr || m_pIndexData == nullptr)
+    {
+        printf("LODs need the source model's vertex and index data\n");
+        return false;
+    }
+
+    if (maxLODs < 1 || maxLODs > kMaxLODs || !(ratio > 0.0f && ratio < 1.0f) || !(maxError > 0.0f) || !(pixelError > 0.0f))
+    {
+        printf("LODs need 1-%u levels, a ratio between 0 and 1, and an error and pixel error above 0\n", kMaxLODs);
+        return false;
+    }
+
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        const Attrib &position = m_pMesh[meshIndex].attrib[attrib_position];
+        if (position.format != attrib_format_float || position.components < 3)
+        {
+            printf("mesh %u: LODs need float positions\n", meshIndex);
+            return false;
+        }
+    }
+
+    ClearLODs();
+
+    // Meshes are independent, so threads take whole meshes, the largest first so that no thread is left with a
+    // big one at the end
+    std::vector<uint32_t> order(m_Header.meshCount);
+    for (uint32_t meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+        order[meshIndex] = meshIndex;
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t l, uint32_t r)
+    {
+        return m_pMesh[l].indexCount > m_pMesh[r].indexCount;
+    });
+
+    std::vector<LODChain> chains(m_Header.meshCount);
+    std::atomic<uint32_t> nextMesh(0);
+
+    auto worker = [&]()
+    {
+        for (uint32_t next = nextMesh++; next < m_Header.meshCount; next = nextMesh++)
+        {
+            const uint32_t meshIndex = order[next];
+            const Mesh *mesh = m_pMesh + meshIndex;
+            LODChain &chain = chains[meshIndex];
+            chain.simplifiedTriangles = 0;
+            chain.seconds = 0.0;
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            SimplifySource source;
+            source.positions = (const float*)(m_pVertexData + mesh->vertexDataByteOffset + mesh->attrib[attrib_position].offset);
+            source.vertexStride = mesh->vertexStride;
+            source.vertexCount = mesh->vertexCount;
+            source.indices = (const uint16_t*)(m_pIndexData + mesh->indexDataByteOffset);
+            source.indexCount = mesh->indexCount;
+
+            // Errors are relative to the bounding sphere, which is also what the viewer projects to pick a LOD
+            const float radius = 0.5f * (float)Length(mesh->boundingBox.max - mesh->boundingBox.min);
+            if (radius <= 0.0f)
+                continue;
+
+            double edgeLength = 0.0;
+            for (uint32_t n = 0; n < source.indexCount; n++)
+            {
+                const float *p0 = (const float*)((const unsigned char*)source.positions + source.indices[n] * source.vertexStride);
+                const float *p1 = (const float*)((const unsigned char*)source.positions +
+                    source.indices[n % 3 == 2 ? n - 2 : n + 1] * source.vertexStride);
+                edgeLength += sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1]) + (p1[2] - p0[2]) * (p1[2] - p0[2]));
+            }
+            const float sampleSpacing = source.indexCount > 0 ? (float)(0.5 * edgeLength / source.indexCount) : radius;
+
+            // Each level is made from the one before, and the chain ends when a level barely shrinks or strays
+            // too far from the full mesh
+            std::vector<uint16_t> current(source.indices, source.indices + source.indexCount);
+            std::vector<uint16_t> reduced(source.indexCount);
+            float threshold = FLT_MAX;
+
+            for (uint32_t level = 0; level < maxLODs; level++)
+            {
+                uint32_t targetIndexCount = (uint32_t)(current.size() / 3 * ratio) * 3;
+                if (targetIndexCount < 3)
+                    break;
+
+                SimplifySource previous = source;
+                previous.indices = current.data();
+                previous.indexCount = (uint32_t)current.size();
+                uint32_t indexCount = SimplifyMesh(previous, targetIndexCount, maxError * radius, reduced.data(), nullptr);
+                chain.simplifiedTriangles += previous.indexCount / 3;
+                if (indexCount < 3 || indexCount > previous.indexCount * 9 / 10)
+                    break;
+
+                SurfaceDistance distance = MeasureSurfaceDistance(source, reduced.data(), indexCount, sampleSpacing);
+                if (distance.maxDistance > maxError * radius)
+                    break;
+
+                // The mesh's diameter on screen at which the error covers pixelError pixels, kept from growing
+                // down the chain so that the viewer can stop at the first level it is too big for
+                if (distance.maxDistance > 0.0f)
+                    threshold = std::min(threshold, pixelError * 2.0f * radius / distance.maxDistance);
+
+                MeshLOD lod;
+                lod.indexDataByteOffset = (uint32_t)(chain.indices.size() * sizeof(uint16_t));
+                lod.indexCount = indexCount;
+                lod.error = distance.maxDistance;
+                lod.screenSize = threshold;
+                chain.lods.push_back(lod);
+                chain.meanError.push_back(distance.meanDistance);
+                chain.indices.insert(chain.indices.end(), reduced.begin(), reduced.begin() + indexCount);
+
+                current.assign(reduced.begin(), reduced.begin() + indexCount);
+            }
+
+            chain.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t n = 1; n < std::min(std::max(numThreads, 1u), m_Header.meshCount); n++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+        thread.join();
+    double wallSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    // Pack the chains in mesh order
+    uint32_t lodCount = 0, indexDataByteSize = 0;
+    for (const LODChain &chain : chains)
+    {
+        lodCount += (uint32_t)chain.lods.size();
+        indexDataByteSize += (uint32_t)(chain.indices.size() * sizeof(uint16_t));
+    }
+
+    m_LODHeader.lodCount = lodCount;
+    m_LODHeader.indexDataByteSize = indexDataByteSize;
+    m_LODHeader.pixelError = pixelError;
+    m_LODHeader.reserved = 0;
+    m_pLODRange = new LODRange [m_Header.meshCount];
+    m_pLOD = new MeshLOD [lodCount];
+    m_pLODIndexData = new unsigned char [indexDataByteSize];
+
+    uint32_t lodOffset = 0, indexDataByteOffset = 0;
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        const LODChain &chain = chains[meshIndex];
+        m_pLODRange[meshIndex].lodOffset = lodOffset;
+        m_pLODRange[meshIndex].lodCount = (uint32_t)chain.lods.size();
+
+        for (const MeshLOD &lod : chain.lods)
+        {
+            m_pLOD[lodOffset] = lod;
+            m_pLOD[lodOffset].indexDataByteOffset += indexDataByteOffset;
+            lodOffset++;
+        }
+        if (!chain.indices.empty())
+            memcpy(m_pLODIndexData + indexDataByteOffset, chain.indices.data(), chain.indices.size() * sizeof(uint16_t));
+        indexDataByteOffset += (uint32_t)(chain.indices.size() * sizeof(uint16_t));
+    }
+
+    // How much each level keeps and how far it strays, relative to each mesh's bounding sphere
+    uint32_t sourceTriangles = 0, simplifiedTriangles = 0;
+    double threadSeconds = 0.0;
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        sourceTriangles += m_pMesh[meshIndex].indexCount / 3;
+        simplifiedTriangles += chains[meshIndex].simplifiedTriangles;
+        threadSeconds += chains[meshIndex].seconds;
+    }
+
+    for (uint32_t level = 0; level < maxLODs; level++)
+    {
+        uint32_t meshCount = 0, triangleCount = 0, fullTriangleCount = 0;
+        float maxDistance = 0.0f;
+        double meanDistance = 0.0;
+        for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+        {
+            const LODChain &chain = chains[meshIndex];
+            if (level >= chain.lods.size())
+                continue;
+
+            const float radius = 0.5f * (float)Length(m_pMesh[meshIndex].boundingBox.max - m_pMesh[meshIndex].boundingBox.min);
+            meshCount++;
+            triangleCount += chain.lods[level].indexCount / 3;
+            fullTriangleCount += m_pMesh[meshIndex].indexCount / 3;
+            maxDistance = std::max(maxDistance, chain.lods[level].error / radius);
+            meanDistance += chain.meanError[level] / radius;
+        }
+        if (meshCount == 0)
+            break;
+
+        printf("LOD %u: %u meshes, %u triangles (%.1f%% of theirs at LOD 0), Hausdorff up to %.3f%% of the radius, mean %.4f%%\n",
+            level + 1, meshCount, triangleCount, 100.0 * triangleCount / fullTriangleCount, maxDistance * 100.0f, meanDistance / meshCount * 100.0);
+    }
+
+    printf("LODs: %u levels over %u meshes, %u index bytes (%.1f%% of LOD 0)\n", lodCount, m_Header.meshCount,
+        indexDataByteSize, m_Header.indexDataByteSize > 0 ? 100.0 * indexDataByteSize / m_Header.indexDataByteSize : 0.0);
+    printf("LODs: %u source triangles, %u simplified in %.1f ms on %u threads, %.2f M triangles/s (%.2f M per thread)\n",
+        sourceTriangles, simplifiedTriangles, wallSeconds * 1000.0, (uint32_t)threads.size() + 1,
+        wallSeconds > 0.0 ? simplifiedTriangles / wallSeconds * 1e-6 : 0.0,
+        threadSeconds > 0.0 ? simplifiedTriangles / threadSeconds * 1e-6 : 0.0);
+
+    return true;
+}
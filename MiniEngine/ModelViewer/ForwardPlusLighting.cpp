@@ -13,6 +13,7 @@
 //
 
 #include "ForwardPlusLighting.h"
+#include "LightBinner.h"
 #include "PipelineState.h"
 #include "RootSignature.h"
 #include "CommandContext.h"
@@ -24,29 +25,21 @@
 #include "CompiledShaders/FillLightGridCS_24.h"
 #include "CompiledShaders/FillLightGridCS_32.h"
 
+#include <random>
+
 using namespace Math;
 using namespace Graphics;
 
-// must keep in sync with HLSL
-struct LightData
-{
-    float pos[3];
-    float radiusSq;
-    float color[3];
-
-    uint32_t type;
-    float coneDir[3];
-    float coneAngles[2];
-
-    float shadowTextureMatrix[16];
-};
-
 enum { kMinLightGridDim = 8 };
 
 namespace Lighting
 {
     IntVar LightGridDim("Application/Forward+/Light Grid Dim", 16, kMinLightGridDim, 32, 8 );
 
+    // Builds the light grid with LightBinner instead of FillLightGridCS.  The CPU can't see the
+    // depth buffer, so its tiles span the whole depth range and can list more lights.
+    BoolVar CpuLightGrid("Application/Forward+/CPU Light Grid", false);
+
     RootSignature m_FillLightRootSig;
     ComputePSO m_FillLightGridCS_8;
     ComputePSO m_FillLightGridCS_16;
@@ -58,6 +51,9 @@ namespace Lighting
     ByteAddressBuffer m_LightGrid;
 
     ByteAddressBuffer m_LightGridBitMask;
+    LightBinner m_CpuLightBinner;
+    std::vector<uint32_t> m_CpuLightGrid;
+    std::vector<uint32_t> m_CpuLightGridBitMask;
     uint32_t m_FirstConeLight;
     uint32_t m_FirstConeShadowedLight;
 
@@ -69,6 +65,7 @@ namespace Lighting
     void InitializeResources(void);
     void CreateRandomLights(const Vector3 minBound, const Vector3 maxBound);
     void FillLightGrid(GraphicsContext& gfxContext, const Camera& camera);
+    void FillLightGridOnCpu(GraphicsContext& gfxContext, const Camera& camera);
     void Shutdown(void);
 }
 
@@ -102,26 +99,25 @@ void Lighting::CreateRandomLights( const Vector3 minBound, const Vector3 maxBoun
     Vector3 posScale = maxBound - minBound;
     Vector3 posBias = minBound;
 
-    // todo: replace this with MT
-    srand(12645);
-    auto randUint = []() -> uint32_t
+    // mt19937's output is fully specified, so the lights are the same with every compiler
+    std::mt19937 rng(12645);
+    auto randUint = [&rng]() -> uint32_t
     {
-        return rand(); // [0, RAND_MAX]
+        return rng(); // [0, 2^32)
     };
     auto randFloat = [randUint]() -> float
     {
-        return randUint() * (1.0f / RAND_MAX); // convert [0, RAND_MAX] to [0, 1]
+        return (randUint() >> 8) * (1.0f / (1 << 24)); // convert [0, 2^24) to [0, 1)
     };
     auto randVecUniform = [randFloat]() -> Vector3
     {
         return Vector3(randFloat(), randFloat(), randFloat());
     };
-    auto randGaussian = [randFloat]() -> float
+    bool gaussianPair = true;
+    float y2 = 0.0f;
+    auto randGaussian = [randFloat, &gaussianPair, &y2]() -> float
     {
         // polar box-muller
-        static bool gaussianPair = true;
-        static float y2;
-
         if (gaussianPair)
         {
             gaussianPair = false;
@@ -263,10 +259,40 @@ void Lighting::Shutdown(void)
     m_LightShadowTempBuffer.Destroy();
 }
 
+void Lighting::FillLightGridOnCpu(GraphicsContext& gfxContext, const Camera& camera)
+{
+    LightGridDesc desc = {};
+    std::memcpy(desc.ViewProjMatrix, &camera.GetViewProjMatrix(), sizeof(desc.ViewProjMatrix));
+    desc.ViewportWidth = g_SceneColorBuffer.GetWidth();
+    desc.ViewportHeight = g_SceneColorBuffer.GetHeight();
+    desc.TileDim = LightGridDim;
+    desc.NearClip = camera.GetNearClip();
+    desc.FarClip = camera.GetFarClip();
+    m_CpuLightBinner.BinLights(desc, m_LightData, MaxLights);
+
+    uint32_t tileCount = m_CpuLightBinner.GetTileCountX() * m_CpuLightBinner.GetTileCountY();
+    size_t lightGridSizeBytes = tileCount * (4 + MaxLights * 4);
+    m_CpuLightGrid.resize(lightGridSizeBytes / 4);
+    m_CpuLightGridBitMask.resize(tileCount * 4);
+    m_CpuLightBinner.WriteGpuLightGrid(m_CpuLightGrid.data(), lightGridSizeBytes,
+        m_CpuLightGridBitMask.data(), tileCount * 16);
+
+    gfxContext.WriteBuffer(m_LightGrid, 0, m_CpuLightGrid.data(), lightGridSizeBytes);
+    gfxContext.WriteBuffer(m_LightGridBitMask, 0, m_CpuLightGridBitMask.data(), tileCount * 16);
+    gfxContext.TransitionResource(m_LightGrid, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    gfxContext.TransitionResource(m_LightGridBitMask, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+}
+
 void Lighting::FillLightGrid(GraphicsContext& gfxContext, const Camera& camera)
 {
     ScopedTimer _prof(L"FillLightGrid", gfxContext);
 
+    if (CpuLightGrid)
+    {
+        FillLightGridOnCpu(gfxContext, camera);
+        return;
+    }
+
     ComputeContext& Context = gfxContext.GetComputeContext();
 
     Context.SetRootSignature(m_FillLightRootSig);
@@ -31,6 +31,20 @@ namespace Math
     class Camera;
 }
 
+// must keep in sync with HLSL
+struct LightData
+{
+    float pos[3];
+    float radiusSq;
+    float color[3];
+
+    uint32_t type;
+    float coneDir[3];
+    float coneAngles[2];
+
+    float shadowTextureMatrix[16];
+};
+
 namespace Lighting
 {
     extern IntVar LightGridDim;
@@ -0,0 +1,457 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author(s):  Alex Nankervis
+//             James Stanard
+//
+
+#include "LightBinner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <emmintrin.h>
+
+using namespace Lighting;
+
+namespace
+{
+    // An element of the view-projection matrix, which is stored one column after another.
+    inline float ViewProj( const float* Matrix, uint32_t Row, uint32_t Column )
+    {
+        return Matrix[Column * 4 + Row];
+    }
+
+    inline void MakePlane( float x, float y, float z, float w, float* Plane )
+    {
+        float Scale = 1.0f / std::sqrt(x * x + y * y + z * z);
+        Plane[0] = x * Scale;
+        Plane[1] = y * Scale;
+        Plane[2] = z * Scale;
+        Plane[3] = w * Scale;
+    }
+
+    // Sets Visible to the lights that are not entirely behind any of the planes, and returns how
+    // many there are.  The lights are tested four at a time, but each one goes through the same
+    // operations as in LightBinner::BinLightsReference().
+    template <typename PlaneType>
+    uint32_t CullLights( const PlaneType* Planes, uint32_t PlaneCount, const float* PosX, const float* PosY,
+        const float* PosZ, const float* Radius, uint32_t LightCount, uint32_t* Visible )
+    {
+        __m128 PlaneX[4], PlaneY[4], PlaneZ[4], PlaneW[4];
+        for (uint32_t p = 0; p < PlaneCount; ++p)
+        {
+            PlaneX[p] = _mm_set1_ps(Planes[p].x);
+            PlaneY[p] = _mm_set1_ps(Planes[p].y);
+            PlaneZ[p] = _mm_set1_ps(Planes[p].z);
+            PlaneW[p] = _mm_set1_ps(Planes[p].w);
+        }
+
+        const __m128 SignBit = _mm_set1_ps(-0.0f);
+        uint32_t VisibleCount = 0;
+
+        for (uint32_t i = 0; i < LightCount; i += 4)
+        {
+            __m128 X = _mm_loadu_ps(PosX + i);
+            __m128 Y = _mm_loadu_ps(PosY + i);
+            __m128 Z = _mm_loadu_ps(PosZ + i);
+            __m128 NegRadius = _mm_xor_ps(_mm_loadu_ps(Radius + i), SignBit);
+
+            __m128 Outside = _mm_setzero_ps();
+            for (uint32_t p = 0; p < PlaneCount; ++p)
+            {
+                __m128 Dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(X, PlaneX[p]), _mm_mul_ps(Y, PlaneY[p])),
+                    _mm_mul_ps(Z, PlaneZ[p])), PlaneW[p]);
+                Outside = _mm_or_ps(Outside, _mm_cmplt_ps(Dist, NegRadius));
+            }
+
+            uint32_t Mask = ~_mm_movemask_ps(Outside) & 0xF;
+            if (LightCount - i < 4)
+                Mask &= (1u << (LightCount - i)) - 1;
+
+            for (uint32_t Lane = 0; Mask != 0; ++Lane, Mask >>= 1)
+            {
+                if (Mask & 1)
+                    Visible[VisibleCount++] = i + Lane;
+            }
+        }
+
+        return VisibleCount;
+    }
+}
+
+void LightBinner::LightList::Resize( uint32_t Capacity )
+{
+    // Leave room for the loads past the last light of a group of four.
+    Capacity = (Capacity + 3) & ~3u;
+    PosX.resize(Capacity);
+    PosY.resize(Capacity);
+    PosZ.resize(Capacity);
+    Radius.resize(Capacity);
+    SortedPos.resize(Capacity);
+    Count = 0;
+}
+
+void LightBinner::LightList::Append( const LightList& Source, const uint32_t* Visible, uint32_t VisibleCount )
+{
+    for (uint32_t i = 0; i < VisibleCount; ++i)
+    {
+        uint32_t n = Visible[i];
+        PosX[Count] = Source.PosX[n];
+        PosY[Count] = Source.PosY[n];
+        PosZ[Count] = Source.PosZ[n];
+        Radius[Count] = Source.Radius[n];
+        SortedPos[Count] = Source.SortedPos[n];
+        ++Count;
+    }
+}
+
+LightBinner::LightBinner( uint32_t ThreadCount )
+    : m_ThreadCount(ThreadCount)
+    , m_TileCountX(0)
+    , m_TileCountY(0)
+    , m_SliceCount(1)
+    , m_LightCount(0)
+{
+    if (m_ThreadCount == 0)
+        m_ThreadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    std::memset(&m_Desc, 0, sizeof(m_Desc));
+    std::memset(m_TypeEnd, 0, sizeof(m_TypeEnd));
+    m_CellOffsets.push_back(0);
+}
+
+void LightBinner::BeginGrid( const LightGridDesc& Desc, uint32_t LightCount )
+{
+    m_Desc = Desc;
+    m_TileCountX = (Desc.ViewportWidth + Desc.TileDim - 1) / Desc.TileDim;
+    m_TileCountY = (Desc.ViewportHeight + Desc.TileDim - 1) / Desc.TileDim;
+    m_SliceCount = std::max(1u, Desc.DepthSliceCount);
+    m_LightCount = LightCount;
+
+    m_RowLights.resize(m_TileCountY);
+    for (auto& Row : m_RowLights)
+        Row.clear();
+
+    m_CellCounts.assign(GetCellCount() * kLightTypeCount, 0);
+}
+
+void LightBinner::FinishGrid( void )
+{
+    uint32_t CellCount = GetCellCount();
+    m_CellOffsets.resize(CellCount + 1);
+    m_CellOffsets[0] = 0;
+    for (uint32_t Cell = 0; Cell < CellCount; ++Cell)
+    {
+        const uint32_t* Counts = &m_CellCounts[Cell * kLightTypeCount];
+        m_CellOffsets[Cell + 1] = m_CellOffsets[Cell] + Counts[0] + Counts[1] + Counts[2];
+    }
+
+    m_LightIndices.resize(m_CellOffsets[CellCount]);
+    uint32_t* Dest = m_LightIndices.data();
+    for (const auto& Row : m_RowLights)
+    {
+        if (!Row.empty())
+            std::memcpy(Dest, Row.data(), Row.size() * sizeof(uint32_t));
+        Dest += Row.size();
+    }
+}
+
+// The side planes of a tile's frustum, built the same way as in FillLightGridCS.  Planes 2 and 3
+// depend only on the tile row.
+void LightBinner::ComputeTilePlanes( uint32_t TileX, uint32_t TileY, Plane Planes[4] ) const
+{
+    const float* VP = m_Desc.ViewProjMatrix;
+    float InvTileDim = 1.0f / (float)m_Desc.TileDim;
+    float InvTileSize2X = (float)m_Desc.ViewportWidth * InvTileDim;
+    float InvTileSize2Y = (float)m_Desc.ViewportHeight * InvTileDim;
+    float TileBiasX = -2.0f * (float)TileX + InvTileSize2X - 1.0f;
+    float TileBiasY = -2.0f * (float)TileY + InvTileSize2Y - 1.0f;
+
+    float Row0[4], Row1[4], Row3[4];
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+        Row0[j] = InvTileSize2X * ViewProj(VP, 0, j) + TileBiasX * ViewProj(VP, 3, j);
+        Row1[j] = -InvTileSize2Y * ViewProj(VP, 1, j) + TileBiasY * ViewProj(VP, 3, j);
+        Row3[j] = ViewProj(VP, 3, j);
+    }
+
+    MakePlane(Row3[0] + Row0[0], Row3[1] + Row0[1], Row3[2] + Row0[2], Row3[3] + Row0[3], &Planes[0].x);
+    MakePlane(Row3[0] - Row0[0], Row3[1] - Row0[1], Row3[2] - Row0[2], Row3[3] - Row0[3], &Planes[1].x);
+    MakePlane(Row3[0] + Row1[0], Row3[1] + Row1[1], Row3[2] + Row1[2], Row3[3] + Row1[3], &Planes[2].x);
+    MakePlane(Row3[0] - Row1[0], Row3[1] - Row1[1], Row3[2] - Row1[2], Row3[3] - Row1[3], &Planes[3].x);
+}
+
+// The near and far planes of a cell.  For screen tiles these are FillLightGridCS's planes, which
+// reach past the far end of the tile by the length of its projected depth range (and so past the
+// far clip plane when the tile has no depth bounds).  Depth slices are bounded exactly, so that a
+// light only lands in the slices it touches.
+void LightBinner::ComputeDepthPlanes( uint32_t TileIndex, uint32_t Slice, Plane Planes[2] ) const
+{
+    const float RcpZMagic = m_Desc.NearClip / (m_Desc.FarClip - m_Desc.NearClip);
+    const bool Sliced = m_Desc.DepthSliceCount > 0;
+
+    // Depth in the [0, 1] range of the (reversed) projection, from near (1) to far (0)
+    float TileMinDepth = 0.0f;
+    float TileMaxDepth = 1.0f;
+
+    if (Sliced)
+    {
+        float DepthRatio = m_Desc.FarClip / m_Desc.NearClip;
+        float MinLinear = m_Desc.NearClip * std::pow(DepthRatio, (float)Slice / m_SliceCount) / m_Desc.FarClip;
+        float MaxLinear = m_Desc.NearClip * std::pow(DepthRatio, (float)(Slice + 1) / m_SliceCount) / m_Desc.FarClip;
+        TileMinDepth = (1.0f / MaxLinear - 1.0f) * RcpZMagic;
+        TileMaxDepth = (1.0f / MinLinear - 1.0f) * RcpZMagic;
+    }
+    else if (m_Desc.TileDepthBounds != nullptr)
+    {
+        float MinLinear = m_Desc.TileDepthBounds[TileIndex * 2 + 0];
+        float MaxLinear = m_Desc.TileDepthBounds[TileIndex * 2 + 1];
+        TileMinDepth = (1.0f / MaxLinear - 1.0f) * RcpZMagic;
+        TileMaxDepth = (1.0f / MinLinear - 1.0f) * RcpZMagic;
+    }
+
+    float TileDepthRange = std::max(TileMaxDepth - TileMinDepth, FLT_MIN);
+    float InvTileDepthRange = 1.0f / TileDepthRange;
+    float TileBiasZ = -TileMinDepth * InvTileDepthRange;
+
+    const float* VP = m_Desc.ViewProjMatrix;
+    float Row2[4], Row3[4];
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+        Row2[j] = InvTileDepthRange * ViewProj(VP, 2, j) + TileBiasZ * ViewProj(VP, 3, j);
+        Row3[j] = ViewProj(VP, 3, j);
+    }
+
+    if (Sliced)
+        MakePlane(Row2[0], Row2[1], Row2[2], Row2[3], &Planes[0].x);
+    else
+        MakePlane(Row3[0] + Row2[0], Row3[1] + Row2[1], Row3[2] + Row2[2], Row3[3] + Row2[3], &Planes[0].x);
+    MakePlane(Row3[0] - Row2[0], Row3[1] - Row2[1], Row3[2] - Row2[2], Row3[3] - Row2[3], &Planes[1].x);
+}
+
+uint32_t LightBinner::GetDepthSlice( float ViewDepth ) const
+{
+    if (ViewDepth <= m_Desc.NearClip)
+        return 0;
+
+    float Slice = std::log(ViewDepth / m_Desc.NearClip) / std::log(m_Desc.FarClip / m_Desc.NearClip) * m_SliceCount;
+    return std::min((uint32_t)Slice, m_SliceCount - 1);
+}
+
+const uint32_t* LightBinner::GetCellLights( uint32_t CellIndex, uint32_t Counts[kLightTypeCount] ) const
+{
+    for (uint32_t Type = 0; Type < kLightTypeCount; ++Type)
+        Counts[Type] = m_CellCounts[CellIndex * kLightTypeCount + Type];
+
+    return m_LightIndices.data() + m_CellOffsets[CellIndex];
+}
+
+void LightBinner::SortLights( const LightData* Lights, uint32_t LightCount )
+{
+    m_SortedLights.Resize(LightCount);
+    m_SortedIndex.clear();
+
+    for (uint32_t Type = 0; Type < kLightTypeCount; ++Type)
+    {
+        for (uint32_t n = 0; n < LightCount; ++n)
+        {
+            if (Lights[n].type != Type)
+                continue;
+
+            uint32_t Pos = m_SortedLights.Count++;
+            m_SortedLights.PosX[Pos] = Lights[n].pos[0];
+            m_SortedLights.PosY[Pos] = Lights[n].pos[1];
+            m_SortedLights.PosZ[Pos] = Lights[n].pos[2];
+            m_SortedLights.Radius[Pos] = std::sqrt(Lights[n].radiusSq);
+            m_SortedLights.SortedPos[Pos] = Pos;
+            m_SortedIndex.push_back(n);
+        }
+        m_TypeEnd[Type] = m_SortedLights.Count;
+    }
+}
+
+void LightBinner::AddCellLights( uint32_t CellIndex, const uint32_t* SortedPos, const uint32_t* Visible, uint32_t VisibleCount )
+{
+    std::vector<uint32_t>& Row = m_RowLights[CellIndex / (m_TileCountX * m_SliceCount)];
+    uint32_t* Counts = &m_CellCounts[CellIndex * kLightTypeCount];
+
+    // The lights are in sorted order, so each type's lights follow the previous type's.
+    for (uint32_t i = 0; i < VisibleCount; ++i)
+    {
+        uint32_t Pos = SortedPos[Visible[i]];
+        Row.push_back(m_SortedIndex[Pos]);
+        Counts[Pos < m_TypeEnd[0] ? 0 : Pos < m_TypeEnd[1] ? 1 : 2]++;
+    }
+}
+
+void LightBinner::BinTileRow( uint32_t TileY, RowScratch& Scratch )
+{
+    Plane TilePlanes[4];
+    Plane DepthPlanes[2];
+
+    // Only keep the lights that reach this row of tiles.
+    ComputeTilePlanes(0, TileY, TilePlanes);
+    const LightList& All = m_SortedLights;
+    uint32_t VisibleCount = CullLights(TilePlanes + 2, 2, All.PosX.data(), All.PosY.data(), All.PosZ.data(),
+        All.Radius.data(), All.Count, Scratch.Visible.data());
+
+    LightList& Row = Scratch.RowLights;
+    Row.Count = 0;
+    Row.Append(All, Scratch.Visible.data(), VisibleCount);
+
+    for (uint32_t TileX = 0; TileX < m_TileCountX; ++TileX)
+    {
+        ComputeTilePlanes(TileX, TileY, TilePlanes);
+        uint32_t TileIndex = TileY * m_TileCountX + TileX;
+
+        if (m_Desc.DepthSliceCount == 0)
+        {
+            ComputeDepthPlanes(TileIndex, 0, DepthPlanes);
+            Plane Planes[4] = { TilePlanes[0], TilePlanes[1], DepthPlanes[0], DepthPlanes[1] };
+            VisibleCount = CullLights(Planes, 4, Row.PosX.data(), Row.PosY.data(), Row.PosZ.data(),
+                Row.Radius.data(), Row.Count, Scratch.Visible.data());
+            AddCellLights(GetCellIndex(TileX, TileY), Row.SortedPos.data(), Scratch.Visible.data(), VisibleCount);
+            continue;
+        }
+
+        VisibleCount = CullLights(TilePlanes, 2, Row.PosX.data(), Row.PosY.data(), Row.PosZ.data(),
+            Row.Radius.data(), Row.Count, Scratch.Visible.data());
+
+        LightList& Tile = Scratch.TileLights;
+        Tile.Count = 0;
+        Tile.Append(Row, Scratch.Visible.data(), VisibleCount);
+
+        for (uint32_t Slice = 0; Slice < m_SliceCount; ++Slice)
+        {
+            ComputeDepthPlanes(TileIndex, Slice, DepthPlanes);
+            VisibleCount = CullLights(DepthPlanes, 2, Tile.PosX.data(), Tile.PosY.data(), Tile.PosZ.data(),
+                Tile.Radius.data(), Tile.Count, Scratch.Visible.data());
+            AddCellLights(GetCellIndex(TileX, TileY, Slice), Tile.SortedPos.data(), Scratch.Visible.data(), VisibleCount);
+        }
+    }
+}
+
+void LightBinner::BinLights( const LightGridDesc& Desc, const LightData* Lights, uint32_t LightCount )
+{
+    BeginGrid(Desc, LightCount);
+    SortLights(Lights, LightCount);
+
+    std::atomic<uint32_t> NextRow(0);
+    auto Worker = [&]()
+    {
+        RowScratch Scratch;
+        Scratch.RowLights.Resize(m_SortedLights.Count);
+        Scratch.TileLights.Resize(m_SortedLights.Count);
+        Scratch.Visible.resize(m_SortedLights.Count);
+
+        for (;;)
+        {
+            uint32_t TileY = NextRow.fetch_add(1);
+            if (TileY >= m_TileCountY)
+                break;
+            BinTileRow(TileY, Scratch);
+        }
+    };
+
+    uint32_t HelperCount = std::min(m_ThreadCount, m_TileCountY);
+    HelperCount = HelperCount > 1 ? HelperCount - 1 : 0;
+
+    std::vector<std::thread> Threads;
+    for (uint32_t i = 0; i < HelperCount; ++i)
+        Threads.push_back(std::thread(Worker));
+    Worker();
+    for (auto& T : Threads)
+        T.join();
+
+    FinishGrid();
+}
+
+void LightBinner::BinLightsReference( const LightGridDesc& Desc, const LightData* Lights, uint32_t LightCount )
+{
+    BeginGrid(Desc, LightCount);
+
+    std::vector<uint32_t> TypeLights[kLightTypeCount];
+
+    for (uint32_t TileY = 0; TileY < m_TileCountY; ++TileY)
+    {
+        for (uint32_t TileX = 0; TileX < m_TileCountX; ++TileX)
+        {
+            for (uint32_t Slice = 0; Slice < m_SliceCount; ++Slice)
+            {
+                Plane Planes[6];
+                ComputeTilePlanes(TileX, TileY, Planes);
+                ComputeDepthPlanes(TileY * m_TileCountX + TileX, Slice, Planes + 4);
+
+                for (auto& List : TypeLights)
+                    List.clear();
+
+                for (uint32_t n = 0; n < LightCount; ++n)
+                {
+                    const LightData& Light = Lights[n];
+                    if (Light.type >= kLightTypeCount)
+                        continue;
+
+                    float CullRadius = std::sqrt(Light.radiusSq);
+                    bool Overlapping = true;
+                    for (uint32_t p = 0; p < 6; ++p)
+                    {
+                        float Dist = Light.pos[0] * Planes[p].x + Light.pos[1] * Planes[p].y + Light.pos[2] * Planes[p].z + Planes[p].w;
+                        if (Dist < -CullRadius)
+                            Overlapping = false;
+                    }
+
+                    if (Overlapping)
+                        TypeLights[Light.type].push_back(n);
+                }
+
+                uint32_t CellIndex = GetCellIndex(TileX, TileY, Slice);
+                for (uint32_t Type = 0; Type < kLightTypeCount; ++Type)
+                {
+                    m_CellCounts[CellIndex * kLightTypeCount + Type] = (uint32_t)TypeLights[Type].size();
+                    m_RowLights[TileY].insert(m_RowLights[TileY].end(), TypeLights[Type].begin(), TypeLights[Type].end());
+                }
+            }
+        }
+    }
+
+    FinishGrid();
+}
+
+bool LightBinner::WriteGpuLightGrid( void* LightGrid, size_t LightGridSize, void* BitMask, size_t BitMaskSize ) const
+{
+    const size_t TileSize = 4 + MaxLights * 4;
+    const uint32_t TileCount = m_TileCountX * m_TileCountY;
+
+    if (m_Desc.DepthSliceCount > 0 || m_LightCount > MaxLights ||
+        LightGridSize < TileCount * TileSize || BitMaskSize < TileCount * 16)
+        return false;
+
+    for (uint32_t TileIndex = 0; TileIndex < TileCount; ++TileIndex)
+    {
+        uint32_t Counts[kLightTypeCount];
+        const uint32_t* TileLights = GetCellLights(TileIndex, Counts);
+        uint32_t LightCount = Counts[0] + Counts[1] + Counts[2];
+
+        uint32_t* Dest = (uint32_t*)((uint8_t*)LightGrid + TileIndex * TileSize);
+        Dest[0] = (Counts[0] & 0xff) | (Counts[1] & 0xff) << 8 | (Counts[2] & 0xff) << 16;
+        std::memcpy(Dest + 1, TileLights, LightCount * sizeof(uint32_t));
+
+        uint32_t* Mask = (uint32_t*)BitMask + TileIndex * 4;
+        Mask[0] = Mask[1] = Mask[2] = Mask[3] = 0;
+        for (uint32_t i = 0; i < LightCount; ++i)
+            Mask[TileLights[i] / 32] |= 1u << (TileLights[i] % 32);
+    }
+
+    return true;
+}
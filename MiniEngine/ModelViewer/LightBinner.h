@@ -0,0 +1,150 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author(s):  Alex Nankervis
+//             James Stanard
+//
+// A CPU version of FillLightGridCS.  It finds the lights whose bounding spheres overlap the
+// frustum of each screen tile, using the same tile planes as the compute shader, and can also
+// split each tile into depth slices to build a clustered light grid.
+//
+// BinLights() tests four lights at a time with SSE and spreads the tile rows over worker
+// threads.  BinLightsReference() tests every light against every cell one plane at a time, and
+// gives exactly the same output:  both do the same float operations in the same order.
+//
+// The lights of each cell are listed sphere lights first, then cone lights, then shadowed cone
+// lights, in increasing light index within each type.  The compute shader lists each type in
+// whatever order its threads reach it, so its lists match these once sorted.
+//
+
+#pragma once
+
+#include "ForwardPlusLighting.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Lighting
+{
+    struct LightGridDesc
+    {
+        float ViewProjMatrix[16];       // As stored in a Math::Matrix4, one column after another
+        uint32_t ViewportWidth;
+        uint32_t ViewportHeight;
+        uint32_t TileDim;               // Tile width and height in pixels
+        float NearClip;
+        float FarClip;
+
+        // 0 bins screen tiles over their whole depth range, as FillLightGridCS does.  Otherwise
+        // each tile is split into this many slices, spaced exponentially between the clip planes.
+        uint32_t DepthSliceCount;
+
+        // Optional when DepthSliceCount is 0:  the minimum and maximum linear depth (view depth
+        // divided by FarClip) of each tile, row by row, as FillLightGridCS reads from the linear
+        // depth buffer.  Tiles without it cover the whole depth range.
+        const float* TileDepthBounds;
+    };
+
+    class LightBinner
+    {
+    public:
+        enum { kLightTypeCount = 3 };
+
+        // A ThreadCount of 0 uses one thread per hardware thread.
+        LightBinner( uint32_t ThreadCount = 0 );
+
+        // Bins the lights into the cells of the grid.  Lights with a type other than 0 (sphere),
+        // 1 (cone) or 2 (shadowed cone) are not listed.
+        void BinLights( const LightGridDesc& Desc, const LightData* Lights, uint32_t LightCount );
+        void BinLightsReference( const LightGridDesc& Desc, const LightData* Lights, uint32_t LightCount );
+
+        uint32_t GetTileCountX( void ) const { return m_TileCountX; }
+        uint32_t GetTileCountY( void ) const { return m_TileCountY; }
+        uint32_t GetSliceCount( void ) const { return m_SliceCount; }
+        uint32_t GetCellCount( void ) const { return m_TileCountX * m_TileCountY * m_SliceCount; }
+        // The cells are stored tile by tile, with the slices of a tile next to each other, so that
+        // the cell index of a grid without depth slices is the tile index of FillLightGridCS.
+        uint32_t GetCellIndex( uint32_t TileX, uint32_t TileY, uint32_t Slice = 0 ) const
+        {
+            return (TileY * m_TileCountX + TileX) * m_SliceCount + Slice;
+        }
+
+        // The depth slice that a view depth falls in, for a grid binned with depth slices.
+        uint32_t GetDepthSlice( float ViewDepth ) const;
+
+        // The lights of a cell; Counts receives the number of each type.
+        const uint32_t* GetCellLights( uint32_t CellIndex, uint32_t Counts[kLightTypeCount] ) const;
+        uint32_t GetCellLightCount( uint32_t CellIndex ) const { return m_CellOffsets[CellIndex + 1] - m_CellOffsets[CellIndex]; }
+        size_t GetTotalLightCount( void ) const { return m_LightIndices.size(); }
+
+        // Writes the grid in the layout of m_LightGrid and m_LightGridBitMask.  Each tile takes
+        // 4 + MaxLights * 4 bytes of LightGrid and 16 bytes of BitMask.  This fails for depth
+        // sliced grids and for more than MaxLights lights, which that layout can't hold.
+        bool WriteGpuLightGrid( void* LightGrid, size_t LightGridSize, void* BitMask, size_t BitMaskSize ) const;
+
+    private:
+        struct Plane
+        {
+            float x, y, z, w;
+        };
+
+        // The lights left after culling against a tile row, and then against a tile, one array
+        // per component, with their positions in the sorted light arrays.
+        struct LightList
+        {
+            void Resize( uint32_t Capacity );
+            void Append( const LightList& Source, const uint32_t* Visible, uint32_t VisibleCount );
+
+            std::vector<float> PosX;
+            std::vector<float> PosY;
+            std::vector<float> PosZ;
+            std::vector<float> Radius;
+            std::vector<uint32_t> SortedPos;
+            uint32_t Count;
+        };
+
+        struct RowScratch
+        {
+            LightList RowLights;
+            LightList TileLights;
+            std::vector<uint32_t> Visible;
+        };
+
+        void BeginGrid( const LightGridDesc& Desc, uint32_t LightCount );
+        void FinishGrid( void );
+        void ComputeTilePlanes( uint32_t TileX, uint32_t TileY, Plane Planes[4] ) const;
+        void ComputeDepthPlanes( uint32_t TileIndex, uint32_t Slice, Plane Planes[2] ) const;
+        void SortLights( const LightData* Lights, uint32_t LightCount );
+        void BinTileRow( uint32_t TileY, RowScratch& Scratch );
+        void AddCellLights( uint32_t CellIndex, const uint32_t* SortedPos, const uint32_t* Visible, uint32_t VisibleCount );
+
+        uint32_t m_ThreadCount;
+
+        LightGridDesc m_Desc;
+        uint32_t m_TileCountX;
+        uint32_t m_TileCountY;
+        uint32_t m_SliceCount;
+        uint32_t m_LightCount;
+
+        // The lights sorted by type then index.  m_SortedIndex maps them back to light indices,
+        // and m_TypeEnd holds the end of each type's run.
+        LightList m_SortedLights;
+        std::vector<uint32_t> m_SortedIndex;
+        uint32_t m_TypeEnd[kLightTypeCount];
+
+        // Each tile row's lights, cell by cell, before they are gathered into m_LightIndices.
+        std::vector<std::vector<uint32_t>> m_RowLights;
+
+        std::vector<uint32_t> m_CellOffsets;
+        std::vector<uint32_t> m_CellCounts;     // kLightTypeCount per cell
+        std::vector<uint32_t> m_LightIndices;
+    };
+}
@@ -70,7 +70,7 @@ private:
     void RenderLightShadows(GraphicsContext& gfxContext);
 
     enum eObjectFilter { kOpaque = 0x1, kCutout = 0x2, kTransparent = 0x4, kAll = 0xF, kNone = 0x0 };
-    void RenderObjects( GraphicsContext& Context, const Matrix4& ViewProjMat, eObjectFilter Filter = kAll );
+    void RenderObjects( GraphicsContext& Context, const Matrix4& ViewProjMat, float ViewHeight, eObjectFilter Filter = kAll );
     void CreateParticleEffects();
     Camera m_Camera;
     std::auto_ptr<CameraController> m_CameraController;
@@ -113,6 +113,8 @@ NumVar ShadowDimX("Application/Lighting/Shadow Dim X", 5000, 1000, 10000, 100 );
 NumVar ShadowDimY("Application/Lighting/Shadow Dim Y", 3000, 1000, 10000, 100 );
 NumVar ShadowDimZ("Application/Lighting/Shadow Dim Z", 3000, 1000, 10000, 100 );
 
+BoolVar EnableLODs("Application/Model/Enable LODs", true);
+
 BoolVar ShowWaveTileCounts("Application/Forward+/Show Wave Tile Counts", false);
 #ifdef _WAVE_OP
 BoolVar EnableWaveOps("Application/Forward+/Enable Wave Ops", true);
@@ -303,7 +305,7 @@ void ModelViewer::Update( float deltaT )
     m_MainScissor.bottom = (LONG)g_SceneColorBuffer.GetHeight();
 }
 
-void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& ViewProjMat, eObjectFilter Filter )
+void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& ViewProjMat, float ViewHeight, eObjectFilter Filter )
 {
     struct VSConstants
     {
@@ -321,6 +323,9 @@ void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& Vie
 
     uint32_t VertexStride = m_Model.m_VertexStride;
 
+    // A bounding sphere of radius r at clip w is about r * |clip y row| / w * ViewHeight pixels across
+    const float ClipScaleY = Length(Vector3(Transpose(ViewProjMat).GetY()));
+
     for (uint32_t meshIndex = 0; meshIndex < m_Model.m_Header.meshCount; meshIndex++)
     {
         const Model::Mesh& mesh = m_Model.m_pMesh[meshIndex];
@@ -329,6 +334,17 @@ void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& Vie
         uint32_t startIndex = mesh.indexDataByteOffset / sizeof(uint16_t);
         uint32_t baseVertex = mesh.vertexDataByteOffset / VertexStride;
 
+        if (EnableLODs)
+        {
+            Vector3 Center = (mesh.boundingBox.min + mesh.boundingBox.max) * 0.5f;
+            float Radius = Length(mesh.boundingBox.max - mesh.boundingBox.min) * 0.5f;
+            float W = (ViewProjMat * Center).GetW();
+
+            // Meshes centered on or behind the eye plane keep their full detail
+            float ScreenSize = W > 0.0f ? Radius * ClipScaleY / W * ViewHeight : FLT_MAX;
+            m_Model.GetMeshLOD(meshIndex, ScreenSize, indexCount, startIndex);
+        }
+
         if (mesh.materialIndex != materialIdx)
         {
             if ( m_pMaterialIsCutout[mesh.materialIndex] && !(Filter & kCutout) ||
@@ -358,18 +374,21 @@ void ModelViewer::RenderLightShadows(GraphicsContext& gfxContext)
     m_LightShadowTempBuffer.BeginRendering(gfxContext);
     {
         gfxContext.SetPipelineState(m_ShadowPSO);
-        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kOpaque);
+        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], (float)m_LightShadowTempBuffer.GetHeight(), kOpaque);
         gfxContext.SetPipelineState(m_CutoutShadowPSO);
-        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kCutout);
+        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], (float)m_LightShadowTempBuffer.GetHeight(), kCutout);
     }
     m_LightShadowTempBuffer.EndRendering(gfxContext);
 
     gfxContext.TransitionResource(m_LightShadowTempBuffer, D3D12_RESOURCE_STATE_GENERIC_READ);
-    gfxContext.TransitionResource(m_LightShadowArray, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    // Only the slice being copied to leaves the shader resource state, so the rest of the array can stay put
+    gfxContext.TransitionSubresource(m_LightShadowArray, LightIndex, D3D12_RESOURCE_STATE_COPY_DEST);
 
     gfxContext.CopySubresource(m_LightShadowArray, LightIndex, m_LightShadowTempBuffer, 0);
 
-    gfxContext.TransitionResource(m_LightShadowArray, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    // The slice isn't read until the color pass, so the transition back can overlap everything in between
+    gfxContext.BeginSubresourceTransition(m_LightShadowArray, LightIndex, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 
     ++LightIndex;
 }
@@ -453,13 +472,13 @@ void ModelViewer::RenderScene( void )
 #endif
             gfxContext.SetDepthStencilTarget(g_SceneDepthBuffer.GetDSV());
             gfxContext.SetViewportAndScissor(m_MainViewport, m_MainScissor);
-            RenderObjects(gfxContext, m_ViewProjMatrix, kOpaque );
+            RenderObjects(gfxContext, m_ViewProjMatrix, m_MainViewport.Height, kOpaque );
         }
 
         {
             ScopedTimer _prof(L"Cutout", gfxContext);
             gfxContext.SetPipelineState(m_CutoutDepthPSO);
-            RenderObjects(gfxContext, m_ViewProjMatrix, kCutout );
+            RenderObjects(gfxContext, m_ViewProjMatrix, m_MainViewport.Height, kCutout );
         }
     }
 
@@ -484,9 +503,9 @@ void ModelViewer::RenderScene( void )
 
             g_ShadowBuffer.BeginRendering(gfxContext);
             gfxContext.SetPipelineState(m_ShadowPSO);
-            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kOpaque);
+            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), (float)g_ShadowBuffer.GetHeight(), kOpaque);
             gfxContext.SetPipelineState(m_CutoutShadowPSO);
-            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kCutout);
+            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), (float)g_ShadowBuffer.GetHeight(), kCutout);
             g_ShadowBuffer.EndRendering(gfxContext);
         }
 
@@ -503,6 +522,7 @@ void ModelViewer::RenderScene( void )
             ScopedTimer _prof(L"Render Color", gfxContext);
 
             gfxContext.TransitionResource(g_SSAOFullScreen, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+            gfxContext.TransitionResource(Lighting::m_LightShadowArray, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 
             gfxContext.SetDynamicDescriptors(3, 0, _countof(m_ExtraTextures), m_ExtraTextures);
             gfxContext.SetDynamicConstantBufferView(1, sizeof(psConstants), &psConstants);
@@ -515,12 +535,12 @@ void ModelViewer::RenderScene( void )
             gfxContext.SetRenderTarget(g_SceneColorBuffer.GetRTV(), g_SceneDepthBuffer.GetDSV_DepthReadOnly());
             gfxContext.SetViewportAndScissor(m_MainViewport, m_MainScissor);
 
-            RenderObjects( gfxContext, m_ViewProjMatrix, kOpaque );
+            RenderObjects( gfxContext, m_ViewProjMatrix, m_MainViewport.Height, kOpaque );
 
             if (!ShowWaveTileCounts)
             {
                 gfxContext.SetPipelineState(m_CutoutModelPSO);
-                RenderObjects( gfxContext, m_ViewProjMatrix, kCutout );
+                RenderObjects( gfxContext, m_ViewProjMatrix, m_MainViewport.Height, kCutout );
             }
         }
 
@@ -0,0 +1,1389 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "BlockCompress.h"
+
+#include <emmintrin.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // The block with each channel in its own row, so that four texels fill an SSE register
+    struct BlockPixels
+    {
+        float Channel[4][16];
+    };
+
+    // Palette entries are decoded the way the hardware decodes them, so errors are exact integers.  The most
+    // a pixel can be off is 4 * 255^2, which keeps a block's total well inside a float's 24-bit mantissa and
+    // makes the SSE2 and scalar sums agree exactly.
+    struct Palette
+    {
+        float Color[16][4];
+        uint32_t NumEntries;
+    };
+
+    template <uint32_t NumChannels>
+    float FindIndicesScalar( const BlockPixels& Px, const Palette& Pal, uint32_t Mask, uint8_t Indices[16] )
+    {
+        float TotalError = 0.0f;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if ((Mask & (1 << i)) == 0)
+                continue;
+
+            float BestError = FLT_MAX;
+            uint32_t BestIndex = 0;
+            for (uint32_t e = 0; e < Pal.NumEntries; ++e)
+            {
+                float Error = 0.0f;
+                for (uint32_t c = 0; c < NumChannels; ++c)
+                {
+                    float d = Px.Channel[c][i] - Pal.Color[e][c];
+                    Error += d * d;
+                }
+                if (Error < BestError)
+                {
+                    BestError = Error;
+                    BestIndex = e;
+                }
+            }
+            Indices[i] = (uint8_t)BestIndex;
+            TotalError += BestError;
+        }
+        return TotalError;
+    }
+
+    template <uint32_t NumChannels>
+    float FindIndicesSSE2( const BlockPixels& Px, const Palette& Pal, uint32_t Mask, uint8_t Indices[16] )
+    {
+        __m128 TotalError = _mm_setzero_ps();
+        for (uint32_t i = 0; i < 16; i += 4)
+        {
+            const uint32_t Lanes = (Mask >> i) & 0xF;
+            if (Lanes == 0)
+                continue;
+
+            __m128 Texel[NumChannels];
+            for (uint32_t c = 0; c < NumChannels; ++c)
+                Texel[c] = _mm_loadu_ps(&Px.Channel[c][i]);
+
+            __m128 BestError = _mm_set1_ps(FLT_MAX);
+            __m128i BestIndex = _mm_setzero_si128();
+            for (uint32_t e = 0; e < Pal.NumEntries; ++e)
+            {
+                __m128 d = _mm_sub_ps(Texel[0], _mm_set1_ps(Pal.Color[e][0]));
+                __m128 Error = _mm_mul_ps(d, d);
+                for (uint32_t c = 1; c < NumChannels; ++c)
+                {
+                    d = _mm_sub_ps(Texel[c], _mm_set1_ps(Pal.Color[e][c]));
+                    Error = _mm_add_ps(Error, _mm_mul_ps(d, d));
+                }
+                __m128i Closer = _mm_castps_si128(_mm_cmplt_ps(Error, BestError));
+                BestError = _mm_min_ps(Error, BestError);
+                BestIndex = _mm_or_si128(_mm_andnot_si128(Closer, BestIndex),
+                    _mm_and_si128(Closer, _mm_set1_epi32((int)e)));
+            }
+
+            const __m128i LaneBits = _mm_set_epi32(8, 4, 2, 1);
+            __m128 LaneMask = _mm_castsi128_ps(_mm_cmpeq_epi32(
+                _mm_and_si128(_mm_set1_epi32((int)Lanes), LaneBits), LaneBits));
+            TotalError = _mm_add_ps(TotalError, _mm_and_ps(BestError, LaneMask));
+
+            alignas(16) int32_t Index[4];
+            _mm_store_si128((__m128i*)Index, BestIndex);
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                if (Lanes & (1 << j))
+                    Indices[i + j] = (uint8_t)Index[j];
+            }
+        }
+
+        alignas(16) float Sum[4];
+        _mm_store_ps(Sum, TotalError);
+        return (Sum[0] + Sum[1]) + (Sum[2] + Sum[3]);
+    }
+
+    bool s_UseSSE2 = true;
+
+    // Assigns each texel in Mask the closest palette entry, comparing the first NumChannels channels, and
+    // returns the summed squared error of those texels.  Indices of texels outside Mask are left alone.
+    float FindIndices( const BlockPixels& Px, const Palette& Pal, uint32_t NumChannels, uint32_t Mask,
+        uint8_t Indices[16] )
+    {
+        if (s_UseSSE2)
+        {
+            switch (NumChannels)
+            {
+            case 1: return FindIndicesSSE2<1>(Px, Pal, Mask, Indices);
+            case 3: return FindIndicesSSE2<3>(Px, Pal, Mask, Indices);
+            default: return FindIndicesSSE2<4>(Px, Pal, Mask, Indices);
+            }
+        }
+        else
+        {
+            switch (NumChannels)
+            {
+            case 1: return FindIndicesScalar<1>(Px, Pal, Mask, Indices);
+            case 3: return FindIndicesScalar<3>(Px, Pal, Mask, Indices);
+            default: return FindIndicesScalar<4>(Px, Pal, Mask, Indices);
+            }
+        }
+    }
+
+    uint32_t CountBits( uint32_t Mask )
+    {
+        uint32_t Count = 0;
+        for (; Mask != 0; Mask &= Mask - 1)
+            ++Count;
+        return Count;
+    }
+
+    float Clamp255( float Value )
+    {
+        return Value < 0.0f ? 0.0f : (Value > 255.0f ? 255.0f : Value);
+    }
+
+    // Finds the mean and the direction of greatest variance of the texels in Mask.  Returns the variance
+    // left over after projecting onto that axis, summed over the texels, which is the least error any pair
+    // of endpoints can reach before quantization.
+    float FindPrincipalAxis( const BlockPixels& Px, uint32_t Mask, uint32_t NumChannels, float Mean[4],
+        float Axis[4] )
+    {
+        const float Count = (float)CountBits(Mask);
+
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            Mean[c] = 0.0f;
+            Axis[c] = 0.0f;
+        }
+
+        if (Count == 0.0f)
+            return 0.0f;
+
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if (Mask & (1 << i))
+            {
+                for (uint32_t c = 0; c < NumChannels; ++c)
+                    Mean[c] += Px.Channel[c][i];
+            }
+        }
+        for (uint32_t c = 0; c < NumChannels; ++c)
+            Mean[c] /= Count;
+
+        float Covariance[4][4] = {};
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if ((Mask & (1 << i)) == 0)
+                continue;
+
+            float d[4];
+            for (uint32_t c = 0; c < NumChannels; ++c)
+                d[c] = Px.Channel[c][i] - Mean[c];
+            for (uint32_t r = 0; r < NumChannels; ++r)
+                for (uint32_t c = r; c < NumChannels; ++c)
+                    Covariance[r][c] += d[r] * d[c];
+        }
+
+        float Trace = 0.0f;
+        uint32_t Widest = 0;
+        for (uint32_t r = 0; r < NumChannels; ++r)
+        {
+            for (uint32_t c = 0; c < r; ++c)
+                Covariance[r][c] = Covariance[c][r];
+            Trace += Covariance[r][r];
+            if (Covariance[r][r] > Covariance[Widest][Widest])
+                Widest = r;
+        }
+
+        if (Trace < 1e-3f)
+            return 0.0f;
+
+        // Power iteration, starting from the row of the widest channel so it can't start orthogonal to the axis
+        float v[4] = {};
+        for (uint32_t c = 0; c < NumChannels; ++c)
+            v[c] = Covariance[Widest][c];
+
+        for (uint32_t Iteration = 0; Iteration < 8; ++Iteration)
+        {
+            float w[4] = {};
+            float Largest = 0.0f;
+            for (uint32_t r = 0; r < NumChannels; ++r)
+            {
+                for (uint32_t c = 0; c < NumChannels; ++c)
+                    w[r] += Covariance[r][c] * v[c];
+                Largest = std::max(Largest, std::fabs(w[r]));
+            }
+            if (Largest == 0.0f)
+                return Trace;
+            for (uint32_t c = 0; c < NumChannels; ++c)
+                v[c] = w[c] / Largest;
+        }
+
+        float Length = 0.0f;
+        for (uint32_t c = 0; c < NumChannels; ++c)
+            Length += v[c] * v[c];
+        Length = std::sqrt(Length);
+
+        float Variance = 0.0f;
+        for (uint32_t r = 0; r < NumChannels; ++r)
+        {
+            Axis[r] = v[r] / Length;
+            for (uint32_t c = 0; c < NumChannels; ++c)
+                Variance += v[r] * Covariance[r][c] * v[c];
+        }
+        Variance /= Length * Length;
+
+        return std::max(Trace - Variance, 0.0f);
+    }
+
+    // Endpoints at the extreme projections of the texels onto the principal axis, pulled in by Inset of the
+    // range at each end
+    void FitEndpoints( const BlockPixels& Px, uint32_t Mask, uint32_t NumChannels, float Inset, float E0[4],
+        float E1[4] )
+    {
+        float Mean[4], Axis[4];
+        FindPrincipalAxis(Px, Mask, NumChannels, Mean, Axis);
+
+        float MinT = FLT_MAX, MaxT = -FLT_MAX;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if ((Mask & (1 << i)) == 0)
+                continue;
+
+            float t = 0.0f;
+            for (uint32_t c = 0; c < NumChannels; ++c)
+                t += (Px.Channel[c][i] - Mean[c]) * Axis[c];
+            MinT = std::min(MinT, t);
+            MaxT = std::max(MaxT, t);
+        }
+        if (MinT > MaxT)
+            MinT = MaxT = 0.0f;
+
+        const float Pull = (MaxT - MinT) * Inset;
+        MinT += Pull;
+        MaxT -= Pull;
+
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            E0[c] = c < NumChannels ? Clamp255(Mean[c] + Axis[c] * MinT) : 0.0f;
+            E1[c] = c < NumChannels ? Clamp255(Mean[c] + Axis[c] * MaxT) : 0.0f;
+        }
+    }
+
+    // Solves for the endpoints that best reproduce the texels in Mask given their indices, where index i decodes
+    // to (1 - Weights[i]) * E0 + Weights[i] * E1.  Texels with an index of NumWeights or more sit on a fixed
+    // palette entry and are left out.  Returns false when the indices don't pin down both endpoints.
+    bool RefineEndpoints( const BlockPixels& Px, uint32_t Mask, uint32_t NumChannels, const uint8_t Indices[16],
+        const float* Weights, uint32_t NumWeights, float E0[4], float E1[4] )
+    {
+        float AA = 0.0f, AB = 0.0f, BB = 0.0f;
+        float AX[4] = {}, BX[4] = {};
+
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if ((Mask & (1 << i)) == 0 || Indices[i] >= NumWeights)
+                continue;
+
+            const float b = Weights[Indices[i]];
+            const float a = 1.0f - b;
+            AA += a * a;
+            AB += a * b;
+            BB += b * b;
+            for (uint32_t c = 0; c < NumChannels; ++c)
+            {
+                AX[c] += a * Px.Channel[c][i];
+                BX[c] += b * Px.Channel[c][i];
+            }
+        }
+
+        const float Determinant = AA * BB - AB * AB;
+        if (std::fabs(Determinant) < 1e-4f)
+            return false;
+
+        for (uint32_t c = 0; c < NumChannels; ++c)
+        {
+            E0[c] = Clamp255((BB * AX[c] - AB * BX[c]) / Determinant);
+            E1[c] = Clamp255((AA * BX[c] - AB * AX[c]) / Determinant);
+        }
+        return true;
+    }
+
+    // Widens a quantized value to 8 bits by repeating its high bits, as the hardware does
+    uint32_t Expand( uint32_t Value, uint32_t Bits )
+    {
+        return Bits >= 8 ? Value : (Value << (8 - Bits)) | (Value >> (2 * Bits - 8));
+    }
+
+    // The Bits-bit value (below a fixed low bit PBit, when there is one) whose expansion is closest to Value
+    uint32_t Quantize( float Value, uint32_t Bits, int PBit = -1 )
+    {
+        const uint32_t TotalBits = PBit < 0 ? Bits : Bits + 1;
+        const int MaxValue = (1 << Bits) - 1;
+        const float Scaled = Value * (float)((1 << TotalBits) - 1) / 255.0f;
+        int Guess = PBit < 0 ? (int)(Scaled + 0.5f) : (int)std::floor((Scaled - PBit) * 0.5f + 0.5f);
+
+        uint32_t Best = 0;
+        float BestError = FLT_MAX;
+        for (int q = Guess - 1; q <= Guess + 1; ++q)
+        {
+            if (q < 0 || q > MaxValue)
+                continue;
+
+            const uint32_t Full = PBit < 0 ? (uint32_t)q : ((uint32_t)q << 1) | (uint32_t)PBit;
+            const float Error = std::fabs((float)Expand(Full, TotalBits) - Value);
+            if (Error < BestError)
+            {
+                BestError = Error;
+                Best = (uint32_t)q;
+            }
+        }
+        return Best;
+    }
+
+    void LoadBlock( const uint8_t Pixels[64], BlockPixels& Px )
+    {
+        for (uint32_t i = 0; i < 16; ++i)
+            for (uint32_t c = 0; c < 4; ++c)
+                Px.Channel[c][i] = (float)Pixels[i * 4 + c];
+    }
+
+    // A little-endian bit stream over one 128-bit block, as BC7 lays its fields out
+    class BitWriter
+    {
+    public:
+        BitWriter( uint8_t* Block ) : m_Block(Block), m_Position(0)
+        {
+            memset(Block, 0, 16);
+        }
+
+        void Write( uint32_t Value, uint32_t NumBits )
+        {
+            for (uint32_t i = 0; i < NumBits; ++i, ++m_Position)
+                m_Block[m_Position >> 3] |= (uint8_t)(((Value >> i) & 1) << (m_Position & 7));
+        }
+
+    private:
+        uint8_t* m_Block;
+        uint32_t m_Position;
+    };
+
+    class BitReader
+    {
+    public:
+        BitReader( const uint8_t* Block ) : m_Block(Block), m_Position(0) {}
+
+        uint32_t Read( uint32_t NumBits )
+        {
+            uint32_t Value = 0;
+            for (uint32_t i = 0; i < NumBits; ++i, ++m_Position)
+                Value |= ((m_Block[m_Position >> 3] >> (m_Position & 7)) & 1u) << i;
+            return Value;
+        }
+
+    private:
+        const uint8_t* m_Block;
+        uint32_t m_Position;
+    };
+
+    //
+    // BC1 and the color half of BC3
+    //
+
+    void DecodeRGB565( uint32_t Color, uint32_t RGB[3] )
+    {
+        RGB[0] = Expand((Color >> 11) & 31, 5);
+        RGB[1] = Expand((Color >> 5) & 63, 6);
+        RGB[2] = Expand(Color & 31, 5);
+    }
+
+    // Four-color blocks blend the endpoints in thirds.  In BC1, a first endpoint that isn't greater than the
+    // second selects three colors, the midpoint and transparent black.  BC3 always blends in thirds.
+    void MakeBC1Palette( uint32_t C0, uint32_t C1, bool ThreeColor, Palette& Pal )
+    {
+        uint32_t P0[3], P1[3];
+        DecodeRGB565(C0, P0);
+        DecodeRGB565(C1, P1);
+
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            Pal.Color[0][c] = (float)P0[c];
+            Pal.Color[1][c] = (float)P1[c];
+            if (ThreeColor)
+            {
+                Pal.Color[2][c] = (float)((P0[c] + P1[c] + 1) / 2);
+                Pal.Color[3][c] = 0.0f;
+            }
+            else
+            {
+                Pal.Color[2][c] = (float)((2 * P0[c] + P1[c] + 1) / 3);
+                Pal.Color[3][c] = (float)((P0[c] + 2 * P1[c] + 1) / 3);
+            }
+        }
+        Pal.NumEntries = 4;
+    }
+
+    uint32_t PackRGB565( const float Color[3] )
+    {
+        return Quantize(Color[0], 5) << 11 | Quantize(Color[1], 6) << 5 | Quantize(Color[2], 5);
+    }
+
+    struct BC1Candidate
+    {
+        uint32_t C0, C1;
+        uint8_t Indices[16];
+        float Error;
+    };
+
+    const float kBC1FourColorWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    const float kBC1ThreeColorWeights[3] = { 0.0f, 1.0f, 0.5f };
+
+    // Scores a pair of endpoints in either mode.  Opaque is the set of texels that must be matched; the rest
+    // are transparent, which only BC1's three-color mode can express.  Its fourth entry is transparent black, so
+    // opaque texels never use it.
+    void TryBC1Endpoints( const BlockPixels& Px, uint32_t Opaque, bool BC3, bool ThreeColor, uint32_t C0,
+        uint32_t C1, BC1Candidate& Best )
+    {
+        if (!BC3)
+        {
+            // The order of the endpoints picks the mode
+            if (ThreeColor ? C0 > C1 : C0 < C1)
+                std::swap(C0, C1);
+            else if (!ThreeColor && C0 == C1)
+                ThreeColor = true;
+        }
+
+        Palette Pal;
+        MakeBC1Palette(C0, C1, ThreeColor && !BC3, Pal);
+        if (ThreeColor && !BC3)
+            Pal.NumEntries = 3;
+
+        BC1Candidate Candidate;
+        Candidate.C0 = C0;
+        Candidate.C1 = C1;
+        memset(Candidate.Indices, 3, sizeof(Candidate.Indices));
+        Candidate.Error = FindIndices(Px, Pal, 3, Opaque, Candidate.Indices);
+
+        if (Candidate.Error < Best.Error)
+            Best = Candidate;
+    }
+
+    void RefineBC1( const BlockPixels& Px, uint32_t Opaque, bool BC3, bool ThreeColor, uint32_t Passes,
+        BC1Candidate& Best )
+    {
+        for (uint32_t Pass = 0; Pass < Passes; ++Pass)
+        {
+            const BC1Candidate Start = Best;
+            float E0[4], E1[4];
+            if (!RefineEndpoints(Px, Opaque, 3, Start.Indices, ThreeColor ? kBC1ThreeColorWeights :
+                kBC1FourColorWeights, ThreeColor ? 3 : 4, E0, E1))
+                break;
+
+            TryBC1Endpoints(Px, Opaque, BC3, ThreeColor, PackRGB565(E0), PackRGB565(E1), Best);
+            if (Best.Error >= Start.Error)
+                break;
+        }
+    }
+
+    void EncodeBC1Color( const uint8_t Pixels[64], bool BC3, bool Quality, uint8_t* Dest )
+    {
+        BlockPixels Px;
+        LoadBlock(Pixels, Px);
+
+        uint32_t Opaque = 0xFFFF;
+        if (!BC3)
+        {
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                if (Pixels[i * 4 + 3] < 128)
+                    Opaque &= ~(1u << i);
+            }
+        }
+
+        BC1Candidate Best;
+        Best.C0 = Best.C1 = 0;
+        memset(Best.Indices, 3, sizeof(Best.Indices));
+        Best.Error = FLT_MAX;
+
+        if (Opaque == 0)
+        {
+            // Fully transparent:  three-color mode with every index on the transparent entry
+            Best.Error = 0.0f;
+        }
+        else if (Opaque != 0xFFFF)
+        {
+            float E0[4], E1[4];
+            FitEndpoints(Px, Opaque, 3, 0.0f, E0, E1);
+            TryBC1Endpoints(Px, Opaque, BC3, true, PackRGB565(E0), PackRGB565(E1), Best);
+            RefineBC1(Px, Opaque, BC3, true, Quality ? 3 : 1, Best);
+        }
+        else
+        {
+            float E0[4], E1[4];
+            FitEndpoints(Px, Opaque, 3, 1.0f / 16.0f, E0, E1);
+            TryBC1Endpoints(Px, Opaque, BC3, false, PackRGB565(E0), PackRGB565(E1), Best);
+            RefineBC1(Px, Opaque, BC3, false, Quality ? 3 : 1, Best);
+
+            if (Quality)
+            {
+                BC1Candidate FourColor = Best;
+                FitEndpoints(Px, Opaque, 3, 0.0f, E0, E1);
+                TryBC1Endpoints(Px, Opaque, BC3, false, PackRGB565(E0), PackRGB565(E1), FourColor);
+                RefineBC1(Px, Opaque, BC3, false, 3, FourColor);
+                if (FourColor.Error < Best.Error)
+                    Best = FourColor;
+
+                // The three-color mode's midpoint is exact for some colors that thirds can't reach
+                if (!BC3)
+                {
+                    BC1Candidate ThreeColor = Best;
+                    TryBC1Endpoints(Px, Opaque, BC3, true, PackRGB565(E0), PackRGB565(E1), ThreeColor);
+                    RefineBC1(Px, Opaque, BC3, true, 3, ThreeColor);
+                    if (ThreeColor.Error < Best.Error)
+                        Best = ThreeColor;
+                }
+            }
+        }
+
+        Dest[0] = (uint8_t)Best.C0;
+        Dest[1] = (uint8_t)(Best.C0 >> 8);
+        Dest[2] = (uint8_t)Best.C1;
+        Dest[3] = (uint8_t)(Best.C1 >> 8);
+
+        uint32_t Indices = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+            Indices |= (uint32_t)Best.Indices[i] << (i * 2);
+        memcpy(Dest + 4, &Indices, 4);
+    }
+
+    void DecodeBC1Color( const uint8_t* Block, bool BC3, uint8_t Pixels[64] )
+    {
+        const uint32_t C0 = Block[0] | Block[1] << 8;
+        const uint32_t C1 = Block[2] | Block[3] << 8;
+        const bool ThreeColor = !BC3 && C0 <= C1;
+
+        Palette Pal;
+        MakeBC1Palette(C0, C1, ThreeColor, Pal);
+
+        uint32_t Indices;
+        memcpy(&Indices, Block + 4, 4);
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            const uint32_t Index = (Indices >> (i * 2)) & 3;
+            for (uint32_t c = 0; c < 3; ++c)
+                Pixels[i * 4 + c] = (uint8_t)Pal.Color[Index][c];
+            Pixels[i * 4 + 3] = ThreeColor && Index == 3 ? 0 : 255;
+        }
+    }
+
+    //
+    // BC4, which is also BC3's alpha and each half of BC5
+    //
+
+    // A first endpoint greater than the second blends them in sevenths.  Otherwise they blend in fifths, with
+    // 0 and 255 as the last two entries.
+    void MakeBC4Palette( uint32_t A0, uint32_t A1, Palette& Pal )
+    {
+        Pal.Color[0][0] = (float)A0;
+        Pal.Color[1][0] = (float)A1;
+        if (A0 > A1)
+        {
+            for (uint32_t i = 2; i < 8; ++i)
+                Pal.Color[i][0] = (float)(((8 - i) * A0 + (i - 1) * A1 + 3) / 7);
+        }
+        else
+        {
+            for (uint32_t i = 2; i < 6; ++i)
+                Pal.Color[i][0] = (float)(((6 - i) * A0 + (i - 1) * A1 + 2) / 5);
+            Pal.Color[6][0] = 0.0f;
+            Pal.Color[7][0] = 255.0f;
+        }
+        Pal.NumEntries = 8;
+    }
+
+    struct BC4Candidate
+    {
+        uint32_t A0, A1;
+        uint8_t Indices[16];
+        float Error;
+    };
+
+    const float kBC4EightValueWeights[8] = { 0.0f, 1.0f, 1.0f / 7, 2.0f / 7, 3.0f / 7, 4.0f / 7, 5.0f / 7, 6.0f / 7 };
+    const float kBC4SixValueWeights[6] = { 0.0f, 1.0f, 1.0f / 5, 2.0f / 5, 3.0f / 5, 4.0f / 5 };
+
+    void TryBC4Endpoints( const BlockPixels& Px, bool SixValue, int A0, int A1, BC4Candidate& Best )
+    {
+        if (A0 < 0 || A0 > 255 || A1 < 0 || A1 > 255)
+            return;
+
+        if (SixValue ? A0 > A1 : A0 < A1)
+            std::swap(A0, A1);
+        else if (!SixValue && A0 == A1)
+            return;
+
+        Palette Pal;
+        MakeBC4Palette((uint32_t)A0, (uint32_t)A1, Pal);
+
+        BC4Candidate Candidate;
+        Candidate.A0 = (uint32_t)A0;
+        Candidate.A1 = (uint32_t)A1;
+        Candidate.Error = FindIndices(Px, Pal, 1, 0xFFFF, Candidate.Indices);
+
+        if (Candidate.Error < Best.Error)
+            Best = Candidate;
+    }
+
+    void RefineBC4( const BlockPixels& Px, bool SixValue, uint32_t Passes, BC4Candidate& Best )
+    {
+        for (uint32_t Pass = 0; Pass < Passes; ++Pass)
+        {
+            const BC4Candidate Start = Best;
+            float E0[4], E1[4];
+            if (!RefineEndpoints(Px, 0xFFFF, 1, Start.Indices, SixValue ? kBC4SixValueWeights :
+                kBC4EightValueWeights, SixValue ? 6 : 8, E0, E1))
+                break;
+
+            TryBC4Endpoints(Px, SixValue, (int)(E0[0] + 0.5f), (int)(E1[0] + 0.5f), Best);
+            if (Best.Error >= Start.Error)
+                break;
+        }
+    }
+
+    void EncodeBC4( const uint8_t* Pixels, uint32_t Channel, bool Quality, uint8_t* Dest )
+    {
+        BlockPixels Px;
+        uint32_t Lo = 255, Hi = 0, InnerLo = 255, InnerHi = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            const uint32_t Value = Pixels[i * 4 + Channel];
+            Px.Channel[0][i] = (float)Value;
+            Lo = std::min(Lo, Value);
+            Hi = std::max(Hi, Value);
+            if (Value != 0 && Value != 255)
+            {
+                InnerLo = std::min(InnerLo, Value);
+                InnerHi = std::max(InnerHi, Value);
+            }
+        }
+
+        BC4Candidate Best;
+        Best.Error = FLT_MAX;
+
+        if (Lo == Hi)
+        {
+            Best.A0 = Best.A1 = Lo;
+            memset(Best.Indices, 0, sizeof(Best.Indices));
+        }
+        else
+        {
+            TryBC4Endpoints(Px, false, (int)Hi, (int)Lo, Best);
+            RefineBC4(Px, false, Quality ? 3 : 1, Best);
+
+            if (Quality)
+            {
+
+                // Six values with exact 0 and 255 suit blocks that mix the extremes with a narrower range
+                BC4Candidate SixValue;
+                SixValue.Error = FLT_MAX;
+                if (InnerLo > InnerHi)
+                    InnerLo = InnerHi = Lo;
+                TryBC4Endpoints(Px, true, (int)InnerLo, (int)InnerHi, SixValue);
+                RefineBC4(Px, true, 3, SixValue);
+
+                if (SixValue.Error < Best.Error)
+                    Best = SixValue;
+
+                // Finish with a small search around whichever won, keeping its mode
+                const bool IsSixValue = Best.A0 <= Best.A1;
+                const int A0 = (int)Best.A0, A1 = (int)Best.A1;
+                for (int d0 = -1; d0 <= 1 && Best.Error > 0.0f; ++d0)
+                    for (int d1 = -1; d1 <= 1; ++d1)
+                        TryBC4Endpoints(Px, IsSixValue, A0 + d0, A1 + d1, Best);
+            }
+        }
+
+        Dest[0] = (uint8_t)Best.A0;
+        Dest[1] = (uint8_t)Best.A1;
+
+        uint64_t Indices = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+            Indices |= (uint64_t)Best.Indices[i] << (i * 3);
+        for (uint32_t i = 0; i < 6; ++i)
+            Dest[2 + i] = (uint8_t)(Indices >> (i * 8));
+    }
+
+    void DecodeBC4( const uint8_t* Block, uint32_t Channel, uint8_t Pixels[64] )
+    {
+        Palette Pal;
+        MakeBC4Palette(Block[0], Block[1], Pal);
+
+        uint64_t Indices = 0;
+        for (uint32_t i = 0; i < 6; ++i)
+            Indices |= (uint64_t)Block[2 + i] << (i * 8);
+        for (uint32_t i = 0; i < 16; ++i)
+            Pixels[i * 4 + Channel] = (uint8_t)Pal.Color[(Indices >> (i * 3)) & 7][0];
+    }
+
+    //
+    // BC7 modes 1 and 6
+    //
+
+    const uint32_t kBC7Weights2[4] = { 0, 21, 43, 64 };
+    const uint32_t kBC7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const uint32_t kBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // Bit i is set when texel i belongs to the second subset
+    const uint16_t kBC7Partitions2[64] =
+    {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+        0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+        0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+        0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+        0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+    };
+
+    // The texel of the second subset whose index drops its top bit
+    const uint8_t kBC7Anchors2[64] =
+    {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+    };
+
+    uint32_t Interpolate( uint32_t E0, uint32_t E1, uint32_t Weight )
+    {
+        return ((64 - Weight) * E0 + Weight * E1 + 32) >> 6;
+    }
+
+    // One subset's endpoints as stored:  ColorBits per channel, below a p-bit in modes that have them
+    struct BC7Endpoints
+    {
+        uint32_t Value[2][4];
+        uint32_t PBit[2];
+    };
+
+    struct BC7SubsetCandidate
+    {
+        BC7Endpoints Endpoints;
+        uint8_t Indices[16];
+        float Error;
+    };
+
+    enum BC7PBits { kNoPBit, kSharedPBit, kUniquePBit };
+
+    struct BC7ModeInfo
+    {
+        uint32_t NumChannels;   // 3 leaves alpha at 255
+        uint32_t ColorBits;     // Per channel, not counting the p-bit
+        uint32_t IndexBits;
+        BC7PBits PBits;         // Shared by a subset's endpoints, or one for each
+    };
+
+    const BC7ModeInfo kBC7Mode1 = { 3, 6, 3, kSharedPBit };
+    const BC7ModeInfo kBC7Mode6 = { 4, 7, 4, kUniquePBit };
+
+    // Mode 5 codes color and alpha separately, each with its own endpoints and indices.  Alpha is fit as the
+    // first channel of a block of its own.
+    const BC7ModeInfo kBC7Mode5Color = { 3, 7, 2, kNoPBit };
+    const BC7ModeInfo kBC7Mode5Alpha = { 1, 8, 2, kNoPBit };
+
+    const uint32_t* GetBC7Weights( uint32_t IndexBits )
+    {
+        return IndexBits == 2 ? kBC7Weights2 : (IndexBits == 3 ? kBC7Weights3 : kBC7Weights4);
+    }
+
+    void MakeBC7Palette( const BC7ModeInfo& Mode, const BC7Endpoints& Endpoints, Palette& Pal )
+    {
+        const uint32_t* Weights = GetBC7Weights(Mode.IndexBits);
+        Pal.NumEntries = 1u << Mode.IndexBits;
+
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            uint32_t E[2];
+            for (uint32_t e = 0; e < 2; ++e)
+            {
+                if (c >= Mode.NumChannels)
+                    E[e] = 255;
+                else if (Mode.PBits == kNoPBit)
+                    E[e] = Expand(Endpoints.Value[e][c], Mode.ColorBits);
+                else
+                    E[e] = Expand(Endpoints.Value[e][c] << 1 | Endpoints.PBit[e], Mode.ColorBits + 1);
+            }
+            for (uint32_t i = 0; i < Pal.NumEntries; ++i)
+                Pal.Color[i][c] = (float)Interpolate(E[0], E[1], Weights[i]);
+        }
+    }
+
+    void TryBC7Endpoints( const BlockPixels& Px, uint32_t Mask, const BC7ModeInfo& Mode, const float E0[4],
+        const float E1[4], uint32_t P0, uint32_t P1, BC7SubsetCandidate& Best )
+    {
+        BC7SubsetCandidate Candidate = {};
+        Candidate.Endpoints.PBit[0] = P0;
+        Candidate.Endpoints.PBit[1] = P1;
+        for (uint32_t c = 0; c < Mode.NumChannels; ++c)
+        {
+            Candidate.Endpoints.Value[0][c] = Quantize(E0[c], Mode.ColorBits, Mode.PBits == kNoPBit ? -1 : (int)P0);
+            Candidate.Endpoints.Value[1][c] = Quantize(E1[c], Mode.ColorBits, Mode.PBits == kNoPBit ? -1 : (int)P1);
+        }
+
+        Palette Pal;
+        MakeBC7Palette(Mode, Candidate.Endpoints, Pal);
+        Candidate.Error = FindIndices(Px, Pal, Mode.NumChannels, Mask, Candidate.Indices);
+
+        if (Candidate.Error < Best.Error)
+            Best = Candidate;
+    }
+
+    // The p-bit that loses the least precision across an endpoint's channels
+    uint32_t ChoosePBit( const float E[4], const BC7ModeInfo& Mode )
+    {
+        float Error[2] = {};
+        for (uint32_t p = 0; p < 2; ++p)
+        {
+            for (uint32_t c = 0; c < Mode.NumChannels; ++c)
+            {
+                const float d = (float)Expand(Quantize(E[c], Mode.ColorBits, (int)p) << 1 | p,
+                    Mode.ColorBits + 1) - E[c];
+                Error[p] += d * d;
+            }
+        }
+        return Error[1] < Error[0] ? 1 : 0;
+    }
+
+    // KeepOpaque holds mode 6's p-bits at one, the only way its alpha endpoints can reach 255, so that opaque
+    // blocks stay exactly opaque
+    void EncodeBC7Subset( const BlockPixels& Px, uint32_t Mask, const BC7ModeInfo& Mode, bool Quality,
+        bool KeepOpaque, BC7SubsetCandidate& Best )
+    {
+        Best.Error = FLT_MAX;
+        memset(Best.Indices, 0, sizeof(Best.Indices));
+
+        float E0[4], E1[4];
+        FitEndpoints(Px, Mask, Mode.NumChannels, 0.0f, E0, E1);
+
+        // Fast mode settles on one pair of p-bits up front; quality mode carries every combination through
+        // refinement, since the best one often changes as the endpoints move
+        uint32_t PBits[4][2] = { { 0, 0 }, { 1, 1 }, { 0, 1 }, { 1, 0 } };
+        uint32_t NumPBits = Mode.PBits == kNoPBit ? 1 : (Mode.PBits == kSharedPBit ? 2 : 4);
+        if (!Quality && Mode.PBits != kNoPBit)
+        {
+            uint32_t P0 = ChoosePBit(E0, Mode), P1 = ChoosePBit(E1, Mode);
+            if (Mode.PBits == kSharedPBit)
+            {
+                float Both[4];
+                for (uint32_t c = 0; c < 4; ++c)
+                    Both[c] = (E0[c] + E1[c]) * 0.5f;
+                P0 = P1 = ChoosePBit(Both, Mode);
+            }
+            PBits[0][0] = P0;
+            PBits[0][1] = P1;
+            NumPBits = 1;
+        }
+        if (KeepOpaque && Mode.PBits == kUniquePBit)
+        {
+            PBits[0][0] = PBits[0][1] = 1;
+            NumPBits = 1;
+        }
+
+        float Weights[16];
+        const uint32_t* IntWeights = GetBC7Weights(Mode.IndexBits);
+        for (uint32_t i = 0; i < (1u << Mode.IndexBits); ++i)
+            Weights[i] = IntWeights[i] / 64.0f;
+
+        for (uint32_t p = 0; p < NumPBits; ++p)
+        {
+            BC7SubsetCandidate Candidate;
+            Candidate.Error = FLT_MAX;
+            TryBC7Endpoints(Px, Mask, Mode, E0, E1, PBits[p][0], PBits[p][1], Candidate);
+
+            const uint32_t Passes = Quality ? 3 : 1;
+            for (uint32_t Pass = 0; Pass < Passes && Candidate.Error > 0.0f; ++Pass)
+            {
+                const float Start = Candidate.Error;
+                float R0[4] = {}, R1[4] = {};
+                if (!RefineEndpoints(Px, Mask, Mode.NumChannels, Candidate.Indices, Weights, 1u << Mode.IndexBits,
+                    R0, R1))
+                    break;
+
+                TryBC7Endpoints(Px, Mask, Mode, R0, R1, PBits[p][0], PBits[p][1], Candidate);
+                if (Candidate.Error >= Start)
+                    break;
+            }
+
+            if (Candidate.Error < Best.Error)
+                Best = Candidate;
+        }
+    }
+
+    // Swaps a subset's endpoints when its anchor texel's index has the top bit set, which the format can't store
+    void FixBC7Anchor( BC7Endpoints& Endpoints, uint8_t Indices[16], uint32_t Mask, uint32_t Anchor,
+        uint32_t IndexBits )
+    {
+        const uint32_t MaxIndex = (1u << IndexBits) - 1;
+        if (Indices[Anchor] <= (MaxIndex >> 1))
+            return;
+
+        for (uint32_t c = 0; c < 4; ++c)
+            std::swap(Endpoints.Value[0][c], Endpoints.Value[1][c]);
+        std::swap(Endpoints.PBit[0], Endpoints.PBit[1]);
+
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if (Mask & (1 << i))
+                Indices[i] = (uint8_t)(MaxIndex - Indices[i]);
+        }
+    }
+
+    void WriteBC7Mode5( BC7SubsetCandidate& Color, BC7SubsetCandidate& Alpha, uint8_t* Dest )
+    {
+        FixBC7Anchor(Color.Endpoints, Color.Indices, 0xFFFF, 0, 2);
+        FixBC7Anchor(Alpha.Endpoints, Alpha.Indices, 0xFFFF, 0, 2);
+
+        BitWriter Bits(Dest);
+        Bits.Write(1 << 5, 6);
+        Bits.Write(0, 2);       // No channel rotation
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            Bits.Write(Color.Endpoints.Value[0][c], 7);
+            Bits.Write(Color.Endpoints.Value[1][c], 7);
+        }
+        Bits.Write(Alpha.Endpoints.Value[0][0], 8);
+        Bits.Write(Alpha.Endpoints.Value[1][0], 8);
+        for (uint32_t i = 0; i < 16; ++i)
+            Bits.Write(Color.Indices[i], i == 0 ? 1 : 2);
+        for (uint32_t i = 0; i < 16; ++i)
+            Bits.Write(Alpha.Indices[i], i == 0 ? 1 : 2);
+    }
+
+    void WriteBC7Mode6( BC7SubsetCandidate& Subset, uint8_t* Dest )
+    {
+        FixBC7Anchor(Subset.Endpoints, Subset.Indices, 0xFFFF, 0, 4);
+
+        BitWriter Bits(Dest);
+        Bits.Write(1 << 6, 7);
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            Bits.Write(Subset.Endpoints.Value[0][c], 7);
+            Bits.Write(Subset.Endpoints.Value[1][c], 7);
+        }
+        Bits.Write(Subset.Endpoints.PBit[0], 1);
+        Bits.Write(Subset.Endpoints.PBit[1], 1);
+        for (uint32_t i = 0; i < 16; ++i)
+            Bits.Write(Subset.Indices[i], i == 0 ? 3 : 4);
+    }
+
+    void WriteBC7Mode1( uint32_t Partition, BC7SubsetCandidate Subsets[2], uint8_t* Dest )
+    {
+        const uint32_t Masks[2] = { ~kBC7Partitions2[Partition] & 0xFFFFu, kBC7Partitions2[Partition] };
+        const uint32_t Anchors[2] = { 0, kBC7Anchors2[Partition] };
+
+        uint8_t Indices[16];
+        for (uint32_t s = 0; s < 2; ++s)
+        {
+            FixBC7Anchor(Subsets[s].Endpoints, Subsets[s].Indices, Masks[s], Anchors[s], 3);
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                if (Masks[s] & (1 << i))
+                    Indices[i] = Subsets[s].Indices[i];
+            }
+        }
+
+        BitWriter Bits(Dest);
+        Bits.Write(1 << 1, 2);
+        Bits.Write(Partition, 6);
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            for (uint32_t s = 0; s < 2; ++s)
+            {
+                Bits.Write(Subsets[s].Endpoints.Value[0][c], 6);
+                Bits.Write(Subsets[s].Endpoints.Value[1][c], 6);
+            }
+        }
+        Bits.Write(Subsets[0].Endpoints.PBit[0], 1);
+        Bits.Write(Subsets[1].Endpoints.PBit[0], 1);
+        for (uint32_t i = 0; i < 16; ++i)
+            Bits.Write(Indices[i], i == Anchors[0] || i == Anchors[1] ? 2 : 3);
+    }
+
+    // Sums of a set of RGB texels and of their channel products, from which the set's spread about its best
+    // line follows without another pass over the texels
+    struct ColorMoments
+    {
+        float Count;
+        float Sum[3];
+        float Product[6];   // RR, RG, RB, GG, GB, BB
+    };
+
+    void SumMoments( const BlockPixels& Px, uint32_t Mask, ColorMoments& Moments )
+    {
+        memset(&Moments, 0, sizeof(Moments));
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if ((Mask & (1 << i)) == 0)
+                continue;
+
+            const float R = Px.Channel[0][i], G = Px.Channel[1][i], B = Px.Channel[2][i];
+            Moments.Count += 1.0f;
+            Moments.Sum[0] += R;
+            Moments.Sum[1] += G;
+            Moments.Sum[2] += B;
+            Moments.Product[0] += R * R;
+            Moments.Product[1] += R * G;
+            Moments.Product[2] += R * B;
+            Moments.Product[3] += G * G;
+            Moments.Product[4] += G * B;
+            Moments.Product[5] += B * B;
+        }
+    }
+
+    // The same as what FindPrincipalAxis() returns, with fewer iterations since it only ranks partitions
+    float EstimateLineError( const ColorMoments& Moments )
+    {
+        if (Moments.Count < 2.0f)
+            return 0.0f;
+
+        const float* S = Moments.Sum;
+        const float* P = Moments.Product;
+        const float InvCount = 1.0f / Moments.Count;
+        const float Covariance[3][3] =
+        {
+            { P[0] - S[0] * S[0] * InvCount, P[1] - S[0] * S[1] * InvCount, P[2] - S[0] * S[2] * InvCount },
+            { P[1] - S[0] * S[1] * InvCount, P[3] - S[1] * S[1] * InvCount, P[4] - S[1] * S[2] * InvCount },
+            { P[2] - S[0] * S[2] * InvCount, P[4] - S[1] * S[2] * InvCount, P[5] - S[2] * S[2] * InvCount },
+        };
+
+        const float Trace = Covariance[0][0] + Covariance[1][1] + Covariance[2][2];
+        if (Trace < 1e-3f)
+            return 0.0f;
+
+        uint32_t Widest = Covariance[1][1] > Covariance[0][0] ? 1 : 0;
+        if (Covariance[2][2] > Covariance[Widest][Widest])
+            Widest = 2;
+
+        float v[3] = { Covariance[Widest][0], Covariance[Widest][1], Covariance[Widest][2] };
+        for (uint32_t Iteration = 0; Iteration < 3; ++Iteration)
+        {
+            float w[3];
+            for (uint32_t r = 0; r < 3; ++r)
+                w[r] = Covariance[r][0] * v[0] + Covariance[r][1] * v[1] + Covariance[r][2] * v[2];
+            const float Largest = std::max(std::fabs(w[0]), std::max(std::fabs(w[1]), std::fabs(w[2])));
+            if (Largest == 0.0f)
+                return Trace;
+            for (uint32_t c = 0; c < 3; ++c)
+                v[c] = w[c] / Largest;
+        }
+
+        float Variance = 0.0f;
+        for (uint32_t r = 0; r < 3; ++r)
+            Variance += v[r] * (Covariance[r][0] * v[0] + Covariance[r][1] * v[1] + Covariance[r][2] * v[2]);
+        Variance /= v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+
+        return std::max(Trace - Variance, 0.0f);
+    }
+
+    void EncodeBC7( const uint8_t Pixels[64], bool Quality, uint8_t* Dest )
+    {
+        BlockPixels Px;
+        LoadBlock(Pixels, Px);
+
+        bool Opaque = true;
+        for (uint32_t i = 0; i < 16; ++i)
+            Opaque = Opaque && Pixels[i * 4 + 3] == 255;
+
+        BC7SubsetCandidate Mode6;
+        EncodeBC7Subset(Px, 0xFFFF, kBC7Mode6, Quality, Opaque, Mode6);
+
+        // Mode 6 puts alpha on the same line as color, which fails where alpha changes independently of it,
+        // as at the edges of cutouts.  Mode 5 gives alpha its own endpoints and indices.
+        if (!Opaque && Mode6.Error > 0.0f)
+        {
+            BlockPixels AlphaPx;
+            memcpy(AlphaPx.Channel[0], Px.Channel[3], sizeof(AlphaPx.Channel[0]));
+
+            BC7SubsetCandidate Color, Alpha;
+            EncodeBC7Subset(Px, 0xFFFF, kBC7Mode5Color, Quality, false, Color);
+            EncodeBC7Subset(AlphaPx, 0xFFFF, kBC7Mode5Alpha, Quality, false, Alpha);
+
+            if (Color.Error + Alpha.Error < Mode6.Error)
+            {
+                WriteBC7Mode5(Color, Alpha, Dest);
+                return;
+            }
+        }
+
+        // Mode 1 has two RGB subsets with less precise endpoints and indices.  Rank its partitions by how far
+        // each subset's colors stray from a line, then encode the most promising few in full.
+        if (Quality && Opaque && Mode6.Error > 0.0f)
+        {
+            const uint32_t kNumTried = 4;
+            uint32_t Ranked[kNumTried];
+            float RankedError[kNumTried];
+            for (uint32_t i = 0; i < kNumTried; ++i)
+            {
+                Ranked[i] = 0;
+                RankedError[i] = FLT_MAX;
+            }
+
+            ColorMoments All;
+            SumMoments(Px, 0xFFFF, All);
+
+            for (uint32_t Partition = 0; Partition < 64; ++Partition)
+            {
+                ColorMoments First, Second;
+                SumMoments(Px, kBC7Partitions2[Partition], Second);
+                First.Count = All.Count - Second.Count;
+                for (uint32_t c = 0; c < 3; ++c)
+                    First.Sum[c] = All.Sum[c] - Second.Sum[c];
+                for (uint32_t c = 0; c < 6; ++c)
+                    First.Product[c] = All.Product[c] - Second.Product[c];
+
+                float Error = EstimateLineError(First) + EstimateLineError(Second);
+
+                uint32_t Candidate = Partition;
+                for (uint32_t Slot = 0; Slot < kNumTried; ++Slot)
+                {
+                    if (Error < RankedError[Slot])
+                    {
+                        std::swap(Error, RankedError[Slot]);
+                        std::swap(Candidate, Ranked[Slot]);
+                    }
+                }
+            }
+
+            uint32_t BestPartition = 0;
+            float BestError = Mode6.Error;
+            BC7SubsetCandidate BestSubsets[2];
+            for (uint32_t Slot = 0; Slot < kNumTried && RankedError[Slot] != FLT_MAX; ++Slot)
+            {
+                const uint32_t Partition = Ranked[Slot];
+                const uint32_t Second = kBC7Partitions2[Partition];
+                BC7SubsetCandidate Subsets[2];
+                EncodeBC7Subset(Px, ~Second & 0xFFFF, kBC7Mode1, true, false, Subsets[0]);
+                EncodeBC7Subset(Px, Second, kBC7Mode1, true, false, Subsets[1]);
+
+                if (Subsets[0].Error + Subsets[1].Error < BestError)
+                {
+                    BestError = Subsets[0].Error + Subsets[1].Error;
+                    BestPartition = Partition;
+                    BestSubsets[0] = Subsets[0];
+                    BestSubsets[1] = Subsets[1];
+                }
+            }
+
+            if (BestError < Mode6.Error)
+            {
+                WriteBC7Mode1(BestPartition, BestSubsets, Dest);
+                return;
+            }
+        }
+
+        WriteBC7Mode6(Mode6, Dest);
+    }
+
+    bool DecodeBC7( const uint8_t* Block, uint8_t Pixels[64] )
+    {
+        BitReader Bits(Block);
+
+        uint32_t Mode = 0;
+        while (Mode < 8 && Bits.Read(1) == 0)
+            ++Mode;
+
+        BC7Endpoints Endpoints[2];
+        uint32_t Masks[2] = { 0xFFFF, 0 };
+        uint32_t Anchors[2] = { 0, 0 };
+        const BC7ModeInfo* Info;
+
+        if (Mode == 5)
+        {
+            const uint32_t Rotation = Bits.Read(2);
+
+            BC7Endpoints Color, Alpha;
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                Color.Value[0][c] = Bits.Read(7);
+                Color.Value[1][c] = Bits.Read(7);
+            }
+            Alpha.Value[0][0] = Bits.Read(8);
+            Alpha.Value[1][0] = Bits.Read(8);
+
+            Palette ColorPal, AlphaPal;
+            MakeBC7Palette(kBC7Mode5Color, Color, ColorPal);
+            MakeBC7Palette(kBC7Mode5Alpha, Alpha, AlphaPal);
+
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                const uint32_t Index = Bits.Read(i == 0 ? 1 : 2);
+                for (uint32_t c = 0; c < 3; ++c)
+                    Pixels[i * 4 + c] = (uint8_t)ColorPal.Color[Index][c];
+            }
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                Pixels[i * 4 + 3] = (uint8_t)AlphaPal.Color[Bits.Read(i == 0 ? 1 : 2)][0];
+                if (Rotation != 0)
+                    std::swap(Pixels[i * 4 + 3], Pixels[i * 4 + Rotation - 1]);
+            }
+            return true;
+        }
+        else if (Mode == 6)
+        {
+            Info = &kBC7Mode6;
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                Endpoints[0].Value[0][c] = Bits.Read(7);
+                Endpoints[0].Value[1][c] = Bits.Read(7);
+            }
+            Endpoints[0].PBit[0] = Bits.Read(1);
+            Endpoints[0].PBit[1] = Bits.Read(1);
+        }
+        else if (Mode == 1)
+        {
+            Info = &kBC7Mode1;
+            const uint32_t Partition = Bits.Read(6);
+            Masks[0] = ~kBC7Partitions2[Partition] & 0xFFFFu;
+            Masks[1] = kBC7Partitions2[Partition];
+            Anchors[1] = kBC7Anchors2[Partition];
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                for (uint32_t s = 0; s < 2; ++s)
+                {
+                    Endpoints[s].Value[0][c] = Bits.Read(6);
+                    Endpoints[s].Value[1][c] = Bits.Read(6);
+                }
+            }
+            for (uint32_t s = 0; s < 2; ++s)
+                Endpoints[s].PBit[0] = Endpoints[s].PBit[1] = Bits.Read(1);
+        }
+        else
+        {
+            memset(Pixels, 0, 64);
+            return false;
+        }
+
+        Palette Pal[2];
+        for (uint32_t s = 0; s < 2; ++s)
+        {
+            if (Masks[s] != 0)
+                MakeBC7Palette(*Info, Endpoints[s], Pal[s]);
+        }
+
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            const uint32_t s = (Masks[1] >> i) & 1;
+            const bool Anchor = i == Anchors[0] || (s == 1 && i == Anchors[1]);
+            const uint32_t Index = Bits.Read(Anchor ? Info->IndexBits - 1 : Info->IndexBits);
+            for (uint32_t c = 0; c < 4; ++c)
+                Pixels[i * 4 + c] = (uint8_t)Pal[s].Color[Index][c];
+        }
+        return true;
+    }
+}
+
+const char* GetBCFormatName( BCFormat Format )
+{
+    switch (Format)
+    {
+    case kBC1: return "BC1";
+    case kBC3: return "BC3";
+    case kBC4: return "BC4";
+    case kBC5: return "BC5";
+    case kBC7: return "BC7";
+    default: return "?";
+    }
+}
+
+void EncodeBCBlock( BCFormat Format, const uint8_t Pixels[64], bool Quality, void* Block )
+{
+    uint8_t* Dest = (uint8_t*)Block;
+
+    switch (Format)
+    {
+    case kBC1:
+        EncodeBC1Color(Pixels, false, Quality, Dest);
+        break;
+
+    case kBC3:
+        EncodeBC4(Pixels, 3, Quality, Dest);
+        EncodeBC1Color(Pixels, true, Quality, Dest + 8);
+        break;
+
+    case kBC4:
+        EncodeBC4(Pixels, 0, Quality, Dest);
+        break;
+
+    case kBC5:
+        EncodeBC4(Pixels, 0, Quality, Dest);
+        EncodeBC4(Pixels, 1, Quality, Dest + 8);
+        break;
+
+    case kBC7:
+        EncodeBC7(Pixels, Quality, Dest);
+        break;
+
+    default:
+        break;
+    }
+}
+
+bool DecodeBCBlock( BCFormat Format, const void* Block, uint8_t Pixels[64] )
+{
+    const uint8_t* Src = (const uint8_t*)Block;
+
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        Pixels[i * 4 + 0] = 0;
+        Pixels[i * 4 + 1] = 0;
+        Pixels[i * 4 + 2] = 0;
+        Pixels[i * 4 + 3] = 255;
+    }
+
+    switch (Format)
+    {
+    case kBC1:
+        DecodeBC1Color(Src, false, Pixels);
+        return true;
+
+    case kBC3:
+        DecodeBC1Color(Src + 8, true, Pixels);
+        DecodeBC4(Src, 3, Pixels);
+        return true;
+
+    case kBC4:
+        DecodeBC4(Src, 0, Pixels);
+        return true;
+
+    case kBC5:
+        DecodeBC4(Src, 0, Pixels);
+        DecodeBC4(Src + 8, 1, Pixels);
+        return true;
+
+    case kBC7:
+        return DecodeBC7(Src, Pixels);
+
+    default:
+        return false;
+    }
+}
+
+bool ConfigureBCEncoder( bool UseSSE2 )
+{
+    s_UseSSE2 = UseSSE2;
+    return s_UseSSE2;
+}
@@ -0,0 +1,53 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Encodes and decodes single 4x4 blocks of BC1, BC3, BC4, BC5 and BC7.  Endpoints start on the principal axis
+// of the block's colors and are refit by least squares to the indices they produce; the quality setting spends
+// more passes on that, tries BC1's three-color mode and both BC4 modes, and for opaque BC7 blocks searches the
+// two-subset partitions of mode 1 as well as mode 6.  BC7 blocks with varying alpha also try mode 5, which codes
+// alpha apart from color.  Every candidate is scored by its exact decoded error, so finding the closest palette
+// entry for each pixel is the inner loop, and it runs four pixels at a time on SSE2.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum BCFormat
+{
+    kBC1,       // RGB with 1-bit alpha, 8 bytes per block
+    kBC3,       // RGB plus BC4 alpha, 16 bytes per block
+    kBC4,       // Red, 8 bytes per block
+    kBC5,       // Red and green, 16 bytes per block
+    kBC7,       // RGBA, 16 bytes per block
+
+    kNumBCFormats
+};
+
+inline size_t GetBCBlockSize( BCFormat Format )
+{
+    return Format == kBC1 || Format == kBC4 ? 8 : 16;
+}
+
+const char* GetBCFormatName( BCFormat Format );
+
+// Pixels are 16 RGBA8 texels, four rows of four.  BC4 only reads red and BC5 red and green.  BC1 makes texels
+// with alpha below 128 transparent.
+void EncodeBCBlock( BCFormat Format, const uint8_t Pixels[64], bool Quality, void* Block );
+
+// Writes what a GPU would sample, with unused channels as 0 and alpha as 255.  BC7 blocks in modes the encoder
+// never writes (anything but 1, 5 and 6) decode to zero and return false.
+bool DecodeBCBlock( BCFormat Format, const void* Block, uint8_t Pixels[64] );
+
+// Selects the SSE2 or the scalar palette search.  Both give identical blocks.  Returns whether SSE2 is now used.
+bool ConfigureBCEncoder( bool UseSSE2 );
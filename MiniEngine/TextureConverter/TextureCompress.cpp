@@ -0,0 +1,255 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "TextureCompress.h"
+
+#include "dds.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+using namespace DirectX;
+
+namespace
+{
+    float SRGBToLinear( float Value )
+    {
+        return Value <= 0.04045f ? Value / 12.92f : std::pow((Value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float LinearToSRGB( float Value )
+    {
+        return Value <= 0.0031308f ? Value * 12.92f : 1.055f * std::pow(Value, 1.0f / 2.4f) - 0.055f;
+    }
+
+    uint8_t ToUnorm8( float Value )
+    {
+        Value = Value * 255.0f + 0.5f;
+        return (uint8_t)(Value < 0.0f ? 0.0f : (Value > 255.0f ? 255.0f : Value));
+    }
+
+    // The source texels one destination texel covers along an axis, and how much of each
+    struct FilterTaps
+    {
+        uint32_t First;
+        uint32_t Count;
+        float Weight[4];
+    };
+
+    // Halving keeps the footprint between two and three texels, which can straddle four
+    void MakeFilterTaps( uint32_t SrcSize, uint32_t DestSize, std::vector<FilterTaps>& Taps )
+    {
+        const double Scale = (double)SrcSize / DestSize;
+        Taps.resize(DestSize);
+
+        for (uint32_t i = 0; i < DestSize; ++i)
+        {
+            const double Start = i * Scale, End = (i + 1) * Scale;
+            FilterTaps& Tap = Taps[i];
+            Tap.First = (uint32_t)Start;
+            Tap.Count = 0;
+            for (uint32_t j = Tap.First; j < SrcSize && j < End && Tap.Count < 4; ++j)
+            {
+                const double Covered = std::min<double>(j + 1, End) - std::max<double>(j, Start);
+                Tap.Weight[Tap.Count++] = (float)(Covered / Scale);
+            }
+        }
+    }
+
+    uint32_t GetDXGIFormat( BCFormat Format, bool sRGB )
+    {
+        switch (Format)
+        {
+        case kBC1: return sRGB ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+        case kBC3: return sRGB ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+        case kBC4: return DXGI_FORMAT_BC4_UNORM;
+        case kBC5: return DXGI_FORMAT_BC5_UNORM;
+        case kBC7: return sRGB ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+        default: return DXGI_FORMAT_UNKNOWN;
+        }
+    }
+
+    uint32_t GetNumBlocks( uint32_t Size )
+    {
+        return std::max(1u, (Size + 3) / 4);
+    }
+
+    void CompressBlockRow( const MipLevel& Level, uint32_t BlockY, BCFormat Format, bool Quality, uint8_t* Dest )
+    {
+        const size_t BlockSize = GetBCBlockSize(Format);
+        const uint32_t NumBlocksX = GetNumBlocks(Level.Width);
+
+        uint8_t Pixels[64];
+        for (uint32_t BlockX = 0; BlockX < NumBlocksX; ++BlockX)
+        {
+            for (uint32_t y = 0; y < 4; ++y)
+            {
+                const uint32_t SrcY = std::min(BlockY * 4 + y, Level.Height - 1);
+                for (uint32_t x = 0; x < 4; ++x)
+                {
+                    const uint32_t SrcX = std::min(BlockX * 4 + x, Level.Width - 1);
+                    memcpy(Pixels + (y * 4 + x) * 4, &Level.Pixels[((size_t)SrcY * Level.Width + SrcX) * 4], 4);
+                }
+            }
+            EncodeBCBlock(Format, Pixels, Quality, Dest + BlockX * BlockSize);
+        }
+    }
+}
+
+uint32_t GetFullMipCount( uint32_t Width, uint32_t Height )
+{
+    uint32_t Count = 1;
+    for (uint32_t Size = std::max(Width, Height); Size > 1; Size >>= 1)
+        ++Count;
+    return Count;
+}
+
+void GenerateMipChain( std::vector<MipLevel>& Levels, uint32_t MipCount, bool sRGB )
+{
+    Levels.resize(1);
+
+    float ToLinear[256];
+    for (uint32_t i = 0; i < 256; ++i)
+        ToLinear[i] = sRGB ? SRGBToLinear(i / 255.0f) : i / 255.0f;
+
+    const MipLevel& Base = Levels[0];
+    std::vector<float> Src((size_t)Base.Width * Base.Height * 4);
+    for (size_t i = 0; i < Src.size(); ++i)
+        Src[i] = (i & 3) == 3 ? Base.Pixels[i] / 255.0f : ToLinear[Base.Pixels[i]];
+
+    uint32_t SrcWidth = Base.Width, SrcHeight = Base.Height;
+    std::vector<float> Dest, Row;
+    std::vector<FilterTaps> TapsX, TapsY;
+
+    for (uint32_t LevelIdx = 1; LevelIdx < MipCount && (SrcWidth > 1 || SrcHeight > 1); ++LevelIdx)
+    {
+        const uint32_t Width = std::max(1u, SrcWidth / 2), Height = std::max(1u, SrcHeight / 2);
+        MakeFilterTaps(SrcWidth, Width, TapsX);
+        MakeFilterTaps(SrcHeight, Height, TapsY);
+
+        Dest.assign((size_t)Width * Height * 4, 0.0f);
+        Row.resize((size_t)SrcWidth * 4);
+
+        for (uint32_t y = 0; y < Height; ++y)
+        {
+            // Filter the rows this one covers down to one, then across
+            const FilterTaps& TapY = TapsY[y];
+            std::fill(Row.begin(), Row.end(), 0.0f);
+            for (uint32_t t = 0; t < TapY.Count; ++t)
+            {
+                const float* SrcRow = &Src[(size_t)(TapY.First + t) * SrcWidth * 4];
+                for (size_t i = 0; i < Row.size(); ++i)
+                    Row[i] += SrcRow[i] * TapY.Weight[t];
+            }
+
+            float* DestRow = &Dest[(size_t)y * Width * 4];
+            for (uint32_t x = 0; x < Width; ++x)
+            {
+                const FilterTaps& TapX = TapsX[x];
+                for (uint32_t t = 0; t < TapX.Count; ++t)
+                    for (uint32_t c = 0; c < 4; ++c)
+                        DestRow[x * 4 + c] += Row[(TapX.First + t) * 4 + c] * TapX.Weight[t];
+            }
+        }
+
+        MipLevel Level;
+        Level.Width = Width;
+        Level.Height = Height;
+        Level.Pixels.resize(Dest.size());
+        for (size_t i = 0; i < Dest.size(); ++i)
+            Level.Pixels[i] = ToUnorm8(sRGB && (i & 3) != 3 ? LinearToSRGB(Dest[i]) : Dest[i]);
+        Levels.push_back(std::move(Level));
+
+        Src.swap(Dest);
+        SrcWidth = Width;
+        SrcHeight = Height;
+    }
+}
+
+size_t GetCompressedLevelSize( uint32_t Width, uint32_t Height, BCFormat Format )
+{
+    return (size_t)GetNumBlocks(Width) * GetNumBlocks(Height) * GetBCBlockSize(Format);
+}
+
+void CompressMipChain( const std::vector<MipLevel>& Levels, BCFormat Format, bool Quality, uint32_t NumThreads,
+    std::vector<uint8_t>& Blocks )
+{
+    // Block rows of every level are numbered consecutively, so threads move on to the next level without
+    // waiting for the others to finish this one
+    std::vector<size_t> LevelOffset(Levels.size());
+    std::vector<uint32_t> FirstRow(Levels.size() + 1);
+    size_t TotalSize = 0;
+    FirstRow[0] = 0;
+    for (size_t i = 0; i < Levels.size(); ++i)
+    {
+        LevelOffset[i] = TotalSize;
+        TotalSize += GetCompressedLevelSize(Levels[i].Width, Levels[i].Height, Format);
+        FirstRow[i + 1] = FirstRow[i] + GetNumBlocks(Levels[i].Height);
+    }
+    Blocks.resize(TotalSize);
+
+    std::atomic<uint32_t> NextRow(0);
+    const uint32_t NumRows = FirstRow.back();
+
+    auto Worker = [&]()
+    {
+        size_t LevelIdx = 0;
+        for (uint32_t Row = NextRow++; Row < NumRows; Row = NextRow++)
+        {
+            while (Row >= FirstRow[LevelIdx + 1])
+                ++LevelIdx;
+
+            const MipLevel& Level = Levels[LevelIdx];
+            const uint32_t BlockY = Row - FirstRow[LevelIdx];
+            const size_t RowPitch = GetCompressedLevelSize(Level.Width, 1, Format);
+            CompressBlockRow(Level, BlockY, Format, Quality, &Blocks[LevelOffset[LevelIdx] + BlockY * RowPitch]);
+        }
+    };
+
+    std::vector<std::thread> Threads;
+    for (uint32_t i = 1; i < std::min(NumThreads, NumRows); ++i)
+        Threads.emplace_back(Worker);
+    Worker();
+    for (auto& Thread : Threads)
+        Thread.join();
+}
+
+void MakeDDSFile( uint32_t Width, uint32_t Height, uint32_t MipCount, BCFormat Format, bool sRGB,
+    const std::vector<uint8_t>& Blocks, std::vector<uint8_t>& File )
+{
+    DDS_HEADER Header = {};
+    Header.size = sizeof(DDS_HEADER);
+    Header.flags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_LINEARSIZE | DDS_HEADER_FLAGS_MIPMAP;
+    Header.height = Height;
+    Header.width = Width;
+    Header.pitchOrLinearSize = (uint32_t)GetCompressedLevelSize(Width, Height, Format);
+    Header.mipMapCount = MipCount;
+    Header.ddspf = DDSPF_DX10;
+    Header.caps = DDS_SURFACE_FLAGS_TEXTURE | (MipCount > 1 ? DDS_SURFACE_FLAGS_MIPMAP : 0);
+
+    DDS_HEADER_DXT10 Extension = {};
+    Extension.dxgiFormat = (DXGI_FORMAT)GetDXGIFormat(Format, sRGB);
+    Extension.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+    Extension.arraySize = 1;
+
+    const uint32_t Magic = DDS_MAGIC;
+    File.resize(sizeof(Magic) + sizeof(Header) + sizeof(Extension) + Blocks.size());
+    uint8_t* Dest = File.data();
+    memcpy(Dest, &Magic, sizeof(Magic));
+    memcpy(Dest += sizeof(Magic), &Header, sizeof(Header));
+    memcpy(Dest += sizeof(Header), &Extension, sizeof(Extension));
+    memcpy(Dest += sizeof(Extension), Blocks.data(), Blocks.size());
+}
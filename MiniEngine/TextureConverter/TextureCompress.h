@@ -0,0 +1,54 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Turns an RGBA8 image into a block compressed DDS file:  builds the mip chain, compresses every level on a
+// pool of threads that take rows of blocks as they finish the last, and wraps the result in the header that
+// CreateDDSTextureFromMemory() reads.
+//
+
+#pragma once
+
+#include "BlockCompress.h"
+
+#include <cstdint>
+#include <vector>
+
+struct MipLevel
+{
+    uint32_t Width;
+    uint32_t Height;
+    std::vector<uint8_t> Pixels;    // RGBA8, rows packed
+};
+
+// The number of levels down to 1x1
+uint32_t GetFullMipCount( uint32_t Width, uint32_t Height );
+
+// Adds levels after Levels[0] until there are MipCount of them.  Each level halves the one above, rounding down,
+// and each texel is the average of the area it covers there, so odd sizes blend three texels with fractional
+// weights rather than dropping one.  When sRGB is set, color is averaged as linear light and encoded again;
+// alpha, and everything in a non-sRGB texture, is averaged as stored.  Each level is filtered from the full
+// precision of the one above, not from its rounded RGBA8 texels.
+void GenerateMipChain( std::vector<MipLevel>& Levels, uint32_t MipCount, bool sRGB );
+
+// Bytes of block data for one level, which is what the GPU expects:  partial blocks at the edges are whole
+// blocks, and levels smaller than a block still take one.
+size_t GetCompressedLevelSize( uint32_t Width, uint32_t Height, BCFormat Format );
+
+// Compresses every level into Blocks, in the order they appear in a DDS file.  Texels past the edge of a
+// partial block repeat the edge.  NumThreads includes the calling thread.
+void CompressMipChain( const std::vector<MipLevel>& Levels, BCFormat Format, bool Quality, uint32_t NumThreads,
+    std::vector<uint8_t>& Blocks );
+
+// Builds the file around the compressed levels.  It always carries the DX10 header extension, which is the only
+// way to describe BC7 and the sRGB formats.  BC4 and BC5 have no sRGB variants.
+void MakeDDSFile( uint32_t Width, uint32_t Height, uint32_t MipCount, BCFormat Format, bool sRGB,
+    const std::vector<uint8_t>& Blocks, std::vector<uint8_t>& File );
@@ -0,0 +1,345 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Compresses TGA textures to BC1, BC3, BC4, BC5 or BC7 DDS files with full mip chains.  Writing foo.dds next to
+// foo.tga is enough:  TextureManager looks for the DDS first.  In report mode it compresses each file in every
+// format at both settings and prints the PSNR of the top level, the encoding rate and the size of the result.
+//
+
+#include "TextureCompress.h"
+#include "TGALoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+void PrintHelp()
+{
+    printf("texture_convert\n");
+
+    printf("usage:\n");
+    printf("texture_convert [-bc1|-bc3|-bc4|-bc5|-bc7] [-fast] [-linear] [-nomips] [-threads n] input.tga [output.dds]\n");
+    printf("texture_convert -report [-threads n] input.tga ...\n");
+    printf("\n");
+    printf("  -bc1 ... -bc7  output format (default -bc7)\n");
+    printf("  -fast          fewer endpoint refinements, and no BC7 partitions (mode 1)\n");
+    printf("  -linear        the texture isn't sRGB color (normal maps, masks), so filter mips as stored\n");
+    printf("  -nomips        write the top level only\n");
+    printf("  -threads n     compress on n threads (default: one per core)\n");
+    printf("  -report        print PSNR, MP/s and size for every format and setting instead of writing files\n");
+    printf("\n");
+    printf("BC4 and BC5 keep red, and red and green, and are never sRGB.  The output defaults to the input with\n");
+    printf("a .dds extension.\n");
+}
+
+bool LoadTGA( const char* FileName, MipLevel& Image, size_t& FileSize )
+{
+    FILE* File = fopen(FileName, "rb");
+    if (File == nullptr)
+        return false;
+
+    std::vector<uint8_t> Data;
+    fseek(File, 0, SEEK_END);
+    long Size = ftell(File);
+    fseek(File, 0, SEEK_SET);
+    if (Size > 0)
+    {
+        Data.resize((size_t)Size);
+        if (fread(Data.data(), 1, Data.size(), File) != Data.size())
+            Data.clear();
+    }
+    fclose(File);
+
+    TGAImageInfo Info;
+    if (Data.empty() || !ReadTGAHeader(Data.data(), Data.size(), Info))
+        return false;
+
+    Image.Width = Info.Width;
+    Image.Height = Info.Height;
+    Image.Pixels.resize((size_t)Info.Width * Info.Height * 4);
+    FileSize = Data.size();
+    return DecodeTGA(Data.data(), Data.size(), Info, Image.Pixels.data(), Info.Width * 4);
+}
+
+bool SaveFile( const std::string& FileName, const std::vector<uint8_t>& Data )
+{
+    FILE* File = fopen(FileName.c_str(), "wb");
+    if (File == nullptr)
+        return false;
+
+    bool Written = fwrite(Data.data(), 1, Data.size(), File) == Data.size();
+    return fclose(File) == 0 && Written;
+}
+
+// The channels a format stores, for measuring its error
+uint32_t GetChannelMask( BCFormat Format )
+{
+    switch (Format)
+    {
+    case kBC1: return 0x7;
+    case kBC4: return 0x1;
+    case kBC5: return 0x3;
+    default: return 0xF;
+    }
+}
+
+// Squared error of the top level against the source, over the channels the format stores.  BC1 texels that are
+// meant to be transparent are left out, since their color is meant to be lost.
+double MeasureError( const MipLevel& Source, const std::vector<uint8_t>& Blocks, BCFormat Format, uint64_t& NumSamples )
+{
+    const uint32_t ChannelMask = GetChannelMask(Format);
+    const size_t BlockSize = GetBCBlockSize(Format);
+    const uint32_t NumBlocksX = (Source.Width + 3) / 4;
+
+    double Error = 0.0;
+    NumSamples = 0;
+    for (uint32_t y = 0; y < Source.Height; y += 4)
+    {
+        for (uint32_t x = 0; x < Source.Width; x += 4)
+        {
+            uint8_t Decoded[64];
+            DecodeBCBlock(Format, &Blocks[((y / 4) * NumBlocksX + x / 4) * BlockSize], Decoded);
+
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                if (x + i % 4 >= Source.Width || y + i / 4 >= Source.Height)
+                    continue;
+
+                const uint8_t* Texel = &Source.Pixels[((size_t)(y + i / 4) * Source.Width + x + i % 4) * 4];
+                if (Format == kBC1 && Texel[3] < 128)
+                    continue;
+
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    if (ChannelMask & (1 << c))
+                    {
+                        const double d = (double)Texel[c] - Decoded[i * 4 + c];
+                        Error += d * d;
+                        ++NumSamples;
+                    }
+                }
+            }
+        }
+    }
+    return Error;
+}
+
+double PSNR( double Error, uint64_t NumSamples )
+{
+    return Error == 0.0 ? 99.0 : 10.0 * log10(255.0 * 255.0 * NumSamples / Error);
+}
+
+struct ReportTotals
+{
+    double Error;
+    uint64_t NumSamples;
+    uint64_t NumPixels;
+    double Seconds;
+    uint64_t CompressedSize;
+    uint64_t UncompressedSize;
+};
+
+int Report( const std::vector<const char*>& Files, uint32_t NumThreads )
+{
+    ReportTotals Totals[kNumBCFormats][2] = {};
+    uint64_t TotalFileSize = 0;
+
+    printf("%-32s %-6s %-8s %9s %10s %12s %8s\n", "file", "format", "setting", "PSNR", "MP/s", "bytes", "vs RGBA8");
+
+    for (const char* FileName : Files)
+    {
+        MipLevel Image;
+        size_t FileSize;
+        if (!LoadTGA(FileName, Image, FileSize))
+        {
+            printf("failed to load texture: %s\n", FileName);
+            return -1;
+        }
+        TotalFileSize += FileSize;
+
+        const uint32_t MipCount = GetFullMipCount(Image.Width, Image.Height);
+        std::vector<MipLevel> ColorLevels(1, Image), DataLevels(1, Image);
+        GenerateMipChain(ColorLevels, MipCount, true);
+        GenerateMipChain(DataLevels, MipCount, false);
+
+        uint64_t NumPixels = 0, UncompressedSize = 0;
+        for (const MipLevel& Level : ColorLevels)
+            NumPixels += (uint64_t)Level.Width * Level.Height;
+        UncompressedSize = NumPixels * 4;
+
+        for (uint32_t f = 0; f < kNumBCFormats; ++f)
+        {
+            const BCFormat Format = (BCFormat)f;
+            const std::vector<MipLevel>& Levels = Format == kBC4 || Format == kBC5 ? DataLevels : ColorLevels;
+
+            for (uint32_t Quality = 0; Quality < 2; ++Quality)
+            {
+                std::vector<uint8_t> Blocks;
+                auto Start = std::chrono::high_resolution_clock::now();
+                CompressMipChain(Levels, Format, Quality != 0, NumThreads, Blocks);
+                auto End = std::chrono::high_resolution_clock::now();
+                const double Seconds = std::chrono::duration<double>(End - Start).count();
+
+                uint64_t NumSamples;
+                const double Error = MeasureError(Image, Blocks, Format, NumSamples);
+
+                printf("%-32s %-6s %-8s %6.2f dB %10.2f %12zu %7.2fx\n", FileName, GetBCFormatName(Format),
+                    Quality ? "quality" : "fast", PSNR(Error, NumSamples), NumPixels / Seconds / 1e6,
+                    Blocks.size(), (double)UncompressedSize / Blocks.size());
+
+                ReportTotals& Total = Totals[f][Quality];
+                Total.Error += Error;
+                Total.NumSamples += NumSamples;
+                Total.NumPixels += NumPixels;
+                Total.Seconds += Seconds;
+                Total.CompressedSize += Blocks.size();
+                Total.UncompressedSize += UncompressedSize;
+            }
+        }
+    }
+
+    printf("\n%u files, %llu bytes of TGA, %u threads\n", (uint32_t)Files.size(), (unsigned long long)TotalFileSize,
+        NumThreads);
+    printf("%-6s %-8s %9s %10s %12s %8s %8s\n", "format", "setting", "PSNR", "MP/s", "bytes", "vs RGBA8", "vs TGA");
+    for (uint32_t f = 0; f < kNumBCFormats; ++f)
+    {
+        for (uint32_t Quality = 0; Quality < 2; ++Quality)
+        {
+            const ReportTotals& Total = Totals[f][Quality];
+            printf("%-6s %-8s %6.2f dB %10.2f %12llu %7.2fx %7.2fx\n", GetBCFormatName((BCFormat)f),
+                Quality ? "quality" : "fast", PSNR(Total.Error, Total.NumSamples),
+                Total.NumPixels / Total.Seconds / 1e6, (unsigned long long)Total.CompressedSize,
+                (double)Total.UncompressedSize / Total.CompressedSize, (double)TotalFileSize / Total.CompressedSize);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    BCFormat Format = kBC7;
+    bool Quality = true;
+    bool sRGB = true;
+    bool Mips = true;
+    bool ReportMode = false;
+    uint32_t NumThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<const char*> Files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* Arg = argv[i];
+        if (strcmp(Arg, "-bc1") == 0)
+            Format = kBC1;
+        else if (strcmp(Arg, "-bc3") == 0)
+            Format = kBC3;
+        else if (strcmp(Arg, "-bc4") == 0)
+            Format = kBC4;
+        else if (strcmp(Arg, "-bc5") == 0)
+            Format = kBC5;
+        else if (strcmp(Arg, "-bc7") == 0)
+            Format = kBC7;
+        else if (strcmp(Arg, "-fast") == 0)
+            Quality = false;
+        else if (strcmp(Arg, "-linear") == 0)
+            sRGB = false;
+        else if (strcmp(Arg, "-nomips") == 0)
+            Mips = false;
+        else if (strcmp(Arg, "-report") == 0)
+            ReportMode = true;
+        else if (strcmp(Arg, "-threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+            NumThreads = (uint32_t)atoi(argv[++i]);
+        else if (Arg[0] == '-')
+        {
+            PrintHelp();
+            return -1;
+        }
+        else
+            Files.push_back(Arg);
+    }
+
+    if (ReportMode)
+    {
+        if (Files.empty())
+        {
+            PrintHelp();
+            return -1;
+        }
+        return Report(Files, NumThreads);
+    }
+
+    if (Files.empty() || Files.size() > 2)
+    {
+        PrintHelp();
+        return -1;
+    }
+
+    const char* InputFile = Files[0];
+    std::string OutputFile = Files.size() > 1 ? Files[1] : InputFile;
+    if (Files.size() == 1)
+    {
+        size_t Dot = OutputFile.find_last_of('.');
+        size_t Slash = OutputFile.find_last_of("/\\");
+        if (Dot != std::string::npos && (Slash == std::string::npos || Dot > Slash))
+            OutputFile.resize(Dot);
+        OutputFile += ".dds";
+    }
+
+    if (Format == kBC4 || Format == kBC5)
+        sRGB = false;
+
+    std::vector<MipLevel> Levels(1);
+    size_t FileSize;
+    if (!LoadTGA(InputFile, Levels[0], FileSize))
+    {
+        printf("failed to load texture: %s\n", InputFile);
+        return -1;
+    }
+
+    const uint32_t Width = Levels[0].Width, Height = Levels[0].Height;
+    if (Width % 4 != 0 || Height % 4 != 0)
+    {
+        // D3D12 requires the top level of a block compressed texture to be whole blocks
+        printf("%s is %ux%u; block compressed textures must be a multiple of 4 in each dimension\n",
+            InputFile, Width, Height);
+        return -1;
+    }
+
+    const uint32_t MipCount = Mips ? GetFullMipCount(Width, Height) : 1;
+    GenerateMipChain(Levels, MipCount, sRGB);
+
+    std::vector<uint8_t> Blocks, DDSFile;
+    auto Start = std::chrono::high_resolution_clock::now();
+    CompressMipChain(Levels, Format, Quality, NumThreads, Blocks);
+    auto End = std::chrono::high_resolution_clock::now();
+    MakeDDSFile(Width, Height, MipCount, Format, sRGB, Blocks, DDSFile);
+
+    if (!SaveFile(OutputFile, DDSFile))
+    {
+        printf("failed to save texture: %s\n", OutputFile.c_str());
+        return -1;
+    }
+
+    uint64_t NumSamples;
+    const double Error = MeasureError(Levels[0], Blocks, Format, NumSamples);
+    printf("%s -> %s:  %ux%u, %u mips, %s%s %s, %.2f dB, %.2f s, %zu bytes (%.2fx smaller than the TGA)\n",
+        InputFile, OutputFile.c_str(), Width, Height, MipCount, GetBCFormatName(Format), sRGB ? " sRGB" : "",
+        Quality ? "quality" : "fast", PSNR(Error, NumSamples), std::chrono::duration<double>(End - Start).count(),
+        DDSFile.size(), (double)FileSize / DDSFile.size());
+
+    return 0;
+}
@@ -0,0 +1,436 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking CommandAllocatorPool (CommandAllocatorPool.cpp) without a device.  Allocators come
+// from a test provider, the fence is a pair of counters that the test (or a pretend GPU thread) completes, and
+// every allocator remembers the fence it was last discarded with, so one that is reset while the GPU could still be
+// reading its commands is caught.
+//
+//   CommandAllocatorPoolTest selftest
+//       Checks fence ordering of retired allocators, the per-thread caches (reuse without the lock, return on
+//       thread exit, dropped by Shutdown()), the allocator cap, and many threads recording against a GPU that
+//       lags behind, with and without a cap.
+//   CommandAllocatorPoolTest bench [max threads]
+//       Records on 1, 2, 4 ... threads with fences completing one and four submissions behind and reports
+//       requests per second, how many were served by the thread caches, and how many allocators were created.
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "pch.h"
+#include "CommandAllocatorPool.h"
+#include "../TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+    // Fence values are handed out in order by Signal().  Complete() never moves the completed value backwards.
+    class FakeFence
+    {
+    public:
+        FakeFence() : m_Next(1), m_Completed(0) {}
+
+        uint64_t Signal( void ) { return m_Next++; }
+        uint64_t GetCompletedValue( void ) const { return m_Completed.load(std::memory_order_acquire); }
+        uint64_t GetLastSignaled( void ) const { return m_Next - 1; }
+
+        void Complete( uint64_t FenceValue )
+        {
+            uint64_t Current = m_Completed.load();
+            while (Current < FenceValue && !m_Completed.compare_exchange_weak(Current, FenceValue))
+                ;
+        }
+
+    private:
+        std::atomic<uint64_t> m_Next;
+        std::atomic<uint64_t> m_Completed;
+    };
+
+    // An allocator with no memory behind it.  Reset() is where the pool declares that the GPU is done with it, so that
+    // is where the fence is checked.
+    class FakeAllocator final : public ID3D12CommandAllocator
+    {
+    public:
+        FakeAllocator( FakeFence& Fence, std::atomic<int>& LiveCount ) :
+            m_RefCount(1), m_Fence(Fence), m_LiveCount(LiveCount), m_RetiredFence(0), m_InUse(false), m_NumResets(0)
+        {
+            ++m_LiveCount;
+        }
+
+        HRESULT STDMETHODCALLTYPE QueryInterface( REFIID, void** PpvObject ) override { *PpvObject = nullptr; return E_NOINTERFACE; }
+        ULONG STDMETHODCALLTYPE AddRef( void ) override { return ++m_RefCount; }
+        ULONG STDMETHODCALLTYPE Release( void ) override
+        {
+            ULONG Count = --m_RefCount;
+            if (Count == 0)
+            {
+                --m_LiveCount;
+                delete this;
+            }
+            return Count;
+        }
+
+        HRESULT STDMETHODCALLTYPE GetPrivateData( REFGUID, UINT*, void* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateData( REFGUID, UINT, const void* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateDataInterface( REFGUID, const IUnknown* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetName( LPCWSTR ) override { return S_OK; }
+        HRESULT STDMETHODCALLTYPE GetDevice( REFIID, void** PpvDevice ) override { *PpvDevice = nullptr; return E_NOTIMPL; }
+
+        HRESULT STDMETHODCALLTYPE Reset( void ) override
+        {
+            Check(m_RetiredFence <= m_Fence.GetCompletedValue(), "an allocator is only reset after its fence completes");
+            Check(!m_InUse, "an allocator is not reset while a context is recording into it");
+            ++m_NumResets;
+            return S_OK;
+        }
+
+        std::atomic<ULONG> m_RefCount;
+        FakeFence& m_Fence;
+        std::atomic<int>& m_LiveCount;
+
+        std::atomic<uint64_t> m_RetiredFence;   // The fence the allocator was last discarded with
+        std::atomic<bool> m_InUse;              // Held by a context that is recording
+        std::atomic<uint32_t> m_NumResets;
+    };
+
+    class FakeAllocatorProvider : public CommandAllocatorProvider
+    {
+    public:
+        FakeAllocatorProvider( FakeFence& Fence ) : m_Fence(Fence), m_LiveAllocators(0), m_NumCreated(0) {}
+
+        ID3D12CommandAllocator* CreateAllocator( D3D12_COMMAND_LIST_TYPE Type ) override
+        {
+            Check(Type == D3D12_COMMAND_LIST_TYPE_DIRECT, "allocators are created for the pool's queue type");
+            ++m_NumCreated;
+            return new FakeAllocator(m_Fence, m_LiveAllocators);
+        }
+
+        FakeFence& m_Fence;
+        std::atomic<int> m_LiveAllocators;
+        std::atomic<uint32_t> m_NumCreated;
+    };
+
+    FakeAllocator* FakeOf( ID3D12CommandAllocator* Allocator )
+    {
+        return static_cast<FakeAllocator*>(Allocator);
+    }
+
+    // What CommandQueue does with an allocator between requesting and discarding it, with the checks a real queue
+    // cannot make:  the allocator is not held by anyone else, and its previous submission has finished.
+    ID3D12CommandAllocator* Begin( CommandAllocatorPool& Pool, FakeFence& Fence )
+    {
+        uint64_t Completed = Fence.GetCompletedValue();
+        ID3D12CommandAllocator* Allocator = Pool.RequestAllocator(Completed);
+        if (Allocator != nullptr)
+        {
+            Check(FakeOf(Allocator)->m_RetiredFence <= Completed, "a requested allocator's fence has completed");
+            Check(!FakeOf(Allocator)->m_InUse.exchange(true), "an allocator is handed to one context at a time");
+        }
+        return Allocator;
+    }
+
+    uint64_t End( CommandAllocatorPool& Pool, FakeFence& Fence, ID3D12CommandAllocator* Allocator )
+    {
+        uint64_t FenceValue = Fence.Signal();
+        FakeOf(Allocator)->m_RetiredFence = FenceValue;
+        FakeOf(Allocator)->m_InUse = false;
+        Pool.DiscardAllocator(FenceValue, Allocator);
+        return FenceValue;
+    }
+
+    // The pool gives each thread a cache for the first pool of a type that it uses, so every check runs on a thread
+    // of its own.  Pools must outlive the threads that used them.
+    template <typename Function>
+    void OnNewThread( Function Func )
+    {
+        std::thread Thread(Func);
+        Thread.join();
+    }
+
+    //
+    // Self test
+    //
+
+    void TestFenceOrder( void )
+    {
+        FakeFence Fence;
+        FakeAllocatorProvider Provider(Fence);
+        CommandAllocatorPool Pool(D3D12_COMMAND_LIST_TYPE_DIRECT, &Provider);
+        Pool.Create(nullptr);
+
+        // Record on another thread and retire four allocators out of fence order.  Two stay in that thread's cache
+        // until it exits, then everything is in the shared queue.
+        ID3D12CommandAllocator* Allocators[4];
+        uint64_t Fences[4];
+        OnNewThread([&]()
+        {
+            for (uint32_t i = 0; i < 4; ++i)
+                Allocators[i] = Begin(Pool, Fence);
+            for (uint32_t i = 0; i < 4; ++i)
+                Fences[i] = Fence.Signal();
+
+            const uint32_t Order[4] = { 3, 0, 2, 1 };
+            for (uint32_t i : Order)
+            {
+                FakeOf(Allocators[i])->m_RetiredFence = Fences[i];
+                FakeOf(Allocators[i])->m_InUse = false;
+                Pool.DiscardAllocator(Fences[i], Allocators[i]);
+            }
+        });
+        Check(Provider.m_NumCreated == 4, "four allocators were created");
+        Check(Pool.GetOldestPendingFence() == Fences[0], "an exiting thread returns its cached allocators to the pool");
+
+        // Only the oldest fence has completed.  The FIFO the pool used to keep had fence 4 at its front, so it would
+        // have created a new allocator here.
+        Fence.Complete(Fences[0]);
+        ID3D12CommandAllocator* First = Begin(Pool, Fence);
+        Check(First == Allocators[0], "the allocator with the oldest fence is reused first");
+        Check(Provider.m_NumCreated == 4, "a retired allocator is reused while any is ready");
+
+        Fence.Complete(Fences[2]);
+        ID3D12CommandAllocator* Second = Begin(Pool, Fence);
+        ID3D12CommandAllocator* Third = Begin(Pool, Fence);
+        Check(Second == Allocators[1] && Third == Allocators[2], "allocators come back in fence order");
+        ID3D12CommandAllocator* Fourth = Begin(Pool, Fence);
+        Check(Fourth != Allocators[3] && Provider.m_NumCreated == 5, "an allocator whose fence is pending is not reused");
+
+        End(Pool, Fence, First);
+        End(Pool, Fence, Second);
+        End(Pool, Fence, Third);
+        End(Pool, Fence, Fourth);
+
+        CommandAllocatorPool::Statistics Stats = Pool.GetStatistics();
+        Check(Stats.NumCreated == 5 && Stats.NumReused == 3, "creations and reuses are counted");
+    }
+
+    void TestThreadCache( void )
+    {
+        FakeFence Fence;
+        FakeAllocatorProvider Provider(Fence);
+        CommandAllocatorPool Pool(D3D12_COMMAND_LIST_TYPE_DIRECT, &Provider);
+        Pool.Create(nullptr);
+
+        // A thread whose submissions complete one behind cycles through the two allocators in its own cache
+        OnNewThread([&]()
+        {
+            for (uint32_t Frame = 0; Frame < 1000; ++Frame)
+            {
+                ID3D12CommandAllocator* Allocator = Begin(Pool, Fence);
+                Fence.Complete(End(Pool, Fence, Allocator) - 1);
+            }
+        });
+
+        CommandAllocatorPool::Statistics Stats = Pool.GetStatistics();
+        Check(Stats.NumCreated == 2, "one submission in flight while recording the next needs two allocators");
+        Check(Stats.NumReused == 998, "every later request reuses an allocator");
+        Check(Stats.NumThreadCacheHits == 998, "a thread reuses its own allocators without going through the pool");
+
+        // One more in flight than the cache holds, and the oldest goes through the shared queue instead
+        OnNewThread([&]()
+        {
+            for (uint32_t Frame = 0; Frame < 1000; ++Frame)
+            {
+                ID3D12CommandAllocator* Allocator = Begin(Pool, Fence);
+                Fence.Complete(End(Pool, Fence, Allocator) - 2);
+            }
+        });
+
+        Stats = Pool.GetStatistics();
+        Check(Stats.NumCreated <= 4, "a thread with more in flight than it caches shares through the pool");
+        Check(Stats.NumThreadCacheHits == 998, "allocators evicted from a full cache are not cache hits");
+
+        // Shutdown() releases everything, including what a thread still has cached
+        std::atomic<bool> ShutDown(false);
+        OnNewThread([&]()
+        {
+            ID3D12CommandAllocator* a = Begin(Pool, Fence);
+            ID3D12CommandAllocator* b = Begin(Pool, Fence);
+            End(Pool, Fence, a);
+            End(Pool, Fence, b);
+            Fence.Complete(Fence.GetLastSignaled());
+
+            Pool.Shutdown();
+            ShutDown = true;
+            Check(Provider.m_LiveAllocators == 0, "Shutdown() releases every allocator");
+
+            uint32_t Created = Provider.m_NumCreated;
+            ID3D12CommandAllocator* c = Begin(Pool, Fence);
+            Check(Provider.m_NumCreated == Created + 1, "a thread cache does not outlive Shutdown()");
+            End(Pool, Fence, c);
+        });
+        Check(ShutDown, "the pool was shut down");
+    }
+
+    void TestCap( void )
+    {
+        FakeFence Fence;
+        FakeAllocatorProvider Provider(Fence);
+        CommandAllocatorPool Pool(D3D12_COMMAND_LIST_TYPE_DIRECT, &Provider);
+        Pool.Create(nullptr, 4);
+
+        OnNewThread([&]()
+        {
+            // Four in flight fill the pool.  This thread keeps two of them cached; the other two are shared.
+            ID3D12CommandAllocator* Allocators[4];
+            for (uint32_t i = 0; i < 4; ++i)
+                Allocators[i] = Begin(Pool, Fence);
+            uint64_t Fences[4];
+            for (uint32_t i = 0; i < 4; ++i)
+                Fences[i] = End(Pool, Fence, Allocators[i]);
+
+            Check(Begin(Pool, Fence) == nullptr, "a capped pool refuses a request while its allocators are in flight");
+            Check(Pool.GetStatistics().NumStalled == 1, "the refused request is counted");
+            Check(Pool.GetOldestPendingFence() == Fences[0], "the caller is told which fence to wait for");
+
+            // What CommandQueue::RequestAllocator does next
+            Fence.Complete(Pool.GetOldestPendingFence());
+            ID3D12CommandAllocator* Reused = Begin(Pool, Fence);
+            Check(Reused == Allocators[0], "waiting for the oldest fence frees an allocator");
+            Check(Provider.m_NumCreated == 4, "the cap holds");
+            End(Pool, Fence, Reused);
+        });
+    }
+
+    struct Workload
+    {
+        uint32_t Threads;
+        uint32_t SubmissionsPerThread;
+        uint32_t MaxAllocators; // The pool's cap, 0 for none
+        uint32_t GpuLag;        // Submissions the GPU stays behind by
+    };
+
+    struct RunResult
+    {
+        double RequestsPerSecond;
+        CommandAllocatorPool::Statistics Stats;
+    };
+
+    // Worker threads record and submit as fast as they can.  After each submission the pretend GPU catches up to a
+    // few submissions behind the newest, whichever thread made them.  A capped pool makes workers wait on the
+    // oldest fence, like CommandQueue does.
+    RunResult Run( const Workload& Work )
+    {
+        FakeFence Fence;
+        FakeAllocatorProvider Provider(Fence);
+        CommandAllocatorPool Pool(D3D12_COMMAND_LIST_TYPE_DIRECT, &Provider);
+        Pool.Create(nullptr, Work.MaxAllocators);
+
+        std::vector<std::thread> Threads;
+        auto StartTime = std::chrono::high_resolution_clock::now();
+        for (uint32_t t = 0; t < Work.Threads; ++t)
+        {
+            Threads.emplace_back([&]()
+            {
+                for (uint32_t i = 0; i < Work.SubmissionsPerThread; )
+                {
+                    ID3D12CommandAllocator* Allocator = Begin(Pool, Fence);
+                    if (Allocator == nullptr)
+                    {
+                        uint64_t Oldest = Pool.GetOldestPendingFence();
+                        // The GPU only moves when someone submits, and every other worker may be waiting too
+                        Fence.Complete(Oldest);
+                        continue;
+                    }
+
+                    uint64_t Submitted = End(Pool, Fence, Allocator);
+                    if (Submitted > Work.GpuLag)
+                        Fence.Complete(Submitted - Work.GpuLag);
+                    ++i;
+                }
+            });
+        }
+        for (std::thread& Thread : Threads)
+            Thread.join();
+        auto EndTime = std::chrono::high_resolution_clock::now();
+
+        RunResult Result;
+        Result.Stats = Pool.GetStatistics();
+        Result.RequestsPerSecond = (double)Work.Threads * Work.SubmissionsPerThread /
+            std::chrono::duration<double>(EndTime - StartTime).count();
+
+        Check(Result.Stats.NumCreated + Result.Stats.NumReused == (uint64_t)Work.Threads * Work.SubmissionsPerThread,
+            "every submission had an allocator");
+        Check(Result.Stats.NumCreated == Provider.m_NumCreated, "the pool counts what the provider created");
+
+        Pool.Shutdown();
+        Check(Provider.m_LiveAllocators == 0, "Shutdown() releases every allocator");
+        return Result;
+    }
+
+    void TestThreads( void )
+    {
+        Workload Unbounded = { 8, 5000, 0, 1 };
+        RunResult Result = Run(Unbounded);
+        Check(Result.Stats.NumThreadCacheHits > 0, "threads reuse allocators from their own caches");
+        Check(Result.Stats.NumStalled == 0, "an unbounded pool never refuses a request");
+
+        // The cap gives way only while every spare allocator sits in some thread's cache, two per thread
+        Workload Capped = { 8, 5000, 12, 3 };
+        Result = Run(Capped);
+        Check(Result.Stats.NumCreated <= 12 + 8 * 2, "a capped pool stays near its cap");
+    }
+
+    int SelfTest( void )
+    {
+        OnNewThread(TestFenceOrder);
+        OnNewThread(TestThreadCache);
+        OnNewThread(TestCap);
+        OnNewThread(TestThreads);
+
+        return 0;
+    }
+
+    //
+    // Benchmark
+    //
+
+    int Bench( uint32_t MaxThreads )
+    {
+        const uint32_t kSubmissions = 200000;
+        printf("%u submissions per thread, %u hardware threads\n", kSubmissions, std::thread::hardware_concurrency());
+        printf("%8s %12s %16s %16s %12s\n", "threads", "GPU behind", "requests (M/s)", "cache hits (%)", "allocators");
+
+        // A thread's cache holds two allocators, so it only helps while the GPU is close behind
+        for (uint32_t NumThreads = 1; NumThreads <= MaxThreads; NumThreads *= 2)
+        {
+            for (uint32_t GpuLag : { 1u, 4u })
+            {
+                Workload Work = { NumThreads, kSubmissions, 0, GpuLag };
+                RunResult Result = Run(Work);
+                uint64_t Requests = Result.Stats.NumCreated + Result.Stats.NumReused;
+                printf("%8u %12u %16.2f %16.1f %12llu\n", NumThreads, GpuLag, Result.RequestsPerSecond * 1e-6,
+                    100.0 * Result.Stats.NumThreadCacheHits / Requests, (unsigned long long)Result.Stats.NumCreated);
+            }
+        }
+
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "bench", "[max threads]", 1, []( int ArgCount, char* Args[] )
+        {
+            uint32_t MaxThreads = TestHarness::GetCountArgument(ArgCount, Args, 0, std::max(1u, std::thread::hardware_concurrency()));
+            return MaxThreads == 0 ? TestHarness::kBadArguments : Bench(MaxThreads);
+        } },
+    };
+    return TestHarness::RunCommand(argc, argv, "CommandAllocatorPoolTest", kCommands);
+}
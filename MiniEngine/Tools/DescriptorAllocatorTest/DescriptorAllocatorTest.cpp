@@ -0,0 +1,470 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking DescriptorAllocator's recycling (DescriptorHeap.cpp) without a device.  Heaps come
+// from a stub provider that hands out made-up handle ranges, and the test keeps its own map of which descriptors
+// are handed out, so a descriptor given to two owners at once, or one outside every heap, is caught.
+//
+//   DescriptorAllocatorTest selftest
+//       Checks that freed singles and ranges are reused before a new heap is created, that free neighbors merge
+//       within a heap but never across heaps, that handles from before DestroyAll() are dropped, and a
+//       multithreaded run whose magazines are returned when the threads exit.
+//   DescriptorAllocatorTest bench [max threads]
+//       Allocates and frees descriptors on 1, 2, 4 ... threads and reports operations per second for single
+//       descriptors (per-thread magazines) and for small ranges (shared free lists).
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "pch.h"
+#include "DescriptorHeap.h"
+#include "../TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+// DescriptorHeap.cpp only touches the device when no provider is given
+namespace Graphics
+{
+    ID3D12Device* g_Device = nullptr;
+}
+
+using TestHarness::Check;
+
+namespace
+{
+    const uint32_t kHeapSize = 256; // DescriptorAllocator::sm_NumDescriptorsPerHeap
+    const uint32_t kDescriptorSize = 32;
+
+    // Heaps are laid out back to back, so that a free range at the end of one heap sits right next to a free range
+    // at the start of the next.  Each descriptor has an owner count that the tests raise and lower as they
+    // allocate and free.
+    class StubHeapProvider : public DescriptorHeapProvider
+    {
+    public:
+        static const uint32_t kMaxHeaps = 64;
+
+        StubHeapProvider() : m_NumHeaps(0), m_Owners(kMaxHeaps * kHeapSize) {}
+
+        D3D12_CPU_DESCRIPTOR_HANDLE CreateHeap( D3D12_DESCRIPTOR_HEAP_TYPE, uint32_t NumDescriptors ) override
+        {
+            Check(NumDescriptors == kHeapSize, "heaps are requested at the expected size");
+            uint32_t Heap = m_NumHeaps++;
+            Check(Heap < kMaxHeaps, "the provider has room for another heap");
+
+            D3D12_CPU_DESCRIPTOR_HANDLE Start;
+            Start.ptr = kBase + (size_t)Heap * kHeapSize * kDescriptorSize;
+            return Start;
+        }
+
+        uint32_t GetDescriptorSize( D3D12_DESCRIPTOR_HEAP_TYPE ) override { return kDescriptorSize; }
+
+        // Returns false when any descriptor in the range lies outside the heaps or is already owned
+        bool Acquire( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count )
+        {
+            size_t First;
+            if (!IndexOf(Handle, Count, First))
+                return false;
+
+            bool Ok = true;
+            for (uint32_t i = 0; i < Count; ++i)
+            {
+                if (m_Owners[First + i].fetch_add(1) != 0)
+                    Ok = false;
+            }
+            return Ok;
+        }
+
+        void Release( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count )
+        {
+            size_t First;
+            if (IndexOf(Handle, Count, First))
+            {
+                for (uint32_t i = 0; i < Count; ++i)
+                    m_Owners[First + i].fetch_sub(1);
+            }
+        }
+
+        uint32_t NumHeaps( void ) const { return m_NumHeaps; }
+        uint32_t HeapOf( D3D12_CPU_DESCRIPTOR_HANDLE Handle ) const { return (uint32_t)((Handle.ptr - kBase) / (kHeapSize * kDescriptorSize)); }
+
+    private:
+        static const size_t kBase = 0x100000;
+
+        bool IndexOf( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count, size_t& First ) const
+        {
+            if (Handle.ptr < kBase || (Handle.ptr - kBase) % kDescriptorSize != 0)
+                return false;
+
+            First = (Handle.ptr - kBase) / kDescriptorSize;
+            return First + Count <= (size_t)m_NumHeaps * kHeapSize && First / kHeapSize == (First + Count - 1) / kHeapSize;
+        }
+
+        std::atomic<uint32_t> m_NumHeaps;
+        std::vector<std::atomic<int>> m_Owners;
+    };
+
+    struct Allocation
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE Handle;
+        uint32_t Count;
+    };
+
+    Allocation Allocate( DescriptorAllocator& Allocator, StubHeapProvider& Provider, uint32_t Count )
+    {
+        Allocation a = { Allocator.Allocate(Count), Count };
+        Check(Provider.Acquire(a.Handle, Count), "every allocated descriptor lies in one heap and has no other owner");
+        return a;
+    }
+
+    void Free( DescriptorAllocator& Allocator, StubHeapProvider& Provider, const Allocation& a )
+    {
+        Provider.Release(a.Handle, a.Count);
+        Allocator.Free(a.Handle, a.Count);
+    }
+
+    // Each allocator's magazines belong to the threads that use it, so every check runs on a thread of its own and
+    // starts with empty magazines.
+    template <typename Function>
+    void OnNewThread( Function Func )
+    {
+        std::thread Thread(Func);
+        Thread.join();
+    }
+
+    //
+    // Self test
+    //
+
+    void TestSingles( void )
+    {
+        StubHeapProvider Provider;
+        DescriptorAllocator Allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, &Provider);
+
+        // Create and destroy views of a few hundred short-lived resources, a handful at a time
+        std::vector<Allocation> Live;
+        for (uint32_t Round = 0; Round < 2000; ++Round)
+        {
+            for (uint32_t i = 0; i < 40; ++i)
+                Live.push_back(Allocate(Allocator, Provider, 1));
+            for (const Allocation& a : Live)
+                Free(Allocator, Provider, a);
+            Live.clear();
+        }
+
+        Check(Provider.NumHeaps() == 1, "freed single descriptors are reused instead of creating heaps");
+
+        DescriptorAllocatorStats Stats = Allocator.GetStats();
+        Check(Stats.NumAllocations == 80000 && Stats.NumFrees == 80000, "allocations and frees are counted");
+        Check(Stats.NumInUse == 0, "nothing is in use after everything is freed");
+        Check(Stats.NumMagazineHits > 0, "single descriptors come from the thread's magazine");
+
+        // A handle that was never allocated, and an empty range, are ignored
+        D3D12_CPU_DESCRIPTOR_HANDLE Unknown;
+        Unknown.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
+        uint32_t RecycleCount = DescriptorAllocator::GetRecycleCount();
+        Allocator.Free(Unknown, 1);
+        Allocator.Free(Allocate(Allocator, Provider, 1).Handle, 0);
+        Check(DescriptorAllocator::GetRecycleCount() == RecycleCount, "unknown handles and empty ranges are not recycled");
+        Check(Allocator.GetStats().NumFrees == 80000, "unknown handles and empty ranges are not counted as frees");
+    }
+
+    void TestRanges( void )
+    {
+        StubHeapProvider Provider;
+        DescriptorAllocator Allocator(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, &Provider);
+
+        // Fill one heap with ranges, free every other one, then the rest: the gaps merge back into one block
+        std::vector<Allocation> Ranges;
+        for (uint32_t i = 0; i < 8; ++i)
+            Ranges.push_back(Allocate(Allocator, Provider, 32));
+        Check(Provider.NumHeaps() == 1, "eight 32-descriptor ranges fit in one heap");
+
+        for (uint32_t i = 0; i < 8; i += 2)
+            Free(Allocator, Provider, Ranges[i]);
+        DescriptorAllocatorStats Stats = Allocator.GetStats();
+        Check(Stats.NumFreeBlocks == 4 && Stats.LargestFreeBlock == 32, "separated frees stay separate blocks");
+        Check(Stats.Fragmentation > 0.5f, "separated frees are reported as fragmented");
+
+        for (uint32_t i = 1; i < 8; i += 2)
+            Free(Allocator, Provider, Ranges[i]);
+        Stats = Allocator.GetStats();
+        Check(Stats.NumFreeBlocks == 1 && Stats.LargestFreeBlock == kHeapSize, "free neighbors merge into one block");
+        Check(Stats.Fragmentation == 0.0f, "one free block is not fragmented");
+
+        // A range larger than any of the originals comes out of the merged block
+        Allocation Big = Allocate(Allocator, Provider, 200);
+        Check(Provider.NumHeaps() == 1, "a merged block serves a larger range");
+
+        // Splitting the remainder and asking for sizes from every class still reuses the heap
+        std::vector<Allocation> Small;
+        for (uint32_t Count : { 2u, 3u, 5u, 8u, 13u, 21u })
+            Small.push_back(Allocate(Allocator, Provider, Count));
+        Check(Provider.NumHeaps() == 1, "the remainder of a split block is reused");
+
+        Free(Allocator, Provider, Big);
+        for (const Allocation& a : Small)
+            Free(Allocator, Provider, a);
+        Stats = Allocator.GetStats();
+        Check(Stats.NumInUse == 0 && Stats.NumFreeBlocks == 1, "the heap is whole again once everything is freed");
+    }
+
+    void TestHeapBoundaries( void )
+    {
+        StubHeapProvider Provider;
+        DescriptorAllocator Allocator(D3D12_DESCRIPTOR_HEAP_TYPE_RTV, &Provider);
+
+        // Two whole heaps, adjacent in the stub's address space
+        Allocation First = Allocate(Allocator, Provider, kHeapSize);
+        Allocation Second = Allocate(Allocator, Provider, kHeapSize);
+        Check(Provider.NumHeaps() == 2, "each whole-heap range gets a heap");
+        Check(Second.Handle.ptr == First.Handle.ptr + kHeapSize * kDescriptorSize, "the stub heaps are adjacent");
+
+        Free(Allocator, Provider, Second);
+        Free(Allocator, Provider, First);
+        DescriptorAllocatorStats Stats = Allocator.GetStats();
+        Check(Stats.NumFreeBlocks == 2, "free ranges do not merge across heaps");
+
+        // So a range spanning the seam can never be handed out
+        std::vector<Allocation> Ranges;
+        for (uint32_t i = 0; i < 4; ++i)
+            Ranges.push_back(Allocate(Allocator, Provider, 128));
+        Check(Provider.NumHeaps() == 2, "both heaps are reused");
+        for (const Allocation& a : Ranges)
+            Free(Allocator, Provider, a);
+
+        // The tail of a heap too small for the next request is kept rather than stranded
+        Allocation Most = Allocate(Allocator, Provider, 250);
+        Allocation Whole = Allocate(Allocator, Provider, kHeapSize);
+        Allocation Tail = Allocate(Allocator, Provider, 6);
+        Check(Provider.NumHeaps() == 2, "the tail left by a large range is reused");
+        Free(Allocator, Provider, Most);
+        Free(Allocator, Provider, Whole);
+        Free(Allocator, Provider, Tail);
+    }
+
+    void TestDestroyAll( void )
+    {
+        StubHeapProvider Provider;
+        DescriptorAllocator Allocator(D3D12_DESCRIPTOR_HEAP_TYPE_DSV, &Provider);
+
+        // Ranges go through the shared lists, which know which heaps exist
+        std::vector<Allocation> Before;
+        for (uint32_t i = 0; i < 20; ++i)
+            Before.push_back(Allocate(Allocator, Provider, 4 + i % 3));
+
+        DescriptorAllocator::DestroyAll();
+
+        // Views of resources destroyed after the heaps point at nothing, and must not be handed out again
+        for (const Allocation& a : Before)
+            Free(Allocator, Provider, a);
+
+        DescriptorAllocatorStats Stats = Allocator.GetStats();
+        Check(Stats.NumHeaps == 0 && Stats.NumFreeListed == 0, "handles from before DestroyAll() are dropped");
+        Check(Stats.NumInUse == 0, "dropped handles leave the in-use count alone");
+
+        std::vector<Allocation> After;
+        for (uint32_t i = 0; i < 60; ++i)
+            After.push_back(Allocate(Allocator, Provider, i % 3 == 0 ? 4 : 1));
+        Check(Provider.NumHeaps() == 2, "DestroyAll() starts over with a new heap");
+        for (const Allocation& a : After)
+            Check(Provider.HeapOf(a.Handle) != 0, "nothing is handed out from a destroyed heap");
+        for (const Allocation& a : After)
+            Free(Allocator, Provider, a);
+        Check(Allocator.GetStats().NumInUse == 0, "the new heap's descriptors are all returned");
+    }
+
+    void TestRandom( void )
+    {
+        StubHeapProvider Provider;
+        DescriptorAllocator Allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, &Provider);
+
+        // Mostly single views with the odd table-sized range, about 600 live at once
+        std::mt19937 Rng(7);
+        std::vector<Allocation> Live;
+        uint32_t LiveCount = 0, Peak = 0;
+        for (uint32_t Step = 0; Step < 200000; ++Step)
+        {
+            bool ShouldAllocate = Live.empty() || (Rng() % 1200) >= LiveCount;
+            if (ShouldAllocate)
+            {
+                uint32_t Count = Rng() % 8 == 0 ? 1 + Rng() % 24 : 1;
+                Live.push_back(Allocate(Allocator, Provider, Count));
+                LiveCount += Count;
+                Peak = std::max(Peak, LiveCount);
+            }
+            else
+            {
+                size_t Index = Rng() % Live.size();
+                LiveCount -= Live[Index].Count;
+                Free(Allocator, Provider, Live[Index]);
+                Live[Index] = Live.back();
+                Live.pop_back();
+            }
+        }
+
+        DescriptorAllocatorStats Stats = Allocator.GetStats();
+        Check(Stats.NumInUse == LiveCount, "the in-use count matches the test's own count");
+
+        // Each heap may strand a partly used tail and magazines hold up to a batch; anything beyond that would be a leak
+        Check(Provider.NumHeaps() <= (Peak + 64) / (kHeapSize - 32) + 2, "churn stays within a few heaps of the peak");
+
+        for (const Allocation& a : Live)
+            Free(Allocator, Provider, a);
+        Check(Allocator.GetStats().NumInUse == 0, "everything is returned");
+    }
+
+    void TestMagazineExit( void )
+    {
+        StubHeapProvider Provider;
+        DescriptorAllocator Allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, &Provider);
+
+        // One allocation fills the thread's magazine with a batch; the rest stay cached there until the thread exits
+        uint32_t ListedWhileRunning = ~0u;
+        OnNewThread([&]()
+        {
+            Free(Allocator, Provider, Allocate(Allocator, Provider, 1));
+            ListedWhileRunning = Allocator.GetStats().NumFreeListed;
+        });
+
+        DescriptorAllocatorStats Stats = Allocator.GetStats();
+        Check(ListedWhileRunning == 0, "a running thread keeps its magazine");
+        Check(Stats.NumFreeListed == 16 && Stats.NumFreeBlocks == 1, "an exiting thread returns its magazine");
+        Check(Stats.NumInUse == 0, "nothing is in use after the thread exits");
+    }
+
+    void TestThreads( void )
+    {
+        StubHeapProvider Provider;
+        DescriptorAllocator Allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, &Provider);
+
+        const uint32_t kThreads = 8;
+        std::vector<std::vector<Allocation>> Leftovers(kThreads);
+        std::vector<std::thread> Threads;
+        for (uint32_t t = 0; t < kThreads; ++t)
+        {
+            Threads.emplace_back([&, t]()
+            {
+                std::mt19937 Rng(100 + t);
+                std::vector<Allocation>& Live = Leftovers[t];
+                for (uint32_t Step = 0; Step < 40000; ++Step)
+                {
+                    if (Live.size() < 64 && (Live.empty() || Rng() % 2 == 0))
+                        Live.push_back(Allocate(Allocator, Provider, Rng() % 6 == 0 ? 1 + Rng() % 8 : 1));
+                    else
+                    {
+                        size_t Index = Rng() % Live.size();
+                        Free(Allocator, Provider, Live[Index]);
+                        Live[Index] = Live.back();
+                        Live.pop_back();
+                    }
+                }
+            });
+        }
+        for (std::thread& Thread : Threads)
+            Thread.join();
+
+        // No more than 64 descriptors per thread in use, up to 32 more per magazine and a stranded tail per heap
+        Check(Provider.NumHeaps() <= (kThreads * (64 * 8 + 32)) / (kHeapSize - 32) + 2, "threads reuse each other's descriptors");
+
+        // What the workers left behind is freed here, on another thread
+        uint32_t LeftoverCount = 0;
+        for (const std::vector<Allocation>& Live : Leftovers)
+        {
+            for (const Allocation& a : Live)
+            {
+                LeftoverCount += a.Count;
+                Free(Allocator, Provider, a);
+            }
+        }
+
+        DescriptorAllocatorStats Stats = Allocator.GetStats();
+        Check(LeftoverCount > 0, "the workers left descriptors to free");
+        Check(Stats.NumInUse == 0 && Stats.NumAllocations == Stats.NumFrees, "every allocation is freed once");
+    }
+
+    int SelfTest( void )
+    {
+        OnNewThread(TestSingles);
+        OnNewThread(TestRanges);
+        OnNewThread(TestHeapBoundaries);
+        OnNewThread(TestDestroyAll);
+        OnNewThread(TestRandom);
+        OnNewThread(TestMagazineExit);
+        OnNewThread(TestThreads);
+
+        return 0;
+    }
+
+    //
+    // Benchmark
+    //
+
+    const uint32_t kOpsPerThread = 400000;
+
+    // Returns allocate/free pairs per second.  Each thread keeps a small working set and replaces one entry per step.
+    double RunThreads( uint32_t NumThreads, uint32_t Count )
+    {
+        StubHeapProvider Provider;
+        DescriptorAllocator Allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, &Provider);
+
+        std::vector<std::thread> Threads;
+        auto Begin = std::chrono::high_resolution_clock::now();
+        for (uint32_t t = 0; t < NumThreads; ++t)
+        {
+            Threads.emplace_back([&]()
+            {
+                D3D12_CPU_DESCRIPTOR_HANDLE Live[16];
+                for (uint32_t i = 0; i < 16; ++i)
+                    Live[i] = Allocator.Allocate(Count);
+                for (uint32_t i = 0; i < kOpsPerThread; ++i)
+                {
+                    Allocator.Free(Live[i & 15], Count);
+                    Live[i & 15] = Allocator.Allocate(Count);
+                }
+                for (uint32_t i = 0; i < 16; ++i)
+                    Allocator.Free(Live[i], Count);
+            });
+        }
+        for (std::thread& Thread : Threads)
+            Thread.join();
+        auto End = std::chrono::high_resolution_clock::now();
+
+        return (double)NumThreads * kOpsPerThread / std::chrono::duration<double>(End - Begin).count();
+    }
+
+    int Bench( uint32_t MaxThreads )
+    {
+        printf("%u allocate/free pairs per thread, %u hardware threads\n", kOpsPerThread, std::thread::hardware_concurrency());
+        printf("%8s %20s %20s\n", "threads", "singles (M/s)", "4-ranges (M/s)");
+
+        for (uint32_t NumThreads = 1; NumThreads <= MaxThreads; NumThreads *= 2)
+            printf("%8u %20.2f %20.2f\n", NumThreads, RunThreads(NumThreads, 1) * 1e-6, RunThreads(NumThreads, 4) * 1e-6);
+
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "bench", "[max threads]", 1, []( int ArgCount, char* Args[] )
+        {
+            uint32_t MaxThreads = TestHarness::GetCountArgument(ArgCount, Args, 0, std::max(1u, std::thread::hardware_concurrency()));
+            return MaxThreads == 0 ? TestHarness::kBadArguments : Bench(MaxThreads);
+        } },
+    };
+    return TestHarness::RunCommand(argc, argv, "DescriptorAllocatorTest", kCommands);
+}
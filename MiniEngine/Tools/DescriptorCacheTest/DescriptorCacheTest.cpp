@@ -0,0 +1,850 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking the descriptor table reuse in DynamicDescriptorHeap (DynamicDescriptorHeap.cpp and
+// DescriptorTableReuseCache.cpp) against a fake device.  Tables are staged, copied and bound by the real
+// DynamicDescriptorHeap, given fake shader-visible heaps by the test's provider and bound on a fake command list.
+// The fake device's CopyDescriptors() counts what it copies and records which view ended up in each slot of the
+// heaps, so every bound table can be checked for the views it should hold.  Source descriptors that are recycled
+// come from a real DescriptorAllocator (DescriptorHeap.cpp).
+//
+//   DescriptorCacheTest selftest
+//       Checks hits, misses, collisions, unset slots, heap retirement, recycled descriptors and a long random run.
+//   DescriptorCacheTest frame
+//       Replays the descriptor tables of a ModelViewer-style frame (depth, shadow and color passes over the same
+//       meshes and materials, plus compute work with tables of its own) and reports, per frame, the descriptors
+//       that copying every bound table would take against the descriptors and CopyDescriptors() calls made.
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "pch.h"
+#include "DynamicDescriptorHeap.h"
+#include "DescriptorHeap.h"
+#include "DescriptorTableReuseCache.h"
+#include "../TestHarness.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// DynamicDescriptorHeap copies descriptors with the graphics device, which each test points at its fake
+namespace Graphics
+{
+    ID3D12Device* g_Device = nullptr;
+}
+
+using TestHarness::Check;
+
+namespace
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE Handle( size_t Ptr )
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE CpuHandle;
+        CpuHandle.ptr = Ptr;
+        return CpuHandle;
+    }
+
+    const UINT kDescriptorSize = 32;
+    const D3D12_DESCRIPTOR_HEAP_TYPE kViewHeap = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+
+    // Only the descriptor calls do anything.  Shader-visible heap slots are identified by their CPU address, and
+    // each remembers the source handle last copied into it and which view that handle held at the time.  Creating
+    // a view in a CPU descriptor gives it a new version.
+    class FakeDevice : public ID3D12Device
+    {
+    public:
+        FakeDevice() : m_CopyCalls(0), m_DescriptorsCopied(0), m_Errors(0), m_HeapCount(0) {}
+
+        // Every shader-visible heap gets its own range of addresses, whichever context asked for it
+        size_t NewHeap( void ) { return (size_t)(++m_HeapCount) << 32; }
+
+        // Whether the slot holds the view that the source handle holds now
+        bool Holds( size_t Dest, size_t SourcePtr ) const
+        {
+            auto It = m_Slots.find(Dest);
+            return It != m_Slots.end() && It->second.SourcePtr == SourcePtr && It->second.Version == VersionOf(SourcePtr);
+        }
+
+        uint64_t m_CopyCalls;
+        uint64_t m_DescriptorsCopied;
+        uint32_t m_Errors;
+
+        void STDMETHODCALLTYPE CopyDescriptors( UINT NumDestDescriptorRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* DestDescriptorRangeStarts,
+            const UINT* DestDescriptorRangeSizes, UINT NumSrcDescriptorRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* SrcDescriptorRangeStarts,
+            const UINT* SrcDescriptorRangeSizes, D3D12_DESCRIPTOR_HEAP_TYPE ) override
+        {
+            ++m_CopyCalls;
+
+            std::vector<size_t> Sources;
+            for (UINT i = 0; i < NumSrcDescriptorRanges; ++i)
+            {
+                UINT Size = SrcDescriptorRangeSizes == nullptr ? 1 : SrcDescriptorRangeSizes[i];
+                for (UINT j = 0; j < Size; ++j)
+                    Sources.push_back(SrcDescriptorRangeStarts[i].ptr + j * kDescriptorSize);
+            }
+
+            size_t Next = 0;
+            for (UINT i = 0; i < NumDestDescriptorRanges; ++i)
+            {
+                UINT Size = DestDescriptorRangeSizes == nullptr ? 1 : DestDescriptorRangeSizes[i];
+                for (UINT j = 0; j < Size && Next < Sources.size(); ++j)
+                    m_Slots[DestDescriptorRangeStarts[i].ptr + j * kDescriptorSize] = Copy(Sources[Next++]);
+            }
+
+            if (Next != Sources.size())
+                ++m_Errors;
+            m_DescriptorsCopied += Sources.size();
+        }
+
+        void STDMETHODCALLTYPE CopyDescriptorsSimple( UINT NumDescriptors, D3D12_CPU_DESCRIPTOR_HANDLE DestDescriptorRangeStart,
+            D3D12_CPU_DESCRIPTOR_HANDLE SrcDescriptorRangeStart, D3D12_DESCRIPTOR_HEAP_TYPE ) override
+        {
+            ++m_CopyCalls;
+            for (UINT i = 0; i < NumDescriptors; ++i)
+                m_Slots[DestDescriptorRangeStart.ptr + i * kDescriptorSize] = Copy(SrcDescriptorRangeStart.ptr + i * kDescriptorSize);
+            m_DescriptorsCopied += NumDescriptors;
+        }
+
+        UINT STDMETHODCALLTYPE GetDescriptorHandleIncrementSize( D3D12_DESCRIPTOR_HEAP_TYPE ) override { return kDescriptorSize; }
+
+        HRESULT STDMETHODCALLTYPE QueryInterface( REFIID, void** PpvObject ) override { *PpvObject = nullptr; return E_NOINTERFACE; }
+        ULONG STDMETHODCALLTYPE AddRef( void ) override { return 1; }
+        ULONG STDMETHODCALLTYPE Release( void ) override { return 1; }
+        HRESULT STDMETHODCALLTYPE GetPrivateData( REFGUID, UINT*, void* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateData( REFGUID, UINT, const void* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateDataInterface( REFGUID, const IUnknown* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetName( LPCWSTR ) override { return S_OK; }
+        UINT STDMETHODCALLTYPE GetNodeCount( void ) override { return 1; }
+        HRESULT STDMETHODCALLTYPE CreateCommandQueue( const D3D12_COMMAND_QUEUE_DESC*, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CreateGraphicsPipelineState( const D3D12_GRAPHICS_PIPELINE_STATE_DESC*, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CreateComputePipelineState( const D3D12_COMPUTE_PIPELINE_STATE_DESC*, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CreateCommandList( UINT, D3D12_COMMAND_LIST_TYPE, ID3D12CommandAllocator*, ID3D12PipelineState*, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CheckFeatureSupport( D3D12_FEATURE, void*, UINT ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CreateDescriptorHeap( const D3D12_DESCRIPTOR_HEAP_DESC*, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CreateRootSignature( UINT, const void*, SIZE_T, REFIID, void** ) override { return E_NOTIMPL; }
+        void STDMETHODCALLTYPE CreateConstantBufferView( const D3D12_CONSTANT_BUFFER_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE ) override {}
+        void STDMETHODCALLTYPE CreateShaderResourceView( ID3D12Resource*, const D3D12_SHADER_RESOURCE_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE DestDescriptor ) override { ++m_Versions[DestDescriptor.ptr]; }
+        void STDMETHODCALLTYPE CreateUnorderedAccessView( ID3D12Resource*, ID3D12Resource*, const D3D12_UNORDERED_ACCESS_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE ) override {}
+        void STDMETHODCALLTYPE CreateRenderTargetView( ID3D12Resource*, const D3D12_RENDER_TARGET_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE ) override {}
+        void STDMETHODCALLTYPE CreateDepthStencilView( ID3D12Resource*, const D3D12_DEPTH_STENCIL_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE ) override {}
+        void STDMETHODCALLTYPE CreateSampler( const D3D12_SAMPLER_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE ) override {}
+        D3D12_RESOURCE_ALLOCATION_INFO STDMETHODCALLTYPE GetResourceAllocationInfo( UINT, UINT, const D3D12_RESOURCE_DESC* ) override { D3D12_RESOURCE_ALLOCATION_INFO Info = {}; return Info; }
+        D3D12_HEAP_PROPERTIES STDMETHODCALLTYPE GetCustomHeapProperties( UINT, D3D12_HEAP_TYPE ) override { D3D12_HEAP_PROPERTIES Props = {}; return Props; }
+        HRESULT STDMETHODCALLTYPE CreateCommittedResource( const D3D12_HEAP_PROPERTIES*, D3D12_HEAP_FLAGS, const D3D12_RESOURCE_DESC*, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CreateHeap( const D3D12_HEAP_DESC*, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CreatePlacedResource( ID3D12Heap*, UINT64, const D3D12_RESOURCE_DESC*, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CreateReservedResource( const D3D12_RESOURCE_DESC*, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CreateSharedHandle( ID3D12DeviceChild*, const SECURITY_ATTRIBUTES*, DWORD, LPCWSTR, HANDLE* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE OpenSharedHandle( HANDLE, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE OpenSharedHandleByName( LPCWSTR, DWORD, HANDLE* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE MakeResident( UINT, ID3D12Pageable* const* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE Evict( UINT, ID3D12Pageable* const* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CreateFence( UINT64, D3D12_FENCE_FLAGS, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE GetDeviceRemovedReason( void ) override { return S_OK; }
+        void STDMETHODCALLTYPE GetCopyableFootprints( const D3D12_RESOURCE_DESC*, UINT, UINT, UINT64, D3D12_PLACED_SUBRESOURCE_FOOTPRINT*, UINT*, UINT64*, UINT64* ) override {}
+        HRESULT STDMETHODCALLTYPE CreateQueryHeap( const D3D12_QUERY_HEAP_DESC*, REFIID, void** ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetStablePowerState( BOOL ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE CreateCommandSignature( const D3D12_COMMAND_SIGNATURE_DESC*, ID3D12RootSignature*, REFIID, void** ) override { return E_NOTIMPL; }
+        void STDMETHODCALLTYPE GetResourceTiling( ID3D12Resource*, UINT*, D3D12_PACKED_MIP_INFO*, D3D12_TILE_SHAPE*, UINT*, UINT, D3D12_SUBRESOURCE_TILING* ) override {}
+        LUID STDMETHODCALLTYPE GetAdapterLuid( void ) override { LUID Luid = {}; return Luid; }
+
+    private:
+        struct Slot
+        {
+            size_t SourcePtr;
+            uint32_t Version;
+        };
+
+        uint32_t VersionOf( size_t SourcePtr ) const
+        {
+            auto It = m_Versions.find(SourcePtr);
+            return It == m_Versions.end() ? 0 : It->second;
+        }
+
+        Slot Copy( size_t SourcePtr ) const
+        {
+            Slot Entry = { SourcePtr, VersionOf(SourcePtr) };
+            return Entry;
+        }
+
+        std::unordered_map<size_t, Slot> m_Slots;
+        std::unordered_map<size_t, uint32_t> m_Versions;
+        uint32_t m_HeapCount;
+    };
+
+    // A shader-visible heap with no memory behind it.  Its CPU and GPU addresses are the same.
+    class FakeDescriptorHeap : public ID3D12DescriptorHeap
+    {
+    public:
+        FakeDescriptorHeap( D3D12_DESCRIPTOR_HEAP_TYPE Type, size_t Base ) : m_Base(Base), m_Type(Type) {}
+
+        D3D12_DESCRIPTOR_HEAP_DESC STDMETHODCALLTYPE GetDesc( void ) override
+        {
+            D3D12_DESCRIPTOR_HEAP_DESC Desc = {};
+            Desc.Type = m_Type;
+            Desc.NumDescriptors = DynamicDescriptorHeap::kNumDescriptorsPerHeap;
+            Desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+            return Desc;
+        }
+        D3D12_CPU_DESCRIPTOR_HANDLE STDMETHODCALLTYPE GetCPUDescriptorHandleForHeapStart( void ) override { return Handle(m_Base); }
+        D3D12_GPU_DESCRIPTOR_HANDLE STDMETHODCALLTYPE GetGPUDescriptorHandleForHeapStart( void ) override
+        {
+            D3D12_GPU_DESCRIPTOR_HANDLE CpuHandle;
+            CpuHandle.ptr = m_Base;
+            return CpuHandle;
+        }
+
+        HRESULT STDMETHODCALLTYPE QueryInterface( REFIID, void** PpvObject ) override { *PpvObject = nullptr; return E_NOINTERFACE; }
+        ULONG STDMETHODCALLTYPE AddRef( void ) override { return 1; }
+        ULONG STDMETHODCALLTYPE Release( void ) override { return 1; }
+        HRESULT STDMETHODCALLTYPE GetPrivateData( REFGUID, UINT*, void* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateData( REFGUID, UINT, const void* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateDataInterface( REFGUID, const IUnknown* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetName( LPCWSTR ) override { return S_OK; }
+        HRESULT STDMETHODCALLTYPE GetDevice( REFIID, void** PpvDevice ) override { *PpvDevice = nullptr; return E_NOTIMPL; }
+
+        size_t m_Base;
+
+    private:
+        D3D12_DESCRIPTOR_HEAP_TYPE m_Type;
+    };
+
+    // A command list that only remembers the descriptor table bound to each root parameter.
+    class FakeCommandList : public ID3D12GraphicsCommandList
+    {
+    public:
+        FakeCommandList() : m_TableCalls(0)
+        {
+            memset(m_GraphicsTables, 0, sizeof(m_GraphicsTables));
+            memset(m_ComputeTables, 0, sizeof(m_ComputeTables));
+        }
+
+        void STDMETHODCALLTYPE SetGraphicsRootDescriptorTable( UINT RootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor ) override
+        {
+            m_GraphicsTables[RootParameterIndex] = (size_t)BaseDescriptor.ptr;
+            ++m_TableCalls;
+        }
+
+        void STDMETHODCALLTYPE SetComputeRootDescriptorTable( UINT RootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor ) override
+        {
+            m_ComputeTables[RootParameterIndex] = (size_t)BaseDescriptor.ptr;
+            ++m_TableCalls;
+        }
+
+        size_t m_GraphicsTables[16];
+        size_t m_ComputeTables[16];
+        uint64_t m_TableCalls;
+
+        HRESULT STDMETHODCALLTYPE QueryInterface( REFIID, void** PpvObject ) override { *PpvObject = nullptr; return E_NOINTERFACE; }
+        ULONG STDMETHODCALLTYPE AddRef( void ) override { return 1; }
+        ULONG STDMETHODCALLTYPE Release( void ) override { return 1; }
+        HRESULT STDMETHODCALLTYPE GetPrivateData( REFGUID, UINT*, void* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateData( REFGUID, UINT, const void* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateDataInterface( REFGUID, const IUnknown* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetName( LPCWSTR ) override { return S_OK; }
+        HRESULT STDMETHODCALLTYPE GetDevice( REFIID, void** PpvDevice ) override { *PpvDevice = nullptr; return E_NOTIMPL; }
+        D3D12_COMMAND_LIST_TYPE STDMETHODCALLTYPE GetType( void ) override { return D3D12_COMMAND_LIST_TYPE_DIRECT; }
+
+        HRESULT STDMETHODCALLTYPE Close( void ) override { return S_OK; }
+        HRESULT STDMETHODCALLTYPE Reset( ID3D12CommandAllocator*, ID3D12PipelineState* ) override { return S_OK; }
+        void STDMETHODCALLTYPE ClearState( ID3D12PipelineState* ) override {}
+        void STDMETHODCALLTYPE DrawInstanced( UINT, UINT, UINT, UINT ) override {}
+        void STDMETHODCALLTYPE DrawIndexedInstanced( UINT, UINT, UINT, INT, UINT ) override {}
+        void STDMETHODCALLTYPE Dispatch( UINT, UINT, UINT ) override {}
+        void STDMETHODCALLTYPE CopyBufferRegion( ID3D12Resource*, UINT64, ID3D12Resource*, UINT64, UINT64 ) override {}
+        void STDMETHODCALLTYPE CopyTextureRegion( const D3D12_TEXTURE_COPY_LOCATION*, UINT, UINT, UINT, const D3D12_TEXTURE_COPY_LOCATION*, const D3D12_BOX* ) override {}
+        void STDMETHODCALLTYPE CopyResource( ID3D12Resource*, ID3D12Resource* ) override {}
+        void STDMETHODCALLTYPE CopyTiles( ID3D12Resource*, const D3D12_TILED_RESOURCE_COORDINATE*, const D3D12_TILE_REGION_SIZE*, ID3D12Resource*, UINT64, D3D12_TILE_COPY_FLAGS ) override {}
+        void STDMETHODCALLTYPE ResolveSubresource( ID3D12Resource*, UINT, ID3D12Resource*, UINT, DXGI_FORMAT ) override {}
+        void STDMETHODCALLTYPE IASetPrimitiveTopology( D3D12_PRIMITIVE_TOPOLOGY ) override {}
+        void STDMETHODCALLTYPE RSSetViewports( UINT, const D3D12_VIEWPORT* ) override {}
+        void STDMETHODCALLTYPE RSSetScissorRects( UINT, const D3D12_RECT* ) override {}
+        void STDMETHODCALLTYPE OMSetBlendFactor( const FLOAT[4] ) override {}
+        void STDMETHODCALLTYPE OMSetStencilRef( UINT ) override {}
+        void STDMETHODCALLTYPE SetPipelineState( ID3D12PipelineState* ) override {}
+        void STDMETHODCALLTYPE ExecuteBundle( ID3D12GraphicsCommandList* ) override {}
+        void STDMETHODCALLTYPE ResourceBarrier( UINT, const D3D12_RESOURCE_BARRIER* ) override {}
+        void STDMETHODCALLTYPE SetDescriptorHeaps( UINT, ID3D12DescriptorHeap* const* ) override {}
+        void STDMETHODCALLTYPE SetComputeRootSignature( ID3D12RootSignature* ) override {}
+        void STDMETHODCALLTYPE SetGraphicsRootSignature( ID3D12RootSignature* ) override {}
+        void STDMETHODCALLTYPE SetComputeRoot32BitConstant( UINT, UINT, UINT ) override {}
+        void STDMETHODCALLTYPE SetGraphicsRoot32BitConstant( UINT, UINT, UINT ) override {}
+        void STDMETHODCALLTYPE SetComputeRoot32BitConstants( UINT, UINT, const void*, UINT ) override {}
+        void STDMETHODCALLTYPE SetGraphicsRoot32BitConstants( UINT, UINT, const void*, UINT ) override {}
+        void STDMETHODCALLTYPE SetComputeRootConstantBufferView( UINT, D3D12_GPU_VIRTUAL_ADDRESS ) override {}
+        void STDMETHODCALLTYPE SetGraphicsRootConstantBufferView( UINT, D3D12_GPU_VIRTUAL_ADDRESS ) override {}
+        void STDMETHODCALLTYPE SetComputeRootShaderResourceView( UINT, D3D12_GPU_VIRTUAL_ADDRESS ) override {}
+        void STDMETHODCALLTYPE SetGraphicsRootShaderResourceView( UINT, D3D12_GPU_VIRTUAL_ADDRESS ) override {}
+        void STDMETHODCALLTYPE SetComputeRootUnorderedAccessView( UINT, D3D12_GPU_VIRTUAL_ADDRESS ) override {}
+        void STDMETHODCALLTYPE SetGraphicsRootUnorderedAccessView( UINT, D3D12_GPU_VIRTUAL_ADDRESS ) override {}
+        void STDMETHODCALLTYPE IASetIndexBuffer( const D3D12_INDEX_BUFFER_VIEW* ) override {}
+        void STDMETHODCALLTYPE IASetVertexBuffers( UINT, UINT, const D3D12_VERTEX_BUFFER_VIEW* ) override {}
+        void STDMETHODCALLTYPE SOSetTargets( UINT, UINT, const D3D12_STREAM_OUTPUT_BUFFER_VIEW* ) override {}
+        void STDMETHODCALLTYPE OMSetRenderTargets( UINT, const D3D12_CPU_DESCRIPTOR_HANDLE*, BOOL, const D3D12_CPU_DESCRIPTOR_HANDLE* ) override {}
+        void STDMETHODCALLTYPE ClearDepthStencilView( D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_CLEAR_FLAGS, FLOAT, UINT8, UINT, const D3D12_RECT* ) override {}
+        void STDMETHODCALLTYPE ClearRenderTargetView( D3D12_CPU_DESCRIPTOR_HANDLE, const FLOAT[4], UINT, const D3D12_RECT* ) override {}
+        void STDMETHODCALLTYPE ClearUnorderedAccessViewUint( D3D12_GPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE, ID3D12Resource*, const UINT[4], UINT, const D3D12_RECT* ) override {}
+        void STDMETHODCALLTYPE ClearUnorderedAccessViewFloat( D3D12_GPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE, ID3D12Resource*, const FLOAT[4], UINT, const D3D12_RECT* ) override {}
+        void STDMETHODCALLTYPE DiscardResource( ID3D12Resource*, const D3D12_DISCARD_REGION* ) override {}
+        void STDMETHODCALLTYPE BeginQuery( ID3D12QueryHeap*, D3D12_QUERY_TYPE, UINT ) override {}
+        void STDMETHODCALLTYPE EndQuery( ID3D12QueryHeap*, D3D12_QUERY_TYPE, UINT ) override {}
+        void STDMETHODCALLTYPE ResolveQueryData( ID3D12QueryHeap*, D3D12_QUERY_TYPE, UINT, UINT, ID3D12Resource*, UINT64 ) override {}
+        void STDMETHODCALLTYPE SetPredication( ID3D12Resource*, UINT64, D3D12_PREDICATION_OP ) override {}
+        void STDMETHODCALLTYPE SetMarker( UINT, const void*, UINT ) override {}
+        void STDMETHODCALLTYPE BeginEvent( UINT, const void*, UINT ) override {}
+        void STDMETHODCALLTYPE EndEvent( void ) override {}
+        void STDMETHODCALLTYPE ExecuteIndirect( ID3D12CommandSignature*, UINT, ID3D12Resource*, UINT64, ID3D12Resource*, UINT64 ) override {}
+    };
+
+    const uint32_t kNumTables = 4;
+    const uint32_t kTableSize = 16;
+
+    // A root signature of nothing but descriptor tables.  Only the layout that DynamicDescriptorHeap parses is
+    // filled in; it is never finalized.
+    class TestRootSignature : public RootSignature
+    {
+    public:
+        TestRootSignature() : RootSignature(kNumTables)
+        {
+            m_DescriptorTableBitMap = (1 << kNumTables) - 1;
+            m_SamplerTableBitMap = 0;
+            for (uint32_t i = 0; i < kNumTables; ++i)
+                m_DescriptorTableSize[i] = kTableSize;
+        }
+    };
+
+    // One command context's view descriptor heap.  The context is the heap's provider:  it creates fake heaps and
+    // records which one is bound.  It also remembers what it staged, so that every bound table can be checked.
+    class TestContext : public DynamicDescriptorHeapProvider
+    {
+    public:
+        TestContext( FakeDevice& Device, bool ComputeContext = false ) :
+            m_Device(Device), m_Compute(ComputeContext), m_Heap(*this, kViewHeap), m_BoundHeap(nullptr), m_FenceValue(0)
+        {
+            m_HeapsRequested = 0;
+            m_HeapsDiscarded = 0;
+            m_DescriptorsStaged = 0;
+            m_TablesCopied = 0;
+            m_TablesReused = 0;
+            memset(m_Assigned, 0, sizeof(m_Assigned));
+            memset(m_Staged, 0, sizeof(m_Staged));
+            m_Stale = 0;
+            SetRootSignature();
+        }
+
+        ID3D12DescriptorHeap* RequestHeap( D3D12_DESCRIPTOR_HEAP_TYPE HeapType ) override
+        {
+            m_Heaps.emplace_back(new FakeDescriptorHeap(HeapType, m_Device.NewHeap()));
+            ++m_HeapsRequested;
+            return m_Heaps.back().get();
+        }
+
+        void DiscardHeaps( D3D12_DESCRIPTOR_HEAP_TYPE, uint64_t, const std::vector<ID3D12DescriptorHeap*>& UsedHeaps ) override
+        {
+            m_HeapsDiscarded += (uint32_t)UsedHeaps.size();
+        }
+
+        void SetDescriptorHeap( D3D12_DESCRIPTOR_HEAP_TYPE, ID3D12DescriptorHeap* HeapPtr ) override
+        {
+            m_BoundHeap = static_cast<FakeDescriptorHeap*>(HeapPtr);
+        }
+
+        void Stage( uint32_t RootIndex, uint32_t Offset, uint32_t Count, const D3D12_CPU_DESCRIPTOR_HANDLE Handles[] )
+        {
+            if (m_Compute)
+                m_Heap.SetComputeDescriptorHandles(RootIndex, Offset, Count, Handles);
+            else
+                m_Heap.SetGraphicsDescriptorHandles(RootIndex, Offset, Count, Handles);
+
+            for (uint32_t i = 0; i < Count; ++i)
+                m_Staged[RootIndex][Offset + i] = Handles[i];
+            m_Assigned[RootIndex] |= ((1 << Count) - 1) << Offset;
+            m_Stale |= 1 << RootIndex;
+        }
+
+        // A draw or dispatch
+        void Commit( void )
+        {
+            if (m_Compute)
+                m_Heap.CommitComputeRootDescriptorTables(&m_List);
+            else
+                m_Heap.CommitGraphicsRootDescriptorTables(&m_List);
+
+            // What copying every table staged since the last draw would take
+            for (uint32_t RootIndex = 0; RootIndex < kNumTables; ++RootIndex)
+            {
+                if ((m_Stale & (1 << RootIndex)) == 0)
+                    continue;
+                for (uint32_t Bits = m_Assigned[RootIndex]; Bits != 0; Bits &= Bits - 1)
+                    ++m_DescriptorsStaged;
+            }
+            m_Stale = 0;
+        }
+
+        // Whether the table bound to the root parameter lies in the bound heap and holds the views staged for it
+        bool BoundTableMatches( uint32_t RootIndex ) const
+        {
+            if (m_Assigned[RootIndex] == 0)
+                return true;
+
+            size_t Table = m_Compute ? m_List.m_ComputeTables[RootIndex] : m_List.m_GraphicsTables[RootIndex];
+            if (m_BoundHeap == nullptr || Table < m_BoundHeap->m_Base ||
+                Table >= m_BoundHeap->m_Base + DynamicDescriptorHeap::kNumDescriptorsPerHeap * kDescriptorSize)
+            {
+                return false;
+            }
+
+            for (uint32_t Entry = 0; Entry < kTableSize; ++Entry)
+            {
+                if ((m_Assigned[RootIndex] & (1 << Entry)) != 0 && !m_Device.Holds(Table + Entry * kDescriptorSize, m_Staged[RootIndex][Entry].ptr))
+                    return false;
+            }
+            return true;
+        }
+
+        bool BoundTablesMatch( void ) const
+        {
+            for (uint32_t RootIndex = 0; RootIndex < kNumTables; ++RootIndex)
+            {
+                if (!BoundTableMatches(RootIndex))
+                    return false;
+            }
+            return true;
+        }
+
+        // CommandContext::Finish() retires the heaps with the command list, and the next user sets a root signature
+        void Finish( void )
+        {
+            DynamicDescriptorHeap::Statistics Before = DynamicDescriptorHeap::GetStatistics(kViewHeap);
+            m_Heap.CleanupUsedHeaps(++m_FenceValue);
+            DynamicDescriptorHeap::Statistics After = DynamicDescriptorHeap::GetStatistics(kViewHeap);
+            m_TablesCopied += After.TablesCopied - Before.TablesCopied;
+            m_TablesReused += After.TablesReused - Before.TablesReused;
+
+            m_BoundHeap = nullptr;
+            memset(m_Assigned, 0, sizeof(m_Assigned));
+            m_Stale = 0;
+            SetRootSignature();
+        }
+
+        uint32_t m_HeapsRequested;
+        uint32_t m_HeapsDiscarded;
+        uint64_t m_DescriptorsStaged;
+        uint64_t m_TablesCopied;    // Updated by Finish()
+        uint64_t m_TablesReused;    // Updated by Finish()
+        FakeCommandList m_List;
+
+    private:
+        void SetRootSignature( void )
+        {
+            if (m_Compute)
+                m_Heap.ParseComputeRootSignature(m_RootSignature);
+            else
+                m_Heap.ParseGraphicsRootSignature(m_RootSignature);
+        }
+
+        FakeDevice& m_Device;
+        bool m_Compute;
+        TestRootSignature m_RootSignature;
+        DynamicDescriptorHeap m_Heap;
+        FakeDescriptorHeap* m_BoundHeap;
+        std::vector<std::unique_ptr<FakeDescriptorHeap>> m_Heaps;
+        uint64_t m_FenceValue;
+        uint32_t m_Assigned[kNumTables];
+        uint32_t m_Stale;
+        D3D12_CPU_DESCRIPTOR_HANDLE m_Staged[kNumTables][kTableSize];
+    };
+
+    // CPU descriptor heaps for a DescriptorAllocator, laid out back to back well away from the made-up handles
+    // of Source()
+    class StubHeapProvider : public DescriptorHeapProvider
+    {
+    public:
+        StubHeapProvider() : m_NumHeaps(0) {}
+
+        D3D12_CPU_DESCRIPTOR_HANDLE CreateHeap( D3D12_DESCRIPTOR_HEAP_TYPE, uint32_t NumDescriptors ) override
+        {
+            return Handle(0x10000000 + (size_t)(m_NumHeaps++) * NumDescriptors * kDescriptorSize);
+        }
+
+        uint32_t GetDescriptorSize( D3D12_DESCRIPTOR_HEAP_TYPE ) override { return kDescriptorSize; }
+
+    private:
+        uint32_t m_NumHeaps;
+    };
+
+    // Made-up CPU descriptors, spread out like those of a DescriptorAllocator
+    D3D12_CPU_DESCRIPTOR_HANDLE Source( uint32_t Index )
+    {
+        return Handle(0x1000 + Index * kDescriptorSize);
+    }
+
+    void SourceRange( uint32_t First, uint32_t Count, D3D12_CPU_DESCRIPTOR_HANDLE* Handles )
+    {
+        for (uint32_t i = 0; i < Count; ++i)
+            Handles[i] = Source(First + i);
+    }
+
+    int SelfTest( void )
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE TableA[6], TableB[6];
+        SourceRange(0, 6, TableA);
+        SourceRange(100, 6, TableB);
+
+        // The cache on its own
+        {
+            DescriptorTableReuseCache Cache(1024);
+            uint32_t Offset = 0;
+            size_t HashA = DescriptorTableReuseCache::HashTable(TableA, 0x3F);
+
+            Check(!Cache.Find(HashA, TableA, 0x3F, Offset), "an empty cache misses");
+            Cache.Insert(HashA, TableA, 0x3F, 40);
+            Check(Cache.Find(HashA, TableA, 0x3F, Offset) && Offset == 40, "a table just inserted is found");
+            Check(!Cache.Find(HashA, TableB, 0x3F, Offset), "a colliding hash with different handles misses");
+            Check(!Cache.Find(DescriptorTableReuseCache::HashTable(TableA, 0x1F), TableA, 0x1F, Offset), "fewer set slots is a different table");
+
+            D3D12_CPU_DESCRIPTOR_HANDLE Gap[6];
+            memcpy(Gap, TableA, sizeof(Gap));
+            Gap[2] = Source(999);
+            Check(DescriptorTableReuseCache::HashTable(Gap, 0x3B) == DescriptorTableReuseCache::HashTable(TableA, 0x3B),
+                "unset slots don't change the hash");
+
+            Cache.Validate(0);
+            Check(Cache.Find(HashA, TableA, 0x3F, Offset), "an unchanged recycle count keeps the cache");
+            Cache.Validate(1);
+            Check(!Cache.Find(HashA, TableA, 0x3F, Offset), "recycled descriptors empty the cache");
+            Cache.Insert(HashA, TableA, 0x3F, 40);
+            Cache.Clear();
+            Check(!Cache.Find(HashA, TableA, 0x3F, Offset), "Clear() empties the cache");
+        }
+
+        // Binding the same table again reuses the copy
+        {
+            FakeDevice Device;
+            Graphics::g_Device = &Device;
+            TestContext Context(Device);
+            Context.Stage(2, 0, 6, TableA);
+            Context.Commit();
+            Context.Stage(2, 0, 6, TableB);
+            Context.Commit();
+            Context.Stage(2, 0, 6, TableA);
+            Context.Commit();
+            Check(Context.BoundTablesMatch(), "a reused table holds its handles");
+            Check(Device.m_DescriptorsCopied == 12 && Context.m_List.m_TableCalls == 3, "the third bind copies nothing");
+
+            Context.Stage(2, 2, 1, &TableB[0]);
+            Context.Commit();
+            Check(Context.BoundTablesMatch() && Device.m_DescriptorsCopied == 18, "changing one handle copies the table");
+
+            Context.Finish();
+            Check(Context.m_TablesCopied == 3 && Context.m_TablesReused == 1, "statistics count copied and reused tables");
+            Check(Context.m_HeapsRequested == 1 && Context.m_HeapsDiscarded == 1, "one heap for the command list");
+        }
+
+        // Tables with unset slots, and tables of other root parameters
+        {
+            FakeDevice Device;
+            Graphics::g_Device = &Device;
+            TestContext Context(Device);
+            Context.Stage(1, 0, 2, TableA);
+            Context.Stage(1, 4, 2, TableA + 4);
+            Context.Commit();
+            Context.Stage(0, 0, 1, TableB);
+            Context.Commit();
+            Context.Stage(1, 0, 2, TableA);
+            Context.Commit();
+            Check(Context.BoundTablesMatch() && Device.m_DescriptorsCopied == 5, "tables with gaps are reused");
+
+            Context.Stage(0, 0, 2, TableA);
+            Context.Stage(0, 4, 2, TableA + 4);
+            Context.Commit();
+            Check(Context.BoundTablesMatch() && Device.m_DescriptorsCopied == 5, "a table is reused at another root parameter");
+        }
+
+        // Compute tables go through the same cache
+        {
+            FakeDevice Device;
+            Graphics::g_Device = &Device;
+            TestContext Context(Device, true);
+            Context.Stage(1, 0, 6, TableA);
+            Context.Stage(2, 0, 6, TableB);
+            Context.Commit();
+            Context.Stage(1, 0, 6, TableB);
+            Context.Stage(2, 0, 6, TableA);
+            Context.Commit();
+            Check(Context.BoundTablesMatch() && Device.m_DescriptorsCopied == 12, "compute tables are reused");
+        }
+
+        // Running out of heap space retires the heap and the cache with it
+        {
+            FakeDevice Device;
+            Graphics::g_Device = &Device;
+            TestContext Context(Device);
+            const uint32_t TablesPerHeap = DynamicDescriptorHeap::kNumDescriptorsPerHeap / 6;
+            for (uint32_t i = 0; i <= TablesPerHeap; ++i)
+            {
+                D3D12_CPU_DESCRIPTOR_HANDLE Table[6];
+                SourceRange(1000 + i * 6, 6, Table);
+                Context.Stage(2, 0, 6, Table);
+                Context.Commit();
+            }
+            Check(Context.m_HeapsRequested == 2 && Context.BoundTablesMatch(), "a full heap is retired for a new one");
+
+            uint64_t Copied = Device.m_DescriptorsCopied;
+            D3D12_CPU_DESCRIPTOR_HANDLE First[6];
+            SourceRange(1000, 6, First);
+            Context.Stage(2, 0, 6, First);
+            Context.Commit();
+            Check(Context.BoundTablesMatch() && Device.m_DescriptorsCopied == Copied + 6, "tables in a retired heap are not reused");
+
+            Context.Finish();
+            Check(Context.m_HeapsDiscarded == 2, "both heaps are discarded with the command list");
+        }
+
+        // A finished command list takes its heap and its tables with it
+        {
+            FakeDevice Device;
+            Graphics::g_Device = &Device;
+            TestContext Context(Device);
+            Context.Stage(2, 0, 6, TableA);
+            Context.Commit();
+            Context.Finish();
+            Context.Stage(2, 0, 6, TableA);
+            Context.Commit();
+            Check(Context.BoundTablesMatch() && Device.m_DescriptorsCopied == 12 && Context.m_HeapsRequested == 2,
+                "tables are copied again into the next command list's heap");
+        }
+
+        // A descriptor that is freed and allocated again names a new view, so a table holding it is copied again
+        // even though its handles haven't changed
+        {
+            FakeDevice Device;
+            Graphics::g_Device = &Device;
+            StubHeapProvider CpuHeaps;
+            DescriptorAllocator Allocator(kViewHeap, &CpuHeaps);
+            D3D12_CPU_DESCRIPTOR_HANDLE Views[6];
+            for (uint32_t i = 0; i < 6; ++i)
+            {
+                Views[i] = Allocator.Allocate(1);
+                Device.CreateShaderResourceView(nullptr, nullptr, Views[i]);
+            }
+
+            TestContext Context(Device);
+            Context.Stage(2, 0, 6, Views);
+            Context.Commit();
+            Context.Stage(2, 0, 6, TableB);
+            Context.Commit();
+            Context.Stage(2, 0, 6, Views);
+            Context.Commit();
+            Check(Context.BoundTablesMatch() && Device.m_DescriptorsCopied == 12, "views from an allocator are reused");
+
+            Allocator.Free(Views[3], 1);
+            D3D12_CPU_DESCRIPTOR_HANDLE Replacement = Allocator.Allocate(1);
+            Check(Replacement.ptr == Views[3].ptr, "the freed descriptor is handed out again");
+            Device.CreateShaderResourceView(nullptr, nullptr, Replacement);
+            Views[3] = Replacement;
+
+            Context.Stage(2, 0, 6, TableB);
+            Context.Commit();
+            Context.Stage(2, 0, 6, Views);
+            Context.Commit();
+            Check(Context.BoundTablesMatch(), "the table holds the new view, not the one copied before it was recycled");
+            Check(Device.m_DescriptorsCopied == 24, "tables are copied again after a descriptor is recycled");
+
+            Context.Finish();
+            Check(Context.m_TablesReused == 1, "only the table bound before the recycling was reused");
+        }
+
+        // A long random run, checked after every commit.  Descriptors are recycled now and then.
+        {
+            FakeDevice Device;
+            Graphics::g_Device = &Device;
+            StubHeapProvider CpuHeaps;
+            DescriptorAllocator Allocator(kViewHeap, &CpuHeaps);
+            D3D12_CPU_DESCRIPTOR_HANDLE Views[24];
+            for (uint32_t i = 0; i < 24; ++i)
+            {
+                Views[i] = Allocator.Allocate(1);
+                Device.CreateShaderResourceView(nullptr, nullptr, Views[i]);
+            }
+
+            TestContext Context(Device);
+            std::mt19937 Rng(7);
+            uint32_t Mismatches = 0;
+            for (uint32_t Step = 0; Step < 20000; ++Step)
+            {
+                if (Rng() % 4 == 0)
+                {
+                    uint32_t View = Rng() % 24;
+                    Allocator.Free(Views[View], 1);
+                    Views[View] = Allocator.Allocate(1);
+                    Device.CreateShaderResourceView(nullptr, nullptr, Views[View]);
+                }
+
+                uint32_t RootIndex = Rng() % kNumTables;
+                uint32_t Offset = Rng() % 8;
+                uint32_t Count = 1 + Rng() % 8;
+                D3D12_CPU_DESCRIPTOR_HANDLE Handles[8];
+                for (uint32_t i = 0; i < Count; ++i)
+                    Handles[i] = Views[Rng() % 24];
+                Context.Stage(RootIndex, Offset, Count, Handles);
+
+                if (Rng() % 500 == 0)
+                    Context.Finish();
+
+                // Only the table just staged is sure to hold live views.  The others may hold recycled ones.
+                Context.Commit();
+                if (!Context.BoundTableMatches(RootIndex))
+                    ++Mismatches;
+            }
+            Context.Finish();
+            Check(Mismatches == 0, "every bound table matches in the random run");
+            Check(Context.m_TablesReused > 0, "the random run reuses tables");
+            Check(Device.m_Errors == 0, "copy ranges add up");
+        }
+
+        return 0;
+    }
+
+    //
+    // Frame replay
+    //
+
+    struct Scene
+    {
+        std::vector<uint32_t> MeshMaterials;
+        std::vector<bool> MaterialIsCutout;
+    };
+
+    // A scene laid out like a typical converted model:  meshes are roughly grouped by material, but most
+    // materials show up in several places.
+    Scene BuildScene( uint32_t NumMeshes, uint32_t NumMaterials )
+    {
+        Scene Objects;
+        std::mt19937 Rng(11);
+        uint32_t Material = 0;
+        for (uint32_t i = 0; i < NumMeshes; ++i)
+        {
+            if (Rng() % 5 < 2)
+                Material = Rng() % NumMaterials;
+            Objects.MeshMaterials.push_back(Material);
+        }
+        for (uint32_t i = 0; i < NumMaterials; ++i)
+            Objects.MaterialIsCutout.push_back(Rng() % 4 == 0);
+        return Objects;
+    }
+
+    enum ObjectFilter { kOpaque = 1, kCutout = 2 };
+
+    // ModelViewer::RenderObjects():  the material table is staged when the material changes
+    void RenderObjects( TestContext& Context, const Scene& Objects, uint32_t Filter, uint32_t& Draws )
+    {
+        uint32_t MaterialIdx = 0xFFFFFFFFul;
+        for (uint32_t Material : Objects.MeshMaterials)
+        {
+            if (Material != MaterialIdx)
+            {
+                bool Cutout = Objects.MaterialIsCutout[Material];
+                if ((Filter & (Cutout ? kCutout : kOpaque)) == 0)
+                    continue;
+
+                MaterialIdx = Material;
+                D3D12_CPU_DESCRIPTOR_HANDLE Textures[6];
+                SourceRange(Material * 6, 6, Textures);
+                Context.Stage(2, 0, 6, Textures);
+            }
+            Context.Commit();
+            ++Draws;
+            Check(Context.BoundTablesMatch(), "draw sees its material's textures");
+        }
+    }
+
+    void RecordFrame( TestContext& GraphicsContext, TestContext& ComputeContext, const Scene& Objects, uint32_t NumMaterials, uint32_t& Draws )
+    {
+        // Depth prepass
+        RenderObjects(GraphicsContext, Objects, kOpaque, Draws);
+        RenderObjects(GraphicsContext, Objects, kCutout, Draws);
+
+        // SSAO, light grid and post effects each bind their own textures
+        for (uint32_t Dispatch = 0; Dispatch < 24; ++Dispatch)
+        {
+            D3D12_CPU_DESCRIPTOR_HANDLE Uavs[4], Srvs[4];
+            SourceRange(NumMaterials * 6 + Dispatch * 8, 4, Uavs);
+            SourceRange(NumMaterials * 6 + Dispatch * 8 + 4, 4, Srvs);
+            ComputeContext.Stage(1, 0, 4, Uavs);
+            ComputeContext.Stage(2, 0, 4, Srvs);
+            ComputeContext.Commit();
+            Check(ComputeContext.BoundTablesMatch(), "dispatch sees its textures");
+        }
+
+        // Sun shadow map
+        RenderObjects(GraphicsContext, Objects, kOpaque, Draws);
+        RenderObjects(GraphicsContext, Objects, kCutout, Draws);
+
+        // Color pass with the shared lighting textures
+        D3D12_CPU_DESCRIPTOR_HANDLE ExtraTextures[6];
+        SourceRange(NumMaterials * 6 + 1000, 6, ExtraTextures);
+        GraphicsContext.Stage(3, 0, 6, ExtraTextures);
+        RenderObjects(GraphicsContext, Objects, kOpaque, Draws);
+        RenderObjects(GraphicsContext, Objects, kCutout, Draws);
+
+        GraphicsContext.Finish();
+        ComputeContext.Finish();
+    }
+
+    int Frame( void )
+    {
+        const uint32_t kNumMeshes = 400;
+        const uint32_t kNumMaterials = 64;
+        const uint32_t kFrames = 8;
+        Scene Objects = BuildScene(kNumMeshes, kNumMaterials);
+
+        printf("%u meshes, %u materials, %u frames\n", kNumMeshes, kNumMaterials, kFrames);
+
+        FakeDevice Device;
+        Graphics::g_Device = &Device;
+        TestContext GraphicsContext(Device);
+        TestContext ComputeContext(Device, true);
+
+        uint32_t Draws = 0;
+        for (uint32_t FrameIndex = 0; FrameIndex < kFrames; ++FrameIndex)
+            RecordFrame(GraphicsContext, ComputeContext, Objects, kNumMaterials, Draws);
+
+        // Copying every table staged before a draw is the least that the heap would copy without reuse
+        uint64_t Staged = (GraphicsContext.m_DescriptorsStaged + ComputeContext.m_DescriptorsStaged) / kFrames;
+        uint64_t Copied = Device.m_DescriptorsCopied / kFrames;
+        printf("%12s %12s %12s %12s %12s %8s\n", "draws", "staged", "copied", "copy calls", "tables", "reused");
+        printf("%12u %12llu %12llu %12llu %12llu %8llu\n",
+            Draws / kFrames,
+            (unsigned long long)Staged,
+            (unsigned long long)Copied,
+            (unsigned long long)(Device.m_CopyCalls / kFrames),
+            (unsigned long long)((GraphicsContext.m_TablesCopied + ComputeContext.m_TablesCopied) / kFrames),
+            (unsigned long long)((GraphicsContext.m_TablesReused + ComputeContext.m_TablesReused) / kFrames));
+
+        Check(Device.m_Errors == 0, "copy ranges add up");
+        Check(Copied < Staged, "reuse copies fewer descriptors per frame than the tables staged");
+
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "frame", "", 0, []( int, char*[] ) { return Frame(); } },
+    };
+    return TestHarness::RunCommand(argc, argv, "DescriptorCacheTest", kCommands);
+}
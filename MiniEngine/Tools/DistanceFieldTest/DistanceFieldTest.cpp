@@ -0,0 +1,312 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking and timing SDFFontCreator's distance transform (SDFFontCreator/DistanceField.cpp)
+// against the brute force search it replaced.
+//
+//   DistanceFieldTest selftest
+//       Rasterizes a few glyph-like shapes at SDFFontCreator's 16x resolution:  a ring, an L, a diagonal stroke,
+//       hairlines and isolated pixels, random blobs, a solid block, an empty glyph and one cut off by the top of
+//       the cell.  Each is converted with both methods for several search radii and border sizes, and every
+//       texel must come out exactly the same.  The glyphs are painted side by side into one map, as the font
+//       atlas is, so writing outside a glyph's block is caught as well.
+//   DistanceFieldTest bench
+//       Reports glyphs per second for both methods at a few search radii.
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "DistanceField.h"
+#include "../TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+    // A 1-bit glyph bitmap laid out like FreeType's monochrome output
+    struct TestGlyph
+    {
+        const char* Name;
+        uint32_t Width; // In high-res pixels
+        uint32_t Rows;
+        uint32_t Pitch;
+        int32_t YShift; // Added to the canvas y offset; negative moves the glyph up into the border
+        std::vector<uint8_t> Bits;
+
+        TestGlyph( const char* GlyphName, uint32_t w, uint32_t h, int32_t Shift = 0 )
+            : Name(GlyphName), Width(w), Rows(h), Pitch((w + 7) / 8), YShift(Shift), Bits(Pitch * h, 0)
+        {
+        }
+
+        void Set( int32_t x, int32_t y )
+        {
+            if (x >= 0 && y >= 0 && (uint32_t)x < Width && (uint32_t)y < Rows)
+                Bits[y * Pitch + x / 8] |= (uint8_t)(0x80 >> (x & 7));
+        }
+
+        void FillRect( int32_t x0, int32_t y0, int32_t x1, int32_t y1 )
+        {
+            for (int32_t y = y0; y < y1; ++y)
+                for (int32_t x = x0; x < x1; ++x)
+                    Set(x, y);
+        }
+
+        void FillEllipse( float Cx, float Cy, float Rx, float Ry, bool Clear = false )
+        {
+            for (uint32_t y = 0; y < Rows; ++y)
+            {
+                for (uint32_t x = 0; x < Width; ++x)
+                {
+                    float Dx = (x + 0.5f - Cx) / Rx;
+                    float Dy = (y + 0.5f - Cy) / Ry;
+                    if (Dx * Dx + Dy * Dy > 1.0f)
+                        continue;
+                    if (Clear)
+                        Bits[y * Pitch + x / 8] &= (uint8_t)~(0x80 >> (x & 7));
+                    else
+                        Set(x, y);
+                }
+            }
+        }
+
+        // Where the canvas sits in the texel block, as LoadCanvas places it
+        Canvas GetCanvas( uint32_t BorderSize ) const
+        {
+            Canvas GlyphCanvas;
+            GlyphCanvas.bitmap = const_cast<uint8_t*>(Bits.data());
+            GlyphCanvas.pitch = Pitch;
+            GlyphCanvas.width = Width;
+            GlyphCanvas.rows = Rows;
+            GlyphCanvas.xOff = BorderSize * 16;
+            GlyphCanvas.yOff = (uint32_t)((int32_t)(BorderSize * 16) + YShift);
+            return GlyphCanvas;
+        }
+
+        uint32_t TexelsX( uint32_t BorderSize ) const { return (Width + 15) / 16 + BorderSize * 2; }
+        uint32_t TexelsY( uint32_t BorderSize ) const { return (Rows + 15) / 16 + BorderSize * 2; }
+    };
+
+    std::vector<TestGlyph> MakeGlyphs( void )
+    {
+        std::vector<TestGlyph> Glyphs;
+
+        Glyphs.emplace_back("ring", 176, 240);
+        Glyphs.back().FillEllipse(88.0f, 120.0f, 84.0f, 116.0f);
+        Glyphs.back().FillEllipse(88.0f, 120.0f, 52.0f, 80.0f, true);
+
+        Glyphs.emplace_back("L", 160, 240);
+        Glyphs.back().FillRect(8, 0, 44, 240);
+        Glyphs.back().FillRect(8, 204, 160, 240);
+
+        Glyphs.emplace_back("diagonal", 192, 224);
+        for (int32_t y = 0; y < 224; ++y)
+            Glyphs.back().FillRect(150 - y * 150 / 224, y, 150 - y * 150 / 224 + 28, y + 1);
+
+        // One pixel features put the most distinct parabolas into the lower envelope
+        Glyphs.emplace_back("hairlines", 144, 208);
+        for (int32_t x = 3; x < 144; x += 29)
+            Glyphs.back().FillRect(x, 0, x + 1, 208);
+        Glyphs.back().FillRect(0, 101, 144, 102);
+        for (int32_t i = 0; i < 40; ++i)
+            Glyphs.back().Set((i * 37) % 144, (i * 53) % 208);
+
+        Glyphs.emplace_back("blobs", 208, 240);
+        std::mt19937 Random(7);
+        for (uint32_t i = 0; i < 12; ++i)
+        {
+            float Cx = (float)(Random() % 208), Cy = (float)(Random() % 240);
+            float Rx = (float)(4 + Random() % 40), Ry = (float)(4 + Random() % 40);
+            Glyphs.back().FillEllipse(Cx, Cy, Rx, Ry, i % 4 == 3);
+        }
+
+        Glyphs.emplace_back("block", 128, 192);
+        Glyphs.back().FillRect(0, 0, 128, 192);
+
+        Glyphs.emplace_back("space", 96, 192);
+
+        // Starts above the texel block, which neither method searches
+        Glyphs.emplace_back("cut off", 160, 224, -40);
+        Glyphs.back().FillEllipse(80.0f, 60.0f, 70.0f, 90.0f);
+        Glyphs.back().FillRect(70, 0, 90, 224);
+
+        return Glyphs;
+    }
+
+    const float kUnwritten = 1000.0f;
+
+    // Paints every glyph side by side into one map, separated by a gap that neither method may write to
+    std::vector<float> PaintMap( const std::vector<TestGlyph>& Glyphs, uint32_t MaxDistance, uint32_t BorderSize,
+        bool BruteForce, uint32_t& MapWidth )
+    {
+        static const uint32_t kGap = 3;
+
+        MapWidth = kGap;
+        uint32_t MapHeight = 0;
+        for (const TestGlyph& Glyph : Glyphs)
+        {
+            MapWidth += Glyph.TexelsX(BorderSize) + kGap;
+            MapHeight = std::max(MapHeight, Glyph.TexelsY(BorderSize) + kGap * 2);
+        }
+
+        std::vector<float> Map(MapWidth * MapHeight, kUnwritten);
+        DistanceFieldScratch Scratch;
+
+        uint32_t x = kGap;
+        for (const TestGlyph& Glyph : Glyphs)
+        {
+            float* Dest = &Map[x + kGap * MapWidth];
+            if (BruteForce)
+                ComputeDistanceFieldBruteForce(Glyph.GetCanvas(BorderSize), Glyph.TexelsX(BorderSize), Glyph.TexelsY(BorderSize), MaxDistance, Dest, MapWidth);
+            else
+                ComputeDistanceField(Scratch, Glyph.GetCanvas(BorderSize), Glyph.TexelsX(BorderSize), Glyph.TexelsY(BorderSize), MaxDistance, Dest, MapWidth);
+            x += Glyph.TexelsX(BorderSize) + kGap;
+        }
+        return Map;
+    }
+
+    int SelfTest( void )
+    {
+        const std::vector<TestGlyph> Glyphs = MakeGlyphs();
+        const uint32_t kMaxDistances[] = { 1, 3, 6 };
+
+        for (uint32_t MaxDistance : kMaxDistances)
+        {
+            const uint32_t BorderSizes[] = { 0, MaxDistance };
+            for (uint32_t BorderSize : BorderSizes)
+            {
+                uint32_t NumTexels = 0;
+                for (const TestGlyph& Glyph : Glyphs)
+                    NumTexels += Glyph.TexelsX(BorderSize) * Glyph.TexelsY(BorderSize);
+
+                uint32_t MapWidth = 0;
+                const std::vector<float> Reference = PaintMap(Glyphs, MaxDistance, BorderSize, true, MapWidth);
+                const std::vector<float> Transform = PaintMap(Glyphs, MaxDistance, BorderSize, false, MapWidth);
+
+                uint32_t Mismatches = 0;
+                float MaxError = 0.0f;
+                for (size_t i = 0; i < Reference.size(); ++i)
+                {
+                    if (Reference[i] != Transform[i])
+                    {
+                        ++Mismatches;
+                        MaxError = std::max(MaxError, std::fabs(Reference[i] - Transform[i]));
+                    }
+                }
+
+                char Message[128];
+                snprintf(Message, sizeof(Message), "radius %u, border %u:  %u texels differ from the brute force search (by up to %g)",
+                    MaxDistance, BorderSize, Mismatches, MaxError);
+                Check(Mismatches == 0, Message);
+
+                snprintf(Message, sizeof(Message), "radius %u, border %u:  the transform must write exactly the glyph blocks", MaxDistance, BorderSize);
+                Check((uint32_t)std::count_if(Transform.begin(), Transform.end(), []( float d ) { return d != kUnwritten; }) == NumTexels, Message);
+            }
+        }
+
+        // A few properties of the field itself, so that both methods being wrong the same way shows up too
+        const uint32_t MaxDistance = 3;
+        for (const TestGlyph& Glyph : Glyphs)
+        {
+            const Canvas GlyphCanvas = Glyph.GetCanvas(MaxDistance);
+            const uint32_t NumTexelsX = Glyph.TexelsX(MaxDistance);
+            const uint32_t NumTexelsY = Glyph.TexelsY(MaxDistance);
+            std::vector<float> Field(NumTexelsX * NumTexelsY);
+            DistanceFieldScratch Scratch;
+            ComputeDistanceField(Scratch, GlyphCanvas, NumTexelsX, NumTexelsY, MaxDistance, Field.data(), NumTexelsX);
+
+            bool InRange = true, SignsMatch = true, BordersOutside = true;
+            for (uint32_t y = 0; y < NumTexelsY; ++y)
+            {
+                for (uint32_t x = 0; x < NumTexelsX; ++x)
+                {
+                    const float d = Field[x + y * NumTexelsX];
+                    const bool Covered = ReadCanvasBit(GlyphCanvas, x * 16 + 7, y * 16 + 7) && ReadCanvasBit(GlyphCanvas, x * 16 + 8, y * 16 + 7) &&
+                        ReadCanvasBit(GlyphCanvas, x * 16 + 7, y * 16 + 8) && ReadCanvasBit(GlyphCanvas, x * 16 + 8, y * 16 + 8);
+
+                    InRange &= d >= -1.0f && d <= 1.0f && d != 0.0f;
+                    SignsMatch &= (d > 0.0f) == Covered;
+                    if (x == 0 || x == NumTexelsX - 1 || y == NumTexelsY - 1)
+                        BordersOutside &= d < 0.0f;
+                }
+            }
+
+            std::string Name(Glyph.Name);
+            Check(InRange, (Name + ":  distances must be non-zero and within [-1, 1]").c_str());
+            Check(SignsMatch, (Name + ":  texels must be positive exactly where the glyph covers their center").c_str());
+            Check(BordersOutside, (Name + ":  the border must be outside the glyph").c_str());
+        }
+
+        {
+            // Far from the glyph the distance saturates at the search radius
+            const TestGlyph& Space = Glyphs[6];
+            const uint32_t NumTexelsX = Space.TexelsX(MaxDistance), NumTexelsY = Space.TexelsY(MaxDistance);
+            std::vector<float> Field(NumTexelsX * NumTexelsY);
+            DistanceFieldScratch Scratch;
+            ComputeDistanceField(Scratch, Space.GetCanvas(MaxDistance), NumTexelsX, NumTexelsY, MaxDistance, Field.data(), NumTexelsX);
+            Check(std::all_of(Field.begin(), Field.end(), []( float d ) { return d == -1.0f; }), "an empty glyph must be -1 everywhere");
+        }
+
+        return 0;
+    }
+
+    //
+    // Benchmark
+    //
+
+    double Seconds( std::chrono::high_resolution_clock::time_point Start )
+    {
+        return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - Start).count();
+    }
+
+    int Bench( void )
+    {
+        const std::vector<TestGlyph> Glyphs = MakeGlyphs();
+        const uint32_t kMaxDistances[] = { 2, 4, 8 };
+
+        printf("%zu glyphs of about 12x15 texels, glyphs per second on one thread\n", Glyphs.size());
+        printf("%-7s %14s %14s %8s\n", "radius", "transform", "brute force", "speedup");
+        for (uint32_t MaxDistance : kMaxDistances)
+        {
+            double Rate[2];
+            for (uint32_t BruteForce = 0; BruteForce < 2; ++BruteForce)
+            {
+                uint32_t NumGlyphs = 0;
+                uint32_t MapWidth = 0;
+                auto Start = std::chrono::high_resolution_clock::now();
+                do
+                {
+                    PaintMap(Glyphs, MaxDistance, MaxDistance, BruteForce != 0, MapWidth);
+                    NumGlyphs += (uint32_t)Glyphs.size();
+                }
+                while (Seconds(Start) < 0.5);
+                Rate[BruteForce] = NumGlyphs / Seconds(Start);
+            }
+            printf("%-7u %14.0f %14.0f %7.1fx\n", MaxDistance, Rate[0], Rate[1], Rate[0] / Rate[1]);
+        }
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "bench", "", 0, []( int, char*[] ) { return Bench(); } },
+    };
+    return TestHarness::RunCommand(argc, argv, "DistanceFieldTest", kCommands);
+}
@@ -0,0 +1,478 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking and timing ModelViewer's CPU light binner (LightBinner.cpp).
+//
+//   LightBinnerTest selftest
+//       Checks the binner on hand-placed lights, and checks that LightBinner::BinLights() gives
+//       exactly the same cells as the brute force LightBinner::BinLightsReference() for random
+//       cameras and lights, with and without depth slices.
+//   LightBinnerTest benchmark [max lights]
+//       Reports the 1920x1080 tiles binned per second for 1K to 64K lights.
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "LightBinner.h"
+#include "../TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using TestHarness::Check;
+using namespace Lighting;
+
+namespace
+{
+    struct TestCamera
+    {
+        float Position[3];
+        float Yaw;
+        float Pitch;
+        float VerticalFOV;
+        float NearClip;
+        float FarClip;
+    };
+
+    // Builds the view-projection matrix of a MiniEngine camera (right handed, looking down -Z,
+    // with a reversed-Z projection), stored one column after another like a Math::Matrix4.
+    void MakeViewProjMatrix( const TestCamera& Camera, uint32_t Width, uint32_t Height, float* Matrix )
+    {
+        // Rows of the view matrix: the camera's right, up and back axes, and the translation.
+        float Cy = std::cos(Camera.Yaw), Sy = std::sin(Camera.Yaw);
+        float Cp = std::cos(Camera.Pitch), Sp = std::sin(Camera.Pitch);
+        float Right[3] = { Cy, 0.0f, -Sy };
+        float Up[3] = { Sy * Sp, Cp, Cy * Sp };
+        float Back[3] = { Sy * Cp, -Sp, Cy * Cp };
+        const float* Axes[3] = { Right, Up, Back };
+
+        float View[4][4] = {};
+        for (int r = 0; r < 3; ++r)
+        {
+            View[r][0] = Axes[r][0];
+            View[r][1] = Axes[r][1];
+            View[r][2] = Axes[r][2];
+            View[r][3] = -(Axes[r][0] * Camera.Position[0] + Axes[r][1] * Camera.Position[1] + Axes[r][2] * Camera.Position[2]);
+        }
+        View[3][3] = 1.0f;
+
+        float Y = 1.0f / std::tan(Camera.VerticalFOV * 0.5f);
+        float X = Y * (float)Height / (float)Width;
+        float Q1 = Camera.NearClip / (Camera.FarClip - Camera.NearClip);
+        float Q2 = Q1 * Camera.FarClip;
+        float Proj[4][4] =
+        {
+            { X, 0.0f, 0.0f, 0.0f },
+            { 0.0f, Y, 0.0f, 0.0f },
+            { 0.0f, 0.0f, Q1, Q2 },
+            { 0.0f, 0.0f, -1.0f, 0.0f },
+        };
+
+        for (int r = 0; r < 4; ++r)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                float Sum = 0.0f;
+                for (int k = 0; k < 4; ++k)
+                    Sum += Proj[r][k] * View[k][c];
+                Matrix[c * 4 + r] = Sum;
+            }
+        }
+    }
+
+    LightGridDesc MakeDesc( const TestCamera& Camera, uint32_t Width, uint32_t Height, uint32_t TileDim, uint32_t SliceCount )
+    {
+        LightGridDesc Desc = {};
+        MakeViewProjMatrix(Camera, Width, Height, Desc.ViewProjMatrix);
+        Desc.ViewportWidth = Width;
+        Desc.ViewportHeight = Height;
+        Desc.TileDim = TileDim;
+        Desc.NearClip = Camera.NearClip;
+        Desc.FarClip = Camera.FarClip;
+        Desc.DepthSliceCount = SliceCount;
+        return Desc;
+    }
+
+    LightData MakeLight( float x, float y, float z, float Radius, uint32_t Type )
+    {
+        LightData Light = {};
+        Light.pos[0] = x;
+        Light.pos[1] = y;
+        Light.pos[2] = z;
+        Light.radiusSq = Radius * Radius;
+        Light.type = Type;
+        return Light;
+    }
+
+    // Lights scattered around the camera, most of them in front of it.
+    std::vector<LightData> MakeRandomLights( std::mt19937& Rng, uint32_t Count, float MinRadius, float MaxRadius, bool UnusedTypes )
+    {
+        std::uniform_real_distribution<float> Horizontal(-1500.0f, 1500.0f);
+        std::uniform_real_distribution<float> Vertical(-600.0f, 600.0f);
+        std::uniform_real_distribution<float> Depth(-3000.0f, 300.0f);
+        std::uniform_real_distribution<float> Radius(MinRadius, MaxRadius);
+
+        std::vector<LightData> Lights(Count);
+        for (LightData& Light : Lights)
+        {
+            uint32_t Type = Rng() % (UnusedTypes ? 4 : 3);
+            Light = MakeLight(Horizontal(Rng), Vertical(Rng), Depth(Rng), Radius(Rng), Type);
+        }
+        return Lights;
+    }
+
+    bool ContainsLight( const LightBinner& Binner, uint32_t Cell, uint32_t Light )
+    {
+        uint32_t Counts[LightBinner::kLightTypeCount];
+        const uint32_t* Lights = Binner.GetCellLights(Cell, Counts);
+        for (uint32_t i = 0; i < Binner.GetCellLightCount(Cell); ++i)
+        {
+            if (Lights[i] == Light)
+                return true;
+        }
+        return false;
+    }
+
+    bool SameCells( const LightBinner& a, const LightBinner& b )
+    {
+        if (a.GetCellCount() != b.GetCellCount() || a.GetTotalLightCount() != b.GetTotalLightCount())
+            return false;
+
+        for (uint32_t Cell = 0; Cell < a.GetCellCount(); ++Cell)
+        {
+            uint32_t CountsA[LightBinner::kLightTypeCount], CountsB[LightBinner::kLightTypeCount];
+            const uint32_t* LightsA = a.GetCellLights(Cell, CountsA);
+            const uint32_t* LightsB = b.GetCellLights(Cell, CountsB);
+            if (memcmp(CountsA, CountsB, sizeof(CountsA)) != 0 ||
+                memcmp(LightsA, LightsB, a.GetCellLightCount(Cell) * sizeof(uint32_t)) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    // Each cell should list its lights grouped by type, in increasing index within a type.
+    bool CellsAreOrdered( const LightBinner& Binner, const std::vector<LightData>& Lights )
+    {
+        for (uint32_t Cell = 0; Cell < Binner.GetCellCount(); ++Cell)
+        {
+            uint32_t Counts[LightBinner::kLightTypeCount];
+            const uint32_t* CellLights = Binner.GetCellLights(Cell, Counts);
+            for (uint32_t Type = 0; Type < LightBinner::kLightTypeCount; ++Type)
+            {
+                for (uint32_t i = 0; i < Counts[Type]; ++i)
+                {
+                    if (Lights[CellLights[i]].type != Type || (i > 0 && CellLights[i] <= CellLights[i - 1]))
+                        return false;
+                }
+                CellLights += Counts[Type];
+            }
+        }
+        return true;
+    }
+
+    void TestPlacedLights( void )
+    {
+        TestCamera Camera = { { 0.0f, 0.0f, 0.0f }, 0.0f, 0.0f, 0.7853981f, 1.0f, 1000.0f };
+        LightGridDesc Desc = MakeDesc(Camera, 1280, 720, 16, 0);
+
+        std::vector<LightData> Lights;
+        Lights.push_back(MakeLight(0.0f, 0.0f, -50.0f, 0.5f, 0));       // Small, in the middle of the screen
+        Lights.push_back(MakeLight(0.0f, 0.0f, 50.0f, 1.0f, 1));        // Behind the camera
+        Lights.push_back(MakeLight(0.0f, 0.0f, -500.0f, 5000.0f, 2));   // Covers everything
+        Lights.push_back(MakeLight(0.0f, 0.0f, -2000.0f, 10.0f, 0));    // Past the far plane, which only depth slices cull
+        Lights.push_back(MakeLight(0.0f, 0.0f, -50.0f, 1.0e6f, 3));     // Not a light type the grid lists
+
+        LightBinner Binner(2);
+        Binner.BinLights(Desc, Lights.data(), (uint32_t)Lights.size());
+
+        const uint32_t TileCount = Binner.GetTileCountX() * Binner.GetTileCountY();
+        Check(Binner.GetTileCountX() == 80 && Binner.GetTileCountY() == 45 && Binner.GetSliceCount() == 1, "tile counts");
+
+        uint32_t SmallLightTiles = 0;
+        bool BehindListed = false, EverywhereListed = true, OtherTypeListed = false;
+        for (uint32_t Tile = 0; Tile < TileCount; ++Tile)
+        {
+            SmallLightTiles += ContainsLight(Binner, Tile, 0) ? 1 : 0;
+            BehindListed |= ContainsLight(Binner, Tile, 1);
+            EverywhereListed &= ContainsLight(Binner, Tile, 2);
+            OtherTypeListed |= ContainsLight(Binner, Tile, 4);
+        }
+
+        // The small light is about 17 pixels across at the center of the screen, which is on the
+        // edge between two tiles, and may reach the tiles above and below them.
+        Check(SmallLightTiles >= 2 && SmallLightTiles <= 6, "a small light lands in only a few tiles");
+        Check(ContainsLight(Binner, Binner.GetCellIndex(39, 22), 0) && ContainsLight(Binner, Binner.GetCellIndex(40, 22), 0),
+            "a small light lands in the tiles at the center of the screen");
+        Check(!BehindListed, "a light behind the camera is culled");
+        Check(EverywhereListed, "a light around the camera lands in every tile");
+        Check(!OtherTypeListed, "lights of other types are not listed");
+
+        uint32_t Counts[LightBinner::kLightTypeCount];
+        const uint32_t* CenterLights = Binner.GetCellLights(Binner.GetCellIndex(40, 22), Counts);
+        Check(Counts[0] == 2 && Counts[1] == 0 && Counts[2] == 1 && CenterLights[0] == 0 && CenterLights[1] == 3 && CenterLights[2] == 2,
+            "the center tile lists the sphere lights and then the shadowed cone light");
+
+        // With depth slices, a small light only lands in the slice of its depth, and lights past
+        // the far plane are culled.
+        Desc.DepthSliceCount = 16;
+        Binner.BinLights(Desc, Lights.data(), (uint32_t)Lights.size());
+        Check(Binner.GetSliceCount() == 16, "slice count");
+        uint32_t Slice = Binner.GetDepthSlice(50.0f);
+        Check(Slice == 9, "the slice of a view depth of 50");
+        bool InSlice = false, InOtherSlice = false, FarListed = false;
+        for (uint32_t s = 0; s < 16; ++s)
+        {
+            bool Listed = ContainsLight(Binner, Binner.GetCellIndex(40, 22, s), 0);
+            (s == Slice ? InSlice : InOtherSlice) |= Listed;
+            FarListed |= ContainsLight(Binner, Binner.GetCellIndex(40, 22, s), 3);
+        }
+        Check(InSlice && !InOtherSlice, "a small light lands in only its own depth slice");
+        Check(!FarListed, "depth slices cull a light past the far plane");
+
+        // Tile depth bounds around the light keep it; bounds behind it cull it.  (Bounds in front of
+        // it may not, as the tile planes reach past the far end of the bounds.)
+        std::vector<float> DepthBounds(TileCount * 2);
+        for (uint32_t Tile = 0; Tile < TileCount; ++Tile)
+        {
+            DepthBounds[Tile * 2 + 0] = 45.0f / Camera.FarClip;
+            DepthBounds[Tile * 2 + 1] = 55.0f / Camera.FarClip;
+        }
+        Desc.DepthSliceCount = 0;
+        Desc.TileDepthBounds = DepthBounds.data();
+        Binner.BinLights(Desc, Lights.data(), 1);
+        Check(ContainsLight(Binner, Binner.GetCellIndex(40, 22), 0), "tile depth bounds around a light keep it");
+
+        for (uint32_t Tile = 0; Tile < TileCount; ++Tile)
+        {
+            DepthBounds[Tile * 2 + 0] = 100.0f / Camera.FarClip;
+            DepthBounds[Tile * 2 + 1] = 110.0f / Camera.FarClip;
+        }
+        Binner.BinLights(Desc, Lights.data(), 1);
+        Check(!ContainsLight(Binner, Binner.GetCellIndex(40, 22), 0), "tile depth bounds behind a light cull it");
+    }
+
+    void TestMatchesReference( void )
+    {
+        const uint32_t Viewports[][2] = { { 1920, 1080 }, { 1280, 720 }, { 1000, 563 }, { 64, 64 } };
+        const uint32_t TileDims[] = { 8, 16, 24, 32 };
+        const uint32_t SliceCounts[] = { 0, 0, 16, 24 };
+
+        std::mt19937 Rng(7);
+        std::uniform_real_distribution<float> Angle(-3.14159f, 3.14159f);
+        std::uniform_real_distribution<float> Unit(0.0f, 1.0f);
+
+        LightBinner Binner(4), SingleThreaded(1), Reference(1);
+        int Mismatches = 0, Unordered = 0;
+
+        for (int Test = 0; Test < 48; ++Test)
+        {
+            const uint32_t* Viewport = Viewports[Test % 4];
+            uint32_t TileDim = TileDims[(Test / 4) % 4];
+            uint32_t SliceCount = SliceCounts[(Test / 16) % 4];
+            bool WithDepthBounds = SliceCount == 0 && (Test & 1) != 0;
+
+            TestCamera Camera =
+            {
+                { 200.0f * (Unit(Rng) - 0.5f), 100.0f * (Unit(Rng) - 0.5f), 200.0f * (Unit(Rng) - 0.5f) },
+                Angle(Rng), 0.3f * Angle(Rng), 0.5f + Unit(Rng), 1.0f + Unit(Rng) * 4.0f, 2000.0f + Unit(Rng) * 2000.0f
+            };
+            LightGridDesc Desc = MakeDesc(Camera, Viewport[0], Viewport[1], TileDim, SliceCount);
+
+            std::vector<float> DepthBounds;
+            if (WithDepthBounds)
+            {
+                uint32_t TileCount = ((Viewport[0] + TileDim - 1) / TileDim) * ((Viewport[1] + TileDim - 1) / TileDim);
+                std::uniform_real_distribution<float> LinearDepth(Camera.NearClip / Camera.FarClip, 1.0f);
+                DepthBounds.resize(TileCount * 2);
+                for (uint32_t Tile = 0; Tile < TileCount; ++Tile)
+                {
+                    float a = LinearDepth(Rng), b = LinearDepth(Rng);
+                    DepthBounds[Tile * 2 + 0] = std::min(a, b);
+                    DepthBounds[Tile * 2 + 1] = std::max(a, b);
+                }
+                Desc.TileDepthBounds = DepthBounds.data();
+            }
+
+            uint32_t LightCount = 1 + Rng() % 300;
+            std::vector<LightData> Lights = MakeRandomLights(Rng, LightCount, 5.0f, 400.0f, true);
+
+            Binner.BinLights(Desc, Lights.data(), LightCount);
+            SingleThreaded.BinLights(Desc, Lights.data(), LightCount);
+            Reference.BinLightsReference(Desc, Lights.data(), LightCount);
+
+            if (!SameCells(Binner, Reference) || !SameCells(SingleThreaded, Reference))
+            {
+                if (Mismatches++ == 0)
+                    printf("Mismatch: %ux%u, %u pixel tiles, %u slices, %u lights\n", Viewport[0], Viewport[1], TileDim, SliceCount, LightCount);
+            }
+            if (!CellsAreOrdered(Binner, Lights))
+                ++Unordered;
+        }
+
+        Check(Mismatches == 0, "BinLights() matches BinLightsReference()");
+        Check(Unordered == 0, "cell lights are grouped by type and in index order");
+
+        // Depth slices are bounded more tightly than whole tiles, so every light of a slice is in
+        // the tile's list as well.
+        TestCamera Camera = { { 0.0f, 10.0f, 0.0f }, 0.4f, -0.1f, 1.0f, 1.0f, 3000.0f };
+        std::vector<LightData> Lights = MakeRandomLights(Rng, 1000, 5.0f, 100.0f, false);
+        LightGridDesc Desc = MakeDesc(Camera, 1280, 720, 16, 0);
+        Reference.BinLights(Desc, Lights.data(), 1000);
+        Desc.DepthSliceCount = 24;
+        Binner.BinLights(Desc, Lights.data(), 1000);
+
+        bool SlicesInTiles = true;
+        for (uint32_t y = 0; y < Binner.GetTileCountY(); ++y)
+        {
+            for (uint32_t x = 0; x < Binner.GetTileCountX(); ++x)
+            {
+                for (uint32_t s = 0; s < Binner.GetSliceCount(); ++s)
+                {
+                    uint32_t Counts[LightBinner::kLightTypeCount];
+                    uint32_t Cell = Binner.GetCellIndex(x, y, s);
+                    const uint32_t* SliceLights = Binner.GetCellLights(Cell, Counts);
+                    for (uint32_t i = 0; i < Binner.GetCellLightCount(Cell); ++i)
+                        SlicesInTiles &= ContainsLight(Reference, Reference.GetCellIndex(x, y), SliceLights[i]);
+                }
+            }
+        }
+        Check(SlicesInTiles, "the lights of each depth slice are in the lights of its tile");
+    }
+
+    void TestGpuLayout( void )
+    {
+        std::mt19937 Rng(11);
+        TestCamera Camera = { { 0.0f, 0.0f, 0.0f }, 0.2f, 0.0f, 1.0f, 1.0f, 3000.0f };
+        LightGridDesc Desc = MakeDesc(Camera, 1920, 1080, 16, 0);
+        std::vector<LightData> Lights = MakeRandomLights(Rng, MaxLights, 100.0f, 800.0f, false);
+
+        LightBinner Binner(2);
+        Binner.BinLights(Desc, Lights.data(), MaxLights);
+
+        uint32_t TileCount = Binner.GetTileCountX() * Binner.GetTileCountY();
+        const uint32_t TileWords = 1 + MaxLights;
+        std::vector<uint32_t> LightGrid(TileCount * TileWords, 0xcdcdcdcd);
+        std::vector<uint32_t> BitMask(TileCount * 4, 0xcdcdcdcd);
+        Check(Binner.WriteGpuLightGrid(LightGrid.data(), LightGrid.size() * 4, BitMask.data(), BitMask.size() * 4), "WriteGpuLightGrid");
+
+        bool LayoutMatches = true;
+        for (uint32_t Tile = 0; Tile < TileCount; ++Tile)
+        {
+            uint32_t Counts[LightBinner::kLightTypeCount];
+            const uint32_t* TileLights = Binner.GetCellLights(Tile, Counts);
+            uint32_t LightCount = Binner.GetCellLightCount(Tile);
+
+            const uint32_t* GpuTile = &LightGrid[Tile * TileWords];
+            LayoutMatches &= GpuTile[0] == (Counts[0] | Counts[1] << 8 | Counts[2] << 16);
+            LayoutMatches &= memcmp(GpuTile + 1, TileLights, LightCount * 4) == 0;
+
+            uint32_t Mask[4] = {};
+            for (uint32_t i = 0; i < LightCount; ++i)
+                Mask[TileLights[i] / 32] |= 1u << (TileLights[i] % 32);
+            LayoutMatches &= memcmp(Mask, &BitMask[Tile * 4], sizeof(Mask)) == 0;
+        }
+        Check(LayoutMatches, "the GPU light grid holds the counts, lights and bit mask of each tile");
+
+        Check(!Binner.WriteGpuLightGrid(LightGrid.data(), LightGrid.size() * 4 - 4, BitMask.data(), BitMask.size() * 4),
+            "WriteGpuLightGrid fails for a buffer that is too small");
+
+        Lights.push_back(Lights[0]);
+        Binner.BinLights(Desc, Lights.data(), MaxLights + 1);
+        Check(!Binner.WriteGpuLightGrid(LightGrid.data(), LightGrid.size() * 4, BitMask.data(), BitMask.size() * 4),
+            "WriteGpuLightGrid fails for more than MaxLights lights");
+
+        Desc.DepthSliceCount = 16;
+        Binner.BinLights(Desc, Lights.data(), MaxLights);
+        Check(!Binner.WriteGpuLightGrid(LightGrid.data(), LightGrid.size() * 4, BitMask.data(), BitMask.size() * 4),
+            "WriteGpuLightGrid fails for a depth sliced grid");
+    }
+
+    int SelfTest( void )
+    {
+        TestPlacedLights();
+        TestMatchesReference();
+        TestGpuLayout();
+
+        return 0;
+    }
+
+    template <typename Function>
+    double TimeSeconds( Function Func, int Repeats )
+    {
+        auto Start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < Repeats; ++i)
+            Func();
+        std::chrono::duration<double> Elapsed = std::chrono::high_resolution_clock::now() - Start;
+        return Elapsed.count() / Repeats;
+    }
+
+    int Benchmark( uint32_t MaxLightCount )
+    {
+        TestCamera Camera = { { 0.0f, 0.0f, 0.0f }, 0.0f, 0.0f, 0.7853981f, 1.0f, 3000.0f };
+        const uint32_t ThreadCount = std::max(1u, std::thread::hardware_concurrency());
+
+        printf("1920x1080, 16x16 pixel tiles, %u threads\n", ThreadCount);
+        printf("%8s %8s %14s %14s %14s %12s\n", "lights", "slices", "tiles/s", "1 thread", "reference", "lights/cell");
+
+        std::mt19937 Rng(3);
+        for (uint32_t LightCount = 1024; LightCount <= MaxLightCount; LightCount *= 4)
+        {
+            std::vector<LightData> Lights = MakeRandomLights(Rng, LightCount, 5.0f, 50.0f, false);
+
+            for (uint32_t SliceCount = 0; SliceCount <= 16; SliceCount += 16)
+            {
+                LightGridDesc Desc = MakeDesc(Camera, 1920, 1080, 16, SliceCount);
+                LightBinner Binner(ThreadCount), SingleThreaded(1), Reference(1);
+
+                Binner.BinLights(Desc, Lights.data(), LightCount);
+                uint32_t TileCount = Binner.GetTileCountX() * Binner.GetTileCountY();
+                int Repeats = LightCount <= 4096 ? 10 : 2;
+
+                double Seconds = TimeSeconds([&]() { Binner.BinLights(Desc, Lights.data(), LightCount); }, Repeats);
+                double SingleSeconds = TimeSeconds([&]() { SingleThreaded.BinLights(Desc, Lights.data(), LightCount); }, Repeats);
+
+                char ReferenceRate[32] = "-";
+                if (LightCount <= 4096)
+                {
+                    double ReferenceSeconds = TimeSeconds([&]() { Reference.BinLightsReference(Desc, Lights.data(), LightCount); }, 1);
+                    snprintf(ReferenceRate, sizeof(ReferenceRate), "%.0f", TileCount / ReferenceSeconds);
+                    if (!SameCells(Binner, Reference))
+                    {
+                        printf("BinLights() doesn't match BinLightsReference()\n");
+                        return 1;
+                    }
+                }
+
+                printf("%8u %8u %14.0f %14.0f %14s %12.2f\n", LightCount, Binner.GetSliceCount(), TileCount / Seconds,
+                    TileCount / SingleSeconds, ReferenceRate, (double)Binner.GetTotalLightCount() / Binner.GetCellCount());
+            }
+        }
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "benchmark", "[max lights]", 1, []( int ArgCount, char* Args[] )
+        {
+            uint32_t MaxLightCount = TestHarness::GetCountArgument(ArgCount, Args, 0, 65536);
+            return MaxLightCount == 0 ? TestHarness::kBadArguments : Benchmark(MaxLightCount);
+        } },
+    };
+    return TestHarness::RunCommand(argc, argv, "LightBinnerTest", kCommands);
+}
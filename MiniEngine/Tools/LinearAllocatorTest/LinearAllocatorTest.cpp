@@ -0,0 +1,635 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking LinearAllocator's page recycling (LinearAllocator.cpp) without a device.  Pages
+// come from a test provider whose fences are plain counters that the test completes by hand, and every page
+// remembers the fence it was last retired with, so a page handed out while the GPU could still be using it
+// is caught.
+//
+//   LinearAllocatorTest selftest
+//       Checks fence ordering, per-queue retirement, large page reuse and its budget, thread magazines and a
+//       multithreaded run, and that Destroy() releases every page.
+//   LinearAllocatorTest bench [max threads]
+//       Records contexts on 1, 2, 4 ... threads, each making a few hundred allocations from a GPU allocator
+//       (64KB pages) with fences completing a couple of frames behind.  Reports allocations per second for
+//       the page manager before and after the per-thread magazines, and the share of page requests that still
+//       take the lock.  Any difference in contention only shows with at least as many cores as threads.
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "pch.h"
+#include "LinearAllocator.h"
+#include "../TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+    // A buffer with no memory behind it.  It is reference counted like the real thing, because pages release
+    // their resource when they are destroyed, and it carries the bookkeeping the tests check pages against.
+    class FakeResource final : public ID3D12Resource
+    {
+    public:
+        FakeResource( size_t Width, D3D12_GPU_VIRTUAL_ADDRESS Address, std::atomic<int>& LiveCount ) :
+            m_RefCount(1), m_Width(Width), m_Address(Address), m_LiveCount(LiveCount), m_RetiredFence(0), m_InUse(false)
+        {
+            ++m_LiveCount;
+        }
+
+        HRESULT STDMETHODCALLTYPE QueryInterface( REFIID, void** PpvObject ) override { *PpvObject = nullptr; return E_NOINTERFACE; }
+        ULONG STDMETHODCALLTYPE AddRef( void ) override { return ++m_RefCount; }
+        ULONG STDMETHODCALLTYPE Release( void ) override
+        {
+            ULONG Count = --m_RefCount;
+            if (Count == 0)
+            {
+                --m_LiveCount;
+                delete this;
+            }
+            return Count;
+        }
+
+        HRESULT STDMETHODCALLTYPE GetPrivateData( REFGUID, UINT*, void* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateData( REFGUID, UINT, const void* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateDataInterface( REFGUID, const IUnknown* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetName( LPCWSTR ) override { return S_OK; }
+        HRESULT STDMETHODCALLTYPE GetDevice( REFIID, void** PpvDevice ) override { *PpvDevice = nullptr; return E_NOTIMPL; }
+
+        // The CPU address is as fake as the GPU one.  Nothing writes through it.
+        HRESULT STDMETHODCALLTYPE Map( UINT, const D3D12_RANGE*, void** PpData ) override { *PpData = (void*)(size_t)m_Address; return S_OK; }
+        void STDMETHODCALLTYPE Unmap( UINT, const D3D12_RANGE* ) override {}
+        D3D12_RESOURCE_DESC STDMETHODCALLTYPE GetDesc( void ) override
+        {
+            D3D12_RESOURCE_DESC Desc = {};
+            Desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+            Desc.Width = m_Width;
+            Desc.Height = 1;
+            Desc.DepthOrArraySize = 1;
+            Desc.MipLevels = 1;
+            Desc.SampleDesc.Count = 1;
+            return Desc;
+        }
+        D3D12_GPU_VIRTUAL_ADDRESS STDMETHODCALLTYPE GetGPUVirtualAddress( void ) override { return m_Address; }
+        HRESULT STDMETHODCALLTYPE WriteToSubresource( UINT, const D3D12_BOX*, const void*, UINT, UINT ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE ReadFromSubresource( void*, UINT, UINT, UINT, const D3D12_BOX* ) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE GetHeapProperties( D3D12_HEAP_PROPERTIES*, D3D12_HEAP_FLAGS* ) override { return E_NOTIMPL; }
+
+        std::atomic<ULONG> m_RefCount;
+        size_t m_Width;
+        D3D12_GPU_VIRTUAL_ADDRESS m_Address;
+        std::atomic<int>& m_LiveCount;
+
+        std::atomic<uint64_t> m_RetiredFence;   // The fence the page was last retired with
+        std::atomic<bool> m_InUse;              // Held by a context that is recording
+    };
+
+    FakeResource* ResourceOf( GpuResource& Buffer )
+    {
+        return static_cast<FakeResource*>(Buffer.GetResource());
+    }
+
+    // Fences are counters per queue type, encoded like CommandQueue's (the type in the top byte)
+    class FakePageProvider : public LinearAllocatorPageProvider
+    {
+    public:
+        FakePageProvider() : m_LiveResources(0), m_NextAddress(0x10000), m_BytesCreated(0)
+        {
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                m_NextFence[i] = ((uint64_t)i << 56) + 1;
+                m_CompletedFence[i] = (uint64_t)i << 56;
+            }
+        }
+
+        LinearAllocationPage* CreatePage( LinearAllocatorType Type, size_t PageSize ) override
+        {
+            m_BytesCreated += PageSize;
+            FakeResource* Resource = new FakeResource(PageSize, m_NextAddress.fetch_add(PageSize), m_LiveResources);
+            return new LinearAllocationPage(Resource, Type == kGpuExclusive ? D3D12_RESOURCE_STATE_UNORDERED_ACCESS : D3D12_RESOURCE_STATE_GENERIC_READ);
+        }
+
+        bool IsFenceComplete( uint64_t FenceValue ) override
+        {
+            return FenceValue <= m_CompletedFence[(FenceValue >> 56) & 3].load(std::memory_order_acquire);
+        }
+
+        uint64_t Signal( uint32_t Queue = 0 )
+        {
+            return m_NextFence[Queue]++;
+        }
+
+        // Completes every fence up to FenceValue on its queue.  Fences never go backwards.
+        void Complete( uint64_t FenceValue )
+        {
+            std::atomic<uint64_t>& Completed = m_CompletedFence[(FenceValue >> 56) & 3];
+            uint64_t Current = Completed.load();
+            while (Current < FenceValue && !Completed.compare_exchange_weak(Current, FenceValue))
+                ;
+        }
+
+        std::atomic<int> m_LiveResources;
+        std::atomic<uint64_t> m_NextAddress;
+        std::atomic<uint64_t> m_BytesCreated;
+
+    private:
+        std::atomic<uint64_t> m_NextFence[4];
+        std::atomic<uint64_t> m_CompletedFence[4];
+    };
+
+    //
+    // The page manager and allocator as they were before per-thread magazines, for comparison:  one FIFO of retired
+    // pages polled under the lock on every request, and large pages created and destroyed for each use.
+    //
+
+    class LegacyPageManager
+    {
+    public:
+        LegacyPageManager( LinearAllocatorType Type, LinearAllocatorPageProvider* Provider ) : m_Type(Type), m_Provider(Provider) {}
+
+        ~LegacyPageManager()
+        {
+            while (!m_DeletionQueue.empty())
+            {
+                delete m_DeletionQueue.front().second;
+                m_DeletionQueue.pop();
+            }
+        }
+
+        LinearAllocationPage* RequestPage( void )
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+            while (!m_RetiredPages.empty() && m_Provider->IsFenceComplete(m_RetiredPages.front().first))
+            {
+                m_AvailablePages.push(m_RetiredPages.front().second);
+                m_RetiredPages.pop();
+            }
+
+            LinearAllocationPage* PagePtr = nullptr;
+
+            if (!m_AvailablePages.empty())
+            {
+                PagePtr = m_AvailablePages.front();
+                m_AvailablePages.pop();
+            }
+            else
+            {
+                PagePtr = CreateNewPage();
+                m_PagePool.emplace_back(PagePtr);
+            }
+
+            return PagePtr;
+        }
+
+        LinearAllocationPage* CreateNewPage( size_t PageSize = 0 )
+        {
+            return m_Provider->CreatePage(m_Type, PageSize == 0 ? (size_t)kGpuAllocatorPageSize : PageSize);
+        }
+
+        void DiscardPages( uint64_t FenceValue, const std::vector<LinearAllocationPage*>& UsedPages )
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+            for (auto Iter = UsedPages.begin(); Iter != UsedPages.end(); ++Iter)
+                m_RetiredPages.push(std::make_pair(FenceValue, *Iter));
+        }
+
+        void FreeLargePages( uint64_t FenceValue, const std::vector<LinearAllocationPage*>& LargePages )
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+            while (!m_DeletionQueue.empty() && m_Provider->IsFenceComplete(m_DeletionQueue.front().first))
+            {
+                delete m_DeletionQueue.front().second;
+                m_DeletionQueue.pop();
+            }
+
+            for (auto Iter = LargePages.begin(); Iter != LargePages.end(); ++Iter)
+            {
+                (*Iter)->Unmap();
+                m_DeletionQueue.push(std::make_pair(FenceValue, *Iter));
+            }
+        }
+
+    private:
+        LinearAllocatorType m_Type;
+        LinearAllocatorPageProvider* m_Provider;
+        std::vector<std::unique_ptr<LinearAllocationPage> > m_PagePool;
+        std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_RetiredPages;
+        std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_DeletionQueue;
+        std::queue<LinearAllocationPage*> m_AvailablePages;
+        std::mutex m_Mutex;
+    };
+
+    class LegacyLinearAllocator
+    {
+    public:
+        LegacyLinearAllocator( LinearAllocatorType, LegacyPageManager& PageManager ) :
+            m_PageManager(PageManager), m_PageSize(kGpuAllocatorPageSize), m_CurOffset(~(size_t)0), m_CurPage(nullptr) {}
+
+        DynAlloc Allocate( size_t SizeInBytes, size_t Alignment = DEFAULT_ALIGN )
+        {
+            const size_t AlignmentMask = Alignment - 1;
+            const size_t AlignedSize = Math::AlignUpWithMask(SizeInBytes, AlignmentMask);
+
+            if (AlignedSize > m_PageSize)
+            {
+                LinearAllocationPage* OneOff = m_PageManager.CreateNewPage(AlignedSize);
+                m_LargePageList.push_back(OneOff);
+
+                DynAlloc Ret(*OneOff, 0, AlignedSize);
+                Ret.DataPtr = OneOff->m_CpuVirtualAddress;
+                Ret.GpuAddress = OneOff->m_GpuVirtualAddress;
+                return Ret;
+            }
+
+            m_CurOffset = Math::AlignUp(m_CurOffset, Alignment);
+
+            if (m_CurOffset + AlignedSize > m_PageSize)
+            {
+                m_RetiredPages.push_back(m_CurPage);
+                m_CurPage = nullptr;
+            }
+
+            if (m_CurPage == nullptr)
+            {
+                m_CurPage = m_PageManager.RequestPage();
+                m_CurOffset = 0;
+            }
+
+            DynAlloc Ret(*m_CurPage, m_CurOffset, AlignedSize);
+            Ret.DataPtr = (uint8_t*)m_CurPage->m_CpuVirtualAddress + m_CurOffset;
+            Ret.GpuAddress = m_CurPage->m_GpuVirtualAddress + m_CurOffset;
+
+            m_CurOffset += AlignedSize;
+
+            return Ret;
+        }
+
+        void CleanupUsedPages( uint64_t FenceID )
+        {
+            if (m_CurPage == nullptr)
+                return;
+
+            m_RetiredPages.push_back(m_CurPage);
+            m_CurPage = nullptr;
+            m_CurOffset = 0;
+
+            m_PageManager.DiscardPages(FenceID, m_RetiredPages);
+            m_RetiredPages.clear();
+
+            m_PageManager.FreeLargePages(FenceID, m_LargePageList);
+            m_LargePageList.clear();
+        }
+
+    private:
+        LegacyPageManager& m_PageManager;
+        size_t m_PageSize;
+        size_t m_CurOffset;
+        LinearAllocationPage* m_CurPage;
+        std::vector<LinearAllocationPage*> m_RetiredPages;
+        std::vector<LinearAllocationPage*> m_LargePageList;
+    };
+
+    //
+    // Recording contexts
+    //
+
+    // The pages one context is holding, checked as it sees each of them for the first time
+    class PageTracker
+    {
+    public:
+        explicit PageTracker( FakePageProvider& Provider ) : m_Provider(Provider) {}
+
+        void Saw( GpuResource& Buffer )
+        {
+            FakeResource* Resource = ResourceOf(Buffer);
+            for (FakeResource* Held : m_Held)
+            {
+                if (Held == Resource)
+                    return;
+            }
+
+            Check(m_Provider.IsFenceComplete(Resource->m_RetiredFence), "a page is not handed out before its fence completes");
+            Check(!Resource->m_InUse.exchange(true), "a page is not held by two contexts at once");
+            m_Held.push_back(Resource);
+        }
+
+        // Call before handing the pages back
+        void Retire( uint64_t Fence )
+        {
+            for (FakeResource* Held : m_Held)
+            {
+                Held->m_RetiredFence = Fence;
+                Held->m_InUse = false;
+            }
+            m_Held.clear();
+        }
+
+    private:
+        FakePageProvider& m_Provider;
+        std::vector<FakeResource*> m_Held;
+    };
+
+    struct Workload
+    {
+        uint32_t Contexts;          // Contexts recorded per thread
+        uint32_t Allocations;       // Allocations per context
+        uint32_t LargeOneIn;        // One allocation in this many is larger than a page
+        uint32_t FencesInFlight;    // How far completion trails behind signalling
+        bool Validate;
+    };
+
+    // Allocation sizes of constant buffers and dynamic vertex data, and now and then something bigger than a page
+    size_t NextAllocationSize( std::mt19937& Rng, const Workload& Work )
+    {
+        if (Work.LargeOneIn != 0 && Rng() % Work.LargeOneIn == 0)
+            return kGpuAllocatorPageSize + Rng() % (3 * kGpuAllocatorPageSize);
+        return 256 + Rng() % 8192;
+    }
+
+    template <typename Allocator, typename Manager>
+    uint64_t RecordContexts( Manager& PageManager, FakePageProvider& Provider, const Workload& Work, uint32_t Seed )
+    {
+        std::mt19937 Rng(Seed);
+        Allocator TestAllocator(kGpuExclusive, PageManager);
+        PageTracker Tracker(Provider);
+        uint64_t AddressSum = 0;
+
+        for (uint32_t Context = 0; Context < Work.Contexts; ++Context)
+        {
+            for (uint32_t i = 0; i < Work.Allocations; ++i)
+            {
+                DynAlloc Alloc = TestAllocator.Allocate(NextAllocationSize(Rng, Work));
+                AddressSum += Alloc.GpuAddress;
+                if (Work.Validate)
+                    Tracker.Saw(Alloc.Buffer);
+            }
+
+            uint64_t Fence = Provider.Signal();
+            Tracker.Retire(Fence);
+            TestAllocator.CleanupUsedPages(Fence);
+            if (Fence > Work.FencesInFlight)
+                Provider.Complete(Fence - Work.FencesInFlight);
+        }
+
+        return AddressSum;
+    }
+
+    template <typename Allocator, typename Manager>
+    double RunThreads( Manager& PageManager, FakePageProvider& Provider, const Workload& Work, uint32_t NumThreads )
+    {
+        std::vector<std::thread> Threads;
+        std::vector<uint64_t> Results(NumThreads);
+
+        auto Start = std::chrono::high_resolution_clock::now();
+        for (uint32_t t = 0; t < NumThreads; ++t)
+        {
+            Threads.emplace_back([&, t]()
+            {
+                Results[t] = RecordContexts<Allocator>(PageManager, Provider, Work, 1000 + t);
+            });
+        }
+        for (std::thread& Thread : Threads)
+            Thread.join();
+        auto End = std::chrono::high_resolution_clock::now();
+
+        return std::chrono::duration<double>(End - Start).count();
+    }
+
+    //
+    // Self test
+    //
+
+    int SelfTest( void )
+    {
+        const std::vector<LinearAllocationPage*> kNone;
+
+        // A retired page waits for its fence
+        {
+            FakePageProvider Provider;
+            LinearAllocatorPageManager PageManager(kGpuExclusive, &Provider);
+
+            LinearAllocationPage* First = PageManager.RequestPage();
+            uint64_t Fence = Provider.Signal();
+            PageManager.DiscardPages(Fence, std::vector<LinearAllocationPage*>(1, First), kNone);
+
+            LinearAllocationPage* Second = PageManager.RequestPage();
+            Check(Second != First, "a page in flight is not reused");
+
+            Provider.Complete(Fence);
+            LinearAllocationPage* Third = PageManager.RequestPage();
+            Check(Third == First, "a page is reused once its fence completes");
+            Check(PageManager.GetStatistics().NumCreated == 2 && PageManager.GetStatistics().NumReused == 1, "two pages created, one reused");
+        }
+
+        // A queue that is behind doesn't hold up pages retired on another
+        {
+            FakePageProvider Provider;
+            LinearAllocatorPageManager PageManager(kGpuExclusive, &Provider);
+
+            LinearAllocationPage* ComputePage = PageManager.RequestPage();
+            LinearAllocationPage* DirectPage = PageManager.RequestPage();
+            uint64_t ComputeFence = Provider.Signal(D3D12_COMMAND_LIST_TYPE_COMPUTE);
+            uint64_t DirectFence = Provider.Signal(D3D12_COMMAND_LIST_TYPE_DIRECT);
+            PageManager.DiscardPages(ComputeFence, std::vector<LinearAllocationPage*>(1, ComputePage), kNone);
+            PageManager.DiscardPages(DirectFence, std::vector<LinearAllocationPage*>(1, DirectPage), kNone);
+
+            Provider.Complete(DirectFence);
+            Check(PageManager.RequestPage() == DirectPage, "the direct queue's page is reused while compute is busy");
+            Check(PageManager.RequestPage() != ComputePage, "the compute queue's page waits");
+        }
+
+        // Fences that arrive out of order on one queue wait for the later one
+        {
+            FakePageProvider Provider;
+            LinearAllocatorPageManager PageManager(kGpuExclusive, &Provider);
+
+            LinearAllocationPage* Early = PageManager.RequestPage();
+            LinearAllocationPage* Late = PageManager.RequestPage();
+            uint64_t Fence1 = Provider.Signal();
+            uint64_t Fence2 = Provider.Signal();
+            PageManager.DiscardPages(Fence2, std::vector<LinearAllocationPage*>(1, Late), kNone);
+            PageManager.DiscardPages(Fence1, std::vector<LinearAllocationPage*>(1, Early), kNone);
+
+            Provider.Complete(Fence1);
+            LinearAllocationPage* Next = PageManager.RequestPage();
+            Check(Next != Early && Next != Late, "nothing is reused until the later fence completes");
+            Provider.Complete(Fence2);
+            LinearAllocationPage* a = PageManager.RequestPage();
+            LinearAllocationPage* b = PageManager.RequestPage();
+            Check((a == Early || a == Late) && (b == Early || b == Late) && a != b, "both pages come back together");
+        }
+
+        // Large pages are recycled by size, within a budget
+        {
+            FakePageProvider Provider;
+            LinearAllocatorPageManager PageManager(kGpuExclusive, &Provider);
+            LinearAllocator TestAllocator(kGpuExclusive, PageManager);
+
+            DynAlloc Big = TestAllocator.Allocate(100 * 1024);
+            LinearAllocationPage* BigPage = static_cast<LinearAllocationPage*>(&Big.Buffer);
+            Check(BigPage->m_PageSize == 128 * 1024, "large pages are rounded up to whole pages");
+            uint64_t Fence = Provider.Signal();
+            TestAllocator.CleanupUsedPages(Fence);
+            Provider.Complete(Fence);
+
+            DynAlloc Again = TestAllocator.Allocate(120 * 1024);
+            Check(&Again.Buffer == &Big.Buffer, "a retired large page of the right size is reused");
+            DynAlloc Bigger = TestAllocator.Allocate(300 * 1024);
+            Check(&Bigger.Buffer != &Big.Buffer, "a large page that is too small is not reused");
+            Fence = Provider.Signal();
+            TestAllocator.CleanupUsedPages(Fence);
+            Provider.Complete(Fence);
+
+            DynAlloc Smaller = TestAllocator.Allocate(70 * 1024);
+            Check(&Smaller.Buffer == &Big.Buffer, "a small request takes the page that fits, not the larger one");
+            Fence = Provider.Signal();
+            TestAllocator.CleanupUsedPages(Fence);
+            Provider.Complete(Fence);
+
+            // Retire far more than the budget at once
+            for (uint32_t i = 0; i < 40; ++i)
+                TestAllocator.Allocate(4 * 1024 * 1024 - i * kGpuAllocatorPageSize);
+            Fence = Provider.Signal();
+            TestAllocator.CleanupUsedPages(Fence);
+            Provider.Complete(Fence);
+            TestAllocator.Allocate(256);
+
+            LinearAllocatorPageManager::Statistics Stats = PageManager.GetStatistics();
+            Check(Stats.NumLargeReused == 2, "the 128KB page is reused twice");
+            Check(Stats.NumLargeDestroyed > 0, "retired large pages beyond the budget are destroyed");
+            Check(Provider.m_LiveResources < 40, "the large page budget holds");
+        }
+
+        // A thread's magazine serves repeat requests without the lock
+        {
+            FakePageProvider Provider;
+            LinearAllocatorPageManager PageManager(kGpuExclusive, &Provider);
+
+            std::vector<LinearAllocationPage*> Pages;
+            for (uint32_t i = 0; i < 32; ++i)
+                Pages.push_back(PageManager.RequestPage());
+            uint64_t Fence = Provider.Signal();
+            PageManager.DiscardPages(Fence, Pages, kNone);
+            Provider.Complete(Fence);
+
+            for (uint32_t i = 0; i < 32; ++i)
+                PageManager.RequestPage();
+
+            LinearAllocatorPageManager::Statistics Stats = PageManager.GetStatistics();
+            Check(Stats.NumCreated == 32 && Stats.NumReused == 32, "every page is reused");
+            Check(Stats.NumMagazineHits > 0, "some requests are served by the magazine");
+        }
+
+        // Many threads recording at once
+        {
+            FakePageProvider Provider;
+            {
+                LinearAllocatorPageManager PageManager(kGpuExclusive, &Provider);
+                Workload Work = { 400, 200, 50, 6, true };
+                RunThreads<LinearAllocator>(PageManager, Provider, Work, 8);
+
+                LinearAllocatorPageManager::Statistics Stats = PageManager.GetStatistics();
+                Check(Stats.NumReused > Stats.NumCreated * 10, "the threaded run mostly reuses pages");
+                Check(Stats.NumMagazineHits > 0, "magazine hits of exited threads are counted");
+                Check(Stats.NumLargeReused > 0, "the threaded run reuses large pages");
+            }
+            Check(Provider.m_LiveResources == 0, "destroying the manager releases every page");
+        }
+
+        // Destroy() drops what the magazines hold
+        {
+            FakePageProvider Provider;
+            LinearAllocatorPageManager PageManager(kGpuExclusive, &Provider);
+
+            std::vector<LinearAllocationPage*> Pages;
+            for (uint32_t i = 0; i < 8; ++i)
+                Pages.push_back(PageManager.RequestPage());
+            uint64_t Fence = Provider.Signal();
+            PageManager.DiscardPages(Fence, Pages, kNone);
+            Provider.Complete(Fence);
+            PageManager.RequestPage();
+
+            PageManager.Destroy();
+            Check(Provider.m_LiveResources == 0, "Destroy() releases every page");
+            Check(PageManager.RequestPage() != nullptr && Provider.m_LiveResources == 1, "a destroyed manager starts over");
+        }
+
+        return 0;
+    }
+
+    //
+    // Benchmark
+    //
+
+    int Bench( uint32_t MaxThreads )
+    {
+        Workload Work = { 2000, 256, 500, 0, false };
+
+        printf("%u contexts per thread, %u allocations each, one in %u larger than a page\n", Work.Contexts, Work.Allocations, Work.LargeOneIn);
+        printf("%8s %16s %16s %10s %14s %14s\n", "threads", "before (M/s)", "after (M/s)", "speedup", "pages created", "locked pages");
+
+        for (uint32_t NumThreads = 1; NumThreads <= MaxThreads; NumThreads *= 2)
+        {
+            // About two frames of contexts in flight
+            Work.FencesInFlight = 2 * NumThreads;
+            double Allocations = (double)NumThreads * Work.Contexts * Work.Allocations;
+
+            FakePageProvider LegacyProvider;
+            double LegacySeconds;
+            {
+                LegacyPageManager PageManager(kGpuExclusive, &LegacyProvider);
+                LegacySeconds = RunThreads<LegacyLinearAllocator>(PageManager, LegacyProvider, Work, NumThreads);
+            }
+
+            FakePageProvider Provider;
+            double Seconds;
+            uint64_t Created;
+            double LockedFraction;
+            {
+                LinearAllocatorPageManager PageManager(kGpuExclusive, &Provider);
+                Seconds = RunThreads<LinearAllocator>(PageManager, Provider, Work, NumThreads);
+                LinearAllocatorPageManager::Statistics Stats = PageManager.GetStatistics();
+                Created = Stats.NumCreated + Stats.NumLargeCreated;
+
+                // Every page request took the lock before.  Now only those the thread's magazine can't serve do.
+                uint64_t Requests = Stats.NumCreated + Stats.NumReused;
+                LockedFraction = (double)(Requests - Stats.NumMagazineHits) / (double)Requests;
+            }
+
+            printf("%8u %16.2f %16.2f %9.2fx %14llu %13.0f%%\n", NumThreads, Allocations / LegacySeconds * 1e-6,
+                Allocations / Seconds * 1e-6, LegacySeconds / Seconds, (unsigned long long)Created, LockedFraction * 100.0);
+        }
+
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "bench", "[max threads]", 1, []( int ArgCount, char* Args[] )
+        {
+            uint32_t MaxThreads = TestHarness::GetCountArgument(ArgCount, Args, 0, std::max(1u, std::thread::hardware_concurrency()));
+            return MaxThreads == 0 ? TestHarness::kBadArguments : Bench(MaxThreads);
+        } },
+    };
+    return TestHarness::RunCommand(argc, argv, "LinearAllocatorTest", kCommands);
+}
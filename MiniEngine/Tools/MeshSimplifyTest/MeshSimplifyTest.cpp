@@ -0,0 +1,438 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking and timing the mesh simplifier (ModelConverter/MeshSimplify.cpp).
+//
+//   MeshSimplifyTest selftest
+//       Checks the surface distance measure against shapes with known answers, then simplifies generated meshes:
+//       a flat grid with open borders and a UV seam, a UV sphere with its seam, a noisy terrain, a non-manifold
+//       fin and a mesh with degenerate triangles.  It checks that the results reach their targets or stop at
+//       the error limit, keep their winding, never stretch a triangle across a seam, keep the grid's outline
+//       and stay close to the original, and that the same input always gives the same output.
+//   MeshSimplifyTest bench [threads]
+//       Reports triangles per second and the Hausdorff distance for several reduction ratios, then simplifies
+//       copies of the meshes on several threads at once, as the converter does with a model's meshes.
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "pch.h"
+#include "MeshSimplify.h"
+#include "../TestHarness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+    // Vertices carry a position and a texture coordinate; wedges at one position differ in the latter
+    struct TestMesh
+    {
+        const char* Name;
+        std::vector<float> Vertices;    // x, y, z, u, v
+        std::vector<uint16_t> Indices;
+        float Radius;                   // of the bounding sphere, for relative errors
+
+        SimplifySource Source( void ) const
+        {
+            SimplifySource Source;
+            Source.positions = Vertices.data();
+            Source.vertexStride = 20;
+            Source.vertexCount = (uint32_t)(Vertices.size() / 5);
+            Source.indices = Indices.data();
+            Source.indexCount = (uint32_t)Indices.size();
+            return Source;
+        }
+
+        uint32_t AddVertex( float x, float y, float z, float u, float v )
+        {
+            Vertices.insert(Vertices.end(), { x, y, z, u, v });
+            return (uint32_t)(Vertices.size() / 5 - 1);
+        }
+
+        void AddTriangle( uint32_t i0, uint32_t i1, uint32_t i2 )
+        {
+            Indices.insert(Indices.end(), { (uint16_t)i0, (uint16_t)i1, (uint16_t)i2 });
+        }
+
+        const float* Vertex( uint32_t i ) const { return &Vertices[i * 5]; }
+    };
+
+    // A square grid facing +Z.  Its right side is a separate chart one to the right in U, with the column at
+    // SeamColumn split into a wedge for each chart, as a UV border would be.  The heights come from a function.
+    template <typename HeightFunction>
+    TestMesh MakeGrid( const char* Name, uint32_t Size, uint32_t SeamColumn, HeightFunction Height )
+    {
+        TestMesh Mesh;
+        Mesh.Name = Name;
+        std::vector<uint32_t> Left(Size * Size), Right(Size * Size);
+        for (uint32_t y = 0; y < Size; ++y)
+        {
+            for (uint32_t x = 0; x < Size; ++x)
+            {
+                float u = (float)x / (Size - 1) + (x > SeamColumn ? 1.0f : 0.0f), v = (float)y / (Size - 1);
+                Left[y * Size + x] = Right[y * Size + x] = Mesh.AddVertex((float)x, (float)y, Height(x, y), u, v);
+                if (x == SeamColumn)
+                    Right[y * Size + x] = Mesh.AddVertex((float)x, (float)y, Height(x, y), u + 1.0f, v);
+            }
+        }
+
+        for (uint32_t y = 0; y + 1 < Size; ++y)
+        {
+            for (uint32_t x = 0; x + 1 < Size; ++x)
+            {
+                const std::vector<uint32_t>& Side = x < SeamColumn ? Left : Right;
+                uint32_t v = y * Size + x;
+                Mesh.AddTriangle(Side[v], Side[v + 1], Side[v + Size + 1]);
+                Mesh.AddTriangle(Side[v], Side[v + Size + 1], Side[v + Size]);
+            }
+        }
+        Mesh.Radius = (Size - 1) * 0.7071f;
+        return Mesh;
+    }
+
+    // A UV sphere of radius 10 with the usual seam where U wraps
+    TestMesh MakeSphere( uint32_t Slices, uint32_t Stacks )
+    {
+        TestMesh Mesh;
+        Mesh.Name = "sphere";
+        const float Pi = 3.14159265f;
+        // Each pole is one vertex, with no U of its own, and the last column of the rings is the first again with U = 1
+        Mesh.AddVertex(0.0f, 0.0f, 10.0f, -1.0f, 0.0f);
+        for (uint32_t Stack = 1; Stack < Stacks; ++Stack)
+        {
+            float Theta = Pi * Stack / Stacks;
+            for (uint32_t Slice = 0; Slice <= Slices; ++Slice)
+            {
+                float Phi = 2.0f * Pi * (Slice % Slices) / Slices;
+                float r = 10.0f * sinf(Theta);
+                Mesh.AddVertex(r * cosf(Phi), r * sinf(Phi), 10.0f * cosf(Theta), (float)Slice / Slices, (float)Stack / Stacks);
+            }
+        }
+        Mesh.AddVertex(0.0f, 0.0f, -10.0f, -1.0f, 1.0f);
+
+        const uint32_t LastPole = (Stacks - 1) * (Slices + 1) + 1;
+        auto Index = [&]( uint32_t Stack, uint32_t Slice )
+        {
+            return Stack == 0 ? 0 : Stack == Stacks ? LastPole : (Stack - 1) * (Slices + 1) + Slice + 1;
+        };
+        for (uint32_t Stack = 0; Stack < Stacks; ++Stack)
+        {
+            for (uint32_t Slice = 0; Slice < Slices; ++Slice)
+            {
+                if (Stack > 0)
+                    Mesh.AddTriangle(Index(Stack, Slice), Index(Stack + 1, Slice), Index(Stack, Slice + 1));
+                if (Stack + 1 < Stacks)
+                    Mesh.AddTriangle(Index(Stack, Slice + 1), Index(Stack + 1, Slice), Index(Stack + 1, Slice + 1));
+            }
+        }
+        Mesh.Radius = 10.0f;
+        return Mesh;
+    }
+
+    double Now( void )
+    {
+        return std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+    }
+
+    void Normal( const TestMesh& Mesh, const uint16_t* Corners, float n[3] )
+    {
+        const float* p0 = Mesh.Vertex(Corners[0]);
+        const float* p1 = Mesh.Vertex(Corners[1]);
+        const float* p2 = Mesh.Vertex(Corners[2]);
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    float AverageEdgeLength( const TestMesh& Mesh )
+    {
+        double Sum = 0.0;
+        for (size_t n = 0; n < Mesh.Indices.size(); n += 3)
+        {
+            for (int Corner = 0; Corner < 3; ++Corner)
+            {
+                const float* a = Mesh.Vertex(Mesh.Indices[n + Corner]);
+                const float* b = Mesh.Vertex(Mesh.Indices[n + (Corner + 1) % 3]);
+                Sum += sqrt((double)(a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+            }
+        }
+        return (float)(Sum / std::max<size_t>(1, Mesh.Indices.size()));
+    }
+
+    std::vector<uint16_t> Simplify( const TestMesh& Mesh, float Ratio, float MaxError, float* Error = nullptr )
+    {
+        std::vector<uint16_t> Result(Mesh.Indices.size());
+        uint32_t Target = (uint32_t)(Mesh.Indices.size() / 3 * Ratio) * 3;
+        Result.resize(SimplifyMesh(Mesh.Source(), Target, MaxError, Result.data(), Error));
+        return Result;
+    }
+
+    void CheckSurfaceDistance( void )
+    {
+        // Two unit squares a quarter apart, and the lower one's triangles against each other
+        TestMesh Squares;
+        Squares.Name = "squares";
+        for (int Layer = 0; Layer < 2; ++Layer)
+        {
+            uint32_t v0 = Squares.AddVertex(0.0f, 0.0f, Layer * 0.25f, 0.0f, 0.0f);
+            uint32_t v1 = Squares.AddVertex(1.0f, 0.0f, Layer * 0.25f, 1.0f, 0.0f);
+            uint32_t v2 = Squares.AddVertex(1.0f, 1.0f, Layer * 0.25f, 1.0f, 1.0f);
+            uint32_t v3 = Squares.AddVertex(0.0f, 1.0f, Layer * 0.25f, 0.0f, 1.0f);
+            Squares.AddTriangle(v0, v1, v2);
+            Squares.AddTriangle(v0, v2, v3);
+        }
+
+        SimplifySource Lower = Squares.Source();
+        Lower.indexCount = 6;
+        SurfaceDistance Same = MeasureSurfaceDistance(Lower, Squares.Indices.data(), 6, 0.1f);
+        Check(Same.maxDistance < 1e-6f && Same.meanDistance < 1e-6f, "a surface is no distance from itself");
+
+        SurfaceDistance Apart = MeasureSurfaceDistance(Lower, Squares.Indices.data() + 6, 6, 0.1f);
+        Check(fabsf(Apart.maxDistance - 0.25f) < 1e-5f && fabsf(Apart.meanDistance - 0.25f) < 1e-5f, "parallel squares are a quarter apart");
+
+        SurfaceDistance Half = MeasureSurfaceDistance(Lower, Squares.Indices.data(), 3, 0.01f);
+        Check(fabsf(Half.maxDistance - 0.70710678f) < 1e-4f, "the far corner of a square is half a diagonal from its other half");
+        Check(Half.meanDistance > 0.05f && Half.meanDistance < 0.35f, "the mean distance lies between none and the most");
+    }
+
+    // Every triangle is made of vertices the mesh has, faces the way the original does, and doesn't span a
+    // texture seam
+    void CheckResult( const TestMesh& Mesh, const std::vector<uint16_t>& Result, const char* What, float Facing[3], bool Outward )
+    {
+        char Message[256];
+        bool IndicesValid = Result.size() % 3 == 0, Wound = true, Seamless = true;
+        const uint32_t VertexCount = (uint32_t)(Mesh.Vertices.size() / 5);
+        for (size_t n = 0; n + 2 < Result.size() && IndicesValid; n += 3)
+        {
+            IndicesValid = Result[n] < VertexCount && Result[n + 1] < VertexCount && Result[n + 2] < VertexCount;
+            if (!IndicesValid)
+                break;
+
+            float FaceNormal[3];
+            Normal(Mesh, &Result[n], FaceNormal);
+            if (Outward)
+            {
+                const float* p = Mesh.Vertex(Result[n]);
+                Wound = Wound && FaceNormal[0] * p[0] + FaceNormal[1] * p[1] + FaceNormal[2] * p[2] > 0.0f;
+            }
+            else
+                Wound = Wound && FaceNormal[0] * Facing[0] + FaceNormal[1] * Facing[1] + FaceNormal[2] * Facing[2] > 0.0f;
+
+            float UMin = 2.0f, UMax = -1.0f;
+            for (int Corner = 0; Corner < 3; ++Corner)
+            {
+                float u = Mesh.Vertex(Result[n + Corner])[3];
+                if (u >= 0.0f)
+                {
+                    UMin = std::min(UMin, u);
+                    UMax = std::max(UMax, u);
+                }
+            }
+            Seamless = Seamless && UMax - UMin < 0.75f;
+        }
+
+        sprintf_s(Message, sizeof(Message), "%s %s gives whole triangles of its own vertices", Mesh.Name, What);
+        Check(IndicesValid, Message);
+        sprintf_s(Message, sizeof(Message), "%s %s keeps its winding", Mesh.Name, What);
+        Check(Wound, Message);
+        sprintf_s(Message, sizeof(Message), "%s %s keeps its texture seam", Mesh.Name, What);
+        Check(Seamless, Message);
+    }
+
+    int SelfTest( void )
+    {
+        CheckSurfaceDistance();
+
+        float Up[3] = { 0.0f, 0.0f, 1.0f };
+        char Message[256];
+
+        // A flat grid is flat at any size, so any error limit leaves it a few triangles along its outline and seam
+        {
+            TestMesh Grid = MakeGrid("grid", 64, 21, []( uint32_t, uint32_t ) { return 0.0f; });
+            float Error;
+            std::vector<uint16_t> Result = Simplify(Grid, 0.0f, 1e-3f, &Error);
+            CheckResult(Grid, Result, "at its smallest", Up, false);
+            SurfaceDistance Distance = MeasureSurfaceDistance(Grid.Source(), Result.data(), (uint32_t)Result.size(), 0.5f);
+            printf("flat grid:  %zu of %zu triangles left, %.2g Hausdorff distance\n", Result.size() / 3, Grid.Indices.size() / 3, Distance.maxDistance);
+            Check(Result.size() / 3 < Grid.Indices.size() / 3 / 20, "a flat grid loses more than 95% of its triangles");
+            Check(Distance.maxDistance < 1e-3f && Error < 1e-3f, "a flat grid keeps its outline and seam");
+        }
+
+        // A UV sphere keeps its shape and its seam down to a tenth
+        TestMesh Sphere = MakeSphere(64, 32);
+        {
+            float Error;
+            std::vector<uint16_t> Result = Simplify(Sphere, 0.1f, FLT_MAX, &Error);
+            float Facing[3] = {};
+            CheckResult(Sphere, Result, "at a tenth", Facing, true);
+            SurfaceDistance Distance = MeasureSurfaceDistance(Sphere.Source(), Result.data(), (uint32_t)Result.size(), AverageEdgeLength(Sphere) * 0.5f);
+            printf("sphere at a tenth:  %zu of %zu triangles, Hausdorff %.2f%% of the radius, estimate %.2f%%\n",
+                Result.size() / 3, Sphere.Indices.size() / 3, Distance.maxDistance / Sphere.Radius * 100.0f, Error / Sphere.Radius * 100.0f);
+            Check(Result.size() <= (Sphere.Indices.size() / 3 / 10) * 3, "a sphere reaches a tenth of its triangles");
+            Check(Result.size() >= (Sphere.Indices.size() / 3 / 10) * 3 * 8 / 10, "a sphere doesn't overshoot its target by much");
+            Check(Distance.maxDistance < Sphere.Radius * 0.05f, "a sphere at a tenth stays within 5% of its radius");
+
+            std::vector<uint16_t> Again = Simplify(Sphere, 0.1f, FLT_MAX);
+            Check(Again == Result, "simplifying twice gives the same result");
+
+            // Simplifying a simplified mesh, as a LOD chain does
+            TestMesh Coarser = Sphere;
+            Coarser.Indices = Result;
+            std::vector<uint16_t> Chained = Simplify(Coarser, 0.5f, FLT_MAX);
+            CheckResult(Sphere, Chained, "simplified again", Facing, true);
+            Check(Chained.size() <= Result.size() / 2 + 3, "a simplified sphere simplifies again");
+        }
+
+        // An error limit stops the simplifier short of its target
+        {
+            const float Limit = Sphere.Radius * 0.002f;
+            float Error;
+            std::vector<uint16_t> Result = Simplify(Sphere, 0.1f, Limit, &Error);
+            sprintf_s(Message, sizeof(Message), "the error limit holds (%g against %g)", Error, Limit);
+            Check(Error <= Limit, Message);
+            Check(Result.size() > (Sphere.Indices.size() / 3 / 10) * 3, "a tight error limit stops short of the target");
+            Check(Result.size() < Sphere.Indices.size(), "a tight error limit still removes flat enough regions");
+        }
+
+        // Rolling terrain with a seam keeps its seam and outline and follows the hills
+        {
+            TestMesh Terrain = MakeGrid("terrain", 96, 40, []( uint32_t x, uint32_t y ) { return 4.0f * sinf(x * 0.1f) * cosf(y * 0.13f); });
+            std::vector<uint16_t> Result = Simplify(Terrain, 0.1f, FLT_MAX);
+            CheckResult(Terrain, Result, "at a tenth", Up, false);
+            SurfaceDistance Distance = MeasureSurfaceDistance(Terrain.Source(), Result.data(), (uint32_t)Result.size(), 0.5f);
+            printf("terrain at a tenth:  Hausdorff %.3f, mean %.4f, in cells of 1\n", Distance.maxDistance, Distance.meanDistance);
+            Check(Distance.maxDistance < 0.5f, "terrain at a tenth stays within half a cell");
+
+            // Vertices left on the seam column are split on both sides
+            bool SeamKept = true;
+            for (size_t n = 0; n < Result.size(); ++n)
+            {
+                const float* v = Terrain.Vertex(Result[n]);
+                if (v[0] == 40.0f)
+                    SeamKept = SeamKept && (v[3] > 1.0f) == (Terrain.Vertex(Result[n - n % 3])[0] + Terrain.Vertex(Result[n - n % 3 + 1])[0] +
+                        Terrain.Vertex(Result[n - n % 3 + 2])[0] > 120.0f);
+            }
+            Check(SeamKept, "triangles right of the seam use its right wedges");
+        }
+
+        // A fin on one edge of a grid and some degenerate triangles don't upset it.  The fin's tip can't move
+        // without moving the surface by far more than the flat grid around it.
+        {
+            TestMesh Fin = MakeGrid("fin", 8, 100, []( uint32_t, uint32_t ) { return 0.0f; });
+            uint32_t Top = Fin.AddVertex(3.0f, 3.0f, 2.0f, 0.0f, 0.0f);
+            Fin.AddTriangle(3 * 8 + 3, 3 * 8 + 4, Top);
+            Fin.AddTriangle(5, 5, 6);
+            Fin.AddTriangle(9, 10, 9);
+            std::vector<uint16_t> Result = Simplify(Fin, 0.0f, 0.01f);
+            bool FinKept = false, EdgeKept = false, DegenerateGone = true;
+            for (size_t n = 0; n < Result.size(); n += 3)
+            {
+                FinKept = FinKept || Result[n] == Top || Result[n + 1] == Top || Result[n + 2] == Top;
+                EdgeKept = EdgeKept || (std::count(&Result[n], &Result[n] + 3, (uint16_t)(3 * 8 + 3)) && std::count(&Result[n], &Result[n] + 3, (uint16_t)(3 * 8 + 4)));
+                DegenerateGone = DegenerateGone && Result[n] != Result[n + 1] && Result[n + 1] != Result[n + 2] && Result[n + 2] != Result[n];
+            }
+            Check(FinKept && EdgeKept, "a fin and the edge it stands on stay");
+            Check(DegenerateGone, "degenerate triangles are dropped");
+            Check(Result.size() < Fin.Indices.size() / 2, "the rest of a mesh with a fin still simplifies");
+        }
+
+        return 0;
+    }
+
+    int Bench( uint32_t ThreadCount )
+    {
+        std::mt19937 Random(7);
+        std::uniform_real_distribution<float> Noise(-0.05f, 0.05f);
+        const TestMesh Meshes[] =
+        {
+            MakeSphere(256, 128),
+            MakeGrid("terrain", 180, 90, []( uint32_t x, uint32_t y ) { return 8.0f * sinf(x * 0.05f) * cosf(y * 0.07f) + sinf(x * 0.5f + y * 0.3f); }),
+            MakeGrid("noisy", 180, 60, [&]( uint32_t, uint32_t ) { return Noise(Random); }),
+        };
+        const float Ratios[] = { 0.5f, 0.25f, 0.1f, 0.02f };
+
+        printf("%-8s %9s %9s %12s %11s %11s\n", "mesh", "ratio", "triangles", "Mtri/s", "Hausdorff", "mean");
+        for (const TestMesh& Mesh : Meshes)
+        {
+            const uint32_t TriangleCount = (uint32_t)Mesh.Indices.size() / 3;
+            const float Spacing = AverageEdgeLength(Mesh) * 0.5f;
+            for (float Ratio : Ratios)
+            {
+                std::vector<uint16_t> Result;
+                double Best = 1e30;
+                for (int Pass = 0; Pass < 3; ++Pass)
+                {
+                    double Start = Now();
+                    Result = Simplify(Mesh, Ratio, FLT_MAX);
+                    Best = std::min(Best, Now() - Start);
+                }
+                SurfaceDistance Distance = MeasureSurfaceDistance(Mesh.Source(), Result.data(), (uint32_t)Result.size(), Spacing);
+                printf("%-8s %9.2f %9zu %12.2f %10.3f%% %10.4f%%\n", Mesh.Name, Ratio, Result.size() / 3, TriangleCount / Best / 1e6,
+                    Distance.maxDistance / Mesh.Radius * 100.0f, Distance.meanDistance / Mesh.Radius * 100.0f);
+            }
+        }
+
+        // A LOD chain for many meshes at once, each simplified from the last level, one mesh per thread at a time
+        const uint32_t Copies = 24;
+        for (uint32_t Threads = 1; Threads <= ThreadCount; Threads *= 2)
+        {
+            std::atomic<uint32_t> Next(0);
+            uint64_t Triangles = 0;
+            for (uint32_t n = 0; n < Copies; ++n)
+                Triangles += Meshes[n % 3].Indices.size() / 3;
+
+            auto Worker = [&]()
+            {
+                for (uint32_t n = Next++; n < Copies; n = Next++)
+                {
+                    TestMesh Level = Meshes[n % 3];
+                    for (int Lod = 0; Lod < 4 && Level.Indices.size() > 48; ++Lod)
+                        Level.Indices = Simplify(Level, 0.5f, FLT_MAX);
+                }
+            };
+
+            double Start = Now();
+            std::vector<std::thread> Pool;
+            for (uint32_t t = 1; t < Threads; ++t)
+                Pool.emplace_back(Worker);
+            Worker();
+            for (auto& Thread : Pool)
+                Thread.join();
+            double Seconds = Now() - Start;
+            printf("LOD chains of %u meshes on %u threads:  %.2f M source triangles/s\n", Copies, Threads, Triangles / Seconds / 1e6);
+        }
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "bench", "[threads]", 1, []( int ArgCount, char* Args[] )
+        {
+            uint32_t ThreadCount = TestHarness::GetCountArgument(ArgCount, Args, 0, std::max(1u, std::thread::hardware_concurrency()));
+            return ThreadCount == 0 ? TestHarness::kBadArguments : Bench(ThreadCount);
+        } },
+    };
+    return TestHarness::RunCommand(argc, argv, "MeshSimplifyTest", kCommands);
+}
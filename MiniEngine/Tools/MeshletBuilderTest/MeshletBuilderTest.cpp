@@ -0,0 +1,429 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking and timing the meshlet builder (ModelConverter/MeshletBuilder.cpp).
+//
+//   MeshletBuilderTest selftest
+//       Builds meshlets for generated meshes (a flat grid, a sphere, a soup of separate triangles, a mesh with
+//       duplicate and degenerate triangles, and one using all 65536 vertex indices) under several limits, and
+//       runs the validator on each.  It then corrupts the results in the ways the validator exists to catch
+//       and checks that it does.  For the grid and sphere it checks how full the meshlets are, and from eye
+//       positions all around the sphere it checks that every meshlet the cone rejects really is back-facing.
+//   MeshletBuilderTest bench
+//       Reports build time per million triangles, average fill and how many meshlets the cones cull from a
+//       random distant eye, for each mesh and limit.
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "pch.h"
+#include "MeshletBuilder.h"
+#include "../TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+    struct TestMesh
+    {
+        const char* Name;
+        std::vector<float> Positions;   // x, y, z, plus a fourth float so the stride isn't 12
+        std::vector<uint16_t> Indices;
+
+        MeshletSource Source( void ) const
+        {
+            MeshletSource Source;
+            Source.positions = Positions.data();
+            Source.vertexStride = 16;
+            Source.vertexCount = (uint32_t)(Positions.size() / 4);
+            Source.indices = Indices.data();
+            Source.indexCount = (uint32_t)Indices.size();
+            return Source;
+        }
+
+        void AddVertex( float x, float y, float z )
+        {
+            Positions.insert(Positions.end(), { x, y, z, 1.0f });
+        }
+
+        void AddTriangle( uint32_t i0, uint32_t i1, uint32_t i2 )
+        {
+            Indices.insert(Indices.end(), { (uint16_t)i0, (uint16_t)i1, (uint16_t)i2 });
+        }
+    };
+
+    // A flat grid of quads in the XY plane, facing +Z
+    TestMesh MakeGrid( uint32_t Width, uint32_t Height )
+    {
+        TestMesh Mesh;
+        Mesh.Name = "grid";
+        for (uint32_t y = 0; y < Height; ++y)
+            for (uint32_t x = 0; x < Width; ++x)
+                Mesh.AddVertex((float)x, (float)y, 0.0f);
+
+        for (uint32_t y = 0; y + 1 < Height; ++y)
+        {
+            for (uint32_t x = 0; x + 1 < Width; ++x)
+            {
+                uint32_t v = y * Width + x;
+                Mesh.AddTriangle(v, v + 1, v + Width + 1);
+                Mesh.AddTriangle(v, v + Width + 1, v + Width);
+            }
+        }
+        return Mesh;
+    }
+
+    // A latitude-longitude sphere of radius 10, facing out, with fans at the poles
+    TestMesh MakeSphere( uint32_t Slices, uint32_t Stacks )
+    {
+        TestMesh Mesh;
+        Mesh.Name = "sphere";
+        const float Pi = 3.14159265f;
+        Mesh.AddVertex(0.0f, 0.0f, 10.0f);
+        for (uint32_t Stack = 1; Stack < Stacks; ++Stack)
+        {
+            float Theta = Pi * Stack / Stacks;
+            for (uint32_t Slice = 0; Slice < Slices; ++Slice)
+            {
+                float Phi = 2.0f * Pi * Slice / Slices;
+                Mesh.AddVertex(10.0f * sinf(Theta) * cosf(Phi), 10.0f * sinf(Theta) * sinf(Phi), 10.0f * cosf(Theta));
+            }
+        }
+        const uint32_t South = (uint32_t)Mesh.Positions.size() / 4;
+        Mesh.AddVertex(0.0f, 0.0f, -10.0f);
+
+        auto Ring = [&]( uint32_t Stack, uint32_t Slice ) { return 1 + (Stack - 1) * Slices + Slice % Slices; };
+        for (uint32_t Slice = 0; Slice < Slices; ++Slice)
+        {
+            Mesh.AddTriangle(0, Ring(1, Slice), Ring(1, Slice + 1));
+            for (uint32_t Stack = 1; Stack + 1 < Stacks; ++Stack)
+            {
+                Mesh.AddTriangle(Ring(Stack, Slice), Ring(Stack + 1, Slice), Ring(Stack + 1, Slice + 1));
+                Mesh.AddTriangle(Ring(Stack, Slice), Ring(Stack + 1, Slice + 1), Ring(Stack, Slice + 1));
+            }
+            Mesh.AddTriangle(South, Ring(Stacks - 1, Slice + 1), Ring(Stacks - 1, Slice));
+        }
+        return Mesh;
+    }
+
+    // Small separate triangles scattered through a box, like leaves, in a random order
+    TestMesh MakeSoup( uint32_t Count, uint32_t Seed )
+    {
+        TestMesh Mesh;
+        Mesh.Name = "soup";
+        std::mt19937 Random(Seed);
+        std::uniform_real_distribution<float> Place(0.0f, 100.0f), Jitter(-1.0f, 1.0f);
+        for (uint32_t n = 0; n < Count; ++n)
+        {
+            float x = Place(Random), y = Place(Random), z = Place(Random);
+            uint32_t v = (uint32_t)Mesh.Positions.size() / 4;
+            Mesh.AddVertex(x, y, z);
+            Mesh.AddVertex(x + 1.0f + Jitter(Random) * 0.5f, y + Jitter(Random) * 0.5f, z + Jitter(Random));
+            Mesh.AddVertex(x + Jitter(Random) * 0.5f, y + 1.0f + Jitter(Random) * 0.5f, z + Jitter(Random));
+            Mesh.AddTriangle(v, v + 1, v + 2);
+        }
+        return Mesh;
+    }
+
+    // A grid with some triangles repeated and some collapsed to a line or a point
+    TestMesh MakeAwkward( void )
+    {
+        TestMesh Mesh = MakeGrid(12, 12);
+        Mesh.Name = "awkward";
+        const size_t TriangleCount = Mesh.Indices.size() / 3;
+        for (size_t t = 0; t < TriangleCount; t += 7)
+            Mesh.AddTriangle(Mesh.Indices[t * 3], Mesh.Indices[t * 3 + 1], Mesh.Indices[t * 3 + 2]);
+        Mesh.AddTriangle(5, 5, 6);
+        Mesh.AddTriangle(7, 7, 7);
+        Mesh.AddTriangle(0, 1, 2);    // collinear
+        Mesh.AddTriangle(20, 19, 31); // back-facing, against the rest
+        return Mesh;
+    }
+
+    double Now( void )
+    {
+        return std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+    }
+
+    struct Fill
+    {
+        double Vertices;    // average share of the vertex limit used
+        double Triangles;
+        double Binding;     // average share of whichever limit is closer
+    };
+
+    Fill MeasureFill( const MeshletList& List, uint32_t MaxVertices, uint32_t MaxPrimitives )
+    {
+        Fill Result = {};
+        for (const Meshlet& Current : List.meshlets)
+        {
+            double v = (double)Current.vertexCount / MaxVertices, t = (double)Current.primitiveCount / MaxPrimitives;
+            Result.Vertices += v;
+            Result.Triangles += t;
+            Result.Binding += std::max(v, t);
+        }
+        const double Count = (double)std::max<size_t>(1, List.meshlets.size());
+        Result.Vertices /= Count;
+        Result.Triangles /= Count;
+        Result.Binding /= Count;
+        return Result;
+    }
+
+    bool Validate( const TestMesh& Mesh, const MeshletList& List, uint32_t MaxVertices, uint32_t MaxPrimitives, char* Error, size_t ErrorSize )
+    {
+        return ValidateMeshlets(Mesh.Source(), List, 0, (uint32_t)List.meshlets.size(), MaxVertices, MaxPrimitives, Error, ErrorSize);
+    }
+
+    // The share of meshlets the cone culls, checking that each culled one is back-facing for this eye
+    double ConeCullRate( const TestMesh& Mesh, const MeshletList& List, const float Eye[3], bool& Conservative )
+    {
+        uint32_t Culled = 0;
+        for (const Meshlet& Current : List.meshlets)
+        {
+            if (!IsMeshletBackFacing(Current, Eye[0], Eye[1], Eye[2]))
+                continue;
+
+            ++Culled;
+            for (uint32_t n = 0; n < Current.primitiveCount; ++n)
+            {
+                uint32_t Primitive = List.primitives[Current.primitiveOffset + n];
+                const float* p[3];
+                for (uint32_t Corner = 0; Corner < 3; ++Corner)
+                    p[Corner] = &Mesh.Positions[List.vertices[Current.vertexOffset + UnpackMeshletIndex(Primitive, Corner)] * 4];
+
+                float e1[3], e2[3], ToEye[3];
+                for (int c = 0; c < 3; ++c)
+                {
+                    e1[c] = p[1][c] - p[0][c];
+                    e2[c] = p[2][c] - p[0][c];
+                    ToEye[c] = Eye[c] - p[0][c];
+                }
+                float Normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+                float Facing = Normal[0] * ToEye[0] + Normal[1] * ToEye[1] + Normal[2] * ToEye[2];
+                float Scale = sqrtf(Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2]) *
+                    sqrtf(ToEye[0] * ToEye[0] + ToEye[1] * ToEye[1] + ToEye[2] * ToEye[2]);
+                if (Facing > 1e-4f * Scale)
+                    Conservative = false;
+            }
+        }
+        return (double)Culled / std::max<size_t>(1, List.meshlets.size());
+    }
+
+    void CheckMesh( const TestMesh& Mesh, uint32_t MaxVertices, uint32_t MaxPrimitives )
+    {
+        MeshletList List;
+        BuildMeshlets(Mesh.Source(), MaxVertices, MaxPrimitives, List);
+
+        char Error[256], Message[512];
+        bool Valid = Validate(Mesh, List, MaxVertices, MaxPrimitives, Error, sizeof(Error));
+        sprintf_s(Message, sizeof(Message), "%s with %u/%u: %s", Mesh.Name, MaxVertices, MaxPrimitives, Valid ? "valid" : Error);
+        Check(Valid, Message);
+
+        MeshletList Again;
+        BuildMeshlets(Mesh.Source(), MaxVertices, MaxPrimitives, Again);
+        sprintf_s(Message, sizeof(Message), "%s with %u/%u builds the same twice", Mesh.Name, MaxVertices, MaxPrimitives);
+        Check(Again.primitives == List.primitives && Again.vertices == List.vertices &&
+            memcmp(Again.meshlets.data(), List.meshlets.data(), List.meshlets.size() * sizeof(Meshlet)) == 0, Message);
+    }
+
+    void CheckCorruptionsAreCaught( void )
+    {
+        const TestMesh Mesh = MakeSphere(24, 12);
+        MeshletList Built;
+        BuildMeshlets(Mesh.Source(), 64, 124, Built);
+        char Error[256];
+
+        struct Corruption
+        {
+            const char* Name;
+            void (*Apply)( MeshletList& List );
+        };
+        const Corruption Corruptions[] =
+        {
+            { "a dropped triangle", []( MeshletList& List ) { List.meshlets[1].primitiveCount--; } },
+            { "a repeated triangle", []( MeshletList& List ) { List.primitives[List.meshlets[0].primitiveOffset + 1] = List.primitives[List.meshlets[0].primitiveOffset]; } },
+            { "a flipped triangle", []( MeshletList& List )
+                {
+                    uint32_t& p = List.primitives[List.meshlets[2].primitiveOffset];
+                    p = PackMeshletTriangle(UnpackMeshletIndex(p, 0), UnpackMeshletIndex(p, 2), UnpackMeshletIndex(p, 1));
+                } },
+            { "a local index past the meshlet's vertices", []( MeshletList& List ) { List.primitives[List.meshlets[0].primitiveOffset] |= 0x3FF; } },
+            { "a vertex past the mesh", []( MeshletList& List ) { List.vertices[List.meshlets[0].vertexOffset] = 60000; } },
+            { "too many triangles", []( MeshletList& List ) { List.meshlets[0].primitiveCount = 125; } },
+            { "a sphere too small", []( MeshletList& List ) { List.meshlets[3].radius *= 0.99f; } },
+            { "a cone too narrow", []( MeshletList& List )
+                {
+                    for (Meshlet& m : List.meshlets)
+                        if (m.coneCutoff < 1.0f)
+                        {
+                            m.coneCutoff = std::max(0.0f, m.coneCutoff - 0.05f);
+                            break;
+                        }
+                } },
+            { "a cone apex in front", []( MeshletList& List )
+                {
+                    for (Meshlet& m : List.meshlets)
+                        if (m.coneCutoff < 1.0f)
+                        {
+                            for (int c = 0; c < 3; ++c)
+                                m.coneApex[c] += m.coneAxis[c] * m.radius * 2.0f;
+                            break;
+                        }
+                } },
+        };
+
+        for (const Corruption& Damage : Corruptions)
+        {
+            MeshletList List = Built;
+            Damage.Apply(List);
+            char Message[256];
+            sprintf_s(Message, sizeof(Message), "the validator catches %s", Damage.Name);
+            Check(!Validate(Mesh, List, 64, 124, Error, sizeof(Error)), Message);
+        }
+    }
+
+    int SelfTest( void )
+    {
+        const TestMesh Meshes[] = { MakeGrid(40, 30), MakeSphere(48, 24), MakeSoup(3000, 1), MakeAwkward(), MakeGrid(256, 256) };
+        const uint32_t Limits[][2] = { { 64, 124 }, { 128, 256 }, { 256, 256 }, { 32, 16 }, { 3, 1 }, { 4, 256 } };
+        for (const TestMesh& Mesh : Meshes)
+            for (auto& Limit : Limits)
+                CheckMesh(Mesh, Limit[0], Limit[1]);
+
+        CheckCorruptionsAreCaught();
+
+        // Two meshes built into one list keep their own ranges
+        {
+            const TestMesh Grid = MakeGrid(20, 20), Sphere = MakeSphere(16, 8);
+            MeshletList List;
+            BuildMeshlets(Grid.Source(), 64, 124, List);
+            uint32_t GridCount = (uint32_t)List.meshlets.size();
+            BuildMeshlets(Sphere.Source(), 64, 124, List);
+            char Error[256];
+            Check(ValidateMeshlets(Grid.Source(), List, 0, GridCount, 64, 124, Error, sizeof(Error)) &&
+                ValidateMeshlets(Sphere.Source(), List, GridCount, (uint32_t)List.meshlets.size() - GridCount, 64, 124, Error, sizeof(Error)),
+                "meshlets appended after another mesh's");
+        }
+
+        // Connected meshes fill their meshlets:  a grid meshlet can't beat 8x8 vertices and 98 triangles
+        {
+            const TestMesh Grid = MakeGrid(100, 100), Sphere = MakeSphere(64, 32);
+            MeshletList GridList, SphereList;
+            BuildMeshlets(Grid.Source(), 64, 124, GridList);
+            BuildMeshlets(Sphere.Source(), 64, 124, SphereList);
+            Fill GridFill = MeasureFill(GridList, 64, 124), SphereFill = MeasureFill(SphereList, 64, 124);
+            printf("fill at 64/124:  grid %.1f%% of vertices, %.1f%% of triangles; sphere %.1f%%, %.1f%%\n",
+                GridFill.Vertices * 100.0, GridFill.Triangles * 100.0, SphereFill.Vertices * 100.0, SphereFill.Triangles * 100.0);
+            Check(GridFill.Binding > 0.9, "grid meshlets are at least 90% full");
+            Check(SphereFill.Binding > 0.9, "sphere meshlets are at least 90% full");
+
+            // A flat grid faces one way, so its cones are exact
+            bool Flat = true;
+            for (const Meshlet& Current : GridList.meshlets)
+                Flat = Flat && Current.coneCutoff < 1e-3f && Current.coneAxis[2] > 0.999f;
+            Check(Flat, "grid cones point straight out with no spread");
+
+            // Cones cull only back-facing meshlets, and a fair share of them from any direction
+            std::mt19937 Random(11);
+            std::normal_distribution<float> Direction;
+            bool Conservative = true;
+            double WorstRate = 1.0;
+            for (int n = 0; n < 200; ++n)
+            {
+                float d[3] = { Direction(Random), Direction(Random), Direction(Random) };
+                float Length = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+                float Distance = n % 2 ? 1000.0f : 11.0f + n * 0.1f;
+                float Eye[3] = { d[0] / Length * Distance, d[1] / Length * Distance, d[2] / Length * Distance };
+                WorstRate = std::min(WorstRate, ConeCullRate(Sphere, SphereList, Eye, Conservative));
+            }
+            printf("sphere cones cull at least %.1f%% of meshlets from any direction\n", WorstRate * 100.0);
+            Check(Conservative, "cones cull only back-facing meshlets");
+            Check(WorstRate > 0.2, "sphere cones cull at least 20% of meshlets");
+
+            float Behind[3] = { 50.0f, 50.0f, -10.0f }, InFront[3] = { 50.0f, 50.0f, 10.0f };
+            bool GridConservative = true;
+            Check(ConeCullRate(Grid, GridList, Behind, GridConservative) == 1.0 && ConeCullRate(Grid, GridList, InFront, GridConservative) == 0.0,
+                "a grid seen from behind is culled and from in front is not");
+            Check(GridConservative, "grid cones cull only back-facing meshlets");
+        }
+
+        return 0;
+    }
+
+    int Bench( void )
+    {
+        const TestMesh Meshes[] = { MakeGrid(255, 255), MakeSphere(256, 250), MakeSoup(21000, 2) };
+        const uint32_t Limits[][2] = { { 64, 124 }, { 128, 256 }, { 256, 256 } };
+
+        printf("%-8s %-9s %10s %10s %10s %10s %10s\n", "mesh", "limits", "triangles", "meshlets", "ms/Mtri", "fill", "cone cull");
+        for (const TestMesh& Mesh : Meshes)
+        {
+            const uint32_t TriangleCount = (uint32_t)Mesh.Indices.size() / 3;
+            const uint32_t Repeats = std::max(1u, 2000000 / TriangleCount);
+            for (auto& Limit : Limits)
+            {
+                MeshletList List;
+                double Best = 1e30;
+                for (uint32_t Pass = 0; Pass < 3; ++Pass)
+                {
+                    double Start = Now();
+                    for (uint32_t n = 0; n < Repeats; ++n)
+                    {
+                        List = MeshletList();
+                        BuildMeshlets(Mesh.Source(), Limit[0], Limit[1], List);
+                    }
+                    Best = std::min(Best, (Now() - Start) / Repeats);
+                }
+
+                char Error[256];
+                if (!Validate(Mesh, List, Limit[0], Limit[1], Error, sizeof(Error)))
+                {
+                    printf("%s: %s\n", Mesh.Name, Error);
+                    return 1;
+                }
+
+                std::mt19937 Random(3);
+                std::normal_distribution<float> Direction;
+                double CullRate = 0.0;
+                bool Conservative = true;
+                for (int n = 0; n < 64; ++n)
+                {
+                    float d[3] = { Direction(Random), Direction(Random), Direction(Random) };
+                    float Length = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+                    float Eye[3] = { d[0] / Length * 1000.0f, d[1] / Length * 1000.0f, d[2] / Length * 1000.0f };
+                    CullRate += ConeCullRate(Mesh, List, Eye, Conservative) / 64.0;
+                }
+
+                char LimitName[16];
+                sprintf_s(LimitName, sizeof(LimitName), "%u/%u", Limit[0], Limit[1]);
+                printf("%-8s %-9s %10u %10zu %10.1f %9.1f%% %9.1f%%\n", Mesh.Name, LimitName, TriangleCount, List.meshlets.size(),
+                    Best * 1000.0 * 1e6 / TriangleCount, MeasureFill(List, Limit[0], Limit[1]).Binding * 100.0, CullRate * 100.0);
+            }
+        }
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "bench", "", 0, []( int, char*[] ) { return Bench(); } },
+    };
+    return TestHarness::RunCommand(argc, argv, "MeshletBuilderTest", kCommands);
+}
@@ -0,0 +1,246 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "DistanceField.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+float DistanceFromInside( const Canvas& canvas, uint32_t xCoord, uint32_t yCoord, uint32_t maxDistance )
+{
+	const uint32_t radius = maxDistance * 32;
+	const uint32_t x0 =	xCoord * 32 + 15;
+	const uint32_t y0 =	yCoord * 32 + 15;
+
+	uint32_t left =		(uint32_t)max(0, (int32_t)(x0 - radius + 1));
+	uint32_t right =	x0 + radius - 1;
+	uint32_t top =		(uint32_t)max(0, (int32_t)(y0 - radius + 1));
+	uint32_t bottom =	y0 + radius - 1;
+
+	uint32_t bestDistSq = radius * radius;
+
+	for (uint32_t y1 = top; y1 <= bottom; y1 += 2)
+	{
+		int32_t distY = (int32_t)(y1 - y0);
+		uint32_t distYSq = (uint32_t)(distY * distY);
+
+		if (distYSq >= bestDistSq)
+		{
+			if (y1 > y0)
+				continue;
+			else
+				break;
+		}
+
+		for (uint32_t x1 = left; x1 <= right; x1 += 2)
+		{
+			int32_t distX = (int32_t)(x1 - x0);
+			uint32_t distXSq = (uint32_t)(distX * distX);
+
+			uint32_t distSq = (uint32_t)(distXSq + distYSq);
+			if (distSq < bestDistSq && !ReadCanvasBit(canvas, x1 >> 1, y1 >> 1))
+				bestDistSq = distSq;
+		}
+	}
+
+	return sqrt((float)bestDistSq) / (float)radius;
+}
+
+float DistanceFromOutside( const Canvas& canvas, uint32_t xCoord, uint32_t yCoord, uint32_t maxDistance )
+{
+	const uint32_t radius = maxDistance * 32;
+	const uint32_t x0 =	xCoord * 32 + 15;
+	const uint32_t y0 =	yCoord * 32 + 15;
+
+	uint32_t left =		(uint32_t)max(0, (int32_t)(x0 - radius + 1));
+	uint32_t right =	x0 + radius - 1;
+	uint32_t top =		(uint32_t)max(0, (int32_t)(y0 - radius + 1));
+	uint32_t bottom =	y0 + radius - 1;
+
+	uint32_t bestDistSq = radius * radius;
+
+	for (uint32_t y1 = top; y1 <= bottom; y1 += 2)
+	{
+		int32_t distY = (int32_t)(y1 - y0);
+		uint32_t distYSq = (uint32_t)(distY * distY);
+
+		if (distYSq >= bestDistSq)
+		{
+			if (y1 > y0)
+				continue;
+			else
+				break;
+		}
+
+		for (uint32_t x1 = left; x1 <= right; x1 += 2)
+		{
+			int32_t distX = (int32_t)(x1 - x0);
+			uint32_t distXSq = (uint32_t)(distX * distX);
+
+			uint32_t distSq = (uint32_t)(distXSq + distYSq);
+			if (distSq < bestDistSq && ReadCanvasBit(canvas, x1 >> 1, y1 >> 1))
+				bestDistSq = distSq;
+		}
+	}
+
+	return sqrt((float)bestDistSq) / (float)radius;
+}
+
+void ComputeDistanceFieldBruteForce( const Canvas& canvas, uint32_t texelsX, uint32_t texelsY, uint32_t maxDistance,
+	float* dest, uint32_t destPitch )
+{
+	// Convert high-res bitmap to low-res distance map
+	for (uint32_t x = 0; x < texelsX; ++x)
+	{
+		for (uint32_t y = 0; y < texelsY; ++y)
+		{
+			uint32_t left = x * 16 + 7;
+			uint32_t top = y * 16 + 7;
+
+			bool inside = ReadCanvasBit(canvas, left, top) & ReadCanvasBit(canvas, left + 1, top) &
+				ReadCanvasBit(canvas, left, top + 1) & ReadCanvasBit(canvas, left + 1, top + 1);
+
+			if (inside)
+				dest[x + y * destPitch] = +DistanceFromInside(canvas, x, y, maxDistance);
+			else
+				dest[x + y * destPitch] = -DistanceFromOutside(canvas, x, y, maxDistance);
+		}
+	}
+}
+
+// The brute force search above is kept as a reference for -benchmark and DistanceFieldTest.  Painting uses an exact
+// Euclidean distance transform instead (Felzenszwalb & Huttenlocher, "Distance Transforms of Sampled
+// Functions"), which is linear in the number of high-res pixels rather than proportional to the search area.
+//
+// Distances are measured in the same half-pixel units as the brute force search:  high-res pixel p sits at 2p and
+// the center of low-res texel t sits at 32t + 15, so both methods compute exactly the same squared distances.
+
+static const double kNoFeature = 1e20;
+
+// For each query q = 32j + 15 (j < numQueries), computes min over i of (q - 2i)^2 + f[i].  Entries of f equal to
+// kNoFeature are skipped.  v and z are scratch space of at least n and n + 1 entries.
+static void DistanceTransform1D( const double* f, uint32_t n, double* d, uint32_t numQueries, uint32_t* v, double* z )
+{
+	// Build the lower envelope of the parabolas rooted at each feature
+	int32_t k = -1;
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		if (f[i] >= kNoFeature)
+			continue;
+
+		double s = -kNoFeature;
+		while (k >= 0)
+		{
+			uint32_t j = v[k];
+			s = ((f[i] + 4.0 * i * i) - (f[j] + 4.0 * j * j)) / (4.0 * ((double)i - (double)j));
+			if (s > z[k])
+				break;
+			--k;
+		}
+		if (k < 0)
+			s = -kNoFeature;
+
+		++k;
+		v[k] = i;
+		z[k] = s;
+	}
+
+	if (k < 0)
+	{
+		for (uint32_t j = 0; j < numQueries; ++j)
+			d[j] = kNoFeature;
+		return;
+	}
+
+	z[k + 1] = kNoFeature;
+
+	// Queries are sorted, so walk the envelope once
+	int32_t m = 0;
+	for (uint32_t j = 0; j < numQueries; ++j)
+	{
+		double q = 32.0 * j + 15.0;
+		while (z[m + 1] < q)
+			++m;
+
+		double dx = q - 2.0 * v[m];
+		d[j] = dx * dx + f[v[m]];
+	}
+}
+
+// Computes the squared distance from the center of every texel of a texelsX x texelsY region to the nearest
+// high-res pixel whose glyph coverage equals 'covered'.
+static void SquaredDistanceToCoverage( DistanceFieldScratch& scratch, uint32_t gridW, uint32_t gridH,
+	uint32_t texelsX, uint32_t texelsY, bool covered, vector<double>& result )
+{
+	// First pass:  distance along each column, evaluated only at the texel rows
+	for (uint32_t x = 0; x < gridW; ++x)
+	{
+		for (uint32_t y = 0; y < gridH; ++y)
+			scratch.column[y] = (scratch.bits[x + y * gridW] != 0) == covered ? 0.0 : kNoFeature;
+
+		DistanceTransform1D(scratch.column.data(), gridH, scratch.rowDist.data(), texelsY, scratch.v.data(), scratch.z.data());
+
+		for (uint32_t y = 0; y < texelsY; ++y)
+			scratch.columnDist[x + y * gridW] = scratch.rowDist[y];
+	}
+
+	// Second pass:  combine the columns along each texel row
+	for (uint32_t y = 0; y < texelsY; ++y)
+	{
+		DistanceTransform1D(&scratch.columnDist[y * gridW], gridW, &result[y * texelsX], texelsX, scratch.v.data(), scratch.z.data());
+	}
+}
+
+void ComputeDistanceField( DistanceFieldScratch& scratch, const Canvas& canvas, uint32_t texelsX, uint32_t texelsY,
+	uint32_t maxDistance, float* dest, uint32_t destPitch )
+{
+	// Nothing farther than the search radius can affect a texel, so the grid only needs to extend that far
+	// beyond the region.  Like the brute force search, it never extends above or to the left of it.
+	const uint32_t radius = maxDistance * 32;
+	const uint32_t gridW = (texelsX + maxDistance) * 16;
+	const uint32_t gridH = (texelsY + maxDistance) * 16;
+	const uint32_t maxDim = max(gridW, gridH);
+
+	scratch.bits.resize(gridW * gridH);
+	scratch.column.resize(gridH);
+	scratch.columnDist.resize(gridW * texelsY);
+	scratch.insideDist.resize(texelsX * texelsY);
+	scratch.outsideDist.resize(texelsX * texelsY);
+	scratch.rowDist.resize(max(texelsX, texelsY));
+	scratch.v.resize(maxDim);
+	scratch.z.resize(maxDim + 1);
+
+	for (uint32_t y = 0; y < gridH; ++y)
+		for (uint32_t x = 0; x < gridW; ++x)
+			scratch.bits[x + y * gridW] = ReadCanvasBit(canvas, x, y) ? 1 : 0;
+
+	SquaredDistanceToCoverage(scratch, gridW, gridH, texelsX, texelsY, false, scratch.insideDist);
+	SquaredDistanceToCoverage(scratch, gridW, gridH, texelsX, texelsY, true, scratch.outsideDist);
+
+	const double radiusSq = (double)radius * radius;
+
+	for (uint32_t y = 0; y < texelsY; ++y)
+	{
+		for (uint32_t x = 0; x < texelsX; ++x)
+		{
+			uint32_t left = x * 16 + 7;
+			uint32_t top = y * 16 + 7;
+
+			bool inside = ReadCanvasBit(canvas, left, top) & ReadCanvasBit(canvas, left + 1, top) &
+				ReadCanvasBit(canvas, left, top + 1) & ReadCanvasBit(canvas, left + 1, top + 1);
+
+			double distSq = inside ? scratch.insideDist[x + y * texelsX] : scratch.outsideDist[x + y * texelsX];
+			float dist = sqrt((float)(uint32_t)min(distSq, radiusSq)) / (float)radius;
+
+			dest[x + y * destPitch] = inside ? +dist : -dist;
+		}
+	}
+}
@@ -0,0 +1,65 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Signed distance fields for SDFFontCreator.  Glyphs are rendered at 16x the resolution of the distance map
+// (one texel covers 16x16 high-res pixels), and each texel stores the distance from its center to the nearest
+// pixel of the opposite coverage, divided by the search radius and negated outside the glyph.  maxDistance is
+// the search radius in texels.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct Canvas
+{
+	uint8_t* bitmap;	// Pointer to rendered glyph memory (from FT_Bitmap)
+	uint32_t pitch;		// Width in bytes of a row in the canvas
+	uint32_t width;		// Width in pixels of a row in the canvas
+	uint32_t rows;		// Number of rows in the canvas
+	uint32_t xOff;		// Amount to offset the x coordinate when reading
+	uint32_t yOff;		// Amount to offset the y coordinate when reading
+};
+
+// Access the high res glyph canvas
+inline bool ReadCanvasBit( const Canvas& canvas, uint32_t x, uint32_t y )
+{
+	// Notice that negative values have been cast to large positive values
+	x -= canvas.xOff;
+	y -= canvas.yOff;
+	if (x >= canvas.width || y >= canvas.rows)
+		return false;
+
+	uint32_t p = y * canvas.pitch + x / 8;
+	uint32_t k = x & 7;
+	return (canvas.bitmap[p] & (0x80 >> k)) ? true : false;
+}
+
+// Per-thread scratch memory for ComputeDistanceField so that painting doesn't allocate for every glyph
+struct DistanceFieldScratch
+{
+	std::vector<uint8_t> bits;		// Glyph coverage of the high-res region
+	std::vector<double> column;		// Feature costs along one column
+	std::vector<double> columnDist;	// Per-column distances at each texel row
+	std::vector<double> insideDist;	// Squared distance to the nearest uncovered pixel, one row per texel row
+	std::vector<double> outsideDist;	// Squared distance to the nearest covered pixel, one row per texel row
+	std::vector<double> rowDist;
+	std::vector<uint32_t> v;
+	std::vector<double> z;
+};
+
+// Reference implementation:  searches the whole radius around every texel
+float DistanceFromInside( const Canvas& canvas, uint32_t xCoord, uint32_t yCoord, uint32_t maxDistance );
+float DistanceFromOutside( const Canvas& canvas, uint32_t xCoord, uint32_t yCoord, uint32_t maxDistance );
+void ComputeDistanceFieldBruteForce( const Canvas& canvas, uint32_t texelsX, uint32_t texelsY, uint32_t maxDistance,
+	float* dest, uint32_t destPitch );
+
+// Writes the signed distance field of one glyph into a texelsX x texelsY block of dest
+void ComputeDistanceField( DistanceFieldScratch& scratch, const Canvas& canvas, uint32_t texelsX, uint32_t texelsY,
+	uint32_t maxDistance, float* dest, uint32_t destPitch );
@@ -6,10 +6,13 @@
 #include <thread>
 #include <vector>
 #include <algorithm>
+#include <chrono>
 #include <intrin.h>
 
 #include FT_FREETYPE_H
 
+#include "DistanceField.h"
+
 #define kMajorVersion	1
 #define kMinorVersion	0
 
@@ -45,6 +48,7 @@ uint32_t g_MapWidth = 0;
 uint32_t g_MapHeight = 0;
 volatile int32_t g_nextGlyphIdx = 0;
 volatile bool g_ReadyToPaint = false;
+bool g_benchmark = false;			// Time the distance transform and verify it against the brute force search
 
 void PrintAssertMessage( const char* file, uint32_t line, const char* cond, const char* msg, ...)
 {
@@ -118,30 +122,6 @@ void ShutdownFont(void)
 		FT_Done_FreeType( g_FreeTypeLib );
 }
 
-struct Canvas
-{
-	uint8_t* bitmap;	// Pointer to rendered glyph memory (from FT_Bitmap)
-	uint32_t pitch;		// Width in bytes of a row in the canvas
-	uint32_t width;		// Width in pixels of a row in the canvas
-	uint32_t rows;		// Number of rows in the canvas
-	uint32_t xOff;		// Amount to offset the x coordinate when reading
-	uint32_t yOff;		// Amount to offset the y coordinate when reading
-};
-
-// Access the high res glyph canvas
-inline bool ReadCanvasBit( const Canvas& canvas, uint32_t x, uint32_t y )
-{
-	// Notice that negative values have been cast to large positive values
-	x -= canvas.xOff;
-	y -= canvas.yOff;
-	if (x >= canvas.width || y >= canvas.rows)
-		return false;
-
-	uint32_t p = y * canvas.pitch + x / 8;
-	uint32_t k = x & 7;
-	return (canvas.bitmap[p] & (0x80 >> k)) ? true : false;
-}
-
 // Setup pixel reads from the glyph canvas
 inline Canvas LoadCanvas(FT_GlyphSlot glyph)
 {
@@ -155,86 +135,6 @@ inline Canvas LoadCanvas(FT_GlyphSlot glyph)
 	return ret;
 }
 
-float DistanceFromInside(const Canvas& canvas, uint32_t xCoord, uint32_t yCoord)
-{
-	const uint32_t radius = g_maxDistance * 32;
-	const uint32_t x0 =	xCoord * 32 + 15;
-	const uint32_t y0 =	yCoord * 32 + 15;
-
-	uint32_t left =		(uint32_t)max(0, (int32_t)(x0 - radius + 1));
-	uint32_t right =	x0 + radius - 1;
-	uint32_t top =		(uint32_t)max(0, (int32_t)(y0 - radius + 1));
-	uint32_t bottom =	y0 + radius - 1;
-
-	uint32_t bestDistSq = radius * radius;
-
-	for (uint32_t y1 = top; y1 <= bottom; y1 += 2)
-	{
-		int32_t distY = (int32_t)(y1 - y0);
-		uint32_t distYSq = (uint32_t)(distY * distY);
-
-		if (distYSq >= bestDistSq)
-		{
-			if (y1 > y0)
-				continue;
-			else
-				break;
-		}
-
-		for (uint32_t x1 = left; x1 <= right; x1 += 2)
-		{
-			int32_t distX = (int32_t)(x1 - x0);
-			uint32_t distXSq = (uint32_t)(distX * distX);
-
-			uint32_t distSq = (uint32_t)(distXSq + distYSq);
-			if (distSq < bestDistSq && !ReadCanvasBit(canvas, x1 >> 1, y1 >> 1))
-				bestDistSq = distSq;
-		}
-	}
-
-	return sqrt((float)bestDistSq) / (float)radius;
-}
-
-float DistanceFromOutside(const Canvas& canvas, uint32_t xCoord, uint32_t yCoord)
-{
-	const uint32_t radius = g_maxDistance * 32;
-	const uint32_t x0 =	xCoord * 32 + 15;
-	const uint32_t y0 =	yCoord * 32 + 15;
-
-	uint32_t left =		(uint32_t)max(0, (int32_t)(x0 - radius + 1));
-	uint32_t right =	x0 + radius - 1;
-	uint32_t top =		(uint32_t)max(0, (int32_t)(y0 - radius + 1));
-	uint32_t bottom =	y0 + radius - 1;
-
-	uint32_t bestDistSq = radius * radius;
-
-	for (uint32_t y1 = top; y1 <= bottom; y1 += 2)
-	{
-		int32_t distY = (int32_t)(y1 - y0);
-		uint32_t distYSq = (uint32_t)(distY * distY);
-
-		if (distYSq >= bestDistSq)
-		{
-			if (y1 > y0)
-				continue;
-			else
-				break;
-		}
-
-		for (uint32_t x1 = left; x1 <= right; x1 += 2)
-		{
-			int32_t distX = (int32_t)(x1 - x0);
-			uint32_t distXSq = (uint32_t)(distX * distX);
-
-			uint32_t distSq = (uint32_t)(distXSq + distYSq);
-			if (distSq < bestDistSq && ReadCanvasBit(canvas, x1 >> 1, y1 >> 1))
-				bestDistSq = distSq;
-		}
-	}
-
-	return sqrt((float)bestDistSq) / (float)radius;
-}
-
 // Get width and spacing of a given glyph to compute necessary space and layout in final texture.
 inline uint16_t GetGlyphMetrics( wchar_t c, GlyphInfo& info )
 {
@@ -283,8 +183,10 @@ uint32_t UnwrapUVs(uint32_t textureWidth)
 	return (y + rowSize + glyphBorder) / 16;
 }
 
-void PaintCharacters( float* distanceMap, uint32_t width, uint32_t height )
+void PaintCharacters( float* distanceMap, uint32_t width, uint32_t height, bool bruteForce = false )
 {
+	DistanceFieldScratch scratch;
+
 	int32_t i = -1;
 	while ((i = _InterlockedExchangeAdd((volatile long*)&g_nextGlyphIdx, 1)) < g_numGlyphs)
 	{
@@ -301,22 +203,15 @@ void PaintCharacters( float* distanceMap, uint32_t width, uint32_t height )
 		uint32_t startX = ch.u / 16 - g_borderSize;
 		uint32_t startY = ch.v / 16 - g_borderSize;
 
-		// Convert high-res bitmap to low-res distance map
-		for (uint32_t x = 0; x < charWidth + g_borderSize * 2; ++x)
+		if (bruteForce)
 		{
-			for (uint32_t y = 0; y < charHeight + g_borderSize * 2; ++y)
-			{
-				uint32_t left = x * 16 + 7;
-				uint32_t top = y * 16 + 7;
-
-				bool inside = ReadCanvasBit(canvas, left, top) & ReadCanvasBit(canvas, left + 1, top) &
-					ReadCanvasBit(canvas, left, top + 1) & ReadCanvasBit(canvas, left + 1, top + 1);
-
-				if (inside)
-					distanceMap[startX + x + (startY + y) * width] = +DistanceFromInside(canvas, x, y);
-				else
-					distanceMap[startX + x + (startY + y) * width] = -DistanceFromOutside(canvas, x, y);
-			}
+			ComputeDistanceFieldBruteForce(canvas, charWidth + g_borderSize * 2, charHeight + g_borderSize * 2, g_maxDistance,
+				distanceMap + startX + startY * width, width);
+		}
+		else
+		{
+			ComputeDistanceField(scratch, canvas, charWidth + g_borderSize * 2, charHeight + g_borderSize * 2, g_maxDistance,
+				distanceMap + startX + startY * width, width);
 		}
 	}
 }
@@ -335,6 +230,50 @@ void WorkerFunc( void )
 	ShutdownFont();
 }
 
+// Repaints every glyph with the brute force search, reports the speed of both methods and verifies that the
+// distance transform matches the reference to within half a step of the 8-bit output.
+void BenchmarkDistanceTransform( double transformSeconds, size_t numThreads )
+{
+	float* referenceMap = new float[g_MapWidth * g_MapHeight];
+	for (size_t x = g_MapWidth * g_MapHeight; x > 0; --x)
+		referenceMap[x - 1] = -1.0f;
+
+	g_nextGlyphIdx = 0;
+	__faststorefence();
+
+	auto start = chrono::high_resolution_clock::now();
+
+	std::vector<std::thread> Threads;
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		Threads.push_back(std::thread([referenceMap]()
+		{
+			InitializeFont();
+			PaintCharacters(referenceMap, g_MapWidth, g_MapHeight, true);
+			ShutdownFont();
+		}));
+	}
+
+	PaintCharacters(referenceMap, g_MapWidth, g_MapHeight, true);
+
+	for_each( Threads.begin(), Threads.end(), []( std::thread& T ) { T.join(); } );
+
+	double bruteForceSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	float maxError = 0.0f;
+	for (uint32_t i = 0; i < g_MapWidth * g_MapHeight; ++i)
+		maxError = max(maxError, fabs(referenceMap[i] - g_DistanceMap[i]));
+
+	delete[] referenceMap;
+
+	printf("Distance transform: %.1f glyphs/sec\n", g_numGlyphs / transformSeconds);
+	printf("Brute force search: %.1f glyphs/sec\n", g_numGlyphs / bruteForceSeconds);
+	printf("Max difference:     %g\n\n", maxError);
+
+	if (maxError > 0.5f / 127.0f)
+		throw exception("Distance transform does not match the brute force search");
+}
+
 struct BMP_Header
 {
 	// Bitmap file header
@@ -475,6 +414,8 @@ void CompileFont(const string& inputFile, uint32_t size, const string& outputNam
 	// Make sure all of the parameters are flushed to memory before we trigger the threads to paint.
     __faststorefence();
 
+	auto paintStart = chrono::high_resolution_clock::now();
+
 	g_ReadyToPaint = true;
 
 	// Also paint on the main thread
@@ -486,6 +427,12 @@ void CompileFont(const string& inputFile, uint32_t size, const string& outputNam
 		for_each( Threads.begin(), Threads.end(), []( std::thread& T ) { T.join(); } );
 	}
 
+	if (g_benchmark)
+	{
+		double paintSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - paintStart).count();
+		BenchmarkDistanceTransform(paintSeconds, Threads.size());
+	}
+
 	uint8_t* compressedMap8 = new uint8_t[g_MapWidth * g_MapHeight];
 
 	for (uint32_t i = 0; i < g_MapWidth * g_MapHeight; ++i)
@@ -565,7 +512,9 @@ void main( int argc, const char** argv )
 			if (argv[arg][0] != '-')
 				throw exception("Malformed option");
 
-			if (arg + 1 == argc)
+			if (strcmp("-benchmark", argv[arg]) == 0)
+				g_benchmark = true;
+			else if (arg + 1 == argc)
 				throw exception("Missing operand");
 			else if (strcmp("-size", argv[arg]) == 0)
 				size = atoi(argv[++arg]);
@@ -593,6 +542,7 @@ void main( int argc, const char** argv )
 			"-size <integer>\n\tThe font pixel resolution.\n"
 			"-radius <integer>\n\tThe search radius.\n\tDefaults to font size / 8.\n"
 			"-border_size <integer>\n\tExtra spacing around glyphs for various effects.\n\tDefaults to the search radius.\n"
+			"-benchmark\n\tReport glyphs/sec and verify the distance transform against a brute force search.\n"
 			"\n\nExample:  %s myfont.ttf -character_set Japanese.txt -output japanese\n\n", e.what(), argv[0], argv[0]);
 		return;
 	}
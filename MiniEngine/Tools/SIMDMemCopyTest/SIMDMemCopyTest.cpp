@@ -0,0 +1,250 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking and timing SIMDMemCopy() and SIMDMemFill() (Utility.cpp).
+//
+//   SIMDMemCopyTest selftest
+//       For every vector width the CPU supports, with both regular and streaming stores, copies and fills every
+//       length up to a few times the vector loop, at every source and destination alignment within a cache line.
+//       Each result is compared with the expected bytes, and the bytes on either side are checked for overwrites.
+//   SIMDMemCopyTest bench
+//       Copies sizes from 64B to 64MB with memcpy and with each variant, and reports GB/s.  Small sizes are
+//       copied repeatedly between the same buffers, so they measure copies that hit the cache.
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "pch.h"
+#include "../TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+    const char* kLevelNames[] = { "SSE2", "AVX2", "AVX-512" };
+
+    // Bytes on either side of the destination that must not be written
+    const size_t kGuardBytes = 64;
+    const uint8_t kGuardValue = 0xCD;
+
+    // Longer than four of the widest vectors plus both unaligned ends, so that every path through the loops runs
+    const size_t kMaxTestLength = 4 * 64 + 2 * 64 + 64;
+
+    bool GuardsIntact( const uint8_t* Dest, size_t Length )
+    {
+        for (size_t i = 0; i < kGuardBytes; ++i)
+        {
+            if (Dest[-1 - (ptrdiff_t)i] != kGuardValue || Dest[Length + i] != kGuardValue)
+                return false;
+        }
+        return true;
+    }
+
+    // Returns the number of mismatches
+    int CheckCopies( void )
+    {
+        std::vector<uint8_t> Source(kMaxTestLength + 128);
+        std::mt19937 Random(7);
+        for (size_t i = 0; i < Source.size(); ++i)
+            Source[i] = (uint8_t)Random();
+
+        std::vector<uint8_t> DestBuffer(kMaxTestLength + 128 + 2 * kGuardBytes, kGuardValue);
+        uint8_t* DestBase = (uint8_t*)(((size_t)DestBuffer.data() + kGuardBytes + 63) & ~(size_t)63);
+        const uint8_t* SourceBase = (const uint8_t*)(((size_t)Source.data() + 63) & ~(size_t)63);
+
+        int Failures = 0;
+        for (size_t DestAlign = 0; DestAlign < 64; ++DestAlign)
+        {
+            for (size_t SourceAlign = 0; SourceAlign < 64; ++SourceAlign)
+            {
+                uint8_t* Dest = DestBase + DestAlign;
+                const uint8_t* Src = SourceBase + SourceAlign;
+                for (size_t Length = 0; Length <= kMaxTestLength; ++Length)
+                {
+                    SIMDMemCopyBytes(Dest, Src, Length);
+                    if (memcmp(Dest, Src, Length) != 0 || !GuardsIntact(Dest, Length))
+                        ++Failures;
+                    memset(Dest, kGuardValue, Length);
+                }
+
+                // The quadword version
+                SIMDMemCopy(Dest, Src, 5);
+                if (memcmp(Dest, Src, 80) != 0 || !GuardsIntact(Dest, 80))
+                    ++Failures;
+                memset(Dest, kGuardValue, 80);
+            }
+        }
+        return Failures;
+    }
+
+    int CheckFills( void )
+    {
+        uint8_t Pattern[16];
+        for (uint8_t i = 0; i < 16; ++i)
+            Pattern[i] = (uint8_t)(0x10 + i * 7);
+        __m128 FillVector = _mm_loadu_ps((const float*)Pattern);
+
+        std::vector<uint8_t> DestBuffer(kMaxTestLength + 128 + 2 * kGuardBytes, kGuardValue);
+        uint8_t* DestBase = (uint8_t*)(((size_t)DestBuffer.data() + kGuardBytes + 63) & ~(size_t)63);
+
+        int Failures = 0;
+        for (size_t DestAlign = 0; DestAlign < 64; ++DestAlign)
+        {
+            uint8_t* Dest = DestBase + DestAlign;
+            for (size_t Length = 0; Length <= kMaxTestLength; ++Length)
+            {
+                SIMDMemFillBytes(Dest, FillVector, Length);
+                bool Matches = GuardsIntact(Dest, Length);
+                for (size_t i = 0; i < Length && Matches; ++i)
+                    Matches = Dest[i] == Pattern[i & 15];
+                if (!Matches)
+                    ++Failures;
+                memset(Dest, kGuardValue, Length);
+            }
+
+            SIMDMemFill(Dest, FillVector, 5);
+            bool Matches = GuardsIntact(Dest, 80);
+            for (size_t i = 0; i < 80 && Matches; ++i)
+                Matches = Dest[i] == Pattern[i & 15];
+            if (!Matches)
+                ++Failures;
+            memset(Dest, kGuardValue, 80);
+        }
+        return Failures;
+    }
+
+    int SelfTest( void )
+    {
+        const SIMDMemLevel Supported = GetSupportedSIMDMemLevel();
+        printf("supported: %s\n", kLevelNames[Supported]);
+        Check(GetSIMDMemLevel() == Supported, "startup picks the widest supported vectors");
+
+        char Message[128];
+        for (int Level = kSIMDMemSSE2; Level <= (int)Supported; ++Level)
+        {
+            // A threshold of zero streams everything
+            for (int Streaming = 0; Streaming < 2; ++Streaming)
+            {
+                Check(ConfigureSIMDMem((SIMDMemLevel)Level, Streaming ? 0 : kSIMDMemStreamingThreshold) == Level,
+                    "ConfigureSIMDMem() selects a supported level");
+
+                const char* Stores = Streaming ? "streaming" : "regular";
+                int Failures = CheckCopies();
+                sprintf_s(Message, sizeof(Message), "%s copies with %s stores (%d mismatches)", kLevelNames[Level], Stores, Failures);
+                Check(Failures == 0, Message);
+
+                Failures = CheckFills();
+                sprintf_s(Message, sizeof(Message), "%s fills with %s stores (%d mismatches)", kLevelNames[Level], Stores, Failures);
+                Check(Failures == 0, Message);
+            }
+        }
+
+        Check(ConfigureSIMDMem(kSIMDMemAVX512, kSIMDMemStreamingThreshold) == Supported, "levels are clamped to what is supported");
+
+        // Sizes either side of the threshold, through the public entry points
+        {
+            std::vector<uint8_t> Source(kSIMDMemStreamingThreshold * 2 + 256);
+            std::vector<uint8_t> Dest(Source.size() + 2 * kGuardBytes, kGuardValue);
+            for (size_t i = 0; i < Source.size(); ++i)
+                Source[i] = (uint8_t)(i * 13 + (i >> 8));
+
+            const size_t Lengths[] = { kSIMDMemStreamingThreshold - 1, kSIMDMemStreamingThreshold, kSIMDMemStreamingThreshold * 2 + 77 };
+            for (size_t Length : Lengths)
+            {
+                for (size_t Align = 0; Align < 64; Align += 9)
+                {
+                    uint8_t* Target = Dest.data() + kGuardBytes + Align;
+                    SIMDMemCopyBytes(Target, Source.data() + 64 - Align, Length);
+                    Check(memcmp(Target, Source.data() + 64 - Align, Length) == 0 && GuardsIntact(Target, Length),
+                        "copies either side of the streaming threshold");
+                    memset(Target, kGuardValue, Length);
+                }
+            }
+        }
+
+        return 0;
+    }
+
+    //
+    // Benchmark
+    //
+
+    // Returns GB/s.  Repeats the copy until about 1GB has been moved.
+    template <typename CopyFunction>
+    double TimeCopies( uint8_t* Dest, const uint8_t* Source, size_t Size, CopyFunction Copy )
+    {
+        size_t Repeats = std::max<size_t>(8, (1 << 30) / Size);
+
+        Copy(Dest, Source, Size);
+        auto Start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < Repeats; ++i)
+            Copy(Dest, Source, Size);
+        auto End = std::chrono::high_resolution_clock::now();
+
+        return (double)Size * Repeats / std::chrono::duration<double>(End - Start).count() * 1e-9;
+    }
+
+    int Bench( void )
+    {
+        const size_t kMaxSize = 64 << 20;
+        std::vector<uint8_t> Source(kMaxSize + 64, 1);
+        std::vector<uint8_t> Dest(kMaxSize + 64, 2);
+        uint8_t* DestBase = (uint8_t*)(((size_t)Dest.data() + 63) & ~(size_t)63);
+        const uint8_t* SourceBase = (const uint8_t*)(((size_t)Source.data() + 63) & ~(size_t)63);
+
+        const SIMDMemLevel Supported = GetSupportedSIMDMemLevel();
+        printf("GB/s, 64-byte aligned buffers.  'regular' and 'stream' force one kind of store; 'default' switches at %zuKB.\n",
+            kSIMDMemStreamingThreshold >> 10);
+        printf("%10s %9s", "size", "memcpy");
+        for (int Level = kSIMDMemSSE2; Level <= (int)Supported; ++Level)
+            printf("  %7s regular %7s stream", kLevelNames[Level], kLevelNames[Level]);
+        printf(" %9s\n", "default");
+
+        for (size_t Size = 64; Size <= kMaxSize; Size *= 2)
+        {
+            if (Size >= (1 << 20))
+                printf("%8zuMB", Size >> 20);
+            else if (Size >= (1 << 10))
+                printf("%8zuKB", Size >> 10);
+            else
+                printf("%9zuB", Size);
+
+            printf(" %9.2f", TimeCopies(DestBase, SourceBase, Size, []( uint8_t* d, const uint8_t* s, size_t n ) { memcpy(d, s, n); }));
+
+            for (int Level = kSIMDMemSSE2; Level <= (int)Supported; ++Level)
+            {
+                ConfigureSIMDMem((SIMDMemLevel)Level, ~(size_t)0);
+                printf(" %16.2f", TimeCopies(DestBase, SourceBase, Size, SIMDMemCopyBytes));
+                ConfigureSIMDMem((SIMDMemLevel)Level, 0);
+                printf(" %14.2f", TimeCopies(DestBase, SourceBase, Size, SIMDMemCopyBytes));
+            }
+
+            ConfigureSIMDMem(Supported, kSIMDMemStreamingThreshold);
+            printf(" %9.2f\n", TimeCopies(DestBase, SourceBase, Size, SIMDMemCopyBytes));
+        }
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "bench", "", 0, []( int, char*[] ) { return Bench(); } },
+    };
+    return TestHarness::RunCommand(argc, argv, "SIMDMemCopyTest", kCommands);
+}
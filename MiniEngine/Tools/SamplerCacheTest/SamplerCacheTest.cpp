@@ -0,0 +1,362 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking SamplerCache (SamplerCache.cpp) without a device.  Descriptors come from a test
+// provider that hands out made-up handles and records the description each one was created with, so a handle
+// returned for the wrong description, or a description created twice, is caught.
+//
+//   SamplerCacheTest selftest
+//       Checks deduplication, the sampler limit and the fallback sampler past it, and many threads asking for
+//       overlapping sets of samplers at once, both well under the limit and racing past it.
+//   SamplerCacheTest bench [max threads]
+//       Looks up a few dozen samplers that already exist on 1, 2, 4 ... threads and reports lookups per second
+//       for a single locked cache (what SamplerManager used before) and for the sharded one.  Any difference
+//       in contention only shows with at least as many cores as threads.
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "pch.h"
+#include "SamplerCache.h"
+#include "../TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+    // Handles are consecutive multiples of kHandleStride starting at kHandleBase, so a handle maps back to the
+    // slot where the provider recorded its description.
+    const size_t kHandleBase = 0x10000;
+    const size_t kHandleStride = 32;
+
+    class FakeSamplerProvider : public SamplerDescriptorProvider
+    {
+    public:
+        explicit FakeSamplerProvider( uint32_t Capacity ) : m_Descs(Capacity), m_NumCreated(0) {}
+
+        D3D12_CPU_DESCRIPTOR_HANDLE CreateSampler( const D3D12_SAMPLER_DESC& Desc ) override
+        {
+            uint32_t Index = m_NumCreated++;
+            Check(Index < m_Descs.size(), "the provider is not asked for more samplers than the cache allows");
+
+            D3D12_CPU_DESCRIPTOR_HANDLE Handle = { kHandleBase + Index * kHandleStride };
+            if (Index < m_Descs.size())
+                m_Descs[Index] = Desc;
+            return Handle;
+        }
+
+        uint32_t GetNumCreated( void ) const { return m_NumCreated; }
+
+        // The description a handle was created with, or null for a handle this provider never made
+        const D3D12_SAMPLER_DESC* Lookup( D3D12_CPU_DESCRIPTOR_HANDLE Handle ) const
+        {
+            if (Handle.ptr < kHandleBase || (Handle.ptr - kHandleBase) % kHandleStride != 0)
+                return nullptr;
+            size_t Index = (Handle.ptr - kHandleBase) / kHandleStride;
+            return Index < m_NumCreated && Index < m_Descs.size() ? &m_Descs[Index] : nullptr;
+        }
+
+    private:
+        std::vector<D3D12_SAMPLER_DESC> m_Descs;
+        std::atomic<uint32_t> m_NumCreated;
+    };
+
+    // A different, valid-looking description for every index
+    D3D12_SAMPLER_DESC MakeDesc( uint32_t Index )
+    {
+        static const D3D12_FILTER kFilters[] = { D3D12_FILTER_MIN_MAG_MIP_POINT, D3D12_FILTER_MIN_MAG_MIP_LINEAR,
+            D3D12_FILTER_ANISOTROPIC, D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT };
+
+        D3D12_SAMPLER_DESC Desc = {};
+        Desc.Filter = kFilters[Index % 4];
+        Desc.AddressU = (D3D12_TEXTURE_ADDRESS_MODE)(1 + (Index / 4) % 5);
+        Desc.AddressV = (D3D12_TEXTURE_ADDRESS_MODE)(1 + (Index / 20) % 5);
+        Desc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+        Desc.MipLODBias = 0.0f;
+        Desc.MaxAnisotropy = 16;
+        Desc.ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+        Desc.BorderColor[0] = Desc.BorderColor[1] = Desc.BorderColor[2] = Desc.BorderColor[3] = 1.0f;
+        Desc.MinLOD = 0.0f;
+        Desc.MaxLOD = (float)(Index / 100);    // Keeps the descriptions distinct past the first hundred
+        return Desc;
+    }
+
+    // What the cache hands out past its limit.  No MakeDesc() index up to a million makes it.
+    D3D12_SAMPLER_DESC FallbackDesc( void )
+    {
+        D3D12_SAMPLER_DESC Desc = MakeDesc(0);
+        Desc.MaxLOD = D3D12_FLOAT32_MAX;
+        return Desc;
+    }
+
+    bool SameDesc( const D3D12_SAMPLER_DESC* a, const D3D12_SAMPLER_DESC& b )
+    {
+        return a != nullptr && memcmp(a, &b, sizeof(b)) == 0;
+    }
+
+    void CheckDeduplication( void )
+    {
+        FakeSamplerProvider Provider(64);
+        SamplerCache Cache(Provider, FallbackDesc());
+        Check(Cache.GetMaxSamplers() == 2048, "the default limit is the size of a shader-visible sampler heap");
+
+        D3D12_SAMPLER_DESC Point = MakeDesc(0);
+        D3D12_SAMPLER_DESC Linear = MakeDesc(1);
+        D3D12_SAMPLER_DESC PointCopy = Point;
+
+        D3D12_CPU_DESCRIPTOR_HANDLE First = Cache.GetDescriptor(Point);
+        Check(First.ptr != 0 && SameDesc(Provider.Lookup(First), Point), "a new sampler is created from its description");
+        Check(Cache.GetDescriptor(Point).ptr == First.ptr, "the same description returns the same descriptor");
+        Check(Cache.GetDescriptor(PointCopy).ptr == First.ptr, "an identical copy returns the same descriptor");
+
+        D3D12_CPU_DESCRIPTOR_HANDLE Second = Cache.GetDescriptor(Linear);
+        Check(Second.ptr != First.ptr && SameDesc(Provider.Lookup(Second), Linear), "a different description gets its own descriptor");
+
+        // Fields that are easy to miss
+        D3D12_SAMPLER_DESC Border = Point;
+        Border.BorderColor[3] = 0.0f;
+        D3D12_SAMPLER_DESC Bias = Point;
+        Bias.MipLODBias = -0.5f;
+        Check(Cache.GetDescriptor(Border).ptr != First.ptr, "the border color is part of the key");
+        Check(Cache.GetDescriptor(Bias).ptr != First.ptr, "the LOD bias is part of the key");
+
+        Check(Provider.GetNumCreated() == 4 && Cache.GetNumSamplers() == 4, "each distinct sampler is created once");
+        Check(Cache.GetNumRejected() == 0, "nothing is rejected under the limit");
+    }
+
+    void CheckLimit( void )
+    {
+        // One slot is kept for the fallback
+        const uint32_t kMax = 64;
+        const uint32_t kAccepted = kMax - 1;
+        FakeSamplerProvider Provider(kMax);
+        SamplerCache Cache(Provider, FallbackDesc(), kMax);
+
+        std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> Handles;
+        for (uint32_t i = 0; i < 100; ++i)
+            Handles.push_back(Cache.GetDescriptor(MakeDesc(i)));
+
+        bool FirstAccepted = true;
+        bool RestFallBack = true;
+        for (uint32_t i = 0; i < 100; ++i)
+        {
+            if (i < kAccepted)
+                FirstAccepted = FirstAccepted && SameDesc(Provider.Lookup(Handles[i]), MakeDesc(i));
+            else
+                RestFallBack = RestFallBack && Handles[i].ptr == Handles[kAccepted].ptr;
+        }
+        Check(FirstAccepted, "samplers up to the limit are created");
+        Check(RestFallBack && SameDesc(Provider.Lookup(Handles[kAccepted]), FallbackDesc()), "samplers past the limit get the fallback sampler");
+        Check(Cache.GetNumSamplers() == kMax && Provider.GetNumCreated() == kMax, "no more than the limit are created");
+        Check(Cache.GetNumRejected() == 100 - kAccepted, "each description past the limit is rejected once");
+
+        // Asking again changes nothing, either way
+        Check(Cache.GetDescriptor(MakeDesc(3)).ptr == Handles[3].ptr, "an existing sampler is still found at the limit");
+        Check(Cache.GetDescriptor(MakeDesc(80)).ptr == Handles[kAccepted].ptr, "a rejected description keeps the fallback");
+        Check(Cache.GetDescriptor(FallbackDesc()).ptr == Handles[kAccepted].ptr, "the fallback's own description finds it");
+        Check(Cache.GetNumRejected() == 100 - kAccepted && Provider.GetNumCreated() == kMax, "repeated requests create nothing");
+
+        // The fallback can be asked for by name at the limit, before anything has fallen back to it
+        FakeSamplerProvider FullProvider(kMax);
+        SamplerCache Full(FullProvider, FallbackDesc(), kMax);
+        for (uint32_t i = 0; i < kAccepted; ++i)
+            Full.GetDescriptor(MakeDesc(i));
+        D3D12_CPU_DESCRIPTOR_HANDLE Fallback = Full.GetDescriptor(FallbackDesc());
+        Check(SameDesc(FullProvider.Lookup(Fallback), FallbackDesc()) && Full.GetNumRejected() == 0, "the fallback's slot is kept for it");
+        Check(Full.GetDescriptor(MakeDesc(kAccepted)).ptr == Fallback.ptr && FullProvider.GetNumCreated() == kMax,
+            "past the limit, the fallback created earlier is handed out");
+    }
+
+    // Every thread asks for descriptions drawn at random from the first NumDescs, and checks every handle it gets
+    // against the first handle any thread got for that description.  When NumDescs is past the limit, exactly
+    // the limit are created, the fallback included, and the rest consistently get the fallback.
+    void CheckThreads( uint32_t NumThreads, uint32_t NumDescs, uint32_t MaxSamplers, const char* Label )
+    {
+        FakeSamplerProvider Provider(MaxSamplers);
+        SamplerCache Cache(Provider, FallbackDesc(), MaxSamplers);
+        const D3D12_SAMPLER_DESC Fallback = FallbackDesc();
+
+        std::vector<D3D12_SAMPLER_DESC> Descs;
+        for (uint32_t i = 0; i < NumDescs; ++i)
+            Descs.push_back(MakeDesc(i));
+
+        const size_t kUnseen = ~(size_t)0;
+        std::vector<std::atomic<size_t>> FirstHandle(NumDescs);
+        for (std::atomic<size_t>& Handle : FirstHandle)
+            Handle = kUnseen;
+
+        std::atomic<uint32_t> Mismatches(0);
+        std::atomic<bool> Start(false);
+        std::vector<std::thread> Threads;
+        for (uint32_t t = 0; t < NumThreads; ++t)
+        {
+            Threads.emplace_back([&, t]()
+            {
+                std::mt19937 Random(t + 1);
+                while (!Start.load())
+                    std::this_thread::yield();
+
+                for (uint32_t i = 0; i < 20000; ++i)
+                {
+                    // Most requests go to a few popular samplers, like a real scene's materials
+                    uint32_t Index = (Random() & 3) != 0 ? Random() % 8 : Random() % NumDescs;
+                    size_t Handle = Cache.GetDescriptor(Descs[Index]).ptr;
+
+                    size_t Expected = kUnseen;
+                    if (!FirstHandle[Index].compare_exchange_strong(Expected, Handle) && Expected != Handle)
+                        ++Mismatches;
+                }
+            });
+        }
+        Start = true;
+        for (std::thread& Thread : Threads)
+            Thread.join();
+
+        char Message[160];
+        sprintf_s(Message, sizeof(Message), "%s: every thread got the same handle for a description (%u mismatches)", Label, Mismatches.load());
+        Check(Mismatches == 0, Message);
+
+        uint32_t Seen = 0, Accepted = 0, FellBack = 0, Wrong = 0;
+        for (uint32_t i = 0; i < NumDescs; ++i)
+        {
+            size_t Handle = FirstHandle[i];
+            if (Handle == kUnseen)
+                continue;
+            ++Seen;
+
+            D3D12_CPU_DESCRIPTOR_HANDLE CpuHandle = { Handle };
+            if (SameDesc(Provider.Lookup(CpuHandle), Descs[i]))
+                ++Accepted;
+            else if (SameDesc(Provider.Lookup(CpuHandle), Fallback))
+                ++FellBack;
+            else
+                ++Wrong;
+        }
+
+        sprintf_s(Message, sizeof(Message), "%s: handles match their descriptions or the fallback (%u wrong)", Label, Wrong);
+        Check(Wrong == 0, Message);
+        uint32_t Created = Accepted + (FellBack > 0 ? 1 : 0);
+        sprintf_s(Message, sizeof(Message), "%s: each sampler was created once (%u created, %u handed out)", Label,
+            Provider.GetNumCreated(), Created);
+        Check(Provider.GetNumCreated() == Created && Cache.GetNumSamplers() == Created, Message);
+        sprintf_s(Message, sizeof(Message), "%s: %u of %u descriptions accepted with a limit of %u", Label, Accepted, Seen, MaxSamplers);
+        Check(Accepted == std::min(Seen, MaxSamplers - 1) && Cache.GetNumRejected() == FellBack && FellBack == Seen - Accepted, Message);
+    }
+
+    int SelfTest( void )
+    {
+        CheckDeduplication();
+        CheckLimit();
+        CheckThreads(16, 1500, 2048, "under the limit");
+        CheckThreads(16, 3000, 2048, "past the limit");
+        CheckThreads(8, 40, 16, "small limit");
+
+        return 0;
+    }
+
+    //
+    // Benchmark
+    //
+
+    // SamplerManager before the cache was sharded:  one StateCache, one lock
+    class SingleLockCache
+    {
+    public:
+        explicit SingleLockCache( SamplerDescriptorProvider& Provider ) : m_Provider(Provider) {}
+
+        D3D12_CPU_DESCRIPTOR_HANDLE GetDescriptor( const D3D12_SAMPLER_DESC& Desc )
+        {
+            StateKey Key;
+            Key.Append(&Desc);
+            return m_Cache.GetOrCreate(Key, [&]() { return m_Provider.CreateSampler(Desc); });
+        }
+
+    private:
+        SamplerDescriptorProvider& m_Provider;
+        StateCache<D3D12_CPU_DESCRIPTOR_HANDLE> m_Cache;
+    };
+
+    const uint32_t kBenchSamplers = 48;
+    const uint32_t kLookupsPerThread = 500000;
+
+    // Returns lookups per second
+    template <typename CacheType>
+    double RunThreads( CacheType& Cache, uint32_t NumThreads )
+    {
+        std::vector<D3D12_SAMPLER_DESC> Descs;
+        for (uint32_t i = 0; i < kBenchSamplers; ++i)
+        {
+            Descs.push_back(MakeDesc(i));
+            Cache.GetDescriptor(Descs.back());
+        }
+
+        std::atomic<size_t> Sink(0);
+        std::vector<std::thread> Threads;
+        auto Begin = std::chrono::high_resolution_clock::now();
+        for (uint32_t t = 0; t < NumThreads; ++t)
+        {
+            Threads.emplace_back([&, t]()
+            {
+                size_t Sum = 0;
+                for (uint32_t i = 0; i < kLookupsPerThread; ++i)
+                    Sum += Cache.GetDescriptor(Descs[(i * 7 + t) % kBenchSamplers]).ptr;
+                Sink += Sum;
+            });
+        }
+        for (std::thread& Thread : Threads)
+            Thread.join();
+        auto End = std::chrono::high_resolution_clock::now();
+
+        return (double)NumThreads * kLookupsPerThread / std::chrono::duration<double>(End - Begin).count();
+    }
+
+    int Bench( uint32_t MaxThreads )
+    {
+        printf("%u samplers already created, %u lookups per thread, %u hardware threads\n", kBenchSamplers,
+            kLookupsPerThread, std::thread::hardware_concurrency());
+        printf("%8s %18s %18s %10s\n", "threads", "one lock (M/s)", "sharded (M/s)", "ratio");
+
+        for (uint32_t NumThreads = 1; NumThreads <= MaxThreads; NumThreads *= 2)
+        {
+            FakeSamplerProvider SingleProvider(kBenchSamplers);
+            SingleLockCache Single(SingleProvider);
+            double SingleRate = RunThreads(Single, NumThreads);
+
+            FakeSamplerProvider ShardedProvider(kBenchSamplers);
+            SamplerCache Sharded(ShardedProvider, FallbackDesc());
+            double ShardedRate = RunThreads(Sharded, NumThreads);
+
+            printf("%8u %18.2f %18.2f %9.2fx\n", NumThreads, SingleRate * 1e-6, ShardedRate * 1e-6, ShardedRate / SingleRate);
+        }
+
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "bench", "[max threads]", 1, []( int ArgCount, char* Args[] )
+        {
+            uint32_t MaxThreads = TestHarness::GetCountArgument(ArgCount, Args, 0, std::max(1u, std::thread::hardware_concurrency()));
+            return MaxThreads == 0 ? TestHarness::kBadArguments : Bench(MaxThreads);
+        } },
+    };
+    return TestHarness::RunCommand(argc, argv, "SamplerCacheTest", kCommands);
+}
@@ -0,0 +1,412 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking and timing the state hashing behind the root signature, PSO and sampler caches
+// (Hash.h and StateCache.h).  It needs no device.
+//
+//   StateHashTest selftest
+//       Checks HashBytes64() against XXH64 reference values, builds pairs of sampler descriptions that collide
+//       under the 32-bit HashState() the caches used to trust, and checks that StateCache keeps them apart even
+//       when every key is forced into one bucket.  Also races several threads over the same keys to check that
+//       each object is created exactly once.
+//   StateHashTest bench
+//       Reports hashing throughput for HashRange() (CRC32) and HashBytes64() at state-sized and larger inputs,
+//       and cache hits per second for a map keyed by the CRC alone and for StateCache.
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "pch.h"
+#include "StateCache.h"
+#include "../TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+    // Keys that all land in one bucket, so every hit is decided by comparing keys
+    struct ConstantHash
+    {
+        size_t operator()( const StateKey& ) const { return 0; }
+    };
+
+    // The 32-bit hash the caches used before
+    struct LegacyHash
+    {
+        size_t operator()( const StateKey& Key ) const
+        {
+            return Utility::HashRange(Key.GetWords(), Key.GetWords() + Key.GetNumWords(), 2166136261U);
+        }
+    };
+
+    struct ReferenceValue
+    {
+        size_t Length;
+        uint64_t Seed0;
+        uint64_t SeedFNV;
+    };
+
+    // XXH64 of the bytes (i * 31 + 7), from the reference implementation
+    const ReferenceValue kReferenceValues[] =
+    {
+        { 0, 0xEF46DB3751D8E999ull, 0xCA92D85635A166F5ull },
+        { 1, 0xA96C7F0CE858BBB7ull, 0x1767F9AD52DB2B25ull },
+        { 3, 0x56E6957632A487F9ull, 0x4D0B3589C7882248ull },
+        { 4, 0xC60D15B1E3FF8F04ull, 0x23576B8CEB98C373ull },
+        { 7, 0xAFBEFC3D6C6F9A8Eull, 0x05764A4EEB059FE9ull },
+        { 8, 0x3DA5C7AA269683E0ull, 0xD1C64726332E6F4Bull },
+        { 15, 0xAE2A37EB9357CAA7ull, 0xACE323150D65B5F1ull },
+        { 16, 0xA19AD429B02BC413ull, 0xF0585EA3ED90AB45ull },
+        { 31, 0x4A74F3A1A39AD4A1ull, 0x95D98CB16728ED57ull },
+        { 32, 0x8D57D6A4671CC43Dull, 0xF66C35BD0518F84Dull },
+        { 33, 0x62C9FD21ED857664ull, 0x05ADFFF4718F8402ull },
+        { 63, 0x5C320A0D2707057Full, 0xC82C8864DC4B4781ull },
+        { 64, 0x7BBABBC45729D17Eull, 0x3780862199E8E6CAull },
+        { 100, 0xEFA0AD2D3E70C151ull, 0x81903008D62A402Cull },
+        { 255, 0x2C3DB4BB567F731Eull, 0x72E0F26845C7ED82ull },
+        { 300, 0x8D2BA0CD7FECE76Cull, 0x5AB42498C8AE43FCull },
+    };
+
+    // Sampler descriptions laid out the way HashState() sees them:  8-byte aligned, so the CRC consumes them a
+    // pair of words at a time.
+    struct alignas(8) AlignedSampler
+    {
+        D3D12_SAMPLER_DESC Desc;
+    };
+
+    const size_t kSamplerWords = sizeof(D3D12_SAMPLER_DESC) / 4;
+
+    AlignedSampler MakeSampler( uint32_t Variant )
+    {
+        AlignedSampler Sampler;
+        memset(&Sampler, 0, sizeof(Sampler));
+        Sampler.Desc.Filter = D3D12_FILTER_ANISOTROPIC;
+        Sampler.Desc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+        Sampler.Desc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+        Sampler.Desc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+        Sampler.Desc.MaxAnisotropy = 1 + Variant % 16;
+        Sampler.Desc.ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+        Sampler.Desc.BorderColor[0] = (float)(Variant / 16);
+        Sampler.Desc.MaxLOD = D3D12_FLOAT32_MAX;
+        return Sampler;
+    }
+
+    // Returns a copy of 'original' with a different address mode in its first pair of words and its second pair
+    // adjusted so that HashState() gives the same value for both.  A CRC step folds the running value into the
+    // low word of the next input, so changing that word by the difference between the two running values puts
+    // them back in step.
+    AlignedSampler CraftLegacyCollision( const AlignedSampler& Original, uint32_t AddressMode )
+    {
+        AlignedSampler Forged = Original;
+        Forged.Desc.AddressU = (D3D12_TEXTURE_ADDRESS_MODE)AddressMode;
+
+        const uint32_t* OriginalWords = (const uint32_t*)&Original.Desc;
+        const uint32_t* ForgedWords = (const uint32_t*)&Forged.Desc;
+        uint32_t OriginalState = (uint32_t)Utility::HashRange(OriginalWords, OriginalWords + 2, 2166136261U);
+        uint32_t ForgedState = (uint32_t)Utility::HashRange(ForgedWords, ForgedWords + 2, 2166136261U);
+
+        Forged.Desc.AddressV = (D3D12_TEXTURE_ADDRESS_MODE)(Original.Desc.AddressV ^ OriginalState ^ ForgedState);
+        return Forged;
+    }
+
+    StateKey MakeKey( const AlignedSampler& Sampler )
+    {
+        StateKey Key;
+        Key.Append(&Sampler.Desc);
+        return Key;
+    }
+
+    int SelfTest( void )
+    {
+        char Message[160];
+
+        // Reference values
+        {
+            uint8_t Bytes[300 + 8];
+            for (uint32_t i = 0; i < 300; ++i)
+                Bytes[i] = (uint8_t)(i * 31 + 7);
+
+            for (const ReferenceValue& Reference : kReferenceValues)
+            {
+                sprintf_s(Message, sizeof(Message), "HashBytes64 of %zu bytes matches XXH64", Reference.Length);
+                Check(Utility::HashBytes64(Bytes, Reference.Length) == Reference.Seed0, Message);
+                Check(Utility::HashBytes64(Bytes, Reference.Length, 2166136261ull) == Reference.SeedFNV, Message);
+            }
+
+            // Unaligned input hashes the same
+            for (size_t Offset = 1; Offset < 8; ++Offset)
+            {
+                uint8_t Shifted[300 + 8];
+                memcpy(Shifted + Offset, Bytes, 300);
+                Check(Utility::HashBytes64(Shifted + Offset, 300) == kReferenceValues[15].Seed0, "HashBytes64 doesn't depend on alignment");
+            }
+        }
+
+        // Keys
+        {
+            StateKey a, b;
+            a.AppendString("abcd");
+            a.AppendString("");
+            b.AppendString("abc");
+            b.AppendString("d");
+            Check(a != b && a.GetHash() != b.GetHash(), "strings keep their boundaries");
+
+            StateKey c, d;
+            c.AppendString("TEXCOORD");
+            d.AppendString(std::string("TEXCOORD").c_str());
+            Check(c == d && c.GetHash() == d.GetHash(), "strings are keyed by their characters");
+
+            StateKey e;
+            e.AppendString("abc");
+            uint32_t One = 1;
+            e.AppendValue(One);
+            Check(e.GetNumWords() == 2, "a string and its terminator are padded to whole words");
+
+            uint64_t Before = e.GetHash();
+            e.AppendValue(One);
+            Check(e.GetHash() != Before, "appending changes the hash");
+        }
+
+        // Crafted collisions under the old hash
+        {
+            const uint32_t kPairs = 64;
+            std::vector<AlignedSampler> Originals, Forgeries;
+            for (uint32_t i = 0; i < kPairs; ++i)
+            {
+                Originals.push_back(MakeSampler(i));
+                Forgeries.push_back(CraftLegacyCollision(Originals.back(), D3D12_TEXTURE_ADDRESS_MODE_CLAMP + i % 4));
+            }
+
+            int LegacyCollisions = 0, NewCollisions = 0;
+            for (uint32_t i = 0; i < kPairs; ++i)
+            {
+                const uint32_t* Original = (const uint32_t*)&Originals[i].Desc;
+                const uint32_t* Forged = (const uint32_t*)&Forgeries[i].Desc;
+                if (Utility::HashState(&Originals[i].Desc) == Utility::HashState(&Forgeries[i].Desc))
+                    ++LegacyCollisions;
+                if (Utility::HashBytes64(Original, kSamplerWords * 4) == Utility::HashBytes64(Forged, kSamplerWords * 4))
+                    ++NewCollisions;
+            }
+            sprintf_s(Message, sizeof(Message), "every crafted pair collides under HashState() (%d of %u)", LegacyCollisions, kPairs);
+            Check(LegacyCollisions == (int)kPairs, Message);
+            Check(NewCollisions == 0, "no crafted pair collides under HashBytes64()");
+
+            // The old caches, keyed by the hash alone, would hand the forgery the original's object.
+            std::map<size_t, uint32_t> LegacyCache;
+            for (uint32_t i = 0; i < kPairs; ++i)
+                LegacyCache.emplace(Utility::HashState(&Originals[i].Desc), i);
+            uint32_t WrongObjects = 0;
+            for (uint32_t i = 0; i < kPairs; ++i)
+            {
+                auto Iter = LegacyCache.find(Utility::HashState(&Forgeries[i].Desc));
+                if (Iter != LegacyCache.end() && Iter->second == i)
+                    ++WrongObjects;
+            }
+            Check(WrongObjects == kPairs, "a cache keyed by HashState() alone confuses every crafted pair");
+
+            // StateCache keeps them apart, whether the bucket comes from the old hash or from no hash at all.
+            StateCache<uint32_t, LegacyHash> LegacyBuckets;
+            StateCache<uint32_t, ConstantHash> OneBucket;
+            for (uint32_t i = 0; i < kPairs; ++i)
+            {
+                LegacyBuckets.GetOrCreate(MakeKey(Originals[i]), [i]() { return i; });
+                LegacyBuckets.GetOrCreate(MakeKey(Forgeries[i]), [i]() { return i + 1000; });
+                OneBucket.GetOrCreate(MakeKey(Originals[i]), [i]() { return i; });
+                OneBucket.GetOrCreate(MakeKey(Forgeries[i]), [i]() { return i + 1000; });
+            }
+            Check(LegacyBuckets.GetSize() == 2 * kPairs && OneBucket.GetSize() == 2 * kPairs, "every crafted description gets its own entry");
+
+            uint32_t RightObjects = 0;
+            for (uint32_t i = 0; i < kPairs; ++i)
+            {
+                bool Created = true;
+                auto Fail = []() { return ~0u; };
+                if (LegacyBuckets.GetOrCreate(MakeKey(Originals[i]), Fail, &Created) == i && !Created &&
+                    LegacyBuckets.GetOrCreate(MakeKey(Forgeries[i]), Fail, &Created) == i + 1000 && !Created &&
+                    OneBucket.GetOrCreate(MakeKey(Originals[i]), Fail, &Created) == i && !Created &&
+                    OneBucket.GetOrCreate(MakeKey(Forgeries[i]), Fail, &Created) == i + 1000 && !Created)
+                {
+                    ++RightObjects;
+                }
+            }
+            Check(RightObjects == kPairs, "lookups of crafted descriptions return their own objects");
+
+            OneBucket.Clear();
+            Check(OneBucket.GetSize() == 0, "Clear() empties the cache");
+        }
+
+        // Several threads asking for the same keys at once
+        {
+            const uint32_t kKeys = 256;
+            const uint32_t kThreads = 8;
+            std::vector<std::atomic<uint32_t>> Creations(kKeys);
+            for (auto& Count : Creations)
+                Count = 0;
+
+            StateCache<uint32_t> Cache;
+            std::atomic<uint32_t> WrongObjects(0);
+            std::vector<std::thread> Threads;
+            for (uint32_t t = 0; t < kThreads; ++t)
+            {
+                Threads.emplace_back([&, t]()
+                {
+                    std::vector<uint32_t> Order(kKeys);
+                    for (uint32_t i = 0; i < kKeys; ++i)
+                        Order[i] = i;
+                    std::shuffle(Order.begin(), Order.end(), std::mt19937(t));
+
+                    for (uint32_t i : Order)
+                    {
+                        uint32_t Object = Cache.GetOrCreate(MakeKey(MakeSampler(i)), [&Creations, i]()
+                        {
+                            Creations[i]++;
+                            std::this_thread::yield();
+                            return i * 3 + 1;
+                        });
+                        if (Object != i * 3 + 1)
+                            WrongObjects++;
+                    }
+                });
+            }
+            for (auto& Thread : Threads)
+                Thread.join();
+
+            uint32_t CreatedOnce = 0;
+            for (auto& Count : Creations)
+                CreatedOnce += Count == 1 ? 1 : 0;
+            Check(CreatedOnce == kKeys, "each key is created exactly once by racing threads");
+            Check(WrongObjects == 0, "racing threads all get the created object");
+            Check(Cache.GetSize() == kKeys, "racing threads leave one entry per key");
+        }
+
+        return 0;
+    }
+
+    //
+    // Benchmark
+    //
+
+    template <typename Function>
+    double TimeSeconds( Function Func )
+    {
+        auto Start = std::chrono::high_resolution_clock::now();
+        Func();
+        auto End = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double>(End - Start).count();
+    }
+
+    int Bench( void )
+    {
+        // Sampler description, static samplers of a root signature, a graphics PSO description with a typical
+        // input layout, and bulk data
+        const size_t Sizes[] = { 52, 128, 768, 4096, 1 << 20 };
+        std::vector<uint32_t> Data((1 << 20) / 4 + 2);
+        std::mt19937 Random(3);
+        for (uint32_t& Word : Data)
+            Word = Random();
+
+        printf("%10s %14s %14s %14s %14s\n", "bytes", "CRC32 (ns)", "CRC32 (GB/s)", "64-bit (ns)", "64-bit (GB/s)");
+        for (size_t Size : Sizes)
+        {
+            size_t Repeats = std::max<size_t>(16, (256 << 20) / Size);
+            const uint32_t* Begin = Data.data();
+            const uint32_t* End = Begin + Size / 4;
+
+            volatile size_t Sink = 0;
+            double LegacySeconds = TimeSeconds([&]()
+            {
+                size_t Hash = 0;
+                for (size_t i = 0; i < Repeats; ++i)
+                    Hash += Utility::HashRange(Begin, End, 2166136261U + i);
+                Sink = Hash;
+            });
+            double NewSeconds = TimeSeconds([&]()
+            {
+                uint64_t Hash = 0;
+                for (size_t i = 0; i < Repeats; ++i)
+                    Hash += Utility::HashBytes64(Begin, Size, i);
+                Sink = (size_t)Hash;
+            });
+
+            printf("%10zu %14.1f %14.2f %14.1f %14.2f\n", Size, LegacySeconds / Repeats * 1e9, Size * Repeats / LegacySeconds * 1e-9,
+                NewSeconds / Repeats * 1e9, Size * Repeats / NewSeconds * 1e-9);
+        }
+
+        // Cache hits at the scale of a few thousand PSOs:  building the key, hashing it, finding it, and for
+        // StateCache, comparing it.
+        {
+            const uint32_t kStates = 4096;
+            const size_t kStateWords = 768 / 4;
+            std::vector<std::vector<uint32_t>> States(kStates, std::vector<uint32_t>(kStateWords));
+            for (auto& State : States)
+                for (uint32_t& Word : State)
+                    Word = Random() & 0xFF;
+
+            std::map<size_t, uint32_t> LegacyCache;
+            StateCache<uint32_t> Cache;
+            for (uint32_t i = 0; i < kStates; ++i)
+            {
+                LegacyCache.emplace(Utility::HashRange(States[i].data(), States[i].data() + kStateWords, 2166136261U), i);
+                StateKey Key;
+                Key.Append(States[i].data(), kStateWords);
+                Cache.GetOrCreate(Key, [i]() { return i; });
+            }
+
+            const uint32_t kLookups = 1 << 20;
+            volatile uint32_t Sink = 0;
+            double LegacySeconds = TimeSeconds([&]()
+            {
+                uint32_t Total = 0;
+                for (uint32_t i = 0; i < kLookups; ++i)
+                {
+                    const std::vector<uint32_t>& State = States[i % kStates];
+                    Total += LegacyCache.find(Utility::HashRange(State.data(), State.data() + kStateWords, 2166136261U))->second;
+                }
+                Sink = Total;
+            });
+            double NewSeconds = TimeSeconds([&]()
+            {
+                uint32_t Total = 0;
+                for (uint32_t i = 0; i < kLookups; ++i)
+                {
+                    const std::vector<uint32_t>& State = States[i % kStates];
+                    StateKey Key;
+                    Key.Append(State.data(), kStateWords);
+                    Total += Cache.GetOrCreate(Key, []() { return 0u; });
+                }
+                Sink = Total;
+            });
+
+            printf("\n%u cached states of %zu bytes\n", kStates, kStateWords * 4);
+            printf("%24s %10.2f M hits/s\n", "map keyed by CRC32", kLookups / LegacySeconds * 1e-6);
+            printf("%24s %10.2f M hits/s\n", "StateCache", kLookups / NewSeconds * 1e-6);
+        }
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "bench", "", 0, []( int, char*[] ) { return Bench(); } },
+    };
+    return TestHarness::RunCommand(argc, argv, "StateHashTest", kCommands);
+}
@@ -0,0 +1,694 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking and timing the TGA decoder (TGALoader.cpp).
+//
+//   TGALoaderTest selftest
+//       Decodes a handful of tiny files written out byte by byte from the format specification, then a corpus
+//       generated here:  every image type and pixel depth, with and without RLE, from all four corners, with
+//       run-length packets that stop at the end of each row and packets that run on, at widths either side of
+//       the vector loops.  Each is decoded with SSSE3 and without, into rows with padding, and compared with
+//       the pixels it was written from.  Truncated and malformed files must be rejected without reading past
+//       the end, and uncompressed 24 and 32-bit files must still decode as the old loader did, apart from the
+//       orientation it used to ignore.
+//   TGALoaderTest bench
+//       Decodes 2048x2048 images of each kind and reports MB/s of RGBA written.  For 24 and 32-bit images it
+//       also times the old loader, which converted one pixel at a time into a staging array that was then
+//       copied into the upload buffer.
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "pch.h"
+#include "TGALoader.h"
+#include "../TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+    // Decodes into rows with a few bytes of padding that must be left alone
+    const size_t kPadding = 12;
+    const uint8_t kPadValue = 0xCD;
+
+    bool Decode( const std::vector<uint8_t>& File, std::vector<uint32_t>& Pixels, bool* PaddingIntact = nullptr )
+    {
+        TGAImageInfo Info;
+        if (!ReadTGAHeader(File.data(), File.size(), Info))
+            return false;
+
+        size_t Pitch = Info.Width * 4 + kPadding;
+        std::vector<uint8_t> Dest(Pitch * Info.Height, kPadValue);
+        if (!DecodeTGA(File.data(), File.size(), Info, Dest.data(), Pitch))
+            return false;
+
+        bool Intact = true;
+        Pixels.resize((size_t)Info.Width * Info.Height);
+        for (uint32_t y = 0; y < Info.Height; ++y)
+        {
+            memcpy(&Pixels[(size_t)y * Info.Width], &Dest[y * Pitch], Info.Width * 4);
+            for (size_t i = 0; i < kPadding; ++i)
+                Intact = Intact && Dest[y * Pitch + Info.Width * 4 + i] == kPadValue;
+        }
+        if (PaddingIntact != nullptr)
+            *PaddingIntact = Intact;
+        return true;
+    }
+
+    uint32_t RGBA( uint32_t r, uint32_t g, uint32_t b, uint32_t a )
+    {
+        return r | g << 8 | b << 16 | a << 24;
+    }
+
+    //
+    // Files written by hand from the specification
+    //
+
+    struct HandWrittenFile
+    {
+        const char* Name;
+        std::vector<uint8_t> Bytes;
+        std::vector<uint32_t> Expected;     // Top row first
+    };
+
+    // Appends a TGA 2.0 extension area that gives only the attributes type, and the footer that points to it
+    std::vector<uint8_t> WithExtensionArea( std::vector<uint8_t> Bytes, uint8_t AttributesType )
+    {
+        const size_t ExtensionOffset = Bytes.size();
+        Bytes.resize(ExtensionOffset + 495, 0);
+        Bytes[ExtensionOffset] = 495 & 0xFF;
+        Bytes[ExtensionOffset + 1] = 495 >> 8;
+        Bytes[ExtensionOffset + 494] = AttributesType;
+
+        for (int i = 0; i < 4; ++i)
+            Bytes.push_back((uint8_t)(ExtensionOffset >> i * 8));
+        Bytes.insert(Bytes.end(), 4, 0);
+        const char Signature[] = "TRUEVISION-XFILE.";
+        Bytes.insert(Bytes.end(), Signature, Signature + sizeof(Signature));
+        return Bytes;
+    }
+
+    std::vector<HandWrittenFile> HandWrittenCorpus( void )
+    {
+        std::vector<HandWrittenFile> Corpus;
+
+        // 2x2, 24-bit, bottom-left origin:  blue, green on the bottom row; red, white on top
+        Corpus.push_back({ "type 2, 24-bit, bottom-left", {
+            0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 2, 0, 24, 0x00,
+            0xFF, 0, 0,   0, 0xFF, 0,
+            0, 0, 0xFF,   0xFF, 0xFF, 0xFF },
+            { RGBA(255, 0, 0, 255), RGBA(255, 255, 255, 255), RGBA(0, 0, 255, 255), RGBA(0, 255, 0, 255) } });
+
+        // 3x1, 32-bit with 8 alpha bits, top-left origin, with a 2-byte image ID to skip
+        Corpus.push_back({ "type 2, 32-bit, top-left, image ID", {
+            2, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 1, 0, 32, 0x28,
+            'I', 'D',
+            10, 20, 30, 40,   50, 60, 70, 80,   1, 2, 3, 0 },
+            { RGBA(30, 20, 10, 40), RGBA(70, 60, 50, 80), RGBA(3, 2, 1, 0) } });
+
+        // The same pixels without alpha bits.  Many writers leave them out, so the fourth byte is still alpha.
+        const std::vector<uint8_t> NoAlphaBits = {
+            0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 1, 0, 32, 0x20,
+            10, 20, 30, 40,   50, 60, 70, 80,   1, 2, 3, 0 };
+        Corpus.push_back({ "type 2, 32-bit, no alpha bits", NoAlphaBits,
+            { RGBA(30, 20, 10, 40), RGBA(70, 60, 50, 80), RGBA(3, 2, 1, 0) } });
+
+        // A TGA 2.0 extension area decides.  Attributes types 0-2 say there is no alpha, and 3 and 4 that there is.
+        for (uint8_t AttributesType = 0; AttributesType <= 4; ++AttributesType)
+        {
+            static const char* const kNames[] =
+            {
+                "type 2, 32-bit, attributes type 0 (no alpha)",
+                "type 2, 32-bit, attributes type 1 (undefined, ignore)",
+                "type 2, 32-bit, attributes type 2 (undefined, retain)",
+                "type 2, 32-bit, attributes type 3 (alpha)",
+                "type 2, 32-bit, attributes type 4 (premultiplied alpha)",
+            };
+            uint32_t a = AttributesType >= 3 ? 0 : 0xFF;
+            Corpus.push_back({ kNames[AttributesType], WithExtensionArea(NoAlphaBits, AttributesType),
+                { RGBA(30, 20, 10, a | 40), RGBA(70, 60, 50, a | 80), RGBA(3, 2, 1, a) } });
+        }
+
+        // An attributes type of 3 gives a 16-bit image without attribute bits its alpha bit
+        Corpus.push_back({ "type 2, 16-bit, attributes type 3", WithExtensionArea({
+            0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 1, 0, 16, 0x20,
+            0x00, 0xFC,   0x1F, 0x00 }, 3),
+            { RGBA(255, 0, 0, 255), RGBA(0, 0, 255, 0) } });
+
+        // 4x2 RLE, 24-bit, top-left.  A run of three reds, then a raw packet that continues onto the second row
+        // (yellow, cyan), then a run of three blacks.
+        Corpus.push_back({ "type 10, 24-bit, packets across rows", {
+            0, 0, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 2, 0, 24, 0x20,
+            0x82, 0, 0, 0xFF,
+            0x01, 0, 0xFF, 0xFF,   0xFF, 0xFF, 0,
+            0x82, 0, 0, 0 },
+            { RGBA(255, 0, 0, 255), RGBA(255, 0, 0, 255), RGBA(255, 0, 0, 255), RGBA(255, 255, 0, 255),
+              RGBA(0, 255, 255, 255), RGBA(0, 0, 0, 255), RGBA(0, 0, 0, 255), RGBA(0, 0, 0, 255) } });
+
+        // 2x1, 16-bit A1R5G5B5 with one alpha bit:  opaque pure red, transparent pure blue
+        Corpus.push_back({ "type 2, 16-bit", {
+            0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 1, 0, 16, 0x21,
+            0x00, 0xFC,   0x1F, 0x00 },
+            { RGBA(255, 0, 0, 255), RGBA(0, 0, 255, 0) } });
+
+        // 3x1 grayscale, bottom-right origin, so the row is stored right to left
+        Corpus.push_back({ "type 3, 8-bit, right to left", {
+            0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 1, 0, 8, 0x10,
+            0, 128, 255 },
+            { RGBA(255, 255, 255, 255), RGBA(128, 128, 128, 255), RGBA(0, 0, 0, 255) } });
+
+        // 2x2 color mapped:  a 24-bit palette of two entries starting at index 3
+        Corpus.push_back({ "type 1, 8-bit indices, 24-bit palette", {
+            0, 1, 1, 3, 0, 2, 0, 24, 0, 0, 0, 0, 2, 0, 2, 0, 8, 0x20,
+            0, 0, 0xFF,   0xFF, 0, 0,
+            3, 4,   4, 3 },
+            { RGBA(255, 0, 0, 255), RGBA(0, 0, 255, 255), RGBA(0, 0, 255, 255), RGBA(255, 0, 0, 255) } });
+
+        // 5x1 RLE grayscale with alpha:  a run of two, then a raw packet of three
+        Corpus.push_back({ "type 11, 16-bit gray and alpha", {
+            0, 0, 11, 0, 0, 0, 0, 0, 0, 0, 0, 0, 5, 0, 1, 0, 16, 0x28,
+            0x81, 100, 200,
+            0x02, 1, 2,   3, 4,   5, 6 },
+            { RGBA(100, 100, 100, 200), RGBA(100, 100, 100, 200), RGBA(1, 1, 1, 2), RGBA(3, 3, 3, 4), RGBA(5, 5, 5, 6) } });
+
+        return Corpus;
+    }
+
+    //
+    // Generated corpus
+    //
+
+    struct Layout
+    {
+        uint8_t ImageType;
+        uint8_t Depth;
+        uint8_t PaletteDepth;
+        uint8_t AlphaBits;
+        const char* Name;
+    };
+
+    const Layout kLayouts[] =
+    {
+        { 2, 15, 0, 0, "true color 15" },
+        { 2, 16, 0, 1, "true color 16" },
+        { 2, 16, 0, 0, "true color 16 no alpha" },
+        { 2, 24, 0, 0, "true color 24" },
+        { 2, 32, 0, 8, "true color 32" },
+        { 2, 32, 0, 0, "true color 32 no alpha bits" },
+        { 3, 8, 0, 0, "gray 8" },
+        { 3, 16, 0, 8, "gray 16" },
+        { 1, 8, 15, 0, "index 8, palette 15" },
+        { 1, 8, 16, 1, "index 8, palette 16" },
+        { 1, 8, 24, 0, "index 8, palette 24" },
+        { 1, 8, 32, 8, "index 8, palette 32" },
+        { 1, 16, 24, 0, "index 16, palette 24" },
+    };
+
+    uint32_t Expand5( uint32_t Bits )
+    {
+        return Bits << 3 | Bits >> 2;
+    }
+
+    // Appends one stored pixel or palette entry, and returns what it should decode to
+    uint32_t WriteColor( std::vector<uint8_t>& Out, uint32_t Color, uint32_t Depth, uint32_t AlphaBits, bool Gray )
+    {
+        uint32_t r = Color & 0xFF, g = Color >> 8 & 0xFF, b = Color >> 16 & 0xFF, a = Color >> 24;
+        if (Gray)
+        {
+            Out.push_back((uint8_t)r);
+            if (Depth == 16)
+                Out.push_back((uint8_t)a);
+            return RGBA(r, r, r, Depth == 16 && AlphaBits != 0 ? a : 255);
+        }
+
+        switch (Depth)
+        {
+        case 15:
+        case 16:
+        {
+            // A 15-bit pixel's top bit is garbage, which must be ignored
+            uint32_t AlphaBit = a >> 7;
+            uint32_t Packed = (r >> 3) << 10 | (g >> 3) << 5 | (b >> 3) | AlphaBit << 15;
+            Out.push_back((uint8_t)Packed);
+            Out.push_back((uint8_t)(Packed >> 8));
+            bool HasAlpha = Depth == 16 && AlphaBits != 0;
+            return RGBA(Expand5(r >> 3), Expand5(g >> 3), Expand5(b >> 3), HasAlpha ? (AlphaBit ? 255 : 0) : 255);
+        }
+        case 24:
+            Out.push_back((uint8_t)b);
+            Out.push_back((uint8_t)g);
+            Out.push_back((uint8_t)r);
+            return RGBA(r, g, b, 255);
+        default:
+            Out.push_back((uint8_t)b);
+            Out.push_back((uint8_t)g);
+            Out.push_back((uint8_t)r);
+            Out.push_back((uint8_t)a);
+            return RGBA(r, g, b, a);           // With or without attribute bits
+        }
+    }
+
+    struct Image
+    {
+        uint32_t Width;
+        uint32_t Height;
+        std::vector<uint32_t> Palette;
+        std::vector<uint32_t> Indices;      // Top row first
+    };
+
+    // Runs of repeated colors of random length, so that RLE has something to find
+    Image MakeImage( uint32_t Width, uint32_t Height, uint32_t NumColors, std::mt19937& Random )
+    {
+        Image Img;
+        Img.Width = Width;
+        Img.Height = Height;
+        for (uint32_t i = 0; i < NumColors; ++i)
+            Img.Palette.push_back((uint32_t)Random());
+
+        uint32_t Index = 0;
+        for (uint32_t i = 0; i < Width * Height; ++i)
+        {
+            if (Random() % 3 == 0)
+                Index = Random() % NumColors;
+            Img.Indices.push_back(Index);
+        }
+        return Img;
+    }
+
+    struct Encoding
+    {
+        bool Rle;
+        bool TopToBottom;
+        bool RightToLeft;
+        bool PacketsCrossRows;
+    };
+
+    // Returns the file, and the pixels it should decode to in Expected
+    std::vector<uint8_t> Encode( const Image& Img, const Layout& Format, const Encoding& Options, std::vector<uint32_t>& Expected )
+    {
+        const bool Indexed = Format.ImageType == 1;
+        const bool Gray = Format.ImageType == 3;
+        const uint16_t FirstEntry = 5;
+
+        std::vector<uint8_t> File(18, 0);
+        File[0] = 3;                    // A short image ID to skip
+        File[1] = Indexed ? 1 : 0;
+        File[2] = (uint8_t)(Format.ImageType + (Options.Rle ? 8 : 0));
+        File[12] = (uint8_t)Img.Width;
+        File[13] = (uint8_t)(Img.Width >> 8);
+        File[14] = (uint8_t)Img.Height;
+        File[15] = (uint8_t)(Img.Height >> 8);
+        File[16] = Format.Depth;
+        File[17] = (uint8_t)(Format.AlphaBits | (Options.RightToLeft ? 0x10 : 0) | (Options.TopToBottom ? 0x20 : 0));
+        File.insert(File.end(), { 'T', 'G', 'A' });
+
+        // Stored pixels, and what each palette color decodes to
+        std::vector<uint32_t> DecodedPalette;
+        std::vector<uint8_t> Stored;
+        const uint32_t BytesPerPixel = (Format.Depth + 7) / 8;
+        if (Indexed)
+        {
+            File[3] = (uint8_t)FirstEntry;
+            File[5] = (uint8_t)Img.Palette.size();
+            File[6] = (uint8_t)(Img.Palette.size() >> 8);
+            File[7] = Format.PaletteDepth;
+            for (uint32_t Color : Img.Palette)
+                DecodedPalette.push_back(WriteColor(File, Color, Format.PaletteDepth, Format.AlphaBits, false));
+        }
+        else
+        {
+            std::vector<uint8_t> Scratch;
+            for (uint32_t Color : Img.Palette)
+                DecodedPalette.push_back(WriteColor(Scratch, Color, Format.Depth, Format.AlphaBits, Gray));
+        }
+
+        for (uint32_t FileRow = 0; FileRow < Img.Height; ++FileRow)
+        {
+            uint32_t y = Options.TopToBottom ? FileRow : Img.Height - 1 - FileRow;
+            for (uint32_t FileColumn = 0; FileColumn < Img.Width; ++FileColumn)
+            {
+                uint32_t x = Options.RightToLeft ? Img.Width - 1 - FileColumn : FileColumn;
+                uint32_t Index = Img.Indices[y * Img.Width + x];
+                if (Indexed)
+                {
+                    uint32_t StoredIndex = Index + FirstEntry;
+                    Stored.push_back((uint8_t)StoredIndex);
+                    if (Format.Depth == 16)
+                        Stored.push_back((uint8_t)(StoredIndex >> 8));
+                }
+                else
+                    WriteColor(Stored, Img.Palette[Index], Format.Depth, Format.AlphaBits, Gray);
+            }
+        }
+
+        Expected.clear();
+        for (uint32_t Index : Img.Indices)
+            Expected.push_back(DecodedPalette[Index]);
+
+        if (!Options.Rle)
+        {
+            File.insert(File.end(), Stored.begin(), Stored.end());
+            return File;
+        }
+
+        // Greedy packets:  a run wherever two neighbors match, raw pixels otherwise
+        const size_t NumPixels = Stored.size() / BytesPerPixel;
+        const size_t SpanLength = Options.PacketsCrossRows ? NumPixels : Img.Width;
+        auto Same = [&]( size_t a, size_t b ) { return memcmp(&Stored[a * BytesPerPixel], &Stored[b * BytesPerPixel], BytesPerPixel) == 0; };
+        for (size_t SpanStart = 0; SpanStart < NumPixels; SpanStart += SpanLength)
+        {
+            const size_t SpanEnd = SpanStart + SpanLength;
+            size_t i = SpanStart;
+            while (i < SpanEnd)
+            {
+                size_t Count = 1;
+                if (i + 1 < SpanEnd && Same(i, i + 1))
+                {
+                    while (Count < 128 && i + Count < SpanEnd && Same(i, i + Count))
+                        ++Count;
+                    File.push_back((uint8_t)(0x80 | (Count - 1)));
+                    File.insert(File.end(), &Stored[i * BytesPerPixel], &Stored[i * BytesPerPixel] + BytesPerPixel);
+                }
+                else
+                {
+                    while (Count < 128 && i + Count < SpanEnd && !(i + Count + 1 < SpanEnd && Same(i + Count, i + Count + 1)))
+                        ++Count;
+                    File.push_back((uint8_t)(Count - 1));
+                    File.insert(File.end(), &Stored[i * BytesPerPixel], &Stored[(i + Count) * BytesPerPixel]);
+                }
+                i += Count;
+            }
+        }
+        return File;
+    }
+
+    // The loader this decoder replaced, for comparison.  It ignored the image type and the origin.
+    std::vector<uint32_t> OldLoader( const uint8_t* FilePtr, uint32_t& Width, uint32_t& Height )
+    {
+        FilePtr += 12;
+        uint16_t ImageWidth = (uint16_t)(FilePtr[0] | FilePtr[1] << 8);
+        uint16_t ImageHeight = (uint16_t)(FilePtr[2] | FilePtr[3] << 8);
+        uint8_t BitCount = FilePtr[4];
+        FilePtr += 6;
+
+        std::vector<uint32_t> FormattedData((size_t)ImageWidth * ImageHeight);
+        uint32_t* Iter = FormattedData.data();
+        uint32_t NumBytes = ImageWidth * ImageHeight * (BitCount / 8);
+        if (BitCount == 24)
+        {
+            for (uint32_t ByteIdx = 0; ByteIdx < NumBytes; ByteIdx += 3, FilePtr += 3)
+                *Iter++ = 0xff000000 | FilePtr[0] << 16 | FilePtr[1] << 8 | FilePtr[2];
+        }
+        else if (BitCount == 32)
+        {
+            for (uint32_t ByteIdx = 0; ByteIdx < NumBytes; ByteIdx += 4, FilePtr += 4)
+                *Iter++ = (uint32_t)FilePtr[3] << 24 | FilePtr[0] << 16 | FilePtr[1] << 8 | FilePtr[2];
+        }
+
+        Width = ImageWidth;
+        Height = ImageHeight;
+        return FormattedData;
+    }
+
+    void CheckHandWritten( void )
+    {
+        char Message[160];
+        for (const HandWrittenFile& File : HandWrittenCorpus())
+        {
+            for (int Simd = 1; Simd >= 0; --Simd)
+            {
+                ConfigureTGADecoder(Simd != 0);
+                std::vector<uint32_t> Pixels;
+                bool Decoded = Decode(File.Bytes, Pixels);
+                sprintf_s(Message, sizeof(Message), "%s decodes%s", File.Name, Simd ? "" : " (scalar)");
+                Check(Decoded && Pixels == File.Expected, Message);
+            }
+        }
+    }
+
+    // Returns the number of files checked
+    int CheckGenerated( void )
+    {
+        const uint32_t kWidths[] = { 1, 3, 8, 15, 16, 17, 33, 100 };
+        std::mt19937 Random(11);
+        char Message[200];
+        int NumFiles = 0;
+
+        for (const Layout& Format : kLayouts)
+        {
+            const uint32_t NumColors = Format.ImageType == 1 && Format.Depth == 16 ? 300 : 40;
+            for (uint32_t Width : kWidths)
+            {
+                Image Img = MakeImage(Width, 7, NumColors, Random);
+                for (uint32_t Variant = 0; Variant < 16; ++Variant)
+                {
+                    Encoding Options = { (Variant & 1) != 0, (Variant & 2) != 0, (Variant & 4) != 0, (Variant & 8) != 0 };
+                    if (!Options.Rle && Options.PacketsCrossRows)
+                        continue;
+
+                    std::vector<uint32_t> Expected;
+                    std::vector<uint8_t> File = Encode(Img, Format, Options, Expected);
+                    ++NumFiles;
+
+                    for (int Simd = 1; Simd >= 0; --Simd)
+                    {
+                        ConfigureTGADecoder(Simd != 0);
+                        std::vector<uint32_t> Pixels;
+                        bool PaddingIntact = false;
+                        bool Decoded = Decode(File, Pixels, &PaddingIntact);
+                        sprintf_s(Message, sizeof(Message), "%s, %u wide, %s%s, %s%s", Format.Name, Width,
+                            Options.Rle ? "RLE" : "uncompressed", Options.PacketsCrossRows ? " across rows" : "",
+                            Options.TopToBottom ? (Options.RightToLeft ? "top-right" : "top-left") : (Options.RightToLeft ? "bottom-right" : "bottom-left"),
+                            Simd ? "" : ", scalar");
+                        Check(Decoded && Pixels == Expected && PaddingIntact, Message);
+                    }
+                }
+            }
+        }
+        return NumFiles;
+    }
+
+    void CheckMalformed( void )
+    {
+        std::mt19937 Random(5);
+        Image Img = MakeImage(37, 9, 20, Random);
+        std::vector<uint32_t> Expected, Pixels;
+
+        // Every truncation of an RLE file, and of an uncompressed one, is rejected.  Under a memory checker this
+        // also shows that nothing past the end is read.
+        for (int Rle = 0; Rle < 2; ++Rle)
+        {
+            Encoding Options = { Rle != 0, false, false, true };
+            std::vector<uint8_t> File = Encode(Img, kLayouts[4], Options, Expected);
+            bool AllRejected = true;
+            for (size_t Length = 0; Length < File.size(); ++Length)
+            {
+                std::vector<uint8_t> Truncated(File.begin(), File.begin() + Length);
+                AllRejected = AllRejected && !Decode(Truncated, Pixels);
+            }
+            Check(AllRejected, Rle ? "truncated RLE files are rejected" : "truncated uncompressed files are rejected");
+        }
+
+        // Header fields this decoder can't handle
+        std::vector<uint8_t> Good = Encode(Img, kLayouts[3], Encoding{ false, false, false, false }, Expected);
+        Check(Decode(Good, Pixels) && Pixels == Expected, "the unmodified file decodes");
+
+        struct Corruption { size_t Offset; uint8_t Value; const char* Name; };
+        const Corruption Corruptions[] =
+        {
+            { 2, 0, "image type 0 (no image)" },
+            { 2, 4, "unknown image type" },
+            { 2, 32, "obsolete Huffman image type" },
+            { 1, 2, "unknown color map type" },
+            { 12, 0, "zero width" },
+            { 16, 12, "unsupported depth" },
+        };
+        for (const Corruption& Damage : Corruptions)
+        {
+            std::vector<uint8_t> Bad = Good;
+            Bad[Damage.Offset] = Damage.Value;
+            if (Damage.Offset == 12)
+                Bad[13] = 0;
+            char Message[128];
+            sprintf_s(Message, sizeof(Message), "rejects %s", Damage.Name);
+            Check(!Decode(Bad, Pixels), Message);
+        }
+
+        std::vector<uint8_t> Huge = Good;
+        Huge[12] = 0x01;
+        Huge[13] = 0x41;                // 16641 wide
+        Check(!Decode(Huge, Pixels), "rejects images wider than a texture can be");
+
+        // A color index before the first palette entry, and one past the last
+        std::vector<uint8_t> Indexed = Encode(Img, kLayouts[10], Encoding{ false, true, false, false }, Expected);
+        const size_t PixelOffset = 18 + 3 + 20 * 3;
+        std::vector<uint8_t> BadIndex = Indexed;
+        BadIndex[PixelOffset + 40] = 4;
+        Check(!Decode(BadIndex, Pixels), "rejects a color index before the palette");
+        BadIndex = Indexed;
+        BadIndex[PixelOffset + 40] = 25;
+        Check(!Decode(BadIndex, Pixels), "rejects a color index past the palette");
+
+        // A color map may come with any image type, and is skipped
+        std::vector<uint8_t> WithMap = Good;
+        WithMap[1] = 1;
+        WithMap[5] = 2;
+        WithMap[7] = 24;
+        WithMap.insert(WithMap.begin() + 18 + 3, 6, 0xAB);
+        Check(Decode(WithMap, Pixels) && Pixels == Expected, "a true color image with a color map is decoded");
+    }
+
+    void CheckOldLoader( void )
+    {
+        std::mt19937 Random(3);
+        Image Img = MakeImage(61, 13, 50, Random);
+        for (size_t LayoutIndex : { (size_t)3, (size_t)4, (size_t)5 })
+        {
+            // What the art tools wrote that loaded correctly before:  uncompressed from the bottom-left corner
+            std::vector<uint32_t> Expected, Pixels;
+            std::vector<uint8_t> File = Encode(Img, kLayouts[LayoutIndex], Encoding{ false, false, false, false }, Expected);
+
+            // The old loader didn't skip the image ID, so leave it out
+            File[0] = 0;
+            File.erase(File.begin() + 18, File.begin() + 21);
+            Check(Decode(File, Pixels), "decodes an old style file");
+
+            uint32_t Width, Height;
+            std::vector<uint32_t> Old = OldLoader(File.data(), Width, Height);
+
+            // The old loader put the bottom row at the top
+            bool Matches = Width == Img.Width && Height == Img.Height;
+            for (uint32_t y = 0; y < Img.Height && Matches; ++y)
+                Matches = memcmp(&Pixels[y * Width], &Old[(Height - 1 - y) * Width], Width * 4) == 0;
+            Check(Matches, LayoutIndex == 3 ? "24-bit pixels match the old loader" : "32-bit pixels match the old loader");
+        }
+    }
+
+    int SelfTest( void )
+    {
+        bool HasSSSE3 = ConfigureTGADecoder(true);
+        printf("SSSE3: %s\n", HasSSSE3 ? "yes" : "no, only the scalar conversions are checked");
+
+        CheckHandWritten();
+        int NumFiles = CheckGenerated();
+        printf("%d generated files\n", NumFiles);
+        CheckMalformed();
+        CheckOldLoader();
+
+        ConfigureTGADecoder(true);
+
+        return 0;
+    }
+
+    //
+    // Benchmark
+    //
+
+    const uint32_t kBenchSize = 2048;
+
+    // Rows of the upload buffer are 256-byte aligned
+    const size_t kUploadPitch = (kBenchSize * 4 + 255) & ~(size_t)255;
+
+    // Returns MB/s of RGBA written.  Repeats until about 1GB has been written.
+    template <typename DecodeFunction>
+    double TimeDecodes( DecodeFunction DecodeFn )
+    {
+        const size_t BytesPerImage = (size_t)kBenchSize * kBenchSize * 4;
+        const int Repeats = std::max(4, (int)((1 << 30) / BytesPerImage));
+
+        DecodeFn();
+        auto Start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < Repeats; ++i)
+            DecodeFn();
+        auto End = std::chrono::high_resolution_clock::now();
+
+        return (double)BytesPerImage * Repeats / std::chrono::duration<double>(End - Start).count() / (1024.0 * 1024.0);
+    }
+
+    int Bench( void )
+    {
+        // Color mapped images index from entry 5, so they get fewer colors to keep 8-bit indices in range.
+        std::mt19937 Random(1);
+        Image Img = MakeImage(kBenchSize, kBenchSize, 256, Random);
+        Image IndexedImage = MakeImage(kBenchSize, kBenchSize, 200, Random);
+        std::vector<uint8_t> Upload(kUploadPitch * kBenchSize);
+
+        printf("%ux%u images, MB/s of RGBA written to a buffer with %zu-byte rows\n", kBenchSize, kBenchSize, kUploadPitch);
+        printf("%-28s %12s %12s %12s %10s\n", "format", "old loop", "scalar", "SSSE3", "vs old");
+
+        struct BenchCase { size_t Format; bool Rle; };
+        const BenchCase Cases[] = { { 3, false }, { 4, false }, { 3, true }, { 4, true }, { 6, false }, { 7, false }, { 1, false }, { 11, false } };
+        for (const BenchCase& Case : Cases)
+        {
+            const Layout& Format = kLayouts[Case.Format];
+            std::vector<uint32_t> Expected;
+            std::vector<uint8_t> File = Encode(Format.ImageType == 1 ? IndexedImage : Img, Format,
+                Encoding{ Case.Rle, false, false, false }, Expected);
+
+            TGAImageInfo Info;
+            if (!ReadTGAHeader(File.data(), File.size(), Info) || !DecodeTGA(File.data(), File.size(), Info, Upload.data(), kUploadPitch))
+            {
+                printf("%s does not decode\n", Format.Name);
+                return 1;
+            }
+            auto DecodeFn = [&]() { DecodeTGA(File.data(), File.size(), Info, Upload.data(), kUploadPitch); };
+
+            char Name[64];
+            sprintf_s(Name, sizeof(Name), "%s%s", Format.Name, Case.Rle ? " RLE" : "");
+            printf("%-28s", Name);
+
+            // The old loader's staging array, then the copy into the upload buffer
+            double OldRate = 0.0;
+            if (!Case.Rle && (Format.Depth == 24 || Format.Depth == 32))
+            {
+                OldRate = TimeDecodes([&]()
+                {
+                    uint32_t Width, Height;
+                    std::vector<uint32_t> Staging = OldLoader(File.data(), Width, Height);
+                    for (uint32_t y = 0; y < Height; ++y)
+                        memcpy(&Upload[y * kUploadPitch], &Staging[y * Width], Width * 4);
+                });
+                printf(" %12.0f", OldRate);
+            }
+            else
+                printf(" %12s", "-");
+
+            ConfigureTGADecoder(false);
+            printf(" %12.0f", TimeDecodes(DecodeFn));
+
+            if (ConfigureTGADecoder(true))
+            {
+                double Rate = TimeDecodes(DecodeFn);
+                printf(" %12.0f", Rate);
+                if (OldRate > 0.0)
+                    printf(" %9.2fx", Rate / OldRate);
+            }
+            printf("\n");
+        }
+
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "bench", "", 0, []( int, char*[] ) { return Bench(); } },
+    };
+    return TestHarness::RunCommand(argc, argv, "TGALoaderTest", kCommands);
+}
@@ -0,0 +1,125 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// The checks and command line shared by the console tests in MiniEngine/Tools.  Each test lists its commands
+// and hands main()'s arguments to RunCommand(), which runs the command named first and reports any checks that
+// failed while it ran.  Check() can be called from any thread.
+//
+// Exit codes are 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+namespace TestHarness
+{
+    // Returned by a command whose arguments are out of range.  RunCommand() prints the usage.
+    const int kBadArguments = 2;
+
+    struct Command
+    {
+        const char* Name;
+        const char* Arguments;      // Shown in the usage, e.g. "[max threads]"
+        int MaxArguments;
+        int (*Run)( int ArgCount, char* Args[] );
+    };
+
+    namespace Internal
+    {
+        struct Results
+        {
+            std::mutex Mutex;
+            int Failures = 0;
+            std::atomic<bool> Checked{ false };
+        };
+
+        inline Results& GetResults( void )
+        {
+            static Results s_Results;
+            return s_Results;
+        }
+    }
+
+    // One bug tends to fail many checks in a row, so only the first 20 failures are printed.
+    inline void Check( bool Condition, const char* Message )
+    {
+        Internal::Results& Results = Internal::GetResults();
+
+        // Read first so that threads checking in a loop don't keep writing the same cache line
+        if (!Results.Checked.load(std::memory_order_relaxed))
+            Results.Checked.store(true, std::memory_order_relaxed);
+
+        if (!Condition)
+        {
+            std::lock_guard<std::mutex> Lock(Results.Mutex);
+            if (Results.Failures < 20)
+                printf("FAILED: %s\n", Message);
+            ++Results.Failures;
+        }
+    }
+
+    inline int GetFailures( void )
+    {
+        Internal::Results& Results = Internal::GetResults();
+        std::lock_guard<std::mutex> Lock(Results.Mutex);
+        return Results.Failures;
+    }
+
+    // Returns Args[Index] as a positive count, Default when it isn't given, or 0 when it isn't a positive count.
+    inline uint32_t GetCountArgument( int ArgCount, char* Args[], int Index, uint32_t Default )
+    {
+        if (Index >= ArgCount)
+            return Default;
+
+        const char* Arg = Args[Index];
+        if (!isdigit((unsigned char)Arg[0]))
+            return 0;
+
+        char* End = nullptr;
+        unsigned long long Value = strtoull(Arg, &End, 10);
+        return *End == '\0' && Value <= UINT32_MAX ? (uint32_t)Value : 0;
+    }
+
+    template <size_t NumCommands>
+    int RunCommand( int argc, char* argv[], const char* TestName, const Command (&Commands)[NumCommands] )
+    {
+        for (const Command& Cmd : Commands)
+        {
+            if (argc < 2 || strcmp(argv[1], Cmd.Name) != 0 || argc - 2 > Cmd.MaxArguments)
+                continue;
+
+            int Result = Cmd.Run(argc - 2, argv + 2);
+            if (Result == kBadArguments)
+                break;
+
+            int Failures = GetFailures();
+            if (Failures != 0)
+            {
+                printf("%s FAILED (%d checks)\n", Cmd.Name, Failures);
+                return 1;
+            }
+            if (Result == 0 && Internal::GetResults().Checked.load())
+                printf("%s passed\n", Cmd.Name);
+            return Result;
+        }
+
+        for (size_t i = 0; i < NumCommands; ++i)
+        {
+            printf("%s%s %s%s%s\n", i == 0 ? "Usage: " : "       ", TestName, Commands[i].Name,
+                Commands[i].Arguments[0] != '\0' ? " " : "", Commands[i].Arguments);
+        }
+        return kBadArguments;
+    }
+}
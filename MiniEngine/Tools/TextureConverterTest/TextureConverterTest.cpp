@@ -0,0 +1,569 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// A console tool for checking and timing the block compressor and the mip chain and DDS writer behind
+// TextureConverter (BlockCompress.cpp and TextureCompress.cpp).
+//
+//   TextureConverterTest selftest
+//       Decodes reference blocks, whose pixels came from an independent decoder, with the built-in decoder:  one
+//       or two of each format and mode the encoder writes.  BC7 must match exactly; the others may differ by one
+//       where decoders round the blended palette entries differently.  Then it encodes a generated image of
+//       gradients, edges, flat colors, noise and alpha cutouts in every format at both settings, with SSE2 and
+//       without, and checks that both paths write identical blocks, that quality is never worse than fast, that
+//       each meets a PSNR floor, and that flat blocks, transparency and opacity come back as they went in.
+//       Last come the mip filter (sRGB averaging, odd sizes), threaded compression and the DDS header.
+//   TextureConverterTest bench [max threads]
+//       Reports megapixels per second for each format and setting, for one thread with and without SSE2, and
+//       for a 2048x2048 mip chain on 1, 2, 4 ... threads.
+//
+// Returns 0 on success, 1 when a check fails and 2 for bad arguments.
+//
+
+#include "pch.h"
+#include "BlockCompress.h"
+#include "TextureCompress.h"
+#include "dds.h"
+#include "../TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+    const char* kSettingNames[2] = { "fast", "quality" };
+
+    // The channels each format stores
+    uint32_t ChannelMask( BCFormat Format )
+    {
+        return Format == kBC1 ? 0x7 : (Format == kBC4 ? 0x1 : (Format == kBC5 ? 0x3 : 0xF));
+    }
+
+    std::vector<uint8_t> FromHex( const char* Hex )
+    {
+        std::vector<uint8_t> Bytes;
+        for (; Hex[0] != 0 && Hex[1] != 0; Hex += 2)
+        {
+            char Digits[3] = { Hex[0], Hex[1], 0 };
+            Bytes.push_back((uint8_t)strtoul(Digits, nullptr, 16));
+        }
+        return Bytes;
+    }
+
+    //
+    // Reference blocks
+    //
+
+    struct ReferenceBlock
+    {
+        const char* Name;
+        BCFormat Format;
+        const char* Block;
+        const char* Pixels;     // RGBA, row by row
+        int Tolerance;
+    };
+
+    // Written by this encoder and decoded by another implementation.  BC4 and BC5 only give the channels stored.
+    const ReferenceBlock kReferenceBlocks[] =
+    {
+        { "BC1 four colors", kBC1, "D2830D2EBD2D2F0B",
+            "29C36BFF47AA78FF47AA78FF659186FF29C36BFF47AA78FF659186FF847994FF"
+            "47AA78FF47AA78FF659186FF847994FF47AA78FF659186FF847994FF847994FF", 1 },
+        { "BC1 three colors and transparent", kBC1, "A4ACE4B1D7BAAEC3",
+            "00000000B53C21FFB53C21FF00000000B16921FFB16921FF00000000B16921FF"
+            "B16921FF00000000B16921FFB16921FF00000000AD9621FFAD9621FF00000000", 1 },
+        { "BC3", kBC3, "F609C96FB7E42601331333AB78787878",
+            "10659C0944659C0978659C2AAD659C2A10659C4C44659C4C78659C6EAD659C6E"
+            "10659C9044659C9078659CB2AD659CB210659CD444659CD478659CF6AD659CF6", 1 },
+        { "BC4 eight values", kBC4, "C711C96FB7E42601",
+            "11000000110000002B0000002B00000045000000450000005F0000005F000000"
+            "79000000790000009300000093000000AD000000AD000000C7000000C7000000", 1 },
+        { "BC4 six values", kBC4, "6B8D3E207FA3DFC4",
+            "00000000FF0000006B0000006B0000007100000000000000FF00000078000000"
+            "780000007F00000000000000FF000000860000008D0000008D00000000000000", 1 },
+        { "BC5", kBC5, "9321F1100FF1100FF56000B08DB59D24",
+            "21F5000041F5000072F5000093F5000021CA000041CA000072CA000093B50000"
+            "219F0000418A0000728A0000938A000021600000416000007260000093600000", 1 },
+        { "BC7 mode 6", kBC7, "C00775301EA35EF82164539786CAB9FD",
+            "1F07C75F3222B674443AA8865755979A3B2EAF7D4C46A08F606190A3717981B6"
+            "5755979A686D88AD7C8878C18DA069D3717981B6849470CA96AC62DCA9C751F1", 0 },
+        { "BC7 mode 5", kBC7, "20C3A127CBE301FCCBC9C9C9F1F0F0F0",
+            "873C780087637800878C78FF87B378FF873C780087637800878C78FF87B378FF"
+            "873C780087637800878C78FF87B378FF873C780087637800878C78FF87B378FF", 0 },
+        { "BC7 mode 1", kBC7, "1A7A2D08CA91294541E7DE2314D0E55D",
+            "E12314FFDB1F14FFD51C14FF0A66D3FFE62614FFDD2114FF0A55D9FF0A66D3FF"
+            "E92814FF0A3BE1FF0A4DDBFF0A5ED6FF0A2AE7FF0A3BE1FF0A4DDBFF0A5ED6FF", 0 },
+    };
+
+    void CheckReferenceBlocks( void )
+    {
+        for (const ReferenceBlock& Reference : kReferenceBlocks)
+        {
+            std::vector<uint8_t> Block = FromHex(Reference.Block);
+            std::vector<uint8_t> Expected = FromHex(Reference.Pixels);
+            if (Block.size() != GetBCBlockSize(Reference.Format) || Expected.size() != 64)
+            {
+                Check(false, Reference.Name);
+                continue;
+            }
+
+            uint8_t Decoded[64];
+            Check(DecodeBCBlock(Reference.Format, Block.data(), Decoded), Reference.Name);
+
+            const uint32_t Channels = ChannelMask(Reference.Format) | (Reference.Format == kBC1 ? 0x8 : 0);
+            int Worst = 0;
+            for (uint32_t i = 0; i < 64; ++i)
+            {
+                if (Channels & (1 << (i % 4)))
+                    Worst = std::max(Worst, std::abs((int)Decoded[i] - (int)Expected[i]));
+            }
+            Check(Worst <= Reference.Tolerance, Reference.Name);
+        }
+
+        // Modes the encoder never writes, and the reserved mode, are refused
+        uint8_t Reserved[16] = {}, Mode0[16] = { 0x01 }, Decoded[64];
+        Check(!DecodeBCBlock(kBC7, Reserved, Decoded), "BC7 reserved mode is refused");
+        Check(!DecodeBCBlock(kBC7, Mode0, Decoded), "BC7 mode 0 is refused");
+    }
+
+    //
+    // Generated blocks
+    //
+
+    enum BlockKind { kGradient, kEdge, kFlat, kNoise, kCutout, kAlphaRamp, kNumBlockKinds };
+
+    const char* kBlockKindNames[kNumBlockKinds] = { "gradient", "edge", "flat", "noise", "cutout", "alpha ramp" };
+
+    uint8_t Clamp( int Value )
+    {
+        return (uint8_t)std::min(255, std::max(0, Value));
+    }
+
+    void MakeBlock( BlockKind Kind, std::mt19937& Random, uint8_t Pixels[64] )
+    {
+        std::uniform_int_distribution<int> Byte(0, 255), Slope(-40, 40), Jitter(-3, 3);
+        int Base[4] = { Byte(Random), Byte(Random), Byte(Random), 255 };
+        int Dx[3] = { Slope(Random), Slope(Random), Slope(Random) };
+        int Dy[3] = { Slope(Random), Slope(Random), Slope(Random) };
+        int Other[3] = { Byte(Random), Byte(Random), Byte(Random) };
+        int Edge = std::uniform_int_distribution<int>(1, 5)(Random);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            int x = i % 4, y = i / 4;
+            uint8_t* Texel = Pixels + i * 4;
+            for (int c = 0; c < 3; ++c)
+            {
+                switch (Kind)
+                {
+                case kFlat:
+                    Texel[c] = (uint8_t)Base[c];
+                    break;
+                case kNoise:
+                    Texel[c] = (uint8_t)Byte(Random);
+                    break;
+                case kEdge:
+                    Texel[c] = (uint8_t)(x + y < Edge ? Base[c] : Other[c]);
+                    break;
+                default:
+                    Texel[c] = Clamp(Base[c] + (Dx[c] * x + Dy[c] * y) / 4 + Jitter(Random));
+                    break;
+                }
+            }
+            Texel[3] = Kind == kCutout ? (x + y < Edge ? 0 : 255) : (Kind == kAlphaRamp ? Clamp(40 + x * 50 + y * 10) : 255);
+        }
+    }
+
+    struct Corpus
+    {
+        std::vector<uint8_t> Pixels;        // 64 bytes per block
+        std::vector<BlockKind> Kinds;
+    };
+
+    Corpus MakeCorpus( uint32_t BlocksPerKind )
+    {
+        Corpus TestCorpus;
+        std::mt19937 Random(7);
+        for (uint32_t i = 0; i < BlocksPerKind; ++i)
+        {
+            for (uint32_t k = 0; k < kNumBlockKinds; ++k)
+            {
+                uint8_t Pixels[64];
+                MakeBlock((BlockKind)k, Random, Pixels);
+                TestCorpus.Pixels.insert(TestCorpus.Pixels.end(), Pixels, Pixels + 64);
+                TestCorpus.Kinds.push_back((BlockKind)k);
+            }
+        }
+        return TestCorpus;
+    }
+
+    // The least PSNR over the corpus, leaving out the noise blocks, for each format, fast then quality
+    const double kPSNRFloor[kNumBCFormats][2] =
+    {
+        { 35.5, 35.5 },     // BC1
+        { 35.5, 35.5 },     // BC3
+        { 48.0, 48.5 },     // BC4
+        { 48.0, 48.5 },     // BC5
+        { 36.0, 37.0 },     // BC7
+    };
+
+    void CheckGenerated( void )
+    {
+        const Corpus TestCorpus = MakeCorpus(200);
+        const size_t NumBlocks = TestCorpus.Kinds.size();
+
+        for (uint32_t f = 0; f < kNumBCFormats; ++f)
+        {
+            const BCFormat Format = (BCFormat)f;
+            const size_t BlockSize = GetBCBlockSize(Format);
+            const uint32_t Channels = ChannelMask(Format);
+            double Error[2] = {};
+
+            for (uint32_t Quality = 0; Quality < 2; ++Quality)
+            {
+                char Name[128];
+                std::vector<uint8_t> Blocks(NumBlocks * BlockSize), ScalarBlocks(NumBlocks * BlockSize);
+
+                ConfigureBCEncoder(true);
+                for (size_t b = 0; b < NumBlocks; ++b)
+                    EncodeBCBlock(Format, &TestCorpus.Pixels[b * 64], Quality != 0, &Blocks[b * BlockSize]);
+                ConfigureBCEncoder(false);
+                for (size_t b = 0; b < NumBlocks; ++b)
+                    EncodeBCBlock(Format, &TestCorpus.Pixels[b * 64], Quality != 0, &ScalarBlocks[b * BlockSize]);
+                ConfigureBCEncoder(true);
+
+                sprintf_s(Name, sizeof(Name), "%s %s:  SSE2 and scalar blocks match", GetBCFormatName(Format), kSettingNames[Quality]);
+                Check(Blocks == ScalarBlocks, Name);
+
+                double KindError[kNumBlockKinds] = {}, KindSamples[kNumBlockKinds] = {};
+                for (size_t b = 0; b < NumBlocks; ++b)
+                {
+                    const uint8_t* Source = &TestCorpus.Pixels[b * 64];
+                    const BlockKind Kind = TestCorpus.Kinds[b];
+                    uint8_t Decoded[64];
+                    DecodeBCBlock(Format, &Blocks[b * BlockSize], Decoded);
+
+                    int WorstFlat = 0;
+                    bool AlphaKept = true;
+                    for (uint32_t i = 0; i < 16; ++i)
+                    {
+                        const uint8_t* In = Source + i * 4;
+                        const uint8_t* Out = Decoded + i * 4;
+
+                        // BC1 makes texels below half alpha transparent black, and keeps the rest opaque
+                        if (Format == kBC1)
+                        {
+                            AlphaKept = AlphaKept && Out[3] == (In[3] < 128 ? 0 : 255);
+                            if (In[3] < 128)
+                                continue;
+                        }
+                        else if (Channels & 0x8)
+                            AlphaKept = AlphaKept && (In[3] != 255 || Out[3] == 255);
+
+                        for (uint32_t c = 0; c < 4; ++c)
+                        {
+                            if ((Channels & (1 << c)) == 0)
+                                continue;
+                            const double d = (double)In[c] - Out[c];
+                            KindError[Kind] += d * d;
+                            KindSamples[Kind] += 1.0;
+                            WorstFlat = std::max(WorstFlat, std::abs((int)In[c] - (int)Out[c]));
+                        }
+                    }
+
+                    sprintf_s(Name, sizeof(Name), "%s %s:  alpha of %s blocks", GetBCFormatName(Format), kSettingNames[Quality], kBlockKindNames[Kind]);
+                    Check(AlphaKept, Name);
+
+                    // BC4 reproduces any flat value; BC1 and BC3 are within their 5:6:5 endpoints' rounding, and
+                    // BC7 within its 7-bit endpoints' rounding
+                    if (Kind == kFlat)
+                    {
+                        const int Limit = Format == kBC4 || Format == kBC5 ? 0 : (Format == kBC7 ? 1 : 4);
+                        sprintf_s(Name, sizeof(Name), "%s %s:  flat block within %d", GetBCFormatName(Format), kSettingNames[Quality], Limit);
+                        Check(WorstFlat <= Limit, Name);
+                    }
+                }
+
+                // Noise is there to exercise the encoder, not to be reproduced
+                double Samples = 0.0;
+                for (uint32_t k = 0; k < kNumBlockKinds; ++k)
+                {
+                    if (k != kNoise)
+                    {
+                        Error[Quality] += KindError[k];
+                        Samples += KindSamples[k];
+                    }
+                }
+
+                const double Psnr = 10.0 * log10(255.0 * 255.0 * Samples / Error[Quality]);
+                printf("%s %-8s %6.2f dB  (", GetBCFormatName(Format), kSettingNames[Quality], Psnr);
+                for (uint32_t k = 0; k < kNumBlockKinds; ++k)
+                {
+                    printf("%s%s %.1f", k ? ", " : "", kBlockKindNames[k],
+                        KindError[k] == 0.0 ? 99.0 : 10.0 * log10(255.0 * 255.0 * KindSamples[k] / KindError[k]));
+                }
+                printf(")\n");
+
+                sprintf_s(Name, sizeof(Name), "%s %s:  PSNR of at least %.1f dB", GetBCFormatName(Format), kSettingNames[Quality], kPSNRFloor[f][Quality]);
+                Check(Psnr >= kPSNRFloor[f][Quality], Name);
+            }
+
+            char Name[128];
+            sprintf_s(Name, sizeof(Name), "%s:  quality is no worse than fast", GetBCFormatName(Format));
+            Check(Error[1] <= Error[0], Name);
+        }
+    }
+
+    //
+    // Mip chain, threading and DDS header
+    //
+
+    MipLevel MakeLevel( uint32_t Width, uint32_t Height, const uint8_t* Pixels )
+    {
+        MipLevel Level;
+        Level.Width = Width;
+        Level.Height = Height;
+        Level.Pixels.assign(Pixels, Pixels + (size_t)Width * Height * 4);
+        return Level;
+    }
+
+    void CheckMipChain( void )
+    {
+        // Black and white average to half the light, which sRGB stores as 188, not 128.  Alpha averages as stored.
+        const uint8_t Checker[16] = { 0, 0, 0, 0,   255, 255, 255, 255,   255, 255, 255, 255,   0, 0, 0, 0 };
+        std::vector<MipLevel> Levels(1, MakeLevel(2, 2, Checker));
+        GenerateMipChain(Levels, 2, true);
+        Check(Levels.size() == 2 && Levels[1].Width == 1 && Levels[1].Height == 1, "2x2 has two levels");
+        Check(Levels.size() == 2 && Levels[1].Pixels[0] == 188 && Levels[1].Pixels[2] == 188, "sRGB averages light");
+        Check(Levels.size() == 2 && Levels[1].Pixels[3] == 128, "alpha averages as stored");
+
+        Levels.assign(1, MakeLevel(2, 2, Checker));
+        GenerateMipChain(Levels, 2, false);
+        Check(Levels.size() == 2 && Levels[1].Pixels[0] == 128, "linear data averages as stored");
+
+        // Three texels become one with a third of each, so the middle one isn't dropped
+        const uint8_t Row[12] = { 0, 0, 0, 255,   255, 90, 30, 255,   0, 0, 0, 255 };
+        Levels.assign(1, MakeLevel(3, 1, Row));
+        GenerateMipChain(Levels, GetFullMipCount(3, 1), false);
+        Check(Levels.size() == 2 && Levels[1].Pixels[0] == 85 && Levels[1].Pixels[1] == 30 && Levels[1].Pixels[2] == 10,
+            "odd widths weigh every texel");
+
+        // Halving rounds down and stops at 1x1, however oblong
+        Check(GetFullMipCount(6, 3) == 3 && GetFullMipCount(1024, 1024) == 11 && GetFullMipCount(256, 1) == 9, "mip counts");
+        std::vector<uint8_t> Big(12 * 5 * 4, 200);
+        Levels.assign(1, MakeLevel(12, 5, Big.data()));
+        GenerateMipChain(Levels, GetFullMipCount(12, 5), true);
+        const uint32_t Sizes[][2] = { { 12, 5 }, { 6, 2 }, { 3, 1 }, { 1, 1 } };
+        bool SizesMatch = Levels.size() == 4;
+        for (size_t i = 0; SizesMatch && i < Levels.size(); ++i)
+        {
+            SizesMatch = Levels[i].Width == Sizes[i][0] && Levels[i].Height == Sizes[i][1];
+            for (uint8_t Value : Levels[i].Pixels)
+                SizesMatch = SizesMatch && Value == 200;
+        }
+        Check(SizesMatch, "12x5 chain sizes, and a flat texture stays flat");
+    }
+
+    void CheckCompressedChain( void )
+    {
+        // A chain whose lower levels are smaller than a block, compressed on one thread and on several
+        std::mt19937 Random(3);
+        std::vector<uint8_t> Pixels(64 * 32 * 4);
+        for (size_t i = 0; i < Pixels.size(); ++i)
+            Pixels[i] = (uint8_t)(i % 4 == 3 ? 255 : (i / 4 % 64) * 4 + Random() % 3);
+        std::vector<MipLevel> Levels(1, MakeLevel(64, 32, Pixels.data()));
+        GenerateMipChain(Levels, GetFullMipCount(64, 32), true);
+
+        for (uint32_t f = 0; f < kNumBCFormats; ++f)
+        {
+            const BCFormat Format = (BCFormat)f;
+            size_t ExpectedSize = 0;
+            for (const MipLevel& Level : Levels)
+                ExpectedSize += GetCompressedLevelSize(Level.Width, Level.Height, Format);
+
+            std::vector<uint8_t> Single, Threaded;
+            CompressMipChain(Levels, Format, false, 1, Single);
+            CompressMipChain(Levels, Format, false, 5, Threaded);
+
+            char Name[128];
+            sprintf_s(Name, sizeof(Name), "%s chain is %zu bytes", GetBCFormatName(Format), ExpectedSize);
+            Check(Single.size() == ExpectedSize, Name);
+            sprintf_s(Name, sizeof(Name), "%s chain is the same on five threads", GetBCFormatName(Format));
+            Check(Single == Threaded, Name);
+        }
+
+        // Texels past the edge of a partial block repeat the last column and row.  Two values in a channel come
+        // back exactly from BC5.
+        const uint8_t Pair[8] = { 90, 30, 200, 255,   150, 60, 200, 255 };
+        std::vector<MipLevel> Tiny(1, MakeLevel(2, 1, Pair));
+        std::vector<uint8_t> Block;
+        CompressMipChain(Tiny, kBC5, true, 1, Block);
+        uint8_t Decoded[64];
+        DecodeBCBlock(kBC5, Block.data(), Decoded);
+        bool EdgeRepeated = Block.size() == 16;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            const uint8_t* Expected = i % 4 == 0 ? Pair : Pair + 4;
+            EdgeRepeated = EdgeRepeated && Decoded[i * 4] == Expected[0] && Decoded[i * 4 + 1] == Expected[1];
+        }
+        Check(EdgeRepeated, "partial blocks repeat the edge");
+        Check(GetCompressedLevelSize(1, 1, kBC1) == 8 && GetCompressedLevelSize(5, 9, kBC7) == 96, "level sizes round up to blocks");
+    }
+
+    void CheckDDSFile( void )
+    {
+        using namespace DirectX;
+
+        std::vector<uint8_t> Blocks(GetCompressedLevelSize(8, 4, kBC7) + GetCompressedLevelSize(4, 2, kBC7) +
+            GetCompressedLevelSize(2, 1, kBC7) + GetCompressedLevelSize(1, 1, kBC7), 0x5A);
+        std::vector<uint8_t> File;
+        MakeDDSFile(8, 4, 4, kBC7, true, Blocks, File);
+
+        const size_t DataOffset = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+        Check(File.size() == DataOffset + Blocks.size(), "DDS size");
+        if (File.size() != DataOffset + Blocks.size())
+            return;
+
+        uint32_t Magic;
+        DDS_HEADER Header;
+        DDS_HEADER_DXT10 Extension;
+        memcpy(&Magic, File.data(), sizeof(Magic));
+        memcpy(&Header, File.data() + sizeof(Magic), sizeof(Header));
+        memcpy(&Extension, File.data() + sizeof(Magic) + sizeof(Header), sizeof(Extension));
+
+        Check(Magic == DDS_MAGIC && Header.size == sizeof(DDS_HEADER), "DDS magic and header size");
+        Check(Header.width == 8 && Header.height == 4 && Header.mipMapCount == 4, "DDS dimensions and mip count");
+        Check((Header.flags & DDS_HEADER_FLAGS_TEXTURE) == DDS_HEADER_FLAGS_TEXTURE && (Header.flags & DDS_HEADER_FLAGS_MIPMAP) != 0, "DDS flags");
+        Check(Header.pitchOrLinearSize == 32, "DDS linear size is the top level's");
+        Check((Header.ddspf.flags & DDS_FOURCC) != 0 && Header.ddspf.fourCC == DDSPF_DX10.fourCC, "DX10 extension");
+        Check(Extension.dxgiFormat == DXGI_FORMAT_BC7_UNORM_SRGB && Extension.resourceDimension == DDS_DIMENSION_TEXTURE2D &&
+            Extension.arraySize == 1 && Extension.miscFlag == 0, "DX10 extension fields");
+        Check(memcmp(File.data() + DataOffset, Blocks.data(), Blocks.size()) == 0, "DDS block data");
+
+        MakeDDSFile(4, 4, 1, kBC4, false, std::vector<uint8_t>(8), File);
+        memcpy(&Header, File.data() + sizeof(Magic), sizeof(Header));
+        memcpy(&Extension, File.data() + sizeof(Magic) + sizeof(Header), sizeof(Extension));
+        Check(Extension.dxgiFormat == DXGI_FORMAT_BC4_UNORM && Header.mipMapCount == 1 && (Header.caps & DDS_SURFACE_FLAGS_MIPMAP) == 0,
+            "single level BC4");
+    }
+
+    int SelfTest( void )
+    {
+        CheckReferenceBlocks();
+        CheckGenerated();
+        CheckMipChain();
+        CheckCompressedChain();
+        CheckDDSFile();
+
+        return 0;
+    }
+
+    //
+    // Benchmark
+    //
+
+    double Seconds( std::chrono::high_resolution_clock::time_point Start )
+    {
+        return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - Start).count();
+    }
+
+    int Bench( uint32_t MaxThreads )
+    {
+        const Corpus TestCorpus = MakeCorpus(2000);
+        const size_t NumBlocks = TestCorpus.Kinds.size();
+        std::vector<uint8_t> Blocks(NumBlocks * 16);
+
+        printf("%zu generated blocks, megapixels per second on one thread\n", NumBlocks);
+        printf("%-6s %-8s %10s %10s %8s\n", "format", "setting", "scalar", "SSE2", "speedup");
+        for (uint32_t f = 0; f < kNumBCFormats; ++f)
+        {
+            for (uint32_t Quality = 0; Quality < 2; ++Quality)
+            {
+                double Rate[2];
+                for (uint32_t Sse2 = 0; Sse2 < 2; ++Sse2)
+                {
+                    ConfigureBCEncoder(Sse2 != 0);
+                    auto Start = std::chrono::high_resolution_clock::now();
+                    for (size_t b = 0; b < NumBlocks; ++b)
+                        EncodeBCBlock((BCFormat)f, &TestCorpus.Pixels[b * 64], Quality != 0, &Blocks[b * 16]);
+                    Rate[Sse2] = NumBlocks * 16 / Seconds(Start) / 1e6;
+                }
+                printf("%-6s %-8s %10.2f %10.2f %7.2fx\n", GetBCFormatName((BCFormat)f), kSettingNames[Quality], Rate[0], Rate[1], Rate[1] / Rate[0]);
+            }
+        }
+        ConfigureBCEncoder(true);
+
+        // A 2048x2048 chain of smooth color with some noise
+        const uint32_t Size = 2048;
+        std::mt19937 Random(5);
+        std::vector<uint8_t> Pixels((size_t)Size * Size * 4);
+        for (uint32_t y = 0; y < Size; ++y)
+        {
+            for (uint32_t x = 0; x < Size; ++x)
+            {
+                uint8_t* Texel = &Pixels[((size_t)y * Size + x) * 4];
+                Texel[0] = (uint8_t)(128 + 100 * sin(x * 0.01) + Random() % 8);
+                Texel[1] = (uint8_t)(128 + 100 * cos(y * 0.013) + Random() % 8);
+                Texel[2] = (uint8_t)((x ^ y) & 0xFF);
+                Texel[3] = 255;
+            }
+        }
+        std::vector<MipLevel> Levels(1, MakeLevel(Size, Size, Pixels.data()));
+        auto Start = std::chrono::high_resolution_clock::now();
+        GenerateMipChain(Levels, GetFullMipCount(Size, Size), true);
+        double MipSeconds = Seconds(Start);
+        uint64_t NumPixels = 0;
+        for (const MipLevel& Level : Levels)
+            NumPixels += (uint64_t)Level.Width * Level.Height;
+        printf("\n%ux%u mip chain:  filtered in %.0f ms; megapixels per second compressing it\n", Size, Size, MipSeconds * 1000.0);
+
+        printf("%-6s %-8s", "format", "setting");
+        for (uint32_t Threads = 1; Threads <= MaxThreads; Threads *= 2)
+            printf(" %7u thr", Threads);
+        printf("\n");
+
+        std::vector<uint8_t> Chain;
+        for (uint32_t f = 0; f < kNumBCFormats; ++f)
+        {
+            for (uint32_t Quality = 0; Quality < 2; ++Quality)
+            {
+                printf("%-6s %-8s", GetBCFormatName((BCFormat)f), kSettingNames[Quality]);
+                for (uint32_t Threads = 1; Threads <= MaxThreads; Threads *= 2)
+                {
+                    Start = std::chrono::high_resolution_clock::now();
+                    CompressMipChain(Levels, (BCFormat)f, Quality != 0, Threads, Chain);
+                    printf(" %11.2f", NumPixels / Seconds(Start) / 1e6);
+                }
+                printf("\n");
+            }
+        }
+        return 0;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    static const TestHarness::Command kCommands[] =
+    {
+        { "selftest", "", 0, []( int, char*[] ) { return SelfTest(); } },
+        { "bench", "[max threads]", 1, []( int ArgCount, char* Args[] )
+        {
+            uint32_t MaxThreads = TestHarness::GetCountArgument(ArgCount, Args, 0, std::max(1u, std::thread::hardware_concurrency()));
+            return MaxThreads == 0 ? TestHarness::kBadArguments : Bench(MaxThreads);
+        } },
+    };
+    return TestHarness::RunCommand(argc, argv, "TextureConverterTest", kCommands);
+}
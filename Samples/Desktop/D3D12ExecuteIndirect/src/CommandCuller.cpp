@@ -0,0 +1,305 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// This file doesn't use the precompiled header so that CommandCullerTest can share it.
+#include "CommandCuller.h"
+
+#include <cstring>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CULLING_TARGET_AVX2
+#else
+#define CULLING_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace
+{
+	inline const uint8_t* GetCommand(const void* pCommands, uint32_t index, size_t stride)
+	{
+		return static_cast<const uint8_t*>(pCommands) + index * stride;
+	}
+
+	// The x and w of a point transformed by the stored projection. The shader multiplies a row
+	// vector by the matrix, which, since the matrix is stored transposed, takes the dot product
+	// with the first and last rows as they are laid out in memory.
+	inline bool IsVisible(const CullingParameters& parameters, const CullingSceneConstants& constants)
+	{
+		const float* pOffset = constants.offset;
+		const float* pRowX = constants.projection;
+		const float* pRowW = constants.projection + 12;
+
+		const float leftX = -parameters.xOffset + pOffset[0];
+		const float rightX = parameters.xOffset + pOffset[0];
+		const float y = 0.0f + pOffset[1];
+		const float z = parameters.zOffset + pOffset[2];
+		const float w = 1.0f + pOffset[3];
+
+		// Keep the products separate from the sums, so that they aren't fused.
+		float products[4];
+		products[0] = leftX * pRowX[0]; products[1] = y * pRowX[1]; products[2] = z * pRowX[2]; products[3] = w * pRowX[3];
+		const float leftProjectedX = ((products[0] + products[1]) + products[2]) + products[3];
+		products[0] = leftX * pRowW[0]; products[1] = y * pRowW[1]; products[2] = z * pRowW[2]; products[3] = w * pRowW[3];
+		const float leftProjectedW = ((products[0] + products[1]) + products[2]) + products[3];
+		products[0] = rightX * pRowX[0]; products[1] = y * pRowX[1]; products[2] = z * pRowX[2]; products[3] = w * pRowX[3];
+		const float rightProjectedX = ((products[0] + products[1]) + products[2]) + products[3];
+		products[0] = rightX * pRowW[0]; products[1] = y * pRowW[1]; products[2] = z * pRowW[2]; products[3] = w * pRowW[3];
+		const float rightProjectedW = ((products[0] + products[1]) + products[2]) + products[3];
+
+		return -parameters.cullOffset < rightProjectedX / rightProjectedW && leftProjectedX / leftProjectedW < parameters.cullOffset;
+	}
+
+	uint32_t CullRange(const CullingParameters& parameters, const CullingSceneConstants* pConstants, const void* pInputCommands, uint32_t first, uint32_t end, size_t commandStride, uint8_t* pOutput)
+	{
+		uint32_t count = 0;
+		for (uint32_t n = first; n < end; n++)
+		{
+			if (IsVisible(parameters, pConstants[n]))
+			{
+				memcpy(pOutput + count * commandStride, GetCommand(pInputCommands, n, commandStride), commandStride);
+				count++;
+			}
+		}
+		return count;
+	}
+
+	// Loads 4 floats from each of 4 constant buffers, at the same offset, and transposes them
+	// so that each register holds one component of all 4.
+	inline void LoadTransposed(const CullingSceneConstants* pConstants, size_t floatOffset, __m128& a, __m128& b, __m128& c, __m128& d)
+	{
+		a = _mm_loadu_ps(reinterpret_cast<const float*>(pConstants + 0) + floatOffset);
+		b = _mm_loadu_ps(reinterpret_cast<const float*>(pConstants + 1) + floatOffset);
+		c = _mm_loadu_ps(reinterpret_cast<const float*>(pConstants + 2) + floatOffset);
+		d = _mm_loadu_ps(reinterpret_cast<const float*>(pConstants + 3) + floatOffset);
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+	}
+
+	inline __m128 Dot4(__m128 x, __m128 y, __m128 z, __m128 w, __m128 row0, __m128 row1, __m128 row2, __m128 row3)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, row0), _mm_mul_ps(y, row1)), _mm_mul_ps(z, row2)), _mm_mul_ps(w, row3));
+	}
+
+	CULLING_TARGET_AVX2 inline __m256 Dot8(__m256 x, __m256 y, __m256 z, __m256 w, __m256 row0, __m256 row1, __m256 row2, __m256 row3)
+	{
+		return _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, row0), _mm256_mul_ps(y, row1)), _mm256_mul_ps(z, row2)), _mm256_mul_ps(w, row3));
+	}
+
+	CULLING_TARGET_AVX2 inline void LoadTransposed8(const CullingSceneConstants* pConstants, size_t floatOffset, __m256& a, __m256& b, __m256& c, __m256& d)
+	{
+		__m128 a0, b0, c0, d0, a1, b1, c1, d1;
+		LoadTransposed(pConstants, floatOffset, a0, b0, c0, d0);
+		LoadTransposed(pConstants + 4, floatOffset, a1, b1, c1, d1);
+		a = _mm256_insertf128_ps(_mm256_castps128_ps256(a0), a1, 1);
+		b = _mm256_insertf128_ps(_mm256_castps128_ps256(b0), b1, 1);
+		c = _mm256_insertf128_ps(_mm256_castps128_ps256(c0), c1, 1);
+		d = _mm256_insertf128_ps(_mm256_castps128_ps256(d0), d1, 1);
+	}
+
+	// For each 8-bit visibility mask, the indices of the set bits packed 3 bits apiece from
+	// the bottom, and the number of set bits in the top byte.
+	struct LeftPackTable
+	{
+		uint32_t entries[256];
+
+		LeftPackTable()
+		{
+			for (uint32_t mask = 0; mask < 256; mask++)
+			{
+				uint32_t packed = 0;
+				uint32_t count = 0;
+				for (uint32_t bit = 0; bit < 8; bit++)
+				{
+					if (mask & (1u << bit))
+					{
+						packed |= bit << (count * 3);
+						count++;
+					}
+				}
+				entries[mask] = packed | (count << 24);
+			}
+		}
+	};
+
+	const LeftPackTable g_leftPackTable;
+}
+
+uint32_t CullCommandsScalar(const CullingParameters& parameters, const CullingSceneConstants* pConstants, const void* pInputCommands, uint32_t commandCount, size_t commandStride, void* pOutputCommands)
+{
+	return CullRange(parameters, pConstants, pInputCommands, 0, commandCount, commandStride, static_cast<uint8_t*>(pOutputCommands));
+}
+
+uint32_t CullCommandsSse2(const CullingParameters& parameters, const CullingSceneConstants* pConstants, const void* pInputCommands, uint32_t commandCount, size_t commandStride, void* pOutputCommands)
+{
+	const size_t offsetIndex = offsetof(CullingSceneConstants, offset) / sizeof(float);
+	const size_t rowXIndex = offsetof(CullingSceneConstants, projection) / sizeof(float);
+	const size_t rowWIndex = rowXIndex + 12;
+
+	const __m128 leftX = _mm_set1_ps(-parameters.xOffset);
+	const __m128 rightX = _mm_set1_ps(parameters.xOffset);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 zOffset = _mm_set1_ps(parameters.zOffset);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 cullOffset = _mm_set1_ps(parameters.cullOffset);
+	const __m128 negativeCullOffset = _mm_set1_ps(-parameters.cullOffset);
+
+	uint8_t* pOutput = static_cast<uint8_t*>(pOutputCommands);
+	uint32_t count = 0;
+	uint32_t n = 0;
+	for (; n + 4 <= commandCount; n += 4)
+	{
+		__m128 offsetX, offsetY, offsetZ, offsetW;
+		__m128 x0, x1, x2, x3;
+		__m128 w0, w1, w2, w3;
+		LoadTransposed(pConstants + n, offsetIndex, offsetX, offsetY, offsetZ, offsetW);
+		LoadTransposed(pConstants + n, rowXIndex, x0, x1, x2, x3);
+		LoadTransposed(pConstants + n, rowWIndex, w0, w1, w2, w3);
+
+		const __m128 left = _mm_add_ps(leftX, offsetX);
+		const __m128 right = _mm_add_ps(rightX, offsetX);
+		const __m128 y = _mm_add_ps(zero, offsetY);
+		const __m128 z = _mm_add_ps(zOffset, offsetZ);
+		const __m128 w = _mm_add_ps(one, offsetW);
+
+		const __m128 leftProjected = _mm_div_ps(Dot4(left, y, z, w, x0, x1, x2, x3), Dot4(left, y, z, w, w0, w1, w2, w3));
+		const __m128 rightProjected = _mm_div_ps(Dot4(right, y, z, w, x0, x1, x2, x3), Dot4(right, y, z, w, w0, w1, w2, w3));
+		const __m128 visible = _mm_and_ps(_mm_cmplt_ps(negativeCullOffset, rightProjected), _mm_cmplt_ps(leftProjected, cullOffset));
+
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(visible));
+		while (mask != 0)
+		{
+			uint32_t bit = 0;
+			while (!(mask & (1u << bit)))
+			{
+				bit++;
+			}
+			mask &= mask - 1;
+
+			memcpy(pOutput + count * commandStride, GetCommand(pInputCommands, n + bit, commandStride), commandStride);
+			count++;
+		}
+	}
+
+	return count + CullRange(parameters, pConstants, pInputCommands, n, commandCount, commandStride, pOutput + count * commandStride);
+}
+
+CULLING_TARGET_AVX2 uint32_t CullCommandsAvx2(const CullingParameters& parameters, const CullingSceneConstants* pConstants, const void* pInputCommands, uint32_t commandCount, size_t commandStride, void* pOutputCommands)
+{
+	const size_t offsetIndex = offsetof(CullingSceneConstants, offset) / sizeof(float);
+	const size_t rowXIndex = offsetof(CullingSceneConstants, projection) / sizeof(float);
+	const size_t rowWIndex = rowXIndex + 12;
+
+	const __m256 leftX = _mm256_set1_ps(-parameters.xOffset);
+	const __m256 rightX = _mm256_set1_ps(parameters.xOffset);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 zOffset = _mm256_set1_ps(parameters.zOffset);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 cullOffset = _mm256_set1_ps(parameters.cullOffset);
+	const __m256 negativeCullOffset = _mm256_set1_ps(-parameters.cullOffset);
+	const __m256i indexShifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256i indexMask = _mm256_set1_epi32(7);
+
+	uint8_t* pOutput = static_cast<uint8_t*>(pOutputCommands);
+	uint32_t count = 0;
+	uint32_t n = 0;
+	for (; n + 8 <= commandCount; n += 8)
+	{
+		__m256 offsetX, offsetY, offsetZ, offsetW;
+		__m256 x0, x1, x2, x3;
+		__m256 w0, w1, w2, w3;
+		LoadTransposed8(pConstants + n, offsetIndex, offsetX, offsetY, offsetZ, offsetW);
+		LoadTransposed8(pConstants + n, rowXIndex, x0, x1, x2, x3);
+		LoadTransposed8(pConstants + n, rowWIndex, w0, w1, w2, w3);
+
+		const __m256 left = _mm256_add_ps(leftX, offsetX);
+		const __m256 right = _mm256_add_ps(rightX, offsetX);
+		const __m256 y = _mm256_add_ps(zero, offsetY);
+		const __m256 z = _mm256_add_ps(zOffset, offsetZ);
+		const __m256 w = _mm256_add_ps(one, offsetW);
+
+		const __m256 leftProjected = _mm256_div_ps(Dot8(left, y, z, w, x0, x1, x2, x3), Dot8(left, y, z, w, w0, w1, w2, w3));
+		const __m256 rightProjected = _mm256_div_ps(Dot8(right, y, z, w, x0, x1, x2, x3), Dot8(right, y, z, w, w0, w1, w2, w3));
+		const __m256 visible = _mm256_and_ps(
+			_mm256_cmp_ps(negativeCullOffset, rightProjected, _CMP_LT_OQ),
+			_mm256_cmp_ps(leftProjected, cullOffset, _CMP_LT_OQ));
+
+		const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(visible));
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		// Left-pack the indices of the visible commands, then copy those commands.
+		const uint32_t entry = g_leftPackTable.entries[mask];
+		const uint32_t visibleCount = entry >> 24;
+		const __m256i packed = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(entry)), indexShifts), indexMask);
+
+		uint32_t indices[8];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(indices), _mm256_add_epi32(packed, _mm256_set1_epi32(static_cast<int>(n))));
+
+		for (uint32_t i = 0; i < visibleCount; i++)
+		{
+			memcpy(pOutput + (count + i) * commandStride, GetCommand(pInputCommands, indices[i], commandStride), commandStride);
+		}
+		count += visibleCount;
+	}
+
+	return count + CullRange(parameters, pConstants, pInputCommands, n, commandCount, commandStride, pOutput + count * commandStride);
+}
+
+CullingPath GetBestCullingPath()
+{
+#if defined(_MSC_VER)
+	// AVX2 needs both CPU support and the OS to save the upper halves of the YMM registers.
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7)
+	{
+		__cpuid(info, 1);
+		const bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+
+		__cpuidex(info, 7, 0);
+		if (osSavesYmm && (info[1] & (1 << 5)))
+		{
+			return CullingPath_Avx2;
+		}
+	}
+#else
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return CullingPath_Avx2;
+	}
+#endif
+
+	// SSE2 is part of x64.
+	return CullingPath_Sse2;
+}
+
+CullCommandsFunction GetCullCommandsFunction(CullingPath path)
+{
+	switch (path)
+	{
+	case CullingPath_Avx2:
+		return CullCommandsAvx2;
+
+	case CullingPath_Sse2:
+		return CullCommandsSse2;
+
+	default:
+		return CullCommandsScalar;
+	}
+}
+
+uint32_t CullCommands(const CullingParameters& parameters, const CullingSceneConstants* pConstants, const void* pInputCommands, uint32_t commandCount, size_t commandStride, void* pOutputCommands)
+{
+	static const CullCommandsFunction cullCommands = GetCullCommandsFunction(GetBestCullingPath());
+	return cullCommands(parameters, pConstants, pInputCommands, commandCount, commandStride, pOutputCommands);
+}
@@ -0,0 +1,73 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CPU versions of the culling pass in compute.hlsl. Each one projects the left and right
+// edges of every triangle, and copies the indirect commands of the triangles that fall inside
+// the culling planes to the output, in order. They are used when culling on the CPU, and as
+// the reference that the compute shader's output is checked against.
+//
+// The SIMD versions give exactly the same results as the scalar one: they do the same float
+// operations in the same order, without fused multiply-adds.
+
+// The layout of the per-triangle constant buffers, as in D3D12ExecuteIndirect::SceneConstantBuffer.
+// The projection matrix is stored transposed, so that HLSL's column major packing reads it as
+// it was built.
+struct CullingSceneConstants
+{
+	float velocity[4];
+	float offset[4];
+	float color[4];
+	float projection[16];
+	float padding[36];
+};
+
+static_assert(sizeof(CullingSceneConstants) == 256, "Constant buffers are 256-byte aligned.");
+
+// The root constants of the compute shader.
+struct CullingParameters
+{
+	float xOffset;		// Half the width of the triangles.
+	float zOffset;		// The z offset for the triangle vertices.
+	float cullOffset;	// The culling plane offset in homogenous space.
+};
+
+enum CullingPath
+{
+	CullingPath_Scalar,
+	CullingPath_Sse2,
+	CullingPath_Avx2,
+};
+
+// Copies the commands of visible triangles from pInputCommands to pOutputCommands, both of which
+// hold commandCount commands of commandStride bytes, and returns the number copied.
+typedef uint32_t(*CullCommandsFunction)(
+	const CullingParameters& parameters,
+	const CullingSceneConstants* pConstants,
+	const void* pInputCommands,
+	uint32_t commandCount,
+	size_t commandStride,
+	void* pOutputCommands);
+
+uint32_t CullCommandsScalar(const CullingParameters& parameters, const CullingSceneConstants* pConstants, const void* pInputCommands, uint32_t commandCount, size_t commandStride, void* pOutputCommands);
+uint32_t CullCommandsSse2(const CullingParameters& parameters, const CullingSceneConstants* pConstants, const void* pInputCommands, uint32_t commandCount, size_t commandStride, void* pOutputCommands);
+uint32_t CullCommandsAvx2(const CullingParameters& parameters, const CullingSceneConstants* pConstants, const void* pInputCommands, uint32_t commandCount, size_t commandStride, void* pOutputCommands);
+
+// Returns the fastest path the CPU supports.
+CullingPath GetBestCullingPath();
+CullCommandsFunction GetCullCommandsFunction(CullingPath path);
+
+// Culls with the fastest path the CPU supports.
+uint32_t CullCommands(const CullingParameters& parameters, const CullingSceneConstants* pConstants, const void* pInputCommands, uint32_t commandCount, size_t commandStride, void* pOutputCommands);
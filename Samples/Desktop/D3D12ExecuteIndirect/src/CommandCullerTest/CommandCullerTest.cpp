@@ -0,0 +1,296 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Tests and measures the sample's CPU command culling, without a GPU.
+//
+//     CommandCullerTest selftest                  Check the culling test on known scenes, and check that every
+//                                                 SIMD path gives the same output as the scalar one on random scenes.
+//     CommandCullerTest benchmark [commands]      Cull scenes laid out as the sample's, and report the commands
+//                                                 processed per second by each path.
+//
+// Paths the CPU doesn't support are skipped.
+// The exit code is 0 on success, 1 if the self test fails and 2 for bad arguments.
+
+#include "../CommandCuller.h"
+#include "../../../Shared/TestHarness.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+	// As D3D12ExecuteIndirect::IndirectCommand.
+	struct IndirectCommand
+	{
+		uint64_t cbv;
+		uint32_t drawArguments[4];
+	};
+
+	static_assert(sizeof(IndirectCommand) == 24, "The command layout must match the sample's.");
+
+	const CullingParameters SampleParameters = { 0.05f, 1.0f, 0.5f };
+
+	const char* const PathNames[] = { "scalar", "sse2", "avx2" };
+
+	bool IsPathSupported(CullingPath path)
+	{
+		return path <= GetBestCullingPath();
+	}
+
+	// XMMatrixPerspectiveFovLH, stored transposed as the sample does.
+	void SetProjection(CullingSceneConstants& constants, float fovAngleY, float aspectRatio, float nearZ, float farZ)
+	{
+		const float yScale = 1.0f / tanf(fovAngleY * 0.5f);
+		const float xScale = yScale / aspectRatio;
+		const float range = farZ / (farZ - nearZ);
+
+		memset(constants.projection, 0, sizeof(constants.projection));
+		constants.projection[0] = xScale;
+		constants.projection[5] = yScale;
+		constants.projection[10] = range;
+		constants.projection[11] = -range * nearZ;
+		constants.projection[14] = 1.0f;
+	}
+
+	CullingSceneConstants SceneConstants(float x, float y, float z)
+	{
+		CullingSceneConstants constants = {};
+		constants.offset[0] = x;
+		constants.offset[1] = y;
+		constants.offset[2] = z;
+		SetProjection(constants, 3.14159265f / 4.0f, 1280.0f / 720.0f, 0.01f, 20.0f);
+		return constants;
+	}
+
+	std::vector<IndirectCommand> NumberedCommands(uint32_t count)
+	{
+		std::vector<IndirectCommand> commands(count);
+		for (uint32_t n = 0; n < count; n++)
+		{
+			commands[n].cbv = 0x10000 + n * sizeof(CullingSceneConstants);
+			commands[n].drawArguments[0] = 3;
+			commands[n].drawArguments[1] = 1;
+			commands[n].drawArguments[2] = 0;
+			commands[n].drawArguments[3] = n;
+		}
+		return commands;
+	}
+
+	// Triangles placed by hand either side of the culling planes.
+	void TestKnownScene()
+	{
+		// At depth 1 + z, a triangle is visible while its nearer edge is within cullOffset * (1 + z) / xScale
+		// of the center; its center can be about 0.42 away at z = 0, and 1.15 at z = 2.
+		const float xs[] = { 0.0f, -0.3f, 0.3f, -0.5f, 0.5f, -5.0f, 5.0f, 1.0f, -1.0f, 0.3f };
+		const float zs[] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 2.0f, 2.0f, 1.0f };
+		const bool expected[] = { true, true, true, false, false, false, false, true, true, true };
+		const uint32_t count = static_cast<uint32_t>(sizeof(xs) / sizeof(xs[0]));
+
+		std::vector<CullingSceneConstants> constants;
+		for (uint32_t n = 0; n < count; n++)
+		{
+			constants.push_back(SceneConstants(xs[n], 0.0f, zs[n]));
+		}
+
+		const std::vector<IndirectCommand> commands = NumberedCommands(count);
+		for (int path = CullingPath_Scalar; path <= CullingPath_Avx2; path++)
+		{
+			if (!IsPathSupported(static_cast<CullingPath>(path)))
+			{
+				continue;
+			}
+
+			std::vector<IndirectCommand> output(count);
+			const uint32_t visibleCount = GetCullCommandsFunction(static_cast<CullingPath>(path))(SampleParameters, constants.data(), commands.data(), count, sizeof(IndirectCommand), output.data());
+
+			uint32_t expectedCount = 0;
+			bool matches = true;
+			for (uint32_t n = 0; n < count; n++)
+			{
+				if (expected[n])
+				{
+					matches = matches && expectedCount < visibleCount && memcmp(&output[expectedCount], &commands[n], sizeof(IndirectCommand)) == 0;
+					expectedCount++;
+				}
+			}
+			Check(visibleCount == expectedCount, "the known scene keeps the expected number of triangles");
+			Check(matches, "the known scene keeps the expected triangles, in order");
+		}
+	}
+
+	// The sample's culling planes are at +/-0.5 in homogenous space, so a triangle straddling one
+	// of them must be kept, and one just beyond must be dropped.
+	void TestPlaneEdges()
+	{
+		CullingSceneConstants constants = SceneConstants(0.0f, 0.0f, 0.0f);
+		const float xScale = constants.projection[0];
+		const float edge = SampleParameters.cullOffset / xScale;
+
+		std::vector<CullingSceneConstants> scene;
+		scene.push_back(SceneConstants(edge + SampleParameters.xOffset * 0.5f, 0.0f, 0.0f));
+		scene.push_back(SceneConstants(edge + SampleParameters.xOffset * 1.5f, 0.0f, 0.0f));
+		scene.push_back(SceneConstants(-edge - SampleParameters.xOffset * 0.5f, 0.0f, 0.0f));
+		scene.push_back(SceneConstants(-edge - SampleParameters.xOffset * 1.5f, 0.0f, 0.0f));
+
+		const std::vector<IndirectCommand> commands = NumberedCommands(static_cast<uint32_t>(scene.size()));
+		std::vector<IndirectCommand> output(commands.size());
+		const uint32_t visibleCount = CullCommandsScalar(SampleParameters, scene.data(), commands.data(), static_cast<uint32_t>(scene.size()), sizeof(IndirectCommand), output.data());
+		Check(visibleCount == 2, "triangles straddling the culling planes are kept");
+		Check(visibleCount >= 2 && output[0].drawArguments[3] == 0 && output[1].drawArguments[3] == 2, "triangles beyond the culling planes are dropped");
+	}
+
+	float RandomFloat(std::mt19937& random, float min, float max)
+	{
+		return std::uniform_real_distribution<float>(min, max)(random);
+	}
+
+	// Scenes with random offsets and projections, including triangles behind the camera and
+	// degenerate matrices, checked byte for byte against the scalar path for several strides
+	// and command counts that don't fill the SIMD registers.
+	void TestRandomScenes()
+	{
+		std::mt19937 random(38);
+		const size_t strides[] = { sizeof(IndirectCommand), 4, 20, 33 };
+
+		bool allMatch = true;
+		uint32_t visibleTotal = 0;
+		uint32_t commandTotal = 0;
+		for (int scene = 0; scene < 2000; scene++)
+		{
+			const uint32_t count = std::uniform_int_distribution<uint32_t>(0, 67)(random);
+			const size_t stride = strides[scene % (sizeof(strides) / sizeof(strides[0]))];
+			const CullingParameters parameters = { RandomFloat(random, 0.0f, 0.2f), RandomFloat(random, -1.0f, 2.0f), RandomFloat(random, 0.0f, 1.0f) };
+
+			std::vector<CullingSceneConstants> constants(count);
+			for (CullingSceneConstants& triangle : constants)
+			{
+				triangle = SceneConstants(RandomFloat(random, -6.0f, 6.0f), RandomFloat(random, -1.0f, 1.0f), RandomFloat(random, -3.0f, 3.0f));
+				if (scene % 3 == 1)
+				{
+					SetProjection(triangle, RandomFloat(random, 0.2f, 2.5f), RandomFloat(random, 0.5f, 3.0f), 0.01f, RandomFloat(random, 1.0f, 100.0f));
+				}
+				else if (scene % 3 == 2)
+				{
+					for (float& value : triangle.projection)
+					{
+						value = (random() % 4 == 0) ? 0.0f : RandomFloat(random, -2.0f, 2.0f);
+					}
+				}
+			}
+
+			std::vector<uint8_t> commands(count * stride);
+			for (uint8_t& value : commands)
+			{
+				value = static_cast<uint8_t>(random());
+			}
+
+			std::vector<uint8_t> expected(count * stride + 1, 0xcd);
+			const uint32_t expectedCount = CullCommandsScalar(parameters, constants.data(), commands.data(), count, stride, expected.data());
+			visibleTotal += expectedCount;
+			commandTotal += count;
+
+			for (int path = CullingPath_Sse2; path <= CullingPath_Avx2; path++)
+			{
+				if (!IsPathSupported(static_cast<CullingPath>(path)))
+				{
+					continue;
+				}
+
+				std::vector<uint8_t> output(count * stride + 1, 0xcd);
+				const uint32_t visibleCount = GetCullCommandsFunction(static_cast<CullingPath>(path))(parameters, constants.data(), commands.data(), count, stride, output.data());
+				if (visibleCount != expectedCount || output != expected)
+				{
+					printf("%s differs from scalar in scene %d (%u commands of %zu bytes, %u visible rather than %u)\n",
+						PathNames[path], scene, count, stride, visibleCount, expectedCount);
+					allMatch = false;
+				}
+			}
+		}
+
+		Check(allMatch, "every path matches the scalar path on random scenes");
+		Check(visibleTotal > commandTotal / 10 && visibleTotal < commandTotal - commandTotal / 10, "random scenes have both visible and culled triangles");
+	}
+
+	int RunSelfTest()
+	{
+		printf("best path: %s\n", PathNames[GetBestCullingPath()]);
+
+		TestKnownScene();
+		TestPlaneEdges();
+		TestRandomScenes();
+
+		return 0;
+	}
+
+	int RunBenchmark(uint32_t commandCount)
+	{
+		// Lay triangles out as the sample does at startup, and as they drift across the screen.
+		std::mt19937 random(5);
+		std::vector<CullingSceneConstants> constants(commandCount);
+		for (CullingSceneConstants& triangle : constants)
+		{
+			triangle = SceneConstants(RandomFloat(random, -5.0f, 5.0f), RandomFloat(random, -1.0f, 1.0f), RandomFloat(random, 0.0f, 2.0f));
+		}
+
+		const std::vector<IndirectCommand> commands = NumberedCommands(commandCount);
+		std::vector<IndirectCommand> output(commandCount);
+
+		const uint32_t passes = (64 * 1024 * 1024) / commandCount + 1;
+		for (int path = CullingPath_Scalar; path <= CullingPath_Avx2; path++)
+		{
+			if (!IsPathSupported(static_cast<CullingPath>(path)))
+			{
+				printf("%-6s not supported\n", PathNames[path]);
+				continue;
+			}
+
+			const CullCommandsFunction cullCommands = GetCullCommandsFunction(static_cast<CullingPath>(path));
+			uint32_t visibleCount = cullCommands(SampleParameters, constants.data(), commands.data(), commandCount, sizeof(IndirectCommand), output.data());
+
+			const auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t pass = 0; pass < passes; pass++)
+			{
+				visibleCount = cullCommands(SampleParameters, constants.data(), commands.data(), commandCount, sizeof(IndirectCommand), output.data());
+			}
+			const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			printf("%-6s %8.1f M commands/s, %8.1f us per %u commands, %u visible\n",
+				PathNames[path],
+				static_cast<double>(commandCount) * passes / seconds * 1e-6,
+				seconds * 1e6 / passes,
+				commandCount,
+				visibleCount);
+		}
+
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	static const TestHarness::Command commands[] =
+	{
+		{ "selftest", "", 0, [](int, char**) { return RunSelfTest(); } },
+		{ "benchmark", "[commands]", 1, [](int argCount, char** ppArgs)
+		{
+			const uint32_t commandCount = TestHarness::GetCountArgument(argCount, ppArgs, 0, 1024);
+			return (commandCount > 0) ? RunBenchmark(commandCount) : TestHarness::BadArguments;
+		} },
+	};
+	return TestHarness::RunCommand(argc, argv, "CommandCullerTest", commands);
+}
@@ -14,6 +14,7 @@
 
 const UINT D3D12ExecuteIndirect::CommandSizePerFrame = TriangleCount * sizeof(IndirectCommand);
 const UINT D3D12ExecuteIndirect::CommandBufferCounterOffset = AlignForUavCounter(D3D12ExecuteIndirect::CommandSizePerFrame);
+const UINT D3D12ExecuteIndirect::CpuCommandBufferSizePerFrame = D3D12ExecuteIndirect::CommandBufferCounterOffset + sizeof(UINT);
 const float D3D12ExecuteIndirect::TriangleHalfWidth = 0.05f;
 const float D3D12ExecuteIndirect::TriangleDepth = 1.0f;
 const float D3D12ExecuteIndirect::CullingCutoff = 0.5f;
@@ -28,6 +29,9 @@ D3D12ExecuteIndirect::D3D12ExecuteIndirect(UINT width, UINT height, std::wstring
 	m_cbvSrvUavDescriptorSize(0),
 	m_csRootConstants(),
 	m_enableCulling(true),
+	m_cullOnCpu(false),
+	m_cullCommandsOnCpu(GetCullCommandsFunction(GetBestCullingPath())),
+	m_pCpuProcessedCommandsBegin(nullptr),
 	m_fenceValues{}
 {
 	m_constantBufferData.resize(TriangleCount);
@@ -47,6 +51,7 @@ void D3D12ExecuteIndirect::OnInit()
 {
 	LoadPipeline();
 	LoadAssets();
+	UpdateWindowText();
 }
 
 // Load the rendering pipeline dependencies.
@@ -434,7 +439,7 @@ void D3D12ExecuteIndirect::LoadAssets()
 
 	// Create the command buffers and UAVs to store the results of the compute work.
 	{
-		std::vector<IndirectCommand> commands;
+		std::vector<IndirectCommand>& commands = m_commands;
 		commands.resize(TriangleResourceCount);
 		const UINT commandBufferSize = CommandSizePerFrame * FrameCount;
 
@@ -552,6 +557,21 @@ void D3D12ExecuteIndirect::LoadAssets()
 		ThrowIfFailed(m_processedCommandBufferCounterReset->Map(0, &readRange, reinterpret_cast<void**>(&pMappedCounterReset)));
 		ZeroMemory(pMappedCounterReset, sizeof(UINT));
 		m_processedCommandBufferCounterReset->Unmap(0, nullptr);
+
+		// Allocate an upload buffer to hold the commands culled on the CPU, and their
+		// count, for each frame. ExecuteIndirect reads them straight from the upload heap.
+		ThrowIfFailed(m_device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(CpuCommandBufferSizePerFrame * FrameCount),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&m_cpuProcessedCommandBuffer)));
+
+		NAME_D3D12_OBJECT(m_cpuProcessedCommandBuffer);
+
+		// We don't unmap this until the app closes.
+		ThrowIfFailed(m_cpuProcessedCommandBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_pCpuProcessedCommandsBegin)));
 	}
 
 	// Close the command list and execute it to begin the vertex buffer copy into
@@ -606,6 +626,34 @@ void D3D12ExecuteIndirect::OnUpdate()
 
 	UINT8* destination = m_pCbvDataBegin + (TriangleCount * m_frameIndex * sizeof(SceneConstantBuffer));
 	memcpy(destination, &m_constantBufferData[0], TriangleCount * sizeof(SceneConstantBuffer));
+
+	if (m_enableCulling && m_cullOnCpu)
+	{
+		CullCommandsOnCpu();
+	}
+}
+
+// Apply the compute shader's culling test on the CPU, and write the commands for
+// the visible triangles and their count to this frame's upload buffer.
+void D3D12ExecuteIndirect::CullCommandsOnCpu()
+{
+	static_assert(sizeof(SceneConstantBuffer) == sizeof(CullingSceneConstants), "The culling code expects the constant buffer layout.");
+
+	CullingParameters parameters = {};
+	parameters.xOffset = m_csRootConstants.xOffset;
+	parameters.zOffset = m_csRootConstants.zOffset;
+	parameters.cullOffset = m_csRootConstants.cullOffset;
+
+	UINT8* pDestination = m_pCpuProcessedCommandsBegin + CpuCommandBufferSizePerFrame * m_frameIndex;
+	const UINT visibleCount = m_cullCommandsOnCpu(
+		parameters,
+		reinterpret_cast<const CullingSceneConstants*>(&m_constantBufferData[0]),
+		&m_commands[TriangleCount * m_frameIndex],
+		TriangleCount,
+		sizeof(IndirectCommand),
+		pDestination);
+
+	memcpy(pDestination + CommandBufferCounterOffset, &visibleCount, sizeof(UINT));
 }
 
 // Render the scene.
@@ -615,7 +663,7 @@ void D3D12ExecuteIndirect::OnRender()
 	PopulateCommandLists();
 
 	// Execute the compute work.
-	if (m_enableCulling)
+	if (m_enableCulling && !m_cullOnCpu)
 	{
 		PIXBeginEvent(m_commandQueue.Get(), 0, L"Cull invisible triangles");
 
@@ -659,6 +707,28 @@ void D3D12ExecuteIndirect::OnKeyDown(UINT8 key)
 	{
 		m_enableCulling = !m_enableCulling;
 	}
+	else if (key == 'C')
+	{
+		m_cullOnCpu = !m_cullOnCpu;
+	}
+
+	UpdateWindowText();
+}
+
+void D3D12ExecuteIndirect::UpdateWindowText()
+{
+	if (!m_enableCulling)
+	{
+		SetCustomWindowText(L"Culling disabled");
+	}
+	else if (m_cullOnCpu)
+	{
+		SetCustomWindowText(L"Culling on the CPU");
+	}
+	else
+	{
+		SetCustomWindowText(L"Culling on the GPU");
+	}
 }
 
 // Fill the command list with all the render commands and dependent state.
@@ -676,8 +746,10 @@ void D3D12ExecuteIndirect::PopulateCommandLists()
 	ThrowIfFailed(m_computeCommandList->Reset(m_computeCommandAllocators[m_frameIndex].Get(), m_computeState.Get()));
 	ThrowIfFailed(m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), m_pipelineState.Get()));
 
+	const bool cullOnGpu = m_enableCulling && !m_cullOnCpu;
+
 	// Record the compute commands that will cull triangles and prevent them from being processed by the vertex shader.
-	if (m_enableCulling)
+	if (cullOnGpu)
 	{
 		UINT frameDescriptorOffset = m_frameIndex * CbvSrvUavDescriptorCountPerFrame;
 		D3D12_GPU_DESCRIPTOR_HANDLE cbvSrvUavHandle = m_cbvSrvUavHeap->GetGPUDescriptorHandleForHeapStart();
@@ -715,20 +787,22 @@ void D3D12ExecuteIndirect::PopulateCommandLists()
 		m_commandList->RSSetViewports(1, &m_viewport);
 		m_commandList->RSSetScissorRects(1, m_enableCulling ? &m_cullingScissorRect : &m_scissorRect);
 
-		// Indicate that the command buffer will be used for indirect drawing
-		// and that the back buffer will be used as a render target.
+		// Indicate that the back buffer will be used as a render target and that
+		// the command buffer will be used for indirect drawing. Commands culled on
+		// the CPU are read from an upload heap, which can't change state.
 		D3D12_RESOURCE_BARRIER barriers[2] = {
-			CD3DX12_RESOURCE_BARRIER::Transition(
-				m_enableCulling ? m_processedCommandBuffers[m_frameIndex].Get() : m_commandBuffer.Get(),
-				m_enableCulling ? D3D12_RESOURCE_STATE_UNORDERED_ACCESS : D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
-				D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT),
 			CD3DX12_RESOURCE_BARRIER::Transition(
 				m_renderTargets[m_frameIndex].Get(),
 				D3D12_RESOURCE_STATE_PRESENT,
-				D3D12_RESOURCE_STATE_RENDER_TARGET)
+				D3D12_RESOURCE_STATE_RENDER_TARGET),
+			CD3DX12_RESOURCE_BARRIER::Transition(
+				cullOnGpu ? m_processedCommandBuffers[m_frameIndex].Get() : m_commandBuffer.Get(),
+				cullOnGpu ? D3D12_RESOURCE_STATE_UNORDERED_ACCESS : D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+				D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT)
 		};
+		const UINT barrierCount = (m_enableCulling && m_cullOnCpu) ? 1 : _countof(barriers);
 
-		m_commandList->ResourceBarrier(_countof(barriers), barriers);
+		m_commandList->ResourceBarrier(barrierCount, barriers);
 
 		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
 		CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
@@ -742,7 +816,7 @@ void D3D12ExecuteIndirect::PopulateCommandLists()
 		m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 		m_commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
 
-		if (m_enableCulling)
+		if (cullOnGpu)
 		{
 			PIXBeginEvent(m_commandList.Get(), 0, L"Draw visible triangles");
 
@@ -755,6 +829,20 @@ void D3D12ExecuteIndirect::PopulateCommandLists()
 				m_processedCommandBuffers[m_frameIndex].Get(),
 				CommandBufferCounterOffset);
 		}
+		else if (m_enableCulling)
+		{
+			PIXBeginEvent(m_commandList.Get(), 0, L"Draw triangles culled on the CPU");
+
+			// Draw the triangles that were found to be visible in OnUpdate().
+			const UINT64 frameOffset = CpuCommandBufferSizePerFrame * m_frameIndex;
+			m_commandList->ExecuteIndirect(
+				m_commandSignature.Get(),
+				TriangleCount,
+				m_cpuProcessedCommandBuffer.Get(),
+				frameOffset,
+				m_cpuProcessedCommandBuffer.Get(),
+				frameOffset + CommandBufferCounterOffset);
+		}
 		else
 		{
 			PIXBeginEvent(m_commandList.Get(), 0, L"Draw all triangles");
@@ -772,12 +860,12 @@ void D3D12ExecuteIndirect::PopulateCommandLists()
 
 		// Indicate that the command buffer may be used by the compute shader
 		// and that the back buffer will now be used to present.
-		barriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
-		barriers[0].Transition.StateAfter = m_enableCulling ? D3D12_RESOURCE_STATE_COPY_DEST : D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
-		barriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
-		barriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
+		barriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
+		barriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
+		barriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
+		barriers[1].Transition.StateAfter = cullOnGpu ? D3D12_RESOURCE_STATE_COPY_DEST : D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
 
-		m_commandList->ResourceBarrier(_countof(barriers), barriers);
+		m_commandList->ResourceBarrier(barrierCount, barriers);
 
 		ThrowIfFailed(m_commandList->Close());
 	}
@@ -12,6 +12,7 @@
 #pragma once
 
 #include "DXSample.h"
+#include "CommandCuller.h"
 
 using namespace DirectX;
 
@@ -39,6 +40,7 @@ private:
 	static const UINT TriangleResourceCount = TriangleCount * FrameCount;
 	static const UINT CommandSizePerFrame;				// The size of the indirect commands to draw all of the triangles in a single frame.
 	static const UINT CommandBufferCounterOffset;		// The offset of the UAV counter in the processed command buffer.
+	static const UINT CpuCommandBufferSizePerFrame;		// The size of the commands culled on the CPU for a single frame, followed by their count.
 	static const UINT ComputeThreadBlockSize = 128;		// Should match the value in compute.hlsl.
 	static const float TriangleHalfWidth;				// The x and y offsets used by the triangle vertices.
 	static const float TriangleDepth;					// The z offset used by the triangle vertices.
@@ -109,6 +111,10 @@ private:
 
 	CSRootConstants m_csRootConstants;	// Constants for the compute shader.
 	bool m_enableCulling;				// Toggle whether the compute shader pre-processes the indirect commands.
+	bool m_cullOnCpu;					// Toggle whether the indirect commands are culled on the CPU instead of by the compute shader.
+	CullCommandsFunction m_cullCommandsOnCpu;
+	std::vector<IndirectCommand> m_commands;	// A CPU copy of the command buffer, for culling on the CPU.
+	UINT8* m_pCpuProcessedCommandsBegin;
 
 	// Pipeline objects.
 	CD3DX12_VIEWPORT m_viewport;
@@ -148,11 +154,14 @@ private:
 	ComPtr<ID3D12Resource> m_commandBuffer;
 	ComPtr<ID3D12Resource> m_processedCommandBuffers[FrameCount];
 	ComPtr<ID3D12Resource> m_processedCommandBufferCounterReset;
+	ComPtr<ID3D12Resource> m_cpuProcessedCommandBuffer;
 	D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
 
 	void LoadPipeline();
 	void LoadAssets();
 	float GetRandomFloat(float min, float max);
+	void CullCommandsOnCpu();
+	void UpdateWindowText();
 	void PopulateCommandLists();
 	void WaitForGpu();
 	void MoveToNextFrame();
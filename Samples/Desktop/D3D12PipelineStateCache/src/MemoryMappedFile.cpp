@@ -9,14 +9,64 @@
 //
 //*********************************************************
 
-#include "stdafx.h"
+// This file doesn't use the precompiled header so that it only depends on the platform's file mapping API.
 #include "MemoryMappedFile.h"
 
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	void ReportError(const char* pOperation)
+	{
+#ifdef _WIN32
+		std::cerr << pOperation << " failed with error " << GetLastError() << ".\n";
+#else
+		std::cerr << pOperation << " failed: " << strerror(errno) << ".\n";
+#endif
+	}
+
+#ifndef _WIN32
+	std::string NarrowPath(const std::wstring& path)
+	{
+		std::string narrowPath(path.size() * MB_CUR_MAX + 1, '\0');
+		const size_t length = wcstombs(&narrowPath[0], path.c_str(), narrowPath.size());
+		if (length == static_cast<size_t>(-1))
+		{
+			return std::string();
+		}
+		narrowPath.resize(length);
+		return narrowPath;
+	}
+#endif
+}
+
 MemoryMappedFile::MemoryMappedFile() :
+#ifdef _WIN32
 	m_mapFile(INVALID_HANDLE_VALUE),
 	m_file(INVALID_HANDLE_VALUE),
+#else
+	m_file(-1),
+#endif
 	m_mapAddress(nullptr),
-	m_currentFileSize(0)
+	m_currentFileSize(0),
+	m_cacheKey(0)
 {
 }
 
@@ -24,131 +74,451 @@ MemoryMappedFile::~MemoryMappedFile()
 {
 }
 
-void MemoryMappedFile::Init(std::wstring filename, UINT fileSize)
+uint32_t MemoryMappedFile::Crc32(const void* pData, size_t size)
 {
-	m_filename = filename;
-	WIN32_FIND_DATA findFileData;
-	HANDLE handle = FindFirstFileEx(filename.c_str(), FindExInfoBasic, &findFileData, FindExSearchNameMatch, nullptr, 0);
-	bool found = handle != INVALID_HANDLE_VALUE;
+	static const struct CrcTable
+	{
+		uint32_t entries[256];
+
+		CrcTable()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t crc = i;
+				for (int bit = 0; bit < 8; bit++)
+				{
+					crc = (crc & 1) ? (0xEDB88320u ^ (crc >> 1)) : (crc >> 1);
+				}
+				entries[i] = crc;
+			}
+		}
+	} table;
 
-	if (found)
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; i++)
 	{
-		FindClose(handle);
+		crc = table.entries[(crc ^ pBytes[i]) & 0xFF] ^ (crc >> 8);
 	}
+	return ~crc;
+}
 
+void MemoryMappedFile::Init(std::wstring filename, uint64_t cacheKey, uint32_t fileSize)
+{
+	m_filename = filename;
+	m_cacheKey = cacheKey;
+
+	uint64_t existingFileSize = 0;
+#ifdef _WIN32
 	m_file = CreateFile2(
 		filename.c_str(),
 		GENERIC_READ | GENERIC_WRITE,
 		0,
-		(found) ? OPEN_EXISTING : CREATE_NEW,
+		OPEN_ALWAYS,
 		nullptr);
 
 	if (m_file == INVALID_HANDLE_VALUE)
 	{
-		std::cerr << (L"m_file is invalid. Error %ld.\n", GetLastError());
-		std::cerr << (L"Target file is %s\n", filename.c_str());
+		ReportError("Opening the cache file");
 		return;
 	}
 
 	LARGE_INTEGER realFileSize = {};
-	BOOL flag = GetFileSizeEx(m_file, &realFileSize);
-	if (!flag)
+	if (!GetFileSizeEx(m_file, &realFileSize))
 	{
-		std::cerr << (L"\nError %ld occurred in GetFileSizeEx!", GetLastError());
+		ReportError("GetFileSizeEx");
 		assert(false);
+		Destroy(false);
+		return;
+	}
+	existingFileSize = static_cast<uint64_t>(realFileSize.QuadPart);
+#else
+	m_file = open(NarrowPath(filename).c_str(), O_RDWR | O_CREAT, 0644);
+	if (m_file < 0)
+	{
+		ReportError("Opening the cache file");
 		return;
 	}
 
-	assert(realFileSize.HighPart == 0);
-	m_currentFileSize = realFileSize.LowPart;
-	if (m_currentFileSize == 0)
+	struct stat fileStatus = {};
+	if (fstat(m_file, &fileStatus) != 0)
 	{
-		// File mapping files with a size of 0 produces an error.
-		m_currentFileSize = DefaultFileSize;
+		ReportError("fstat");
+		assert(false);
+		Destroy(false);
+		return;
 	}
-	else if(fileSize > m_currentFileSize)
+	existingFileSize = static_cast<uint64_t>(fileStatus.st_size);
+#endif
+
+	// Mapping a file with a size of 0 produces an error, so new files start out at the default size.
+	// Files larger than 4GB can't have been written by us; they're mapped at the requested size and then reset.
+	uint32_t mappingSize = (fileSize > DefaultFileSize) ? fileSize : DefaultFileSize;
+	if (existingFileSize > mappingSize && existingFileSize <= UINT32_MAX)
 	{
-		// Grow to the specified size.
-		m_currentFileSize = fileSize;
+		mappingSize = static_cast<uint32_t>(existingFileSize);
 	}
 
-	m_mapFile = CreateFileMapping(m_file, nullptr, PAGE_READWRITE, 0, m_currentFileSize, nullptr);
+	if (!Map(mappingSize))
+	{
+		// Typically a full disk; the caller carries on without a cache.
+		Destroy(false);
+		return;
+	}
 
-	if (m_mapFile == nullptr)
+	const char* pReason = nullptr;
+	if (!Validate(&pReason))
+	{
+		// Start over with an empty cache rather than handing corrupt or foreign data to the runtime.
+		if (existingFileSize > 0)
+		{
+			std::cerr << "Discarding the contents of the cache file: " << pReason << ".\n";
+		}
+		WriteHeader(0, 0, 0);
+		Flush(0, sizeof(FileHeader));
+	}
+	else if (m_cacheKey == AnyCacheKey)
+	{
+		// Keep the key the file was written with.
+		m_cacheKey = GetHeader()->cacheKey;
+	}
+}
+
+void MemoryMappedFile::Destroy(bool deleteFile)
+{
+	Unmap();
+
+#ifdef _WIN32
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		if (!CloseHandle(m_file))
+		{
+			ReportError("Closing the cache file");
+			assert(false);
+		}
+		m_file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_file >= 0)
+	{
+		if (close(m_file) != 0)
+		{
+			ReportError("Closing the cache file");
+			assert(false);
+		}
+		m_file = -1;
+	}
+#endif
+
+	m_currentFileSize = 0;
+
+	if (deleteFile)
+	{
+#ifdef _WIN32
+		DeleteFileW(m_filename.c_str());
+#else
+		unlink(NarrowPath(m_filename).c_str());
+#endif
+	}
+}
+
+bool MemoryMappedFile::GrowMapping(uint32_t size)
+{
+	assert(size <= UINT32_MAX - sizeof(FileHeader));
+	const uint32_t neededSize = size + static_cast<uint32_t>(sizeof(FileHeader));
+
+	// Check the size.
+	if (!m_mapAddress)
+	{
+		return false;
+	}
+	if (neededSize <= m_currentFileSize)
+	{
+		// Don't shrink.
+		return true;
+	}
+
+	// Grow geometrically so that a cache which keeps getting bigger isn't remapped on every update.
+	uint32_t newSize = (m_currentFileSize <= UINT32_MAX / 2) ? m_currentFileSize * 2 : UINT32_MAX;
+	if (newSize < neededSize)
+	{
+		newSize = neededSize;
+	}
+
+	// The contents (and the header describing them) are carried over by the file itself; only the view changes.
+	const uint32_t oldSize = m_currentFileSize;
+	Unmap();
+	if (Map(newSize))
+	{
+		return true;
+	}
+
+	// Keep working at the old size; the caller sees that the capacity didn't change.
+	if (!Map(oldSize))
 	{
-		std::cerr << (L"m_mapFile is NULL: last error: %d\n", GetLastError());
 		assert(false);
+	}
+	return false;
+}
+
+void MemoryMappedFile::ShrinkToFit()
+{
+	if (!m_mapAddress)
+	{
 		return;
 	}
 
-	m_mapAddress = MapViewOfFile(m_mapFile, FILE_MAP_ALL_ACCESS, 0, 0, m_currentFileSize);
+	const uint32_t committedSize = GetSize() + static_cast<uint32_t>(sizeof(FileHeader));
+	const uint32_t newSize = (committedSize > DefaultFileSize) ? committedSize : DefaultFileSize;
+	if (newSize >= m_currentFileSize)
+	{
+		return;
+	}
 
-	if (m_mapAddress == nullptr)
+	// The file can't be truncated while it's mapped. If the truncation fails the file is left at its old size.
+	if (!Flush(0, m_currentFileSize))
 	{
-		std::cerr << (L"m_mapAddress is NULL: last error: %d\n", GetLastError());
-		assert(false);
 		return;
 	}
+	const uint32_t oldSize = m_currentFileSize;
+	Unmap();
+
+	if (!Map(SetFileSize(newSize) ? newSize : oldSize))
+	{
+		assert(false);
+	}
 }
 
-void MemoryMappedFile::Destroy(bool deleteFile)
+bool MemoryMappedFile::BeginUpdate()
+{
+	if (!m_mapAddress)
+	{
+		return false;
+	}
+
+	// If we crash while the data is being overwritten the file will read back as empty.
+	WriteHeader(0, 0, 0);
+	return Flush(0, sizeof(FileHeader));
+}
+
+bool MemoryMappedFile::Commit(uint32_t size, uint32_t checkedSize)
+{
+	if (!m_mapAddress)
+	{
+		return false;
+	}
+
+	assert(size <= GetCapacity());
+	assert(checkedSize <= size);
+
+	// The data must be on disk before the header that vouches for it. If it isn't, the header on disk is left
+	// alone: after BeginUpdate it reads back as empty, otherwise it still describes (and checksums) the old data.
+	void* pData = GetData();
+	if (!Flush(sizeof(FileHeader), size))
+	{
+		return false;
+	}
+	WriteHeader(size, checkedSize, Crc32(pData, checkedSize));
+	return Flush(0, sizeof(FileHeader));
+}
+
+bool MemoryMappedFile::Map(uint32_t size)
+{
+	assert(m_mapAddress == nullptr);
+
+#ifdef _WIN32
+	// Mapping more than the current size of the file would extend it, but it's done explicitly so that it can fail
+	// the same way on every platform.
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(m_file, &fileSize))
+	{
+		ReportError("GetFileSizeEx");
+		return false;
+	}
+
+	if (static_cast<uint64_t>(fileSize.QuadPart) < size && !SetFileSize(size))
+	{
+		return false;
+	}
+
+	m_mapFile = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE, 0, size, nullptr);
+	if (m_mapFile == nullptr)
+	{
+		ReportError("CreateFileMapping");
+		m_mapFile = INVALID_HANDLE_VALUE;
+		return false;
+	}
+
+	m_mapAddress = MapViewOfFile(m_mapFile, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (m_mapAddress == nullptr)
+	{
+		ReportError("MapViewOfFile");
+		CloseHandle(m_mapFile);
+		m_mapFile = INVALID_HANDLE_VALUE;
+		return false;
+	}
+#else
+	// Unlike CreateFileMapping, mmap won't extend the file; pages past its end aren't backed by anything.
+	struct stat fileStatus = {};
+	if (fstat(m_file, &fileStatus) != 0)
+	{
+		ReportError("fstat");
+		return false;
+	}
+
+	if (static_cast<uint64_t>(fileStatus.st_size) < size && !SetFileSize(size))
+	{
+		return false;
+	}
+
+	void* pAddress = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+	if (pAddress == MAP_FAILED)
+	{
+		ReportError("mmap");
+		return false;
+	}
+	m_mapAddress = pAddress;
+#endif
+
+	m_currentFileSize = size;
+	return true;
+}
+
+void MemoryMappedFile::Unmap()
 {
 	if (m_mapAddress)
 	{
-		BOOL flag = UnmapViewOfFile(m_mapAddress);
-		if (!flag)
+#ifdef _WIN32
+		if (!UnmapViewOfFile(m_mapAddress))
 		{
-			std::cerr << (L"\nError %ld occurred unmapping the view!", GetLastError());
+			ReportError("UnmapViewOfFile");
 			assert(false);
 		}
 
-		m_mapAddress = nullptr;
-
-		flag = CloseHandle(m_mapFile);	// Close the file mapping object.
-		if (!flag)
+		if (!CloseHandle(m_mapFile))	// Close the file mapping object.
 		{
-			std::cerr << (L"\nError %ld occurred closing the mapping object!", GetLastError());
+			ReportError("Closing the mapping object");
 			assert(false);
 		}
-
-		flag = CloseHandle(m_file);		// Close the file itself.
-		if (!flag)
+		m_mapFile = INVALID_HANDLE_VALUE;
+#else
+		if (munmap(m_mapAddress, m_currentFileSize) != 0)
 		{
-			std::cerr << (L"\nError %ld occurred closing the file!", GetLastError());
+			ReportError("munmap");
 			assert(false);
 		}
+#endif
+		m_mapAddress = nullptr;
 	}
+}
 
-	if (deleteFile)
+bool MemoryMappedFile::Flush(size_t offset, size_t length)
+{
+	if (!m_mapAddress)
+	{
+		return false;
+	}
+	if (length == 0)
 	{
-		DeleteFile(m_filename.c_str());
+		return true;
 	}
+
+	return FlushRange(static_cast<uint8_t*>(m_mapAddress) + offset, length);
 }
 
-void MemoryMappedFile::GrowMapping(UINT size)
+bool MemoryMappedFile::FlushRange(void* pAddress, size_t length)
 {
-	// Add space for the extra size at the beginning of the file.
-	size += sizeof(UINT);
+#ifdef _WIN32
+	// FlushViewOfFile only hands the dirty pages to the file system, FlushFileBuffers waits for them to reach the disk.
+	if (!FlushViewOfFile(pAddress, length) || !FlushFileBuffers(m_file))
+	{
+		ReportError("Flushing the mapping object");
+		return false;
+	}
+#else
+	// msync requires a page aligned address.
+	const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+	const uintptr_t address = reinterpret_cast<uintptr_t>(pAddress);
+	const uintptr_t alignedAddress = address - (address % pageSize);
+	if (msync(reinterpret_cast<void*>(alignedAddress), length + (address - alignedAddress), MS_SYNC) != 0)
+	{
+		ReportError("msync");
+		return false;
+	}
+#endif
+	return true;
+}
 
-	// Check the size.
-	if (size <= m_currentFileSize)
+bool MemoryMappedFile::SetFileSize(uint32_t size)
+{
+#ifdef _WIN32
+	LARGE_INTEGER endOfFile = {};
+	endOfFile.QuadPart = size;
+	if (!SetFilePointerEx(m_file, endOfFile, nullptr, FILE_BEGIN) || !SetEndOfFile(m_file))
 	{
-		// Don't shrink.
-		return;
+		ReportError("Resizing the cache file");
+		return false;
 	}
+#else
+	if (ftruncate(m_file, static_cast<off_t>(size)) != 0)
+	{
+		ReportError("ftruncate");
+		return false;
+	}
+#endif
+	return true;
+}
+
+bool MemoryMappedFile::Validate(const char** ppReason) const
+{
+	const FileHeader* pHeader = GetHeader();
+	const uint8_t* pData = static_cast<const uint8_t*>(m_mapAddress) + sizeof(FileHeader);
 
-	// Flush.
-	BOOL flag = FlushViewOfFile(m_mapAddress, 0);
-	if (!flag)
+	if (pHeader->magic != FileMagic || pHeader->version != FileVersion || pHeader->headerSize != sizeof(FileHeader))
 	{
-		std::cerr << (L"\nError %ld occurred flushing the mapping object!", GetLastError());
-		assert(false);
+		*ppReason = "unrecognized file format";
+		return false;
 	}
 
-	// Close the current mapping.
-	Destroy(false);
+	if (pHeader->headerCrc != Crc32(pHeader, offsetof(FileHeader, headerCrc)))
+	{
+		*ppReason = "the header is corrupt";
+		return false;
+	}
 
-	// Update the size and create a new mapping.
-	m_currentFileSize = size;
-	Init(m_filename, m_currentFileSize);
+	if (m_cacheKey != AnyCacheKey && pHeader->cacheKey != m_cacheKey)
+	{
+		*ppReason = "it was built for a different adapter or driver";
+		return false;
+	}
+
+	if (pHeader->dataSize > GetCapacity())
+	{
+		*ppReason = "the file is truncated";
+		return false;
+	}
+
+	if (pHeader->checkedSize > pHeader->dataSize || pHeader->dataCrc != Crc32(pData, pHeader->checkedSize))
+	{
+		*ppReason = "the data is corrupt";
+		return false;
+	}
+
+	return true;
+}
+
+void MemoryMappedFile::WriteHeader(uint32_t dataSize, uint32_t checkedSize, uint32_t dataCrc)
+{
+	FileHeader header = {};
+	header.magic = FileMagic;
+	header.version = FileVersion;
+	header.headerSize = sizeof(FileHeader);
+	header.cacheKey = m_cacheKey;
+	header.dataSize = dataSize;
+	header.dataCrc = dataCrc;
+	header.checkedSize = checkedSize;
+	header.headerCrc = Crc32(&header, offsetof(FileHeader, headerCrc));
+
+	// A torn header write fails the header CRC check.
+	memcpy(m_mapAddress, &header, sizeof(header));
 }
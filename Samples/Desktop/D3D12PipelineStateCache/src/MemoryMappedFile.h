@@ -11,29 +11,70 @@
 
 #pragma once
 
+#include <cstdint>
+#include <string>
+
+// A memory mapped file holding a single blob behind a small versioned header.
+//
+// The header records a cache key supplied by the caller (identifying the adapter and driver the blob was built
+// for) along with CRCs of the blob and of the header itself. Owners that verify parts of their data lazily can limit
+// the blob CRC to a prefix of the data (see Commit). Updates invalidate the header, write the data, flush it
+// and only then commit a new header, so a crash part way through an update leaves a file that fails validation
+// instead of one that loads garbage. Init resets any file that fails validation to empty, which makes the caller
+// rebuild its cache from scratch.
+//
+// The file is mapped with CreateFileMapping/MapViewOfFile on Windows and with mmap/ftruncate elsewhere. If a flush
+// fails the new header isn't published, and if the file can't be resized the old mapping is kept, so an I/O error
+// costs the update rather than the cache.
 class MemoryMappedFile
 {
 protected:
 	MemoryMappedFile();
-	~MemoryMappedFile();
+	virtual ~MemoryMappedFile();
 
-	void Init(std::wstring filename, UINT filesize = DefaultFileSize);
+	// Passing AnyCacheKey accepts whatever key the file was written with, which is what offline tools want.
+	void Init(std::wstring filename, uint64_t cacheKey, uint32_t filesize = DefaultFileSize);
 	void Destroy(bool deleteFile);
-	void GrowMapping(UINT size);
 
-	void SetSize(UINT size)
+	// Makes room for at least 'size' bytes of data. The mapping moves, so pointers returned by GetData() are invalidated.
+	// Returns false, leaving the capacity unchanged, if the file couldn't be grown.
+	bool GrowMapping(uint32_t size);
+
+	// Truncates the file to the committed data. The mapping moves, so pointers returned by GetData() are invalidated.
+	void ShrinkToFit();
+
+	// Marks the file as empty before its data is overwritten in place. Must be followed by Commit().
+	bool BeginUpdate();
+
+	// Flushes the data and then publishes a header describing the first 'size' bytes of it. Only the first
+	// 'checkedSize' bytes are covered by the data CRC; the owner is responsible for verifying the rest.
+	// Returns false if the data couldn't be flushed, in which case the header on disk is left as it was.
+	bool Commit(uint32_t size) { return Commit(size, size); }
+	bool Commit(uint32_t size, uint32_t checkedSize);
+
+	uint32_t GetSize() const
+	{
+		if (m_mapAddress)
+		{
+			return GetHeader()->dataSize;
+		}
+		return 0;
+	}
+
+	uint32_t GetCheckedSize() const
 	{
-		if(m_mapAddress)
+		if (m_mapAddress)
 		{
-			static_cast<UINT*>(m_mapAddress)[0] = size;
+			return GetHeader()->checkedSize;
 		}
+		return 0;
 	}
 
-	UINT GetSize() const
+	uint32_t GetCapacity() const
 	{
 		if (m_mapAddress)
 		{
-			return static_cast<UINT*>(m_mapAddress)[0];
+			return m_currentFileSize - static_cast<uint32_t>(sizeof(FileHeader));
 		}
 		return 0;
 	}
@@ -42,22 +83,58 @@ protected:
 	{
 		if (m_mapAddress)
 		{
-			// The actual data comes after the length.
-			return &static_cast<UINT*>(m_mapAddress)[1];
+			// The actual data comes after the header.
+			return static_cast<uint8_t*>(m_mapAddress) + sizeof(FileHeader);
 		}
 		return nullptr;
 	}
 
 public:
+	static const uint64_t AnyCacheKey = 0;
+
 	bool IsMapped() const { return m_mapAddress != nullptr; }
-	
+
 protected:
-	static const UINT DefaultFileSize = 64;
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t headerSize;
+		uint64_t cacheKey;		// Adapter/driver identifier supplied by the owner of the cache.
+		uint32_t dataSize;
+		uint32_t dataCrc;		// CRC of the first checkedSize bytes of the data.
+		uint32_t checkedSize;
+		uint32_t headerCrc;		// CRC of all of the fields above.
+	};
+
+	static const uint32_t FileMagic = 0x43505344;	// "DSPC"
+	static const uint16_t FileVersion = 2;
+	static const uint32_t DefaultFileSize = 64;
+
+	// CRC-32 (IEEE 802.3), used to detect torn writes and on-disk corruption.
+	static uint32_t Crc32(const void* pData, size_t size);
+
+	FileHeader* GetHeader() const { return static_cast<FileHeader*>(m_mapAddress); }
+
+	bool Map(uint32_t size);
+	void Unmap();
+	bool Flush(size_t offset, size_t length);
+	bool Validate(const char** ppReason) const;
+	void WriteHeader(uint32_t dataSize, uint32_t checkedSize, uint32_t dataCrc);
+
+	// The file system calls an update can fail in. Tests override these to inject faults.
+	virtual bool FlushRange(void* pAddress, size_t length);
+	virtual bool SetFileSize(uint32_t size);
 
-	HANDLE m_mapFile;
-	HANDLE m_file;
-	LPVOID m_mapAddress;
+#ifdef _WIN32
+	void* m_mapFile;
+	void* m_file;
+#else
+	int m_file;
+#endif
+	void* m_mapAddress;
 	std::wstring m_filename;
 
-	UINT m_currentFileSize;
+	uint32_t m_currentFileSize;
+	uint64_t m_cacheKey;
 };
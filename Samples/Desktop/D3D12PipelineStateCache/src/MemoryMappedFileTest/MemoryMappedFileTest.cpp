@@ -0,0 +1,394 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Fault injection tests for MemoryMappedFile, the storage under both of the sample's caches.
+//
+//     MemoryMappedFileTest selftest
+//
+// Damages a scratch file the way a crash or a full disk would (torn header writes, truncation, abandoned updates,
+// corrupt data) and makes the file system calls an update depends on fail, then checks that reopening the file
+// gives back either the last committed data or an empty cache, never anything in between.
+//
+// The test writes MemoryMappedFileTest.scratch.cache in the current directory.
+// The exit code is 0 on success, 1 if any check fails and 2 for bad arguments.
+
+#include "../MemoryMappedFile.h"
+#include "../../../Shared/TestHarness.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+	const char* g_scratchFileName = "MemoryMappedFileTest.scratch.cache";
+	const uint64_t g_scratchCacheKey = 0x4D4D465445535431ull;
+
+	// Exposes the protected file operations and fails the next flush or resize on request.
+	class TestFile : public MemoryMappedFile
+	{
+	public:
+		TestFile() :
+			m_failFlushes(false),
+			m_failResizes(false)
+		{
+		}
+
+		using MemoryMappedFile::Init;
+		using MemoryMappedFile::Destroy;
+		using MemoryMappedFile::GrowMapping;
+		using MemoryMappedFile::ShrinkToFit;
+		using MemoryMappedFile::BeginUpdate;
+		using MemoryMappedFile::Commit;
+		using MemoryMappedFile::GetSize;
+		using MemoryMappedFile::GetCheckedSize;
+		using MemoryMappedFile::GetCapacity;
+		using MemoryMappedFile::GetData;
+
+		static const size_t HeaderSize = sizeof(FileHeader);
+
+		bool m_failFlushes;
+		bool m_failResizes;
+
+	protected:
+		bool FlushRange(void* pAddress, size_t length) override
+		{
+			return !m_failFlushes && MemoryMappedFile::FlushRange(pAddress, length);
+		}
+
+		bool SetFileSize(uint32_t size) override
+		{
+			return !m_failResizes && MemoryMappedFile::SetFileSize(size);
+		}
+	};
+
+	std::wstring Widen(const char* pString)
+	{
+		std::wstring wideString(strlen(pString) + 1, L'\0');
+		const size_t length = mbstowcs(&wideString[0], pString, wideString.size());
+		wideString.resize((length == static_cast<size_t>(-1)) ? 0 : length);
+		return wideString;
+	}
+
+	std::vector<uint8_t> MakeData(uint32_t seed, size_t size)
+	{
+		std::mt19937 generator(seed);
+		std::vector<uint8_t> data(size);
+		for (uint8_t& byte : data)
+		{
+			byte = static_cast<uint8_t>(generator());
+		}
+		return data;
+	}
+
+	// The file is only touched directly while it isn't open; on Windows the cache opens it without sharing.
+	std::vector<uint8_t> ReadScratchFile()
+	{
+		std::vector<uint8_t> contents;
+		FILE* pFile = fopen(g_scratchFileName, "rb");
+		if (pFile)
+		{
+			uint8_t buffer[4096];
+			size_t bytesRead;
+			while ((bytesRead = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+			{
+				contents.insert(contents.end(), buffer, buffer + bytesRead);
+			}
+			fclose(pFile);
+		}
+		return contents;
+	}
+
+	void WriteScratchFile(const std::vector<uint8_t>& contents)
+	{
+		FILE* pFile = fopen(g_scratchFileName, "wb");
+		if (pFile)
+		{
+			if (!contents.empty())
+			{
+				fwrite(contents.data(), 1, contents.size(), pFile);
+			}
+			fclose(pFile);
+		}
+	}
+
+	// Replaces the scratch file with one holding 'data', all of it covered by the data CRC unless told otherwise.
+	void WriteCommitted(const std::vector<uint8_t>& data, uint32_t checkedSize)
+	{
+		TestFile file;
+		remove(g_scratchFileName);
+		file.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+		file.GrowMapping(static_cast<uint32_t>(data.size()));
+		file.BeginUpdate();
+		memcpy(file.GetData(), data.data(), data.size());
+		Check(file.Commit(static_cast<uint32_t>(data.size()), checkedSize), "commits succeed without injected faults");
+		file.Destroy(false);
+	}
+
+	void WriteCommitted(const std::vector<uint8_t>& data)
+	{
+		WriteCommitted(data, static_cast<uint32_t>(data.size()));
+	}
+
+	// Returns true if the scratch file opens with exactly 'expected' as its data.
+	bool ReadsBackAs(const std::vector<uint8_t>& expected, uint64_t cacheKey = g_scratchCacheKey)
+	{
+		TestFile file;
+		file.Init(Widen(g_scratchFileName), cacheKey);
+		bool matches = file.IsMapped() && file.GetSize() == expected.size();
+		if (matches && !expected.empty())
+		{
+			matches = memcmp(file.GetData(), expected.data(), expected.size()) == 0;
+		}
+		file.Destroy(false);
+		return matches;
+	}
+
+	bool ReadsBackEmpty()
+	{
+		return ReadsBackAs(std::vector<uint8_t>());
+	}
+
+	void TestRoundTrip()
+	{
+		const std::vector<uint8_t> data = MakeData(1, 5000);
+		WriteCommitted(data);
+		Check(ReadsBackAs(data), "committed data reads back");
+		Check(ReadsBackAs(data, MemoryMappedFile::AnyCacheKey), "AnyCacheKey accepts whatever key the file was written with");
+		Check(ReadsBackAs(data), "opening with AnyCacheKey doesn't change the file's key");
+		Check(!ReadsBackAs(data, g_scratchCacheKey + 1), "a different cache key discards the data");
+		Check(ReadsBackEmpty(), "a file discarded for its key stays empty");
+	}
+
+	void TestTornHeader()
+	{
+		const std::vector<uint8_t> oldData = MakeData(2, 3000);
+		const std::vector<uint8_t> newData = MakeData(3, 2000);
+
+		// Capture the header BeginUpdate leaves behind, then the one a completed update publishes.
+		WriteCommitted(oldData);
+		{
+			TestFile file;
+			file.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+			file.BeginUpdate();
+			file.Destroy(false);
+		}
+		const std::vector<uint8_t> invalidated = ReadScratchFile();
+		const std::vector<uint8_t> emptyHeader(invalidated.begin(), invalidated.begin() + TestFile::HeaderSize);
+
+		WriteCommitted(newData);
+		const std::vector<uint8_t> committed = ReadScratchFile();
+		const std::vector<uint8_t> newHeader(committed.begin(), committed.begin() + TestFile::HeaderSize);
+
+		// A crash while the new header is being written leaves any prefix of it over the empty one.
+		bool allTornHeadersHandled = true;
+		for (size_t tornAt = 0; tornAt <= TestFile::HeaderSize; tornAt++)
+		{
+			std::vector<uint8_t> torn = committed;
+			memcpy(torn.data(), newHeader.data(), tornAt);
+			memcpy(torn.data() + tornAt, emptyHeader.data() + tornAt, TestFile::HeaderSize - tornAt);
+			WriteScratchFile(torn);
+
+			const bool complete = memcmp(torn.data(), newHeader.data(), TestFile::HeaderSize) == 0;
+			allTornHeadersHandled &= complete ? ReadsBackAs(newData) : ReadsBackEmpty();
+		}
+		Check(allTornHeadersHandled, "a torn header write reads back as empty or as the complete update");
+
+		bool allFlipsDetected = true;
+		for (size_t offset = 0; offset < TestFile::HeaderSize; offset++)
+		{
+			std::vector<uint8_t> corrupt = committed;
+			corrupt[offset] ^= 0x10;
+			WriteScratchFile(corrupt);
+			allFlipsDetected &= ReadsBackEmpty();
+		}
+		Check(allFlipsDetected, "a flipped bit anywhere in the header discards the file");
+	}
+
+	void TestTruncation()
+	{
+		const std::vector<uint8_t> data = MakeData(4, 6000);
+		WriteCommitted(data);
+		const std::vector<uint8_t> committed = ReadScratchFile();
+
+		const size_t truncatedSizes[] = { 0, 1, TestFile::HeaderSize / 2, TestFile::HeaderSize, TestFile::HeaderSize + 100, committed.size() - 1 };
+		bool allTruncationsDetected = true;
+		for (size_t size : truncatedSizes)
+		{
+			WriteScratchFile(std::vector<uint8_t>(committed.begin(), committed.begin() + size));
+			allTruncationsDetected &= ReadsBackEmpty();
+		}
+		Check(allTruncationsDetected, "truncated files read back as empty");
+
+		// Truncation followed by zero fill (mapping a short file extends it) must fail the data CRC, not the size check.
+		WriteScratchFile(std::vector<uint8_t>(committed.begin(), committed.begin() + TestFile::HeaderSize + 100));
+		{
+			TestFile file;
+			file.Init(Widen(g_scratchFileName), g_scratchCacheKey, static_cast<uint32_t>(committed.size()));
+			Check(file.IsMapped() && file.GetSize() == 0, "truncated files mapped at their old size read back as empty");
+			file.Destroy(false);
+		}
+	}
+
+	void TestAbandonedUpdate()
+	{
+		const std::vector<uint8_t> oldData = MakeData(5, 4000);
+		WriteCommitted(oldData);
+
+		TestFile file;
+		file.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+		Check(file.BeginUpdate(), "BeginUpdate succeeds without injected faults");
+		memset(file.GetData(), 0xCD, oldData.size() / 2);
+		file.Destroy(false);
+
+		Check(ReadsBackEmpty(), "an update that is never committed reads back as empty");
+	}
+
+	void TestCorruptData()
+	{
+		const std::vector<uint8_t> data = MakeData(6, 8000);
+		const uint32_t checkedSize = 1000;
+		WriteCommitted(data, checkedSize);
+		const std::vector<uint8_t> committed = ReadScratchFile();
+
+		std::vector<uint8_t> corrupt = committed;
+		corrupt[TestFile::HeaderSize + checkedSize - 1] ^= 0x01;
+		WriteScratchFile(corrupt);
+		Check(ReadsBackEmpty(), "corruption in the checked prefix discards the file");
+
+		// Past the checked prefix the owner verifies its own data, so the file is still handed over as it is.
+		corrupt = committed;
+		corrupt[TestFile::HeaderSize + checkedSize] ^= 0x01;
+		WriteScratchFile(corrupt);
+		std::vector<uint8_t> expected = data;
+		expected[checkedSize] ^= 0x01;
+		Check(ReadsBackAs(expected), "corruption past the checked prefix is left to the owner");
+	}
+
+	void TestFailedFlush()
+	{
+		const std::vector<uint8_t> oldData = MakeData(7, 3000);
+		const std::vector<uint8_t> newData = MakeData(8, 3500);
+
+		// An in-place update whose data can't be flushed must not be published.
+		WriteCommitted(oldData);
+		{
+			TestFile file;
+			file.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+			file.GrowMapping(static_cast<uint32_t>(newData.size()));
+			file.BeginUpdate();
+			memcpy(file.GetData(), newData.data(), newData.size());
+			file.m_failFlushes = true;
+			Check(!file.Commit(static_cast<uint32_t>(newData.size())), "Commit reports a failed data flush");
+			file.m_failFlushes = false;
+			Check(file.GetSize() == 0, "a failed commit doesn't publish the new size");
+			file.Destroy(false);
+		}
+		Check(ReadsBackEmpty(), "an in-place update that couldn't be flushed reads back as empty");
+
+		// Appends don't invalidate the header first, so a failed flush must leave the old header describing the old data.
+		WriteCommitted(oldData);
+		{
+			TestFile file;
+			file.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+			file.GrowMapping(static_cast<uint32_t>(oldData.size() + newData.size()));
+			memcpy(static_cast<uint8_t*>(file.GetData()) + oldData.size(), newData.data(), newData.size());
+			file.m_failFlushes = true;
+			Check(!file.Commit(static_cast<uint32_t>(oldData.size() + newData.size())), "Commit reports a failed flush of appended data");
+			file.m_failFlushes = false;
+			file.Destroy(false);
+		}
+		Check(ReadsBackAs(oldData), "an append that couldn't be flushed leaves the previous commit intact");
+
+		// Once the fault clears the same file takes updates again.
+		{
+			TestFile file;
+			file.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+			file.m_failFlushes = true;
+			Check(!file.BeginUpdate(), "BeginUpdate reports a failed flush");
+			file.m_failFlushes = false;
+			file.GrowMapping(static_cast<uint32_t>(newData.size()));
+			memcpy(file.GetData(), newData.data(), newData.size());
+			Check(file.Commit(static_cast<uint32_t>(newData.size())), "commits succeed once the fault clears");
+			file.Destroy(false);
+		}
+		Check(ReadsBackAs(newData), "updates after a failed flush read back");
+	}
+
+	void TestFailedResize()
+	{
+		const std::vector<uint8_t> data = MakeData(9, 2000);
+		WriteCommitted(data);
+
+		{
+			TestFile file;
+			file.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+			const uint32_t capacity = file.GetCapacity();
+
+			file.m_failResizes = true;
+			Check(!file.GrowMapping(capacity * 4), "GrowMapping reports a failed resize");
+			Check(file.IsMapped() && file.GetCapacity() == capacity, "a failed resize keeps the old mapping");
+			Check(file.GetSize() == data.size() && memcmp(file.GetData(), data.data(), data.size()) == 0,
+				"a failed resize keeps the committed data");
+			file.m_failResizes = false;
+
+			Check(file.GrowMapping(capacity * 4) && file.GetCapacity() >= capacity * 4, "the file grows once the fault clears");
+
+			// Shrinking back down can fail the same way; the file must stay usable at its current size.
+			const uint32_t grownCapacity = file.GetCapacity();
+			file.m_failResizes = true;
+			file.ShrinkToFit();
+			Check(file.IsMapped() && file.GetCapacity() == grownCapacity, "a failed truncation keeps the old mapping");
+			file.m_failResizes = false;
+			file.ShrinkToFit();
+			Check(file.IsMapped() && file.GetCapacity() < grownCapacity, "the file shrinks once the fault clears");
+			file.Destroy(false);
+		}
+		Check(ReadsBackAs(data), "failed resizes leave the committed data intact");
+
+		{
+			TestFile file;
+			remove(g_scratchFileName);
+			file.m_failResizes = true;
+			file.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+			Check(!file.IsMapped(), "a new file that can't be sized isn't mapped");
+			file.Destroy(false);
+		}
+		Check(ReadsBackEmpty(), "a file that couldn't be sized opens as empty later");
+	}
+
+	int RunSelfTest()
+	{
+		TestRoundTrip();
+		TestTornHeader();
+		TestTruncation();
+		TestAbandonedUpdate();
+		TestCorruptData();
+		TestFailedFlush();
+		TestFailedResize();
+		remove(g_scratchFileName);
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	static const TestHarness::Command commands[] =
+	{
+		{ "selftest", "", 0, [](int, char**) { return RunSelfTest(); } },
+	};
+	return TestHarness::RunCommand(argc, argv, "MemoryMappedFileTest", commands);
+}
@@ -0,0 +1,346 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Like MemoryMappedFile.cpp, this file doesn't use the precompiled header so that PSOArchiveTool can share it.
+#include "MemoryMappedPSOArchive.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	inline uint64_t Rotl64(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline uint64_t FMix64(uint64_t k)
+	{
+		k ^= k >> 33;
+		k *= 0xFF51AFD7ED558CCDull;
+		k ^= k >> 33;
+		k *= 0xC4CEB9FE1A85EC53ull;
+		k ^= k >> 33;
+		return k;
+	}
+
+	inline uint32_t AlignUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+MemoryMappedPSOArchive::Key MemoryMappedPSOArchive::ComputeKey(const void* pData, size_t size)
+{
+	const uint64_t c1 = 0x87C37B91114253D5ull;
+	const uint64_t c2 = 0x4CF5AD432745937Full;
+
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+	const size_t blockCount = size / 16;
+	uint64_t h1 = 0;
+	uint64_t h2 = 0;
+
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		uint64_t k1, k2;
+		memcpy(&k1, pBytes + i * 16, sizeof(k1));
+		memcpy(&k2, pBytes + i * 16 + 8, sizeof(k2));
+
+		k1 *= c1; k1 = Rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+		h1 = Rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52DCE729;
+
+		k2 *= c2; k2 = Rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		h2 = Rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495AB5;
+	}
+
+	// Fold in the last 0-15 bytes.
+	const uint8_t* pTail = pBytes + blockCount * 16;
+	const size_t tailSize = size & 15;
+	uint64_t k1 = 0;
+	uint64_t k2 = 0;
+	for (size_t i = tailSize; i > 8; i--)
+	{
+		k2 ^= static_cast<uint64_t>(pTail[i - 1]) << ((i - 9) * 8);
+	}
+	if (tailSize > 8)
+	{
+		k2 *= c2; k2 = Rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+	}
+	for (size_t i = (tailSize > 8) ? 8 : tailSize; i > 0; i--)
+	{
+		k1 ^= static_cast<uint64_t>(pTail[i - 1]) << ((i - 1) * 8);
+	}
+	if (tailSize > 0)
+	{
+		k1 *= c1; k1 = Rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+	}
+
+	h1 ^= size;
+	h2 ^= size;
+	h1 += h2;
+	h2 += h1;
+	h1 = FMix64(h1);
+	h2 = FMix64(h2);
+	h1 += h2;
+	h2 += h1;
+
+	Key key = { { h1, h2 } };
+	return key;
+}
+
+void MemoryMappedPSOArchive::Init(std::wstring filename, uint64_t cacheKey)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	MemoryMappedFile::Init(filename, cacheKey);
+	if (IsMapped() && !IsValidArchive())
+	{
+		// The file is new or was discarded, or its table doesn't make sense. Start with an empty table.
+		Rebuild(InitialSlotCount);
+	}
+}
+
+void MemoryMappedPSOArchive::Destroy(bool deleteFile)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	MemoryMappedFile::Destroy(deleteFile);
+}
+
+bool MemoryMappedPSOArchive::Lookup(const Key& key, std::vector<uint8_t>& blob)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!IsMapped())
+	{
+		return false;
+	}
+
+	const IndexSlot* pSlot = FindSlot(key);
+	if (pSlot->offset == 0 || !IsValidEntry(*pSlot))
+	{
+		return false;
+	}
+
+	const uint8_t* pBlob = static_cast<const uint8_t*>(GetData()) + pSlot->offset;
+	blob.assign(pBlob, pBlob + pSlot->size);
+	return true;
+}
+
+void MemoryMappedPSOArchive::Insert(const Key& key, const void* pBlob, size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!IsMapped() || !pBlob || size == 0)
+	{
+		return;
+	}
+
+	if (FindSlot(key)->offset == 0 && (GetArchiveHeader()->entryCount + 1) * 2 > GetArchiveHeader()->slotCount)
+	{
+		// Keep the table at most half full so that probe sequences stay short.
+		Rebuild(GetArchiveHeader()->slotCount * 2);
+	}
+
+	const uint32_t offset = AlignUp(GetSize(), BlobAlignment);
+	if (static_cast<uint64_t>(offset) + size > UINT32_MAX - sizeof(FileHeader))
+	{
+		// The archive is limited to 4GB.
+		return;
+	}
+
+	const uint32_t newSize = offset + static_cast<uint32_t>(size);
+	GrowMapping(newSize);
+	if (GetCapacity() < newSize)
+	{
+		return;
+	}
+
+	// Append the blob past the committed data, then point the table at it. The mapping may have moved.
+	memcpy(static_cast<uint8_t*>(GetData()) + offset, pBlob, size);
+
+	IndexSlot* pSlot = FindSlot(key);
+	if (pSlot->offset == 0)
+	{
+		GetArchiveHeader()->entryCount++;
+	}
+	pSlot->key = key;
+	pSlot->offset = offset;
+	pSlot->size = static_cast<uint32_t>(size);
+	pSlot->crc = Crc32(pBlob, size);
+	pSlot->reserved = 0;
+
+	MemoryMappedFile::Commit(newSize, GetTableSize(GetArchiveHeader()->slotCount));
+}
+
+void MemoryMappedPSOArchive::Compact()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (IsMapped())
+	{
+		Rebuild(InitialSlotCount);
+		MemoryMappedFile::ShrinkToFit();
+	}
+}
+
+MemoryMappedPSOArchive::Stats MemoryMappedPSOArchive::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Stats stats = {};
+	if (IsMapped())
+	{
+		const uint32_t slotCount = GetArchiveHeader()->slotCount;
+		const IndexSlot* pSlots = GetSlots();
+		for (uint32_t i = 0; i < slotCount; i++)
+		{
+			if (pSlots[i].offset != 0 && IsValidEntry(pSlots[i]))
+			{
+				stats.entryCount++;
+				stats.liveBytes += pSlots[i].size;
+			}
+		}
+
+		stats.slotCount = slotCount;
+		stats.staleBytes = GetSize() - GetTableSize(slotCount) - stats.liveBytes;
+		stats.fileSize = m_currentFileSize;
+	}
+	return stats;
+}
+
+bool MemoryMappedPSOArchive::IsValidArchive()
+{
+	if (GetSize() < sizeof(ArchiveHeader))
+	{
+		return false;
+	}
+
+	const ArchiveHeader* pHeader = GetArchiveHeader();
+	const uint32_t slotCount = pHeader->slotCount;
+	if (pHeader->magic != ArchiveMagic ||
+		slotCount == 0 || (slotCount & (slotCount - 1)) != 0 ||
+		slotCount > (UINT32_MAX - sizeof(ArchiveHeader)) / sizeof(IndexSlot))
+	{
+		return false;
+	}
+
+	// The table is covered by the file's CRC, but only if it was committed as the checked part of the data.
+	const uint32_t tableSize = GetTableSize(slotCount);
+	if (GetCheckedSize() != tableSize)
+	{
+		return false;
+	}
+
+	const IndexSlot* pSlots = GetSlots();
+	for (uint32_t i = 0; i < slotCount; i++)
+	{
+		const IndexSlot& slot = pSlots[i];
+		if (slot.offset != 0 && (slot.offset < tableSize || slot.offset > GetSize() || slot.size > GetSize() - slot.offset))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool MemoryMappedPSOArchive::IsValidEntry(const IndexSlot& slot)
+{
+	return Crc32(static_cast<const uint8_t*>(GetData()) + slot.offset, slot.size) == slot.crc;
+}
+
+// Returns the slot holding 'key', or the empty slot where it would be inserted.
+MemoryMappedPSOArchive::IndexSlot* MemoryMappedPSOArchive::FindSlot(const Key& key)
+{
+	const uint32_t mask = GetArchiveHeader()->slotCount - 1;
+	IndexSlot* pSlots = GetSlots();
+
+	// The table is never more than half full, so this always terminates.
+	for (uint32_t i = static_cast<uint32_t>(key.hash[0]) & mask; ; i = (i + 1) & mask)
+	{
+		if (pSlots[i].offset == 0 || pSlots[i].key == key)
+		{
+			return &pSlots[i];
+		}
+	}
+}
+
+void MemoryMappedPSOArchive::Rebuild(uint32_t slotCount)
+{
+	struct Entry
+	{
+		Key key;
+		uint32_t crc;
+		std::vector<uint8_t> data;
+	};
+
+	// Copy the live entries out first; the mapping may move when it grows.
+	std::vector<Entry> entries;
+	if (IsValidArchive())
+	{
+		const uint32_t oldSlotCount = GetArchiveHeader()->slotCount;
+		const IndexSlot* pSlots = GetSlots();
+		for (uint32_t i = 0; i < oldSlotCount; i++)
+		{
+			const IndexSlot& slot = pSlots[i];
+			if (slot.offset != 0 && IsValidEntry(slot))
+			{
+				const uint8_t* pBlob = static_cast<const uint8_t*>(GetData()) + slot.offset;
+				entries.push_back({ slot.key, slot.crc, std::vector<uint8_t>(pBlob, pBlob + slot.size) });
+			}
+		}
+	}
+
+	while (entries.size() * 2 > slotCount)
+	{
+		slotCount *= 2;
+	}
+
+	const uint32_t tableSize = GetTableSize(slotCount);
+	uint32_t newSize = tableSize;
+	for (const Entry& entry : entries)
+	{
+		newSize = AlignUp(newSize, BlobAlignment) + static_cast<uint32_t>(entry.data.size());
+	}
+
+	GrowMapping(newSize);
+	if (GetCapacity() < newSize)
+	{
+		return;
+	}
+
+	// The table and blobs are rewritten in place, so the file must read back as empty if we crash part way through.
+	MemoryMappedFile::BeginUpdate();
+
+	memset(GetData(), 0, tableSize);
+	ArchiveHeader* pHeader = GetArchiveHeader();
+	pHeader->magic = ArchiveMagic;
+	pHeader->slotCount = slotCount;
+	pHeader->entryCount = static_cast<uint32_t>(entries.size());
+
+	uint32_t offset = tableSize;
+	for (const Entry& entry : entries)
+	{
+		offset = AlignUp(offset, BlobAlignment);
+		memcpy(static_cast<uint8_t*>(GetData()) + offset, entry.data.data(), entry.data.size());
+
+		IndexSlot* pSlot = FindSlot(entry.key);
+		pSlot->key = entry.key;
+		pSlot->offset = offset;
+		pSlot->size = static_cast<uint32_t>(entry.data.size());
+		pSlot->crc = entry.crc;
+
+		offset += pSlot->size;
+	}
+
+	MemoryMappedFile::Commit(offset, tableSize);
+}
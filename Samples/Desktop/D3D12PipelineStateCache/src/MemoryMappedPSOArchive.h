@@ -0,0 +1,96 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include "MemoryMappedFile.h"
+#include <mutex>
+#include <vector>
+
+// Native, hardware-specific, PSO cache holding many Cached Blobs in a single file.
+//
+// The file starts with an open addressed hash table keyed by a 128-bit hash of everything that went into the PSO
+// (see PSOLibrary::GetPSOKey), followed by the blobs themselves. Inserts append a blob and then update the table, so
+// opening the archive only validates the table; each blob is checked against its own CRC when it's looked up.
+// Re-inserting a key leaves the old blob behind as a stale entry, which Compact() (or PSOArchiveTool) removes.
+//
+// All of the public methods are thread safe.
+class MemoryMappedPSOArchive : public MemoryMappedFile
+{
+public:
+	struct Key
+	{
+		uint64_t hash[2];
+
+		bool operator==(const Key& other) const { return hash[0] == other.hash[0] && hash[1] == other.hash[1]; }
+		bool operator!=(const Key& other) const { return !(*this == other); }
+	};
+
+	struct Stats
+	{
+		uint32_t entryCount;
+		uint32_t slotCount;
+		uint32_t liveBytes;		// Bytes of blob data referenced by the table.
+		uint32_t staleBytes;	// Bytes of blob data that are no longer referenced, or are corrupt.
+		uint32_t fileSize;
+	};
+
+	// 128-bit MurmurHash3 (x64 variant).
+	static Key ComputeKey(const void* pData, size_t size);
+
+	void Init(std::wstring filename, uint64_t cacheKey);
+	void Destroy(bool deleteFile);
+
+	// Copies the blob stored for 'key' into 'blob'. The copy is needed because an insert on another thread may move
+	// the mapping. Returns false if there's no entry for the key or the entry is corrupt.
+	bool Lookup(const Key& key, std::vector<uint8_t>& blob);
+
+	// Appends a blob for 'key', replacing any existing entry.
+	void Insert(const Key& key, const void* pBlob, size_t size);
+
+	// Rewrites the archive without stale or corrupt entries and truncates the file to fit.
+	void Compact();
+
+	Stats GetStats();
+
+private:
+	struct ArchiveHeader
+	{
+		uint32_t magic;
+		uint32_t slotCount;		// Power of 2.
+		uint32_t entryCount;
+		uint32_t reserved;
+	};
+
+	struct IndexSlot
+	{
+		Key key;
+		uint32_t offset;		// Offset of the blob from the start of the data. 0 marks an empty slot.
+		uint32_t size;
+		uint32_t crc;
+		uint32_t reserved;
+	};
+
+	static const uint32_t ArchiveMagic = 0x48435241;	// "ARCH"
+	static const uint32_t InitialSlotCount = 64;
+	static const uint32_t BlobAlignment = 16;
+
+	static uint32_t GetTableSize(uint32_t slotCount) { return sizeof(ArchiveHeader) + slotCount * sizeof(IndexSlot); }
+
+	ArchiveHeader* GetArchiveHeader() { return static_cast<ArchiveHeader*>(GetData()); }
+	IndexSlot* GetSlots() { return reinterpret_cast<IndexSlot*>(GetArchiveHeader() + 1); }
+	bool IsValidArchive();
+	bool IsValidEntry(const IndexSlot& slot);
+	IndexSlot* FindSlot(const Key& key);
+	void Rebuild(uint32_t slotCount);
+
+	std::mutex m_mutex;
+};
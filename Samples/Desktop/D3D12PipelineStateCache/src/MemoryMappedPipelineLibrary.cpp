@@ -16,7 +16,7 @@
 using std::wstring;
 using Microsoft::WRL::ComPtr;
 
-bool MemoryMappedPipelineLibrary::Init(ID3D12Device* pDevice, std::wstring filename)
+bool MemoryMappedPipelineLibrary::Init(ID3D12Device* pDevice, std::wstring filename, uint64_t cacheKey)
 {
 	// ID3D12PipelineLibrary usage requires OS and driver support.
 	//		- Pipeline Libraries require the ID3D12Device1 interface (OS support).
@@ -32,8 +32,8 @@ bool MemoryMappedPipelineLibrary::Init(ID3D12Device* pDevice, std::wstring filen
 		ComPtr<ID3D12Device1> device1;
 		if (SUCCEEDED(pDevice->QueryInterface(IID_PPV_ARGS(&device1))))
 		{
-			// Init the memory mapped file.
-			MemoryMappedFile::Init(filename);
+			// Init the memory mapped file. A file that is corrupt or was built for another adapter or driver comes back empty.
+			MemoryMappedFile::Init(filename, cacheKey);
 
 			// Create a Pipeline Library from the serialized blob.
 			// Note: The provided Library Blob must remain valid for the lifetime of the object returned - for efficiency, the data is not copied.
@@ -47,7 +47,7 @@ bool MemoryMappedPipelineLibrary::Init(ID3D12Device* pDevice, std::wstring filen
 			case D3D12_ERROR_ADAPTER_NOT_FOUND: // The provided Library contains data for different hardware (Don't really need to clear the cache, could have a cache per adapter).
 			case D3D12_ERROR_DRIVER_VERSION_MISMATCH: // The provided Library contains data from an old driver or runtime. We need to re-create it.
 				MemoryMappedFile::Destroy(true);
-				MemoryMappedFile::Init(filename);
+				MemoryMappedFile::Init(filename, cacheKey);
 				ThrowIfFailed(device1->CreatePipelineLibrary(GetData(), GetSize(), IID_PPV_ARGS(&m_pipelineLibrary)));
 				break;
 
@@ -77,8 +77,7 @@ void MemoryMappedPipelineLibrary::Destroy(bool deleteFile)
 		if (librarySize > 0)
 		{
 			// Grow the file if needed.
-			const size_t neededSize = sizeof(UINT) + librarySize;
-			if (neededSize > m_currentFileSize)
+			if (librarySize > GetCapacity())
 			{
 				// The file mapping is going to change thus it will invalidate the ID3D12PipelineLibrary object.
 				// Serialize the library contents to temporary memory first.
@@ -90,9 +89,13 @@ void MemoryMappedPipelineLibrary::Destroy(bool deleteFile)
 					// Now it's safe to grow the mapping.
 					MemoryMappedFile::GrowMapping(librarySize);
 
-					// Save the size of the library and the library itself.
-					memcpy(GetData(), pTempData, librarySize);
-					MemoryMappedFile::SetSize(librarySize);
+					// Save the library itself, and then commit its size and checksum.
+					if (librarySize <= GetCapacity())
+					{
+						MemoryMappedFile::BeginUpdate();
+						memcpy(GetData(), pTempData, librarySize);
+						MemoryMappedFile::Commit(librarySize);
+					}
 
 					delete[] pTempData;
 					pTempData = nullptr;
@@ -101,10 +104,10 @@ void MemoryMappedPipelineLibrary::Destroy(bool deleteFile)
 			else
 			{
 				// The mapping didn't change, we can serialize directly to the mapped file.
-				// Save the size of the library and the library itself.
-				assert(neededSize <= m_currentFileSize);
+				// Save the library itself, and then commit its size and checksum.
+				MemoryMappedFile::BeginUpdate();
 				ThrowIfFailed(m_pipelineLibrary->Serialize(GetData(), librarySize));
-				MemoryMappedFile::SetSize(librarySize);
+				MemoryMappedFile::Commit(librarySize);
 			}
 
 			// m_pipelineLibrary is now undefined because we just wrote to the mapped file, don't use it again.
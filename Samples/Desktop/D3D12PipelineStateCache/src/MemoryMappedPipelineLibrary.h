@@ -18,7 +18,7 @@
 class MemoryMappedPipelineLibrary : public MemoryMappedFile
 {
 public:
-	bool Init(ID3D12Device* pDevice, std::wstring filename);
+	bool Init(ID3D12Device* pDevice, std::wstring filename, uint64_t cacheKey);
 	void Destroy(bool deleteFile);
 	
 	ID3D12PipelineLibrary* GetPipelineLibrary() { return m_pipelineLibrary.Get(); }
@@ -0,0 +1,281 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Offline maintenance for the sample's PSO archive (psoArchive.cache).
+//
+//     PSOArchiveTool stats <archive>        Print entry counts and how much of the file is stale.
+//     PSOArchiveTool compact <archive>      Drop stale and corrupt entries and truncate the file.
+//     PSOArchiveTool selftest               Exercise inserts, lookups, corruption and compaction on a scratch archive.
+//     PSOArchiveTool benchmark [entries]    Time opening an archive and looking up every entry in it.
+//
+// Both selftest and benchmark write PSOArchiveTool.scratch.cache in the current directory.
+// The exit code is 0 on success, 1 if the self test fails and 2 for bad arguments.
+
+#include "../MemoryMappedPSOArchive.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char* g_scratchFileName = "PSOArchiveTool.scratch.cache";
+	const uint64_t g_scratchCacheKey = 0x5053304152434831ull;
+
+	// Exposes the archive's protected file operations to the tool.
+	class ToolArchive : public MemoryMappedPSOArchive
+	{
+	public:
+		uint32_t GetDataSize() const { return GetSize(); }
+		uint8_t* GetRawData() { return static_cast<uint8_t*>(GetData()); }
+	};
+
+	std::wstring Widen(const char* pString)
+	{
+		std::wstring wideString(strlen(pString) + 1, L'\0');
+		const size_t length = mbstowcs(&wideString[0], pString, wideString.size());
+		wideString.resize((length == static_cast<size_t>(-1)) ? 0 : length);
+		return wideString;
+	}
+
+	MemoryMappedPSOArchive::Key MakeKey(uint32_t index)
+	{
+		return MemoryMappedPSOArchive::ComputeKey(&index, sizeof(index));
+	}
+
+	// Fills a blob with bytes derived from the entry's index and version so that lookups can be checked.
+	std::vector<uint8_t> MakeBlob(uint32_t index, uint32_t version, size_t size)
+	{
+		std::mt19937 generator(index * 7919u + version);
+		std::vector<uint8_t> blob(size);
+		for (uint8_t& byte : blob)
+		{
+			byte = static_cast<uint8_t>(generator());
+		}
+		return blob;
+	}
+
+	size_t BlobSize(uint32_t index)
+	{
+		// Roughly the range of sizes drivers return for cached PSOs.
+		return 1024 + (index * 2654435761u) % 7168;
+	}
+
+	void PrintStats(MemoryMappedPSOArchive& archive)
+	{
+		const MemoryMappedPSOArchive::Stats stats = archive.GetStats();
+		printf("entries:     %u (%u slots)\n", stats.entryCount, stats.slotCount);
+		printf("live bytes:  %u\n", stats.liveBytes);
+		printf("stale bytes: %u\n", stats.staleBytes);
+		printf("file size:   %u\n", stats.fileSize);
+	}
+
+	int Stats(const char* pFileName)
+	{
+		MemoryMappedPSOArchive archive;
+		archive.Init(Widen(pFileName), MemoryMappedPSOArchive::AnyCacheKey);
+		if (!archive.IsMapped())
+		{
+			fprintf(stderr, "Couldn't open %s.\n", pFileName);
+			return 2;
+		}
+
+		PrintStats(archive);
+		archive.Destroy(false);
+		return 0;
+	}
+
+	int Compact(const char* pFileName)
+	{
+		MemoryMappedPSOArchive archive;
+		archive.Init(Widen(pFileName), MemoryMappedPSOArchive::AnyCacheKey);
+		if (!archive.IsMapped())
+		{
+			fprintf(stderr, "Couldn't open %s.\n", pFileName);
+			return 2;
+		}
+
+		const MemoryMappedPSOArchive::Stats before = archive.GetStats();
+		archive.Compact();
+		const MemoryMappedPSOArchive::Stats after = archive.GetStats();
+		printf("Compacted %u entries: %u -> %u bytes.\n", after.entryCount, before.fileSize, after.fileSize);
+
+		archive.Destroy(false);
+		return 0;
+	}
+
+	int SelfTest()
+	{
+		int failures = 0;
+		auto check = [&failures](bool condition, const char* pDescription)
+		{
+			if (!condition)
+			{
+				printf("FAILED: %s\n", pDescription);
+				failures++;
+			}
+		};
+
+		const uint32_t entryCount = 500;
+		std::vector<uint8_t> blob;
+
+		{
+			ToolArchive archive;
+			remove(g_scratchFileName);
+			archive.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+			check(archive.IsMapped(), "the scratch archive can be created");
+
+			for (uint32_t i = 0; i < entryCount; i++)
+			{
+				const std::vector<uint8_t> data = MakeBlob(i, 0, BlobSize(i));
+				archive.Insert(MakeKey(i), data.data(), data.size());
+			}
+
+			// Replace every tenth entry, leaving the original blobs behind as stale data.
+			for (uint32_t i = 0; i < entryCount; i += 10)
+			{
+				const std::vector<uint8_t> data = MakeBlob(i, 1, BlobSize(i) / 2);
+				archive.Insert(MakeKey(i), data.data(), data.size());
+			}
+
+			check(!archive.Lookup(MakeKey(entryCount), blob), "lookups of missing keys fail");
+			archive.Destroy(false);
+		}
+
+		{
+			ToolArchive archive;
+			archive.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+
+			bool allFound = true;
+			for (uint32_t i = 0; i < entryCount; i++)
+			{
+				const uint32_t version = (i % 10 == 0) ? 1 : 0;
+				const size_t size = (version == 1) ? BlobSize(i) / 2 : BlobSize(i);
+				allFound &= archive.Lookup(MakeKey(i), blob) && blob == MakeBlob(i, version, size);
+			}
+			check(allFound, "every entry reads back after reopening");
+
+			const MemoryMappedPSOArchive::Stats stats = archive.GetStats();
+			check(stats.entryCount == entryCount, "replaced entries aren't counted twice");
+			check(stats.staleBytes > 0, "replaced entries leave stale data");
+
+			// Flip a byte in the middle of the blob for entry 1; it's found by looking for its contents.
+			const std::vector<uint8_t> victim = MakeBlob(1, 0, BlobSize(1));
+			uint8_t* pData = archive.GetRawData();
+			for (uint32_t offset = 0; offset + victim.size() <= archive.GetDataSize(); offset++)
+			{
+				if (memcmp(pData + offset, victim.data(), victim.size()) == 0)
+				{
+					pData[offset + victim.size() / 2] ^= 0xFF;
+					break;
+				}
+			}
+			check(!archive.Lookup(MakeKey(1), blob), "corrupt entries aren't returned");
+			check(archive.Lookup(MakeKey(2), blob), "corrupting one entry doesn't affect the others");
+
+			archive.Compact();
+			const MemoryMappedPSOArchive::Stats compacted = archive.GetStats();
+			check(compacted.entryCount == entryCount - 1, "compaction drops the corrupt entry");
+			check(compacted.staleBytes < 16 * compacted.entryCount, "compaction leaves nothing but alignment padding");
+			check(compacted.fileSize < stats.fileSize, "compaction shrinks the file");
+			archive.Destroy(false);
+		}
+
+		{
+			ToolArchive archive;
+			archive.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+			check(archive.Lookup(MakeKey(20), blob) && blob == MakeBlob(20, 1, BlobSize(20) / 2), "compacted archives read back");
+			archive.Destroy(false);
+
+			archive.Init(Widen(g_scratchFileName), g_scratchCacheKey + 1);
+			check(archive.GetStats().entryCount == 0, "archives built for another adapter or driver are discarded");
+			archive.Destroy(true);
+		}
+
+		printf("%s\n", failures ? "Self test failed." : "Self test passed.");
+		return failures ? 1 : 0;
+	}
+
+	int Benchmark(uint32_t entryCount)
+	{
+		{
+			MemoryMappedPSOArchive archive;
+			remove(g_scratchFileName);
+			archive.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+			for (uint32_t i = 0; i < entryCount; i++)
+			{
+				const std::vector<uint8_t> data = MakeBlob(i, 0, BlobSize(i));
+				archive.Insert(MakeKey(i), data.data(), data.size());
+			}
+			archive.Destroy(false);
+		}
+
+		typedef std::chrono::steady_clock Clock;
+		const Clock::time_point start = Clock::now();
+
+		MemoryMappedPSOArchive archive;
+		archive.Init(Widen(g_scratchFileName), g_scratchCacheKey);
+		const Clock::time_point opened = Clock::now();
+
+		std::vector<uint8_t> blob;
+		uint32_t found = 0;
+		for (uint32_t i = 0; i < entryCount; i++)
+		{
+			found += archive.Lookup(MakeKey(i), blob) ? 1 : 0;
+		}
+		const Clock::time_point finished = Clock::now();
+
+		const MemoryMappedPSOArchive::Stats stats = archive.GetStats();
+		archive.Destroy(true);
+
+		const double openMs = std::chrono::duration<double, std::milli>(opened - start).count();
+		const double lookupMs = std::chrono::duration<double, std::milli>(finished - opened).count();
+		printf("Archive of %u entries, %u bytes.\n", entryCount, stats.fileSize);
+		printf("open:    %8.3f ms\n", openMs);
+		printf("lookups: %8.3f ms (%u found, %.3f us each)\n", lookupMs, found, lookupMs * 1000.0 / entryCount);
+		return (found == entryCount) ? 0 : 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 3 && strcmp(argv[1], "stats") == 0)
+	{
+		return Stats(argv[2]);
+	}
+	if (argc == 3 && strcmp(argv[1], "compact") == 0)
+	{
+		return Compact(argv[2]);
+	}
+	if (argc == 2 && strcmp(argv[1], "selftest") == 0)
+	{
+		return SelfTest();
+	}
+	if ((argc == 2 || argc == 3) && strcmp(argv[1], "benchmark") == 0)
+	{
+		const int entryCount = (argc == 3) ? atoi(argv[2]) : 10000;
+		if (entryCount > 0)
+		{
+			return Benchmark(static_cast<uint32_t>(entryCount));
+		}
+	}
+
+	fprintf(stderr,
+		"Usage: PSOArchiveTool stats <archive>\n"
+		"       PSOArchiveTool compact <archive>\n"
+		"       PSOArchiveTool selftest\n"
+		"       PSOArchiveTool benchmark [entries]\n");
+	return 2;
+}
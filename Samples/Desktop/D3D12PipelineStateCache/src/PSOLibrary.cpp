@@ -60,15 +60,144 @@ void PSOLibrary::WaitForThreads()
 	}
 }
 
-void PSOLibrary::Build(ID3D12Device* pDevice, ID3D12RootSignature* pRootSignature)
+// Identifies the adapter and the version of its user mode driver. Cached blobs and pipeline libraries are only
+// valid for the hardware and driver that produced them.
+UINT64 PSOLibrary::GetCacheKey(ID3D12Device* pDevice)
 {
-	// Initialize all cache file mappings (file may be empty).
-	m_pipelineLibrariesSupported = m_pipelineLibrary.Init(pDevice, m_cachePath + g_cPipelineLibraryFileName);
-	for (UINT i = 0; i < EffectPipelineTypeCount; i++)
+	DXGI_ADAPTER_DESC1 desc = {};
+	LARGE_INTEGER umdVersion = {};
+
+	ComPtr<IDXGIFactory4> factory;
+	ComPtr<IDXGIAdapter1> adapter;
+	if (SUCCEEDED(CreateDXGIFactory1(IID_PPV_ARGS(&factory))) &&
+		SUCCEEDED(factory->EnumAdapterByLuid(pDevice->GetAdapterLuid(), IID_PPV_ARGS(&adapter))))
+	{
+		adapter->GetDesc1(&desc);
+		adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &umdVersion);
+	}
+
+	// FNV-1a over the identifying values.
+	const UINT values[] = { desc.VendorId, desc.DeviceId, desc.SubSysId, desc.Revision, umdVersion.LowPart, static_cast<UINT>(umdVersion.HighPart) };
+	UINT64 key = 14695981039346656037ull;
+	for (UINT value : values)
+	{
+		for (UINT byte = 0; byte < sizeof(value); byte++)
+		{
+			key ^= (value >> (byte * 8)) & 0xFF;
+			key *= 1099511628211ull;
+		}
+	}
+	return key;
+}
+
+// Hashes everything in the desc that affects the compiled PSO, following pointers to shader bytecode and layouts.
+// The root signature can't be read back from the object; the driver rejects a cached blob built with a different one,
+// which CompilePSO handles like any other stale entry.
+MemoryMappedPSOArchive::Key PSOLibrary::GetPSOKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+	std::vector<BYTE> stream;
+	auto append = [&stream](const void* pData, size_t size)
+	{
+		const BYTE* pBytes = static_cast<const BYTE*>(pData);
+		stream.insert(stream.end(), pBytes, pBytes + size);
+	};
+	auto appendValue = [&append](const auto& value)
+	{
+		append(&value, sizeof(value));
+	};
+	auto appendString = [&append](LPCSTR pString)
+	{
+		append(pString, pString ? strlen(pString) + 1 : 0);
+	};
+	auto appendShader = [&append, &appendValue](const D3D12_SHADER_BYTECODE& shader)
+	{
+		appendValue(shader.BytecodeLength);
+		append(shader.pShaderBytecode, shader.BytecodeLength);
+	};
+
+	appendShader(desc.VS);
+	appendShader(desc.PS);
+	appendShader(desc.DS);
+	appendShader(desc.HS);
+	appendShader(desc.GS);
+
+	appendValue(desc.StreamOutput.NumEntries);
+	for (UINT i = 0; i < desc.StreamOutput.NumEntries; i++)
+	{
+		const D3D12_SO_DECLARATION_ENTRY& entry = desc.StreamOutput.pSODeclaration[i];
+		appendValue(entry.Stream);
+		appendString(entry.SemanticName);
+		appendValue(entry.SemanticIndex);
+		appendValue(entry.StartComponent);
+		appendValue(entry.ComponentCount);
+		appendValue(entry.OutputSlot);
+	}
+	appendValue(desc.StreamOutput.NumStrides);
+	append(desc.StreamOutput.pBufferStrides, desc.StreamOutput.NumStrides * sizeof(UINT));
+	appendValue(desc.StreamOutput.RasterizedStream);
+
+	appendValue(desc.InputLayout.NumElements);
+	for (UINT i = 0; i < desc.InputLayout.NumElements; i++)
+	{
+		const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+		appendString(element.SemanticName);
+		appendValue(element.SemanticIndex);
+		appendValue(element.Format);
+		appendValue(element.InputSlot);
+		appendValue(element.AlignedByteOffset);
+		appendValue(element.InputSlotClass);
+		appendValue(element.InstanceDataStepRate);
+	}
+
+	// The blend and depth stencil descs have UINT8 members followed by padding, so they're hashed a field at a time.
+	appendValue(desc.BlendState.AlphaToCoverageEnable);
+	appendValue(desc.BlendState.IndependentBlendEnable);
+	for (const D3D12_RENDER_TARGET_BLEND_DESC& renderTarget : desc.BlendState.RenderTarget)
 	{
-		m_diskCaches[i].Init(m_cachePath + g_cCacheFileNames[i]);
+		appendValue(renderTarget.BlendEnable);
+		appendValue(renderTarget.LogicOpEnable);
+		appendValue(renderTarget.SrcBlend);
+		appendValue(renderTarget.DestBlend);
+		appendValue(renderTarget.BlendOp);
+		appendValue(renderTarget.SrcBlendAlpha);
+		appendValue(renderTarget.DestBlendAlpha);
+		appendValue(renderTarget.BlendOpAlpha);
+		appendValue(renderTarget.LogicOp);
+		appendValue(renderTarget.RenderTargetWriteMask);
 	}
 
+	appendValue(desc.DepthStencilState.DepthEnable);
+	appendValue(desc.DepthStencilState.DepthWriteMask);
+	appendValue(desc.DepthStencilState.DepthFunc);
+	appendValue(desc.DepthStencilState.StencilEnable);
+	appendValue(desc.DepthStencilState.StencilReadMask);
+	appendValue(desc.DepthStencilState.StencilWriteMask);
+	appendValue(desc.DepthStencilState.FrontFace);
+	appendValue(desc.DepthStencilState.BackFace);
+
+	// The rest of the state is made up of 4 byte fields.
+	appendValue(desc.SampleMask);
+	appendValue(desc.RasterizerState);
+	appendValue(desc.IBStripCutValue);
+	appendValue(desc.PrimitiveTopologyType);
+	appendValue(desc.NumRenderTargets);
+	appendValue(desc.RTVFormats);
+	appendValue(desc.DSVFormat);
+	appendValue(desc.SampleDesc);
+	appendValue(desc.NodeMask);
+	appendValue(desc.Flags);
+
+	return MemoryMappedPSOArchive::ComputeKey(stream.data(), stream.size());
+}
+
+void PSOLibrary::Build(ID3D12Device* pDevice, ID3D12RootSignature* pRootSignature)
+{
+	// Initialize all cache file mappings (file may be empty).
+	// Files built for a different adapter or driver are discarded when they're mapped.
+	const UINT64 cacheKey = GetCacheKey(pDevice);
+	m_pipelineLibrariesSupported = m_pipelineLibrary.Init(pDevice, m_cachePath + g_cPipelineLibraryFileName, cacheKey);
+	m_diskCache.Init(m_cachePath + g_cPSOArchiveFileName, cacheKey);
+
 	// Use Pipeline Libraries for PSO Caching, if available.
 	if (!m_pipelineLibrariesSupported)
 	{
@@ -247,41 +376,33 @@ void PSOLibrary::CompilePSO(CompilePSOThreadData* pDataPackage)
 	else if (useCache && 
 		(pLibrary->m_psoCachingMechanism == PSOCachingMechanism::CachedBlobs))
 	{
-		// Read how long the cached shader blob is.
-		assert(pLibrary->m_diskCaches[type].IsMapped());
-		size_t size = pLibrary->m_diskCaches[type].GetCachedBlobSize();
+		// Look the PSO up in the archive by the hash of its description.
+		assert(pLibrary->m_diskCache.IsMapped());
+		const MemoryMappedPSOArchive::Key key = GetPSOKey(baseDesc);
 
-		// If the size if 0 then this disk cache needs to be refreshed.
-		if (size == 0)
+		HRESULT hr = E_FAIL;
+		std::vector<uint8_t> cachedBlob;
+		if (pLibrary->m_diskCache.Lookup(key, cachedBlob))
 		{
-			ThrowIfFailed(pDevice->CreateGraphicsPipelineState(&baseDesc, IID_PPV_ARGS(&pLibrary->m_pipelineStates[type])));
-
-			ComPtr<ID3DBlob> blob;
-			pLibrary->m_pipelineStates[type]->GetCachedBlob(&blob);
-			pLibrary->m_diskCaches[type].Update(blob.Get());
+			// Use the blob data from disk to avoid compiling it.
+			baseDesc.CachedPSO.pCachedBlob = cachedBlob.data();
+			baseDesc.CachedPSO.CachedBlobSizeInBytes = cachedBlob.size();
 
-			sleepToEmulateComplexCreatePSO = true;
+			hr = pDevice->CreateGraphicsPipelineState(&baseDesc, IID_PPV_ARGS(&pLibrary->m_pipelineStates[type]));
 		}
-		else
-		{
-			// Read in the blob data from disk to avoid compiling it.
-			baseDesc.CachedPSO.pCachedBlob = pLibrary->m_diskCaches[type].GetCachedBlob();
-			baseDesc.CachedPSO.CachedBlobSizeInBytes = pLibrary->m_diskCaches[type].GetCachedBlobSize();
-
-			HRESULT hr = pDevice->CreateGraphicsPipelineState(&baseDesc, IID_PPV_ARGS(&pLibrary->m_pipelineStates[type]));
 
-			// If compilation fails the cache is probably stale. (old drivers etc.)
-			if (FAILED(hr))
-			{
-				baseDesc.CachedPSO = {};
-				ThrowIfFailed(pDevice->CreateGraphicsPipelineState(&baseDesc, IID_PPV_ARGS(&pLibrary->m_pipelineStates[type])));
+		// If there's no entry, or compilation fails because the cache is stale (old drivers etc.), add a new entry.
+		// Replacing an entry leaves the old blob in the archive until it's compacted.
+		if (FAILED(hr))
+		{
+			baseDesc.CachedPSO = {};
+			ThrowIfFailed(pDevice->CreateGraphicsPipelineState(&baseDesc, IID_PPV_ARGS(&pLibrary->m_pipelineStates[type])));
 
-				ComPtr<ID3DBlob> blob;
-				pLibrary->m_pipelineStates[type]->GetCachedBlob(&blob);
-				pLibrary->m_diskCaches[type].Update(blob.Get());
+			ComPtr<ID3DBlob> blob;
+			ThrowIfFailed(pLibrary->m_pipelineStates[type]->GetCachedBlob(&blob));
+			pLibrary->m_diskCache.Insert(key, blob->GetBufferPointer(), blob->GetBufferSize());
 
-				sleepToEmulateComplexCreatePSO = true;
-			}
+			sleepToEmulateComplexCreatePSO = true;
 		}
 	}
 	else
@@ -331,11 +452,7 @@ void PSOLibrary::ClearPSOCache()
 	}
 
 	// Clear the disk caches.
-	for (size_t i = 0; i < EffectPipelineTypeCount; i++)
-	{
-		m_diskCaches[i].Destroy(true);
-	}
-
+	m_diskCache.Destroy(true);
 	m_pipelineLibrary.Destroy(true);
 }
 
@@ -12,7 +12,7 @@
 #pragma once
 #include "DXSample.h"
 #include "DynamicConstantBuffer.h"
-#include "MemoryMappedPSOCache.h"
+#include "MemoryMappedPSOArchive.h"
 #include "MemoryMappedPipelineLibrary.h"
 #include "SimpleVertexShader.hlsl.h"
 #include "SimplePixelShader.hlsl.h"
@@ -180,20 +180,7 @@ static const GraphicsShaderSet g_cEffectShaderData[EffectPipelineTypeCount] =
 
 static const LPWCH g_cPipelineLibraryFileName = L"pipelineLibrary.cache";
 
-static const LPWCH g_cCacheFileNames[EffectPipelineTypeCount] =
-{
-	L"normal3dPSO.cache",
-	L"ubershaderPSO.cache",
-	L"blitEffectPSO.cache",
-	L"invertEffectPSO.cache",
-	L"grayscaleEffectPSO.cache",
-	L"edgeDetectEffectPSO.cache",
-	L"blurEffectPSO.cache",
-	L"warpEffectPSO.cache",
-	L"pixelateEffectPSO.cache",
-	L"distortEffectPSO.cache",
-	L"waveEffectPSO.cache",
-};
+static const LPWCH g_cPSOArchiveFileName = L"psoArchive.cache";
 
 static const LPWCH g_cEffectNames[EffectPipelineTypeCount] =
 {
@@ -256,12 +243,14 @@ private:
 	};
 
 	static void CompilePSO(CompilePSOThreadData* pDataPackage);
+	static UINT64 GetCacheKey(ID3D12Device* pDevice);
+	static MemoryMappedPSOArchive::Key GetPSOKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
 	void WaitForThreads();
 
 	ComPtr<ID3D12PipelineState> m_pipelineStates[EffectPipelineTypeCount];
 	bool m_compiledPSOFlags[EffectPipelineTypeCount];
 	bool m_inflightPSOFlags[EffectPipelineTypeCount];
-	MemoryMappedPSOCache m_diskCaches[EffectPipelineTypeCount];	// Cached blobs.
+	MemoryMappedPSOArchive m_diskCache;	// Cached blobs, keyed by PSO.
 	MemoryMappedPipelineLibrary m_pipelineLibrary; // Pipeline Library.
 	HANDLE m_flagsMutex;
 	CompilePSOThreadData m_workerThreads[EffectPipelineTypeCount];
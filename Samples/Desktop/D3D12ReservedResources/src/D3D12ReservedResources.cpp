@@ -19,18 +19,18 @@ D3D12ReservedResources::D3D12ReservedResources(UINT width, UINT height, std::wst
 	m_scissorRect(0, 0, static_cast<LONG>(width), static_cast<LONG>(height)),
 	m_rtvDescriptorSize(0),
 	m_tilingSupport(false),
+	m_reservedResourceId(0),
+	m_mipLevels(0),
 	m_packedMipInfo(),
 	m_activeMip(0),
 	m_activeMipChanged(true),
 	m_fenceValues{}
 {
-	UINT mipLevels = 0;
 	for (UINT w = TextureWidth, h = TextureHeight; w > 0 && h > 0; w >>= 1, h >>= 1)
 	{
-		mipLevels++;
+		m_mipLevels++;
 	}
-	m_activeMip = mipLevels - 1;	// Show the least detailed mip first.
-	m_mips.resize(mipLevels);
+	m_activeMip = m_mipLevels - 1;	// Show the least detailed mip first.
 }
 
 void D3D12ReservedResources::OnInit()
@@ -323,7 +323,7 @@ void D3D12ReservedResources::LoadAssets()
 		// Describe and create a reserved Texture2D. This resource has no backing texture
 		// when it is created. It will be mapped to a physical resource dynamically.
 		D3D12_RESOURCE_DESC reservedTextureDesc = {};
-		reservedTextureDesc.MipLevels = static_cast<UINT16>(m_mips.size());
+		reservedTextureDesc.MipLevels = static_cast<UINT16>(m_mipLevels);
 		reservedTextureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 		reservedTextureDesc.Width = TextureWidth;
 		reservedTextureDesc.Height = TextureHeight;
@@ -372,50 +372,18 @@ void D3D12ReservedResources::LoadAssets()
 		std::vector<D3D12_SUBRESOURCE_TILING> tilings(subresourceCount);
 		m_device->GetResourceTiling(m_reservedResource.Get(), &numTiles, &m_packedMipInfo, &tileShape, &subresourceCount, 0, &tilings[0]);
 
-		UINT heapCount = m_packedMipInfo.NumStandardMips + (m_packedMipInfo.NumPackedMips > 0 ? 1 : 0);
-		for (UINT n = 0; n < m_mips.size(); n++)
-		{
-			if (n < m_packedMipInfo.NumStandardMips)
-			{
-				m_mips[n].heapIndex = n;
-				m_mips[n].packedMip = false;
-				m_mips[n].mapped = false;
-				m_mips[n].startCoordinate = CD3DX12_TILED_RESOURCE_COORDINATE(0, 0, 0, n);
-				m_mips[n].regionSize.Width = tilings[n].WidthInTiles;
-				m_mips[n].regionSize.Height = tilings[n].HeightInTiles;
-				m_mips[n].regionSize.Depth = tilings[n].DepthInTiles;
-				m_mips[n].regionSize.NumTiles = tilings[n].WidthInTiles * tilings[n].HeightInTiles * tilings[n].DepthInTiles;
-				m_mips[n].regionSize.UseBox = TRUE;
-			}
-			else
-			{
-				// All of the packed mips will go into the last heap.
-				m_mips[n].heapIndex = heapCount - 1;
-				m_mips[n].packedMip = true;
-				m_mips[n].mapped = false;
-
-				// Mark all of the packed mips as having the same start coordinate and size.
-				m_mips[n].startCoordinate = CD3DX12_TILED_RESOURCE_COORDINATE(0, 0, 0, heapCount - 1);
-				m_mips[n].regionSize.NumTiles = m_packedMipInfo.NumTilesForPackedMips;
-				m_mips[n].regionSize.UseBox = FALSE;	// regionSize.Width/Height/Depth will be ignored.
-			}
-		}
-
-		// Describe and create heaps for the mips in the mip chain to be used by the
-		// reserved resource. The packed mips will all be stored in the same heap.
-		// 
-		// You could also put all of the mips in the same heap, but we do it this way
-		// in the sample to illustrate the ability to map tiles from multiple heaps
-		// into the same reserved resource.
-
-		m_heaps.resize(heapCount);
-		for (UINT n = 0; n < heapCount; n++)
-		{
-			const UINT heapSize = m_mips[n].regionSize.NumTiles * D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		// Create a tile manager to map the mips onto a pool of tiles, and register the
+		// reserved resource with it. Its heaps are created as they are needed.
+		//
+		// The pool is only large enough for the most detailed mip, so showing that mip
+		// evicts the others, and showing them again makes them resident again. A real
+		// streaming system would share a much larger pool between many resources.
+		const UINT mostDetailedMipTiles = tilings[0].WidthInTiles * tilings[0].HeightInTiles * tilings[0].DepthInTiles;
+		const UINT poolTiles = max(mostDetailedMipTiles, m_packedMipInfo.NumTilesForPackedMips);
 
-			CD3DX12_HEAP_DESC heapDesc(heapSize, D3D12_HEAP_TYPE_DEFAULT, 0, D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES);
-			ThrowIfFailed(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_heaps[n])));
-		}
+		m_tileBackend.reset(new TileBackend(this));
+		m_tileManager.reset(new TileManager(m_tileBackend.get(), poolTiles, 1));
+		m_reservedResourceId = m_tileManager->RegisterResource(m_reservedResource.Get(), m_packedMipInfo, &tilings[0]);
 
 		UpdateTileMapping();
 
@@ -447,97 +415,54 @@ void D3D12ReservedResources::LoadAssets()
 	}
 }
 
-// Generate and upload the texture corresponding to the active mip level then
-// map it to the reserved resource.
+// Make the active mip level resident in the reserved resource, then generate and
+// upload its texture if it wasn't resident already.
 void D3D12ReservedResources::UpdateTileMapping()
 {
-	UINT firstSubresource = m_mips[m_activeMip].heapIndex;
-	UINT subresourceCount = m_mips[m_activeMip].packedMip ? m_packedMipInfo.NumPackedMips : 1;
+	// All of the packed mips are made resident together.
+	const bool packedMip = m_activeMip >= m_packedMipInfo.NumStandardMips;
+	const UINT firstSubresource = packedMip ? m_packedMipInfo.NumStandardMips : m_activeMip;
+	const UINT subresourceCount = packedMip ? m_packedMipInfo.NumPackedMips : 1;
+
+	// This may evict mips that were shown in earlier frames to make room. The pool always
+	// has room for any one mip, so this only fails if the pool was sized incorrectly.
+	bool newlyResident = false;
+	if (!m_tileManager->MakeResident(m_reservedResourceId, m_activeMip, &newlyResident))
+	{
+		ThrowIfFailed(E_OUTOFMEMORY);
+	}
 
-	// Only update tile mappings if necessary.
-	if (!m_mips[firstSubresource].mapped)
+	// Update the tile mappings on the reserved resource. The mappings are applied on the
+	// command queue, so they take effect after earlier frames and before this one.
+	m_tileManager->Flush();
+
+	if (newlyResident)
 	{
 		// Generate the texture data for the active mip level.
 		// If the mip level corresponds to a packed mip, generate all the packed mips.
 		std::vector<UINT8> texture = GenerateTextureData(firstSubresource, subresourceCount);
 
-		// Update the tile mappings on the reserved resource.
-		{
-			UINT updatedRegions = 0;
-			std::vector<D3D12_TILED_RESOURCE_COORDINATE> startCoordinates;
-			std::vector<D3D12_TILE_REGION_SIZE> regionSizes;
-			std::vector<D3D12_TILE_RANGE_FLAGS> rangeFlags;
-			std::vector<UINT> heapRangeStartOffsets;
-			std::vector<UINT> rangeTileCounts;
-
-			for (UINT n = 0; n < m_heaps.size(); n++)
-			{
-				if (!m_mips[n].mapped && n != firstSubresource)
-				{
-					// Skip unchanged tile regions.
-					continue;
-				}
-
-				startCoordinates.push_back(m_mips[n].startCoordinate);
-				regionSizes.push_back(m_mips[n].regionSize);
-
-				if (n == firstSubresource)
-				{
-					// Map the currently active mip.
-					rangeFlags.push_back(D3D12_TILE_RANGE_FLAG_NONE);
-					m_mips[n].mapped = true;
-				}
-				else
-				{
-					// Unmap the previously active mip.
-					assert(m_mips[n].mapped);
-
-					rangeFlags.push_back(D3D12_TILE_RANGE_FLAG_NULL);
-					m_mips[n].mapped = false;
-				}
-				heapRangeStartOffsets.push_back(0);		// In this sample, each heap contains only one tile region.
-				rangeTileCounts.push_back(m_mips[n].regionSize.NumTiles);
-
-				updatedRegions++;
-			}
-
-			m_commandQueue->UpdateTileMappings(
-				m_reservedResource.Get(),
-				updatedRegions,
-				&startCoordinates[0],
-				&regionSizes[0],
-				m_heaps[firstSubresource].Get(),
-				updatedRegions,
-				&rangeFlags[0],
-				&heapRangeStartOffsets[0],
-				&rangeTileCounts[0],
-				D3D12_TILE_MAPPING_FLAG_NONE
-				);
-		}
-
 		// Upload the mip(s) to the GPU and copy them to the reserved resource.
+		UINT mipOffset = 0;
+		std::vector<D3D12_SUBRESOURCE_DATA> data(subresourceCount);
+		for (UINT n = 0; n < subresourceCount; n++)
 		{
-			UINT mipOffset = 0;
-			std::vector<D3D12_SUBRESOURCE_DATA> data(subresourceCount);
-			for (UINT n = 0; n < subresourceCount; n++)
-			{
-				UINT currentMip = firstSubresource + n;
+			UINT currentMip = firstSubresource + n;
 
-				data[n].pData = &texture[mipOffset];
-				data[n].RowPitch = (TextureWidth >> currentMip) * TexturePixelSizeInBytes;
-				data[n].SlicePitch = data[n].RowPitch * (TextureHeight >> currentMip);
+			data[n].pData = &texture[mipOffset];
+			data[n].RowPitch = (TextureWidth >> currentMip) * TexturePixelSizeInBytes;
+			data[n].SlicePitch = data[n].RowPitch * (TextureHeight >> currentMip);
 
-				mipOffset += static_cast<UINT>(data[n].SlicePitch);
-			}
-
-			UpdateSubresources(m_commandList.Get(), m_reservedResource.Get(), m_uploadHeap.Get(), 0, firstSubresource, subresourceCount, &data[0]);
+			mipOffset += static_cast<UINT>(data[n].SlicePitch);
 		}
+
+		UpdateSubresources(m_commandList.Get(), m_reservedResource.Get(), m_uploadHeap.Get(), 0, firstSubresource, subresourceCount, &data[0]);
 	}
 
 	m_activeMipChanged = false;
 
 	WCHAR message[100];
-	swprintf_s(message, L"Mip Level: %d", m_activeMip);
+	swprintf_s(message, L"Mip Level: %d (%d tiles resident)", m_activeMip, m_tileManager->GetStatistics().residentTiles);
 	SetCustomWindowText(message);
 }
 
@@ -613,6 +538,9 @@ void D3D12ReservedResources::OnRender()
 		ThrowIfFailed(m_swapChain->Present(1, 0));
 
 		MoveToNextFrame();
+
+		// Mips that were only used in earlier frames may now be evicted.
+		m_tileManager->NextFrame();
 	}
 }
 
@@ -643,7 +571,7 @@ void D3D12ReservedResources::OnKeyDown(UINT8 key)
 
 	case VK_RIGHT:
 	case VK_DOWN:
-		if (m_activeMip < m_mips.size() - 1)
+		if (m_activeMip < m_mipLevels - 1)
 		{
 			m_activeMip++;
 			m_activeMipChanged = true;
@@ -671,6 +599,11 @@ void D3D12ReservedResources::PopulateCommandList()
 		UpdateTileMapping();
 		m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_reservedResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
 	}
+	else
+	{
+		// Keep the active mip at the back of the tile manager's eviction order.
+		m_tileManager->MarkUsed(m_reservedResourceId, m_activeMip);
+	}
 
 	// Set necessary state.
 	m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
@@ -736,3 +669,40 @@ void D3D12ReservedResources::MoveToNextFrame()
 	// Set the fence value for the next frame.
 	m_fenceValues[m_frameIndex] = currentFenceValue + 1;
 }
+
+void D3D12ReservedResources::TileBackend::CreateHeap(UINT heapIndex, UINT numTiles)
+{
+	const UINT64 heapSize = static_cast<UINT64>(numTiles) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+
+	CD3DX12_HEAP_DESC heapDesc(heapSize, D3D12_HEAP_TYPE_DEFAULT, 0, D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES);
+	m_pSample->m_heaps.resize(heapIndex + 1);
+	ThrowIfFailed(m_pSample->m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_pSample->m_heaps[heapIndex])));
+}
+
+void D3D12ReservedResources::TileBackend::UpdateTileMappings(
+	ID3D12Resource* pResource,
+	UINT numRegions,
+	const D3D12_TILED_RESOURCE_COORDINATE* pRegionStartCoordinates,
+	const D3D12_TILE_REGION_SIZE* pRegionSizes,
+	UINT heapIndex,
+	UINT numRanges,
+	const D3D12_TILE_RANGE_FLAGS* pRangeFlags,
+	const UINT* pHeapRangeStartOffsets,
+	const UINT* pRangeTileCounts)
+{
+	// Calls that only unmap tiles don't need a heap.
+	ID3D12Heap* pHeap = (heapIndex == TileManager::NullHeap) ? nullptr : m_pSample->m_heaps[heapIndex].Get();
+
+	m_pSample->m_commandQueue->UpdateTileMappings(
+		pResource,
+		numRegions,
+		pRegionStartCoordinates,
+		pRegionSizes,
+		pHeap,
+		numRanges,
+		pRangeFlags,
+		pHeapRangeStartOffsets,
+		pRangeTileCounts,
+		D3D12_TILE_MAPPING_FLAG_NONE
+		);
+}
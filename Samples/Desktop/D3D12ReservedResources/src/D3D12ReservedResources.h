@@ -12,6 +12,7 @@
 #pragma once
 
 #include "DXSample.h"
+#include "TileManager.h"
 
 using namespace DirectX;
 
@@ -46,14 +47,27 @@ private:
 		XMFLOAT2 uv;
 	};
 
-	// Information about the mips in the reserved resource.
-	struct MipInfo
+	// Creates the heaps for the tile manager's pool and applies its mappings to the
+	// command queue.
+	class TileBackend : public TileMappingBackend
 	{
-		UINT heapIndex;
-		bool packedMip;
-		bool mapped;
-		D3D12_TILED_RESOURCE_COORDINATE startCoordinate;
-		D3D12_TILE_REGION_SIZE regionSize;
+	public:
+		TileBackend(D3D12ReservedResources* pSample) : m_pSample(pSample) {}
+
+		virtual void CreateHeap(UINT heapIndex, UINT numTiles) override;
+		virtual void UpdateTileMappings(
+			ID3D12Resource* pResource,
+			UINT numRegions,
+			const D3D12_TILED_RESOURCE_COORDINATE* pRegionStartCoordinates,
+			const D3D12_TILE_REGION_SIZE* pRegionSizes,
+			UINT heapIndex,
+			UINT numRanges,
+			const D3D12_TILE_RANGE_FLAGS* pRangeFlags,
+			const UINT* pHeapRangeStartOffsets,
+			const UINT* pRangeTileCounts) override;
+
+	private:
+		D3D12ReservedResources* m_pSample;
 	};
 
 	// Pipeline objects.
@@ -84,7 +98,10 @@ private:
 	ComPtr<ID3D12Resource> m_uploadHeap;
 	ComPtr<ID3D12Resource> m_reservedResource;
 	std::vector<ComPtr<ID3D12Heap>> m_heaps;
-	std::vector<MipInfo> m_mips;
+	std::unique_ptr<TileBackend> m_tileBackend;
+	std::unique_ptr<TileManager> m_tileManager;
+	UINT m_reservedResourceId;
+	UINT m_mipLevels;
 	D3D12_PACKED_MIP_INFO m_packedMipInfo;
 	UINT m_activeMip;
 	bool m_activeMipChanged;
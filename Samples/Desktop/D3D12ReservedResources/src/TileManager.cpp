@@ -0,0 +1,400 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// This file doesn't use the precompiled header so that TileManagerTest can share it.
+#include "TileManager.h"
+
+#include <cassert>
+
+TileManager::TileManager(TileMappingBackend* pBackend, UINT tilesPerHeap, UINT maxHeaps) :
+	m_pBackend(pBackend),
+	m_tilesPerHeap(tilesPerHeap),
+	m_maxHeaps(maxHeaps),
+	m_frame(0),
+	m_freeTiles(tilesPerHeap * maxHeaps),
+	m_statistics()
+{
+}
+
+UINT TileManager::RegisterResource(ID3D12Resource* pResource, const D3D12_PACKED_MIP_INFO& packedMipInfo, const D3D12_SUBRESOURCE_TILING* pTilings)
+{
+	std::unique_ptr<ResourceEntry> pEntry(new ResourceEntry());
+	pEntry->pResource = pResource;
+	pEntry->numStandardMips = packedMipInfo.NumStandardMips;
+
+	const UINT resourceId = static_cast<UINT>(m_resources.size());
+	const UINT mipCount = packedMipInfo.NumStandardMips + (packedMipInfo.NumPackedMips > 0 ? 1 : 0);
+	pEntry->mips.resize(mipCount);
+
+	for (UINT n = 0; n < mipCount; n++)
+	{
+		MipAllocation& mip = pEntry->mips[n];
+		mip.resourceId = resourceId;
+		mip.subresource = n;
+		mip.state = MipState_NotResident;
+		mip.unmapPending = false;
+		mip.lastUsedFrame = 0;
+
+		if (n < packedMipInfo.NumStandardMips)
+		{
+			mip.widthInTiles = pTilings[n].WidthInTiles;
+			mip.heightInTiles = pTilings[n].HeightInTiles;
+			mip.tileCount = pTilings[n].WidthInTiles * pTilings[n].HeightInTiles * pTilings[n].DepthInTiles;
+		}
+		else
+		{
+			// The packed mips are addressed as a linear run of tiles from the first packed mip.
+			mip.widthInTiles = packedMipInfo.NumTilesForPackedMips;
+			mip.heightInTiles = 1;
+			mip.tileCount = packedMipInfo.NumTilesForPackedMips;
+		}
+	}
+
+	m_resources.push_back(std::move(pEntry));
+	return resourceId;
+}
+
+void TileManager::UnregisterResource(UINT resourceId)
+{
+	ResourceEntry& resource = *m_resources[resourceId];
+	for (MipAllocation& mip : resource.mips)
+	{
+		if (mip.state != MipState_NotResident)
+		{
+			FreeTiles(mip);
+			m_lru.erase(mip.lruEntry);
+		}
+	}
+
+	m_resources[resourceId].reset();
+}
+
+bool TileManager::MakeResident(UINT resourceId, UINT mipIndex, bool* pNewlyResident)
+{
+	MipAllocation& mip = GetMip(resourceId, mipIndex);
+	*pNewlyResident = false;
+
+	if (mip.state != MipState_NotResident)
+	{
+		Touch(mip);
+		return true;
+	}
+
+	if (m_freeTiles < mip.tileCount)
+	{
+		// Check that evicting mips that weren't used this frame will make enough room before
+		// evicting any of them.
+		UINT reclaimable = m_freeTiles;
+		for (MipAllocation* pCandidate : m_lru)
+		{
+			if (reclaimable >= mip.tileCount || pCandidate->lastUsedFrame == m_frame)
+			{
+				break;
+			}
+			reclaimable += pCandidate->tileCount;
+		}
+
+		if (reclaimable < mip.tileCount)
+		{
+			return false;
+		}
+
+		while (m_freeTiles < mip.tileCount)
+		{
+			Evict(*m_lru.front());
+		}
+	}
+
+	Allocate(mip);
+
+	mip.state = MipState_PendingMap;
+	mip.lastUsedFrame = m_frame;
+	mip.lruEntry = m_lru.insert(m_lru.end(), &mip);
+	m_resources[resourceId]->pendingMaps.push_back(mip.subresource);
+
+	*pNewlyResident = true;
+	return true;
+}
+
+void TileManager::MarkUsed(UINT resourceId, UINT mipIndex)
+{
+	MipAllocation& mip = GetMip(resourceId, mipIndex);
+	assert(mip.state != MipState_NotResident);
+	Touch(mip);
+}
+
+bool TileManager::IsResident(UINT resourceId, UINT mipIndex) const
+{
+	return GetMip(resourceId, mipIndex).state != MipState_NotResident;
+}
+
+void TileManager::NextFrame()
+{
+	m_frame++;
+}
+
+void TileManager::Flush()
+{
+	// Unmap evicted tiles before mapping their new owners, so that no heap tile is ever mapped
+	// into two places at once.
+	for (std::unique_ptr<ResourceEntry>& pResource : m_resources)
+	{
+		if (pResource && !pResource->pendingUnmaps.empty())
+		{
+			FlushUnmaps(*pResource);
+		}
+	}
+
+	for (std::unique_ptr<ResourceEntry>& pResource : m_resources)
+	{
+		if (pResource && !pResource->pendingMaps.empty())
+		{
+			FlushMaps(*pResource);
+		}
+	}
+}
+
+void TileManager::GetTileLocation(UINT resourceId, UINT mipIndex, UINT tile, UINT* pHeapIndex, UINT* pHeapOffset) const
+{
+	const MipAllocation& mip = GetMip(resourceId, mipIndex);
+	assert(mip.state != MipState_NotResident && tile < mip.tileCount);
+
+	*pHeapIndex = mip.tiles[tile].heapIndex;
+	*pHeapOffset = mip.tiles[tile].heapOffset;
+}
+
+UINT TileManager::GetTileCount(UINT resourceId, UINT mipIndex) const
+{
+	return GetMip(resourceId, mipIndex).tileCount;
+}
+
+TileManager::MipAllocation& TileManager::GetMip(UINT resourceId, UINT mipIndex)
+{
+	ResourceEntry& resource = *m_resources[resourceId];
+	return resource.mips[mipIndex < resource.numStandardMips ? mipIndex : resource.numStandardMips];
+}
+
+const TileManager::MipAllocation& TileManager::GetMip(UINT resourceId, UINT mipIndex) const
+{
+	const ResourceEntry& resource = *m_resources[resourceId];
+	return resource.mips[mipIndex < resource.numStandardMips ? mipIndex : resource.numStandardMips];
+}
+
+void TileManager::Evict(MipAllocation& mip)
+{
+	assert(mip.lastUsedFrame != m_frame);
+
+	if (mip.state == MipState_Mapped && !mip.unmapPending)
+	{
+		mip.unmapPending = true;
+		m_resources[mip.resourceId]->pendingUnmaps.push_back(mip.subresource);
+	}
+
+	// A mip that was never mapped is simply skipped by the next flush.
+	m_statistics.evictedTiles += mip.tileCount;
+	FreeTiles(mip);
+	m_lru.erase(mip.lruEntry);
+	mip.state = MipState_NotResident;
+}
+
+// Takes the lowest free tiles, so that a mip allocated from an empty pool is backed by a
+// single run of tiles and can be mapped with one range.
+void TileManager::Allocate(MipAllocation& mip)
+{
+	assert(m_freeTiles >= mip.tileCount);
+
+	mip.tiles.resize(mip.tileCount);
+	UINT tile = 0;
+
+	for (UINT heapIndex = 0; tile < mip.tileCount; heapIndex++)
+	{
+		if (heapIndex == m_heaps.size())
+		{
+			m_pBackend->CreateHeap(heapIndex, m_tilesPerHeap);
+
+			Heap heap;
+			heap.used.resize(m_tilesPerHeap, false);
+			heap.freeCount = m_tilesPerHeap;
+			m_heaps.push_back(heap);
+			m_statistics.heapCount = static_cast<UINT>(m_heaps.size());
+		}
+
+		Heap& heap = m_heaps[heapIndex];
+		for (UINT offset = 0; offset < m_tilesPerHeap && heap.freeCount > 0 && tile < mip.tileCount; offset++)
+		{
+			if (!heap.used[offset])
+			{
+				heap.used[offset] = true;
+				heap.freeCount--;
+				mip.tiles[tile].heapIndex = heapIndex;
+				mip.tiles[tile].heapOffset = offset;
+				tile++;
+			}
+		}
+	}
+
+	m_freeTiles -= mip.tileCount;
+	m_statistics.residentTiles += mip.tileCount;
+}
+
+void TileManager::FreeTiles(MipAllocation& mip)
+{
+	for (const PoolTile& tile : mip.tiles)
+	{
+		Heap& heap = m_heaps[tile.heapIndex];
+		assert(heap.used[tile.heapOffset]);
+		heap.used[tile.heapOffset] = false;
+		heap.freeCount++;
+	}
+
+	m_freeTiles += mip.tileCount;
+	m_statistics.residentTiles -= mip.tileCount;
+	mip.tiles.clear();
+}
+
+void TileManager::Touch(MipAllocation& mip)
+{
+	mip.lastUsedFrame = m_frame;
+	m_lru.splice(m_lru.end(), m_lru, mip.lruEntry);
+}
+
+D3D12_TILED_RESOURCE_COORDINATE TileManager::GetTileCoordinate(const MipAllocation& mip, UINT tile) const
+{
+	const UINT tilesPerSlice = mip.widthInTiles * mip.heightInTiles;
+
+	D3D12_TILED_RESOURCE_COORDINATE coordinate;
+	coordinate.X = tile % mip.widthInTiles;
+	coordinate.Y = (tile % tilesPerSlice) / mip.widthInTiles;
+	coordinate.Z = tile / tilesPerSlice;
+	coordinate.Subresource = mip.subresource;
+	return coordinate;
+}
+
+// Unmaps every tile of each evicted mip, as one region per mip and a single NULL range.
+void TileManager::FlushUnmaps(ResourceEntry& resource)
+{
+	UINT tileCount = 0;
+	for (UINT mipIndex : resource.pendingUnmaps)
+	{
+		MipAllocation& mip = resource.mips[mipIndex];
+		mip.unmapPending = false;
+
+		D3D12_TILE_REGION_SIZE regionSize = {};
+		regionSize.NumTiles = mip.tileCount;
+		regionSize.UseBox = FALSE;
+
+		m_regionStarts.push_back(GetTileCoordinate(mip, 0));
+		m_regionSizes.push_back(regionSize);
+		tileCount += mip.tileCount;
+	}
+	resource.pendingUnmaps.clear();
+
+	m_rangeFlags.push_back(D3D12_TILE_RANGE_FLAG_NULL);
+	m_rangeStarts.push_back(0);
+	m_rangeCounts.push_back(tileCount);
+
+	IssueUpdate(resource.pResource, NullHeap);
+}
+
+// Maps the tiles of newly resident mips, with one call per heap. Consecutive tiles of a mip
+// that are backed by the heap form one region, and consecutive heap tiles form one range.
+void TileManager::FlushMaps(ResourceEntry& resource)
+{
+	for (UINT heapIndex = 0; heapIndex < m_heaps.size(); heapIndex++)
+	{
+		for (UINT mipIndex : resource.pendingMaps)
+		{
+			const MipAllocation& mip = resource.mips[mipIndex];
+			if (mip.state != MipState_PendingMap)
+			{
+				// Evicted before it was mapped, or listed twice.
+				continue;
+			}
+
+			bool regionOpen = false;
+			for (UINT tile = 0; tile < mip.tileCount; tile++)
+			{
+				const PoolTile& poolTile = mip.tiles[tile];
+				if (poolTile.heapIndex != heapIndex)
+				{
+					regionOpen = false;
+					continue;
+				}
+
+				if (regionOpen)
+				{
+					m_regionSizes.back().NumTiles++;
+				}
+				else
+				{
+					D3D12_TILE_REGION_SIZE regionSize = {};
+					regionSize.NumTiles = 1;
+					regionSize.UseBox = FALSE;
+
+					m_regionStarts.push_back(GetTileCoordinate(mip, tile));
+					m_regionSizes.push_back(regionSize);
+					regionOpen = true;
+				}
+
+				if (!m_rangeCounts.empty() && m_rangeStarts.back() + m_rangeCounts.back() == poolTile.heapOffset)
+				{
+					m_rangeCounts.back()++;
+				}
+				else
+				{
+					m_rangeFlags.push_back(D3D12_TILE_RANGE_FLAG_NONE);
+					m_rangeStarts.push_back(poolTile.heapOffset);
+					m_rangeCounts.push_back(1);
+				}
+			}
+		}
+
+		if (!m_regionStarts.empty())
+		{
+			IssueUpdate(resource.pResource, heapIndex);
+		}
+	}
+
+	for (UINT mipIndex : resource.pendingMaps)
+	{
+		MipAllocation& mip = resource.mips[mipIndex];
+		if (mip.state == MipState_PendingMap)
+		{
+			mip.state = MipState_Mapped;
+			m_statistics.mappedTiles += mip.tileCount;
+		}
+	}
+	resource.pendingMaps.clear();
+}
+
+void TileManager::IssueUpdate(ID3D12Resource* pResource, UINT heapIndex)
+{
+	m_pBackend->UpdateTileMappings(
+		pResource,
+		static_cast<UINT>(m_regionStarts.size()),
+		m_regionStarts.data(),
+		m_regionSizes.data(),
+		heapIndex,
+		static_cast<UINT>(m_rangeFlags.size()),
+		m_rangeFlags.data(),
+		m_rangeStarts.data(),
+		m_rangeCounts.data());
+
+	m_statistics.updateCalls++;
+	m_statistics.regions += m_regionStarts.size();
+	m_statistics.ranges += m_rangeFlags.size();
+
+	m_regionStarts.clear();
+	m_regionSizes.clear();
+	m_rangeFlags.clear();
+	m_rangeStarts.clear();
+	m_rangeCounts.clear();
+}
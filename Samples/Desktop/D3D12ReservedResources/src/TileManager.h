@@ -0,0 +1,184 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <d3d12.h>
+#include <climits>
+#include <list>
+#include <memory>
+#include <vector>
+
+// Creates the tile heaps and applies the tile mappings requested by a TileManager. The sample
+// forwards these to the device and command queue; TileManagerTest records them instead.
+class TileMappingBackend
+{
+public:
+	virtual ~TileMappingBackend() {}
+
+	// Creates heap 'heapIndex', with room for 'numTiles' 64KB tiles. Heaps are created in order.
+	virtual void CreateHeap(UINT heapIndex, UINT numTiles) = 0;
+
+	// As ID3D12CommandQueue::UpdateTileMappings, with the heap given by index. When every range
+	// is D3D12_TILE_RANGE_FLAG_NULL, heapIndex is TileManager::NullHeap.
+	virtual void UpdateTileMappings(
+		ID3D12Resource* pResource,
+		UINT numRegions,
+		const D3D12_TILED_RESOURCE_COORDINATE* pRegionStartCoordinates,
+		const D3D12_TILE_REGION_SIZE* pRegionSizes,
+		UINT heapIndex,
+		UINT numRanges,
+		const D3D12_TILE_RANGE_FLAGS* pRangeFlags,
+		const UINT* pHeapRangeStartOffsets,
+		const UINT* pRangeTileCounts) = 0;
+};
+
+// Maps the mips of reserved resources onto a shared pool of 64KB tiles.
+//
+// The pool is made of up to maxHeaps heaps of tilesPerHeap tiles each, created as they are
+// needed. Each registered resource has a page table that records which pool tile backs each
+// of its tiles. Mips are made resident one at a time (the packed mips count as one), and when
+// the pool is full the least recently used mips are evicted to make room, other than mips that
+// were used in the current frame.
+//
+// Mapping changes are batched until Flush, which unmaps evicted tiles first and then maps new
+// ones, with one UpdateTileMappings call per resource and heap. Runs of consecutive resource
+// tiles are merged into a single region, and runs of consecutive heap tiles into a single range.
+// Since the mappings are applied on the queue, in order with command lists, tiles may be
+// reassigned while earlier frames that used them are still in flight.
+class TileManager
+{
+public:
+	static const UINT NullHeap = UINT_MAX;
+
+	struct Statistics
+	{
+		UINT heapCount;
+		UINT residentTiles;
+		UINT64 mappedTiles;
+		UINT64 evictedTiles;
+		UINT64 updateCalls;
+		UINT64 regions;
+		UINT64 ranges;
+	};
+
+	TileManager(TileMappingBackend* pBackend, UINT tilesPerHeap, UINT maxHeaps);
+
+	// Registers a reserved resource with the tiling reported by ID3D12Device::GetResourceTiling,
+	// and returns its id. pTilings must have an entry for each standard mip.
+	UINT RegisterResource(ID3D12Resource* pResource, const D3D12_PACKED_MIP_INFO& packedMipInfo, const D3D12_SUBRESOURCE_TILING* pTilings);
+
+	// Returns the resource's tiles to the pool. The resource's mappings are left as they are,
+	// so this should only be called once the resource is no longer used.
+	void UnregisterResource(UINT resourceId);
+
+	// Allocates and maps tiles for a mip, evicting other mips if the pool is full, and marks it
+	// as used in the current frame. Sets *pNewlyResident if the mip's contents must be uploaded.
+	// Returns false, without evicting anything, if the pool can't make enough room.
+	bool MakeResident(UINT resourceId, UINT mip, bool* pNewlyResident);
+
+	// Marks a resident mip as used in the current frame, so that it won't be evicted this frame.
+	void MarkUsed(UINT resourceId, UINT mip);
+
+	bool IsResident(UINT resourceId, UINT mip) const;
+
+	// Starts a new frame. Mips used in earlier frames may be evicted.
+	void NextFrame();
+
+	// Issues all of the mapping changes since the last flush.
+	void Flush();
+
+	// Returns the heap and tile offset backing a tile of a resident mip, where 'tile' counts in
+	// the order used by UpdateTileMappings when UseBox is FALSE. Used by tests.
+	void GetTileLocation(UINT resourceId, UINT mip, UINT tile, UINT* pHeapIndex, UINT* pHeapOffset) const;
+
+	// Returns the number of tiles in a mip. All of the packed mips share one set of tiles.
+	UINT GetTileCount(UINT resourceId, UINT mip) const;
+
+	const Statistics& GetStatistics() const { return m_statistics; }
+
+private:
+	enum MipState
+	{
+		MipState_NotResident,
+		MipState_PendingMap,
+		MipState_Mapped,
+	};
+
+	struct PoolTile
+	{
+		UINT heapIndex;
+		UINT heapOffset;
+	};
+
+	// A standard mip, or all of the packed mips. This is the unit of residency and eviction.
+	struct MipAllocation
+	{
+		UINT resourceId;
+		UINT subresource;
+		UINT widthInTiles;
+		UINT heightInTiles;
+		UINT tileCount;
+		MipState state;
+		bool unmapPending;					// The mip was evicted after it was mapped.
+		UINT64 lastUsedFrame;
+		std::vector<PoolTile> tiles;		// The page table for this mip.
+		std::list<MipAllocation*>::iterator lruEntry;
+	};
+
+	struct ResourceEntry
+	{
+		ID3D12Resource* pResource;
+		UINT numStandardMips;
+		std::vector<MipAllocation> mips;	// Standard mips, then one entry for the packed mips.
+		std::vector<UINT> pendingUnmaps;	// Indices into mips.
+		std::vector<UINT> pendingMaps;
+	};
+
+	struct Heap
+	{
+		std::vector<bool> used;
+		UINT freeCount;
+	};
+
+	MipAllocation& GetMip(UINT resourceId, UINT mip);
+	const MipAllocation& GetMip(UINT resourceId, UINT mip) const;
+	void Evict(MipAllocation& mip);
+	void Allocate(MipAllocation& mip);
+	void FreeTiles(MipAllocation& mip);
+	void Touch(MipAllocation& mip);
+	D3D12_TILED_RESOURCE_COORDINATE GetTileCoordinate(const MipAllocation& mip, UINT tile) const;
+	void FlushUnmaps(ResourceEntry& resource);
+	void FlushMaps(ResourceEntry& resource);
+	void IssueUpdate(ID3D12Resource* pResource, UINT heapIndex);
+
+	TileMappingBackend* m_pBackend;
+	UINT m_tilesPerHeap;
+	UINT m_maxHeaps;
+	UINT64 m_frame;
+	UINT m_freeTiles;	// Including the tiles of heaps that haven't been created yet.
+
+	// Indexed by resource id. Unregistered resources leave an empty slot.
+	std::vector<std::unique_ptr<ResourceEntry>> m_resources;
+	std::vector<Heap> m_heaps;
+
+	// Resident mips, least recently used first.
+	std::list<MipAllocation*> m_lru;
+
+	// Scratch arrays for building UpdateTileMappings calls, kept to avoid reallocating them.
+	std::vector<D3D12_TILED_RESOURCE_COORDINATE> m_regionStarts;
+	std::vector<D3D12_TILE_REGION_SIZE> m_regionSizes;
+	std::vector<D3D12_TILE_RANGE_FLAGS> m_rangeFlags;
+	std::vector<UINT> m_rangeStarts;
+	std::vector<UINT> m_rangeCounts;
+
+	Statistics m_statistics;
+};
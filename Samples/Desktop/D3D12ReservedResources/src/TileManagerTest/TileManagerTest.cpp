@@ -0,0 +1,568 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Tests and measures the sample's TileManager against a mock backend that records the tile mappings, without a
+// D3D12 device.
+//
+//     TileManagerTest selftest              Check coalescing, eviction and the page tables against the mock.
+//     TileManagerTest benchmark [frames]    Stream the mips of many textures through a small pool and report the
+//                                           time per frame and how many calls, regions and ranges were issued.
+//
+// The mock applies each UpdateTileMappings call the way the runtime would, and fails if a heap tile is ever
+// mapped to two resource tiles at once, if a call's regions and ranges disagree, or if a mapping is out of bounds.
+// The exit code is 0 on success, 1 if the self test fails and 2 for bad arguments.
+
+#include "../TileManager.h"
+#include "../../../Shared/TestHarness.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+	// The tiling of a 32-bit texture with the standard 64KB swizzle: 128x128 pixel tiles, with
+	// mips smaller than a tile packed into one tile.
+	struct TextureTiling
+	{
+		D3D12_PACKED_MIP_INFO packedMipInfo;
+		std::vector<D3D12_SUBRESOURCE_TILING> tilings;
+
+		TextureTiling(UINT width, UINT height)
+		{
+			packedMipInfo = {};
+			while (width >= 128 && height >= 128)
+			{
+				D3D12_SUBRESOURCE_TILING tiling = {};
+				tiling.WidthInTiles = width / 128;
+				tiling.HeightInTiles = static_cast<UINT16>(height / 128);
+				tiling.DepthInTiles = 1;
+				tilings.push_back(tiling);
+				width >>= 1;
+				height >>= 1;
+			}
+			packedMipInfo.NumStandardMips = static_cast<UINT8>(tilings.size());
+			while (width > 0 && height > 0)
+			{
+				packedMipInfo.NumPackedMips++;
+				width >>= 1;
+				height >>= 1;
+			}
+			packedMipInfo.NumTilesForPackedMips = packedMipInfo.NumPackedMips > 0 ? 1 : 0;
+		}
+
+		UINT GetMipCount() const
+		{
+			return packedMipInfo.NumStandardMips + packedMipInfo.NumPackedMips;
+		}
+	};
+
+	// Applies tile mappings like the runtime, and checks them.
+	class MockBackend : public TileMappingBackend
+	{
+	public:
+		// A tile of a resource: the resource, the subresource, and the tile's index in UseBox == FALSE order.
+		typedef std::tuple<ID3D12Resource*, UINT, UINT> ResourceTile;
+		typedef std::pair<UINT, UINT> HeapTile;
+
+		struct CallCounts
+		{
+			UINT calls;
+			UINT regions;
+			UINT ranges;
+		};
+
+		MockBackend(UINT tilesPerHeap) :
+			m_tilesPerHeap(tilesPerHeap),
+			m_heapCount(0),
+			m_counts()
+		{
+		}
+
+		void AddResource(ID3D12Resource* pResource, const TextureTiling* pTiling)
+		{
+			m_resources[pResource] = pTiling;
+		}
+
+		void RemoveResource(ID3D12Resource* pResource)
+		{
+			for (auto it = m_resourceToHeap.begin(); it != m_resourceToHeap.end();)
+			{
+				if (std::get<0>(it->first) == pResource)
+				{
+					m_heapToResource.erase(it->second);
+					it = m_resourceToHeap.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+			m_resources.erase(pResource);
+		}
+
+		virtual void CreateHeap(UINT heapIndex, UINT numTiles) override
+		{
+			Check(heapIndex == m_heapCount, "heaps are created in order");
+			Check(numTiles == m_tilesPerHeap, "heaps have the requested size");
+			m_heapCount++;
+		}
+
+		virtual void UpdateTileMappings(
+			ID3D12Resource* pResource,
+			UINT numRegions,
+			const D3D12_TILED_RESOURCE_COORDINATE* pRegionStartCoordinates,
+			const D3D12_TILE_REGION_SIZE* pRegionSizes,
+			UINT heapIndex,
+			UINT numRanges,
+			const D3D12_TILE_RANGE_FLAGS* pRangeFlags,
+			const UINT* pHeapRangeStartOffsets,
+			const UINT* pRangeTileCounts) override
+		{
+			m_counts.calls++;
+			m_counts.regions += numRegions;
+			m_counts.ranges += numRanges;
+
+			auto resource = m_resources.find(pResource);
+			Check(resource != m_resources.end(), "mapping is for a registered resource");
+			if (resource == m_resources.end())
+			{
+				return;
+			}
+			const TextureTiling& tiling = *resource->second;
+
+			// Expand the regions into resource tiles.
+			std::vector<ResourceTile> resourceTiles;
+			for (UINT i = 0; i < numRegions; i++)
+			{
+				const D3D12_TILED_RESOURCE_COORDINATE& start = pRegionStartCoordinates[i];
+				Check(pRegionSizes[i].UseBox == FALSE && pRegionSizes[i].NumTiles > 0, "regions are non-empty tile runs");
+
+				UINT tileCount;
+				UINT firstTile;
+				if (start.Subresource < tiling.packedMipInfo.NumStandardMips)
+				{
+					const D3D12_SUBRESOURCE_TILING& subresourceTiling = tiling.tilings[start.Subresource];
+					tileCount = subresourceTiling.WidthInTiles * subresourceTiling.HeightInTiles * subresourceTiling.DepthInTiles;
+					firstTile = (start.Z * subresourceTiling.HeightInTiles + start.Y) * subresourceTiling.WidthInTiles + start.X;
+					Check(start.X < subresourceTiling.WidthInTiles && start.Y < subresourceTiling.HeightInTiles, "region starts inside its subresource");
+				}
+				else
+				{
+					Check(start.Subresource == tiling.packedMipInfo.NumStandardMips, "packed mips are addressed through the first packed mip");
+					tileCount = tiling.packedMipInfo.NumTilesForPackedMips;
+					firstTile = start.X;
+				}
+
+				Check(firstTile + pRegionSizes[i].NumTiles <= tileCount, "region ends inside its subresource");
+				for (UINT tile = 0; tile < pRegionSizes[i].NumTiles; tile++)
+				{
+					resourceTiles.push_back(ResourceTile(pResource, start.Subresource, firstTile + tile));
+				}
+			}
+
+			// Expand the ranges into heap tiles, and apply them.
+			UINT rangeTiles = 0;
+			bool allNull = true;
+			for (UINT i = 0; i < numRanges; i++)
+			{
+				allNull = allNull && pRangeFlags[i] == D3D12_TILE_RANGE_FLAG_NULL;
+				Check(pRangeFlags[i] == D3D12_TILE_RANGE_FLAG_NULL || pRangeFlags[i] == D3D12_TILE_RANGE_FLAG_NONE, "ranges map or unmap");
+				Check(pRangeTileCounts[i] > 0, "ranges are non-empty");
+
+				for (UINT tile = 0; tile < pRangeTileCounts[i]; tile++, rangeTiles++)
+				{
+					if (rangeTiles >= resourceTiles.size())
+					{
+						continue;
+					}
+
+					const ResourceTile& resourceTile = resourceTiles[rangeTiles];
+					Unmap(resourceTile);
+
+					if (pRangeFlags[i] == D3D12_TILE_RANGE_FLAG_NONE)
+					{
+						HeapTile heapTile(heapIndex, pHeapRangeStartOffsets[i] + tile);
+						Check(heapIndex < m_heapCount && heapTile.second < m_tilesPerHeap, "mapping is inside a heap");
+						Check(m_heapToResource.find(heapTile) == m_heapToResource.end(), "no heap tile is mapped twice");
+
+						m_heapToResource[heapTile] = resourceTile;
+						m_resourceToHeap[resourceTile] = heapTile;
+					}
+				}
+			}
+
+			Check(rangeTiles == resourceTiles.size(), "regions and ranges cover the same number of tiles");
+			Check(allNull == (heapIndex == TileManager::NullHeap), "unmapping calls, and only those, have no heap");
+		}
+
+		// Returns true if the tile is mapped to the given heap tile.
+		bool IsMappedTo(const ResourceTile& resourceTile, UINT heapIndex, UINT heapOffset) const
+		{
+			auto it = m_resourceToHeap.find(resourceTile);
+			return it != m_resourceToHeap.end() && it->second == HeapTile(heapIndex, heapOffset);
+		}
+
+		size_t GetMappedTileCount() const
+		{
+			return m_resourceToHeap.size();
+		}
+
+		CallCounts TakeCounts()
+		{
+			CallCounts counts = m_counts;
+			m_counts = CallCounts();
+			return counts;
+		}
+
+	private:
+		void Unmap(const ResourceTile& resourceTile)
+		{
+			auto it = m_resourceToHeap.find(resourceTile);
+			if (it != m_resourceToHeap.end())
+			{
+				m_heapToResource.erase(it->second);
+				m_resourceToHeap.erase(it);
+			}
+		}
+
+		UINT m_tilesPerHeap;
+		UINT m_heapCount;
+		std::map<ID3D12Resource*, const TextureTiling*> m_resources;
+		std::map<ResourceTile, HeapTile> m_resourceToHeap;
+		std::map<HeapTile, ResourceTile> m_heapToResource;
+		CallCounts m_counts;
+	};
+
+	ID3D12Resource* FakeResource(UINT index)
+	{
+		return reinterpret_cast<ID3D12Resource*>(static_cast<uintptr_t>(0x1000 + index * 0x100));
+	}
+
+	struct TestResource
+	{
+		ID3D12Resource* pResource;
+		const TextureTiling* pTiling;
+		UINT id;
+		bool registered;
+	};
+
+	UINT Register(TileManager& manager, MockBackend& backend, TestResource& resource, UINT index, const TextureTiling* pTiling)
+	{
+		resource.pResource = FakeResource(index);
+		resource.pTiling = pTiling;
+		resource.registered = true;
+		backend.AddResource(resource.pResource, pTiling);
+		resource.id = manager.RegisterResource(resource.pResource, pTiling->packedMipInfo, pTiling->tilings.data());
+		return resource.id;
+	}
+
+	// Checks that the mock's mappings are exactly the manager's page tables.
+	bool PageTablesMatch(const TileManager& manager, const MockBackend& backend, const std::vector<TestResource>& resources)
+	{
+		size_t residentTiles = 0;
+		for (const TestResource& resource : resources)
+		{
+			if (!resource.registered)
+			{
+				continue;
+			}
+
+			const UINT standardMips = resource.pTiling->packedMipInfo.NumStandardMips;
+			const UINT units = standardMips + (resource.pTiling->packedMipInfo.NumPackedMips > 0 ? 1 : 0);
+			for (UINT mip = 0; mip < units; mip++)
+			{
+				if (!manager.IsResident(resource.id, mip))
+				{
+					continue;
+				}
+
+				for (UINT tile = 0; tile < manager.GetTileCount(resource.id, mip); tile++)
+				{
+					UINT heapIndex;
+					UINT heapOffset;
+					manager.GetTileLocation(resource.id, mip, tile, &heapIndex, &heapOffset);
+					if (!backend.IsMappedTo(MockBackend::ResourceTile(resource.pResource, mip, tile), heapIndex, heapOffset))
+					{
+						return false;
+					}
+					residentTiles++;
+				}
+			}
+		}
+
+		return residentTiles == backend.GetMappedTileCount() && residentTiles == manager.GetStatistics().residentTiles;
+	}
+
+	void TestCoalescing()
+	{
+		const TextureTiling tiling(2048, 2048);	// 16x16 tiles at mip 0.
+		MockBackend backend(1024);
+		TileManager manager(&backend, 1024, 4);
+		std::vector<TestResource> resources(1);
+		const UINT id = Register(manager, backend, resources[0], 0, &tiling);
+
+		bool newlyResident;
+		Check(manager.MakeResident(id, 0, &newlyResident) && newlyResident, "mip 0 fits in an empty pool");
+		manager.Flush();
+
+		MockBackend::CallCounts counts = backend.TakeCounts();
+		Check(counts.calls == 1 && counts.regions == 1 && counts.ranges == 1, "a mip in an empty pool is mapped with one region and one range");
+
+		// Every other mip, including the packed ones, in one flush: one call, one region per mip, one range.
+		for (UINT mip = 1; mip < tiling.GetMipCount(); mip++)
+		{
+			Check(manager.MakeResident(id, mip, &newlyResident), "the rest of the mips fit");
+		}
+		manager.Flush();
+
+		counts = backend.TakeCounts();
+		Check(counts.calls == 1 && counts.regions == tiling.packedMipInfo.NumStandardMips && counts.ranges == 1, "a batch of mips is one call with contiguous heap tiles");
+
+		Check(manager.MakeResident(id, 0, &newlyResident) && !newlyResident, "a resident mip doesn't need to be uploaded again");
+		manager.Flush();
+		Check(backend.TakeCounts().calls == 0, "flushing with nothing to do makes no calls");
+
+		Check(PageTablesMatch(manager, backend, resources), "page tables match the mappings after coalescing");
+	}
+
+	void TestHeapSpanning()
+	{
+		const TextureTiling tiling(2048, 2048);	// 256 tiles at mip 0.
+		MockBackend backend(100);
+		TileManager manager(&backend, 100, 3);
+		std::vector<TestResource> resources(1);
+		const UINT id = Register(manager, backend, resources[0], 0, &tiling);
+
+		bool newlyResident;
+		Check(manager.MakeResident(id, 0, &newlyResident), "a mip may span heaps");
+		manager.Flush();
+
+		MockBackend::CallCounts counts = backend.TakeCounts();
+		Check(counts.calls == 3 && counts.regions == 3 && counts.ranges == 3, "a mip spanning three heaps is three calls");
+		Check(manager.GetStatistics().heapCount == 3, "heaps are created on demand");
+
+		Check(!manager.MakeResident(id, 1, &newlyResident), "mips used this frame are not evicted");
+		Check(manager.IsResident(id, 0), "a failed request evicts nothing");
+
+		Check(PageTablesMatch(manager, backend, resources), "page tables match the mappings across heaps");
+	}
+
+	void TestEviction()
+	{
+		const TextureTiling tiling(512, 512);	// 16 tiles at mip 0.
+		MockBackend backend(16);
+		TileManager manager(&backend, 16, 2);
+		std::vector<TestResource> resources(3);
+		for (UINT i = 0; i < 3; i++)
+		{
+			Register(manager, backend, resources[i], i, &tiling);
+		}
+
+		bool newlyResident;
+		Check(manager.MakeResident(resources[0].id, 0, &newlyResident), "first mip fits");
+		manager.NextFrame();
+		Check(manager.MakeResident(resources[1].id, 0, &newlyResident), "second mip fits");
+		manager.NextFrame();
+
+		// Resource 0 was used longest ago, but touch it so that resource 1 becomes the oldest.
+		manager.MarkUsed(resources[0].id, 0);
+		Check(manager.MakeResident(resources[2].id, 0, &newlyResident), "third mip evicts the least recently used one");
+		manager.Flush();
+
+		Check(manager.IsResident(resources[0].id, 0) && !manager.IsResident(resources[1].id, 0) && manager.IsResident(resources[2].id, 0), "the least recently used mip was evicted");
+		Check(manager.GetStatistics().evictedTiles == 16, "one mip's worth of tiles was evicted");
+		Check(PageTablesMatch(manager, backend, resources), "page tables match the mappings after eviction");
+
+		// Bring the evicted mip back. Both others were used this frame, so there's no room.
+		Check(!manager.MakeResident(resources[1].id, 0, &newlyResident), "mips used this frame are protected");
+		manager.NextFrame();
+		manager.MarkUsed(resources[2].id, 0);
+		Check(manager.MakeResident(resources[1].id, 0, &newlyResident) && newlyResident, "the evicted mip comes back and must be uploaded");
+		manager.Flush();
+
+		Check(!manager.IsResident(resources[0].id, 0), "the next least recently used mip was evicted");
+		Check(PageTablesMatch(manager, backend, resources), "page tables match the mappings after reloading");
+
+		// A mip evicted before it was ever flushed is never mapped or unmapped.
+		manager.NextFrame();
+		Check(manager.MakeResident(resources[0].id, 1, &newlyResident), "mip 1 fits");
+		manager.NextFrame();
+		manager.NextFrame();
+		Check(manager.MakeResident(resources[0].id, 0, &newlyResident), "mip 0 evicts the rest");
+		backend.TakeCounts();
+		manager.Flush();
+		Check(PageTablesMatch(manager, backend, resources), "page tables match after evicting an unflushed mip");
+	}
+
+	void TestRandom()
+	{
+		const TextureTiling tilings[] =
+		{
+			TextureTiling(1024, 1024),
+			TextureTiling(2048, 512),
+			TextureTiling(256, 256),
+			TextureTiling(512, 128),
+			TextureTiling(64, 64),	// Only packed mips.
+		};
+
+		MockBackend backend(48);
+		TileManager manager(&backend, 48, 3);
+		std::vector<TestResource> resources(24);
+		std::mt19937 random(7);
+
+		for (UINT i = 0; i < resources.size(); i++)
+		{
+			Register(manager, backend, resources[i], i, &tilings[i % (sizeof(tilings) / sizeof(tilings[0]))]);
+		}
+
+		UINT mappedTiles = 0;
+		for (UINT step = 0; step < 20000 && TestHarness::GetFailures() == 0; step++)
+		{
+			TestResource& resource = resources[random() % resources.size()];
+			switch (random() % 16)
+			{
+			case 0:
+				manager.NextFrame();
+				break;
+
+			case 1:
+				manager.Flush();
+				Check(PageTablesMatch(manager, backend, resources), "page tables match the mappings after a random flush");
+				break;
+
+			case 2:
+				// Replace the resource with a new one, as if a texture was unloaded and another loaded.
+				if (resource.registered)
+				{
+					manager.Flush();
+					manager.UnregisterResource(resource.id);
+					backend.RemoveResource(resource.pResource);
+					resource.registered = false;
+				}
+				else
+				{
+					Register(manager, backend, resource, static_cast<UINT>(&resource - &resources[0]) + 1000 * step, &tilings[random() % (sizeof(tilings) / sizeof(tilings[0]))]);
+				}
+				break;
+
+			default:
+				if (resource.registered)
+				{
+					UINT mip = random() % resource.pTiling->GetMipCount();
+					bool newlyResident;
+					if (manager.MakeResident(resource.id, mip, &newlyResident) && newlyResident)
+					{
+						mappedTiles += manager.GetTileCount(resource.id, mip);
+					}
+				}
+				break;
+			}
+		}
+
+		manager.Flush();
+		Check(PageTablesMatch(manager, backend, resources), "page tables match the mappings at the end");
+		printf("random: %u tiles made resident, %llu evicted, %u heaps\n", mappedTiles, static_cast<unsigned long long>(manager.GetStatistics().evictedTiles), manager.GetStatistics().heapCount);
+	}
+
+	int RunSelfTest()
+	{
+		TestCoalescing();
+		TestHeapSpanning();
+		TestEviction();
+		TestRandom();
+
+		return 0;
+	}
+
+	// Streams the mips of many 4096x4096 textures through a 256MB pool, as a camera moving over
+	// them would: each frame a window of textures wants a mip that depends on its distance.
+	int RunBenchmark(UINT frames)
+	{
+		const UINT textureCount = 256;
+		const UINT tilesPerHeap = 1024;	// 64MB.
+		const UINT maxHeaps = 4;
+		const TextureTiling tiling(4096, 4096);
+
+		MockBackend backend(tilesPerHeap);
+		TileManager manager(&backend, tilesPerHeap, maxHeaps);
+		std::vector<TestResource> resources(textureCount);
+		for (UINT i = 0; i < textureCount; i++)
+		{
+			Register(manager, backend, resources[i], i, &tiling);
+		}
+
+		UINT64 requests = 0;
+		UINT64 failures = 0;
+		double seconds = 0.0;
+		for (UINT frame = 0; frame < frames; frame++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+
+			const UINT first = (frame / 4) % textureCount;
+			for (UINT i = 0; i < 32; i++)
+			{
+				const UINT distance = (i < 16) ? 16 - i : i - 16;
+				const UINT wantedMip = 2 + distance / 3;
+				TestResource& resource = resources[(first + i) % textureCount];
+
+				// Load from the least detailed mip up to the wanted one, as a streaming system would.
+				for (UINT mip = tiling.GetMipCount() - 1; mip + 1 > wantedMip; mip--)
+				{
+					bool newlyResident;
+					requests++;
+					if (!manager.MakeResident(resource.id, mip, &newlyResident))
+					{
+						failures++;
+						break;
+					}
+				}
+			}
+			manager.Flush();
+			manager.NextFrame();
+
+			seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+		const TileManager::Statistics& statistics = manager.GetStatistics();
+		printf("%u frames, %llu requests (%llu refused), %.2f us per frame (including the mock)\n",
+			frames, static_cast<unsigned long long>(requests), static_cast<unsigned long long>(failures), seconds * 1e6 / frames);
+		printf("tiles mapped %llu, evicted %llu\n", static_cast<unsigned long long>(statistics.mappedTiles), static_cast<unsigned long long>(statistics.evictedTiles));
+		printf("UpdateTileMappings calls %llu, regions %llu, ranges %llu (%.1f tiles per region, %.1f per range)\n",
+			static_cast<unsigned long long>(statistics.updateCalls), static_cast<unsigned long long>(statistics.regions), static_cast<unsigned long long>(statistics.ranges),
+			static_cast<double>(statistics.mappedTiles + statistics.evictedTiles) / statistics.regions,
+			static_cast<double>(statistics.mappedTiles + statistics.evictedTiles) / statistics.ranges);
+
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	static const TestHarness::Command commands[] =
+	{
+		{ "selftest", "", 0, [](int, char**) { return RunSelfTest(); } },
+		{ "benchmark", "[frames]", 1, [](int argCount, char** ppArgs)
+		{
+			const uint32_t frames = TestHarness::GetCountArgument(argCount, ppArgs, 0, 2000);
+			return (frames > 0) ? RunBenchmark(frames) : TestHarness::BadArguments;
+		} },
+	};
+	return TestHarness::RunCommand(argc, argv, "TileManagerTest", commands);
+}
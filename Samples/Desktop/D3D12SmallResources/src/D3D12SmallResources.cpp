@@ -339,14 +339,25 @@ void D3D12SmallResources::LoadAssets()
 		WaitForGpu();
 	}
 
+	// Placed textures are sub-allocated from shared heaps.
+	m_placementDevice.reset(new PlacementDevice(this));
+	m_textureAllocator.reset(new SmallResourceAllocator(m_placementDevice.get(), TextureHeapSize));
+
 	CreateTextures();
 }
 
 void D3D12SmallResources::CreateTextures()
 {
+	// Return the previous textures' space to the allocator, and release its heaps if they are
+	// no longer needed.
+	for (const SmallResourceAllocator::Allocation& allocation : m_textureAllocations)
+	{
+		m_textureAllocator->Free(allocation);
+	}
+	m_textureAllocations.clear();
 	m_textures.clear();
 	m_textures.resize(TextureCount);
-	m_textureHeap.Reset();
+	m_textureAllocator->ReleaseEmptyHeaps();
 
 	ThrowIfFailed(m_copyCommandAllocator->Reset());
 	ThrowIfFailed(m_copyCommandList->Reset(m_copyCommandAllocator.Get(), nullptr));
@@ -362,28 +373,21 @@ void D3D12SmallResources::CreateTextures()
 		// When dealing with MSAA textures the rules are similar, but the minimum
 		// alignment is 64KB for a texture whose most detailed mip can fit in an
 		// allocation less than 4MB.
-		textureDesc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
-		D3D12_RESOURCE_ALLOCATION_INFO info = m_device->GetResourceAllocationInfo(0, 1, &textureDesc);
-
-		if (info.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
-		{
-			// If the alignment requested is not granted, then let D3D tell us
-			// the alignment that needs to be used for these resources.
-			textureDesc.Alignment = 0;
-			info = m_device->GetResourceAllocationInfo(0, 1, &textureDesc);
-		}
-
-		const UINT64 heapSize = TextureCount * info.SizeInBytes;
-		CD3DX12_HEAP_DESC heapDesc(heapSize, D3D12_HEAP_TYPE_DEFAULT, 0, D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES);
-		ThrowIfFailed(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_textureHeap)));
+		//
+		// The allocator requests the small alignment, falls back to the default
+		// alignment if the device doesn't grant it, and packs the textures into
+		// shared heaps. It updates textureDesc.Alignment to match.
+		m_textureAllocations.resize(TextureCount);
 
 		std::vector<D3D12_RESOURCE_BARRIER> barriers;
 		barriers.resize(TextureCount);
 		for (UINT n = 0; n < TextureCount; n++)
 		{
+			m_textureAllocations[n] = m_textureAllocator->Allocate(&textureDesc);
+
 			ThrowIfFailed(m_device->CreatePlacedResource(
-				m_textureHeap.Get(),
-				n * info.SizeInBytes,
+				m_textureHeaps[m_textureAllocations[n].heapIndex].Get(),
+				m_textureAllocations[n].offset,
 				&textureDesc,
 				D3D12_RESOURCE_STATE_COMMON,
 				nullptr,
@@ -677,3 +681,24 @@ void D3D12SmallResources::MoveToNextFrame()
 	// Set the fence value for the next frame.
 	m_fenceValues[m_frameIndex] = currentFenceValue + 1;
 }
+
+D3D12_RESOURCE_ALLOCATION_INFO D3D12SmallResources::PlacementDevice::GetResourceAllocationInfo(const D3D12_RESOURCE_DESC& desc)
+{
+	return m_pSample->m_device->GetResourceAllocationInfo(0, 1, &desc);
+}
+
+void D3D12SmallResources::PlacementDevice::CreateHeap(UINT heapIndex, UINT64 sizeInBytes, D3D12_HEAP_FLAGS flags)
+{
+	if (heapIndex >= m_pSample->m_textureHeaps.size())
+	{
+		m_pSample->m_textureHeaps.resize(heapIndex + 1);
+	}
+
+	CD3DX12_HEAP_DESC heapDesc(sizeInBytes, D3D12_HEAP_TYPE_DEFAULT, 0, flags);
+	ThrowIfFailed(m_pSample->m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_pSample->m_textureHeaps[heapIndex])));
+}
+
+void D3D12SmallResources::PlacementDevice::DestroyHeap(UINT heapIndex)
+{
+	m_pSample->m_textureHeaps[heapIndex].Reset();
+}
@@ -12,6 +12,7 @@
 #pragma once
 
 #include "DXSample.h"
+#include "SmallResourceAllocator.h"
 
 using namespace DirectX;
 
@@ -43,6 +44,21 @@ private:
 	static const UINT TextureWidth = 32;
 	static const UINT TextureHeight = 32;
 	static const UINT TexturePixelSizeInBytes = 4;
+	static const UINT64 TextureHeapSize = 512 * 1024;
+
+	// Answers the allocator's queries with the device, and creates the heaps it asks for.
+	class PlacementDevice : public PlacementBackend
+	{
+	public:
+		PlacementDevice(D3D12SmallResources* pSample) : m_pSample(pSample) {}
+
+		virtual D3D12_RESOURCE_ALLOCATION_INFO GetResourceAllocationInfo(const D3D12_RESOURCE_DESC& desc) override;
+		virtual void CreateHeap(UINT heapIndex, UINT64 sizeInBytes, D3D12_HEAP_FLAGS flags) override;
+		virtual void DestroyHeap(UINT heapIndex) override;
+
+	private:
+		D3D12SmallResources* m_pSample;
+	};
 
 	// Vertex definition.
 	struct Vertex
@@ -80,7 +96,10 @@ private:
 	ComPtr<ID3D12GraphicsCommandList> m_copyCommandList;
 	ComPtr<ID3D12Resource> m_vertexBuffer;
 	std::vector<ComPtr<ID3D12Resource>> m_textures;
-	ComPtr<ID3D12Heap> m_textureHeap;		// Only used when the resources being drawn are placed resources.
+	std::vector<SmallResourceAllocator::Allocation> m_textureAllocations;
+	std::vector<ComPtr<ID3D12Heap>> m_textureHeaps;		// Only used when the resources being drawn are placed resources.
+	std::unique_ptr<PlacementDevice> m_placementDevice;
+	std::unique_ptr<SmallResourceAllocator> m_textureAllocator;
 	bool m_usePlacedResources;
 	D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
 
@@ -0,0 +1,343 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// This file doesn't use the precompiled header so that SmallResourceAllocatorTest can share it.
+#include "SmallResourceAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+
+namespace
+{
+	// Returns the smallest n such that (1 << n) >= value.
+	UINT CeilLog2(UINT64 value)
+	{
+		UINT order = 0;
+		while ((1ull << order) < value)
+		{
+			order++;
+		}
+		return order;
+	}
+
+	UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+SmallResourceAllocator::SmallResourceAllocator(PlacementBackend* pBackend, UINT64 heapSize) :
+	m_pBackend(pBackend),
+	m_heapSize(heapSize),
+	m_maxOrder(CeilLog2(heapSize / PageSize)),
+	m_statistics()
+{
+	assert(heapSize >= PageSize && (PageSize << m_maxOrder) == heapSize);
+}
+
+SmallResourceAllocator::Allocation SmallResourceAllocator::Allocate(D3D12_RESOURCE_DESC* pDesc)
+{
+	const D3D12_RESOURCE_ALLOCATION_INFO info = QueryAllocationInfo(pDesc);
+
+	HeapCategory category = HeapCategory_Textures;
+	if (pDesc->Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+	{
+		category = HeapCategory_Buffers;
+	}
+	else if (pDesc->Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+	{
+		category = HeapCategory_RenderTargets;
+	}
+
+	Allocation allocation = {};
+	allocation.requestedSize = info.SizeInBytes;
+	allocation.alignment = info.Alignment;
+	allocation.smallAlignment = (pDesc->Alignment != 0);
+
+	// The block must be large enough for the resource, and, since buddy blocks are aligned to
+	// their size, at least as large as its alignment.
+	const UINT pageCount = static_cast<UINT>((info.SizeInBytes + PageSize - 1) / PageSize);
+	const UINT order = CeilLog2(std::max(static_cast<UINT64>(pageCount), info.Alignment / PageSize));
+
+	if (order > m_maxOrder)
+	{
+		allocation.sizeInBytes = AlignUp(info.SizeInBytes, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+		allocation.heapIndex = CreateHeap(category, allocation.sizeInBytes, true);
+		allocation.offset = 0;
+		allocation.dedicatedHeap = true;
+	}
+	else
+	{
+		// Use the first heap with a block that's large enough.
+		UINT heapIndex = UINT_MAX;
+		for (UINT n = 0; n < m_heaps.size(); n++)
+		{
+			const Heap& heap = m_heaps[n];
+			if (heap.live && !heap.dedicated && heap.category == category && (heap.freeOrderMask >> order) != 0)
+			{
+				heapIndex = n;
+				break;
+			}
+		}
+
+		if (heapIndex == UINT_MAX)
+		{
+			heapIndex = CreateHeap(category, m_heapSize, false);
+		}
+
+		allocation.heapIndex = heapIndex;
+		allocation.offset = TakeBlock(m_heaps[heapIndex], order, pageCount) * PageSize;
+		allocation.sizeInBytes = pageCount * PageSize;
+		allocation.dedicatedHeap = false;
+	}
+
+	m_statistics.allocationCount++;
+	m_statistics.smallAlignmentCount += allocation.smallAlignment ? 1 : 0;
+	m_statistics.requestedBytes += allocation.requestedSize;
+	m_statistics.allocatedBytes += allocation.sizeInBytes;
+	m_statistics.defaultAlignedBytes += AlignUp(allocation.requestedSize, std::max<UINT64>(allocation.alignment, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+
+	return allocation;
+}
+
+void SmallResourceAllocator::Free(const Allocation& allocation)
+{
+	Heap& heap = m_heaps[allocation.heapIndex];
+	assert(heap.live);
+
+	if (allocation.dedicatedHeap)
+	{
+		m_pBackend->DestroyHeap(allocation.heapIndex);
+		heap.live = false;
+		m_unusedHeapIndices.push_back(allocation.heapIndex);
+		m_statistics.dedicatedHeapCount--;
+		m_statistics.heapCount--;
+		m_statistics.heapBytes -= heap.sizeInBytes;
+	}
+	else
+	{
+		FreePages(heap, static_cast<UINT>(allocation.offset / PageSize), static_cast<UINT>(allocation.sizeInBytes / PageSize));
+	}
+
+	m_statistics.allocationCount--;
+	m_statistics.smallAlignmentCount -= allocation.smallAlignment ? 1 : 0;
+	m_statistics.requestedBytes -= allocation.requestedSize;
+	m_statistics.allocatedBytes -= allocation.sizeInBytes;
+	m_statistics.defaultAlignedBytes -= AlignUp(allocation.requestedSize, std::max<UINT64>(allocation.alignment, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+}
+
+void SmallResourceAllocator::ReleaseEmptyHeaps()
+{
+	for (UINT n = 0; n < m_heaps.size(); n++)
+	{
+		Heap& heap = m_heaps[n];
+		if (heap.live && !heap.dedicated && heap.usedPages == 0)
+		{
+			m_pBackend->DestroyHeap(n);
+			heap.live = false;
+			heap.freeBlocks.clear();
+			m_unusedHeapIndices.push_back(n);
+			m_statistics.heapCount--;
+			m_statistics.heapBytes -= heap.sizeInBytes;
+		}
+	}
+}
+
+SmallResourceAllocator::Statistics SmallResourceAllocator::GetStatistics() const
+{
+	Statistics statistics = m_statistics;
+	statistics.freeBytes = 0;
+	statistics.largestFreeBlock = 0;
+	statistics.largestFreeBlockBytes = 0;
+
+	for (const Heap& heap : m_heaps)
+	{
+		if (heap.live && !heap.dedicated && heap.freeOrderMask != 0)
+		{
+			UINT order = m_maxOrder;
+			while (!(heap.freeOrderMask & (1u << order)))
+			{
+				order--;
+			}
+
+			statistics.freeBytes += heap.sizeInBytes - heap.usedPages * PageSize;
+			statistics.largestFreeBlock = std::max(statistics.largestFreeBlock, PageSize << order);
+			statistics.largestFreeBlockBytes += PageSize << order;
+		}
+	}
+
+	return statistics;
+}
+
+// Picks the placement alignment for a resource, preferring the small alignment when the device
+// grants it, and records the choice in pDesc->Alignment.
+D3D12_RESOURCE_ALLOCATION_INFO SmallResourceAllocator::QueryAllocationInfo(D3D12_RESOURCE_DESC* pDesc)
+{
+	// Buffers are always 64KB aligned. Textures may use 4KB alignment if they aren't render
+	// targets or depth stencils and their most detailed mip fits in 64KB. MSAA textures may use
+	// 64KB alignment rather than 4MB if their most detailed mip fits in 4MB.
+	UINT64 smallAlignment = 0;
+	if (pDesc->Dimension != D3D12_RESOURCE_DIMENSION_BUFFER)
+	{
+		if (pDesc->SampleDesc.Count > 1)
+		{
+			smallAlignment = D3D12_SMALL_MSAA_RESOURCE_PLACEMENT_ALIGNMENT;
+		}
+		else if (!(pDesc->Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)))
+		{
+			smallAlignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+		}
+	}
+
+	if (smallAlignment != 0)
+	{
+		pDesc->Alignment = smallAlignment;
+		D3D12_RESOURCE_ALLOCATION_INFO info = m_pBackend->GetResourceAllocationInfo(*pDesc);
+		if (info.Alignment == smallAlignment)
+		{
+			return info;
+		}
+	}
+
+	// If the alignment requested is not granted, let D3D choose the alignment.
+	pDesc->Alignment = 0;
+	return m_pBackend->GetResourceAllocationInfo(*pDesc);
+}
+
+UINT SmallResourceAllocator::CreateHeap(HeapCategory category, UINT64 sizeInBytes, bool dedicated)
+{
+	UINT heapIndex;
+	if (!m_unusedHeapIndices.empty())
+	{
+		heapIndex = m_unusedHeapIndices.back();
+		m_unusedHeapIndices.pop_back();
+	}
+	else
+	{
+		heapIndex = static_cast<UINT>(m_heaps.size());
+		m_heaps.push_back(Heap());
+	}
+
+	D3D12_HEAP_FLAGS flags = D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES;
+	if (category == HeapCategory_Buffers)
+	{
+		flags = D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES | D3D12_HEAP_FLAG_DENY_NON_RT_DS_TEXTURES;
+	}
+	else if (category == HeapCategory_RenderTargets)
+	{
+		flags = D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_NON_RT_DS_TEXTURES;
+	}
+	m_pBackend->CreateHeap(heapIndex, sizeInBytes, flags);
+
+	Heap& heap = m_heaps[heapIndex];
+	heap.live = true;
+	heap.dedicated = dedicated;
+	heap.category = category;
+	heap.sizeInBytes = sizeInBytes;
+	heap.freeOrderMask = 0;
+	heap.freeBlocks.clear();
+
+	if (dedicated)
+	{
+		heap.usedPages = static_cast<UINT>(sizeInBytes / PageSize);
+		m_statistics.dedicatedHeapCount++;
+	}
+	else
+	{
+		// The whole heap starts out as one free block.
+		heap.usedPages = 0;
+		heap.freeBlocks.resize(m_maxOrder + 1);
+		heap.freeBlocks[m_maxOrder].insert(0);
+		heap.freeOrderMask = 1u << m_maxOrder;
+	}
+
+	m_statistics.heapCount++;
+	m_statistics.heapBytes += sizeInBytes;
+	return heapIndex;
+}
+
+// Takes the smallest free block of at least 'order' from the heap, splitting larger blocks as
+// needed, and frees the pages past the first pageCount. Returns the first page.
+UINT SmallResourceAllocator::TakeBlock(Heap& heap, UINT order, UINT pageCount)
+{
+	UINT blockOrder = order;
+	while (!(heap.freeOrderMask & (1u << blockOrder)))
+	{
+		blockOrder++;
+	}
+
+	// Use the lowest block of that size, to keep the top of the heap free for large blocks.
+	std::set<UINT>& freeBlocks = heap.freeBlocks[blockOrder];
+	const UINT page = *freeBlocks.begin();
+	freeBlocks.erase(freeBlocks.begin());
+	if (freeBlocks.empty())
+	{
+		heap.freeOrderMask &= ~(1u << blockOrder);
+	}
+
+	// Split the block, freeing the upper halves.
+	while (blockOrder > order)
+	{
+		blockOrder--;
+		heap.freeBlocks[blockOrder].insert(page + (1u << blockOrder));
+		heap.freeOrderMask |= 1u << blockOrder;
+	}
+
+	heap.usedPages += 1u << order;
+	FreePages(heap, page + pageCount, (1u << order) - pageCount);
+	return page;
+}
+
+// Frees a run of pages by splitting it into the largest aligned blocks it contains.
+void SmallResourceAllocator::FreePages(Heap& heap, UINT firstPage, UINT pageCount)
+{
+	heap.usedPages -= pageCount;
+
+	const UINT endPage = firstPage + pageCount;
+	while (firstPage < endPage)
+	{
+		UINT order = 0;
+		while (order < m_maxOrder && (firstPage & ((2u << order) - 1)) == 0 && firstPage + (2u << order) <= endPage)
+		{
+			order++;
+		}
+
+		FreeBlock(heap, firstPage, order);
+		firstPage += 1u << order;
+	}
+}
+
+// Returns a block to the heap, merging it with its buddy for as long as the buddy is free.
+void SmallResourceAllocator::FreeBlock(Heap& heap, UINT page, UINT order)
+{
+	while (order < m_maxOrder)
+	{
+		std::set<UINT>& freeBlocks = heap.freeBlocks[order];
+		auto buddy = freeBlocks.find(page ^ (1u << order));
+		if (buddy == freeBlocks.end())
+		{
+			break;
+		}
+
+		freeBlocks.erase(buddy);
+		if (freeBlocks.empty())
+		{
+			heap.freeOrderMask &= ~(1u << order);
+		}
+
+		page &= ~(1u << order);
+		order++;
+	}
+
+	heap.freeBlocks[order].insert(page);
+	heap.freeOrderMask |= 1u << order;
+}
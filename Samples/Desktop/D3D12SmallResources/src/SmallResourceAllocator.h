@@ -0,0 +1,126 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <d3d12.h>
+#include <set>
+#include <vector>
+
+// Answers allocation queries and creates the heaps requested by a SmallResourceAllocator. The
+// sample forwards these to the device; SmallResourceAllocatorTest fakes them instead.
+class PlacementBackend
+{
+public:
+	virtual ~PlacementBackend() {}
+
+	// As ID3D12Device::GetResourceAllocationInfo, for a single resource.
+	virtual D3D12_RESOURCE_ALLOCATION_INFO GetResourceAllocationInfo(const D3D12_RESOURCE_DESC& desc) = 0;
+
+	// Creates heap 'heapIndex'. An index may be reused once its heap has been destroyed.
+	virtual void CreateHeap(UINT heapIndex, UINT64 sizeInBytes, D3D12_HEAP_FLAGS flags) = 0;
+	virtual void DestroyHeap(UINT heapIndex) = 0;
+};
+
+// Places resources in shared heaps, using 4KB placement alignment wherever the device grants it.
+//
+// For each resource the allocator asks for the small placement alignment (4KB, or 64KB for
+// MSAA textures) and falls back to the default alignment when the device refuses, as
+// D3D12SmallResources::CreateTextures did by hand. Resources are then packed into heaps of
+// heapSize bytes with a buddy allocator over 4KB pages: an allocation takes the smallest free
+// power of two block that fits it and its alignment, and gives the unused pages at the end of
+// the block straight back, so that a 12KB texture uses 12KB rather than 16KB. Buffers, render
+// targets and other textures are kept in separate heaps so that the allocator works on resource
+// heap tier 1 hardware. Resources larger than a heap get a heap of their own.
+class SmallResourceAllocator
+{
+public:
+	static const UINT64 PageSize = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+
+	struct Allocation
+	{
+		UINT heapIndex;
+		UINT64 offset;
+		UINT64 sizeInBytes;			// The space reserved in the heap, a multiple of PageSize.
+		UINT64 requestedSize;		// The size reported by GetResourceAllocationInfo.
+		UINT64 alignment;
+		bool smallAlignment;		// The device granted the small placement alignment.
+		bool dedicatedHeap;
+	};
+
+	struct Statistics
+	{
+		UINT heapCount;
+		UINT dedicatedHeapCount;
+		UINT64 heapBytes;
+		UINT64 allocationCount;
+		UINT64 smallAlignmentCount;	// Allocations that were granted the small placement alignment.
+		UINT64 requestedBytes;
+		UINT64 allocatedBytes;
+		UINT64 defaultAlignedBytes;	// What the allocations would take at 64KB placement alignment.
+		UINT64 freeBytes;			// Free space in the shared heaps.
+		UINT64 largestFreeBlock;
+		UINT64 largestFreeBlockBytes;	// The sum of the largest free block in each shared heap.
+
+		// The share of the heaps that doesn't hold resource data.
+		double GetWaste() const { return heapBytes ? 1.0 - static_cast<double>(requestedBytes) / heapBytes : 0.0; }
+
+		// The share of free space that isn't part of the largest free block in its heap.
+		double GetFragmentation() const { return freeBytes ? 1.0 - static_cast<double>(largestFreeBlockBytes) / freeBytes : 0.0; }
+	};
+
+	// heapSize must be a power of two multiple of PageSize.
+	SmallResourceAllocator(PlacementBackend* pBackend, UINT64 heapSize);
+
+	// Finds room for a resource. pDesc->Alignment is set to the alignment the allocation was
+	// made for, and pDesc must be passed to CreatePlacedResource as it is.
+	Allocation Allocate(D3D12_RESOURCE_DESC* pDesc);
+
+	// Frees an allocation. The resource placed there must no longer be in use.
+	void Free(const Allocation& allocation);
+
+	// Destroys shared heaps that have nothing placed in them.
+	void ReleaseEmptyHeaps();
+
+	Statistics GetStatistics() const;
+
+private:
+	enum HeapCategory
+	{
+		HeapCategory_Buffers,
+		HeapCategory_Textures,
+		HeapCategory_RenderTargets,
+	};
+
+	struct Heap
+	{
+		bool live;
+		bool dedicated;
+		HeapCategory category;
+		UINT64 sizeInBytes;
+		UINT usedPages;
+		UINT freeOrderMask;					// Bit n is set if freeBlocks[n] isn't empty.
+		std::vector<std::set<UINT>> freeBlocks;	// The first page of each free block, by order.
+	};
+
+	D3D12_RESOURCE_ALLOCATION_INFO QueryAllocationInfo(D3D12_RESOURCE_DESC* pDesc);
+	UINT CreateHeap(HeapCategory category, UINT64 sizeInBytes, bool dedicated);
+	UINT TakeBlock(Heap& heap, UINT order, UINT pageCount);
+	void FreePages(Heap& heap, UINT firstPage, UINT pageCount);
+	void FreeBlock(Heap& heap, UINT page, UINT order);
+
+	PlacementBackend* m_pBackend;
+	UINT64 m_heapSize;
+	UINT m_maxOrder;						// The order of a whole shared heap.
+	std::vector<Heap> m_heaps;
+	std::vector<UINT> m_unusedHeapIndices;
+	Statistics m_statistics;
+};
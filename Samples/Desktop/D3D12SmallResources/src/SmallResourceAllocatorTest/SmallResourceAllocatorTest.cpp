@@ -0,0 +1,484 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Tests and measures the sample's SmallResourceAllocator against a fake device, without a GPU.
+//
+//     SmallResourceAllocatorTest selftest                 Check alignment, packing and heap reuse.
+//     SmallResourceAllocatorTest benchmark [resources]    Allocate and free a mix of textures and buffers, and
+//                                                         report the time taken, waste and fragmentation.
+//
+// The fake device sizes resources roughly as a driver would: textures whose most detailed mip fits in 64KB are
+// granted 4KB alignment and rounded up to 4KB, and everything else is rounded up to 64KB. The test checks every
+// placement against the heaps it has created, and fails if allocations overlap, are misaligned, fall outside their
+// heap or land in a heap that denies their kind of resource.
+// The exit code is 0 on success, 1 if the self test fails and 2 for bad arguments.
+
+#include "../SmallResourceAllocator.h"
+#include "../../../Shared/TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+	UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	UINT BitsPerPixel(DXGI_FORMAT format)
+	{
+		return (format == DXGI_FORMAT_BC1_UNORM) ? 4 : 32;
+	}
+
+	D3D12_RESOURCE_DESC Texture2D(UINT width, UINT height, UINT16 mipLevels, DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM, D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE, UINT sampleCount = 1)
+	{
+		D3D12_RESOURCE_DESC desc = {};
+		desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+		desc.Width = width;
+		desc.Height = height;
+		desc.DepthOrArraySize = 1;
+		desc.MipLevels = mipLevels;
+		desc.Format = format;
+		desc.SampleDesc.Count = sampleCount;
+		desc.Flags = flags;
+		return desc;
+	}
+
+	D3D12_RESOURCE_DESC Buffer(UINT64 size)
+	{
+		D3D12_RESOURCE_DESC desc = {};
+		desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		desc.Width = size;
+		desc.Height = 1;
+		desc.DepthOrArraySize = 1;
+		desc.MipLevels = 1;
+		desc.SampleDesc.Count = 1;
+		desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		return desc;
+	}
+
+	// Stands in for the device, and checks what the allocator does with the heaps it creates.
+	class FakeDevice : public PlacementBackend
+	{
+	public:
+		struct HeapRecord
+		{
+			bool live;
+			UINT64 sizeInBytes;
+			D3D12_HEAP_FLAGS flags;
+			std::map<UINT64, UINT64> allocations;	// Offset to end.
+		};
+
+		UINT createdHeaps;
+		UINT destroyedHeaps;
+		std::vector<HeapRecord> heaps;
+
+		FakeDevice() :
+			createdHeaps(0),
+			destroyedHeaps(0)
+		{
+		}
+
+		virtual D3D12_RESOURCE_ALLOCATION_INFO GetResourceAllocationInfo(const D3D12_RESOURCE_DESC& desc) override
+		{
+			D3D12_RESOURCE_ALLOCATION_INFO info = {};
+			if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+			{
+				info.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+				info.SizeInBytes = AlignUp(desc.Width, info.Alignment);
+				return info;
+			}
+
+			UINT64 mostDetailedMip = 0;
+			UINT64 size = 0;
+			UINT64 width = desc.Width;
+			UINT64 height = desc.Height;
+			for (UINT mip = 0; mip < desc.MipLevels; mip++)
+			{
+				// Block compressed mips are at least one 4x4 block.
+				UINT64 mipSize = (desc.Format == DXGI_FORMAT_BC1_UNORM)
+					? std::max<UINT64>((width + 3) / 4, 1) * std::max<UINT64>((height + 3) / 4, 1) * 8
+					: width * height * BitsPerPixel(desc.Format) / 8;
+				mipSize = AlignUp(mipSize, 512) * desc.SampleDesc.Count;
+				mostDetailedMip = std::max(mostDetailedMip, mipSize);
+				size += mipSize;
+				width = std::max<UINT64>(width / 2, 1);
+				height = std::max<UINT64>(height / 2, 1);
+			}
+			size *= desc.DepthOrArraySize;
+
+			const bool renderTarget = (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) != 0;
+			if (desc.SampleDesc.Count > 1)
+			{
+				info.Alignment = (desc.Alignment == D3D12_SMALL_MSAA_RESOURCE_PLACEMENT_ALIGNMENT && mostDetailedMip <= 4 * 1024 * 1024)
+					? D3D12_SMALL_MSAA_RESOURCE_PLACEMENT_ALIGNMENT
+					: D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT;
+			}
+			else
+			{
+				info.Alignment = (desc.Alignment == D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT && !renderTarget && mostDetailedMip <= 64 * 1024)
+					? D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT
+					: D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+			}
+			info.SizeInBytes = AlignUp(size, info.Alignment);
+			return info;
+		}
+
+		virtual void CreateHeap(UINT heapIndex, UINT64 sizeInBytes, D3D12_HEAP_FLAGS flags) override
+		{
+			if (heapIndex >= heaps.size())
+			{
+				Check(heapIndex == heaps.size(), "new heap indices are consecutive");
+				heaps.resize(heapIndex + 1);
+			}
+
+			HeapRecord& heap = heaps[heapIndex];
+			Check(!heap.live, "heap indices are only reused once their heap is destroyed");
+			Check(sizeInBytes % D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT == 0, "heap sizes are a multiple of 64KB");
+			heap.live = true;
+			heap.sizeInBytes = sizeInBytes;
+			heap.flags = flags;
+			heap.allocations.clear();
+			createdHeaps++;
+		}
+
+		virtual void DestroyHeap(UINT heapIndex) override
+		{
+			Check(heapIndex < heaps.size() && heaps[heapIndex].live, "only live heaps are destroyed");
+			Check(heaps[heapIndex].allocations.empty(), "heaps are empty when they're destroyed");
+			heaps[heapIndex].live = false;
+			destroyedHeaps++;
+		}
+
+		// Records a placement, as CreatePlacedResource would, and checks it.
+		void Place(const D3D12_RESOURCE_DESC& desc, const SmallResourceAllocator::Allocation& allocation)
+		{
+			Check(allocation.heapIndex < heaps.size() && heaps[allocation.heapIndex].live, "resources are placed in live heaps");
+			HeapRecord& heap = heaps[allocation.heapIndex];
+
+			const D3D12_RESOURCE_ALLOCATION_INFO info = GetResourceAllocationInfo(desc);
+			Check(info.SizeInBytes == allocation.requestedSize && info.Alignment == allocation.alignment, "the desc's alignment matches the allocation");
+			Check(allocation.offset % info.Alignment == 0, "placements are aligned");
+			Check(allocation.sizeInBytes >= info.SizeInBytes, "placements are large enough");
+			Check(allocation.offset + allocation.sizeInBytes <= heap.sizeInBytes, "placements are inside their heap");
+
+			const bool buffer = (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER);
+			const bool renderTarget = (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) != 0;
+			const D3D12_HEAP_FLAGS denied = buffer ? D3D12_HEAP_FLAG_DENY_BUFFERS : (renderTarget ? D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES : D3D12_HEAP_FLAG_DENY_NON_RT_DS_TEXTURES);
+			Check((heap.flags & denied) == 0, "resources are placed in heaps that allow them");
+
+			// The allocation must not overlap its neighbors.
+			auto next = heap.allocations.lower_bound(allocation.offset);
+			Check(next == heap.allocations.end() || next->first >= allocation.offset + allocation.sizeInBytes, "placements don't overlap the next one");
+			if (next != heap.allocations.begin())
+			{
+				--next;
+				Check(next->second <= allocation.offset, "placements don't overlap the previous one");
+			}
+			heap.allocations[allocation.offset] = allocation.offset + allocation.sizeInBytes;
+		}
+
+		void Remove(const SmallResourceAllocator::Allocation& allocation)
+		{
+			HeapRecord& heap = heaps[allocation.heapIndex];
+			Check(heap.allocations.erase(allocation.offset) == 1, "freed allocations were placed");
+		}
+
+		UINT GetLiveHeapCount() const
+		{
+			UINT count = 0;
+			for (const HeapRecord& heap : heaps)
+			{
+				count += heap.live ? 1 : 0;
+			}
+			return count;
+		}
+	};
+
+	struct Placed
+	{
+		D3D12_RESOURCE_DESC desc;
+		SmallResourceAllocator::Allocation allocation;
+	};
+
+	Placed Place(SmallResourceAllocator& allocator, FakeDevice& device, D3D12_RESOURCE_DESC desc)
+	{
+		Placed placed;
+		placed.allocation = allocator.Allocate(&desc);
+		placed.desc = desc;
+		device.Place(desc, placed.allocation);
+		return placed;
+	}
+
+	void Remove(SmallResourceAllocator& allocator, FakeDevice& device, const Placed& placed)
+	{
+		device.Remove(placed.allocation);
+		allocator.Free(placed.allocation);
+	}
+
+	// The sample's textures: 77 32x32 RGBA textures.
+	void TestSampleTextures()
+	{
+		FakeDevice device;
+		SmallResourceAllocator allocator(&device, 512 * 1024);
+
+		std::vector<Placed> textures;
+		for (UINT n = 0; n < 77; n++)
+		{
+			textures.push_back(Place(allocator, device, Texture2D(32, 32, 1)));
+			Check(textures.back().desc.Alignment == D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT, "small textures get 4KB alignment");
+		}
+
+		const SmallResourceAllocator::Statistics statistics = allocator.GetStatistics();
+		Check(statistics.heapCount == 1 && statistics.smallAlignmentCount == 77, "the sample's textures share one heap");
+		Check(statistics.allocatedBytes == 77 * 4096 && statistics.defaultAlignedBytes == 77 * 65536, "the sample's textures take 4KB each rather than 64KB");
+
+		// Packed from the bottom of the heap, so the top is one free block.
+		Check(statistics.largestFreeBlock == 128 * 1024 && statistics.freeBytes == 512 * 1024 - 77 * 4096, "the free space is at the top of the heap");
+
+		for (const Placed& texture : textures)
+		{
+			Remove(allocator, device, texture);
+		}
+		Check(allocator.GetStatistics().largestFreeBlock == 512 * 1024, "freeing everything merges the heap back into one block");
+
+		allocator.ReleaseEmptyHeaps();
+		Check(device.GetLiveHeapCount() == 0 && allocator.GetStatistics().heapCount == 0 && allocator.GetStatistics().heapBytes == 0, "empty heaps are released");
+	}
+
+	void TestAlignment()
+	{
+		FakeDevice device;
+		SmallResourceAllocator allocator(&device, 4 * 1024 * 1024);
+
+		// A 12KB texture takes exactly 12KB, and the next small texture fits in the rest of its block.
+		Placed a = Place(allocator, device, Texture2D(48, 64, 1));
+		Placed b = Place(allocator, device, Texture2D(32, 32, 1));
+		Check(a.allocation.sizeInBytes == 12 * 1024 && b.allocation.offset == 12 * 1024, "odd page counts don't round up to a power of two");
+
+		// Larger textures are 64KB aligned.
+		Placed large = Place(allocator, device, Texture2D(256, 256, 1));
+		Check(large.desc.Alignment == 0 && large.allocation.alignment == 64 * 1024 && large.allocation.offset % (64 * 1024) == 0, "textures over 64KB use the default alignment");
+
+		// Render targets never get 4KB alignment, and go in their own heap.
+		Placed renderTarget = Place(allocator, device, Texture2D(16, 16, 1, DXGI_FORMAT_R8G8B8A8_UNORM, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET));
+		Check(renderTarget.desc.Alignment == 0 && renderTarget.allocation.heapIndex != a.allocation.heapIndex, "render targets use the default alignment and their own heaps");
+
+		// MSAA textures may use 64KB rather than 4MB.
+		Placed msaa = Place(allocator, device, Texture2D(256, 256, 1, DXGI_FORMAT_R8G8B8A8_UNORM, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET, 4));
+		Check(msaa.desc.Alignment == D3D12_SMALL_MSAA_RESOURCE_PLACEMENT_ALIGNMENT && msaa.allocation.heapIndex == renderTarget.allocation.heapIndex, "small MSAA textures get 64KB alignment");
+
+		// Buffers are 64KB aligned, in their own heaps.
+		Placed buffer = Place(allocator, device, Buffer(1000));
+		Check(buffer.allocation.sizeInBytes == 64 * 1024 && buffer.allocation.heapIndex != a.allocation.heapIndex && buffer.allocation.heapIndex != renderTarget.allocation.heapIndex, "buffers are placed in buffer heaps");
+
+		// A block compressed texture with a mip chain.
+		Placed compressed = Place(allocator, device, Texture2D(128, 128, 8, DXGI_FORMAT_BC1_UNORM));
+		Check(compressed.desc.Alignment == D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT && compressed.allocation.sizeInBytes == 16 * 1024, "mip chains are sized as a whole");
+
+		// Resources larger than a heap get their own, which is destroyed when they are freed.
+		const UINT heapsBefore = device.GetLiveHeapCount();
+		Placed huge = Place(allocator, device, Texture2D(2048, 2048, 1));
+		Check(huge.allocation.dedicatedHeap && device.GetLiveHeapCount() == heapsBefore + 1 && allocator.GetStatistics().dedicatedHeapCount == 1, "large resources get a dedicated heap");
+		Remove(allocator, device, huge);
+		Check(device.GetLiveHeapCount() == heapsBefore && allocator.GetStatistics().dedicatedHeapCount == 0, "dedicated heaps are destroyed with their resource");
+
+		for (const Placed* pPlaced : { &a, &b, &large, &renderTarget, &msaa, &buffer, &compressed })
+		{
+			Remove(allocator, device, *pPlaced);
+		}
+		const SmallResourceAllocator::Statistics statistics = allocator.GetStatistics();
+		Check(statistics.allocationCount == 0 && statistics.requestedBytes == 0 && statistics.allocatedBytes == 0 && statistics.smallAlignmentCount == 0, "statistics return to zero");
+		Check(statistics.largestFreeBlock == 4 * 1024 * 1024 && statistics.GetFragmentation() == 0.0, "freed heaps merge back into single blocks");
+	}
+
+	// Refuses every request for small alignment, as a driver may.
+	class RefusingDevice : public FakeDevice
+	{
+	public:
+		virtual D3D12_RESOURCE_ALLOCATION_INFO GetResourceAllocationInfo(const D3D12_RESOURCE_DESC& desc) override
+		{
+			D3D12_RESOURCE_DESC defaultDesc = desc;
+			defaultDesc.Alignment = 0;
+			return FakeDevice::GetResourceAllocationInfo(defaultDesc);
+		}
+	};
+
+	void TestRefusedAlignment()
+	{
+		RefusingDevice device;
+		SmallResourceAllocator allocator(&device, 1024 * 1024);
+
+		Placed a = Place(allocator, device, Texture2D(32, 32, 1));
+		Placed b = Place(allocator, device, Texture2D(32, 32, 1));
+		Check(a.desc.Alignment == 0 && a.allocation.sizeInBytes == 64 * 1024 && b.allocation.offset == 64 * 1024, "refused small alignment falls back to 64KB");
+		Check(allocator.GetStatistics().smallAlignmentCount == 0, "refused small alignment isn't counted");
+	}
+
+	D3D12_RESOURCE_DESC RandomResource(std::mt19937& random)
+	{
+		switch (random() % 8)
+		{
+		case 0:
+			return Buffer(1 + random() % (256 * 1024));
+
+		case 1:
+			return Texture2D(16 << (random() % 6), 16 << (random() % 6), 1, DXGI_FORMAT_R8G8B8A8_UNORM, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET, (random() % 4 == 0) ? 4 : 1);
+
+		case 2:
+		case 3:
+			return Texture2D(64 << (random() % 5), 64 << (random() % 5), static_cast<UINT16>(1 + random() % 6), DXGI_FORMAT_BC1_UNORM);
+
+		default:
+			// Mostly small textures, some of them with mips.
+			return Texture2D(8 + random() % 120, 8 + random() % 120, static_cast<UINT16>(1 + random() % 3));
+		}
+	}
+
+	void TestRandom()
+	{
+		FakeDevice device;
+		SmallResourceAllocator allocator(&device, 1024 * 1024);
+		std::vector<Placed> live;
+		std::mt19937 random(11);
+
+		for (UINT step = 0; step < 50000 && TestHarness::GetFailures() == 0; step++)
+		{
+			if (!live.empty() && random() % 100 < 45)
+			{
+				const size_t index = random() % live.size();
+				Remove(allocator, device, live[index]);
+				live[index] = live.back();
+				live.pop_back();
+			}
+			else
+			{
+				live.push_back(Place(allocator, device, RandomResource(random)));
+			}
+
+			if (step % 5000 == 0)
+			{
+				allocator.ReleaseEmptyHeaps();
+			}
+		}
+
+		UINT64 requested = 0;
+		for (const Placed& placed : live)
+		{
+			requested += placed.allocation.requestedSize;
+		}
+		const SmallResourceAllocator::Statistics statistics = allocator.GetStatistics();
+		Check(statistics.allocationCount == live.size() && statistics.requestedBytes == requested, "statistics track the live allocations");
+		printf("random: %zu live resources in %u heaps, %.1f%% waste, %.1f%% fragmentation\n",
+			live.size(), statistics.heapCount, statistics.GetWaste() * 100.0, statistics.GetFragmentation() * 100.0);
+
+		for (const Placed& placed : live)
+		{
+			Remove(allocator, device, placed);
+		}
+		allocator.ReleaseEmptyHeaps();
+		Check(device.GetLiveHeapCount() == 0 && device.createdHeaps == device.destroyedHeaps, "every heap is released in the end");
+	}
+
+	int RunSelfTest()
+	{
+		TestSampleTextures();
+		TestAlignment();
+		TestRefusedAlignment();
+		TestRandom();
+
+		return 0;
+	}
+
+	void PrintStatistics(const char* pName, const SmallResourceAllocator::Statistics& statistics)
+	{
+		printf("%-18s %6llu resources, %4u heaps, %8.1f MB of heaps for %8.1f MB of data (%8.1f MB at 64KB alignment), %5.1f%% waste, %5.1f%% fragmentation\n",
+			pName,
+			static_cast<unsigned long long>(statistics.allocationCount),
+			statistics.heapCount,
+			statistics.heapBytes / (1024.0 * 1024.0),
+			statistics.requestedBytes / (1024.0 * 1024.0),
+			statistics.defaultAlignedBytes / (1024.0 * 1024.0),
+			statistics.GetWaste() * 100.0,
+			statistics.GetFragmentation() * 100.0);
+	}
+
+	int RunBenchmark(UINT resourceCount)
+	{
+		FakeDevice device;
+		SmallResourceAllocator allocator(&device, 4 * 1024 * 1024);
+		std::mt19937 random(5);
+
+		std::vector<D3D12_RESOURCE_DESC> descs(resourceCount);
+		for (D3D12_RESOURCE_DESC& desc : descs)
+		{
+			desc = RandomResource(random);
+		}
+
+		std::vector<SmallResourceAllocator::Allocation> allocations(resourceCount);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (UINT n = 0; n < resourceCount; n++)
+		{
+			allocations[n] = allocator.Allocate(&descs[n]);
+		}
+		const double allocateSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		PrintStatistics("after allocating", allocator.GetStatistics());
+
+		// Free half of the resources at random, then fill the holes with new ones.
+		std::vector<UINT> order(resourceCount);
+		for (UINT n = 0; n < resourceCount; n++)
+		{
+			order[n] = n;
+		}
+		std::shuffle(order.begin(), order.end(), random);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (UINT n = 0; n < resourceCount / 2; n++)
+		{
+			allocator.Free(allocations[order[n]]);
+		}
+		const double freeSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		PrintStatistics("after freeing half", allocator.GetStatistics());
+
+		for (UINT n = 0; n < resourceCount / 2; n++)
+		{
+			descs[order[n]] = RandomResource(random);
+			allocations[order[n]] = allocator.Allocate(&descs[order[n]]);
+		}
+		PrintStatistics("after refilling", allocator.GetStatistics());
+
+		printf("%.0f ns per allocation, %.0f ns per free\n", allocateSeconds * 1e9 / resourceCount, freeSeconds * 1e9 / (resourceCount / 2));
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	static const TestHarness::Command commands[] =
+	{
+		{ "selftest", "", 0, [](int, char**) { return RunSelfTest(); } },
+		{ "benchmark", "[resources]", 1, [](int argCount, char** ppArgs)
+		{
+			const uint32_t resourceCount = TestHarness::GetCountArgument(argCount, ppArgs, 0, 20000);
+			return (resourceCount > 1) ? RunBenchmark(resourceCount) : TestHarness::BadArguments;
+		} },
+	};
+	return TestHarness::RunCommand(argc, argv, "SmallResourceAllocatorTest", commands);
+}
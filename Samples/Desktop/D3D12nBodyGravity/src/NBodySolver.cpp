@@ -0,0 +1,447 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// The solver doesn't depend on Direct3D or the sample, so that NBodySolverTest can build it on its own.
+#include "NBodySolver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <xmmintrin.h>
+
+namespace
+{
+	const uint32_t MortonBits = 21;		// Bits per axis in a 64-bit Morton key.
+
+	// Calls function(begin, end) over [0, count) in chunks of grainSize, on up to threadCount threads.
+	void ParallelFor(uint32_t threadCount, uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& function)
+	{
+		std::atomic<uint32_t> nextChunk(0);
+		auto worker = [&]()
+		{
+			for (;;)
+			{
+				const uint32_t begin = nextChunk.fetch_add(grainSize);
+				if (begin >= count)
+				{
+					break;
+				}
+				function(begin, std::min(count, begin + grainSize));
+			}
+		};
+
+		const uint32_t chunkCount = (count + grainSize - 1) / grainSize;
+		const uint32_t helperCount = std::min(threadCount, chunkCount) > 1 ? std::min(threadCount, chunkCount) - 1 : 0;
+
+		std::vector<std::thread> helpers;
+		for (uint32_t n = 0; n < helperCount; n++)
+		{
+			helpers.emplace_back(worker);
+		}
+		worker();
+		for (std::thread& helper : helpers)
+		{
+			helper.join();
+		}
+	}
+
+	// Spreads the low 21 bits of value out to every third bit.
+	uint64_t SpreadBits(uint64_t value)
+	{
+		value &= 0x1fffff;
+		value = (value | (value << 32)) & 0x001f00000000ffffull;
+		value = (value | (value << 16)) & 0x001f0000ff0000ffull;
+		value = (value | (value << 8)) & 0x100f00f00f00f00full;
+		value = (value | (value << 4)) & 0x10c30c30c30c30c3ull;
+		value = (value | (value << 2)) & 0x1249249249249249ull;
+		return value;
+	}
+
+	uint32_t Quantize(float value, float origin, float scale)
+	{
+		const float quantized = (value - origin) * scale;
+		const float maxValue = static_cast<float>((1u << MortonBits) - 1);
+		return static_cast<uint32_t>(std::min(std::max(quantized, 0.0f), maxValue));
+	}
+
+	// The pull of one body, or of a group of them at their center of mass, as bodyBodyInteraction()
+	// in nBodyGravityCS.hlsl computes it.
+	inline void Interact(float dx, float dy, float dz, float softeningSquared, float mass, NBodyVector& acceleration)
+	{
+		const float distanceSquared = dx * dx + dy * dy + dz * dz + softeningSquared;
+		const float inverseDistance = 1.0f / sqrtf(distanceSquared);
+		const float inverseDistanceCubed = inverseDistance * inverseDistance * inverseDistance;
+		const float s = mass * inverseDistanceCubed;
+
+		acceleration.x += dx * s;
+		acceleration.y += dy * s;
+		acceleration.z += dz * s;
+	}
+
+	// The SSE version of Interact(), for four particles against one. The reciprocal square root
+	// estimate is refined with a Newton-Raphson step, which leaves it within a few ulps.
+	inline void Interact4(__m128 dx, __m128 dy, __m128 dz, __m128 softeningSquared, __m128 mass, __m128& ax, __m128& ay, __m128& az)
+	{
+		const __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)), softeningSquared);
+		const __m128 estimate = _mm_rsqrt_ps(distanceSquared);
+		const __m128 inverseDistance = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), estimate),
+			_mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(distanceSquared, estimate), estimate)));
+		const __m128 s = _mm_mul_ps(mass, _mm_mul_ps(_mm_mul_ps(inverseDistance, inverseDistance), inverseDistance));
+
+		ax = _mm_add_ps(ax, _mm_mul_ps(dx, s));
+		ay = _mm_add_ps(ay, _mm_mul_ps(dy, s));
+		az = _mm_add_ps(az, _mm_mul_ps(dz, s));
+	}
+
+	template <int Lane>
+	inline __m128 Broadcast(__m128 value)
+	{
+		return _mm_shuffle_ps(value, value, _MM_SHUFFLE(Lane, Lane, Lane, Lane));
+	}
+
+	template <int Lane>
+	inline void InteractWithLane(__m128 xi, __m128 yi, __m128 zi, __m128 xj, __m128 yj, __m128 zj, __m128 softeningSquared, __m128 mass, __m128& ax, __m128& ay, __m128& az)
+	{
+		Interact4(
+			_mm_sub_ps(Broadcast<Lane>(xj), xi),
+			_mm_sub_ps(Broadcast<Lane>(yj), yi),
+			_mm_sub_ps(Broadcast<Lane>(zj), zi),
+			softeningSquared, mass, ax, ay, az);
+	}
+}
+
+NBodySolver::NBodySolver(const NBodyConstants& constants, uint32_t threadCount) :
+	m_constants(constants),
+	m_threadCount(threadCount),
+	m_theta(0.5f),
+	m_leafSize(8),
+	m_treeStatistics()
+{
+	if (m_threadCount == 0)
+	{
+		m_threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+}
+
+void NBodySolver::ComputeAccelerations(NBodyMethod method, const NBodyParticle* pParticles, uint32_t particleCount, NBodyVector* pAccelerations)
+{
+	if (particleCount == 0)
+	{
+		return;
+	}
+
+	if (method == NBodyMethod_BarnesHut)
+	{
+		ComputeBarnesHut(pParticles, particleCount, pAccelerations);
+	}
+	else
+	{
+		LoadPositions(pParticles, particleCount);
+		ComputeAllPairs(particleCount, pAccelerations);
+	}
+}
+
+void NBodySolver::Step(NBodyMethod method, const NBodyParticle* pInput, NBodyParticle* pOutput, uint32_t particleCount)
+{
+	m_accelerations.resize(particleCount);
+	ComputeAccelerations(method, pInput, particleCount, m_accelerations.data());
+
+	const NBodyConstants& constants = m_constants;
+	const NBodyVector* pAccelerations = m_accelerations.data();
+	ParallelFor(m_threadCount, particleCount, 4096, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t n = begin; n < end; n++)
+		{
+			const NBodyVector& acceleration = pAccelerations[n];
+			const NBodyParticle& input = pInput[n];
+			NBodyParticle& output = pOutput[n];
+
+			float velocity[3] =
+			{
+				input.velocity[0] + acceleration.x * constants.deltaTime,
+				input.velocity[1] + acceleration.y * constants.deltaTime,
+				input.velocity[2] + acceleration.z * constants.deltaTime,
+			};
+
+			for (int i = 0; i < 3; i++)
+			{
+				velocity[i] *= constants.damping;
+				output.position[i] = input.position[i] + velocity[i] * constants.deltaTime;
+				output.velocity[i] = velocity[i];
+			}
+			output.position[3] = input.position[3];
+			output.velocity[3] = sqrtf(acceleration.x * acceleration.x + acceleration.y * acceleration.y + acceleration.z * acceleration.z);
+		}
+	});
+}
+
+void NBodySolver::LoadPositions(const NBodyParticle* pParticles, uint32_t particleCount)
+{
+	const uint32_t paddedCount = (particleCount + 3) & ~3u;
+	m_x.assign(paddedCount, 0.0f);
+	m_y.assign(paddedCount, 0.0f);
+	m_z.assign(paddedCount, 0.0f);
+
+	for (uint32_t n = 0; n < particleCount; n++)
+	{
+		m_x[n] = pParticles[n].position[0];
+		m_y[n] = pParticles[n].position[1];
+		m_z[n] = pParticles[n].position[2];
+	}
+}
+
+// Each task takes four particles and sums the pull of every particle on them, four at a time.
+// The padding particles only ever receive forces, so they don't need to be masked out.
+void NBodySolver::ComputeAllPairs(uint32_t particleCount, NBodyVector* pAccelerations)
+{
+	const float* pX = m_x.data();
+	const float* pY = m_y.data();
+	const float* pZ = m_z.data();
+	const __m128 softeningSquared = _mm_set1_ps(m_constants.softeningSquared);
+	const __m128 mass = _mm_set1_ps(m_constants.particleMass);
+	const uint32_t groupCount = (particleCount + 3) / 4;
+
+	ParallelFor(m_threadCount, groupCount, 16, [&](uint32_t beginGroup, uint32_t endGroup)
+	{
+		for (uint32_t group = beginGroup; group < endGroup; group++)
+		{
+			const uint32_t i = group * 4;
+			const __m128 xi = _mm_loadu_ps(pX + i);
+			const __m128 yi = _mm_loadu_ps(pY + i);
+			const __m128 zi = _mm_loadu_ps(pZ + i);
+			__m128 ax = _mm_setzero_ps();
+			__m128 ay = _mm_setzero_ps();
+			__m128 az = _mm_setzero_ps();
+
+			uint32_t j = 0;
+			for (; j + 4 <= particleCount; j += 4)
+			{
+				const __m128 xj = _mm_loadu_ps(pX + j);
+				const __m128 yj = _mm_loadu_ps(pY + j);
+				const __m128 zj = _mm_loadu_ps(pZ + j);
+				InteractWithLane<0>(xi, yi, zi, xj, yj, zj, softeningSquared, mass, ax, ay, az);
+				InteractWithLane<1>(xi, yi, zi, xj, yj, zj, softeningSquared, mass, ax, ay, az);
+				InteractWithLane<2>(xi, yi, zi, xj, yj, zj, softeningSquared, mass, ax, ay, az);
+				InteractWithLane<3>(xi, yi, zi, xj, yj, zj, softeningSquared, mass, ax, ay, az);
+			}
+			for (; j < particleCount; j++)
+			{
+				Interact4(
+					_mm_sub_ps(_mm_set1_ps(pX[j]), xi),
+					_mm_sub_ps(_mm_set1_ps(pY[j]), yi),
+					_mm_sub_ps(_mm_set1_ps(pZ[j]), zi),
+					softeningSquared, mass, ax, ay, az);
+			}
+
+			float x[4], y[4], z[4];
+			_mm_storeu_ps(x, ax);
+			_mm_storeu_ps(y, ay);
+			_mm_storeu_ps(z, az);
+
+			const uint32_t laneCount = std::min(4u, particleCount - i);
+			for (uint32_t lane = 0; lane < laneCount; lane++)
+			{
+				pAccelerations[i + lane].x = x[lane];
+				pAccelerations[i + lane].y = y[lane];
+				pAccelerations[i + lane].z = z[lane];
+			}
+		}
+	});
+}
+
+void NBodySolver::ComputeBarnesHut(const NBodyParticle* pParticles, uint32_t particleCount, NBodyVector* pAccelerations)
+{
+	float origin[3];
+	float size;
+	SortParticles(pParticles, particleCount, origin, &size);
+
+	m_treeStatistics = TreeStatistics();
+	m_nodes.clear();
+	BuildNode(0, particleCount, 0, origin, size);
+	m_treeStatistics.nodeCount = static_cast<uint32_t>(m_nodes.size());
+
+	// Walk the tree for each particle, in Morton order so that neighboring tasks take similar paths.
+	std::atomic<uint64_t> interactions(0);
+	ParallelFor(m_threadCount, particleCount, 256, [&](uint32_t begin, uint32_t end)
+	{
+		uint64_t chunkInteractions = 0;
+		for (uint32_t n = begin; n < end; n++)
+		{
+			pAccelerations[m_order[n]] = WalkTree(m_x[n], m_y[n], m_z[n], &chunkInteractions);
+		}
+		interactions += chunkInteractions;
+	});
+	m_treeStatistics.interactionsPerParticle = static_cast<double>(interactions) / particleCount;
+}
+
+// Sorts the particle positions along a Morton curve through their bounding cube, and returns the cube.
+void NBodySolver::SortParticles(const NBodyParticle* pParticles, uint32_t particleCount, float origin[3], float* pSize)
+{
+	float minimum[3] = { pParticles[0].position[0], pParticles[0].position[1], pParticles[0].position[2] };
+	float maximum[3] = { minimum[0], minimum[1], minimum[2] };
+	for (uint32_t n = 1; n < particleCount; n++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			minimum[i] = std::min(minimum[i], pParticles[n].position[i]);
+			maximum[i] = std::max(maximum[i], pParticles[n].position[i]);
+		}
+	}
+	const float size = std::max(std::max(maximum[0] - minimum[0], maximum[1] - minimum[1]), std::max(maximum[2] - minimum[2], 1e-6f)) * 1.0001f;
+	const float scale = static_cast<float>(1u << MortonBits) / size;
+	origin[0] = minimum[0];
+	origin[1] = minimum[1];
+	origin[2] = minimum[2];
+	*pSize = size;
+
+	std::vector<std::pair<uint64_t, uint32_t>> keys(particleCount);
+	ParallelFor(m_threadCount, particleCount, 16384, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t n = begin; n < end; n++)
+		{
+			const float* pPosition = pParticles[n].position;
+			const uint64_t key =
+				(SpreadBits(Quantize(pPosition[0], minimum[0], scale)) << 2) |
+				(SpreadBits(Quantize(pPosition[1], minimum[1], scale)) << 1) |
+				SpreadBits(Quantize(pPosition[2], minimum[2], scale));
+			keys[n] = std::make_pair(key, n);
+		}
+	});
+	std::sort(keys.begin(), keys.end());
+
+	const uint32_t paddedCount = (particleCount + 3) & ~3u;
+	m_x.assign(paddedCount, 0.0f);
+	m_y.assign(paddedCount, 0.0f);
+	m_z.assign(paddedCount, 0.0f);
+	m_keys.resize(particleCount);
+	m_order.resize(particleCount);
+	for (uint32_t n = 0; n < particleCount; n++)
+	{
+		const NBodyParticle& particle = pParticles[keys[n].second];
+		m_x[n] = particle.position[0];
+		m_y[n] = particle.position[1];
+		m_z[n] = particle.position[2];
+		m_keys[n] = keys[n].first;
+		m_order[n] = keys[n].second;
+	}
+}
+
+// Adds the node for the sorted particles [begin, end), which share the first 'level' octants of
+// their Morton keys, followed by its subtree. Returns the node's index.
+uint32_t NBodySolver::BuildNode(uint32_t begin, uint32_t end, uint32_t level, const float origin[3], float size)
+{
+	const uint32_t index = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.push_back(Node());
+	m_treeStatistics.depth = std::max(m_treeStatistics.depth, level + 1);
+
+	const uint32_t particleCount = end - begin;
+	const bool leaf = particleCount <= m_leafSize || level == MortonBits;
+	double centerOfMass[3] = {};
+
+	if (leaf)
+	{
+		for (uint32_t n = begin; n < end; n++)
+		{
+			centerOfMass[0] += m_x[n];
+			centerOfMass[1] += m_y[n];
+			centerOfMass[2] += m_z[n];
+		}
+		m_treeStatistics.leafCount++;
+	}
+	else
+	{
+		// The keys put x in the high bit of each octant, then y, then z.
+		const uint32_t shift = 3 * (MortonBits - 1 - level);
+		const float childSize = size * 0.5f;
+
+		uint32_t childBegin = begin;
+		for (uint32_t octant = 0; octant < 8 && childBegin < end; octant++)
+		{
+			const uint32_t childEnd = static_cast<uint32_t>(std::partition_point(m_keys.begin() + childBegin, m_keys.begin() + end,
+				[=](uint64_t key) { return ((key >> shift) & 7) <= octant; }) - m_keys.begin());
+
+			if (childEnd > childBegin)
+			{
+				const float childOrigin[3] =
+				{
+					origin[0] + ((octant & 4) ? childSize : 0.0f),
+					origin[1] + ((octant & 2) ? childSize : 0.0f),
+					origin[2] + ((octant & 1) ? childSize : 0.0f),
+				};
+
+				const Node& child = m_nodes[BuildNode(childBegin, childEnd, level + 1, childOrigin, childSize)];
+				centerOfMass[0] += static_cast<double>(child.centerOfMass[0]) * child.particleCount;
+				centerOfMass[1] += static_cast<double>(child.centerOfMass[1]) * child.particleCount;
+				centerOfMass[2] += static_cast<double>(child.centerOfMass[2]) * child.particleCount;
+			}
+			childBegin = childEnd;
+		}
+	}
+
+	Node& node = m_nodes[index];
+	node.centerOfMass[0] = static_cast<float>(centerOfMass[0] / particleCount);
+	node.centerOfMass[1] = static_cast<float>(centerOfMass[1] / particleCount);
+	node.centerOfMass[2] = static_cast<float>(centerOfMass[2] / particleCount);
+	node.particleCount = static_cast<float>(particleCount);
+	node.size = size;
+	node.next = static_cast<uint32_t>(m_nodes.size());
+	node.firstParticle = begin;
+	node.leafParticleCount = leaf ? particleCount : 0;
+	return index;
+}
+
+// Sums the pull on a particle at (x, y, z). The nodes are in depth first order, so a node's
+// first child follows it and 'next' skips its subtree.
+NBodyVector NBodySolver::WalkTree(float x, float y, float z, uint64_t* pInteractions) const
+{
+	const float thetaSquared = m_theta * m_theta;
+	const float softeningSquared = m_constants.softeningSquared;
+	const float mass = m_constants.particleMass;
+	const uint32_t nodeCount = static_cast<uint32_t>(m_nodes.size());
+
+	NBodyVector acceleration = {};
+	uint64_t interactions = 0;
+	for (uint32_t index = 0; index < nodeCount;)
+	{
+		const Node& node = m_nodes[index];
+		if (node.leafParticleCount != 0)
+		{
+			const uint32_t end = node.firstParticle + node.leafParticleCount;
+			for (uint32_t n = node.firstParticle; n < end; n++)
+			{
+				Interact(m_x[n] - x, m_y[n] - y, m_z[n] - z, softeningSquared, mass, acceleration);
+			}
+			interactions += node.leafParticleCount;
+			index = node.next;
+			continue;
+		}
+
+		const float dx = node.centerOfMass[0] - x;
+		const float dy = node.centerOfMass[1] - y;
+		const float dz = node.centerOfMass[2] - z;
+		if (node.size * node.size < thetaSquared * (dx * dx + dy * dy + dz * dz))
+		{
+			Interact(dx, dy, dz, softeningSquared, mass * node.particleCount, acceleration);
+			interactions++;
+			index = node.next;
+		}
+		else
+		{
+			index++;
+		}
+	}
+
+	*pInteractions += interactions;
+	return acceleration;
+}
@@ -0,0 +1,129 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// A CPU version of the n-body simulation in nBodyGravityCS.hlsl, to check the compute shader's
+// results against and to run systems too large for its all-pairs approach.
+//
+// NBodySolver has two ways of finding the accelerations:
+//  - AllPairs sums the pull of every particle on every other, as the compute shader does, four
+//    particles at a time with SSE. It is exact apart from float rounding, and O(n^2).
+//  - BarnesHut sorts the particles along a Morton curve and builds an octree over them. Each
+//    particle then walks the tree, and treats any node that is small compared to its distance
+//    from the particle (size / distance < theta) as a single mass at the node's center of mass.
+//    This is O(n log n); a smaller theta opens more nodes and is more accurate.
+// Both use the same softening and particle mass as the compute shader, and split the particles
+// between worker threads.
+
+// As D3D12nBodyGravity::Particle.
+struct NBodyParticle
+{
+	float position[4];
+	float velocity[4];	// The w component receives the length of the particle's acceleration.
+};
+
+struct NBodyVector
+{
+	float x;
+	float y;
+	float z;
+};
+
+// The constants of nBodyGravityCS.hlsl and of the sample's compute constant buffer.
+struct NBodyConstants
+{
+	float softeningSquared;
+	float particleMass;		// g_fParticleMass, the gravitational constant times the mass of a particle.
+	float deltaTime;
+	float damping;
+
+	static NBodyConstants GetSampleConstants()
+	{
+		const float g = 6.67300e-11f * 10000.0f;
+		NBodyConstants constants = { 0.0012500000f * 0.0012500000f, g * 10000.0f * 10000.0f, 0.1f, 1.0f };
+		return constants;
+	}
+};
+
+enum NBodyMethod
+{
+	NBodyMethod_AllPairs,
+	NBodyMethod_BarnesHut,
+};
+
+class NBodySolver
+{
+public:
+	struct TreeStatistics
+	{
+		uint32_t nodeCount;
+		uint32_t leafCount;
+		uint32_t depth;
+		double interactionsPerParticle;	// Nodes and particles summed per particle in the last tree walk.
+	};
+
+	// A threadCount of 0 uses one thread per hardware thread.
+	NBodySolver(const NBodyConstants& constants, uint32_t threadCount = 0);
+
+	// The Barnes-Hut opening angle. 0 opens every node, which makes Barnes-Hut exact.
+	void SetTheta(float theta) { m_theta = theta; }
+	float GetTheta() const { return m_theta; }
+
+	// The largest number of particles in a tree leaf; leaves are summed directly.
+	void SetLeafSize(uint32_t leafSize) { m_leafSize = leafSize > 0 ? leafSize : 1; }
+
+	uint32_t GetThreadCount() const { return m_threadCount; }
+	const TreeStatistics& GetTreeStatistics() const { return m_treeStatistics; }
+
+	// Computes the acceleration of each particle.
+	void ComputeAccelerations(NBodyMethod method, const NBodyParticle* pParticles, uint32_t particleCount, NBodyVector* pAccelerations);
+
+	// Advances the particles by one step, as nBodyGravityCS.hlsl does, from pInput to pOutput.
+	void Step(NBodyMethod method, const NBodyParticle* pInput, NBodyParticle* pOutput, uint32_t particleCount);
+
+private:
+	struct Node
+	{
+		float centerOfMass[3];
+		float particleCount;
+		float size;				// The length of the node's sides.
+		uint32_t next;			// The node after this node's subtree; the first child, if any, is the node after this one.
+		uint32_t firstParticle;	// The particles of a leaf, in Morton order.
+		uint32_t leafParticleCount;	// 0 for interior nodes.
+	};
+
+	void LoadPositions(const NBodyParticle* pParticles, uint32_t particleCount);
+	void ComputeAllPairs(uint32_t particleCount, NBodyVector* pAccelerations);
+	void ComputeBarnesHut(const NBodyParticle* pParticles, uint32_t particleCount, NBodyVector* pAccelerations);
+	void SortParticles(const NBodyParticle* pParticles, uint32_t particleCount, float origin[3], float* pSize);
+	uint32_t BuildNode(uint32_t begin, uint32_t end, uint32_t level, const float origin[3], float size);
+	NBodyVector WalkTree(float x, float y, float z, uint64_t* pInteractions) const;
+
+	NBodyConstants m_constants;
+	uint32_t m_threadCount;
+	float m_theta;
+	uint32_t m_leafSize;
+	TreeStatistics m_treeStatistics;
+
+	// Particle positions, one array per component, padded to a multiple of four. The Barnes-Hut
+	// path keeps them in Morton order, with m_order mapping them back to the input order.
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_z;
+	std::vector<uint32_t> m_order;
+	std::vector<uint64_t> m_keys;
+	std::vector<Node> m_nodes;
+	std::vector<NBodyVector> m_accelerations;
+};
@@ -0,0 +1,363 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Tests and measures the sample's CPU n-body solver.
+//
+//     NBodySolverTest selftest                              Check both methods against a double precision all-pairs
+//                                                           sum, check Barnes-Hut's error for several values of theta,
+//                                                           and check the energy drift of a short simulation.
+//     NBodySolverTest benchmark [maxParticles] [theta]      Time one step of each method for 16K particles and up, by
+//                                                           powers of four, and report the particles processed per
+//                                                           second. All-pairs is only timed up to 64K particles.
+//
+// The particles are laid out as D3D12nBodyGravity::CreateParticleBuffers() lays them out: two colliding spheres.
+// The exit code is 0 on success, 1 if the self test fails and 2 for bad arguments.
+
+#include "../NBodySolver.h"
+#include "../../../Shared/TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using TestHarness::Check;
+
+namespace
+{
+	const float ParticleSpread = 400.0f;
+
+	// As D3D12nBodyGravity::LoadParticles().
+	void LoadParticles(std::mt19937& random, NBodyParticle* pParticles, const float center[3], float velocityZ, float spread, uint32_t particleCount)
+	{
+		std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+		for (uint32_t i = 0; i < particleCount; i++)
+		{
+			float delta[3];
+			do
+			{
+				delta[0] = distribution(random) * spread;
+				delta[1] = distribution(random) * spread;
+				delta[2] = distribution(random) * spread;
+			} while (delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2] > spread * spread);
+
+			NBodyParticle& particle = pParticles[i];
+			particle.position[0] = center[0] + delta[0];
+			particle.position[1] = center[1] + delta[1];
+			particle.position[2] = center[2] + delta[2];
+			particle.position[3] = 10000.0f * 10000.0f;
+			particle.velocity[0] = 0.0f;
+			particle.velocity[1] = 0.0f;
+			particle.velocity[2] = velocityZ;
+			particle.velocity[3] = 1 / 100000000.0f;
+		}
+	}
+
+	std::vector<NBodyParticle> SampleParticles(uint32_t particleCount, unsigned int seed)
+	{
+		std::mt19937 random(seed);
+		std::vector<NBodyParticle> particles(particleCount);
+		const float centerSpread = ParticleSpread * 0.5f;
+		const float left[3] = { centerSpread, 0.0f, 0.0f };
+		const float right[3] = { -centerSpread, 0.0f, 0.0f };
+		LoadParticles(random, particles.data(), left, -20.0f, ParticleSpread, particleCount / 2);
+		LoadParticles(random, particles.data() + particleCount / 2, right, 20.0f, ParticleSpread, particleCount - particleCount / 2);
+		return particles;
+	}
+
+	// The all-pairs sum in double precision.
+	std::vector<NBodyVector> ReferenceAccelerations(const NBodyConstants& constants, const std::vector<NBodyParticle>& particles)
+	{
+		std::vector<NBodyVector> accelerations(particles.size());
+		for (size_t i = 0; i < particles.size(); i++)
+		{
+			double sum[3] = {};
+			for (size_t j = 0; j < particles.size(); j++)
+			{
+				const double dx = static_cast<double>(particles[j].position[0]) - particles[i].position[0];
+				const double dy = static_cast<double>(particles[j].position[1]) - particles[i].position[1];
+				const double dz = static_cast<double>(particles[j].position[2]) - particles[i].position[2];
+				const double distanceSquared = dx * dx + dy * dy + dz * dz + constants.softeningSquared;
+				const double s = constants.particleMass / (distanceSquared * sqrt(distanceSquared));
+				sum[0] += dx * s;
+				sum[1] += dy * s;
+				sum[2] += dz * s;
+			}
+			accelerations[i].x = static_cast<float>(sum[0]);
+			accelerations[i].y = static_cast<float>(sum[1]);
+			accelerations[i].z = static_cast<float>(sum[2]);
+		}
+		return accelerations;
+	}
+
+	double Length(const NBodyVector& v)
+	{
+		return sqrt(static_cast<double>(v.x) * v.x + static_cast<double>(v.y) * v.y + static_cast<double>(v.z) * v.z);
+	}
+
+	struct ErrorStatistics
+	{
+		double median;
+		double percentile99;
+		double maximum;
+	};
+
+	// The error of each acceleration relative to the size of the expected one.
+	ErrorStatistics RelativeErrors(const std::vector<NBodyVector>& accelerations, const std::vector<NBodyVector>& expected)
+	{
+		std::vector<double> errors(accelerations.size());
+		for (size_t n = 0; n < accelerations.size(); n++)
+		{
+			NBodyVector difference = { accelerations[n].x - expected[n].x, accelerations[n].y - expected[n].y, accelerations[n].z - expected[n].z };
+			errors[n] = Length(difference) / std::max(Length(expected[n]), 1e-30);
+		}
+		std::sort(errors.begin(), errors.end());
+
+		ErrorStatistics statistics = {};
+		if (!errors.empty())
+		{
+			statistics.median = errors[errors.size() / 2];
+			statistics.percentile99 = errors[errors.size() * 99 / 100];
+			statistics.maximum = errors.back();
+		}
+		return statistics;
+	}
+
+	// The kinetic plus the potential energy of the system, per unit of particle mass, with the
+	// softened potential that matches the solver's softened force.
+	double TotalEnergy(const NBodyConstants& constants, const std::vector<NBodyParticle>& particles)
+	{
+		double kinetic = 0.0;
+		double potential = 0.0;
+		for (size_t i = 0; i < particles.size(); i++)
+		{
+			const float* pVelocity = particles[i].velocity;
+			kinetic += 0.5 * (static_cast<double>(pVelocity[0]) * pVelocity[0] + static_cast<double>(pVelocity[1]) * pVelocity[1] + static_cast<double>(pVelocity[2]) * pVelocity[2]);
+
+			for (size_t j = i + 1; j < particles.size(); j++)
+			{
+				const double dx = static_cast<double>(particles[j].position[0]) - particles[i].position[0];
+				const double dy = static_cast<double>(particles[j].position[1]) - particles[i].position[1];
+				const double dz = static_cast<double>(particles[j].position[2]) - particles[i].position[2];
+				potential -= constants.particleMass / sqrt(dx * dx + dy * dy + dz * dz + constants.softeningSquared);
+			}
+		}
+		return kinetic + potential;
+	}
+
+	// Systems small enough to check by hand, and particle counts that don't fill the SSE registers.
+	void TestSmallSystems()
+	{
+		const NBodyConstants constants = NBodyConstants::GetSampleConstants();
+		NBodySolver solver(constants, 2);
+
+		for (int method = NBodyMethod_AllPairs; method <= NBodyMethod_BarnesHut; method++)
+		{
+			NBodyParticle particles[2] = {};
+			particles[1].position[0] = 10.0f;
+
+			NBodyVector accelerations[2] = {};
+			solver.ComputeAccelerations(static_cast<NBodyMethod>(method), particles, 1, accelerations);
+			Check(accelerations[0].x == 0.0f && accelerations[0].y == 0.0f && accelerations[0].z == 0.0f, "a lone particle doesn't accelerate");
+
+			solver.ComputeAccelerations(static_cast<NBodyMethod>(method), particles, 2, accelerations);
+			const double expected = constants.particleMass * 10.0 / pow(100.0 + constants.softeningSquared, 1.5);
+			Check(fabs(accelerations[0].x - expected) < expected * 1e-5 && fabs(accelerations[1].x + expected) < expected * 1e-5, "two particles pull each other together");
+			Check(accelerations[0].y == 0.0f && accelerations[0].z == 0.0f, "two particles on the x axis only accelerate along it");
+		}
+
+		for (uint32_t particleCount = 3; particleCount <= 13; particleCount++)
+		{
+			const std::vector<NBodyParticle> particles = SampleParticles(particleCount, particleCount);
+			const std::vector<NBodyVector> expected = ReferenceAccelerations(constants, particles);
+			for (int method = NBodyMethod_AllPairs; method <= NBodyMethod_BarnesHut; method++)
+			{
+				std::vector<NBodyVector> accelerations(particleCount);
+				solver.ComputeAccelerations(static_cast<NBodyMethod>(method), particles.data(), particleCount, accelerations.data());
+				Check(RelativeErrors(accelerations, expected).maximum < 1e-4, "small systems match the double precision sum");
+			}
+		}
+	}
+
+	// Step() applies the same update as nBodyGravityCS.hlsl.
+	void TestStep()
+	{
+		NBodyConstants constants = NBodyConstants::GetSampleConstants();
+		constants.damping = 0.9f;
+		NBodySolver solver(constants, 1);
+
+		std::vector<NBodyParticle> particles = SampleParticles(6, 6);
+		std::vector<NBodyVector> accelerations(particles.size());
+		solver.ComputeAccelerations(NBodyMethod_AllPairs, particles.data(), 6, accelerations.data());
+
+		std::vector<NBodyParticle> stepped(particles.size());
+		solver.Step(NBodyMethod_AllPairs, particles.data(), stepped.data(), 6);
+
+		bool matches = true;
+		for (size_t n = 0; n < particles.size(); n++)
+		{
+			const float a[3] = { accelerations[n].x, accelerations[n].y, accelerations[n].z };
+			for (int i = 0; i < 3; i++)
+			{
+				const float velocity = (particles[n].velocity[i] + a[i] * constants.deltaTime) * constants.damping;
+				matches = matches && stepped[n].velocity[i] == velocity;
+				matches = matches && stepped[n].position[i] == particles[n].position[i] + velocity * constants.deltaTime;
+			}
+			matches = matches && stepped[n].position[3] == particles[n].position[3];
+			matches = matches && fabs(stepped[n].velocity[3] - Length(accelerations[n])) <= Length(accelerations[n]) * 1e-6;
+		}
+		Check(matches, "a step integrates as the compute shader does");
+
+		// Stepping in place gives the same result.
+		solver.Step(NBodyMethod_AllPairs, particles.data(), particles.data(), 6);
+		Check(memcmp(particles.data(), stepped.data(), particles.size() * sizeof(NBodyParticle)) == 0, "a step can be made in place");
+	}
+
+	// Both methods against the double precision sum, for the sample's layout.
+	void TestAccuracy()
+	{
+		const NBodyConstants constants = NBodyConstants::GetSampleConstants();
+		const uint32_t particleCount = 4001;
+		const std::vector<NBodyParticle> particles = SampleParticles(particleCount, 39);
+		const std::vector<NBodyVector> expected = ReferenceAccelerations(constants, particles);
+		NBodySolver solver(constants, 4);
+
+		std::vector<NBodyVector> accelerations(particleCount);
+		solver.ComputeAccelerations(NBodyMethod_AllPairs, particles.data(), particleCount, accelerations.data());
+		ErrorStatistics errors = RelativeErrors(accelerations, expected);
+		printf("all pairs:          median error %.2e, 99th percentile %.2e, max %.2e\n", errors.median, errors.percentile99, errors.maximum);
+		Check(errors.percentile99 < 1e-4, "all pairs matches the double precision sum");
+
+		// Barnes-Hut opens every node when theta is 0.
+		solver.SetTheta(0.0f);
+		solver.ComputeAccelerations(NBodyMethod_BarnesHut, particles.data(), particleCount, accelerations.data());
+		errors = RelativeErrors(accelerations, expected);
+		printf("barnes-hut theta 0: median error %.2e, 99th percentile %.2e, max %.2e\n", errors.median, errors.percentile99, errors.maximum);
+		Check(errors.percentile99 < 1e-4, "Barnes-Hut with theta 0 matches the double precision sum");
+
+		const float thetas[] = { 0.3f, 0.5f, 0.7f, 1.0f };
+		const double medianLimits[] = { 2e-3, 5e-3, 1.5e-2, 4e-2 };
+		double lastMedian = 0.0;
+		double lastInteractions = 1e30;
+		for (size_t n = 0; n < sizeof(thetas) / sizeof(thetas[0]); n++)
+		{
+			solver.SetTheta(thetas[n]);
+			solver.ComputeAccelerations(NBodyMethod_BarnesHut, particles.data(), particleCount, accelerations.data());
+			errors = RelativeErrors(accelerations, expected);
+
+			const NBodySolver::TreeStatistics& tree = solver.GetTreeStatistics();
+			printf("barnes-hut theta %.1f: median error %.2e, 99th percentile %.2e, max %.2e, %.0f interactions per particle\n",
+				thetas[n], errors.median, errors.percentile99, errors.maximum, tree.interactionsPerParticle);
+
+			Check(errors.median < medianLimits[n], "Barnes-Hut's error is within bounds for its theta");
+			Check(errors.median > lastMedian && tree.interactionsPerParticle < lastInteractions, "a larger theta trades accuracy for fewer interactions");
+			lastMedian = errors.median;
+			lastInteractions = tree.interactionsPerParticle;
+		}
+	}
+
+	// The compute shader's integration is symplectic, so energy should stay close to where it
+	// started rather than drift away. The sample's softening is tiny, and close encounters would
+	// need a much smaller time step than it takes; this test softens the force so that the time
+	// step is small enough.
+	void TestEnergyDrift()
+	{
+		NBodyConstants constants = NBodyConstants::GetSampleConstants();
+		constants.softeningSquared = 20.0f * 20.0f;
+
+		const uint32_t particleCount = 2000;
+		const std::vector<NBodyParticle> initial = SampleParticles(particleCount, 7);
+		const double initialEnergy = TotalEnergy(constants, initial);
+
+		for (int method = NBodyMethod_AllPairs; method <= NBodyMethod_BarnesHut; method++)
+		{
+			NBodySolver solver(constants, 4);
+			solver.SetTheta(0.5f);
+
+			std::vector<NBodyParticle> particles = initial;
+			double maxDrift = 0.0;
+			for (int step = 1; step <= 200; step++)
+			{
+				solver.Step(static_cast<NBodyMethod>(method), particles.data(), particles.data(), particleCount);
+				if (step % 20 == 0)
+				{
+					maxDrift = std::max(maxDrift, fabs(TotalEnergy(constants, particles) / initialEnergy - 1.0));
+				}
+			}
+
+			printf("%s: largest energy drift over 200 steps %.2e\n", method == NBodyMethod_AllPairs ? "all pairs" : "barnes-hut", maxDrift);
+			Check(maxDrift < 2e-2, "energy is conserved over a short simulation");
+		}
+	}
+
+	int RunSelfTest()
+	{
+		TestSmallSystems();
+		TestStep();
+		TestAccuracy();
+		TestEnergyDrift();
+
+		return 0;
+	}
+
+	double TimeStep(NBodySolver& solver, NBodyMethod method, std::vector<NBodyParticle>& particles)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		solver.Step(method, particles.data(), particles.data(), static_cast<uint32_t>(particles.size()));
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	int RunBenchmark(uint32_t maxParticles, float theta)
+	{
+		const NBodyConstants constants = NBodyConstants::GetSampleConstants();
+		NBodySolver solver(constants);
+		solver.SetTheta(theta);
+		printf("%u threads, theta %.2f\n", solver.GetThreadCount(), theta);
+
+		for (uint32_t particleCount = 16 * 1024; particleCount <= maxParticles; particleCount *= 4)
+		{
+			std::vector<NBodyParticle> particles = SampleParticles(particleCount, 1);
+
+			const double barnesHutSeconds = TimeStep(solver, NBodyMethod_BarnesHut, particles);
+			const NBodySolver::TreeStatistics& tree = solver.GetTreeStatistics();
+			printf("%8u particles: barnes-hut %8.3f s per step, %6.2f M particles/s, %u nodes, depth %u, %.0f interactions per particle\n",
+				particleCount, barnesHutSeconds, particleCount / barnesHutSeconds * 1e-6, tree.nodeCount, tree.depth, tree.interactionsPerParticle);
+
+			if (particleCount <= 64 * 1024)
+			{
+				const double allPairsSeconds = TimeStep(solver, NBodyMethod_AllPairs, particles);
+				printf("%8u particles: all pairs  %8.3f s per step, %6.2f M particles/s, %.2f G interactions/s\n",
+					particleCount, allPairsSeconds, particleCount / allPairsSeconds * 1e-6, static_cast<double>(particleCount) * particleCount / allPairsSeconds * 1e-9);
+			}
+		}
+
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	static const TestHarness::Command commands[] =
+	{
+		{ "selftest", "", 0, [](int, char**) { return RunSelfTest(); } },
+		{ "benchmark", "[maxParticles] [theta]", 2, [](int argCount, char** ppArgs)
+		{
+			const uint32_t maxParticles = TestHarness::GetCountArgument(argCount, ppArgs, 0, 1024 * 1024);
+			const float theta = (argCount >= 2) ? static_cast<float>(atof(ppArgs[1])) : 0.5f;
+			return (maxParticles >= 16 * 1024 && theta >= 0.0f) ? RunBenchmark(maxParticles, theta) : TestHarness::BadArguments;
+		} },
+	};
+	return TestHarness::RunCommand(argc, argv, "NBodySolverTest", commands);
+}
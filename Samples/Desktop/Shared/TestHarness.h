@@ -0,0 +1,141 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+// The checks and command line shared by the samples' console tests. Each test lists its commands and hands
+// main()'s arguments to RunCommand(), which runs the command named first and reports any checks that failed
+// while it ran. Check() can be called from any thread.
+//
+// The exit code is 0 on success, 1 if a check fails and 2 for bad arguments.
+namespace TestHarness
+{
+	// Returned by a command whose arguments are out of range. RunCommand() prints the usage.
+	const int BadArguments = 2;
+
+	struct Command
+	{
+		const char* pName;
+		const char* pArguments;	// Shown in the usage, e.g. "[frames]".
+		int maxArguments;
+		int (*run)(int argc, char** argv);
+	};
+
+	namespace Internal
+	{
+		struct Results
+		{
+			std::mutex mutex;
+			int failures = 0;
+			std::atomic<bool> checked{ false };
+		};
+
+		inline Results& GetResults()
+		{
+			static Results results;
+			return results;
+		}
+	}
+
+	// One bug tends to fail many checks in a row, so only the first 20 failures are printed.
+	inline void Check(bool condition, const char* pMessage)
+	{
+		Internal::Results& results = Internal::GetResults();
+
+		// Read first so that threads checking in a loop don't keep writing the same cache line.
+		if (!results.checked.load(std::memory_order_relaxed))
+		{
+			results.checked.store(true, std::memory_order_relaxed);
+		}
+
+		if (!condition)
+		{
+			std::lock_guard<std::mutex> lock(results.mutex);
+			if (results.failures < 20)
+			{
+				printf("FAILED: %s\n", pMessage);
+			}
+			results.failures++;
+		}
+	}
+
+	inline int GetFailures()
+	{
+		Internal::Results& results = Internal::GetResults();
+		std::lock_guard<std::mutex> lock(results.mutex);
+		return results.failures;
+	}
+
+	// Returns argv[index] as a positive count, defaultValue when it isn't given, or 0 when it isn't a positive count.
+	inline uint32_t GetCountArgument(int argc, char** argv, int index, uint32_t defaultValue)
+	{
+		if (index >= argc)
+		{
+			return defaultValue;
+		}
+
+		const char* pArgument = argv[index];
+		if (!isdigit(static_cast<unsigned char>(pArgument[0])))
+		{
+			return 0;
+		}
+
+		char* pEnd = nullptr;
+		const unsigned long long value = strtoull(pArgument, &pEnd, 10);
+		return (*pEnd == '\0' && value <= UINT32_MAX) ? static_cast<uint32_t>(value) : 0;
+	}
+
+	template <size_t CommandCount>
+	int RunCommand(int argc, char** argv, const char* pTestName, const Command (&commands)[CommandCount])
+	{
+		for (const Command& command : commands)
+		{
+			if (argc < 2 || strcmp(argv[1], command.pName) != 0 || argc - 2 > command.maxArguments)
+			{
+				continue;
+			}
+
+			const int result = command.run(argc - 2, argv + 2);
+			if (result == BadArguments)
+			{
+				break;
+			}
+
+			const int failures = GetFailures();
+			if (failures != 0)
+			{
+				printf("%s FAILED (%d checks)\n", command.pName, failures);
+				return 1;
+			}
+
+			if (result == 0 && Internal::GetResults().checked.load())
+			{
+				printf("%s passed\n", command.pName);
+			}
+			return result;
+		}
+
+		for (size_t i = 0; i < CommandCount; i++)
+		{
+			printf("%s%s %s%s%s\n", (i == 0) ? "Usage: " : "       ", pTestName, commands[i].pName,
+				(commands[i].pArguments[0] != '\0') ? " " : "", commands[i].pArguments);
+		}
+		return BadArguments;
+	}
+}
@@ -261,6 +261,11 @@ HRESULT D3D12MemoryManagement::LoadAssets()
 		++ImageIndex;
 	}
 
+	for (UINT i = 0; i < m_Images.size(); ++i)
+	{
+		RecordPagingTraceResource(i, m_Images[i].pResource);
+	}
+
 	return S_OK;
 }
 
@@ -485,7 +490,7 @@ bool D3D12MemoryManagement::HandleMessage(HWND hwnd, UINT Message, WPARAM wParam
 	return false;
 }
 
-void D3D12MemoryManagement::CalculateImagePagingData(const RectF* pViewportBounds, const Image* pImage, UINT8* pVisibleMip, UINT8* pPrefetchMip)
+void D3D12MemoryManagement::CalculateImagePagingData(const RectF* pViewportBounds, const Image* pImage, UINT8* pVisibleMip, UINT8* pPrefetchMip, float* pDistance)
 {
 	float ImageScale = (pImage->Bounds.Right - pImage->Bounds.Left) * m_pSceneCamera->GetZoom();
 	UINT8 RequiredMip = (UINT8)CalculateRequiredMipLevel(pImage->pResource, ImageScale);
@@ -520,16 +525,37 @@ void D3D12MemoryManagement::CalculateImagePagingData(const RectF* pViewportBound
 		PrefetchMip = UNDEFINED_MIPMAP_INDEX;
 	}
 
+	//
+	// Calculate the screen-space distance between the image and the viewport, which the
+	// paging policy may use to order resources. The distance is rounded up to a power of
+	// two, so that it only changes (and requires reprioritization) occasionally.
+	//
+	float Distance = 0.0f;
+	if (!IsVisible)
+	{
+		float DistanceX = max(0.0f, max(pViewportBounds->Left - pImage->Bounds.Right, pImage->Bounds.Left - pViewportBounds->Right));
+		float DistanceY = max(0.0f, max(pViewportBounds->Top - pImage->Bounds.Bottom, pImage->Bounds.Top - pViewportBounds->Bottom));
+		float ScreenDistance = sqrt(DistanceX * DistanceX + DistanceY * DistanceY) * m_pSceneCamera->GetZoom();
+		if (ScreenDistance > 1.0f)
+		{
+			Distance = pow(2.0f, ceil(log(ScreenDistance) / log(2.0f)));
+		}
+	}
+
 	*pVisibleMip = VisibleMip;
 	*pPrefetchMip = PrefetchMip;
+	*pDistance = Distance;
 }
 
 HRESULT D3D12MemoryManagement::RenderScene(const RectF& ViewportBounds)
 {
 	RectF SceneBounds = m_pSceneCamera->GenerateViewportBounds();
 
-	for (auto& Img : m_Images)
+	RecordPagingTraceFrame();
+
+	for (UINT ImageIndex = 0; ImageIndex < m_Images.size(); ++ImageIndex)
 	{
+		const Image& Img = m_Images[ImageIndex];
 		Resource* pResource = Img.pResource;
 
 		//
@@ -537,17 +563,20 @@ HRESULT D3D12MemoryManagement::RenderScene(const RectF& ViewportBounds)
 		//
 		UINT8 VisibleMip;
 		UINT8 PrefetchMip;
-		CalculateImagePagingData(&SceneBounds, &Img, &VisibleMip, &PrefetchMip);
+		float Distance;
+		CalculateImagePagingData(&SceneBounds, &Img, &VisibleMip, &PrefetchMip, &Distance);
 
 		//
 		// If the visibility or prefetch values have changed, notify the paging thread
 		// so it can update this resource's priority.
 		//
-		if (pResource->VisibleMip != VisibleMip || pResource->PrefetchMip != PrefetchMip)
+		if (pResource->VisibleMip != VisibleMip || pResource->PrefetchMip != PrefetchMip || pResource->Distance != Distance)
 		{
 			pResource->VisibleMip = VisibleMip;
 			pResource->PrefetchMip = PrefetchMip;
+			pResource->Distance = Distance;
 			NotifyPagingWork(pResource);
+			RecordPagingTraceView(ImageIndex, pResource);
 		}
 
 		//
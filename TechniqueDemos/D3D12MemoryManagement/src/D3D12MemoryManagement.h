@@ -84,7 +84,8 @@ protected:
 		const RectF* pViewportBounds,
 		const Image* pImage,
 		UINT8* pVisibleMip,
-		UINT8* pPrefetchMip);
+		UINT8* pPrefetchMip,
+		float* pDistance);
 
 public:
 	D3D12MemoryManagement();
@@ -78,6 +78,11 @@ DX12Framework::DX12Framework() :
 
 DX12Framework::~DX12Framework()
 {
+	if (m_pPagingTraceFile)
+	{
+		fclose(m_pPagingTraceFile);
+		m_pPagingTraceFile = nullptr;
+	}
 }
 
 HRESULT DX12Framework::Init()
@@ -296,11 +301,13 @@ void DX12Framework::DestroyResourceDeviceState(Resource* pResource)
 	}
 
 	RemoveResourceCommitment(pResource);
-	if (pResource->PrioritizationEntry.Flink != nullptr)
-	{
-		RemoveEntryList(&pResource->PrioritizationEntry);
-		pResource->PrioritizationEntry.Flink = nullptr;
-	}
+
+	//
+	// The worker thread, along with its queues, has already been destroyed, so the
+	// resource must be queued again when the worker thread is recreated.
+	//
+	pResource->bPrioritizationPending = false;
+	pResource->PagingHeapIndex = PAGING_HEAP_INVALID_INDEX;
 }
 
 void DX12Framework::DestroyDeviceIndependentStateInternal()
@@ -639,7 +646,7 @@ HRESULT DX12Framework::CreateDeviceDependentStateInternal()
 		return E_OUTOFMEMORY;
 	}
 
-	hr = m_pWorkerThread->Init();
+	hr = m_pWorkerThread->Init(m_pPagingPolicyName);
 	if (FAILED(hr))
 	{
 		LOG_WARNING("Failed to initialize paging worker thread");
@@ -1437,7 +1444,7 @@ HRESULT DX12Framework::CreateResourceDeviceState(Resource* pResource, UINT NumMi
 	pResource->TrimLimit = ERTP_None;
 	pResource->bIgnoreBudget = false;
 
-	pResource->PagingEntry.Flink = nullptr;
+	pResource->PagingHeapIndex = PAGING_HEAP_INVALID_INDEX;
 
 	//
 	// Notify the paging thread of this resource so it can be prioritized. Although
@@ -1944,10 +1951,6 @@ HRESULT DX12Framework::GenerateMip(UINT ImageIndex, WICRect* pRect, UINT RowPitc
 {
 	const UINT RowWidth = RowPitch >> 2;
 	const UINT BufferSize = BufferSizeInBytes >> 2;
-	const UINT CellWidth = max(pRect->Width >> 3, 1);		// The width of a cell in the checkboard texture.
-	const UINT CellHeight = max(pRect->Height >> 3, 1);		// The height of a cell in the checkerboard texture.
-	const BYTE Gray = 0x88;
-	const UINT Color = GetGeneratedImageColor(ImageIndex);
 
 	if (RowWidth * pRect->Height > BufferSize)
 	{
@@ -1955,26 +1958,11 @@ HRESULT DX12Framework::GenerateMip(UINT ImageIndex, WICRect* pRect, UINT RowPitc
 		return E_INVALIDARG;
 	}
 
-	for (int y = 0; y < pRect->Height; y++)
-	{
-		UINT Index = y * RowWidth;
-		for (int x = 0; x < pRect->Width; x++)
-		{
-			UINT i = x / CellWidth;
-			UINT j = y / CellHeight;
-
-			if (i % 2 == j % 2)
-			{
-				pBuffer[Index++] = Color;
-			}
-			else
-			{
-				// A subtle gradient from the top left corner to the bottom right.
-				BYTE Shade = BYTE((i + j) << 3) + Gray;
-				pBuffer[Index++] = 0xff << 24 | Shade << 16 | Shade << 8 | Shade;
-			}
-		}
-	}
+	//
+	// The most detailed mips of the generated images are tens of megabytes, and are generated
+	// on the paging thread while the user waits for them. See MipGenerator.cpp.
+	//
+	GenerateCheckerboard(GetGeneratedImageColor(ImageIndex), pRect->Width, pRect->Height, RowWidth, pBuffer);
 
 	return S_OK;
 }
@@ -2612,15 +2600,13 @@ bool DX12Framework::TrimToTarget(ResourceTrimPass MaxPass, UINT64 TargetUsage)
 					WaitFence = pResourceMip->ReferenceFence;
 				}
 
-				if (CurrentPass == ERTP_Visible)
-				{
-					pResource->MipRestriction = DecreaseMipQuality(Mip, 1);
-				}
-				else if (CurrentPass == ERTP_NonVisible && IsLessDetailedMip(Mip, pResource->VisibleMip))
-				{
-					pResource->MipRestriction = DecreaseMipQuality(Mip, 1);
-				}
-				else if (CurrentPass == ERTP_NonPrefetchable && IsLessDetailedMip(Mip, pResource->PrefetchMip))
+				//
+				// The paging policy decides which mips each pass may trim. By default, the visible
+				// pass trims anything, the non-visible pass trims mips more detailed than the visible
+				// mip, and the non-prefetchable pass trims mips more detailed than the prefetch mip.
+				//
+				PagingResourceState State = PagingWorkerThread::GetPagingResourceState(pResource);
+				if (m_pWorkerThread->m_pPolicy->CanTrim(CurrentPass, Mip, State))
 				{
 					pResource->MipRestriction = DecreaseMipQuality(Mip, 1);
 				}
@@ -2728,5 +2714,100 @@ void DX12Framework::LoadConfig(int argc, LPCSTR argv[])
 		{
 			m_bUseSharedStagingSurface = true;
 		}
+		else if (_strcmpi(pArg, "-pagingpolicy") == 0 && i + 1 < argc)
+		{
+			//
+			// Selects the paging policy used by the worker thread. See PagingPolicy.cpp.
+			//
+			m_pPagingPolicyName = argv[++i];
+		}
+		else if (_strcmpi(pArg, "-recordpagingtrace") == 0 && i + 1 < argc)
+		{
+			//
+			// Records the camera's visibility changes and budget to a file that can be
+			// replayed by the PagingSimulator tool.
+			//
+			LPCSTR pFileName = argv[++i];
+			if (fopen_s(&m_pPagingTraceFile, pFileName, "w") != 0)
+			{
+				LOG_WARNING("Failed to open paging trace file %s", pFileName);
+				m_pPagingTraceFile = nullptr;
+			}
+		}
 	}
 }
+
+//
+// Paging traces are plain text, with one event per line. See PagingSimulator.cpp for
+// a description of the format.
+//
+void DX12Framework::RecordPagingTraceResource(UINT Id, const Resource* pResource)
+{
+	if (m_pPagingTraceFile == nullptr)
+	{
+		return;
+	}
+
+	fprintf(m_pPagingTraceFile, "resource %u %u %u %llu",
+		Id,
+		(UINT)pResource->NumStandardMips,
+		(UINT)pResource->NumPackedMips,
+		(UINT64)pResource->PackedMipTileCount * TILE_SIZE);
+
+	for (UINT Mip = 0; Mip < pResource->NumStandardMips; ++Mip)
+	{
+		fprintf(m_pPagingTraceFile, " %llu", GetNonPackedMipSize(pResource, Mip));
+	}
+
+	fprintf(m_pPagingTraceFile, "\n");
+}
+
+void DX12Framework::RecordPagingTraceView(UINT Id, const Resource* pResource)
+{
+	if (m_pPagingTraceFile == nullptr)
+	{
+		return;
+	}
+
+	fprintf(m_pPagingTraceFile, "view %u ", Id);
+
+	if (pResource->VisibleMip == UNDEFINED_MIPMAP_INDEX)
+	{
+		fprintf(m_pPagingTraceFile, "- ");
+	}
+	else
+	{
+		fprintf(m_pPagingTraceFile, "%u ", (UINT)pResource->VisibleMip);
+	}
+
+	if (pResource->PrefetchMip == UNDEFINED_MIPMAP_INDEX)
+	{
+		fprintf(m_pPagingTraceFile, "- ");
+	}
+	else
+	{
+		fprintf(m_pPagingTraceFile, "%u ", (UINT)pResource->PrefetchMip);
+	}
+
+	fprintf(m_pPagingTraceFile, "%.0f\n", pResource->Distance);
+}
+
+void DX12Framework::RecordPagingTraceFrame()
+{
+	if (m_pPagingTraceFile == nullptr)
+	{
+		return;
+	}
+
+	//
+	// The budget is recorded whenever it changes, including budget overrides.
+	//
+	UINT64 Budget = m_LocalVideoMemoryInfo.Budget;
+	if (Budget != m_PagingTraceBudget)
+	{
+		fprintf(m_pPagingTraceFile, "budget %llu\n", Budget);
+		m_PagingTraceBudget = Budget;
+	}
+
+	fprintf(m_pPagingTraceFile, "frame\n");
+}
@@ -206,6 +206,13 @@ protected:
 	bool m_bUseSharedStagingSurface = false;
 	bool m_bPresentOnVsync = true;
 
+	//
+	// Paging policy and trace recording
+	//
+	LPCSTR m_pPagingPolicyName = "default";
+	FILE* m_pPagingTraceFile = nullptr;
+	UINT64 m_PagingTraceBudget = 0;
+
 	HRESULT m_SimulatedRenderResult = S_OK;
 	UINT m_NewAdapterIndex = 0xFFFFFFFF;
 
@@ -255,6 +262,13 @@ public:
 		return TrimToTarget(TrimLimit, m_LocalVideoMemoryInfo.Budget);
 	}
 
+	//
+	// Paging traces
+	//
+	void RecordPagingTraceResource(UINT Id, const Resource* pResource);
+	void RecordPagingTraceView(UINT Id, const Resource* pResource);
+	void RecordPagingTraceFrame();
+
 	//
 	// Camera
 	//
@@ -0,0 +1,186 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// This file does not use the precompiled header, so that it can be shared with the
+// MipGeneratorTest tool.
+//
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIP_GENERATOR_SSE2 1
+#endif
+
+namespace
+{
+	const uint8_t Gray = 0x88;
+
+	//
+	// Below this many pixels per thread, starting another thread costs more than it saves.
+	//
+	const uint64_t MinPixelsPerThread = 1024 * 1024;
+
+	const uint32_t MaxThreads = 8;
+
+	inline uint32_t CellSize(uint32_t Size)
+	{
+		return std::max(Size >> 3, 1u);
+	}
+
+	inline uint32_t CellColor(uint32_t Color, uint32_t i, uint32_t j)
+	{
+		if (i % 2 == j % 2)
+		{
+			return Color;
+		}
+
+		// A subtle gradient from the top left corner to the bottom right.
+		uint8_t Shade = static_cast<uint8_t>(static_cast<uint8_t>((i + j) << 3) + Gray);
+		return 0xff000000u | Shade << 16 | Shade << 8 | Shade;
+	}
+
+	void FillSpan(uint32_t* pDest, uint32_t Count, uint32_t Value)
+	{
+#if MIP_GENERATOR_SSE2
+		//
+		// Align the destination, then store four pixels at a time.
+		//
+		while (Count > 0 && (reinterpret_cast<uintptr_t>(pDest) & 15) != 0)
+		{
+			*pDest++ = Value;
+			--Count;
+		}
+
+		__m128i Value4 = _mm_set1_epi32(static_cast<int>(Value));
+		while (Count >= 16)
+		{
+			_mm_store_si128(reinterpret_cast<__m128i*>(pDest), Value4);
+			_mm_store_si128(reinterpret_cast<__m128i*>(pDest + 4), Value4);
+			_mm_store_si128(reinterpret_cast<__m128i*>(pDest + 8), Value4);
+			_mm_store_si128(reinterpret_cast<__m128i*>(pDest + 12), Value4);
+			pDest += 16;
+			Count -= 16;
+		}
+		while (Count >= 4)
+		{
+			_mm_store_si128(reinterpret_cast<__m128i*>(pDest), Value4);
+			pDest += 4;
+			Count -= 4;
+		}
+#endif
+		while (Count > 0)
+		{
+			*pDest++ = Value;
+			--Count;
+		}
+	}
+
+	void FillRow(uint32_t Color, uint32_t Width, uint32_t CellWidth, uint32_t j, uint32_t* pRow)
+	{
+		uint32_t x = 0;
+		for (uint32_t i = 0; x < Width; ++i)
+		{
+			uint32_t SpanEnd = std::min(x + CellWidth, Width);
+			FillSpan(pRow + x, SpanEnd - x, CellColor(Color, i, j));
+			x = SpanEnd;
+		}
+	}
+}
+
+void GenerateCheckerboardRows(uint32_t Color, uint32_t Width, uint32_t Height, uint32_t RowPitch, uint32_t FirstRow, uint32_t RowCount, uint32_t* pBuffer)
+{
+	const uint32_t CellWidth = CellSize(Width);
+	const uint32_t CellHeight = CellSize(Height);
+	const uint32_t EndRow = FirstRow + RowCount;
+
+	uint32_t y = FirstRow;
+	while (y < EndRow)
+	{
+		//
+		// Build the first row of this run of cells, and copy it down to the rest.
+		//
+		uint32_t j = y / CellHeight;
+		uint32_t RunEnd = std::min((j + 1) * CellHeight, EndRow);
+
+		uint32_t* pFirstRow = pBuffer + static_cast<size_t>(y) * RowPitch;
+		FillRow(Color, Width, CellWidth, j, pFirstRow);
+
+		for (++y; y < RunEnd; ++y)
+		{
+			memcpy(pBuffer + static_cast<size_t>(y) * RowPitch, pFirstRow, Width * sizeof(uint32_t));
+		}
+	}
+}
+
+void GenerateCheckerboard(uint32_t Color, uint32_t Width, uint32_t Height, uint32_t RowPitch, uint32_t* pBuffer)
+{
+	uint64_t Pixels = static_cast<uint64_t>(Width) * Height;
+	uint32_t ThreadCount = static_cast<uint32_t>(std::min<uint64_t>(Pixels / MinPixelsPerThread, MaxThreads));
+	ThreadCount = std::min(ThreadCount, std::max(std::thread::hardware_concurrency(), 1u));
+
+	if (ThreadCount <= 1)
+	{
+		GenerateCheckerboardRows(Color, Width, Height, RowPitch, 0, Height, pBuffer);
+		return;
+	}
+
+	//
+	// The calling thread fills the first band while the others fill the rest.
+	//
+	uint32_t RowsPerThread = (Height + ThreadCount - 1) / ThreadCount;
+	std::vector<std::thread> Threads;
+	Threads.reserve(ThreadCount - 1);
+
+	for (uint32_t FirstRow = RowsPerThread; FirstRow < Height; FirstRow += RowsPerThread)
+	{
+		uint32_t RowCount = std::min(RowsPerThread, Height - FirstRow);
+		Threads.emplace_back(GenerateCheckerboardRows, Color, Width, Height, RowPitch, FirstRow, RowCount, pBuffer);
+	}
+
+	GenerateCheckerboardRows(Color, Width, Height, RowPitch, 0, std::min(RowsPerThread, Height), pBuffer);
+
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
+}
+
+void GenerateCheckerboardReference(uint32_t Color, uint32_t Width, uint32_t Height, uint32_t RowPitch, uint32_t* pBuffer)
+{
+	const uint32_t CellWidth = CellSize(Width);
+	const uint32_t CellHeight = CellSize(Height);
+
+	for (uint32_t y = 0; y < Height; y++)
+	{
+		uint32_t Index = y * RowPitch;
+		for (uint32_t x = 0; x < Width; x++)
+		{
+			uint32_t i = x / CellWidth;
+			uint32_t j = y / CellHeight;
+
+			if (i % 2 == j % 2)
+			{
+				pBuffer[Index++] = Color;
+			}
+			else
+			{
+				uint8_t Shade = static_cast<uint8_t>(static_cast<uint8_t>((i + j) << 3) + Gray);
+				pBuffer[Index++] = 0xff000000u | Shade << 16 | Shade << 8 | Shade;
+			}
+		}
+	}
+}
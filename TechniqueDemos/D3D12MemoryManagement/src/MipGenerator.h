@@ -0,0 +1,42 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+//
+// Fills the procedurally generated images with an 8x8 checkerboard of the image's color
+// and a gray gradient. These have no dependency on D3D12 or Windows, so that they can be
+// tested by the MipGeneratorTest tool.
+//
+
+#include <cstdint>
+
+//
+// Fills Width x Height 32-bit pixels of pBuffer, with rows RowPitch pixels apart. Pixels
+// between Width and RowPitch are not written.
+//
+// Each row of cells is the same, so the first row of each cell is built a cell at a time
+// with wide stores, and the rest of the cell's rows are copies of it. Large images are
+// split into bands of rows that are filled on several threads.
+//
+void GenerateCheckerboard(uint32_t Color, uint32_t Width, uint32_t Height, uint32_t RowPitch, uint32_t* pBuffer);
+
+//
+// As GenerateCheckerboard, but only fills rows [FirstRow, FirstRow + RowCount) of the
+// image, on the calling thread.
+//
+void GenerateCheckerboardRows(uint32_t Color, uint32_t Width, uint32_t Height, uint32_t RowPitch, uint32_t FirstRow, uint32_t RowCount, uint32_t* pBuffer);
+
+//
+// The original one pixel at a time implementation, which the versions above must match
+// exactly. Used by tests.
+//
+void GenerateCheckerboardReference(uint32_t Color, uint32_t Width, uint32_t Height, uint32_t RowPitch, uint32_t* pBuffer);
@@ -0,0 +1,266 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Tests and measures the procedural mip generator (MipGenerator.h), without a D3D12 device.
+//
+// Usage: MipGeneratorTest selftest
+//        MipGeneratorTest benchmark [iterations]
+//
+//   selftest    Checks that GenerateCheckerboard produces exactly the same pixels as the original one pixel at
+//               a time loop (GenerateCheckerboardReference), for every mip of the generated images, for odd
+//               sizes and row pitches, and for images filled a band of rows at a time. Pixels past the width of
+//               each row must not be written. The reference output itself is checked against golden hashes.
+//   benchmark   Reports megapixels per second for the reference loop, a single thread of the row span
+//               version, and GenerateCheckerboard, for the most detailed mip of a generated image and for
+//               one 32MB transfer of it. Defaults to 10 iterations.
+//
+// The exit code is 0 on success, 1 if a test fails and 2 for bad arguments.
+
+#include "../MipGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// The colors of the generated images, from Util.cpp.
+	const uint32_t GeneratedImageColors[] =
+	{
+		0xff0000ff,
+		0xff0088ff,
+		0xff00ffff,
+		0xff009900,
+		0xffffff00,
+		0xffff0000,
+		0xffff00ff,
+		0xff000000,
+	};
+
+	const uint32_t Canary = 0xdeadbeef;
+
+	// The generated images are 4096x4096, with 13 mips.
+	const uint32_t GeneratedImageSize = 4096;
+
+	uint64_t HashPixels(const std::vector<uint32_t>& Pixels)
+	{
+		// FNV-1a.
+		uint64_t Hash = 14695981039346656037ull;
+		for (uint32_t Pixel : Pixels)
+		{
+			for (int Byte = 0; Byte < 4; ++Byte)
+			{
+				Hash ^= (Pixel >> (Byte * 8)) & 0xff;
+				Hash *= 1099511628211ull;
+			}
+		}
+		return Hash;
+	}
+
+	struct GoldenImage
+	{
+		uint32_t Color;
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t RowPitch;
+		uint64_t Hash;
+	};
+
+	//
+	// Hashes of the output of the original GenerateMip, with the padding of each row left
+	// at zero. These catch a change to the reference as well as to the fast path.
+	//
+	const GoldenImage GoldenImages[] =
+	{
+		{ 0xff0000ff, 256, 256, 256, 0x34bb0bd316f72325ull },
+		{ 0xff009900, 64, 64, 64, 0xe1fca2d64edd5325ull },
+		{ 0xffff00ff, 1, 1, 64, 0x9d0553a48b15fcf0ull },
+		{ 0xff000000, 37, 13, 40, 0xdac7d427ab9d6eb8ull },
+		{ 0xff0088ff, 4096, 2048, 4096, 0xcb2b0e598ea22325ull },
+	};
+
+	bool CompareWithReference(uint32_t Color, uint32_t Width, uint32_t Height, uint32_t RowPitch, uint32_t BandHeight)
+	{
+		size_t Size = static_cast<size_t>(RowPitch) * Height;
+		std::vector<uint32_t> Expected(Size, Canary);
+		std::vector<uint32_t> Actual(Size, Canary);
+
+		GenerateCheckerboardReference(Color, Width, Height, RowPitch, Expected.data());
+
+		if (BandHeight == 0)
+		{
+			GenerateCheckerboard(Color, Width, Height, RowPitch, Actual.data());
+		}
+		else
+		{
+			for (uint32_t FirstRow = 0; FirstRow < Height; FirstRow += BandHeight)
+			{
+				GenerateCheckerboardRows(Color, Width, Height, RowPitch, FirstRow, std::min(BandHeight, Height - FirstRow), Actual.data());
+			}
+		}
+
+		if (Expected != Actual)
+		{
+			size_t First = std::mismatch(Expected.begin(), Expected.end(), Actual.begin()).first - Expected.begin();
+			printf("FAILED: %ux%u, pitch %u, bands of %u: pixel (%zu, %zu) is 0x%08x, expected 0x%08x\n",
+				Width, Height, RowPitch, BandHeight, First % RowPitch, First / RowPitch, Actual[First], Expected[First]);
+			return false;
+		}
+
+		return true;
+	}
+
+	int RunSelfTest()
+	{
+		int Failures = 0;
+		int Cases = 0;
+
+		for (const GoldenImage& Golden : GoldenImages)
+		{
+			std::vector<uint32_t> Pixels(static_cast<size_t>(Golden.RowPitch) * Golden.Height, 0);
+			GenerateCheckerboardReference(Golden.Color, Golden.Width, Golden.Height, Golden.RowPitch, Pixels.data());
+
+			uint64_t Hash = HashPixels(Pixels);
+			if (Hash != Golden.Hash)
+			{
+				printf("FAILED: reference %ux%u, pitch %u hashes to 0x%016llx, expected 0x%016llx\n",
+					Golden.Width, Golden.Height, Golden.RowPitch, static_cast<unsigned long long>(Hash), static_cast<unsigned long long>(Golden.Hash));
+				++Failures;
+			}
+			++Cases;
+		}
+
+		//
+		// Every mip of every generated image, as a whole and as the paging thread transfers it.
+		// Pitches are aligned to 256 bytes, like D3D12_TEXTURE_DATA_PITCH_ALIGNMENT.
+		//
+		for (uint32_t Color : GeneratedImageColors)
+		{
+			for (uint32_t Size = GeneratedImageSize; Size > 0; Size >>= 1)
+			{
+				uint32_t RowPitch = (Size + 63) & ~63u;
+				Failures += !CompareWithReference(Color, Size, Size, RowPitch, 0);
+				Failures += !CompareWithReference(Color, Size, Size, RowPitch, std::max(Size / 3, 1u));
+				Cases += 2;
+			}
+		}
+
+		//
+		// Sizes that don't divide into cells evenly, unaligned pitches, and more threads.
+		//
+		const uint32_t Widths[] = { 1, 2, 3, 7, 8, 9, 15, 17, 31, 33, 63, 65, 127, 1000, 1023, 1025, 3001 };
+		for (uint32_t Width : Widths)
+		{
+			for (uint32_t Height : Widths)
+			{
+				for (uint32_t Padding : { 0u, 1u, 5u })
+				{
+					uint32_t Band = (Width + Height) % 2 == 0 ? 0 : 1 + (Width * 7 + Height) % 37;
+					Failures += !CompareWithReference(GeneratedImageColors[Width % 8], Width, Height, Width + Padding, Band);
+					++Cases;
+				}
+			}
+		}
+		Failures += !CompareWithReference(GeneratedImageColors[3], 3001, 4099, 3003, 0);
+		++Cases;
+
+		if (Failures != 0)
+		{
+			printf("selftest FAILED (%d of %d cases)\n", Failures, Cases);
+			return 1;
+		}
+
+		printf("selftest passed (%d cases)\n", Cases);
+		return 0;
+	}
+
+	template<typename Generator>
+	double MeasureMegapixelsPerSecond(uint32_t Width, uint32_t Height, int Iterations, Generator Generate)
+	{
+		std::vector<uint32_t> Pixels(static_cast<size_t>(Width) * Height);
+
+		// Touch the buffer first, so page faults aren't measured.
+		Generate(Pixels.data());
+
+		double Best = 0.0;
+		for (int i = 0; i < Iterations; ++i)
+		{
+			auto Start = std::chrono::high_resolution_clock::now();
+			Generate(Pixels.data());
+			auto End = std::chrono::high_resolution_clock::now();
+
+			double Seconds = std::chrono::duration<double>(End - Start).count();
+			Best = std::max(Best, Width * static_cast<double>(Height) / Seconds / 1e6);
+		}
+		return Best;
+	}
+
+	void RunBenchmark(const char* pName, uint32_t Width, uint32_t Height, int Iterations)
+	{
+		const uint32_t Color = GeneratedImageColors[0];
+
+		double Reference = MeasureMegapixelsPerSecond(Width, Height, Iterations, [&](uint32_t* pPixels)
+		{
+			GenerateCheckerboardReference(Color, Width, Height, Width, pPixels);
+		});
+		double SingleThread = MeasureMegapixelsPerSecond(Width, Height, Iterations, [&](uint32_t* pPixels)
+		{
+			GenerateCheckerboardRows(Color, Width, Height, Width, 0, Height, pPixels);
+		});
+		double Threaded = MeasureMegapixelsPerSecond(Width, Height, Iterations, [&](uint32_t* pPixels)
+		{
+			GenerateCheckerboard(Color, Width, Height, Width, pPixels);
+		});
+
+		printf("%-22s %12.0f %12.0f %12.0f %8.1fx\n", pName, Reference, SingleThread, Threaded, Threaded / Reference);
+	}
+
+	int RunBenchmarks(int Iterations)
+	{
+		printf("megapixels per second, best of %d\n", Iterations);
+		printf("%-22s %12s %12s %12s %9s\n", "image", "reference", "row spans", "threaded", "speedup");
+		RunBenchmark("4096x4096 mip", GeneratedImageSize, GeneratedImageSize, Iterations);
+		RunBenchmark("4096x2048 transfer", GeneratedImageSize, GeneratedImageSize / 2, Iterations);
+		RunBenchmark("512x512 mip", 512, 512, Iterations);
+		return 0;
+	}
+
+	void PrintUsage()
+	{
+		printf("Usage: MipGeneratorTest selftest\n");
+		printf("       MipGeneratorTest benchmark [iterations]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 2 && strcmp(argv[1], "selftest") == 0)
+	{
+		return RunSelfTest();
+	}
+	else if ((argc == 2 || argc == 3) && strcmp(argv[1], "benchmark") == 0)
+	{
+		int Iterations = argc > 2 ? atoi(argv[2]) : 10;
+		if (Iterations <= 0)
+		{
+			PrintUsage();
+			return 2;
+		}
+
+		return RunBenchmarks(Iterations);
+	}
+
+	PrintUsage();
+	return 2;
+}
@@ -11,6 +11,8 @@
 
 #include "stdafx.h"
 
+static_assert(PAGING_UNDEFINED_MIP == UNDEFINED_MIPMAP_INDEX, "The paging policy must agree on the undefined mip index");
+
 //
 // PagingWorkerThread
 //
@@ -24,16 +26,10 @@ PagingWorkerThread::PagingWorkerThread(DX12Framework* pFramework) :
 	m_hThread(nullptr),
 	m_CurrentStatus(EWTS_Suspended),
 	m_RequestedStatus(EWTS_Suspended),
-	m_BudgetNotificationCookie(0)
+	m_BudgetNotificationCookie(0),
+	m_pPolicy(nullptr),
+	m_bSubmissionSignaled(false)
 {
-	InitializeListHead(&m_PrioritizationListHead);
-	for (int i = 0; i < _ERP_COUNT; ++i)
-	{
-		InitializeListHead(&m_PriorityQueues[i]);
-	}
-
-	InitializeCriticalSection(&m_PrioritizationListLock);
-
 	ZeroMemory(m_hWakeEvents, sizeof(m_hWakeEvents));
 }
 
@@ -68,12 +64,23 @@ PagingWorkerThread::~PagingWorkerThread()
 	{
 		m_pFramework->GetAdapter()->UnregisterVideoMemoryBudgetChangeNotification(m_BudgetNotificationCookie);
 	}
+
+	SafeDelete(m_pPolicy);
 }
 
-HRESULT PagingWorkerThread::Init()
+HRESULT PagingWorkerThread::Init(const char* pPolicyName)
 {
 	HRESULT hr;
 
+	m_pPolicy = CreatePagingPolicy(pPolicyName);
+	if (m_pPolicy == nullptr)
+	{
+		LOG_ERROR("Unknown paging policy '%s'", pPolicyName);
+		return E_INVALIDARG;
+	}
+
+	LOG_MESSAGE("Using the '%s' paging policy", m_pPolicy->GetName());
+
 	for (UINT i = 0; i < _countof(m_hWakeEvents); ++i)
 	{
 		HANDLE hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
@@ -231,9 +238,15 @@ DWORD PagingWorkerThread::Run()
 
 void PagingWorkerThread::DiscardPendingWork()
 {
+	while (MpscQueueEntry* pEntry = m_PrioritizationQueue.Pop())
+	{
+		Resource* pResource = CONTAINING_RECORD(pEntry, Resource, PrioritizationEntry);
+		pResource->bPrioritizationPending = false;
+	}
+
 	for (int i = 0; i < _ERP_COUNT; ++i)
 	{
-		InitializeListHead(&m_PriorityQueues[i]);
+		m_PriorityQueues[i].Clear();
 	}
 }
 
@@ -326,107 +339,105 @@ void PagingWorkerThread::SetStatus(WorkerThreadStatus Status)
 void PagingWorkerThread::EnqueueResource(Resource* pResource)
 {
 	//
-	// Take the prioritization lock as we insert resources into the prioritization list.
-	// This synchronizes the rendering thread queuing work items with the paging thread
-	// prioritizing it.
+	// The rendering thread may notify the paging thread of thousands of resources in a
+	// single frame, so this must not block. Resources are pushed onto a lock-free queue,
+	// and a resource that is already waiting in the queue is not pushed again; the paging
+	// thread reads the resource's latest state when it gets to it.
 	//
-	EnterCriticalSection(&m_PrioritizationListLock);
-
-	if (pResource->PrioritizationEntry.Flink != nullptr)
+	if (!pResource->bPrioritizationPending.exchange(true))
 	{
-		RemoveEntryList(&pResource->PrioritizationEntry);
+		m_PrioritizationQueue.Push(&pResource->PrioritizationEntry);
 	}
-	InsertTailList(&m_PrioritizationListHead, &pResource->PrioritizationEntry);
 
-	LeaveCriticalSection(&m_PrioritizationListLock);
-
-	SetEvent(m_hWakeEvents[EWR_Submission]);
+	//
+	// Only signal the paging thread if it hasn't been signaled since it last drained
+	// the queue. This must come after the push, see MpscQueue::Pop.
+	//
+	if (!m_bSubmissionSignaled.exchange(true))
+	{
+		SetEvent(m_hWakeEvents[EWR_Submission]);
+	}
 }
 
 void PagingWorkerThread::ReprioritizeResources()
 {
-	EnterCriticalSection(&m_PrioritizationListLock);
-	while (!IsListEmpty(&m_PrioritizationListHead))
+	m_bSubmissionSignaled = false;
+
+	while (MpscQueueEntry* pEntry = m_PrioritizationQueue.Pop())
 	{
-		LIST_ENTRY* pEntry = RemoveHeadList(&m_PrioritizationListHead);
 		Resource* pResource = CONTAINING_RECORD(pEntry, Resource, PrioritizationEntry);
-		pResource->PrioritizationEntry.Flink = nullptr;
+
+		//
+		// Clear the pending flag before reading the resource's state, so that any change
+		// made after this point queues the resource again.
+		//
+		pResource->bPrioritizationPending = false;
 
 		PrioritizeResource(pResource);
 	}
-	LeaveCriticalSection(&m_PrioritizationListLock);
 }
 
-void PagingWorkerThread::PrioritizeResource(Resource* pResource)
+PagingResourceState PagingWorkerThread::GetPagingResourceState(const Resource* pResource)
 {
-	UINT8 MostDetailedMipResident = pResource->MostDetailedMipResident;
-	UINT8 VisibleMip = pResource->VisibleMip;
-	UINT8 PrefetchMip = pResource->PrefetchMip;
+	PagingResourceState State;
+	State.MostDetailedMipResident = pResource->MostDetailedMipResident;
+	State.LeastDetailedMipHeapIndex = GetLeastDetailedMipHeapIndex(pResource);
+	State.VisibleMip = pResource->VisibleMip;
+	State.PrefetchMip = pResource->PrefetchMip;
+	State.Distance = pResource->Distance;
 
-	if (pResource->PagingEntry.Flink != nullptr)
+	//
+	// Like SelectResource, only standard mipmaps are counted. Packed mipmaps are small
+	// and are never restricted by the budget.
+	//
+	State.NextMipSize = 0;
+	if (pResource->MostDetailedMipResident != 0)
 	{
-		RemoveEntryList(&pResource->PagingEntry);
-		pResource->PagingEntry.Flink = nullptr;
+		UINT NextMip = IncreaseMipQuality(pResource->MostDetailedMipResident, 1);
+		if (NextMip < pResource->PackedMipHeapIndex)
+		{
+			State.NextMipSize = GetNonPackedMipSize(pResource, NextMip);
+		}
 	}
 
-	bool AnyPackedMipsMissing = MostDetailedMipResident > GetLeastDetailedMipHeapIndex(pResource);
-	bool IsInPrefetchZone = (PrefetchMip != UNDEFINED_MIPMAP_INDEX);
+	return State;
+}
+
+//
+// PrioritizeResource asks the paging policy for the next paging operation on the resource,
+// and places the resource in the chosen queue. See PagingPolicy.cpp for the policies. The
+// default policy sends missing packed mips to the front of the queues, followed by visible
+// mipmaps, nearby (prefetched) mipmaps, and finally everything else in round-robin order.
+//
+void PagingWorkerThread::PrioritizeResource(Resource* pResource)
+{
+	RemoveFromPriorityQueue(pResource);
 
-	if (AnyPackedMipsMissing && IsInPrefetchZone)
-	{
-		//
-		// If the resource has not been loaded at all, and it's in the prefetch zone,
-		// consider it very high priority. We will not only add it to the high priority
-		// queue, but also push it in at the front to ensure this occurs before anything
-		// else. We want to make sure the user has *something* to see, even if it's just
-		// the 1x1 mipmap of a rough color.
-		//
-		InsertTailList(&m_PriorityQueues[ERP_VeryHigh], &pResource->PagingEntry);
-		pResource->TrimLimit = ERTP_Visible;
-		pResource->bIgnoreBudget = true;
-	}
-	else if (IsMoreDetailedMip(MostDetailedMipResident, VisibleMip))
+	PagingDecision Decision = m_pPolicy->Prioritize(GetPagingResourceState(pResource));
+	if (!Decision.bQueue)
 	{
-		//
-		// The user has requested a visible mipmap that is of a greater detail than the
-		// one currently resident. This is high priority, because we want what's on screen
-		// to be visually correct.
-		//
-		InsertTailList(&m_PriorityQueues[ERP_High], &pResource->PagingEntry);
-		pResource->TrimLimit = ERTP_NonVisible;
+		return;
 	}
-	else if (AnyPackedMipsMissing)
+
+	pResource->PagingScore = Decision.Score;
+	pResource->TrimLimit = Decision.TrimLimit;
+	if (Decision.bIgnoreBudget)
 	{
-		//
-		// The resource has not been loaded, but is a somewhat safe distance away from the
-		// camera to be considered a lower priority. We will make sure that the stuff the user
-		// sees on screen gets loaded before this.
-		//
-		InsertHeadList(&m_PriorityQueues[ERP_Medium], &pResource->PagingEntry);
-		pResource->TrimLimit = ERTP_Visible;
 		pResource->bIgnoreBudget = true;
 	}
-	else if (IsMoreDetailedMip(MostDetailedMipResident, PrefetchMip))
-	{
-		//
-		// This is a proximity prefetched mipmap. The user cannot see this mipmap yet, but it
-		// is nearby. We want to reduce any texture popping that may occur as the user scrolls
-		//
-		InsertTailList(&m_PriorityQueues[ERP_Medium], &pResource->PagingEntry);
-		pResource->TrimLimit = ERTP_NonPrefetchable;
 
-		assert(PrefetchMip != UNDEFINED_MIPMAP_INDEX);
-	}
-	else if (MostDetailedMipResident != 0)
+	m_PriorityQueues[Decision.Queue].Insert(pResource, Decision.bInsertAtHead);
+}
+
+void PagingWorkerThread::RemoveFromPriorityQueue(Resource* pResource)
+{
+	for (int i = 0; i < _ERP_COUNT; ++i)
 	{
-		//
-		// This texture is not near the user, but we are under our budget and we haven't loaded
-		// all the mipmaps for this texture yet. This is a low priority work item that will
-		// occur after everything else, but will help guarantee that the user gets a smooth
-		// experience at all times by prefetching the texture data prior to being needed.
-		//
-		InsertTailList(&m_PriorityQueues[ERP_Low], &pResource->PagingEntry);
-		pResource->TrimLimit = ERTP_None;
+		if (m_PriorityQueues[i].Contains(pResource))
+		{
+			m_PriorityQueues[i].Remove(pResource);
+			return;
+		}
 	}
 }
 
@@ -443,17 +454,14 @@ Resource* PagingWorkerThread::SelectResource()
 		// A small bias is applied to the current local budget to help prevent resources from
 		// going over. The size calculated by the driver may differ slightly from the size
 		// calculated by the kernel (due to various alignment and segment restrictions), and so
-		// a buffer is used to prevent the operation from accidentally going over.
+		// a buffer is used to prevent the operation from accidentally going over. The policy
+		// decides how large the bias is for each priority.
 		//
-		// The bias is determined by the priority of the operation. There is a 1MB minimum
-		// bias as a "safety zone," and an 8MB buffer for each priority after that.
-		//
-		UINT64 BudgetBias = _1MB + _8MB * i;
+		UINT64 BudgetBias = m_pPolicy->GetBudgetReserve(static_cast<ResourcePriority>(i));
 
-		if (!IsListEmpty(&m_PriorityQueues[i]))
+		if (!m_PriorityQueues[i].IsEmpty())
 		{
-			LIST_ENTRY* pEntry = m_PriorityQueues[i].Flink;
-			Resource* pResource = CONTAINING_RECORD(pEntry, Resource, PagingEntry);
+			Resource* pResource = m_PriorityQueues[i].GetTop();
 
 			//
 			// The paging thread will only page in one mipmap at a time to be fair to all
@@ -498,8 +506,11 @@ Resource* PagingWorkerThread::SelectResource()
 				}
 			}
 
-			RemoveEntryList(pEntry);
-			pEntry->Flink = nullptr;
+			//
+			// Trimming may have reprioritized this resource, so it isn't necessarily still
+			// at the top of this queue.
+			//
+			RemoveFromPriorityQueue(pResource);
 			pResource->bIgnoreBudget = false;
 
 			return pResource;
@@ -73,24 +73,30 @@ private:
 	HANDLE m_hStatusChangeEvent;
 	DWORD m_BudgetNotificationCookie;
 
-	// Lock for accessing the prioritization list head, which is accessed by both
-	// the rendering and paging threads.
-	CRITICAL_SECTION m_PrioritizationListLock;
-
-	// A list of unprioritized resources. A resource must be prioritized before
+	// A queue of unprioritized resources. A resource must be prioritized before
 	// any paging operations can occur, so that the paging thread knows how to process
-	// the resource.
-	LIST_ENTRY m_PrioritizationListHead;
+	// the resource. The rendering thread pushes resources without taking a lock, and
+	// only the paging thread pops them.
+	MpscQueue m_PrioritizationQueue;
+
+	// Set when the submission event has been signaled, and cleared by the paging thread
+	// before it drains the prioritization queue. This saves the rendering thread from
+	// signaling the event once per resource.
+	std::atomic<bool> m_bSubmissionSignaled;
 
-	// An array of priority-ordered linked list heads. The worker thread will process
-	// resources in these arrays in strict order.
-	LIST_ENTRY m_PriorityQueues[_ERP_COUNT];
+	// An array of priority queues, each ordered by the score the paging policy gave the
+	// resource. The worker thread will process resources in these queues in strict order.
+	// Only the paging thread accesses them.
+	PagingPriorityHeap<Resource> m_PriorityQueues[_ERP_COUNT];
+
+	// Decides how resources are prioritized and trimmed. Owned by the worker thread.
+	PagingPolicy* m_pPolicy;
 
 private:
 	PagingWorkerThread(DX12Framework* pFramework);
 	~PagingWorkerThread();
 
-	HRESULT Init();
+	HRESULT Init(const char* pPolicyName);
 
 	void Flush();
 	void DiscardPendingWork();
@@ -99,8 +105,11 @@ private:
 	void EnqueueResource(Resource* pResource);
 	void ReprioritizeResources();
 	void PrioritizeResource(Resource* pResource);
+	void RemoveFromPriorityQueue(Resource* pResource);
 	Resource* SelectResource();
 
+	static PagingResourceState GetPagingResourceState(const Resource* pResource);
+
 	void ProcessStatusChangeRequest();
 	void ProcessSubmission(bool* pMoreWork);
 	void ProcessBudgetChangeNotification();
@@ -0,0 +1,289 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// This file does not use the precompiled header, so that it can be shared with the
+// PagingSimulator tool.
+//
+#include "PagingPolicy.h"
+
+#include <cstring>
+
+namespace
+{
+	const uint64_t PagingPolicy1MB = 1024 * 1024;
+	const uint64_t PagingPolicy8MB = 8 * PagingPolicy1MB;
+
+	//
+	// Screen-space distance, in pixels, at which the distance weighted policies halve
+	// the priority of a resource.
+	//
+	const float DistanceFalloff = 256.0f;
+
+	//
+	// Returns true if 'MipToCheck' is more detailed that 'CurrentMip'
+	//
+	inline bool IsMoreDetailed(uint8_t CurrentMip, uint8_t MipToCheck)
+	{
+		return MipToCheck < CurrentMip;
+	}
+
+	inline PagingDecision MakeDecision(ResourcePriority Queue, ResourceTrimPass TrimLimit, float Score)
+	{
+		PagingDecision Decision = {};
+		Decision.bQueue = true;
+		Decision.Queue = Queue;
+		Decision.Score = Score;
+		Decision.TrimLimit = TrimLimit;
+		return Decision;
+	}
+
+	inline float DistanceWeight(const PagingResourceState& State)
+	{
+		return 1.0f / (1.0f + State.Distance / DistanceFalloff);
+	}
+
+	//
+	// The number of mip levels between the resident mip and the requested one.
+	//
+	inline float MipDeficit(const PagingResourceState& State, uint8_t RequestedMip)
+	{
+		return static_cast<float>(State.MostDetailedMipResident - RequestedMip);
+	}
+
+	//
+	// The sample's original policy. Resources are sorted into the priority queues by
+	// visibility, and processed in FIFO order within each queue.
+	//
+	class DefaultPagingPolicy : public PagingPolicy
+	{
+	public:
+		virtual const char* GetName() const override
+		{
+			return "default";
+		}
+
+		virtual PagingDecision Prioritize(const PagingResourceState& State) const override
+		{
+			bool AnyPackedMipsMissing = State.MostDetailedMipResident > State.LeastDetailedMipHeapIndex;
+			bool IsInPrefetchZone = (State.PrefetchMip != PAGING_UNDEFINED_MIP);
+
+			if (AnyPackedMipsMissing && IsInPrefetchZone)
+			{
+				//
+				// If the resource has not been loaded at all, and it's in the prefetch zone,
+				// consider it very high priority. We want to make sure the user has *something*
+				// to see, even if it's just the 1x1 mipmap of a rough color.
+				//
+				PagingDecision Decision = MakeDecision(ERP_VeryHigh, ERTP_Visible, 0.0f);
+				Decision.bIgnoreBudget = true;
+				return Decision;
+			}
+			else if (IsMoreDetailed(State.MostDetailedMipResident, State.VisibleMip))
+			{
+				//
+				// The user has requested a visible mipmap that is of a greater detail than the
+				// one currently resident. This is high priority, because we want what's on screen
+				// to be visually correct.
+				//
+				return MakeDecision(ERP_High, ERTP_NonVisible, 0.0f);
+			}
+			else if (AnyPackedMipsMissing)
+			{
+				//
+				// The resource has not been loaded, but is a somewhat safe distance away from the
+				// camera to be considered a lower priority. We will make sure that the stuff the user
+				// sees on screen gets loaded before this.
+				//
+				PagingDecision Decision = MakeDecision(ERP_Medium, ERTP_Visible, 0.0f);
+				Decision.bInsertAtHead = true;
+				Decision.bIgnoreBudget = true;
+				return Decision;
+			}
+			else if (IsMoreDetailed(State.MostDetailedMipResident, State.PrefetchMip))
+			{
+				//
+				// This is a proximity prefetched mipmap. The user cannot see this mipmap yet, but it
+				// is nearby. We want to reduce any texture popping that may occur as the user scrolls
+				//
+				return MakeDecision(ERP_Medium, ERTP_NonPrefetchable, 0.0f);
+			}
+			else if (State.MostDetailedMipResident != 0)
+			{
+				//
+				// This texture is not near the user, but we haven't loaded all the mipmaps for this
+				// texture yet. This is a low priority work item that will occur after everything else,
+				// but will help guarantee that the user gets a smooth experience at all times by
+				// prefetching the texture data prior to being needed.
+				//
+				return MakeDecision(ERP_Low, ERTP_None, 0.0f);
+			}
+
+			PagingDecision Decision = {};
+			return Decision;
+		}
+	};
+
+	//
+	// Uses the same queues as the default policy, but orders each queue by how far the
+	// resource is from the viewport, and how far its resident mip is from the one requested.
+	// This favors the images the user is looking at over those that merely became visible
+	// first, and makes low priority prefetching spiral outwards from the camera instead
+	// of visiting resources in round-robin order.
+	//
+	class DistanceWeightedPagingPolicy : public DefaultPagingPolicy
+	{
+	public:
+		virtual const char* GetName() const override
+		{
+			return "distance";
+		}
+
+		virtual PagingDecision Prioritize(const PagingResourceState& State) const override
+		{
+			PagingDecision Decision = DefaultPagingPolicy::Prioritize(State);
+			if (!Decision.bQueue)
+			{
+				return Decision;
+			}
+
+			float Deficit = 1.0f;
+			if (Decision.Queue == ERP_High)
+			{
+				Deficit = MipDeficit(State, State.VisibleMip);
+			}
+			else if (Decision.Queue == ERP_Medium && !Decision.bIgnoreBudget)
+			{
+				Deficit = MipDeficit(State, State.PrefetchMip);
+			}
+
+			Decision.Score = Deficit * DistanceWeight(State);
+			Decision.bInsertAtHead = false;
+			return Decision;
+		}
+	};
+
+	//
+	// Scores every operation by the benefit it provides per byte of budget it consumes.
+	// Visible and prefetched mipmaps share a single queue, so a cheap prefetch may be
+	// processed before an expensive visible mipmap. Missing packed mipmaps are still
+	// processed first, since they have no budget cost.
+	//
+	class CostBenefitPagingPolicy : public DefaultPagingPolicy
+	{
+	public:
+		virtual const char* GetName() const override
+		{
+			return "costbenefit";
+		}
+
+		virtual PagingDecision Prioritize(const PagingResourceState& State) const override
+		{
+			PagingDecision Decision = DefaultPagingPolicy::Prioritize(State);
+			if (!Decision.bQueue)
+			{
+				return Decision;
+			}
+
+			//
+			// A visible mip level is worth several prefetched ones; prefetched and
+			// speculative levels are discounted by distance.
+			//
+			const float VisibleWeight = 4.0f;
+
+			float Benefit;
+			if (Decision.Queue == ERP_High)
+			{
+				Benefit = VisibleWeight * MipDeficit(State, State.VisibleMip);
+			}
+			else if (Decision.Queue == ERP_Medium && !Decision.bIgnoreBudget)
+			{
+				Benefit = MipDeficit(State, State.PrefetchMip) * DistanceWeight(State);
+				Decision.Queue = ERP_High;
+			}
+			else
+			{
+				Benefit = DistanceWeight(State);
+			}
+
+			//
+			// Packed mipmaps have no cost, but a single tile is a reasonable estimate.
+			//
+			float CostInMB = static_cast<float>(State.NextMipSize) / PagingPolicy1MB;
+			if (CostInMB < 1.0f / 16)
+			{
+				CostInMB = 1.0f / 16;
+			}
+
+			Decision.Score = Benefit / CostInMB;
+			Decision.bInsertAtHead = false;
+			return Decision;
+		}
+	};
+}
+
+const char* const g_PagingPolicyNames[] =
+{
+	"default",
+	"distance",
+	"costbenefit",
+	nullptr
+};
+
+uint64_t PagingPolicy::GetBudgetReserve(ResourcePriority Queue) const
+{
+	//
+	// A small bias is applied to the current local budget to help prevent resources from
+	// going over. The size calculated by the driver may differ slightly from the size
+	// calculated by the kernel (due to various alignment and segment restrictions), and so
+	// a buffer is used to prevent the operation from accidentally going over.
+	//
+	// The bias is determined by the priority of the operation. There is a 1MB minimum
+	// bias as a "safety zone," and an 8MB buffer for each priority after that.
+	//
+	return PagingPolicy1MB + PagingPolicy8MB * Queue;
+}
+
+bool PagingPolicy::CanTrim(ResourceTrimPass Pass, uint8_t Mip, const PagingResourceState& State) const
+{
+	switch (Pass)
+	{
+	case ERTP_Visible:
+		return true;
+
+	case ERTP_NonVisible:
+		return State.VisibleMip > Mip;
+
+	case ERTP_NonPrefetchable:
+		return State.PrefetchMip > Mip;
+
+	default:
+		return false;
+	}
+}
+
+PagingPolicy* CreatePagingPolicy(const char* pName)
+{
+	if (strcmp(pName, "default") == 0)
+	{
+		return new DefaultPagingPolicy();
+	}
+	else if (strcmp(pName, "distance") == 0)
+	{
+		return new DistanceWeightedPagingPolicy();
+	}
+	else if (strcmp(pName, "costbenefit") == 0)
+	{
+		return new CostBenefitPagingPolicy();
+	}
+
+	return nullptr;
+}
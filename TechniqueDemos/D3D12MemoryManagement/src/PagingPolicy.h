@@ -0,0 +1,141 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+//
+// The paging policy decides how the worker thread orders paging operations, how much
+// headroom it leaves under the budget, and which mipmaps it may trim. It only sees the
+// abstract state of a resource below, with no dependency on D3D12 or Windows, so that
+// the same policies can be replayed against recorded traces by the PagingSimulator tool.
+//
+
+#include <cstdint>
+
+//
+// Describes the priority which the worker thread uses to page in a resource. A
+// higher priority resource will always be paged in before a lower priority resource.
+//
+enum ResourcePriority
+{
+	ERP_VeryHigh,
+	ERP_High,
+	ERP_Medium,
+	ERP_Low,
+	_ERP_COUNT
+};
+
+//
+// This enum is used to restrict the extent of trimming operations when the process
+// is over its local memory budget. This helps ensure that lower priority resources not
+// cause higher priority resources to be trimmed, and prevents the worker thread from
+// recursively paging in new content.
+// e.g. a high quality prefetched mip will not trim a mipmap that is currently
+// visible on the screen.
+//
+enum ResourceTrimPass
+{
+	ERTP_None,
+	ERTP_NonPrefetchable,
+	ERTP_NonVisible,
+	ERTP_Visible,
+};
+
+//
+// The mip index used when a resource is neither visible nor in the prefetch zone.
+// This must match UNDEFINED_MIPMAP_INDEX.
+//
+#define PAGING_UNDEFINED_MIP 15
+
+//
+// The state of a single resource, as seen by the paging policy.
+//
+struct PagingResourceState
+{
+	// The most detailed mip level that is fully resident.
+	uint8_t MostDetailedMipResident;
+
+	// The heap index of the least detailed mipmap. Mips at or beyond this index are never
+	// trimmed, and any resource with less than this resident is missing its packed mips.
+	uint8_t LeastDetailedMipHeapIndex;
+
+	// The visible and prefetch mips requested by the render thread, or PAGING_UNDEFINED_MIP.
+	uint8_t VisibleMip;
+	uint8_t PrefetchMip;
+
+	// The number of bytes that paging in the next level of detail will add to the budget.
+	// This is zero for packed mipmaps.
+	uint64_t NextMipSize;
+
+	// The screen-space distance, in pixels, between the resource and the viewport. Zero
+	// when the resource is visible.
+	float Distance;
+};
+
+//
+// The result of prioritizing a resource.
+//
+struct PagingDecision
+{
+	// False if the resource has no more paging work to do.
+	bool bQueue;
+
+	// The queue the resource is placed in. Queues are always processed in order.
+	ResourcePriority Queue;
+
+	// Orders resources within a queue; higher scores are processed first. Resources with
+	// equal scores keep their insertion order, so a policy that gives every resource the
+	// same score gets plain FIFO (or LIFO, with bInsertAtHead) queues.
+	float Score;
+	bool bInsertAtHead;
+
+	// The maximum trimming pass that may be used to make room for this operation.
+	ResourceTrimPass TrimLimit;
+
+	// True if the operation should be processed even if it goes over the budget.
+	bool bIgnoreBudget;
+};
+
+class PagingPolicy
+{
+public:
+	virtual ~PagingPolicy() {}
+
+	virtual const char* GetName() const = 0;
+
+	//
+	// Chooses the queue, score and trimming restrictions for the next paging operation
+	// on a resource.
+	//
+	virtual PagingDecision Prioritize(const PagingResourceState& State) const = 0;
+
+	//
+	// Returns the number of bytes that must remain free under the budget, in addition to
+	// the size of the mipmap, before an operation from the given queue is processed.
+	//
+	virtual uint64_t GetBudgetReserve(ResourcePriority Queue) const;
+
+	//
+	// Returns true if the given trimming pass may evict mip 'Mip' of a resource.
+	//
+	virtual bool CanTrim(ResourceTrimPass Pass, uint8_t Mip, const PagingResourceState& State) const;
+};
+
+//
+// Creates one of the built-in policies by name ("default", "distance" or "costbenefit").
+// Returns nullptr if the name is not recognized. The caller owns the returned policy.
+//
+PagingPolicy* CreatePagingPolicy(const char* pName);
+
+//
+// The names accepted by CreatePagingPolicy, terminated by nullptr.
+//
+extern const char* const g_PagingPolicyNames[];
@@ -0,0 +1,302 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+//
+// The queues used to hand resources from the render thread to the paging worker thread.
+// These have no dependency on D3D12 or Windows, so that they can be tested by the
+// PagingQueueTest tool.
+//
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//
+// An entry in an MpscQueue. Embed one in each object that can be queued.
+//
+struct MpscQueueEntry
+{
+	std::atomic<MpscQueueEntry*> pNext;
+};
+
+//
+// An intrusive, lock-free, multiple producer single consumer FIFO queue.
+//
+// Any thread may push entries, but only one thread may pop them. Push is wait-free: a
+// single atomic exchange followed by a store. An entry must not be pushed again until it
+// has been popped; callers usually guard the entry with an atomic 'pending' flag that is
+// set before pushing and cleared by the consumer after popping.
+//
+// Pop may return nullptr while a push is in progress on another thread, even if other
+// entries have been pushed after it. The producer must therefore wake the consumer after
+// each push completes, so that it tries again.
+//
+class MpscQueue
+{
+public:
+	MpscQueue()
+	{
+		m_Stub.pNext.store(nullptr, std::memory_order_relaxed);
+		m_pHead.store(&m_Stub, std::memory_order_relaxed);
+		m_pTail = &m_Stub;
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	void Push(MpscQueueEntry* pEntry)
+	{
+		pEntry->pNext.store(nullptr, std::memory_order_relaxed);
+
+		//
+		// Claim the head, then link the previous head to the new entry. Until the link is
+		// stored, the consumer cannot see this entry or any pushed after it.
+		//
+		MpscQueueEntry* pPrevious = m_pHead.exchange(pEntry, std::memory_order_acq_rel);
+		pPrevious->pNext.store(pEntry, std::memory_order_release);
+	}
+
+	MpscQueueEntry* Pop()
+	{
+		MpscQueueEntry* pTail = m_pTail;
+		MpscQueueEntry* pNext = pTail->pNext.load(std::memory_order_acquire);
+
+		if (pTail == &m_Stub)
+		{
+			if (pNext == nullptr)
+			{
+				return nullptr;
+			}
+
+			m_pTail = pNext;
+			pTail = pNext;
+			pNext = pNext->pNext.load(std::memory_order_acquire);
+		}
+
+		if (pNext != nullptr)
+		{
+			m_pTail = pNext;
+			return pTail;
+		}
+
+		if (pTail != m_pHead.load(std::memory_order_acquire))
+		{
+			//
+			// Another entry is being pushed, but isn't linked yet.
+			//
+			return nullptr;
+		}
+
+		//
+		// pTail is the last entry. Push the stub behind it so that it can be unlinked.
+		//
+		Push(&m_Stub);
+
+		pNext = pTail->pNext.load(std::memory_order_acquire);
+		if (pNext != nullptr)
+		{
+			m_pTail = pNext;
+			return pTail;
+		}
+
+		return nullptr;
+	}
+
+private:
+	std::atomic<MpscQueueEntry*> m_pHead;
+	MpscQueueEntry* m_pTail;
+	MpscQueueEntry m_Stub;
+};
+
+#define PAGING_HEAP_INVALID_INDEX UINT32_MAX
+
+//
+// An indexed binary heap of objects, ordered by descending score. Objects with the same
+// score are ordered by when they were inserted: objects inserted at the tail come out in
+// FIFO order, after any objects of the same score inserted at the head, which come out in
+// LIFO order. This matches a linked list kept sorted by score, but inserts and removes in
+// O(log n) time instead of O(n).
+//
+// T must have the members:
+//     float PagingScore;
+//     int64_t PagingSequence;
+//     uint32_t PagingHeapIndex;     // PAGING_HEAP_INVALID_INDEX when not in a heap.
+//
+// The heap is not thread safe.
+//
+template<typename T>
+class PagingPriorityHeap
+{
+public:
+	PagingPriorityHeap() :
+		m_NextTailSequence(0),
+		m_NextHeadSequence(-1)
+	{
+	}
+
+	PagingPriorityHeap(const PagingPriorityHeap&) = delete;
+	PagingPriorityHeap& operator=(const PagingPriorityHeap&) = delete;
+
+	bool IsEmpty() const
+	{
+		return m_Heap.empty();
+	}
+
+	size_t GetSize() const
+	{
+		return m_Heap.size();
+	}
+
+	bool Contains(const T* pObject) const
+	{
+		return pObject->PagingHeapIndex < m_Heap.size() && m_Heap[pObject->PagingHeapIndex] == pObject;
+	}
+
+	T* GetTop() const
+	{
+		return m_Heap.empty() ? nullptr : m_Heap[0];
+	}
+
+	void Insert(T* pObject, bool bInsertAtHead)
+	{
+		pObject->PagingSequence = bInsertAtHead ? m_NextHeadSequence-- : m_NextTailSequence++;
+		pObject->PagingHeapIndex = static_cast<uint32_t>(m_Heap.size());
+		m_Heap.push_back(pObject);
+		SiftUp(pObject->PagingHeapIndex);
+	}
+
+	void Remove(T* pObject)
+	{
+		uint32_t Index = pObject->PagingHeapIndex;
+		pObject->PagingHeapIndex = PAGING_HEAP_INVALID_INDEX;
+
+		T* pLast = m_Heap.back();
+		m_Heap.pop_back();
+
+		if (pLast != pObject)
+		{
+			//
+			// Move the last object into the hole, and restore the heap order in whichever
+			// direction it is broken.
+			//
+			m_Heap[Index] = pLast;
+			pLast->PagingHeapIndex = Index;
+			if (Index > 0 && IsOrderedBefore(pLast, m_Heap[(Index - 1) / 2]))
+			{
+				SiftUp(Index);
+			}
+			else
+			{
+				SiftDown(Index);
+			}
+		}
+	}
+
+	T* Pop()
+	{
+		T* pTop = GetTop();
+		if (pTop != nullptr)
+		{
+			Remove(pTop);
+		}
+		return pTop;
+	}
+
+	void Clear()
+	{
+		for (T* pObject : m_Heap)
+		{
+			pObject->PagingHeapIndex = PAGING_HEAP_INVALID_INDEX;
+		}
+		m_Heap.clear();
+	}
+
+	//
+	// Returns true if the heap order holds for every object. Used by tests.
+	//
+	bool Validate() const
+	{
+		for (size_t i = 0; i < m_Heap.size(); ++i)
+		{
+			if (m_Heap[i]->PagingHeapIndex != i || (i > 0 && IsOrderedBefore(m_Heap[i], m_Heap[(i - 1) / 2])))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static bool IsOrderedBefore(const T* pA, const T* pB)
+	{
+		if (pA->PagingScore != pB->PagingScore)
+		{
+			return pA->PagingScore > pB->PagingScore;
+		}
+		return pA->PagingSequence < pB->PagingSequence;
+	}
+
+private:
+	void SiftUp(uint32_t Index)
+	{
+		T* pObject = m_Heap[Index];
+		while (Index > 0)
+		{
+			uint32_t Parent = (Index - 1) / 2;
+			if (!IsOrderedBefore(pObject, m_Heap[Parent]))
+			{
+				break;
+			}
+
+			m_Heap[Index] = m_Heap[Parent];
+			m_Heap[Index]->PagingHeapIndex = Index;
+			Index = Parent;
+		}
+
+		m_Heap[Index] = pObject;
+		pObject->PagingHeapIndex = Index;
+	}
+
+	void SiftDown(uint32_t Index)
+	{
+		T* pObject = m_Heap[Index];
+		uint32_t Count = static_cast<uint32_t>(m_Heap.size());
+		for (;;)
+		{
+			uint32_t Child = 2 * Index + 1;
+			if (Child >= Count)
+			{
+				break;
+			}
+			if (Child + 1 < Count && IsOrderedBefore(m_Heap[Child + 1], m_Heap[Child]))
+			{
+				++Child;
+			}
+			if (!IsOrderedBefore(m_Heap[Child], pObject))
+			{
+				break;
+			}
+
+			m_Heap[Index] = m_Heap[Child];
+			m_Heap[Index]->PagingHeapIndex = Index;
+			Index = Child;
+		}
+
+		m_Heap[Index] = pObject;
+		pObject->PagingHeapIndex = Index;
+	}
+
+	std::vector<T*> m_Heap;
+	int64_t m_NextTailSequence;
+	int64_t m_NextHeadSequence;
+};
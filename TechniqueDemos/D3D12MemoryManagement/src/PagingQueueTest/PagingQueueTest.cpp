@@ -0,0 +1,682 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Tests and measures the queues the render thread uses to hand resources to the paging worker thread
+// (PagingQueue.h), without a D3D12 device.
+//
+// Usage: PagingQueueTest selftest
+//        PagingQueueTest stress [seconds] [producer threads]
+//        PagingQueueTest benchmark [frames] [resources per frame]
+//
+//   selftest    Compares PagingPriorityHeap against the sorted linked list it replaced, using random inserts
+//               (at the head and tail, with many equal scores), removes and pops.
+//   stress      Several producer threads repeatedly change resources and enqueue them, while a consumer
+//               thread drains the queue and reprioritizes the resources into heaps, like the worker thread.
+//               Checks that no change is lost, that no resource is queued twice, and that the heaps stay
+//               ordered. Defaults to 5 seconds and 4 producers.
+//   benchmark   Measures how long the render thread spends enqueuing resources each frame while the worker
+//               thread is prioritizing, for the MpscQueue and for the critical section and sorted lists it
+//               replaced. Defaults to 200 frames of 10000 resources.
+//
+// The exit code is 0 on success, 1 if a test fails and 2 for bad arguments.
+
+#include "../PagingQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	//
+	// The fields of Resource that take part in paging work submission.
+	//
+	struct TestResource
+	{
+		MpscQueueEntry PrioritizationEntry;
+		std::atomic<bool> bPrioritizationPending;
+
+		float PagingScore;
+		int64_t PagingSequence;
+		uint32_t PagingHeapIndex;
+
+		// Incremented by the producers each time they change the resource.
+		std::atomic<uint32_t> Version;
+
+		// The version last seen by the consumer.
+		uint32_t PrioritizedVersion;
+
+		// Used by the benchmark's critical section baseline.
+		TestResource* pPrevious;
+		TestResource* pNext;
+		bool bInPrioritizationList;
+		std::list<TestResource*>::iterator PagingEntry;
+		int Queue;
+	};
+
+	inline TestResource* ResourceFromEntry(MpscQueueEntry* pEntry)
+	{
+		return reinterpret_cast<TestResource*>(reinterpret_cast<char*>(pEntry) - offsetof(TestResource, PrioritizationEntry));
+	}
+
+	std::vector<TestResource> CreateResources(size_t Count)
+	{
+		std::vector<TestResource> Resources(Count);
+		for (TestResource& Resource : Resources)
+		{
+			Resource.bPrioritizationPending = false;
+			Resource.PagingScore = 0.0f;
+			Resource.PagingSequence = 0;
+			Resource.PagingHeapIndex = PAGING_HEAP_INVALID_INDEX;
+			Resource.Version = 0;
+			Resource.PrioritizedVersion = 0;
+			Resource.pPrevious = nullptr;
+			Resource.pNext = nullptr;
+			Resource.bInPrioritizationList = false;
+			Resource.Queue = -1;
+		}
+		return Resources;
+	}
+
+	//
+	// An auto-reset event, standing in for the worker thread's submission event.
+	//
+	class Event
+	{
+	public:
+		Event() : m_bSet(false) {}
+
+		void Set()
+		{
+			std::lock_guard<std::mutex> Lock(m_Mutex);
+			m_bSet = true;
+			m_Condition.notify_one();
+		}
+
+		bool Wait(std::chrono::milliseconds Timeout)
+		{
+			std::unique_lock<std::mutex> Lock(m_Mutex);
+			bool bSet = m_Condition.wait_for(Lock, Timeout, [this] { return m_bSet; });
+			m_bSet = false;
+			return bSet;
+		}
+
+	private:
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		bool m_bSet;
+	};
+
+	const int QueueCount = 4;
+
+	//
+	// The priority queues and prioritization used by both the stress test and the benchmark.
+	// The score depends on the version, so that a lost update would leave a resource in the
+	// wrong place, as well as with a stale version.
+	//
+	struct PriorityQueues
+	{
+		PagingPriorityHeap<TestResource> Heaps[QueueCount];
+
+		void Remove(TestResource* pResource)
+		{
+			for (int i = 0; i < QueueCount; ++i)
+			{
+				if (Heaps[i].Contains(pResource))
+				{
+					Heaps[i].Remove(pResource);
+					return;
+				}
+			}
+		}
+
+		void Prioritize(TestResource* pResource, uint32_t Version)
+		{
+			Remove(pResource);
+
+			uint32_t Hash = Version * 2654435761u;
+			if (Hash % 8 == 0)
+			{
+				// No more work for this resource.
+				return;
+			}
+
+			pResource->PagingScore = static_cast<float>(Hash % 5);
+			Heaps[Hash % QueueCount].Insert(pResource, (Hash & 16) != 0);
+		}
+
+		bool Validate() const
+		{
+			for (int i = 0; i < QueueCount; ++i)
+			{
+				if (!Heaps[i].Validate())
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	//
+	// The sorted list insert that PagingPriorityHeap replaced.
+	//
+	void InsertSorted(std::list<TestResource*>& Queue, TestResource* pResource, bool bInsertAtHead)
+	{
+		std::list<TestResource*>::iterator Position;
+		if (bInsertAtHead)
+		{
+			Position = Queue.begin();
+			while (Position != Queue.end() && (*Position)->PagingScore > pResource->PagingScore)
+			{
+				++Position;
+			}
+		}
+		else
+		{
+			Position = Queue.end();
+			while (Position != Queue.begin() && (*std::prev(Position))->PagingScore < pResource->PagingScore)
+			{
+				--Position;
+			}
+		}
+		pResource->PagingEntry = Queue.insert(Position, pResource);
+	}
+
+	int RunSelfTest()
+	{
+		const size_t ResourceCount = 256;
+		const int OperationCount = 200000;
+
+		std::vector<TestResource> Resources = CreateResources(ResourceCount);
+		std::vector<bool> Queued(ResourceCount, false);
+		PagingPriorityHeap<TestResource> Heap;
+		std::list<TestResource*> Reference;
+		std::mt19937 Random(1);
+
+		for (int Operation = 0; Operation < OperationCount; ++Operation)
+		{
+			size_t Index = Random() % ResourceCount;
+			TestResource* pResource = &Resources[Index];
+
+			switch (Random() % 4)
+			{
+			case 0:
+			case 1:
+				if (Queued[Index])
+				{
+					Heap.Remove(pResource);
+					Reference.erase(pResource->PagingEntry);
+				}
+
+				{
+					// Few distinct scores, so that most inserts are ties.
+					bool bInsertAtHead = (Random() % 2) != 0;
+					pResource->PagingScore = static_cast<float>(Random() % 4);
+					Heap.Insert(pResource, bInsertAtHead);
+					InsertSorted(Reference, pResource, bInsertAtHead);
+					Queued[Index] = true;
+				}
+				break;
+
+			case 2:
+				if (Queued[Index])
+				{
+					Heap.Remove(pResource);
+					Reference.erase(pResource->PagingEntry);
+					Queued[Index] = false;
+				}
+				break;
+
+			case 3:
+				if (!Reference.empty())
+				{
+					TestResource* pTop = Heap.Pop();
+					if (pTop != Reference.front())
+					{
+						printf("FAILED: operation %d popped resource %d, expected %d\n", Operation,
+							static_cast<int>(pTop - Resources.data()), static_cast<int>(Reference.front() - Resources.data()));
+						return 1;
+					}
+					Reference.pop_front();
+					Queued[pTop - Resources.data()] = false;
+				}
+				break;
+			}
+
+			if (Heap.GetSize() != Reference.size() || Heap.GetTop() != (Reference.empty() ? nullptr : Reference.front()))
+			{
+				printf("FAILED: operation %d left the heap out of step with the sorted list\n", Operation);
+				return 1;
+			}
+
+			if (Operation % 1000 == 0 && !Heap.Validate())
+			{
+				printf("FAILED: operation %d broke the heap order\n", Operation);
+				return 1;
+			}
+		}
+
+		while (!Reference.empty())
+		{
+			if (Heap.Pop() != Reference.front())
+			{
+				printf("FAILED: final pop order differs from the sorted list\n");
+				return 1;
+			}
+			Reference.pop_front();
+		}
+
+		printf("selftest passed (%d operations)\n", OperationCount);
+		return 0;
+	}
+
+	//
+	// Mirrors PagingWorkerThread: the producers use EnqueueResource's pending flag and
+	// coalesced wake up, and the consumer uses ReprioritizeResources.
+	//
+	class StressTest
+	{
+	public:
+		StressTest(size_t ResourceCount) :
+			m_Resources(CreateResources(ResourceCount)),
+			m_bSubmissionSignaled(false),
+			m_DoubleQueued(0),
+			m_Prioritized(0)
+		{
+		}
+
+		void Enqueue(TestResource* pResource)
+		{
+			if (!pResource->bPrioritizationPending.exchange(true))
+			{
+				m_Queue.Push(&pResource->PrioritizationEntry);
+			}
+
+			if (!m_bSubmissionSignaled.exchange(true))
+			{
+				m_SubmissionEvent.Set();
+			}
+		}
+
+		void Reprioritize()
+		{
+			m_bSubmissionSignaled = false;
+
+			MpscQueueEntry* pEntry;
+			while ((pEntry = m_Queue.Pop()) != nullptr)
+			{
+				TestResource* pResource = ResourceFromEntry(pEntry);
+				if (!pResource->bPrioritizationPending.exchange(false))
+				{
+					++m_DoubleQueued;
+				}
+
+				uint32_t Version = pResource->Version.load();
+				pResource->PrioritizedVersion = Version;
+				m_Queues.Prioritize(pResource, Version);
+				++m_Prioritized;
+			}
+		}
+
+		int Run(double Seconds, int ProducerCount)
+		{
+			std::atomic<bool> bStop(false);
+			std::atomic<bool> bConsumerStop(false);
+			std::atomic<uint64_t> Changes(0);
+			bool bHeapsValid = true;
+
+			std::thread Consumer([&]
+			{
+				std::mt19937 Random(12345);
+				uint64_t Iteration = 0;
+				while (!bConsumerStop)
+				{
+					m_SubmissionEvent.Wait(std::chrono::milliseconds(100));
+					Reprioritize();
+
+					//
+					// Process some work, as SelectResource would, so the heaps also see pops.
+					//
+					for (int i = 0; i < QueueCount; ++i)
+					{
+						if (!m_Queues.Heaps[i].IsEmpty() && Random() % 4 == 0)
+						{
+							m_Queues.Heaps[i].Pop();
+						}
+					}
+
+					if (++Iteration % 64 == 0 && !m_Queues.Validate())
+					{
+						bHeapsValid = false;
+					}
+				}
+
+				Reprioritize();
+			});
+
+			std::vector<std::thread> Producers;
+			for (int p = 0; p < ProducerCount; ++p)
+			{
+				Producers.emplace_back([&, p]
+				{
+					std::mt19937 Random(p + 1);
+					uint64_t LocalChanges = 0;
+					while (!bStop)
+					{
+						TestResource* pResource = &m_Resources[Random() % m_Resources.size()];
+						pResource->Version.fetch_add(1);
+						Enqueue(pResource);
+						++LocalChanges;
+					}
+					Changes += LocalChanges;
+				});
+			}
+
+			std::this_thread::sleep_for(std::chrono::duration<double>(Seconds));
+			bStop = true;
+			for (std::thread& Producer : Producers)
+			{
+				Producer.join();
+			}
+			bConsumerStop = true;
+			m_SubmissionEvent.Set();
+			Consumer.join();
+
+			size_t Lost = 0;
+			size_t StillPending = 0;
+			for (TestResource& Resource : m_Resources)
+			{
+				if (Resource.PrioritizedVersion != Resource.Version.load())
+				{
+					++Lost;
+				}
+				if (Resource.bPrioritizationPending)
+				{
+					++StillPending;
+				}
+			}
+
+			printf("stress: %d producers, %.1f s, %llu changes, %llu prioritizations\n", ProducerCount, Seconds,
+				static_cast<unsigned long long>(Changes.load()), static_cast<unsigned long long>(m_Prioritized));
+
+			bool bPassed = true;
+			if (Lost != 0 || StillPending != 0)
+			{
+				printf("FAILED: %zu resources lost their last change, %zu are still pending\n", Lost, StillPending);
+				bPassed = false;
+			}
+			if (m_DoubleQueued != 0)
+			{
+				printf("FAILED: %llu resources were queued twice\n", static_cast<unsigned long long>(m_DoubleQueued));
+				bPassed = false;
+			}
+			if (!bHeapsValid || !m_Queues.Validate())
+			{
+				printf("FAILED: the heap order was broken\n");
+				bPassed = false;
+			}
+
+			if (bPassed)
+			{
+				printf("stress passed\n");
+			}
+			return bPassed ? 0 : 1;
+		}
+
+	private:
+		std::vector<TestResource> m_Resources;
+		MpscQueue m_Queue;
+		std::atomic<bool> m_bSubmissionSignaled;
+		Event m_SubmissionEvent;
+		PriorityQueues m_Queues;
+		uint64_t m_DoubleQueued;
+		uint64_t m_Prioritized;
+	};
+
+	//
+	// The submission path before the MpscQueue: the render thread takes a lock to move each
+	// resource to the tail of the prioritization list and sets the event every time, and the
+	// worker thread holds the same lock while it reprioritizes the whole list into sorted
+	// linked lists.
+	//
+	class LockedSubmission
+	{
+	public:
+		LockedSubmission()
+		{
+			m_Head.pPrevious = m_Head.pNext = &m_Head;
+		}
+
+		void Enqueue(TestResource* pResource)
+		{
+			{
+				std::lock_guard<std::mutex> Lock(m_Lock);
+				if (pResource->bInPrioritizationList)
+				{
+					Unlink(pResource);
+				}
+				pResource->pPrevious = m_Head.pPrevious;
+				pResource->pNext = &m_Head;
+				m_Head.pPrevious->pNext = pResource;
+				m_Head.pPrevious = pResource;
+				pResource->bInPrioritizationList = true;
+			}
+			m_SubmissionEvent.Set();
+		}
+
+		void Reprioritize()
+		{
+			std::lock_guard<std::mutex> Lock(m_Lock);
+			while (m_Head.pNext != &m_Head)
+			{
+				TestResource* pResource = m_Head.pNext;
+				Unlink(pResource);
+				pResource->bInPrioritizationList = false;
+
+				if (pResource->Queue >= 0)
+				{
+					m_Queues[pResource->Queue].erase(pResource->PagingEntry);
+					pResource->Queue = -1;
+				}
+
+				uint32_t Hash = pResource->Version.load() * 2654435761u;
+				if (Hash % 8 != 0)
+				{
+					pResource->PagingScore = static_cast<float>(Hash % 5);
+					pResource->Queue = Hash % QueueCount;
+					InsertSorted(m_Queues[pResource->Queue], pResource, (Hash & 16) != 0);
+				}
+			}
+		}
+
+		Event& GetEvent()
+		{
+			return m_SubmissionEvent;
+		}
+
+	private:
+		static void Unlink(TestResource* pResource)
+		{
+			pResource->pPrevious->pNext = pResource->pNext;
+			pResource->pNext->pPrevious = pResource->pPrevious;
+		}
+
+		std::mutex m_Lock;
+		TestResource m_Head;
+		std::list<TestResource*> m_Queues[QueueCount];
+		Event m_SubmissionEvent;
+	};
+
+	class LockFreeSubmission
+	{
+	public:
+		void Enqueue(TestResource* pResource)
+		{
+			if (!pResource->bPrioritizationPending.exchange(true))
+			{
+				m_Queue.Push(&pResource->PrioritizationEntry);
+			}
+
+			if (!m_bSubmissionSignaled.exchange(true))
+			{
+				m_SubmissionEvent.Set();
+			}
+		}
+
+		void Reprioritize()
+		{
+			m_bSubmissionSignaled = false;
+
+			MpscQueueEntry* pEntry;
+			while ((pEntry = m_Queue.Pop()) != nullptr)
+			{
+				TestResource* pResource = ResourceFromEntry(pEntry);
+				pResource->bPrioritizationPending = false;
+				m_Queues.Prioritize(pResource, pResource->Version.load());
+			}
+		}
+
+		Event& GetEvent()
+		{
+			return m_SubmissionEvent;
+		}
+
+	private:
+		MpscQueue m_Queue;
+		std::atomic<bool> m_bSubmissionSignaled{ false };
+		PriorityQueues m_Queues;
+		Event m_SubmissionEvent;
+	};
+
+	template<typename Submission>
+	void RunBenchmark(const char* pName, int FrameCount, size_t ResourcesPerFrame)
+	{
+		//
+		// The scene has more resources than are touched in a frame, and each frame touches a
+		// window that slides across them, like a camera panning over the image grid.
+		//
+		std::vector<TestResource> Resources = CreateResources(ResourcesPerFrame * 4);
+		Submission Queue;
+		std::atomic<bool> bStop(false);
+
+		std::thread Worker([&]
+		{
+			while (!bStop)
+			{
+				Queue.GetEvent().Wait(std::chrono::milliseconds(100));
+				Queue.Reprioritize();
+			}
+		});
+
+		std::vector<double> FrameTimes;
+		FrameTimes.reserve(FrameCount);
+
+		for (int Frame = 0; Frame < FrameCount; ++Frame)
+		{
+			size_t First = (Frame * ResourcesPerFrame / 8) % Resources.size();
+
+			auto Start = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0; i < ResourcesPerFrame; ++i)
+			{
+				TestResource* pResource = &Resources[(First + i) % Resources.size()];
+				pResource->Version.fetch_add(1, std::memory_order_relaxed);
+				Queue.Enqueue(pResource);
+			}
+			auto End = std::chrono::high_resolution_clock::now();
+			FrameTimes.push_back(std::chrono::duration<double, std::micro>(End - Start).count());
+
+			//
+			// Leave the worker thread some of the frame to itself, as the rest of the render
+			// thread's frame would.
+			//
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+
+		bStop = true;
+		Queue.GetEvent().Set();
+		Worker.join();
+
+		std::sort(FrameTimes.begin(), FrameTimes.end());
+		double Median = FrameTimes[FrameTimes.size() / 2];
+		double P99 = FrameTimes[std::min(FrameTimes.size() - 1, FrameTimes.size() * 99 / 100)];
+		double Max = FrameTimes.back();
+
+		printf("%-18s %10.1f %10.1f %10.1f %12.1f\n", pName, Median, P99, Max, Median * 1000.0 / ResourcesPerFrame);
+	}
+
+	int RunBenchmarks(int FrameCount, size_t ResourcesPerFrame)
+	{
+		printf("enqueue time per frame, %d frames of %zu resources\n", FrameCount, ResourcesPerFrame);
+		printf("%-18s %10s %10s %10s %12s\n", "submission", "p50 us", "p99 us", "max us", "ns/resource");
+		RunBenchmark<LockedSubmission>("critical section", FrameCount, ResourcesPerFrame);
+		RunBenchmark<LockFreeSubmission>("mpsc queue", FrameCount, ResourcesPerFrame);
+		return 0;
+	}
+
+	void PrintUsage()
+	{
+		printf("Usage: PagingQueueTest selftest\n");
+		printf("       PagingQueueTest stress [seconds] [producer threads]\n");
+		printf("       PagingQueueTest benchmark [frames] [resources per frame]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 4)
+	{
+		PrintUsage();
+		return 2;
+	}
+
+	if (strcmp(argv[1], "selftest") == 0 && argc == 2)
+	{
+		return RunSelfTest();
+	}
+	else if (strcmp(argv[1], "stress") == 0)
+	{
+		double Seconds = argc > 2 ? atof(argv[2]) : 5.0;
+		int ProducerCount = argc > 3 ? atoi(argv[3]) : 4;
+		if (Seconds <= 0.0 || ProducerCount <= 0)
+		{
+			PrintUsage();
+			return 2;
+		}
+
+		StressTest Test(4096);
+		return Test.Run(Seconds, ProducerCount);
+	}
+	else if (strcmp(argv[1], "benchmark") == 0)
+	{
+		int FrameCount = argc > 2 ? atoi(argv[2]) : 200;
+		int ResourcesPerFrame = argc > 3 ? atoi(argv[3]) : 10000;
+		if (FrameCount <= 0 || ResourcesPerFrame <= 0)
+		{
+			PrintUsage();
+			return 2;
+		}
+
+		return RunBenchmarks(FrameCount, static_cast<size_t>(ResourcesPerFrame));
+	}
+
+	PrintUsage();
+	return 2;
+}
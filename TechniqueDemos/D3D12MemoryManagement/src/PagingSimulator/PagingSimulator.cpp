@@ -0,0 +1,1060 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Replays a paging trace through the sample's paging policies without a D3D12 device, and reports how well each
+// policy keeps up with the camera.
+//
+// Usage: PagingSimulator <trace file|pan|zoom> [-policy <name>|all] [-bandwidth <MB per frame>] [-budget <MB>]
+//                        [-frames] [-length <frames>]
+//        PagingSimulator -generate <pan|zoom> [frames]
+//
+// Traces are recorded by running the sample with '-recordpagingtrace <file>'. 'pan' and 'zoom' replay synthetic
+// traces instead, which are generated in memory ('-length' sets their length, 300 frames by default), and
+// '-generate' writes one of them to stdout. A trace is a list of events, one per line ('#' starts a comment):
+//
+//   resource <id> <standard mips> <packed mips> <packed bytes> <mip 0 bytes> ... <mip n bytes>
+//                                  Create a resource. Ids must be created in order, starting at 0
+//   budget <bytes>                 Set the local memory budget
+//   frame                          Start a new frame
+//   view <id> <visible mip|-> <prefetch mip|-> <distance>
+//                                  The resource's visible or prefetch mip (or '-' if undefined), or its
+//                                  screen-space distance from the viewport, changed
+//
+// At the end of each frame the worker thread is simulated until it runs out of work, or until it has paged in
+// the frame's bandwidth (8MB by default; 0 means unlimited). The budget defaults to 512MB until the trace sets it,
+// and '-budget' overrides the trace. The report includes:
+//
+//   deficit         The number of mip levels between the resident and visible mips, summed over all visible
+//                   resources. The average and maximum of the per-frame sum are reported.
+//   paged           Bytes paged in.
+//   trimmed         Mipmaps and bytes trimmed to stay under the budget.
+//   re-paged        Bytes paged in for mipmaps that had been trimmed earlier. This is the cost of trim churn.
+//   over budget     Frames that ended with the usage over the budget.
+//
+// With '-frames', the per-frame values are printed as CSV instead.
+//
+// The exit code is 0 on success and 2 for bad arguments or a malformed trace.
+
+#include "../PagingPolicy.h"
+#include "../PagingQueue.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const uint64_t _1MB = 1024 * 1024;
+	const uint64_t TileSize = 64 * 1024;
+	const int MaxMipCount = PAGING_UNDEFINED_MIP + 1;
+
+	//
+	// The number of paging operations the worker may process in a single frame, regardless
+	// of the bandwidth. This stops policies that trim and page in the same mips from
+	// spinning forever.
+	//
+	const int MaxOperationsPerFrame = 4096;
+
+	struct SimResource
+	{
+		uint32_t Id;
+		uint8_t NumStandardMips;
+		uint8_t NumPackedMips;
+		uint64_t PackedBytes;
+		std::vector<uint64_t> MipBytes;
+
+		uint8_t MostDetailedMipResident;
+		uint8_t VisibleMip;
+		uint8_t PrefetchMip;
+		float Distance;
+
+		float PagingScore;
+		int64_t PagingSequence;
+		uint32_t PagingHeapIndex;
+		ResourceTrimPass TrimLimit;
+		bool bIgnoreBudget;
+		bool bPackedHeapCreated;
+		std::vector<bool> WasTrimmed;
+
+		bool bPending;
+		std::list<SimResource*>::iterator PendingEntry;
+
+		bool bCommitted;
+		uint8_t CommittedList;
+		std::list<SimResource*>::iterator CommittedEntry;
+
+		uint8_t GetLeastDetailedMipHeapIndex() const
+		{
+			return (NumPackedMips != 0) ? NumStandardMips : NumStandardMips - 1;
+		}
+	};
+
+	struct FrameStats
+	{
+		uint64_t DeficitSum;
+		uint64_t DeficitMax;
+		uint64_t BytesPaged;
+		uint64_t Trims;
+		uint64_t BytesTrimmed;
+		uint64_t BytesRepaged;
+		uint64_t Usage;
+		uint64_t Budget;
+	};
+
+	struct TraceEvent
+	{
+		enum Type { Resource, Budget, Frame, View } EventType;
+		uint32_t Id;
+		uint8_t NumStandardMips;
+		uint8_t NumPackedMips;
+		uint64_t Bytes;
+		std::vector<uint64_t> MipBytes;
+		uint8_t VisibleMip;
+		uint8_t PrefetchMip;
+		float Distance;
+	};
+
+	//
+	// A model of PagingWorkerThread and DX12Framework's trimming, with resources reduced to
+	// their mip sizes. Budget usage is the sum of the resident mips and packed mip heaps.
+	//
+	// SelectResource, ProcessSubmission and TrimToTarget mirror the functions of the same
+	// name in Paging.cpp and Framework.cpp, and must be kept in sync with them.
+	//
+	class PagingModel
+	{
+	public:
+		PagingModel(const PagingPolicy* pPolicy, uint64_t Bandwidth, uint64_t BudgetOverride) :
+			m_pPolicy(pPolicy),
+			m_Bandwidth(Bandwidth),
+			m_BudgetOverride(BudgetOverride),
+			m_Budget(BudgetOverride ? BudgetOverride : 512 * _1MB),
+			m_Usage(0),
+			m_BandwidthDebt(0),
+			m_bFrameOpen(false)
+		{
+			m_Current = FrameStats();
+		}
+
+		bool Replay(const std::vector<TraceEvent>& Events)
+		{
+			for (const TraceEvent& Event : Events)
+			{
+				switch (Event.EventType)
+				{
+				case TraceEvent::Resource:
+					if (Event.Id != m_Resources.size())
+					{
+						fprintf(stderr, "Resource %u was created out of order\n", Event.Id);
+						return false;
+					}
+					CreateResource(Event);
+					break;
+
+				case TraceEvent::Budget:
+					if (m_BudgetOverride == 0)
+					{
+						SetBudget(Event.Bytes);
+					}
+					break;
+
+				case TraceEvent::Frame:
+					if (m_bFrameOpen)
+					{
+						EndFrame();
+					}
+					m_bFrameOpen = true;
+					break;
+
+				case TraceEvent::View:
+					if (Event.Id >= m_Resources.size())
+					{
+						fprintf(stderr, "View of unknown resource %u\n", Event.Id);
+						return false;
+					}
+					UpdateView(*m_Resources[Event.Id], Event);
+					break;
+				}
+			}
+
+			if (m_bFrameOpen)
+			{
+				EndFrame();
+			}
+			return true;
+		}
+
+		const std::vector<FrameStats>& GetFrames() const
+		{
+			return m_Frames;
+		}
+
+	private:
+		void CreateResource(const TraceEvent& Event)
+		{
+			std::unique_ptr<SimResource> pResource(new SimResource());
+			pResource->Id = Event.Id;
+			pResource->NumStandardMips = Event.NumStandardMips;
+			pResource->NumPackedMips = Event.NumPackedMips;
+			pResource->PackedBytes = Event.Bytes;
+			pResource->MipBytes = Event.MipBytes;
+			pResource->MostDetailedMipResident = Event.NumStandardMips + Event.NumPackedMips;
+			pResource->VisibleMip = PAGING_UNDEFINED_MIP;
+			pResource->PrefetchMip = PAGING_UNDEFINED_MIP;
+			pResource->Distance = 0.0f;
+			pResource->PagingScore = 0.0f;
+			pResource->TrimLimit = ERTP_None;
+			pResource->bIgnoreBudget = false;
+			pResource->bPackedHeapCreated = false;
+			pResource->WasTrimmed.assign(Event.NumStandardMips, false);
+			pResource->bPending = false;
+			pResource->PagingHeapIndex = PAGING_HEAP_INVALID_INDEX;
+			pResource->bCommitted = false;
+
+			//
+			// Like DX12Framework::CreateResource, notify the worker so the packed mips get paged in.
+			//
+			EnqueueResource(*pResource);
+			m_Resources.push_back(std::move(pResource));
+		}
+
+		void UpdateView(SimResource& Resource, const TraceEvent& Event)
+		{
+			Resource.VisibleMip = Event.VisibleMip;
+			Resource.PrefetchMip = Event.PrefetchMip;
+			Resource.Distance = Event.Distance;
+			EnqueueResource(Resource);
+		}
+
+		//
+		// Like PagingWorkerThread::EnqueueResource, a resource that is already waiting to be
+		// prioritized is moved to the end of the list.
+		//
+		void EnqueueResource(SimResource& Resource)
+		{
+			if (Resource.bPending)
+			{
+				m_Pending.erase(Resource.PendingEntry);
+			}
+			Resource.PendingEntry = m_Pending.insert(m_Pending.end(), &Resource);
+			Resource.bPending = true;
+		}
+
+		//
+		// Mirrors PagingWorkerThread::ProcessBudgetChangeNotification.
+		//
+		void SetBudget(uint64_t Budget)
+		{
+			m_Budget = Budget;
+			if (m_Usage > m_Budget)
+			{
+				TrimToTarget(ERTP_Visible, m_Budget);
+			}
+		}
+
+		void EndFrame()
+		{
+			//
+			// ReprioritizeResources
+			//
+			while (!m_Pending.empty())
+			{
+				SimResource* pResource = m_Pending.front();
+				m_Pending.pop_front();
+				pResource->bPending = false;
+
+				PrioritizeResource(*pResource);
+			}
+
+			//
+			// Run the worker until it runs out of work or bandwidth. Bandwidth spent past the end
+			// of the frame (by a large mip) is taken from the following frames.
+			//
+			uint64_t Allowance = UINT64_MAX;
+			if (m_Bandwidth != 0)
+			{
+				uint64_t Repaid = (m_BandwidthDebt < m_Bandwidth) ? m_BandwidthDebt : m_Bandwidth;
+				m_BandwidthDebt -= Repaid;
+				Allowance = m_Bandwidth - Repaid;
+			}
+
+			for (int Operation = 0; Operation < MaxOperationsPerFrame && m_Current.BytesPaged < Allowance; ++Operation)
+			{
+				if (!ProcessSubmission())
+				{
+					break;
+				}
+			}
+
+			if (m_Bandwidth != 0 && m_Current.BytesPaged > Allowance)
+			{
+				m_BandwidthDebt += m_Current.BytesPaged - Allowance;
+			}
+
+			for (const std::unique_ptr<SimResource>& pResource : m_Resources)
+			{
+				if (pResource->VisibleMip != PAGING_UNDEFINED_MIP && pResource->MostDetailedMipResident > pResource->VisibleMip)
+				{
+					uint64_t Deficit = pResource->MostDetailedMipResident - pResource->VisibleMip;
+					m_Current.DeficitSum += Deficit;
+					if (Deficit > m_Current.DeficitMax)
+					{
+						m_Current.DeficitMax = Deficit;
+					}
+				}
+			}
+
+			m_Current.Usage = m_Usage;
+			m_Current.Budget = m_Budget;
+			m_Frames.push_back(m_Current);
+			m_Current = FrameStats();
+		}
+
+		PagingResourceState GetState(const SimResource& Resource) const
+		{
+			PagingResourceState State;
+			State.MostDetailedMipResident = Resource.MostDetailedMipResident;
+			State.LeastDetailedMipHeapIndex = Resource.GetLeastDetailedMipHeapIndex();
+			State.VisibleMip = Resource.VisibleMip;
+			State.PrefetchMip = Resource.PrefetchMip;
+			State.Distance = Resource.Distance;
+			State.NextMipSize = 0;
+			if (Resource.MostDetailedMipResident != 0)
+			{
+				uint8_t NextMip = Resource.MostDetailedMipResident - 1;
+				if (NextMip < Resource.NumStandardMips)
+				{
+					State.NextMipSize = Resource.MipBytes[NextMip];
+				}
+			}
+			return State;
+		}
+
+		void PrioritizeResource(SimResource& Resource)
+		{
+			RemoveFromPriorityQueue(Resource);
+
+			PagingDecision Decision = m_pPolicy->Prioritize(GetState(Resource));
+			if (!Decision.bQueue)
+			{
+				return;
+			}
+
+			Resource.PagingScore = Decision.Score;
+			Resource.TrimLimit = Decision.TrimLimit;
+			if (Decision.bIgnoreBudget)
+			{
+				Resource.bIgnoreBudget = true;
+			}
+
+			m_Queues[Decision.Queue].Insert(&Resource, Decision.bInsertAtHead);
+		}
+
+		void RemoveFromPriorityQueue(SimResource& Resource)
+		{
+			for (int i = 0; i < _ERP_COUNT; ++i)
+			{
+				if (m_Queues[i].Contains(&Resource))
+				{
+					m_Queues[i].Remove(&Resource);
+					return;
+				}
+			}
+		}
+
+		SimResource* SelectResource()
+		{
+			for (int i = 0; i < _ERP_COUNT; ++i)
+			{
+				uint64_t BudgetBias = m_pPolicy->GetBudgetReserve(static_cast<ResourcePriority>(i));
+
+				if (!m_Queues[i].IsEmpty())
+				{
+					SimResource* pResource = m_Queues[i].GetTop();
+
+					uint64_t MipSize = GetState(*pResource).NextMipSize;
+
+					if (!pResource->bIgnoreBudget)
+					{
+						uint64_t Reserve = MipSize + BudgetBias;
+						uint64_t TargetUsage = (m_Budget > Reserve) ? m_Budget - Reserve : 0;
+
+						if (m_Usage + Reserve > m_Budget)
+						{
+							if (!TrimToTarget(pResource->TrimLimit, TargetUsage))
+							{
+								continue;
+							}
+						}
+					}
+
+					RemoveFromPriorityQueue(*pResource);
+					pResource->bIgnoreBudget = false;
+
+					return pResource;
+				}
+			}
+
+			return nullptr;
+		}
+
+		bool ProcessSubmission()
+		{
+			SimResource* pResource = SelectResource();
+			if (pResource == nullptr)
+			{
+				return false;
+			}
+
+			PageInNextLevelOfDetail(*pResource);
+			PrioritizeResource(*pResource);
+
+			if (m_Usage > m_Budget)
+			{
+				TrimToTarget(pResource->TrimLimit, m_Budget);
+			}
+			return true;
+		}
+
+		void PageInNextLevelOfDetail(SimResource& Resource)
+		{
+			uint8_t Mip = Resource.MostDetailedMipResident - 1;
+
+			if (Mip >= Resource.NumStandardMips)
+			{
+				//
+				// All packed mips share one heap, which is created with the least detailed mip.
+				//
+				if (!Resource.bPackedHeapCreated)
+				{
+					Resource.bPackedHeapCreated = true;
+					m_Usage += Resource.PackedBytes;
+					m_Current.BytesPaged += Resource.PackedBytes;
+				}
+			}
+			else
+			{
+				uint64_t Bytes = Resource.MipBytes[Mip];
+				m_Usage += Bytes;
+				m_Current.BytesPaged += Bytes;
+				if (Resource.WasTrimmed[Mip])
+				{
+					m_Current.BytesRepaged += Bytes;
+				}
+			}
+
+			Resource.MostDetailedMipResident = Mip;
+			AddResourceCommitment(Resource);
+		}
+
+		bool TrimToTarget(ResourceTrimPass MaxPass, uint64_t TargetUsage)
+		{
+			for (ResourceTrimPass CurrentPass = ERTP_NonPrefetchable;
+				CurrentPass <= MaxPass;
+				CurrentPass = static_cast<ResourceTrimPass>(CurrentPass + 1))
+			{
+				for (uint8_t Mip = 0; Mip < MaxMipCount; ++Mip)
+				{
+					std::list<SimResource*>& List = m_CommitmentLists[Mip];
+
+					std::list<SimResource*>::iterator Entry = List.begin();
+					while (Entry != List.end())
+					{
+						SimResource* pResource = *Entry;
+						++Entry;
+
+						if (Mip >= pResource->GetLeastDetailedMipHeapIndex())
+						{
+							continue;
+						}
+
+						if (m_pPolicy->CanTrim(CurrentPass, Mip, GetState(*pResource)))
+						{
+							TrimMip(*pResource, Mip);
+
+							if (m_Usage < TargetUsage)
+							{
+								return true;
+							}
+						}
+					}
+				}
+			}
+
+			return false;
+		}
+
+		void TrimMip(SimResource& Resource, uint8_t Mip)
+		{
+			m_Usage -= Resource.MipBytes[Mip];
+			m_Current.Trims++;
+			m_Current.BytesTrimmed += Resource.MipBytes[Mip];
+			Resource.WasTrimmed[Mip] = true;
+
+			Resource.MostDetailedMipResident = Mip + 1;
+			AddResourceCommitment(Resource);
+			PrioritizeResource(Resource);
+		}
+
+		void AddResourceCommitment(SimResource& Resource)
+		{
+			if (Resource.bCommitted)
+			{
+				m_CommitmentLists[Resource.CommittedList].erase(Resource.CommittedEntry);
+			}
+
+			uint8_t Index = Resource.MostDetailedMipResident;
+			Resource.CommittedEntry = m_CommitmentLists[Index].insert(m_CommitmentLists[Index].end(), &Resource);
+			Resource.CommittedList = Index;
+			Resource.bCommitted = true;
+		}
+
+		const PagingPolicy* m_pPolicy;
+		uint64_t m_Bandwidth;
+		uint64_t m_BudgetOverride;
+		uint64_t m_Budget;
+		uint64_t m_Usage;
+		uint64_t m_BandwidthDebt;
+		bool m_bFrameOpen;
+
+		std::vector<std::unique_ptr<SimResource>> m_Resources;
+		std::list<SimResource*> m_Pending;
+		PagingPriorityHeap<SimResource> m_Queues[_ERP_COUNT];
+		std::list<SimResource*> m_CommitmentLists[MaxMipCount];
+
+		FrameStats m_Current;
+		std::vector<FrameStats> m_Frames;
+	};
+
+	bool ParseMip(const std::string& Token, uint8_t& MipOut)
+	{
+		if (Token == "-")
+		{
+			MipOut = PAGING_UNDEFINED_MIP;
+			return true;
+		}
+
+		char* pEnd = nullptr;
+		unsigned long Value = strtoul(Token.c_str(), &pEnd, 10);
+		if (pEnd == Token.c_str() || *pEnd != '\0' || Value >= PAGING_UNDEFINED_MIP)
+		{
+			return false;
+		}
+
+		MipOut = static_cast<uint8_t>(Value);
+		return true;
+	}
+
+	bool ParseTraceLine(const std::string& Line, std::vector<TraceEvent>& Events)
+	{
+		std::istringstream Stream(Line.substr(0, Line.find('#')));
+
+		std::string Command;
+		if (!(Stream >> Command))
+		{
+			return true;
+		}
+
+		TraceEvent Event = {};
+		if (Command == "resource")
+		{
+			unsigned int NumStandardMips;
+			unsigned int NumPackedMips;
+			if (!(Stream >> Event.Id >> NumStandardMips >> NumPackedMips >> Event.Bytes) ||
+				NumStandardMips + NumPackedMips == 0 || NumStandardMips + NumPackedMips >= PAGING_UNDEFINED_MIP)
+			{
+				return false;
+			}
+
+			Event.EventType = TraceEvent::Resource;
+			Event.NumStandardMips = static_cast<uint8_t>(NumStandardMips);
+			Event.NumPackedMips = static_cast<uint8_t>(NumPackedMips);
+
+			uint64_t Bytes;
+			while (Stream >> Bytes)
+			{
+				Event.MipBytes.push_back(Bytes);
+			}
+			if (Event.MipBytes.size() != NumStandardMips || !Stream.eof())
+			{
+				return false;
+			}
+		}
+		else if (Command == "budget")
+		{
+			Event.EventType = TraceEvent::Budget;
+			if (!(Stream >> Event.Bytes))
+			{
+				return false;
+			}
+		}
+		else if (Command == "frame")
+		{
+			Event.EventType = TraceEvent::Frame;
+		}
+		else if (Command == "view")
+		{
+			std::string VisibleMip;
+			std::string PrefetchMip;
+			Event.EventType = TraceEvent::View;
+			if (!(Stream >> Event.Id >> VisibleMip >> PrefetchMip >> Event.Distance) ||
+				!ParseMip(VisibleMip, Event.VisibleMip) || !ParseMip(PrefetchMip, Event.PrefetchMip))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			return false;
+		}
+
+		Events.push_back(Event);
+		return true;
+	}
+
+	bool ParseTrace(std::istream& Stream, const char* pName, std::vector<TraceEvent>& Events)
+	{
+		std::string Line;
+		for (int LineNumber = 1; std::getline(Stream, Line); ++LineNumber)
+		{
+			if (!ParseTraceLine(Line, Events))
+			{
+				fprintf(stderr, "%s(%d): malformed event '%s'\n", pName, LineNumber, Line.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool LoadTrace(const char* pFileName, std::vector<TraceEvent>& Events)
+	{
+		std::ifstream File(pFileName);
+		if (!File)
+		{
+			fprintf(stderr, "Unable to open %s\n", pFileName);
+			return false;
+		}
+		return ParseTrace(File, pFileName, Events);
+	}
+
+	//
+	// Synthetic traces. The images are laid out on a grid and viewed by an orthographic
+	// camera, and the visible and prefetch mips are calculated the same way as
+	// D3D12MemoryManagement::CalculateImagePagingData.
+	//
+	const int GridSize = 16;
+	const float ImageSize = 256.0f;
+	const float ImagePadding = 32.0f;
+	const float ViewportWidth = 1280.0f;
+	const float ViewportHeight = 720.0f;
+	const float PrefetchDistance = 600.0f;
+	const int DefaultTraceLength = 300;
+
+	void AppendLine(std::string& Trace, const char* pFormat, ...)
+	{
+		char Line[256];
+		va_list Args;
+		va_start(Args, pFormat);
+		vsnprintf(Line, sizeof(Line), pFormat, Args);
+		va_end(Args);
+
+		Trace += Line;
+		Trace += '\n';
+	}
+
+	struct GeneratedImage
+	{
+		float Left;
+		float Top;
+		uint32_t Width;
+		uint8_t MipCount;
+		uint8_t VisibleMip;
+		uint8_t PrefetchMip;
+		float Distance;
+	};
+
+	void GenerateResource(uint32_t Id, GeneratedImage& Image, std::string& Trace)
+	{
+		//
+		// RGBA8 textures of 1K, 2K or 4K. A 64KB tile holds 128x128 texels, so every mip
+		// smaller than that is packed into a single tile.
+		//
+		static const uint32_t Widths[] = { 1024, 2048, 2048, 4096 };
+		Image.Width = Widths[(Id * 2654435761u >> 16) % 4];
+		Image.Left = (Id % GridSize) * (ImageSize + ImagePadding);
+		Image.Top = (Id / GridSize) * (ImageSize + ImagePadding);
+		Image.VisibleMip = PAGING_UNDEFINED_MIP;
+		Image.PrefetchMip = PAGING_UNDEFINED_MIP;
+		Image.Distance = 0.0f;
+
+		uint32_t NumStandardMips = 0;
+		for (uint32_t Width = Image.Width; Width >= 128; Width /= 2)
+		{
+			++NumStandardMips;
+		}
+		const uint32_t NumPackedMips = 7;
+		Image.MipCount = static_cast<uint8_t>(NumStandardMips + NumPackedMips);
+
+		std::ostringstream Line;
+		Line << "resource " << Id << " " << NumStandardMips << " " << NumPackedMips << " " << TileSize;
+		for (uint32_t Mip = 0; Mip < NumStandardMips; ++Mip)
+		{
+			uint64_t Width = Image.Width >> Mip;
+			Line << " " << Width * Width * 4;
+		}
+		Trace += Line.str();
+		Trace += '\n';
+	}
+
+	void GenerateView(uint32_t Id, GeneratedImage& Image, float CenterX, float CenterY, float Zoom, std::string& Trace)
+	{
+		float ViewLeft = CenterX - ViewportWidth / 2 / Zoom;
+		float ViewRight = CenterX + ViewportWidth / 2 / Zoom;
+		float ViewTop = CenterY - ViewportHeight / 2 / Zoom;
+		float ViewBottom = CenterY + ViewportHeight / 2 / Zoom;
+
+		float DistanceX = std::fmax(0.0f, std::fmax(ViewLeft - (Image.Left + ImageSize), Image.Left - ViewRight));
+		float DistanceY = std::fmax(0.0f, std::fmax(ViewTop - (Image.Top + ImageSize), Image.Top - ViewBottom));
+		float ScreenDistance = std::sqrt(DistanceX * DistanceX + DistanceY * DistanceY) * Zoom;
+
+		float RequiredMipLevel = std::fmax(0.0f, std::log2(Image.Width / (ImageSize * Zoom)));
+		uint8_t RequiredMip = static_cast<uint8_t>(std::fmin(RequiredMipLevel, Image.MipCount - 1.0f));
+
+		uint8_t VisibleMip = PAGING_UNDEFINED_MIP;
+		uint8_t PrefetchMip = PAGING_UNDEFINED_MIP;
+		float Distance = 0.0f;
+		if (ScreenDistance == 0.0f)
+		{
+			VisibleMip = RequiredMip;
+			PrefetchMip = (RequiredMip > 0) ? RequiredMip - 1 : 0;
+		}
+		else
+		{
+			if (ScreenDistance < PrefetchDistance)
+			{
+				PrefetchMip = RequiredMip;
+			}
+			if (ScreenDistance > 1.0f)
+			{
+				Distance = std::pow(2.0f, std::ceil(std::log2(ScreenDistance)));
+			}
+		}
+
+		if (VisibleMip != Image.VisibleMip || PrefetchMip != Image.PrefetchMip || Distance != Image.Distance)
+		{
+			Image.VisibleMip = VisibleMip;
+			Image.PrefetchMip = PrefetchMip;
+			Image.Distance = Distance;
+
+			char Visible[4] = "-";
+			char Prefetch[4] = "-";
+			if (VisibleMip != PAGING_UNDEFINED_MIP)
+			{
+				snprintf(Visible, sizeof(Visible), "%u", VisibleMip);
+			}
+			if (PrefetchMip != PAGING_UNDEFINED_MIP)
+			{
+				snprintf(Prefetch, sizeof(Prefetch), "%u", PrefetchMip);
+			}
+			AppendLine(Trace, "view %u %s %s %.0f", Id, Visible, Prefetch, Distance);
+		}
+	}
+
+	//
+	// 'pan' sweeps the camera across the grid at a fixed zoom level. 'zoom' holds the camera
+	// near the middle of the grid and repeatedly zooms from an overview to full detail. Both
+	// halve the budget for the middle third of the trace. The camera path is a function of the
+	// frame number alone, so a pattern and length always produce the same trace.
+	//
+	bool IsTracePattern(const char* pPattern)
+	{
+		return strcmp(pPattern, "pan") == 0 || strcmp(pPattern, "zoom") == 0;
+	}
+
+	std::string Generate(const char* pPattern, int FrameCount)
+	{
+		const bool bPan = strcmp(pPattern, "pan") == 0;
+
+		const uint64_t Budget = 256 * _1MB;
+		const float Pi = 3.14159265f;
+		const float GridExtent = GridSize * (ImageSize + ImagePadding);
+
+		std::string Trace;
+		AppendLine(Trace, "# Generated by 'PagingSimulator -generate %s %d'", pPattern, FrameCount);
+		std::vector<GeneratedImage> Images(GridSize * GridSize);
+		for (uint32_t Id = 0; Id < Images.size(); ++Id)
+		{
+			GenerateResource(Id, Images[Id], Trace);
+		}
+		AppendLine(Trace, "budget %llu", (unsigned long long)Budget);
+
+		for (int Frame = 0; Frame < FrameCount; ++Frame)
+		{
+			float t = static_cast<float>(Frame) / FrameCount;
+
+			AppendLine(Trace, "frame");
+			if (Frame == FrameCount / 3)
+			{
+				AppendLine(Trace, "budget %llu", (unsigned long long)(Budget / 2));
+			}
+			else if (Frame == 2 * FrameCount / 3)
+			{
+				AppendLine(Trace, "budget %llu", (unsigned long long)Budget);
+			}
+
+			float CenterX, CenterY, Zoom;
+			if (bPan)
+			{
+				CenterX = GridExtent * (0.5f + 0.4f * std::sin(2 * Pi * t));
+				CenterY = GridExtent * (0.5f + 0.4f * std::sin(4 * Pi * t));
+				Zoom = 2.0f;
+			}
+			else
+			{
+				CenterX = GridExtent * (0.5f + 0.1f * std::sin(2 * Pi * t));
+				CenterY = GridExtent * 0.5f;
+				Zoom = std::pow(2.0f, -3.0f + 2.5f * (1.0f - std::cos(6 * Pi * t)));
+			}
+
+			for (uint32_t Id = 0; Id < Images.size(); ++Id)
+			{
+				GenerateView(Id, Images[Id], CenterX, CenterY, Zoom, Trace);
+			}
+		}
+
+		return Trace;
+	}
+
+	struct PolicySummary
+	{
+		const char* pName;
+		size_t Frames;
+		double DeficitAverage;
+		uint64_t DeficitMax;
+		uint64_t BytesPaged;
+		uint64_t Trims;
+		uint64_t BytesTrimmed;
+		uint64_t BytesRepaged;
+		size_t FramesOverBudget;
+	};
+
+	PolicySummary Summarize(const char* pName, const std::vector<FrameStats>& Frames)
+	{
+		PolicySummary Summary = {};
+		Summary.pName = pName;
+		Summary.Frames = Frames.size();
+
+		uint64_t DeficitTotal = 0;
+		for (const FrameStats& Frame : Frames)
+		{
+			DeficitTotal += Frame.DeficitSum;
+			if (Frame.DeficitSum > Summary.DeficitMax)
+			{
+				Summary.DeficitMax = Frame.DeficitSum;
+			}
+			Summary.BytesPaged += Frame.BytesPaged;
+			Summary.Trims += Frame.Trims;
+			Summary.BytesTrimmed += Frame.BytesTrimmed;
+			Summary.BytesRepaged += Frame.BytesRepaged;
+			Summary.FramesOverBudget += (Frame.Usage > Frame.Budget) ? 1 : 0;
+		}
+
+		if (!Frames.empty())
+		{
+			Summary.DeficitAverage = static_cast<double>(DeficitTotal) / Frames.size();
+		}
+		return Summary;
+	}
+
+	void PrintFrames(const char* pName, const std::vector<FrameStats>& Frames)
+	{
+		for (size_t i = 0; i < Frames.size(); ++i)
+		{
+			const FrameStats& Frame = Frames[i];
+			printf("%s,%zu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+				pName, i,
+				(unsigned long long)Frame.DeficitSum,
+				(unsigned long long)Frame.DeficitMax,
+				(unsigned long long)Frame.BytesPaged,
+				(unsigned long long)Frame.Trims,
+				(unsigned long long)Frame.BytesTrimmed,
+				(unsigned long long)Frame.BytesRepaged,
+				(unsigned long long)Frame.Usage,
+				(unsigned long long)Frame.Budget);
+		}
+	}
+
+	double ToMB(uint64_t Bytes)
+	{
+		return static_cast<double>(Bytes) / _1MB;
+	}
+
+	void PrintUsage(const char* pProgram)
+	{
+		fprintf(stderr,
+			"Usage: %s <trace file|pan|zoom> [-policy <name>|all] [-bandwidth <MB per frame>] [-budget <MB>]\n"
+			"           [-frames] [-length <frames>]\n"
+			"       %s -generate <pan|zoom> [frames]\n"
+			"Policies:",
+			pProgram, pProgram);
+		for (const char* const* ppName = g_PagingPolicyNames; *ppName; ++ppName)
+		{
+			fprintf(stderr, " %s", *ppName);
+		}
+		fprintf(stderr, "\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc >= 3 && strcmp(argv[1], "-generate") == 0)
+	{
+		int FrameCount = (argc >= 4) ? atoi(argv[3]) : DefaultTraceLength;
+		if (!IsTracePattern(argv[2]) || FrameCount <= 0)
+		{
+			PrintUsage(argv[0]);
+			return 2;
+		}
+		fputs(Generate(argv[2], FrameCount).c_str(), stdout);
+		return 0;
+	}
+
+	if (argc < 2)
+	{
+		PrintUsage(argv[0]);
+		return 2;
+	}
+
+	const char* pPolicyName = "all";
+	uint64_t Bandwidth = 8 * _1MB;
+	uint64_t BudgetOverride = 0;
+	bool bPrintFrames = false;
+	int TraceLength = DefaultTraceLength;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-policy") == 0 && i + 1 < argc)
+		{
+			pPolicyName = argv[++i];
+		}
+		else if (strcmp(argv[i], "-bandwidth") == 0 && i + 1 < argc)
+		{
+			Bandwidth = strtoull(argv[++i], nullptr, 10) * _1MB;
+		}
+		else if (strcmp(argv[i], "-budget") == 0 && i + 1 < argc)
+		{
+			BudgetOverride = strtoull(argv[++i], nullptr, 10) * _1MB;
+		}
+		else if (strcmp(argv[i], "-frames") == 0)
+		{
+			bPrintFrames = true;
+		}
+		else if (strcmp(argv[i], "-length") == 0 && i + 1 < argc && IsTracePattern(argv[1]))
+		{
+			TraceLength = atoi(argv[++i]);
+			if (TraceLength <= 0)
+			{
+				PrintUsage(argv[0]);
+				return 2;
+			}
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 2;
+		}
+	}
+
+	std::vector<const char*> PolicyNames;
+	if (strcmp(pPolicyName, "all") == 0)
+	{
+		for (const char* const* ppName = g_PagingPolicyNames; *ppName; ++ppName)
+		{
+			PolicyNames.push_back(*ppName);
+		}
+	}
+	else
+	{
+		PolicyNames.push_back(pPolicyName);
+	}
+
+	std::vector<TraceEvent> Events;
+	if (IsTracePattern(argv[1]))
+	{
+		std::istringstream Trace(Generate(argv[1], TraceLength));
+		if (!ParseTrace(Trace, argv[1], Events))
+		{
+			return 2;
+		}
+	}
+	else if (!LoadTrace(argv[1], Events))
+	{
+		return 2;
+	}
+
+	std::vector<PolicySummary> Summaries;
+	if (bPrintFrames)
+	{
+		printf("policy,frame,deficit_sum,deficit_max,paged_bytes,trims,trimmed_bytes,repaged_bytes,usage,budget\n");
+	}
+
+	for (const char* pName : PolicyNames)
+	{
+		std::unique_ptr<PagingPolicy> pPolicy(CreatePagingPolicy(pName));
+		if (!pPolicy)
+		{
+			fprintf(stderr, "Unknown paging policy '%s'\n", pName);
+			PrintUsage(argv[0]);
+			return 2;
+		}
+
+		PagingModel Model(pPolicy.get(), Bandwidth, BudgetOverride);
+		if (!Model.Replay(Events))
+		{
+			return 2;
+		}
+
+		if (bPrintFrames)
+		{
+			PrintFrames(pName, Model.GetFrames());
+		}
+		Summaries.push_back(Summarize(pName, Model.GetFrames()));
+	}
+
+	if (!bPrintFrames)
+	{
+		printf("%-12s %7s %12s %12s %10s %7s %11s %12s %12s\n",
+			"policy", "frames", "deficit avg", "deficit max", "paged MB", "trims", "trimmed MB", "re-paged MB", "over budget");
+		for (const PolicySummary& Summary : Summaries)
+		{
+			printf("%-12s %7zu %12.2f %12llu %10.1f %7llu %11.1f %12.1f %12zu\n",
+				Summary.pName,
+				Summary.Frames,
+				Summary.DeficitAverage,
+				(unsigned long long)Summary.DeficitMax,
+				ToMB(Summary.BytesPaged),
+				(unsigned long long)Summary.Trims,
+				ToMB(Summary.BytesTrimmed),
+				ToMB(Summary.BytesRepaged),
+				Summary.FramesOverBudget);
+		}
+	}
+
+	return 0;
+}
@@ -39,35 +39,6 @@ struct ResourceMip
 	UINT64 ReferenceFence;
 };
 
-//
-// Describes the priority which the worker thread uses to page in a resource. A
-// higher priority resource will always be paged in before a lower priority resource.
-//
-enum ResourcePriority
-{
-	ERP_VeryHigh,
-	ERP_High,
-	ERP_Medium,
-	ERP_Low,
-	_ERP_COUNT
-};
-
-//
-// This enum is used to restrict the extent of trimming operations when the process
-// is over its local memory budget. This helps ensure that lower priority resources not
-// cause higher priority resources to be trimmed, and prevents the worker thread from
-// recursively paging in new content.
-// e.g. a high quality prefetched mip will not trim a mipmap that is currently
-// visible on the screen.
-//
-enum ResourceTrimPass
-{
-	ERTP_None,
-	ERTP_NonPrefetchable,
-	ERTP_NonVisible,
-	ERTP_Visible,
-};
-
 //
 // Stores the per-resource device dependent state. This data must be recreated when
 // the graphics device is removed due to TDR, driver upgrade, surprise removal, etc.
@@ -102,11 +73,16 @@ struct Resource
 	// List entry for tracking the commitment of mipmaps for this resource.
 	LIST_ENTRY CommittedListEntry;
 
-	// List entry used by the worker thread to prioritize paging operations.
-	LIST_ENTRY PrioritizationEntry;
+	// Queue entry used to hand the resource to the worker thread for prioritization.
+	MpscQueueEntry PrioritizationEntry;
 
-	// List entry used to track paging requests.
-	LIST_ENTRY PagingEntry;
+	// Set while the resource is in the prioritization queue, so that it's only queued once
+	// no matter how many times it changes before the worker thread gets to it.
+	std::atomic<bool> bPrioritizationPending;
+
+	// Position of the resource in the worker thread's priority queues. See PagingPriorityHeap.
+	UINT32 PagingHeapIndex;
+	INT64 PagingSequence;
 
 	CRITICAL_SECTION ReferenceLock;
 
@@ -152,6 +128,13 @@ struct Resource
 	// camera movement.
 	UINT8 PrefetchMip : MAX_MIP_COUNT_BITS;
 
+	// The screen-space distance between the resource and the viewport, quantized so that
+	// it only changes occasionally. Zero when the resource is visible.
+	float Distance;
+
+	// Orders the resource within its paging queue. Set by the paging policy.
+	float PagingScore;
+
 	// True if the paging operation determined during prioritization should ignore
 	// the local memory budget. This is used when paging in minimum quality mipmaps
 	// to ensure that every resource has at least some low quality content.
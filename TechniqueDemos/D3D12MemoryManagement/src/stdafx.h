@@ -119,6 +119,9 @@ struct ColorF
 #include "Camera.h"
 #include "Shader.h"
 #include "Versioning.h"
+#include "PagingPolicy.h"
+#include "PagingQueue.h"
+#include "MipGenerator.h"
 #include "Resource.h"
 #include "Util.h"
 #include "Context.h"